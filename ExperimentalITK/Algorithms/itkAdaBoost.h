@@ -19,10 +19,13 @@
 #define __itkAdaBoost_h
 
 #include "itkCSVArray2DDataObject.h"
+#include "itkMultiThreader.h"
 #include "itkObject.h"
 #include "itkProcessObject.h"
 #include "itkVectorContainer.h"
 
+#include "vnl/vnl_vector.h"
+
 #include <vector>
 
 namespace itk
@@ -247,6 +250,18 @@ private:
 
 /** \class AdaBoost
  *
+ * Discrete AdaBoost with decision stumps as weak learners.
+ *
+ * The feature columns are sorted once at the beginning of the training into
+ * index permutations which are reused for every boosting iteration so that
+ * the optimal stump of a feature is found with a single linear scan of the
+ * weighted observations.  The per-feature searches are distributed over
+ * \c NumberOfThreads threads.
+ *
+ * For very large training sets, setting \c NumberOfHistogramBins to a
+ * non-zero value replaces the exact search by a search over the bin
+ * boundaries of a per-feature histogram (quantized once) which avoids the
+ * sorting altogether and reduces the memory footprint.
  */
 
 template<class TStrongClassifier>
@@ -286,6 +301,18 @@ public:
   itkSetMacro( NumberOfIterations, unsigned int );
   itkGetConstMacro( NumberOfIterations, unsigned int );
 
+  /** Set/Get the number of threads used for the weak learner search. */
+  itkSetClampMacro( NumberOfThreads, unsigned int, 1, ITK_MAX_THREADS );
+  itkGetConstMacro( NumberOfThreads, unsigned int );
+
+  /**
+   * Set/Get the number of histogram bins per feature used for the approximate
+   * weak learner search.  A value of 0 (default) selects the exact search
+   * over the presorted feature values.
+   */
+  itkSetClampMacro( NumberOfHistogramBins, unsigned int, 0, 65535 );
+  itkGetConstMacro( NumberOfHistogramBins, unsigned int );
+
   /** Add a single training observation (presumably with multiple features) */
   void AddTrainingObservation( MembershipSignType, SingleObservationContainerType & );
 
@@ -308,12 +335,51 @@ private:
   AdaBoost( const Self & ); // purposely not implemented
   void operator=( const Self & );          // purposely not implemented
 
+  /** Decision stump found for a single feature. */
+  struct StumpType
+    {
+    RealType           WeightedRate;
+    RealType           Threshold;
+    MembershipSignType MembershipSign;
+    };
+
+  /** Multi-threading support. */
+  struct ThreadStruct
+    {
+    Self *Filter;
+    };
+
+  static ITK_THREAD_RETURN_TYPE FindOptimalStumpsThreaderCallback( void * );
+
+  /** Sort (or quantize) each feature column once.  */
+  void PreprocessFeatures();
+
+  /** Find the optimal stump for feature j with the current weights */
+  void FindOptimalStumpForFeature( unsigned int );
+  void FindOptimalStumpForFeatureFromHistogram( unsigned int );
+
   std::vector<SingleObservationContainerType>    m_TrainingObservations;
   std::vector<MembershipSignType>                m_MembershipSigns;
 
   unsigned int                                   m_NumberOfIterations;
+  unsigned int                                   m_NumberOfThreads;
+  unsigned int                                   m_NumberOfHistogramBins;
 
   typename StrongClassifierType::Pointer         m_StrongClassifier;
+
+  /** Presorted feature columns: feature values in increasing order and the
+   *  corresponding observation indices. */
+  std::vector<std::vector<RealType> >            m_SortedFeatureValues;
+  std::vector<std::vector<unsigned int> >        m_SortedFeatureIndices;
+
+  /** Quantized feature columns for the histogram search. */
+  std::vector<std::vector<unsigned short> >      m_FeatureBins;
+  std::vector<RealType>                          m_FeatureMinimum;
+  std::vector<RealType>                          m_FeatureBinWidth;
+
+  /** Observation weights multiplied by the membership sign. */
+  vnl_vector<RealType>                           m_SignedWeights;
+  std::vector<StumpType>                         m_OptimalStumps;
 };
 
 } // end namespace itk
@@ -24,6 +24,7 @@
 #include "vnl/vnl_vector.h"
 
 #include <algorithm>
+#include <utility>
 
 namespace itk
 {
@@ -341,11 +342,15 @@ StrongClassifier<TWeakClassifier>
 
 template<class TStrongClassifier>
 AdaBoost<TStrongClassifier>
-::AdaBoost()
+::AdaBoost() :
+  m_NumberOfIterations( 10 ),
+  m_NumberOfHistogramBins( 0 )
 {
   this->m_TrainingObservations.clear();
   this->m_MembershipSigns.clear();
 
+  this->m_NumberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
+
   this->m_StrongClassifier = StrongClassifierType::New();
 }
 
@@ -375,8 +380,243 @@ AdaBoost<TStrongClassifier>
     {
     this->m_TrainingObservations.clear();
     this->m_MembershipSigns.clear();
-    this->m_Modified();
+    this->Modified();
+    }
+}
+
+template<class TStrongClassifier>
+void
+AdaBoost<TStrongClassifier>
+::PreprocessFeatures()
+{
+  unsigned int numberOfObservations = this->m_TrainingObservations.size();
+  unsigned int numberOfFeatures = this->m_TrainingObservations[0].size();
+
+  this->m_SortedFeatureValues.clear();
+  this->m_SortedFeatureIndices.clear();
+  this->m_FeatureBins.clear();
+  this->m_FeatureMinimum.clear();
+  this->m_FeatureBinWidth.clear();
+
+  if( this->m_NumberOfHistogramBins == 0 )
+    {
+    /** Sort each feature column once.  The permutations are reused for every
+     *  boosting iteration since only the weights change. */
+    this->m_SortedFeatureValues.resize( numberOfFeatures );
+    this->m_SortedFeatureIndices.resize( numberOfFeatures );
+
+    std::vector<std::pair<RealType, unsigned int> > column( numberOfObservations );
+    for( unsigned int j = 0; j < numberOfFeatures; j++ )
+      {
+      for( unsigned int n = 0; n < numberOfObservations; n++ )
+        {
+        column[n] = std::make_pair( this->m_TrainingObservations[n][j], n );
+        }
+      std::sort( column.begin(), column.end() );
+
+      this->m_SortedFeatureValues[j].resize( numberOfObservations );
+      this->m_SortedFeatureIndices[j].resize( numberOfObservations );
+      for( unsigned int n = 0; n < numberOfObservations; n++ )
+        {
+        this->m_SortedFeatureValues[j][n] = column[n].first;
+        this->m_SortedFeatureIndices[j][n] = column[n].second;
+        }
+      }
+    }
+  else
+    {
+    /** Quantize each feature column once into NumberOfHistogramBins
+     *  equal-width bins spanning the observed range. */
+    this->m_FeatureBins.resize( numberOfFeatures );
+    this->m_FeatureMinimum.resize( numberOfFeatures );
+    this->m_FeatureBinWidth.resize( numberOfFeatures );
+
+    for( unsigned int j = 0; j < numberOfFeatures; j++ )
+      {
+      RealType minValue = this->m_TrainingObservations[0][j];
+      RealType maxValue = this->m_TrainingObservations[0][j];
+      for( unsigned int n = 1; n < numberOfObservations; n++ )
+        {
+        minValue = vnl_math_min( minValue, this->m_TrainingObservations[n][j] );
+        maxValue = vnl_math_max( maxValue, this->m_TrainingObservations[n][j] );
+        }
+
+      RealType binWidth = ( maxValue - minValue ) / static_cast<RealType>( this->m_NumberOfHistogramBins );
+      if( binWidth <= 0.0 )
+        {
+        binWidth = 1.0;
+        }
+      this->m_FeatureMinimum[j] = minValue;
+      this->m_FeatureBinWidth[j] = binWidth;
+
+      this->m_FeatureBins[j].resize( numberOfObservations );
+      for( unsigned int n = 0; n < numberOfObservations; n++ )
+        {
+        unsigned int bin = static_cast<unsigned int>(
+          ( this->m_TrainingObservations[n][j] - minValue ) / binWidth );
+        this->m_FeatureBins[j][n] = static_cast<unsigned short>(
+          vnl_math_min( bin, this->m_NumberOfHistogramBins - 1 ) );
+        }
+      }
+    }
+}
+
+template<class TStrongClassifier>
+void
+AdaBoost<TStrongClassifier>
+::FindOptimalStumpForFeature( unsigned int j )
+{
+  /**
+   * The weights are normalized and stored multiplied by the membership sign.
+   * sumOfForegroundWeights is the weighted rate of the stump classifying the
+   * observations above the threshold as foreground.  Its complement is the
+   * rate of the stump classifying the observations below or at the threshold
+   * as foreground.  Starting with a threshold below all the values, passing an
+   * observation above the threshold changes the rate by its signed weight.
+   */
+  const std::vector<RealType> & values = this->m_SortedFeatureValues[j];
+  const std::vector<unsigned int> & indices = this->m_SortedFeatureIndices[j];
+  const RealType *signedWeights = this->m_SignedWeights.data_block();
+
+  RealType sumOfForegroundWeights = 0.0;
+  for( unsigned int n = 0; n < indices.size(); n++ )
+    {
+    if( signedWeights[n] > 0.0 )
+      {
+      sumOfForegroundWeights += signedWeights[n];
+      }
+    }
+
+  StumpType stump;
+  stump.Threshold = NumericTraits<RealType>::NonpositiveMin();
+  if( sumOfForegroundWeights >= 1.0 - sumOfForegroundWeights )
+    {
+    stump.WeightedRate = sumOfForegroundWeights;
+    stump.MembershipSign = FeatureNodeType::FOREGROUND;
+    }
+  else
+    {
+    stump.WeightedRate = 1.0 - sumOfForegroundWeights;
+    stump.MembershipSign = FeatureNodeType::BACKGROUND;
+    }
+
+  const unsigned int numberOfObservations = indices.size();
+  for( unsigned int n = 0; n < numberOfObservations; n++ )
+    {
+    sumOfForegroundWeights -= signedWeights[indices[n]];
+
+    // Only thresholds between distinct values are admissible
+    if( n + 1 < numberOfObservations && values[n + 1] == values[n] )
+      {
+      continue;
+      }
+
+    const RealType sumOfBackgroundWeights = 1.0 - sumOfForegroundWeights;
+    if( sumOfForegroundWeights > stump.WeightedRate )
+      {
+      stump.WeightedRate = sumOfForegroundWeights;
+      stump.Threshold = values[n];
+      stump.MembershipSign = FeatureNodeType::FOREGROUND;
+      }
+    if( sumOfBackgroundWeights > stump.WeightedRate )
+      {
+      stump.WeightedRate = sumOfBackgroundWeights;
+      stump.Threshold = values[n];
+      stump.MembershipSign = FeatureNodeType::BACKGROUND;
+      }
     }
+
+  this->m_OptimalStumps[j] = stump;
+}
+
+template<class TStrongClassifier>
+void
+AdaBoost<TStrongClassifier>
+::FindOptimalStumpForFeatureFromHistogram( unsigned int j )
+{
+  /** Same search as FindOptimalStumpForFeature() restricted to the bin
+   *  boundaries.  The histogram is accumulated in one pass over the
+   *  quantized column. */
+  const std::vector<unsigned short> & bins = this->m_FeatureBins[j];
+  const RealType *signedWeights = this->m_SignedWeights.data_block();
+
+  std::vector<RealType> histogram( this->m_NumberOfHistogramBins, 0.0 );
+
+  RealType sumOfForegroundWeights = 0.0;
+  for( unsigned int n = 0; n < bins.size(); n++ )
+    {
+    histogram[bins[n]] += signedWeights[n];
+    if( signedWeights[n] > 0.0 )
+      {
+      sumOfForegroundWeights += signedWeights[n];
+      }
+    }
+
+  StumpType stump;
+  stump.Threshold = NumericTraits<RealType>::NonpositiveMin();
+  if( sumOfForegroundWeights >= 1.0 - sumOfForegroundWeights )
+    {
+    stump.WeightedRate = sumOfForegroundWeights;
+    stump.MembershipSign = FeatureNodeType::FOREGROUND;
+    }
+  else
+    {
+    stump.WeightedRate = 1.0 - sumOfForegroundWeights;
+    stump.MembershipSign = FeatureNodeType::BACKGROUND;
+    }
+
+  // The last bin boundary corresponds to the constant classifier which has
+  // already been considered.
+  for( unsigned int b = 0; b + 1 < this->m_NumberOfHistogramBins; b++ )
+    {
+    sumOfForegroundWeights -= histogram[b];
+
+    const RealType threshold = this->m_FeatureMinimum[j] +
+      static_cast<RealType>( b + 1 ) * this->m_FeatureBinWidth[j];
+
+    const RealType sumOfBackgroundWeights = 1.0 - sumOfForegroundWeights;
+    if( sumOfForegroundWeights > stump.WeightedRate )
+      {
+      stump.WeightedRate = sumOfForegroundWeights;
+      stump.Threshold = threshold;
+      stump.MembershipSign = FeatureNodeType::FOREGROUND;
+      }
+    if( sumOfBackgroundWeights > stump.WeightedRate )
+      {
+      stump.WeightedRate = sumOfBackgroundWeights;
+      stump.Threshold = threshold;
+      stump.MembershipSign = FeatureNodeType::BACKGROUND;
+      }
+    }
+
+  this->m_OptimalStumps[j] = stump;
+}
+
+template<class TStrongClassifier>
+ITK_THREAD_RETURN_TYPE
+AdaBoost<TStrongClassifier>
+::FindOptimalStumpsThreaderCallback( void *arg )
+{
+  unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct *str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  // Features are interleaved between the threads
+  const unsigned int numberOfFeatures = str->Filter->m_OptimalStumps.size();
+  for( unsigned int j = threadId; j < numberOfFeatures; j += threadCount )
+    {
+    if( str->Filter->m_NumberOfHistogramBins == 0 )
+      {
+      str->Filter->FindOptimalStumpForFeature( j );
+      }
+    else
+      {
+      str->Filter->FindOptimalStumpForFeatureFromHistogram( j );
+      }
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
 }
 
 template<class TStrongClassifier>
@@ -416,64 +656,69 @@ AdaBoost<TStrongClassifier>
 
   vnl_vector<RealType> weights( numberOfObservations, 1.0 / static_cast<RealType>( numberOfObservations ) );
 
-  /** Train */
+  /** Ensemble hypothesis for each observation used to compute the true error */
+  vnl_vector<RealType> strongHypothesis( numberOfObservations, 0.0 );
+
+  /** Presort the features */
 
   unsigned int numberOfFeatures = this->m_TrainingObservations[0].size();
 
-  for( unsigned int i = 0; i < this->m_NumberOfIterations; i++ )
-    {
-    typename WeakClassifierType::Pointer optimalWeakClassifier = WeakClassifierType::New();
+  this->PreprocessFeatures();
 
-    for( unsigned int j = 0; j < numberOfFeatures; j++ )
-      {
-      SingleFeatureObservationsContainerType singleFeatureObservations;
+  this->m_SignedWeights.set_size( numberOfObservations );
+  this->m_OptimalStumps.resize( numberOfFeatures );
 
-      typename std::vector<SingleObservationContainerType>::const_iterator it;
-      for( it = this->m_TrainingObservations.begin(); it != this->m_TrainingObservations.end(); ++it )
-        {
-        unsigned int index = it - this->m_TrainingObservations.begin();
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( vnl_math_min( this->m_NumberOfThreads, numberOfFeatures ) );
 
-        typename FeatureNodeType::Pointer node = FeatureNodeType::New();
-        node->SetValue( ( *it )[j] );
-        node->SetMembershipSign( this->m_MembershipSigns[index] );
-        node->SetWeight( weights[index] );
+  ThreadStruct str;
+  str.Filter = this;
+  threader->SetSingleMethod( this->FindOptimalStumpsThreaderCallback, &str );
 
-        singleFeatureObservations.push_back( node );
-        }
-      std::sort( singleFeatureObservations.begin(), singleFeatureObservations.end() );
+  /** Train */
+
+  for( unsigned int i = 0; i < this->m_NumberOfIterations; i++ )
+    {
+    for( unsigned int n = 0; n < numberOfObservations; n++ )
+      {
+      this->m_SignedWeights[n] = weights[n] * static_cast<RealType>( this->m_MembershipSigns[n] );
+      }
 
-      typename WeakClassifierType::Pointer weakClassifier = WeakClassifierType::New();
-      weakClassifier->SetFeatureID( j );
-      weakClassifier->SetSingleFeatureObservations( singleFeatureObservations );
-      weakClassifier->DoWeakLearn();
+    threader->SingleMethodExecute();
 
-      if( weakClassifier->GetWeightedRate() > optimalWeakClassifier->GetWeightedRate() )
+    unsigned int optimalFeature = 0;
+    for( unsigned int j = 1; j < numberOfFeatures; j++ )
+      {
+      if( this->m_OptimalStumps[j].WeightedRate > this->m_OptimalStumps[optimalFeature].WeightedRate )
         {
-        optimalWeakClassifier->SetMembershipSign( weakClassifier->GetMembershipSign() );
-        optimalWeakClassifier->SetWeightedRate( weakClassifier->GetWeightedRate() );
-        optimalWeakClassifier->SetThreshold( weakClassifier->GetThreshold() );
-        optimalWeakClassifier->SetFeatureID( j );
+        optimalFeature = j;
         }
       }
 
-    RealType optimalWeightedRate = optimalWeakClassifier->GetWeightedRate();
+    typename WeakClassifierType::Pointer optimalWeakClassifier = WeakClassifierType::New();
+    optimalWeakClassifier->SetFeatureID( optimalFeature );
+    optimalWeakClassifier->SetMembershipSign( this->m_OptimalStumps[optimalFeature].MembershipSign );
+    optimalWeakClassifier->SetWeightedRate( this->m_OptimalStumps[optimalFeature].WeightedRate );
+    optimalWeakClassifier->SetThreshold( this->m_OptimalStumps[optimalFeature].Threshold );
+
     MembershipSignType optimalMembershipSign = optimalWeakClassifier->GetMembershipSign();
     RealType optimalThreshold = optimalWeakClassifier->GetThreshold();
 
+    // Avoid infinite weights for a perfect separation
+    RealType optimalWeightedRate = vnl_math_max( static_cast<RealType>( 1.0e-6 ),
+      vnl_math_min( static_cast<RealType>( 1.0 - 1.0e-6 ), optimalWeakClassifier->GetWeightedRate() ) );
+
     RealType alpha = 0.5 * vcl_log( optimalWeightedRate / ( 1.0 - optimalWeightedRate ) );
     RealType weightedError = 1.0;
     RealType trueError = 0.0;
-    RealType CH = 0.0;              // real value either -1 or +1
-    RealType H = 0.0;
-    RealType F = 0.0;
+    RealType H = 0.0;               // real value either -1 or +1
 
-    typename std::vector<SingleObservationContainerType>::const_iterator it;
-    for( it = this->m_TrainingObservations.begin(); it != this->m_TrainingObservations.end(); ++it )
+    for( unsigned int index = 0; index < numberOfObservations; index++ )
       {
-      unsigned int index = it - this->m_TrainingObservations.begin();
+      const RealType value = this->m_TrainingObservations[index][optimalFeature];
 
-      if( ( optimalMembershipSign == FeatureNodeType::FOREGROUND && ( *it )[index] > optimalThreshold ) ||
-        ( optimalMembershipSign == FeatureNodeType::BACKGROUND && ( *it )[index] <= optimalThreshold ) )
+      if( ( optimalMembershipSign == FeatureNodeType::FOREGROUND && value > optimalThreshold ) ||
+        ( optimalMembershipSign == FeatureNodeType::BACKGROUND && value <= optimalThreshold ) )
         {
         H = 1.0;
         }
@@ -487,26 +732,30 @@ AdaBoost<TStrongClassifier>
         weightedError -= weights[index];
         }
 
+      strongHypothesis[index] += alpha * H;
 
-      CH += alpha * H;
-
-      if( CH * static_cast<RealType>( this->m_MembershipSigns[index] ) < 0.0 )
+      if( strongHypothesis[index] * static_cast<RealType>( this->m_MembershipSigns[index] ) < 0.0 )
         {
         trueError += 1.0 / static_cast<RealType>( numberOfObservations );
         }
       weights[index] *= vcl_exp( -alpha * H * static_cast<RealType>( this->m_MembershipSigns[index] ) );
       }
 
-    std::cout << i << ": " << optimalThreshold << ", " << weightedError << ", " << trueError << ", " << CH << std::endl;
+    std::cout << i << ": " << optimalFeature << ", " << optimalThreshold << ", " << weightedError << ", " << trueError << std::endl;
 
     weights /= weights.sum();
 
-
     optimalWeakClassifier->SetWeightedError( weightedError );
     optimalWeakClassifier->SetTrueError( trueError );
 
     this->m_StrongClassifier->AddWeakClassifier( optimalWeakClassifier );
     }
+
+  /** Release the presorted features */
+  this->m_SortedFeatureValues.clear();
+  this->m_SortedFeatureIndices.clear();
+  this->m_FeatureBins.clear();
+  this->m_OptimalStumps.clear();
 }
 
 template<class TStrongClassifier>
@@ -515,6 +764,8 @@ AdaBoost<TStrongClassifier>
 ::PrintSelf( std::ostream& os, Indent indent ) const
 {
   os << indent << "Number of iterations:               " << this->m_NumberOfIterations << std::endl;
+  os << indent << "Number of threads:                  " << this->m_NumberOfThreads << std::endl;
+  os << indent << "Number of histogram bins:           " << this->m_NumberOfHistogramBins << std::endl;
   os << indent << "Number of observations:             " << this->m_TrainingObservations.size() << std::endl;
 
   if( this->m_TrainingObservations.size() > 0 )
@@ -70,23 +70,13 @@ public:
   typedef typename Superclass::FloatOffsetType         FloatOffsetType;
 
 
-  typedef itk::Image< DiffusionTensor3D< double> , 3 > 
-                                               DiffusionTensorImageType;
+  /** Tensor pixel type.  The six components are stored in float in the
+   * order (0,0) (0,1) (0,2) (1,1) (1,2) (2,2). */
+  typedef itk::DiffusionTensor3D< float >              TensorPixelType; 
 
+  typedef itk::Image< TensorPixelType, 3 >             DiffusionTensorImageType;
 
-  /** The default boundary condition for finite difference
-   * functions that is used unless overridden in the Evaluate() method. */
-  typedef ZeroFluxNeumannBoundaryCondition<DiffusionTensorImageType>
-    DefaultBoundaryConditionType;
-
-
-  /** Define diffusion image nbd type */
-  typedef ConstNeighborhoodIterator<DiffusionTensorImageType, 
-                                    DefaultBoundaryConditionType> 
-                                           DiffusionTensorNeighborhoodType;
-
-  /** Tensor pixel type */
-  typedef itk::SymmetricSecondRankTensor< double >  TensorPixelType; 
+  typedef DiffusionTensorImageType::OffsetValueType  TensorOffsetValueType;
 
   /** A global data type for this class of equations.  Used to store
    * values that are needed in calculating the time step and other intermediate
@@ -116,10 +106,14 @@ public:
                                 void *globalData,
                                 const FloatOffsetType& = FloatOffsetType(0.0));
   
-  /** Compute the equation value. */
+  /** Compute the equation value.  tensor points to the diffusion tensor
+   * of the center pixel in the tensor image buffer and tensorOffsets[2i]
+   * and tensorOffsets[2i+1] are the offsets of its neighbours at -1 and +1
+   * along axis i (0 outside the image, which is a zero flux boundary). */
   virtual PixelType ComputeUpdate(
                      const NeighborhoodType &neighborhood,
-                     const DiffusionTensorNeighborhoodType &neighborhoodTensor,
+                     const TensorPixelType *tensor,
+                     const TensorOffsetValueType *tensorOffsets,
                      void *globalData,
                      const FloatOffsetType& = FloatOffsetType(0.0));
 
@@ -75,7 +75,8 @@ template< class TImageType >
 typename AnisotropicDiffusionVesselEnhancementFunction< TImageType >::PixelType
 AnisotropicDiffusionVesselEnhancementFunction< TImageType >
 ::ComputeUpdate(const NeighborhoodType &it, 
-                const DiffusionTensorNeighborhoodType &gt,
+                const TensorPixelType *tensor,
+                const TensorOffsetValueType *tensorOffsets,
                 void *globalData,
                 const FloatOffsetType& offset)
 {
@@ -83,6 +84,11 @@ AnisotropicDiffusionVesselEnhancementFunction< TImageType >
   const ScalarValueType ZERO = NumericTraits<ScalarValueType>::Zero;
   const ScalarValueType center_value  = it.GetCenterPixel();
 
+  // Component of (i,j) in the tensor pixel
+  static const unsigned int component[3][3] = { {0, 1, 2},
+                                                {1, 3, 4},
+                                                {2, 4, 5} };
+
   // Global data structure
   GlobalDataStruct *gd = (GlobalDataStruct *)globalData;
 
@@ -126,22 +132,19 @@ AnisotropicDiffusionVesselEnhancementFunction< TImageType >
     }
 
   // Compute the diffusion tensor matrix first derivatives 
-  TensorPixelType center_Tensor_value  = gt.GetCenterPixel();
+  const TensorPixelType &center_Tensor_value = tensor[0];
 
   for( i = 0; i < ImageDimension; i++)
     {
-    const unsigned int positionA = 
-      static_cast<unsigned int>( m_Center + m_xStride[i]);
-    const unsigned int positionB = 
-      static_cast<unsigned int>( m_Center - m_xStride[i]);
-    
-    TensorPixelType positionA_Tensor_value = gt.GetPixel( positionA );
-    TensorPixelType positionB_Tensor_value = gt.GetPixel( positionB );
+    const TensorPixelType &positionA_Tensor_value = 
+      tensor[tensorOffsets[2 * i + 1]];
+    const TensorPixelType &positionB_Tensor_value = 
+      tensor[tensorOffsets[2 * i]];
 
     for( j = 0; j < ImageDimension; j++)
       { 
-      gd->m_DT_dxy[i][j] = 0.5 *  ( positionA_Tensor_value(i,j) - 
-                                positionB_Tensor_value(i,j) ); 
+      gd->m_DT_dxy[i][j] = 0.5 *  ( positionA_Tensor_value[component[i][j]] - 
+                                positionB_Tensor_value[component[i][j]] ); 
       }
     }
 
@@ -165,21 +168,21 @@ AnisotropicDiffusionVesselEnhancementFunction< TImageType >
 
   ScalarValueType   pdWrtImageIntensity1;
 
-  pdWrtImageIntensity1 = center_Tensor_value(0,0) *  gd->m_dxy[0][0]  + 
-                    center_Tensor_value(0,1) *  gd->m_dxy[0][1] +
-                    center_Tensor_value(0,2) *  gd->m_dxy[0][2];
+  pdWrtImageIntensity1 = center_Tensor_value[0] *  gd->m_dxy[0][0]  + 
+                    center_Tensor_value[1] *  gd->m_dxy[0][1] +
+                    center_Tensor_value[2] *  gd->m_dxy[0][2];
   
   ScalarValueType   pdWrtImageIntensity2;
 
-  pdWrtImageIntensity2 = center_Tensor_value(1,0) *  gd->m_dxy[1][0]  + 
-                    center_Tensor_value(1,1) *  gd->m_dxy[1][1] +
-                    center_Tensor_value(1,2) *  gd->m_dxy[1][2];
+  pdWrtImageIntensity2 = center_Tensor_value[1] *  gd->m_dxy[1][0]  + 
+                    center_Tensor_value[3] *  gd->m_dxy[1][1] +
+                    center_Tensor_value[4] *  gd->m_dxy[1][2];
  
   ScalarValueType   pdWrtImageIntensity3;
 
-  pdWrtImageIntensity3 = center_Tensor_value(2,0) *  gd->m_dxy[2][0]  + 
-                    center_Tensor_value(2,1) *  gd->m_dxy[2][1] +
-                    center_Tensor_value(2,2) *  gd->m_dxy[2][2];
+  pdWrtImageIntensity3 = center_Tensor_value[2] *  gd->m_dxy[2][0]  + 
+                    center_Tensor_value[4] *  gd->m_dxy[2][1] +
+                    center_Tensor_value[5] *  gd->m_dxy[2][2];
  
   ScalarValueType   total;
 
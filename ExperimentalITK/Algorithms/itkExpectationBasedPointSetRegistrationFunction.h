@@ -20,14 +20,13 @@
 
 #include "itkPointSetFunction.h"
 #include "itkGaussianMembershipFunction.h"
-#include "itkKdTreeGenerator.h"
-#include "itkListSample.h"
 #include "itkMatrix.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 #include "itkMeshSource.h"
+#include "itkMultiThreader.h"
+#include "itkPointCellGrid.h"
 #include "itkPointSet.h"
 #include "itkVector.h"
-#include "itkWeightedCentroidKdTreeGenerator.h"
 #include "itkPDEDeformableRegistrationFunction.h"
 #include "itkPoint.h"
 #include "itkCovariantVector.h"
@@ -35,6 +34,9 @@
 #include "itkLinearInterpolateImageFunction.h"
 #include "itkCentralDifferenceImageFunction.h"
 
+#include <map>
+#include <vector>
+
 namespace itk
 {
 
@@ -58,6 +60,14 @@ namespace itk
 * \warning This filter assumes that the fixed image type, moving image type
 * and deformation field type all have the same number of dimensions.
 *
+* The points of each label are kept in cell grids (PointCellGrid) between
+* iterations; a grid is only rebuilt, in linear time, when its points have
+* moved.  The expectation of each point over its neighbors in the other set
+* is computed in parallel, and the forces are then added to the field in
+* point order.  The neighbors are the KNeighborhood closest points, or, if
+* SigmaCutoff is positive, all the points within SigmaCutoff sigmas, which
+* is cheaper when sigma is small relative to the point spacing.
+*
 * \sa ExpectationBasedPointSetRegistrationFilter
 * \ingroup FiniteDifferenceFunctions
 */
@@ -123,11 +133,7 @@ public:
   typedef std::vector<PointDataType>       LabelSetType;
 //  typedef long PointDataType;
   typedef Vector<typename PointSetType::CoordRepType, MeasurementDimension> MeasurementVectorType;
-  typedef typename Statistics::ListSample<MeasurementVectorType>            SampleType;
-  typedef typename
-  Statistics::WeightedCentroidKdTreeGenerator<SampleType>   TreeGeneratorType;
-  typedef typename TreeGeneratorType::KdTreeType::
-  InstanceIdentifierVectorType                              NeighborhoodIdentifierType;
+  typedef PointCellGrid<MeasurementDimension>                               PointGridType;
 
   /** Bspline stuff */
   typedef PointSet<VectorType,
@@ -243,6 +249,18 @@ public:
     return this->m_KNeighborhood;
   }
 
+  /** If positive, the expectations are taken over the points within
+   * SigmaCutoff sigmas instead of the KNeighborhood closest ones.  Default
+   * is 0. */
+  void SetSigmaCutoff( float f )
+  {
+    this->m_SigmaCutoff = f;
+  }
+  float GetSigmaCutoff()
+  {
+    return this->m_SigmaCutoff;
+  }
+
   void SetUseSymmetricMatching(unsigned int b)
   {
     this->m_UseSymmetricMatching = b;
@@ -266,7 +284,8 @@ protected:
     double m_SumOfSquaredChange;
     };
 
-  void SetUpKDTrees(long whichlabel);
+  /** Update the point grids of all the labels. */
+  void SetUpPointGrids();
 
 private:
   ExpectationBasedPointSetRegistrationFunction(const Self &); // purposely not implemented
@@ -317,11 +336,38 @@ private:
   unsigned int m_BucketSize;
   RealType     m_Sigma;
 
-  typename TreeGeneratorType::Pointer                        m_FixedKdTreeGenerator;
-  typename SampleType::Pointer                               m_FixedSamplePoints;
-  typename TreeGeneratorType::Pointer                        m_MovingKdTreeGenerator;
-  typename SampleType::Pointer                               m_MovingSamplePoints;
+  float        m_SigmaCutoff;
+
+  /** The fixed and moving points of a label. */
+  struct LabelPointsStruct
+    {
+    PointGridType FixedPoints;
+    PointGridType MovingPoints;
+    };
+  typedef std::map<PointDataType, LabelPointsStruct> LabelPointsMapType;
+
+  LabelPointsMapType                                         m_LabelPoints;
   typename RandomizerType::Pointer                           m_Randomizer;
+
+  /** Expectation of each point of Points over its neighbors in Neighbors,
+   * as a displacement from the point. */
+  struct ExpectationThreadStruct
+    {
+    const Self              *Function;
+    const PointGridType     *Points;
+    const PointGridType     *Neighbors;
+    double                   Sigma;
+    unsigned int             KNeighbors;
+    std::vector<VectorType>  Displacements;
+    std::vector<IndexType>   Indices;
+    std::vector<char>        IsValid;
+    };
+
+  static ITK_THREAD_RETURN_TYPE ExpectationThreaderCallback( void *arg );
+
+  void ThreadedComputeExpectations( ExpectationThreadStruct *str,
+    unsigned int threadId, unsigned int numberOfThreads ) const;
+
   bool         m_Normalize;
   LabelSetType m_LabelSet;
   unsigned int m_UseSymmetricMatching;
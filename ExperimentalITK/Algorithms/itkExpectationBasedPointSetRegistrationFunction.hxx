@@ -60,6 +60,7 @@ ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplac
   m_RMSChange = NumericTraits<double>::max();
   m_SumOfSquaredChange = 0.0;
   this->m_KNeighborhood = 100;
+  this->m_SigmaCutoff = 0.0;
 
   m_MovingImageGradientCalculator = MovingImageGradientCalculatorType::New();
   m_UseMovingImageGradient = false;
@@ -472,6 +473,8 @@ ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplac
   this->m_bweights->Initialize();
   this->m_bcount = 0;
 
+  this->SetUpPointGrids();
+
   unsigned int lct = 0;
   typename LabelSetType::const_iterator it;
   for( it = this->m_LabelSet.begin(); it != this->m_LabelSet.end(); ++it )
@@ -479,7 +482,6 @@ ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplac
     lct++;
     PointDataType label = (PointDataType) * it;
 //     std::cout << " doing label " << label << std::endl;
-    this->SetUpKDTrees(label);
     bool dobsp = false;
 //    if (lct ==  this->m_LabelSet.size()  ) dobsp=true;
     this->FastExpectationLandmarkField(1.0, true, label, dobsp);
@@ -556,62 +558,168 @@ ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplac
 
 template <class TFixedImage, class TMovingImage, class TDisplacementField, class TPointSet>
 void
-ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplacementField, TPointSet>::SetUpKDTrees(
-  long whichlabel)
+ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplacementField, TPointSet>
+::SetUpPointGrids()
 {
-  // convert this->m_FixedPointSet to a sample type
-  this->m_FixedSamplePoints = SampleType::New();
-  this->m_FixedSamplePoints->SetMeasurementVectorSize( MeasurementDimension );
-  MeasurementVectorType mv;
-  unsigned int          bucketsize = 4;
-  unsigned int          npts = this->m_FixedPointSet->GetNumberOfPoints();
-//  std::cout << " NP MOV " << npts << std::endl;
-  for( unsigned int i = 0; i < npts; i++ )
+  typedef typename PointGridType::CoordinateContainerType CoordinateContainerType;
+  typedef std::map<PointDataType, CoordinateContainerType> CoordinateMapType;
+
+  // Split both point sets by label in one pass each.
+  CoordinateMapType fixedCoordinates;
+  CoordinateMapType movingCoordinates;
+  typename LabelSetType::const_iterator it;
+  for( it = this->m_LabelSet.begin(); it != this->m_LabelSet.end(); ++it )
+    {
+    fixedCoordinates[*it].clear();
+    movingCoordinates[*it].clear();
+    }
+
+  unsigned long npts = this->m_FixedPointSet->GetNumberOfPoints();
+  for( unsigned long i = 0; i < npts; i++ )
     {
     PointType fixedpoint;
     this->m_FixedPointSet->GetPoint(i, &fixedpoint);
     PointDataType fixedlabel = 0;
     this->m_FixedPointSet->GetPointData(i, &fixedlabel);
-    for( unsigned int d = 0; d < ImageDimension; d++ )
-      {
-      mv[d] = fixedpoint[d];
-      }
-    // mv[ImageDimension]=(float) fixedlabel*1.e6;
-    if( fixedlabel == whichlabel )
+    typename CoordinateMapType::iterator cit = fixedCoordinates.find( fixedlabel );
+    if( cit != fixedCoordinates.end() )
       {
-      this->m_FixedSamplePoints->PushBack( mv );
+      for( unsigned int d = 0; d < MeasurementDimension; d++ )
+        {
+        cit->second.push_back( fixedpoint[d] );
+        }
       }
     }
-  this->m_FixedKdTreeGenerator = TreeGeneratorType::New();
-  this->m_FixedKdTreeGenerator->SetSample( this->m_FixedSamplePoints );
-  this->m_FixedKdTreeGenerator->SetBucketSize( bucketsize );
-  this->m_FixedKdTreeGenerator->Update();
 
-  this->m_MovingSamplePoints = SampleType::New();
-  this->m_MovingSamplePoints->SetMeasurementVectorSize( ImageDimension );
   npts = this->m_MovingPointSet->GetNumberOfPoints();
-//  std::cout << " NP MOV " << npts << std::endl;
-  for( unsigned int i = 0; i < npts; i++ )
+  for( unsigned long i = 0; i < npts; i++ )
     {
     PointType movingpoint;
     this->m_MovingPointSet->GetPoint(i, &movingpoint);
     PointDataType movinglabel = 0;
     this->m_MovingPointSet->GetPointData(i, &movinglabel);
-    for( unsigned int d = 0; d < ImageDimension; d++ )
+    typename CoordinateMapType::iterator cit = movingCoordinates.find( movinglabel );
+    if( cit != movingCoordinates.end() )
+      {
+      for( unsigned int d = 0; d < MeasurementDimension; d++ )
+        {
+        cit->second.push_back( movingpoint[d] );
+        }
+      }
+    }
+
+  // Only the grids whose points have moved since the last iteration are
+  // rebuilt; usually the fixed ones are kept.
+  for( it = this->m_LabelSet.begin(); it != this->m_LabelSet.end(); ++it )
+    {
+    LabelPointsStruct & points = this->m_LabelPoints[*it];
+    if( fixedCoordinates[*it] != points.FixedPoints.GetCoordinates() )
       {
-      mv[d] = movingpoint[d];
+      points.FixedPoints.Initialize( fixedCoordinates[*it] );
       }
-    // mv[ImageDimension]=(float) movinglabel*1.e6;
-    if( movinglabel == whichlabel )
+    if( movingCoordinates[*it] != points.MovingPoints.GetCoordinates() )
       {
-      this->m_MovingSamplePoints->PushBack( mv );
+      points.MovingPoints.Initialize( movingCoordinates[*it] );
       }
     }
-  this->m_MovingKdTreeGenerator = TreeGeneratorType::New();
-  this->m_MovingKdTreeGenerator->SetSample( this->m_MovingSamplePoints );
-  this->m_MovingKdTreeGenerator->SetBucketSize( bucketsize );
-  this->m_MovingKdTreeGenerator->Update();
+}
 
+template <class TFixedImage, class TMovingImage, class TDisplacementField, class TPointSet>
+ITK_THREAD_RETURN_TYPE
+ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplacementField, TPointSet>
+::ExpectationThreaderCallback( void *arg )
+{
+  unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ExpectationThreadStruct *str = (ExpectationThreadStruct *)
+    ( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  str->Function->ThreadedComputeExpectations( str, threadId, threadCount );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TFixedImage, class TMovingImage, class TDisplacementField, class TPointSet>
+void
+ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplacementField, TPointSet>
+::ThreadedComputeExpectations( ExpectationThreadStruct *str,
+  unsigned int threadId, unsigned int numberOfThreads ) const
+{
+  const unsigned long numberOfPoints = str->Points->GetNumberOfPoints();
+  const unsigned long begin = numberOfPoints * threadId / numberOfThreads;
+  const unsigned long end = numberOfPoints * ( threadId + 1 ) / numberOfThreads;
+
+  const double sigma = str->Sigma;
+  const double radius = this->m_SigmaCutoff * sigma;
+
+  typename PointGridType::IdentifierContainerType neighbors;
+  typename PointGridType::DistanceContainerType   squaredDistances;
+  std::vector<double>                             probabilities;
+
+  for( unsigned long ii = begin; ii < end; ii++ )
+    {
+    const double *fixedpoint = str->Points->GetPoint( ii );
+    ImagePointType fpt;
+    for( unsigned int j = 0; j < ImageDimension; j++ )
+      {
+      fpt[j] = fixedpoint[j];
+      }
+    if( !this->GetFixedImage()->TransformPhysicalPointToIndex( fpt, str->Indices[ii] ) )
+      {
+      continue;
+      }
+
+    if( radius > 0 )
+      {
+      str->Neighbors->FindPointsWithinRadius( fixedpoint, radius, neighbors, squaredDistances );
+      if( neighbors.empty() )
+        {
+        continue;
+        }
+      }
+    else
+      {
+      str->Neighbors->FindNearestPoints( fixedpoint, str->KNeighbors, neighbors, squaredDistances );
+      }
+
+    double probtotal = 0.0;
+    probabilities.resize( neighbors.size() );
+    for( unsigned int dd = 0; dd < neighbors.size(); dd++ )
+      {
+      double prob = 1.0 / sqrt(3.14186 * 2.0 * sigma * sigma)
+        * exp(-1.0 * squaredDistances[dd] / (2.0 * sigma * sigma) );
+      probtotal += prob;
+      probabilities[dd] = prob;
+      }
+
+    double mpt[ImageDimension];
+    for( unsigned int j = 0; j < ImageDimension; j++ )
+      {
+      mpt[j] = 0.0;
+      }
+    if( probtotal > 0 )
+      {
+      for( unsigned int dd = 0; dd < neighbors.size(); dd++ )
+        {
+        double pp = probabilities[dd] / probtotal;
+        if( pp > 0 )
+          {
+          const double *npt = str->Neighbors->GetPoint( neighbors[dd] );
+          for( unsigned int j = 0; j < ImageDimension; j++ )
+            {
+            mpt[j] += pp * npt[j];
+            }
+          }
+        }
+      }
+
+    for( unsigned int j = 0; j < ImageDimension; j++ )
+      {
+      str->Displacements[ii][j] = mpt[j] - fixedpoint[j];
+      }
+    str->IsValid[ii] = true;
+    }
 }
 
 /*
@@ -620,7 +728,7 @@ ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplac
 template <class TFixedImage, class TMovingImage, class TDisplacementField, class TPointSet>
 void
 ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplacementField, TPointSet>
-::FastExpectationLandmarkField(float weight, bool whichdirection, long /* whichlabel */, bool dobspline)
+::FastExpectationLandmarkField(float weight, bool whichdirection, long whichlabel, bool dobspline)
 {
   /**
 * BSpline typedefs
@@ -637,21 +745,25 @@ ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplac
   typedef ImageRegionIteratorWithIndex<DisplacementFieldType> Iterator;
   SpacingType spacing = this->GetFixedImage()->GetSpacing();
 
-  typename TreeGeneratorType::Pointer fkdtree;
-  typename TreeGeneratorType::Pointer mkdtree;
-  if( whichdirection )
+  typename LabelPointsMapType::const_iterator labelIt =
+    this->m_LabelPoints.find( static_cast<PointDataType>( whichlabel ) );
+  if( labelIt == this->m_LabelPoints.end() )
     {
-    mkdtree = this->m_MovingKdTreeGenerator;
-    fkdtree = this->m_FixedKdTreeGenerator;
+    return;
     }
-  else
+
+  const PointGridType *fgrid = &labelIt->second.FixedPoints;
+  const PointGridType *mgrid = &labelIt->second.MovingPoints;
+  float sigma = this->m_FixedPointSetSigma;
+  if( !whichdirection )
     {
-    fkdtree = this->m_MovingKdTreeGenerator;
-    mkdtree = this->m_FixedKdTreeGenerator;
+    fgrid = &labelIt->second.MovingPoints;
+    mgrid = &labelIt->second.FixedPoints;
+    sigma = this->m_MovingPointSetSigma;
     }
 
-  unsigned long sz1 = fkdtree->GetOutput()->Size();
-  unsigned long sz2 = mkdtree->GetOutput()->Size();
+  unsigned long sz1 = fgrid->GetNumberOfPoints();
+  unsigned long sz2 = mgrid->GetNumberOfPoints();
 
 //  std::cout << " s1 " << sz1 << " s2 " << sz2 << std::endl;
 
@@ -675,90 +787,46 @@ ExpectationBasedPointSetRegistrationFunction<TFixedImage, TMovingImage, TDisplac
   this->m_LandmarkEnergy = 0.0;
 //  float max=0;
 
-  vnl_vector<double> probabilities(KNeighbors);
-  probabilities.fill(0);
+  // The expectations are independent and computed in parallel; the forces
+  // are then added to the field in point order since several points can
+  // fall in the same voxel.
+  ExpectationThreadStruct str;
+  str.Function = this;
+  str.Points = fgrid;
+  str.Neighbors = mgrid;
+  str.Sigma = sigma;
+  str.KNeighbors = KNeighbors;
+  str.Displacements.resize( sz1 );
+  str.Indices.resize( sz1 );
+  str.IsValid.assign( sz1, false );
+
+  // Less than 64 points are not worth a thread.
+  MultiThreader::Pointer threader = MultiThreader::New();
+  if( static_cast<unsigned long>( threader->GetNumberOfThreads() ) > sz1 / 64 + 1 )
+    {
+    threader->SetNumberOfThreads( sz1 / 64 + 1 );
+    }
+  threader->SetSingleMethod( ExpectationThreaderCallback, &str );
+  threader->SingleMethodExecute();
 
   float energy = 0, maxerr = 0;
   for( unsigned long ii = 0; ii < sz1; ii++ )
     {
-    VectorType distance;
-    distance.Fill(0);
-    MeasurementVectorType fixedpoint = fkdtree->GetOutput()->GetMeasurementVector(ii);
-    ImagePointType        mpt;
-    mpt.Fill(0);
-    ImagePointType fpt;
-    fpt.Fill(0);
-    for( int j = 0; j < ImageDimension; j++ )
-      {
-      fpt[j] = fixedpoint[j];
-      }
-//    float err=0;
-    bool      convok = false;
-    IndexType fixedindex;
-    convok = this->GetFixedImage()->TransformPhysicalPointToIndex(fpt, fixedindex);
-//    std::cout << " Orig " << this->GetFixedImage()->GetOrigin() << " ind " << fixedindex << " pt " << fpt <<
-// std::endl;
-    if( convok )
+    if( str.IsValid[ii] )
       {
-      VectorType force;
-      force.Fill(0);
-      typename TreeGeneratorType::KdTreeType::InstanceIdentifierVectorType neighbors;
-      mkdtree->GetOutput()->Search( fixedpoint, static_cast<unsigned int>( KNeighbors ), neighbors );
-      double probtotal = 0.0;
-      for( unsigned int dd = 0;   dd < KNeighbors; dd++ )
-        {
-        PointType             movingpoint;
-        unsigned long         wpt = neighbors[dd];
-        MeasurementVectorType npt = mkdtree->GetOutput()->GetMeasurementVector(wpt);
-        float                 _mag = 0;
-        for( unsigned int qq = 0; qq < ImageDimension; qq++ )
-          {
-          _mag += (fixedpoint[qq] - npt[qq]) * (fixedpoint[qq] - npt[qq]);
-          }
-        float sigma = this->m_FixedPointSetSigma;
-        if( !whichdirection )
-          {
-          sigma = this->m_MovingPointSetSigma;
-          }
-        double prob = 1.0 / sqrt(3.14186 * 2.0 * sigma * sigma) * exp(-1.0 * _mag / (2.0 * sigma * sigma) );
-        probtotal += prob;
-        probabilities(dd) = prob;
-        }
-      if( probtotal  > 0 )
-        {
-        for( unsigned int dd = 0;   dd < KNeighbors; dd++ )
-          {
-          PointType             movingpoint;
-          unsigned long         wpt = neighbors[dd];
-          MeasurementVectorType npt = mkdtree->GetOutput()->GetMeasurementVector(wpt);
-          double                pp = probabilities(dd) / probtotal;
-          if( pp > 0 )
-            {
-            for( int j = 0; j < ImageDimension; j++ )
-              {
-              mpt[j] += pp * npt[j];
-              }
-            }
-          //
-//    if (ii % 245 && pp > 1.e-3) std::cout << " prob " << pp <<  " mpt " << mpt << " dd " << dd <<" wpt " << wpt << "
-// movinpoint " << movingpoint << " ptot " << probtotal <<  std::endl;
-          }
-        }
+      const double *fixedpoint = fgrid->GetPoint( ii );
+      const VectorType & distance = str.Displacements[ii];
+      const IndexType & fixedindex = str.Indices[ii];
 
+      VectorType force;
       float mag = 0.0;
       typename BSplinePointSetType::PointType bpoint;
       for( int j = 0; j < ImageDimension; j++ )
         {
-        distance[j] = mpt[j] - fixedpoint[j];
         mag += distance[j] / spacing[j] * distance[j] / spacing[j];
         force[j] = distance[j] * inweight;
         bpoint[j] = fixedpoint[j];
         }
-      float sigma = this->m_FixedPointSetSigma;
-      if( !whichdirection )
-        {
-        sigma = this->m_MovingPointSetSigma;
-        }
       double prob = 1.0 / sqrt(3.14186 * 2.0 * sigma * sigma) * exp(-1.0 * mag / (2.0 * sigma * sigma) );
       force = force * prob;
 
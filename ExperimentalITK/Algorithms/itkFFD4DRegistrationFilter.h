@@ -340,6 +340,8 @@ private :
   typename ImageType::Pointer EvaluateImageAtPyramidLevel( unsigned int ); 
   typename DeformationFieldType::Pointer EvaluateFieldFromControlPointsAtTimePoint
     ( typename ControlPointLatticeType::Pointer, RealType, bool );
+  std::vector<typename DeformationFieldType::Pointer> EvaluateFieldsFromControlPointsAtTimePoints
+    ( typename ControlPointLatticeType::Pointer, const std::vector<RealType> & );
   void InitializeDeformationFieldWithLandmarks();
 //  void InitializeDeformationFieldWithDeformationFields();
 
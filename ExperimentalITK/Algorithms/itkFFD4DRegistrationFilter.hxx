@@ -35,6 +35,7 @@ PURPOSE.  See the above copyright notices for more information.
 #include "itkImageRegionIteratorWithIndex.h"
 #include "itkMeanSquareRegistrationFunction.h"
 #include "itkMultiplyImageFilter.h"
+#include "itkTimeVaryingBSplineDeformationFieldSource.h"
 #include "itkVectorImageFileReader.h"
 #include "itkVectorLinearInterpolateImageFunction.h"
 #include "itkVectorFieldGradientImageFunction.h"
@@ -894,12 +895,18 @@ FFD4DRegistrationFilter<TImage, TWarpedImage>
 {  
   itkDebugMacro( "Evaluating deformation field at time point " << t );
 
+  if ( !refineLattice )
+    {
+    std::vector<RealType> timePoints( 1, t );
+    return this->EvaluateFieldsFromControlPointsAtTimePoints
+      ( phiLattice, timePoints )[0];
+    }
+
   typedef BSplineControlPointImageFilter
     <ControlPointLatticeType, TimeDependentFieldType> BSplineControlPointsFilterType;
   typename BSplineControlPointsFilterType::Pointer bspliner = BSplineControlPointsFilterType::New();
   typename BSplineControlPointsFilterType::ArrayType close;
   typename BSplineControlPointsFilterType::ArrayType nlevels;
-  typename BSplineFilterType::ArrayType order;
 
   typename TimeDependentFieldType::PointType origin;
   typename TimeDependentFieldType::SpacingType spacing;
@@ -927,8 +934,6 @@ FFD4DRegistrationFilter<TImage, TWarpedImage>
   size[ImageDimension] = this->m_TimePoints.size() + 1;        
   close.Fill( false );
   close[ImageDimension] = this->m_WrapTime;
-  order.Fill( this->m_SplineOrder );
-  order[ImageDimension] = this->m_TemporalSplineOrder;
 
   bspliner->SetSplineOrder( this->m_SplineOrder );
   bspliner->SetCloseDimension( close );
@@ -938,47 +943,58 @@ FFD4DRegistrationFilter<TImage, TWarpedImage>
   bspliner->SetSize( size );
   bspliner->Update();
 
-  if ( refineLattice )
+  nlevels.Fill( 2 );  
+  this->m_TotalDeformationFieldControlPoints = bspliner->RefineControlLattice( nlevels );
+  return NULL;
+}
+
+template<class TImage, class TWarpedImage>
+std::vector<typename FFD4DRegistrationFilter<TImage, TWarpedImage>
+::DeformationFieldType::Pointer>
+FFD4DRegistrationFilter<TImage, TWarpedImage>
+::EvaluateFieldsFromControlPointsAtTimePoints
+  ( typename ControlPointLatticeType::Pointer phiLattice, 
+    const std::vector<RealType> &timePoints )
+{  
+  std::vector<typename DeformationFieldType::Pointer> fields;
+  if ( timePoints.empty() )
     {
-    nlevels.Fill( 2 );  
-    this->m_TotalDeformationFieldControlPoints = bspliner->RefineControlLattice( nlevels );
-    return NULL;
-    }  
-  else
+    return fields;
+    }
+
+  typedef TimeVaryingBSplineDeformationFieldSource
+    <ControlPointLatticeType, DeformationFieldType> FieldSourceType;
+  typename FieldSourceType::Pointer fieldSource = FieldSourceType::New();
+
+  if ( this->m_NumberOfLevels > 0 )
     {
-    typename BSplineControlPointsFilterType::PointType P;
- 
-    /** Fix this part and bspliner->'( P ) */
-    P.Fill( 1e10 );
-    P[ImageDimension] = ( t - this->m_TemporalOrigin ) / 
-      ( this->m_TemporalEnd - this->m_TemporalOrigin );
-
-    typename TimeDependentFieldType::Pointer timeField = 
-      TimeDependentFieldType::New();
-    timeField = bspliner->GenerateOutputImageAt( P );
-
-    typedef ExtractImageFilter<TimeDependentFieldType, DeformationFieldType> ExtracterType;
-    typename ExtracterType::Pointer extracter = ExtracterType::New();
-    extracter->SetInput( timeField );
-
-    typename ExtracterType::InputImageRegionType region;
-    typename ExtracterType::InputImageSizeType regionSize;
-    typename ExtracterType::InputImageIndexType regionIndex;
-   
-    for ( unsigned int d = 0; d < ImageDimension; d++ )
-      {
-      regionSize[d] = timeField->GetLargestPossibleRegion().GetSize()[d];
-      regionIndex[d] = timeField->GetLargestPossibleRegion().GetIndex()[d];
-      }
-    regionSize[ImageDimension] = 0;
-    regionIndex[ImageDimension] = 0;  
-    region.SetSize( regionSize );
-    region.SetIndex( regionIndex );
-
-    extracter->SetExtractionRegion( region );
-    extracter->Update();
-    return extracter->GetOutput();
-    } 
+    fieldSource->SetOrigin( this->m_ReferenceImage->GetOrigin() );
+    fieldSource->SetSpacing( this->m_ReferenceImage->GetSpacing() );
+    fieldSource->SetSize( this->m_ReferenceImage->GetLargestPossibleRegion().GetSize() );
+    }   
+  else   
+    {
+    fieldSource->SetOrigin( this->GetInput()->GetOrigin() );
+    fieldSource->SetSpacing( this->GetInput()->GetSpacing() );
+    fieldSource->SetSize( this->GetInput()->GetLargestPossibleRegion().GetSize() );
+    }   
+  fieldSource->SetControlPointLattice( phiLattice );
+  fieldSource->SetSplineOrder( this->m_SplineOrder );
+  fieldSource->SetTemporalSplineOrder( this->m_TemporalSplineOrder );
+  fieldSource->SetWrapTime( this->m_WrapTime );
+  fieldSource->SetTemporalOrigin( this->m_TemporalOrigin );
+  fieldSource->SetTemporalEnd( this->m_TemporalEnd );
+  fieldSource->SetTimePoints( typename FieldSourceType::TimePointContainerType
+    ( timePoints.begin(), timePoints.end() ) );
+  fieldSource->Update();
+
+  for ( unsigned int i = 0; i < timePoints.size(); i++ )
+    {
+    typename DeformationFieldType::Pointer field = fieldSource->GetOutput( i );
+    field->DisconnectPipeline();
+    fields.push_back( field );
+    }
+  return fields;
 }
 
 template<class TImage, class TWarpedImage>
@@ -22,11 +22,12 @@
 #include "itkIndex.h"
 #include "itkLevelSet.h"
 #include "itkNeighborhoodIterator.h"
+#include "itkRadixHeap.h"
 
 #include "vnl/vnl_math.h"
 
 #include <functional>
-#include <queue>
+#include <vector>
 
 namespace itk
 {
@@ -41,8 +42,10 @@ namespace itk
  *
  * Updates are preformed using an entropy satisfy scheme where only
  * "upwind" neighborhoods are used. This implementation of Fast Marching
- * uses a std::priority_queue to locate the next proper grid position to
- * update.
+ * uses a radix heap (see RadixHeap) to locate the next proper grid position
+ * to update: the arrival times are accepted in non-decreasing order, so
+ * insertions are O(1) and the trial points are only partially sorted as
+ * they are popped.
  *
  * Fast Marching sweeps through N grid points in (N log N) steps to obtain
  * the arrival time value as the front propagates through the grid.
@@ -86,17 +89,17 @@ namespace itk
  * and SetOutputOrigin(). Else if the speed image is not NULL, the output information
  * is copied from the input speed image.
  *
- * Possible Improvements:
- * In the current implemenation, std::priority_queue only allows
- * taking nodes out from the front and putting nodes in from the back.
  * To update a value already on the heap, a new node is added to the heap.
  * The defunct old node is left on the heap. When it is removed from the
- * top, it will be recognized as invalid and not used.
- * Future implementations can implement the heap in a different way
- * allowing the values to be updated. This will generally require
- * some sift-up and sift-down functions and
- * an image of back-pointers going from the image to heap in order
- * to locate the node which is to be updated.
+ * top, it will be recognized as invalid and not used.  The heap keys are
+ * single precision, so arrival times closer than the float resolution may
+ * be accepted in either order.
+ *
+ * With a topology check, the alive neighbours of each pixel are kept as a
+ * bit code that is updated when a pixel becomes alive.  The simple point
+ * and well-composedness tests of a trial point are then functions of its
+ * code, and their results are cached in look-up tables filled on first
+ * use.
  *
  * \sa LevelSetTypeDefault
  * \ingroup LevelSetSegmentation
@@ -389,15 +392,20 @@ private:
   typename LevelSetImageType::PixelType         m_LargeValue;
   AxisNodeType                                  m_NodesUsed[SetDimension];
 
-  /** Trial points are stored in a min-heap. This allow efficient access
-   * to the trial point with minimum value which is the next grid point
-   * the algorithm processes. */
-  typedef std::vector<AxisNodeType>  HeapContainer;
-  typedef std::greater<AxisNodeType> NodeComparer;
-  typedef std::priority_queue< AxisNodeType, HeapContainer, NodeComparer >
-                                     HeapType;
+  /** Trial points are stored in a monotone min-heap. This allow efficient
+   * access to the trial point with minimum value which is the next grid
+   * point the algorithm processes.  The keys are the values minus the
+   * smallest initial value, which keeps them non-negative. */
+  typedef RadixHeap<AxisNodeType>    HeapType;
 
   HeapType    m_TrialHeap;
+  double      m_HeapKeyOffset;
+
+  void PushTrialNode( const AxisNodeType & node )
+    {
+    this->m_TrialHeap.Push( static_cast<typename HeapType::KeyType>(
+      static_cast<double>( node.GetValue() ) - this->m_HeapKeyOffset ), node );
+    }
 
   double    m_NormalizationFactor;
 
@@ -408,9 +416,36 @@ private:
   bool                                          m_UseWellComposedness;
   unsigned int                                  m_SimplePointConnectivity;
 
+  /** Alive neighbours of each pixel: bit b of the code is set if the b-th
+   * pixel of its 3^SetDimension neighborhood (neighborhood iterator order,
+   * center skipped) is alive. */
+  typedef Image<unsigned int, itkGetStaticConstMacro( SetDimension )>
+    NeighborhoodCodeImageType;
+
+  typename NeighborhoodCodeImageType::Pointer   m_NeighborhoodCodeImage;
+  std::vector<typename LabelImageType::OffsetType>
+                                                m_NeighborhoodOffsets;
+  unsigned int                                  m_NeighborhoodCenter;
+
+  /** Look-up tables indexed by the code, two bits per entry (known,
+   * value), filled on first use. */
+  std::vector<unsigned char>                    m_SimplePointTable;
+  std::vector<unsigned char>                    m_WellComposedTable;
+
+  void SetAlivePoint( const IndexType & );
+  unsigned int GetNeighborhoodCode( const IndexType & ) const;
+  bool IsNeighborAlive( unsigned int code, unsigned int n ) const
+    {
+    return ( n != this->m_NeighborhoodCenter &&
+      ( code >> ( n < this->m_NeighborhoodCenter ? n : n - 1 ) ) & 1 );
+    }
+  void GetTopologicalNeighborhood( unsigned int,
+                                   unsigned char[3][3][3] ) const;
+  bool IsSimplePoint( unsigned int );
+
   // Functions/data for the 2-D case
   void InitializeIndices2D();
-  bool IsChangeWellComposed2D( IndexType );
+  bool IsChangeWellComposed2D( unsigned int );
   bool IsCriticalC1Configuration2D( Array<short> );
   bool IsCriticalC2Configuration2D( Array<short> );
   bool IsCriticalC3Configuration2D( Array<short> );
@@ -425,14 +460,14 @@ private:
   void InitializeIndices3D();
   bool IsCriticalC1Configuration3D( Array<short> );
   unsigned int IsCriticalC2Configuration3D( Array<short> );
-  bool IsChangeWellComposed3D( IndexType );
+  bool IsChangeWellComposed3D( unsigned int );
 
   Array<unsigned int>                        m_C1Indices[12];
   Array<unsigned int>                        m_C2Indices[8];
 
   // Functions for both 2D/3D cases
-  bool DoesVoxelChangeViolateWellComposedness( IndexType );
-  bool DoesVoxelChangeViolateStrictTopology( IndexType );
+  bool DoesVoxelChangeViolateWellComposedness( unsigned int );
+  bool DoesVoxelChangeViolateStrictTopology( unsigned int );
 
 };
 
@@ -37,6 +37,9 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
 ::FastMarchingImageFilter()
   : m_TrialHeap( )
 {
+  this->m_HeapKeyOffset = 0.0;
+  this->m_NeighborhoodCenter = 0;
+
   this->ProcessObject::SetNumberOfRequiredInputs(0);
 
   OutputSizeType outputSize;
@@ -195,6 +198,64 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
     this->m_ConnectedComponentImage->FillBuffer( 0 );
     }
 
+  // initialize indices, the neighborhood codes and the look-up tables if
+  // this->m_TopologyCheck is activated
+  this->m_NeighborhoodCodeImage = NULL;
+  this->m_SimplePointTable.clear();
+  this->m_WellComposedTable.clear();
+  if( this->m_TopologyCheck != None )
+    {
+    if( SetDimension == 2 )
+      {
+      this->InitializeIndices2D();
+      }
+    else if( SetDimension == 3 )
+      {
+      this->InitializeIndices3D();
+      }
+    else
+      {
+      itkExceptionMacro(
+        "Topology checking is only valid for level set dimensions of 2 and 3" );
+      }
+
+    unsigned int numberOfNeighbors = 1;
+    for( unsigned int d = 0; d < SetDimension; d++ )
+      {
+      numberOfNeighbors *= 3;
+      }
+    this->m_NeighborhoodCenter = numberOfNeighbors / 2;
+    this->m_NeighborhoodOffsets.resize( numberOfNeighbors );
+    for( unsigned int n = 0; n < numberOfNeighbors; n++ )
+      {
+      unsigned int m = n;
+      for( unsigned int d = 0; d < SetDimension; d++ )
+        {
+        this->m_NeighborhoodOffsets[n][d] = static_cast<long>( m % 3 ) - 1;
+        m /= 3;
+        }
+      }
+
+    this->m_NeighborhoodCodeImage = NeighborhoodCodeImageType::New();
+    this->m_NeighborhoodCodeImage->CopyInformation( output );
+    this->m_NeighborhoodCodeImage->SetRegions( output->GetBufferedRegion() );
+    this->m_NeighborhoodCodeImage->Allocate();
+    this->m_NeighborhoodCodeImage->FillBuffer( 0 );
+
+    // One code per configuration of the 3^SetDimension-1 neighbors, four
+    // entries per byte.
+    const unsigned long numberOfTableBytes =
+      vnl_math_max( 1UL, ( 1UL << ( numberOfNeighbors - 1 ) ) / 4 );
+    if( this->m_UseWellComposedness )
+      {
+      this->m_WellComposedTable.assign( numberOfTableBytes, 0 );
+      }
+    else
+      {
+      this->m_SimplePointTable.assign( numberOfTableBytes, 0 );
+      }
+    }
+
   // set all output value to infinity
   typedef ImageRegionIterator<LevelSetImageType>
     OutputIterator;
@@ -221,9 +282,34 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
     }
 
 
-  // process input alive points
+  // the heap keys are relative to the smallest initial value
   AxisNodeType node;
 
+  this->m_HeapKeyOffset = NumericTraits<double>::max();
+  const NodeContainer *initialPoints[2] =
+    { this->m_AlivePoints.GetPointer(), this->m_TrialPoints.GetPointer() };
+  for( unsigned int i = 0; i < 2; i++ )
+    {
+    if( initialPoints[i] )
+      {
+      typename NodeContainer::ConstIterator pointsIter = initialPoints[i]->Begin();
+      typename NodeContainer::ConstIterator pointsEnd = initialPoints[i]->End();
+      for (; pointsIter != pointsEnd; ++pointsIter )
+        {
+        if( this->m_BufferedRegion.IsInside( pointsIter.Value().GetIndex() ) )
+          {
+          this->m_HeapKeyOffset = vnl_math_min( this->m_HeapKeyOffset,
+            static_cast<double>( pointsIter.Value().GetValue() ) );
+          }
+        }
+      }
+    }
+  if( this->m_HeapKeyOffset == NumericTraits<double>::max() )
+    {
+    this->m_HeapKeyOffset = 0.0;
+    }
+
+  // process input alive points
   if ( this->m_AlivePoints )
     {
     typename NodeContainer::ConstIterator pointsIter = this->m_AlivePoints->Begin();
@@ -242,7 +328,7 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
         }
 
       // make this an alive point
-      this->m_LabelImage->SetPixel( node.GetIndex(), AlivePoint );
+      this->SetAlivePoint( node.GetIndex() );
 
       //
       if( this->m_TopologyCheck == NoHandles )
@@ -276,10 +362,7 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
     }
 
   // make sure the heap is empty
-  while ( !this->m_TrialHeap.empty() )
-    {
-    this->m_TrialHeap.pop();
-    }
+  this->m_TrialHeap.Clear();
 
   // process the input trial points
   if ( this->m_TrialPoints )
@@ -310,28 +393,10 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
       outputPixel = node.GetValue();
       output->SetPixel( node.GetIndex(), outputPixel );
 
-      this->m_TrialHeap.push( node );
+      this->PushTrialNode( node );
 
       }
     }
-
-  // initialize indices if this->m_TopologyCheck is activated
-  if( this->m_TopologyCheck != None )
-    {
-    if( SetDimension == 2 )
-      {
-      this->InitializeIndices2D();
-      }
-    else if( SetDimension == 3 )
-      {
-      this->InitializeIndices3D();
-      }
-    else
-      {
-      itkExceptionMacro(
-        "Topology checking is only valid for level set dimensions of 2 and 3" );
-      }
-    }
 }
 
 template <class TLevelSet, class TSpeedImage>
@@ -352,16 +417,16 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
 
   // process points on the heap
   AxisNodeType node;
+  typename HeapType::KeyType key;
   double currentValue;
   double oldProgress = 0;
 
   this->UpdateProgress( 0.0 ); // Send first progress event
 
-  while ( !this->m_TrialHeap.empty() )
+  while ( !this->m_TrialHeap.Empty() )
     {
     // get the node with the smallest value
-    node = this->m_TrialHeap.top();
-    this->m_TrialHeap.pop();
+    this->m_TrialHeap.Pop( key, node );
 
     // does this node contain the current value ?
     currentValue = (double) output->GetPixel( node.GetIndex() );
@@ -382,43 +447,14 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
       }
 
     // does the node break topology
+    unsigned int neighborhoodCode = 0;
+    if( this->m_TopologyCheck != None )
+      {
+      neighborhoodCode = this->GetNeighborhoodCode( node.GetIndex() );
+      }
     if( this->m_TopologyCheck != None && !this->m_UseWellComposedness )
       {
-      NBH neighborhood;
-      typename NeighborhoodIteratorType::RadiusType radius;
-      radius.Fill( 1 );
-      NeighborhoodIteratorType ItL( radius, this->m_LabelImage,
-        this->m_LabelImage->GetBufferedRegion() );
-      ItL.SetLocation( node.GetIndex() );
-      if( SetDimension == 2 )
-        {
-        for( unsigned int i = 0; i < 3; i++ )
-          {
-          for( unsigned int j = 0; j < 3; j++ )
-            {
-            neighborhood[i][0][j] = neighborhood[i][2][j] = 0;
-            neighborhood[i][1][j] = static_cast<unsigned char>(
-              ItL.GetPixel( 3*i+j ) == AlivePoint );
-            }
-          }
-        }
-      else if( SetDimension == 3 )
-        {
-        for( unsigned int i = 0; i < 3; i++ )
-          {
-          for( unsigned int j = 0; j < 3; j++ )
-            {
-            for( unsigned int k = 0; k < 3; k++ )
-              {
-              neighborhood[i][j][k] = static_cast<unsigned char>(
-                ItL.GetPixel( 9*i + 3*j + k ) == AlivePoint );
-              }
-            }
-          }
-        }
-      bool isSimplePoint = checkSimple( &neighborhood,
-        this->m_SimplePointConnectivity );
-      if( !isSimplePoint )
+      if( !this->IsSimplePoint( neighborhoodCode ) )
         {
         if( this->m_TopologyCheck == Strict )
           {
@@ -428,6 +464,9 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
           }
         else if( this->m_TopologyCheck == NoHandles )
           {
+          NBH neighborhood;
+          this->GetTopologicalNeighborhood( neighborhoodCode, neighborhood );
+
           NBH dnbh;
           NBH neighborhoodInv;
           reverseNBH( &neighborhood, &neighborhoodInv );
@@ -437,6 +476,8 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
             associatedConnectivity( this->m_SimplePointConnectivity ) );
 
           // Get number of connected components
+          typename NeighborhoodIteratorType::RadiusType radius;
+          radius.Fill( 1 );
           NeighborhoodIterator<ConnectedComponentImageType> ItC(
             radius, this->m_ConnectedComponentImage,
             this->m_ConnectedComponentImage->GetBufferedRegion() );
@@ -487,9 +528,9 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
     else if( this->m_TopologyCheck != None && this->m_UseWellComposedness )
       {
       bool wellComposednessViolation
-        = this->DoesVoxelChangeViolateWellComposedness( node.GetIndex() );
+        = this->DoesVoxelChangeViolateWellComposedness( neighborhoodCode );
       bool strictTopologyViolation
-        = this->DoesVoxelChangeViolateStrictTopology( node.GetIndex() );
+        = this->DoesVoxelChangeViolateStrictTopology( neighborhoodCode );
       if( this->m_TopologyCheck == Strict && ( wellComposednessViolation
         || strictTopologyViolation ) )
         {
@@ -510,9 +551,6 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
 										// check for handles
 										typename NeighborhoodIteratorType::RadiusType radius;
 										radius.Fill( 1 );
-										NeighborhoodIteratorType ItL( radius, this->m_LabelImage,
-												this->m_LabelImage->GetBufferedRegion() );
-										ItL.SetLocation( node.GetIndex() );
 										NeighborhoodIterator<ConnectedComponentImageType> ItC(
 												radius, this->m_ConnectedComponentImage,
 												this->m_ConnectedComponentImage->GetBufferedRegion() );
@@ -525,9 +563,11 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
 
 										bool doesChangeCreateHandle = false;
 
-										for( unsigned int d = 0; d < SetDimension; d++ )
+										unsigned int stride = 1;
+										for( unsigned int d = 0; d < SetDimension; d++, stride *= 3 )
 												{
-												if( ItL.GetNext( d ) == AlivePoint && ItL.GetPrevious( d ) == AlivePoint )
+												if( this->IsNeighborAlive( neighborhoodCode, this->m_NeighborhoodCenter + stride )
+														&& this->IsNeighborAlive( neighborhoodCode, this->m_NeighborhoodCenter - stride ) )
 														{
 														if( ItC.GetNext( d ) == ItC.GetPrevious( d ) )
 																{
@@ -573,7 +613,7 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
       }
 
     // set this node as alive
-    this->m_LabelImage->SetPixel( node.GetIndex(), AlivePoint );
+    this->SetAlivePoint( node.GetIndex() );
 
 				// for topology handle checks, we need to update the connected
     // component image at the current node with the appropriate label.
@@ -794,57 +834,187 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
     this->m_LabelImage->SetPixel( index, TrialPoint );
     node.SetValue( static_cast<PixelType>( solution ) );
     node.SetIndex( index );
-    this->m_TrialHeap.push( node );
+    this->PushTrialNode( node );
     }
 
   return solution;
 }
 
 /**
- * Topology check functions
+ * Neighborhood codes
  */
 template <class TLevelSet, class TSpeedImage>
-bool
+void
 FastMarchingImageFilter<TLevelSet,TSpeedImage>
-::DoesVoxelChangeViolateWellComposedness( IndexType idx )
+::SetAlivePoint( const IndexType & index )
 {
-  bool isChangeWellComposed = false;
-  if( SetDimension == 2 )
+  this->m_LabelImage->SetPixel( index, AlivePoint );
+
+  if( this->m_NeighborhoodCodeImage.IsNull() )
     {
-    isChangeWellComposed = this->IsChangeWellComposed2D( idx );
+    return;
+    }
+
+  // index is neighbor 2c-n of its neighbor n
+  const unsigned int center = this->m_NeighborhoodCenter;
+  for( unsigned int n = 0; n < this->m_NeighborhoodOffsets.size(); n++ )
+    {
+    if( n == center )
+      {
+      continue;
+      }
+    IndexType neighIndex = index + this->m_NeighborhoodOffsets[n];
+    if( !this->m_BufferedRegion.IsInside( neighIndex ) )
+      {
+      continue;
+      }
+    const unsigned int m = 2 * center - n;
+    const unsigned int code = this->m_NeighborhoodCodeImage->GetPixel( neighIndex )
+      | ( 1u << ( m < center ? m : m - 1 ) );
+    this->m_NeighborhoodCodeImage->SetPixel( neighIndex, code );
+    }
+}
+
+template <class TLevelSet, class TSpeedImage>
+unsigned int
+FastMarchingImageFilter<TLevelSet,TSpeedImage>
+::GetNeighborhoodCode( const IndexType & index ) const
+{
+  bool isInterior = true;
+  for( unsigned int d = 0; d < SetDimension; d++ )
+    {
+    if( index[d] <= this->m_StartIndex[d] || index[d] >= this->m_LastIndex[d] )
+      {
+      isInterior = false;
+      break;
+      }
+    }
+  if( isInterior )
+    {
+    return this->m_NeighborhoodCodeImage->GetPixel( index );
+    }
+
+  // On the border the neighbors outside the image take the value of the
+  // nearest pixel inside (zero flux Neumann), as with a neighborhood
+  // iterator.
+  const unsigned int center = this->m_NeighborhoodCenter;
+  unsigned int code = 0;
+  for( unsigned int n = 0; n < this->m_NeighborhoodOffsets.size(); n++ )
+    {
+    if( n == center )
+      {
+      continue;
+      }
+    IndexType neighIndex = index + this->m_NeighborhoodOffsets[n];
+    for( unsigned int d = 0; d < SetDimension; d++ )
+      {
+      neighIndex[d] = vnl_math_max( this->m_StartIndex[d],
+        vnl_math_min( this->m_LastIndex[d], neighIndex[d] ) );
+      }
+    if( this->m_LabelImage->GetPixel( neighIndex ) == AlivePoint )
+      {
+      code |= ( 1u << ( n < center ? n : n - 1 ) );
+      }
     }
-  else  // SetDimension == 3
+  return code;
+}
+
+template <class TLevelSet, class TSpeedImage>
+void
+FastMarchingImageFilter<TLevelSet,TSpeedImage>
+::GetTopologicalNeighborhood( unsigned int code,
+  unsigned char neighborhood[3][3][3] ) const
+{
+  for( unsigned int i = 0; i < 3; i++ )
     {
-    isChangeWellComposed = this->IsChangeWellComposed3D( idx );
+    for( unsigned int j = 0; j < 3; j++ )
+      {
+      for( unsigned int k = 0; k < 3; k++ )
+        {
+        if( SetDimension == 2 )
+          {
+          neighborhood[i][j][k] = static_cast<unsigned char>( j == 1 &&
+            this->IsNeighborAlive( code, 3*i + k ) );
+          }
+        else
+          {
+          neighborhood[i][j][k] = static_cast<unsigned char>(
+            this->IsNeighborAlive( code, 9*i + 3*j + k ) );
+          }
+        }
+      }
     }
+}
 
-  return !isChangeWellComposed;
+/**
+ * Topology check functions.  The look-up table entries are two bits:
+ * bit 0 is set once the entry is known and bit 1 holds the result.
+ */
+template <class TLevelSet, class TSpeedImage>
+bool
+FastMarchingImageFilter<TLevelSet,TSpeedImage>
+::IsSimplePoint( unsigned int code )
+{
+  unsigned char & entry = this->m_SimplePointTable[code >> 2];
+  const unsigned int shift = 2 * ( code & 3 );
+  if( !( ( entry >> shift ) & 1 ) )
+    {
+    NBH neighborhood;
+    this->GetTopologicalNeighborhood( code, neighborhood );
+    const bool isSimplePoint = checkSimple( &neighborhood,
+      this->m_SimplePointConnectivity );
+    entry |= ( isSimplePoint ? 3 : 1 ) << shift;
+    }
+  return ( ( entry >> shift ) & 2 ) != 0;
 }
 
 template <class TLevelSet, class TSpeedImage>
 bool
 FastMarchingImageFilter<TLevelSet,TSpeedImage>
-::DoesVoxelChangeViolateStrictTopology( IndexType idx )
+::DoesVoxelChangeViolateWellComposedness( unsigned int code )
 {
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType It( radius, this->m_LabelImage,
-    this->m_LabelImage->GetBufferedRegion() );
-  It.SetLocation( idx );
+  unsigned char & entry = this->m_WellComposedTable[code >> 2];
+  const unsigned int shift = 2 * ( code & 3 );
+  if( !( ( entry >> shift ) & 1 ) )
+    {
+    bool isChangeWellComposed = false;
+    if( SetDimension == 2 )
+      {
+      isChangeWellComposed = this->IsChangeWellComposed2D( code );
+      }
+    else  // SetDimension == 3
+      {
+      isChangeWellComposed = this->IsChangeWellComposed3D( code );
+      }
+    entry |= ( isChangeWellComposed ? 3 : 1 ) << shift;
+    }
 
+  return !( ( entry >> shift ) & 2 );
+}
+
+template <class TLevelSet, class TSpeedImage>
+bool
+FastMarchingImageFilter<TLevelSet,TSpeedImage>
+::DoesVoxelChangeViolateStrictTopology( unsigned int code )
+{
   unsigned int numberOfCriticalC3Configurations = 0;
   unsigned int numberOfFaces = 0;
-  for( unsigned int d = 0; d < SetDimension; d++ )
+  unsigned int stride = 1;
+  for( unsigned int d = 0; d < SetDimension; d++, stride *= 3 )
     {
-    if( It.GetNext( d ) == AlivePoint )
+    const bool isNextAlive = this->IsNeighborAlive( code,
+      this->m_NeighborhoodCenter + stride );
+    const bool isPreviousAlive = this->IsNeighborAlive( code,
+      this->m_NeighborhoodCenter - stride );
+    if( isNextAlive )
       {
       numberOfFaces++;
       }
-    if( It.GetPrevious( d ) == AlivePoint )
+    if( isPreviousAlive )
       {
       numberOfFaces++;
       }
-    if( It.GetNext( d ) == AlivePoint && It.GetPrevious( d ) == AlivePoint )
+    if( isNextAlive && isPreviousAlive )
       {
       numberOfCriticalC3Configurations++;
       }
@@ -861,14 +1031,8 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
 template <class TLevelSet, class TSpeedImage>
 bool
 FastMarchingImageFilter<TLevelSet,TSpeedImage>
-::IsChangeWellComposed2D( IndexType idx )
+::IsChangeWellComposed2D( unsigned int code )
 {
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType It( radius, this->m_LabelImage,
-    this->m_LabelImage->GetBufferedRegion() );
-  It.SetLocation( idx );
-
   Array<short> neighborhoodPixels( 9 );
 
   // Check for critical configurations: 4 90-degree rotations
@@ -878,7 +1042,7 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
     for ( unsigned int j = 0; j < 9; j++ )
       {
       neighborhoodPixels[j] =
-        ( It.GetPixel( this->m_RotationIndices[i][j] ) != AlivePoint );
+        !this->IsNeighborAlive( code, this->m_RotationIndices[i][j] );
       if( this->m_RotationIndices[i][j] == 4 )
         {
         neighborhoodPixels[j] = !neighborhoodPixels[j];
@@ -904,7 +1068,7 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
     for ( unsigned int j = 0; j < 9; j++ )
       {
       neighborhoodPixels[j] =
-        ( It.GetPixel( this->m_ReflectionIndices[i][j] ) != AlivePoint );
+        !this->IsNeighborAlive( code, this->m_ReflectionIndices[i][j] );
       if( this->m_ReflectionIndices[i][j] == 4 )
         {
         neighborhoodPixels[j] = !neighborhoodPixels[j];
@@ -1045,23 +1209,17 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
 template <class TLevelSet, class TSpeedImage>
 bool
 FastMarchingImageFilter<TLevelSet,TSpeedImage>
-::IsChangeWellComposed3D( IndexType idx )
+::IsChangeWellComposed3D( unsigned int code )
 {
   Array<short> neighborhoodPixels( 8 );
 
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType It( radius, this->m_LabelImage,
-    this->m_LabelImage->GetRequestedRegion() );
-  It.SetLocation( idx );
-
   // Check for C1 critical configurations
   for ( unsigned int i = 0; i < 12; i++ )
     {
     for ( unsigned int j = 0; j < 4; j++ )
       {
       neighborhoodPixels[j]
-        = ( It.GetPixel( this->m_C1Indices[i][j] ) == AlivePoint );
+        = this->IsNeighborAlive( code, this->m_C1Indices[i][j] );
       if( this->m_C1Indices[i][j] == 13 )
         {
         neighborhoodPixels[j] = !neighborhoodPixels[j];
@@ -1079,7 +1237,7 @@ FastMarchingImageFilter<TLevelSet,TSpeedImage>
     for ( unsigned int j = 0; j < 8; j++ )
       {
       neighborhoodPixels[j]
-        = ( It.GetPixel( this->m_C2Indices[i][j] ) == AlivePoint );
+        = this->IsNeighborAlive( code, this->m_C2Indices[i][j] );
       if( this->m_C2Indices[i][j] == 13 )
         {
         neighborhoodPixels[j] = !neighborhoodPixels[j];
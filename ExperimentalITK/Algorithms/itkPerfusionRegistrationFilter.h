@@ -30,6 +30,7 @@
 #include "vnl/vnl_vector.h"
 
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -252,6 +253,18 @@ private :
   typename ImageType::Pointer EvaluateImageAtPyramidLevel( unsigned int );
   typename DeformationFieldType::Pointer EvaluateFieldFromControlPointsAtTimePoint
     ( typename ControlPointLatticeType::Pointer, unsigned int, bool );
+  std::vector<typename DeformationFieldType::Pointer> EvaluateFieldsFromControlPointsAtTimePoints
+    ( typename ControlPointLatticeType::Pointer, const std::vector<unsigned int> &,
+      const ImageType * );
+
+  /** Fields of the time points currently in use, keyed by time point. */
+  typedef std::map<unsigned int, typename DeformationFieldType::Pointer>
+                                                     DeformationFieldWindowType;
+  /** Keep in the window only the fields of the given time points, releasing
+   * the others first and then evaluating the missing ones together. */
+  void UpdateDeformationFieldWindow
+    ( typename ControlPointLatticeType::Pointer, const std::vector<unsigned int> &,
+      const ImageType *, DeformationFieldWindowType & );
   void InitializeDeformationFieldWithLandmarks();
 //  void InitializeDeformationFieldWithDeformationFields();
 
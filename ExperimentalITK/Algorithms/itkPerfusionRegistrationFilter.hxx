@@ -35,6 +35,7 @@ PURPOSE.  See the above copyright notices for more information.
 #include "itkImageRegionIteratorWithIndex.h"
 #include "itkCrossCorrelationRegistrationFunction.h"
 #include "itkMultiplyImageFilter.h"
+#include "itkTimeVaryingBSplineDeformationFieldSource.h"
 #include "itkVectorImageFileReader.h"
 #include "itkVectorLinearInterpolateImageFunction.h"
 #include "itkVectorFieldGradientImageFunction.h"
@@ -44,6 +45,8 @@ PURPOSE.  See the above copyright notices for more information.
 #include "vnl/algo/vnl_determinant.h"
 #include "vnl/algo/vnl_matrix_inverse.h"
 
+#include <algorithm>
+
 namespace itk {
 
 template<class TImage, class TWarpedImage>
@@ -371,6 +374,9 @@ PerfusionRegistrationFilter<TImage, TWarpedImage>
 
   typedef WarpImageFilter<ImageType, ImageType, DeformationFieldType> WarperType;
 
+  // Each field is used for its time point and for its neighbors, so only
+  // the fields of the current time point and of its neighbors are kept.
+  DeformationFieldWindowType deformationFields;
 
   unsigned long index = 0;
   for ( unsigned int i = 0; i < this->m_TimePoints.size(); i++ )
@@ -410,14 +416,25 @@ PerfusionRegistrationFilter<TImage, TWarpedImage>
         }
       }
 
+    std::vector<unsigned int> window( 1, i );
+    if( im1 >= 0 )
+      {
+      window.push_back( im1 );
+      }
+    if( ip1 >= 0 )
+      {
+      window.push_back( ip1 );
+      }
+    this->UpdateDeformationFieldWindow( this->m_TotalDeformationFieldControlPoints,
+      window, referenceImage, deformationFields );
+
     typename ImageType::Pointer fixedImage = NULL;
     typename ImageType::Pointer movingImage = NULL;
 
     // Create the current estimate for the fixed image
       {
-      typename DeformationFieldType::Pointer deformationField = DeformationFieldType::New();
-      deformationField = this->EvaluateFieldFromControlPointsAtTimePoint
-        ( this->m_TotalDeformationFieldControlPoints, i );
+      typename DeformationFieldType::Pointer deformationField =
+        deformationFields[i];
 
       typename WarperType::Pointer warper = WarperType::New();
       warper->SetInput( this->EvaluateImageAtPyramidLevel( i ) );
@@ -435,9 +452,8 @@ PerfusionRegistrationFilter<TImage, TWarpedImage>
     // Create the current estimate for the moving image 1
     if( im1 >= 0 )
       {
-      typename DeformationFieldType::Pointer deformationField = DeformationFieldType::New();
-      deformationField = this->EvaluateFieldFromControlPointsAtTimePoint
-        ( this->m_TotalDeformationFieldControlPoints, im1 );
+      typename DeformationFieldType::Pointer deformationField =
+        deformationFields[im1];
 
       typename WarperType::Pointer warper = WarperType::New();
       warper->SetInput( this->EvaluateImageAtPyramidLevel( im1 ) );
@@ -500,9 +516,8 @@ PerfusionRegistrationFilter<TImage, TWarpedImage>
     // Create the current estimate for the moving image 1
     if( ip1 >= 0 )
       {
-      typename DeformationFieldType::Pointer deformationField = DeformationFieldType::New();
-      deformationField = this->EvaluateFieldFromControlPointsAtTimePoint
-        ( this->m_TotalDeformationFieldControlPoints, ip1 );
+      typename DeformationFieldType::Pointer deformationField =
+        deformationFields[ip1];
 
       typename WarperType::Pointer warper = WarperType::New();
       warper->SetInput( this->EvaluateImageAtPyramidLevel( ip1 ) );
@@ -718,6 +733,10 @@ PerfusionRegistrationFilter<TImage, TWarpedImage>
 
   typedef WarpImageFilter<ImageType, ImageType, DeformationFieldType> WarperType;
 
+  // Each field is used for its time point and for its neighbors, so only
+  // the fields of the current time point and of its neighbors are kept.
+  DeformationFieldWindowType deformationFields;
+
   for ( unsigned int i = 0; i < this->m_TimePoints.size(); i++ )
     {
 //     std::cout << "   Evaluating contribution from image " << i << std::endl;
@@ -755,14 +774,25 @@ PerfusionRegistrationFilter<TImage, TWarpedImage>
         }
       }
 
+    std::vector<unsigned int> window( 1, i );
+    if( im1 >= 0 )
+      {
+      window.push_back( im1 );
+      }
+    if( ip1 >= 0 )
+      {
+      window.push_back( ip1 );
+      }
+    this->UpdateDeformationFieldWindow( this->m_TotalDeformationFieldControlPoints,
+      window, referenceImage, deformationFields );
+
     typename ImageType::Pointer fixedImage = NULL;
     typename ImageType::Pointer movingImage = NULL;
 
     // Create the current estimate for the fixed image
       {
-      typename DeformationFieldType::Pointer deformationField = DeformationFieldType::New();
-      deformationField = this->EvaluateFieldFromControlPointsAtTimePoint
-        ( this->m_TotalDeformationFieldControlPoints, i );
+      typename DeformationFieldType::Pointer deformationField =
+        deformationFields[i];
 
       typename WarperType::Pointer warper = WarperType::New();
       warper->SetInput( this->EvaluateImageAtPyramidLevel( i ) );
@@ -780,9 +810,8 @@ PerfusionRegistrationFilter<TImage, TWarpedImage>
     // Create the current estimate for the moving image 1
     if( im1 >= 0 )
       {
-      typename DeformationFieldType::Pointer deformationField = DeformationFieldType::New();
-      deformationField = this->EvaluateFieldFromControlPointsAtTimePoint
-        ( this->m_TotalDeformationFieldControlPoints, im1 );
+      typename DeformationFieldType::Pointer deformationField =
+        deformationFields[im1];
 
       typename WarperType::Pointer warper = WarperType::New();
       warper->SetInput( this->EvaluateImageAtPyramidLevel( im1 ) );
@@ -830,9 +859,8 @@ PerfusionRegistrationFilter<TImage, TWarpedImage>
     // Create the current estimate for the moving image 1
     if( ip1 >= 0 )
       {
-      typename DeformationFieldType::Pointer deformationField = DeformationFieldType::New();
-      deformationField = this->EvaluateFieldFromControlPointsAtTimePoint
-        ( this->m_TotalDeformationFieldControlPoints, ip1 );
+      typename DeformationFieldType::Pointer deformationField =
+        deformationFields[ip1];
 
       typename WarperType::Pointer warper = WarperType::New();
       warper->SetInput( this->EvaluateImageAtPyramidLevel( ip1 ) );
@@ -899,6 +927,12 @@ PerfusionRegistrationFilter<TImage, TWarpedImage>
 
   typename ImageType::Pointer referenceImage = this->EvaluateImageAtPyramidLevel( which );
 
+  if ( !refineLattice )
+    {
+    return this->EvaluateFieldsFromControlPointsAtTimePoints
+      ( phiLattice, std::vector<unsigned int>( 1, which ), referenceImage )[0];
+    }
+
   typedef BSplineControlPointImageFilter<ControlPointLatticeType, TimeDependentFieldType>
     BSplineControlPointsFilterType;
   typename BSplineControlPointsFilterType::Pointer bspliner = BSplineControlPointsFilterType::New();
@@ -937,90 +971,92 @@ PerfusionRegistrationFilter<TImage, TWarpedImage>
   bspliner->SetSize( size );
   bspliner->Update();
 
-  if ( refineLattice )
+  nlevels.Fill( 2 );
+  this->m_TotalDeformationFieldControlPoints = bspliner->RefineControlPointLattice( nlevels );
+  return NULL;
+}
+
+template<class TImage, class TWarpedImage>
+std::vector<typename PerfusionRegistrationFilter<TImage, TWarpedImage>
+::DeformationFieldType::Pointer>
+PerfusionRegistrationFilter<TImage, TWarpedImage>
+::EvaluateFieldsFromControlPointsAtTimePoints
+  ( typename ControlPointLatticeType::Pointer phiLattice,
+    const std::vector<unsigned int> &which, const ImageType *referenceImage )
+{
+  std::vector<typename DeformationFieldType::Pointer> fields;
+  if ( which.empty() )
     {
-    nlevels.Fill( 2 );
-    this->m_TotalDeformationFieldControlPoints = bspliner->RefineControlPointLattice( nlevels );
-    return NULL;
+    return fields;
     }
-  else
+
+  typedef TimeVaryingBSplineDeformationFieldSource
+    <ControlPointLatticeType, DeformationFieldType> FieldSourceType;
+  typename FieldSourceType::TimePointContainerType timePoints;
+  for ( unsigned int i = 0; i < which.size(); i++ )
     {
-    typename ControlPointLatticeType::Pointer tPhiLattice =
-      ControlPointLatticeType::New();
-    typename ControlPointLatticeType::SizeType tPhiSize;
-    for( unsigned int d = 0; d < ImageDimension; d++ )
-      {
-      tPhiSize[d] = phiLattice->GetLargestPossibleRegion().GetSize()[d];
-      }
-    tPhiSize[ImageDimension] = 1;
-    tPhiLattice->SetRegions( tPhiSize );
-    tPhiLattice->Allocate();
+    timePoints.push_back( this->m_TimePoints[which[i]] );
+    }
 
-    RealType numberOfSpans =
-      phiLattice->GetLargestPossibleRegion().GetSize()[ImageDimension];
-    if( this->m_WrapTime )
+  typename FieldSourceType::Pointer fieldSource = FieldSourceType::New();
+  fieldSource->SetOrigin( referenceImage->GetOrigin() );
+  fieldSource->SetSpacing( referenceImage->GetSpacing() );
+  fieldSource->SetSize( referenceImage->GetLargestPossibleRegion().GetSize() );
+  fieldSource->SetControlPointLattice( phiLattice );
+  fieldSource->SetSplineOrder( this->m_SplineOrder );
+  fieldSource->SetTemporalSplineOrder( this->m_TemporalSplineOrder );
+  fieldSource->SetWrapTime( this->m_WrapTime );
+  fieldSource->SetTemporalOrigin( this->m_TemporalOrigin );
+  fieldSource->SetTemporalEnd( this->m_TemporalEnd );
+  fieldSource->SetTimePoints( timePoints );
+  fieldSource->Update();
+
+  for ( unsigned int i = 0; i < which.size(); i++ )
+    {
+    typename DeformationFieldType::Pointer field = fieldSource->GetOutput( i );
+    field->DisconnectPipeline();
+    fields.push_back( field );
+    }
+  return fields;
+}
+
+template<class TImage, class TWarpedImage>
+void
+PerfusionRegistrationFilter<TImage, TWarpedImage>
+::UpdateDeformationFieldWindow
+  ( typename ControlPointLatticeType::Pointer phiLattice,
+    const std::vector<unsigned int> &which, const ImageType *referenceImage,
+    DeformationFieldWindowType &window )
+{
+  typename DeformationFieldWindowType::iterator it = window.begin();
+  while ( it != window.end() )
+    {
+    if ( std::find( which.begin(), which.end(), it->first ) == which.end() )
       {
-      numberOfSpans -= this->m_TemporalSplineOrder;
+      window.erase( it++ );
       }
-    RealType t = ( this->m_TimePoints[which] - this->m_TemporalOrigin ) /
-      ( this->m_TemporalEnd - this->m_TemporalOrigin ) * numberOfSpans;
-
-    bspliner->CollapsePhiLattice( phiLattice, tPhiLattice, t,
-      ImageDimension );
-
-    typedef ExtractImageFilter<TimeDependentFieldType, DeformationFieldType> ExtracterType;
-    typename ExtracterType::Pointer extracter = ExtracterType::New();
-    extracter->SetInput( tPhiLattice );
-
-    typename ExtracterType::InputImageRegionType region;
-    typename ExtracterType::InputImageSizeType regionSize;
-    typename ExtracterType::InputImageIndexType regionIndex;
-
-    for ( unsigned int d = 0; d < ImageDimension; d++ )
+    else
       {
-      regionSize[d] = tPhiLattice->GetLargestPossibleRegion().GetSize()[d];
-      regionIndex[d] = tPhiLattice->GetLargestPossibleRegion().GetIndex()[d];
+      ++it;
       }
-    regionSize[ImageDimension] = 0;
-    regionIndex[ImageDimension] = 0;
-    region.SetSize( regionSize );
-    region.SetIndex( regionIndex );
-
-    extracter->SetExtractionRegion( region );
-    extracter->Update();
+    }
 
-    typename DeformationFieldType::PointType origin2;
-    typename DeformationFieldType::SpacingType spacing2;
-    typename DeformationFieldType::SizeType size2;
-    for ( unsigned int i = 0; i < ImageDimension; i++ )
+  std::vector<unsigned int> missing;
+  for ( unsigned int i = 0; i < which.size(); i++ )
+    {
+    if ( window.find( which[i] ) == window.end()
+      && std::find( missing.begin(), missing.end(), which[i] ) == missing.end() )
       {
-      origin2[i] = referenceImage->GetOrigin()[i];
-      spacing2[i] = referenceImage->GetSpacing()[i];
-      size2[i] = referenceImage->GetLargestPossibleRegion().GetSize()[i];
+      missing.push_back( which[i] );
       }
+    }
 
-    typedef BSplineControlPointImageFilter<DeformationFieldType, DeformationFieldType>
-      BSplineControlPointsFilterType2;
-    typename BSplineControlPointsFilterType2::Pointer bspliner2 =
-      BSplineControlPointsFilterType2::New();
-    typename BSplineControlPointsFilterType2::ArrayType close2;
-    typename BSplineControlPointsFilterType2::ArrayType order2;
-    typename BSplineControlPointsFilterType2::DirectionType direction2;
-    close2.Fill( false );
-    order2.Fill( this->m_SplineOrder );
-    direction2.SetIdentity();
-
-    bspliner2->SetSplineOrder( order2 );
-    bspliner2->SetCloseDimension( close2 );
-    bspliner2->SetInput( extracter->GetOutput() );
-    bspliner2->SetOrigin( origin2 );
-    bspliner2->SetSpacing( spacing2 );
-    bspliner2->SetDirection( direction2 );
-    bspliner2->SetSize( size2 );
-    bspliner2->Update();
-
-    return bspliner2->GetOutput();
-
+  std::vector<typename DeformationFieldType::Pointer> fields =
+    this->EvaluateFieldsFromControlPointsAtTimePoints
+    ( phiLattice, missing, referenceImage );
+  for ( unsigned int i = 0; i < missing.size(); i++ )
+    {
+    window[missing[i]] = fields[i];
     }
 }
 
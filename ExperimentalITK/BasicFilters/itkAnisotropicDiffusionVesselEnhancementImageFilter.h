@@ -69,7 +69,9 @@ public:
   typedef typename Superclass::OutputImageType OutputImageType;
   typedef typename Superclass::PixelType       PixelType;
 
-  typedef itk::Image< DiffusionTensor3D< double > , 3 > 
+  typedef itk::DiffusionTensor3D< float >       DiffusionTensorPixelType;
+
+  typedef itk::Image< DiffusionTensorPixelType, 3 > 
                                                 DiffusionTensorImageType;
 
 
@@ -121,10 +123,6 @@ public:
   /** The container type for the update buffer. */
   typedef OutputImageType UpdateBufferType;
 
-  /** Define diffusion image nbd type */
-  typedef typename FiniteDifferenceFunctionType::DiffusionTensorNeighborhoodType
-                                               DiffusionTensorNeighborhoodType;
-
 
   /** Set/Get Macro for VED parameters */
   itkSetMacro( TimeStep, double ); 
@@ -137,6 +135,20 @@ public:
   itkGetMacro( WStrength, double ); 
   itkGetMacro( Sensitivity, double ); 
 
+  /** The diffusion tensors are recomputed at every TensorUpdateInterval-th
+   * iteration only (default 1, every iteration). */
+  itkSetClampMacro( TensorUpdateInterval, unsigned int, 1,
+                    NumericTraits<unsigned int>::max() );
+  itkGetMacro( TensorUpdateInterval, unsigned int );
+
+  /** If positive, a tensor update is restricted to the blocks of
+   * TensorBlockSize^3 pixels in which the image changed by more than this
+   * value since their tensors were last computed.  The Hessian and the
+   * vesselness are computed on the bounding box of these blocks padded by
+   * three times the largest sigma.  Default is 0 (update everywhere). */
+  itkSetMacro( TensorUpdateTolerance, double );
+  itkGetMacro( TensorUpdateTolerance, double );
+
 #ifdef ITK_USE_CONCEPT_CHECKING
   /** Begin concept checking */
   itkConceptMacro(OutputTimesDoubleCheck,
@@ -192,7 +204,7 @@ protected:
   /** This method allocates storage for the diffusion tensor image */
   void AllocateDiffusionTensorImage();
  
-  /** Update diffusion tensor image */
+  /** Update diffusion tensor image (when due, see TensorUpdateInterval) */
   void UpdateDiffusionTensorImage();
  
   /** The type of region used for multithreading */
@@ -260,6 +272,18 @@ private:
   typename EigenVectorMatrixAnalysisFilterType::Pointer 
                                       m_EigenVectorMatrixAnalysisFilter; 
 
+  /** Lagged tensor updates */
+  enum { TensorBlockSize = 16 };
+
+  typedef itk::Image< float, 3 >                         ReferenceImageType;
+
+  unsigned int                                           m_TensorUpdateInterval;
+  double                                                 m_TensorUpdateTolerance;
+  bool                                                   m_TensorsInitialized;
+
+  /** Output at the last tensor update of each pixel */
+  ReferenceImageType::Pointer                            m_TensorReferenceImage;
+
   // Vesselness guided diffusion parameters
   double                                                 m_Epsilon;
   double                                                 m_WStrength;
@@ -27,7 +27,11 @@
 #include "itkNeighborhoodAlgorithm.h"
 
 #include "itkImageFileWriter.h"
+#include "itkRegionOfInterestImageFilter.h"
 #include "itkVector.h"
+#include "vnl/vnl_math.h"
+
+#include <vector>
 
 //#define INTERMEDIATE_OUTPUTS
 
@@ -70,6 +74,10 @@ AnisotropicDiffusionVesselEnhancementImageFilter<TInputImage, TOutputImage>
   m_WStrength  = 25.0;
   m_Sensitivity  = 5.0;
   m_Epsilon = 10e-2;
+
+  m_TensorUpdateInterval = 1;
+  m_TensorUpdateTolerance = 0.0;
+  m_TensorsInitialized = false;
 }
 
 /** Prepare for the iteration process. */
@@ -261,6 +269,23 @@ AnisotropicDiffusionVesselEnhancementImageFilter<TInputImage, TOutputImage>
   m_DiffusionTensorImage->SetRequestedRegion(output->GetRequestedRegion());
   m_DiffusionTensorImage->SetBufferedRegion(output->GetBufferedRegion());
   m_DiffusionTensorImage->Allocate();
+
+  m_TensorsInitialized = false;
+
+  if( m_TensorUpdateTolerance > 0.0 )
+    {
+    m_TensorReferenceImage = ReferenceImageType::New();
+    m_TensorReferenceImage->SetSpacing(output->GetSpacing());
+    m_TensorReferenceImage->SetOrigin(output->GetOrigin());
+    m_TensorReferenceImage->SetLargestPossibleRegion(output->GetLargestPossibleRegion());
+    m_TensorReferenceImage->SetRequestedRegion(output->GetRequestedRegion());
+    m_TensorReferenceImage->SetBufferedRegion(output->GetBufferedRegion());
+    m_TensorReferenceImage->Allocate();
+    }
+  else
+    {
+    m_TensorReferenceImage = NULL;
+    }
 }
 
 template <class TInputImage, class TOutputImage>
@@ -270,7 +295,121 @@ AnisotropicDiffusionVesselEnhancementImageFilter<TInputImage, TOutputImage>
 {
   itkDebugMacro( << "UpdateDiffusionTensorImage() called" ); 
 
-  m_HessianFilter->SetInput( this->GetOutput() );
+  if( m_TensorsInitialized && 
+      this->GetElapsedIterations() % m_TensorUpdateInterval != 0 )
+    {
+    return;
+    }
+
+  typedef typename OutputImageType::RegionType      RegionType;
+  typedef typename OutputImageType::IndexType       IndexType;
+  typedef typename OutputImageType::SizeType        SizeType;
+
+  typename OutputImageType::Pointer output = this->GetOutput();
+  const RegionType largestRegion = output->GetLargestPossibleRegion();
+
+  // Regions of which the tensors are recomputed
+  std::vector<RegionType> blocks;
+
+  if( m_TensorUpdateTolerance > 0.0 && m_TensorsInitialized )
+    {
+    IndexType blockIndex;
+    SizeType  blockSize;
+    for( long z = 0; z < static_cast<long>( largestRegion.GetSize()[2] ); 
+         z += TensorBlockSize )
+      {
+      for( long y = 0; y < static_cast<long>( largestRegion.GetSize()[1] ); 
+           y += TensorBlockSize )
+        {
+        for( long x = 0; x < static_cast<long>( largestRegion.GetSize()[0] ); 
+             x += TensorBlockSize )
+          {
+          const long position[3] = { x, y, z };
+          for( unsigned int d = 0; d < ImageDimension; d++ )
+            {
+            blockIndex[d] = largestRegion.GetIndex()[d] + position[d];
+            blockSize[d] = vnl_math_min( static_cast<unsigned long>( 
+              TensorBlockSize ), largestRegion.GetSize()[d] - position[d] );
+            }
+          RegionType block( blockIndex, blockSize );
+
+          ImageRegionConstIterator<OutputImageType> ot( output, block );
+          ImageRegionConstIterator<ReferenceImageType> rt( 
+            m_TensorReferenceImage, block );
+          for( ot.GoToBegin(), rt.GoToBegin(); !ot.IsAtEnd(); ++ot, ++rt )
+            {
+            if( vnl_math_abs( static_cast<double>( ot.Get() ) - rt.Get() ) > 
+                m_TensorUpdateTolerance )
+              {
+              blocks.push_back( block );
+              break;
+              }
+            }
+          }
+        }
+      }
+
+    if( blocks.empty() )
+      {
+      return;
+      }
+    }
+  else
+    {
+    blocks.push_back( largestRegion );
+    }
+
+  // The Hessian and the vesselness are computed on the bounding box of the
+  // blocks, padded by the support of the largest Gaussian.
+  IndexType lower = blocks[0].GetIndex();
+  IndexType upper = blocks[0].GetUpperIndex();
+  for( unsigned int n = 1; n < blocks.size(); n++ )
+    {
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      lower[d] = vnl_math_min( lower[d], blocks[n].GetIndex()[d] );
+      upper[d] = vnl_math_max( upper[d], blocks[n].GetUpperIndex()[d] );
+      }
+    }
+  SizeType boundingSize;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    boundingSize[d] = upper[d] - lower[d] + 1;
+    }
+  RegionType updateRegion( lower, boundingSize );
+
+  const double maximumSigma = vnl_math_max( m_HessianFilter->GetSigma(), 
+    m_MultiScaleVesselnessFilter->GetSigmaMax() );
+  SizeType padding;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    padding[d] = static_cast<unsigned long>( 
+      vcl_ceil( 3.0 * maximumSigma / output->GetSpacing()[d] ) ) + 1;
+    }
+  updateRegion.PadByRadius( padding );
+  updateRegion.Crop( largestRegion );
+
+  typedef RegionOfInterestImageFilter<OutputImageType, InputImageType> 
+                                                        ExtractorType;
+  typename ExtractorType::Pointer extractor;
+
+  if( updateRegion == largestRegion )
+    {
+    m_HessianFilter->SetInput( output );
+    m_MultiScaleVesselnessFilter->SetInput( output );
+    }
+  else
+    {
+    extractor = ExtractorType::New();
+    extractor->SetInput( output );
+    extractor->SetRegionOfInterest( updateRegion );
+    extractor->Update();
+
+    m_HessianFilter->SetInput( extractor->GetOutput() );
+    m_MultiScaleVesselnessFilter->SetInput( extractor->GetOutput() );
+    }
+
+  m_HessianFilter->Modified();
   m_HessianFilter->Update();
 
 #ifdef INTERMEDIATE_OUTPUTS
@@ -284,7 +423,6 @@ AnisotropicDiffusionVesselEnhancementImageFilter<TInputImage, TOutputImage>
   HessianWriter->Update(); 
 #endif
 
-  m_MultiScaleVesselnessFilter->SetInput( this->GetOutput() );
   m_MultiScaleVesselnessFilter->Modified();
   m_MultiScaleVesselnessFilter->Update();
 
@@ -299,159 +437,89 @@ AnisotropicDiffusionVesselEnhancementImageFilter<TInputImage, TOutputImage>
   VesselenssImageWriter->Update(); 
 #endif
 
-  // Hessian matrix 
-  typename HessianFilterType::OutputImageType::Pointer   HessianOutputImage;
-  HessianOutputImage = m_HessianFilter->GetOutput();
-
-  // Pass it to the eigenVector matrix analyzer
-  m_EigenVectorMatrixAnalysisFilter->SetInput( HessianOutputImage ); 
-
+  // Pass the Hessian to the eigenVector matrix analyzer
+  m_EigenVectorMatrixAnalysisFilter->SetInput( m_HessianFilter->GetOutput() ); 
   m_EigenVectorMatrixAnalysisFilter->Update();
 
   typename OutputMatrixImageType::Pointer eigenVectorMatrixOutputImage =
                               m_EigenVectorMatrixAnalysisFilter->GetOutput();
 
-  typedef  itk::ImageRegionIterator< OutputMatrixImageType > 
-                                    EigenVectorMatrixIteratorType;
-
-  EigenVectorMatrixIteratorType   
-               ig(eigenVectorMatrixOutputImage, eigenVectorMatrixOutputImage->GetLargestPossibleRegion());
-
-  ig.GoToBegin();
-
-#ifdef IINTERMEDIATE_OUTPUTS
-  typedef ImageFileWriter< OutputMatrixImageType > EigenVectorMatrixWriterType;
-
-  typename EigenVectorMatrixWriterType::Pointer 
-           EigenVectorMatrixWriter = EigenVectorMatrixWriterType::New();
-
-  EigenVectorMatrixWriter->SetFileName( "EigenVectorMatrixImage.mha" );
-  EigenVectorMatrixWriter->SetInput ( m_EigenVectorMatrixAnalysisFilter->GetOutput());
-  EigenVectorMatrixWriter->Update(); 
-#endif
- 
   // Vessleness response
-  typename MultiScaleVesselnessFilterType::OutputImageType::Pointer   MultiScaleHessianOutputImage;
-  MultiScaleHessianOutputImage = m_MultiScaleVesselnessFilter->GetOutput();
-
   typedef typename MultiScaleVesselnessFilterType::OutputImageType      MultiScaleHessianOutputImageType;
-  typedef  itk::ImageRegionIterator< MultiScaleHessianOutputImageType > MultiScaleHessianIteratorType;
-  MultiScaleHessianIteratorType    im(MultiScaleHessianOutputImage, 
-                                    MultiScaleHessianOutputImage->GetLargestPossibleRegion());
-  im.GoToBegin();
-
-  typename DiffusionTensorImageType::PixelType                   tensor;
-
-  double Lambda1;
-  double Lambda2;
-  double Lambda3;
-
-  double iS = 1.0 / m_Sensitivity; 
-
-  MatrixType eigenValueMatrix;
-  MatrixType HessianEigenVectorMatrix;
-  MatrixType HessianEigenVectorMatrixTranspose;
-  MatrixType productMatrix;
-
-  typedef itk::ImageRegionIterator< DiffusionTensorImageType > DiffusionTensorIteratorType;
-
-  DiffusionTensorIteratorType 
-      it( m_DiffusionTensorImage, m_DiffusionTensorImage->GetLargestPossibleRegion() );
-
-  it.GoToBegin();
+  typename MultiScaleHessianOutputImageType::Pointer   MultiScaleHessianOutputImage =
+                              m_MultiScaleVesselnessFilter->GetOutput();
 
-
-  /* For Debugging */
-  /* ======================= */
-  ImageRegionIterator<OutputImageType>  om(this->GetOutput(),
-                                           this->GetOutput()->GetLargestPossibleRegion());
-  om.Begin();
+  // Index of a pixel of the output in the images computed on updateRegion
+  IndexType computedIndex;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    computedIndex[d] = eigenVectorMatrixOutputImage->GetLargestPossibleRegion().GetIndex()[d] -
+                       updateRegion.GetIndex()[d];
+    }
 
   std::cout << "Generate tensor matrix: " << std::endl;
- 
-  //DEBUG: DELETE LATER
-  // Generate a vector image of the eigen values
-
-  typedef itk::Vector<  double , 3>          VectorPixelType;
-  typedef itk::Image< VectorPixelType, 3>    EigenValueImageType;
-  
-
-  EigenValueImageType::Pointer  eigenValueImage = EigenValueImageType::New();
 
-  eigenValueImage->SetSpacing(this->GetOutput()->GetSpacing());
-  eigenValueImage->SetOrigin(this->GetOutput()->GetOrigin());
-  eigenValueImage->SetLargestPossibleRegion(this->GetOutput()->GetLargestPossibleRegion());
-  eigenValueImage->SetRequestedRegion(this->GetOutput()->GetRequestedRegion());
-  eigenValueImage->SetBufferedRegion(this->GetOutput()->GetBufferedRegion());
-  eigenValueImage->Allocate();
-
-  ImageRegionIterator<EigenValueImageType>  eigenImageIterator(eigenValueImage,
-                                           eigenValueImage->GetLargestPossibleRegion());
-  eigenImageIterator.Begin();
-
-  VectorPixelType eigenVectorPixel;
- 
+  double iS = 1.0 / m_Sensitivity; 
 
-  while( !it.IsAtEnd() )
+  for( unsigned int n = 0; n < blocks.size(); n++ )
     {
-    // Generate matrix "Q" with the eigenvectors of the Hessian
-    HessianEigenVectorMatrix = ig.Get();
-    HessianEigenVectorMatrixTranspose = HessianEigenVectorMatrix.GetTranspose(); 
-
-    // Generate the diagonal matrix with the eigen values
-    eigenValueMatrix.SetIdentity();
-
-    double vesselNessValue = static_cast<double> (im.Get());
-    
-    Lambda1 = 1 + ( m_WStrength - 1 ) * vcl_pow ( vesselNessValue, iS ); 
-    Lambda2 = Lambda3 = 1 + ( m_Epsilon - 1 ) * vcl_pow ( vesselNessValue, iS ); 
-
-    eigenValueMatrix(0,0) = Lambda1;
-    eigenValueMatrix(1,1) = Lambda2;
-    eigenValueMatrix(2,2) = Lambda3;
-
-    eigenVectorPixel[0] = Lambda1;
-    eigenVectorPixel[1] = Lambda2;
-    eigenVectorPixel[2] = Lambda3;
-  
-    eigenImageIterator.Set( eigenVectorPixel );
-
-    // Generate the tensor matrix
-    productMatrix = HessianEigenVectorMatrix * eigenValueMatrix * HessianEigenVectorMatrixTranspose;
-
-    //Copy the ITK::Matrix to the tensor...there should be a better way of doing this TODO
-
-    tensor(0,0) = productMatrix(0,0);
-    tensor(0,1) = productMatrix(0,1);
-    tensor(0,2) = productMatrix(0,2);
-
-    tensor(1,0) = productMatrix(1,0);
-    tensor(1,1) = productMatrix(1,1);
-    tensor(1,2) = productMatrix(1,2);
+    RegionType computedRegion = blocks[n];
+    IndexType blockIndex = blocks[n].GetIndex();
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      blockIndex[d] += computedIndex[d];
+      }
+    computedRegion.SetIndex( blockIndex );
 
-    tensor(2,0) = productMatrix(2,0);
-    tensor(2,1) = productMatrix(2,1);
-    tensor(2,2) = productMatrix(2,2);
+    ImageRegionConstIterator<OutputMatrixImageType> 
+      ig( eigenVectorMatrixOutputImage, computedRegion );
+    ImageRegionConstIterator<MultiScaleHessianOutputImageType> 
+      im( MultiScaleHessianOutputImage, computedRegion );
+    ImageRegionIterator<DiffusionTensorImageType> 
+      it( m_DiffusionTensorImage, blocks[n] );
 
-    it.Set( tensor );
+    for( ig.GoToBegin(), im.GoToBegin(), it.GoToBegin(); !it.IsAtEnd(); 
+         ++ig, ++im, ++it )
+      {
+      // The tensor is Q diag( Lambda1, Lambda2, Lambda2 ) Q^T, where Q holds
+      // the eigenvectors of the Hessian, i.e.
+      // Lambda2 I + ( Lambda1 - Lambda2 ) q q^T with q the first column of Q.
+      const MatrixType &HessianEigenVectorMatrix = ig.Value();
+
+      double vesselNessValue = 
+        vcl_pow( static_cast<double>( im.Get() ), iS ); 
+
+      double Lambda1 = 1 + ( m_WStrength - 1 ) * vesselNessValue; 
+      double Lambda2 = 1 + ( m_Epsilon - 1 ) * vesselNessValue; 
+
+      const double d = Lambda1 - Lambda2;
+      const double q0 = HessianEigenVectorMatrix(0,0);
+      const double q1 = HessianEigenVectorMatrix(1,0);
+      const double q2 = HessianEigenVectorMatrix(2,0);
+
+      DiffusionTensorPixelType &tensor = it.Value();
+      tensor[0] = static_cast<float>( Lambda2 + d * q0 * q0 );
+      tensor[1] = static_cast<float>( d * q0 * q1 );
+      tensor[2] = static_cast<float>( d * q0 * q2 );
+      tensor[3] = static_cast<float>( Lambda2 + d * q1 * q1 );
+      tensor[4] = static_cast<float>( d * q1 * q2 );
+      tensor[5] = static_cast<float>( Lambda2 + d * q2 * q2 );
+      }
 
-    ++it;
-    ++ig;
-    ++im;
-    ++eigenImageIterator;
-    
-    ++om;
+    if( m_TensorReferenceImage.IsNotNull() )
+      {
+      ImageRegionConstIterator<OutputImageType> ot( output, blocks[n] );
+      ImageRegionIterator<ReferenceImageType> rt( m_TensorReferenceImage, blocks[n] );
+      for( ot.GoToBegin(), rt.GoToBegin(); !ot.IsAtEnd(); ++ot, ++rt )
+        {
+        rt.Set( static_cast<float>( ot.Get() ) );
+        }
+      }
     }
 
-  
+  m_TensorsInitialized = true;
 
 #ifdef INTERMEDIATE_OUTPUTS
-  typedef itk::ImageFileWriter< EigenValueImageType > EigenValueVectorImageWriter;
-  EigenValueVectorImageWriter::Pointer eigenValueVectorImageWriter = EigenValueVectorImageWriter::New();
-  eigenValueVectorImageWriter->SetInput( eigenValueImage );
-  eigenValueVectorImageWriter->SetFileName( "EigenValueVectorImage.mha");
-  eigenValueVectorImageWriter->Update();
-
   typedef ImageFileWriter< DiffusionTensorImageType > DiffusionTensorWriterType;
 
   typename DiffusionTensorWriterType::Pointer   
@@ -625,7 +693,7 @@ typename
 AnisotropicDiffusionVesselEnhancementImageFilter<TInputImage, TOutputImage>::TimeStepType
 AnisotropicDiffusionVesselEnhancementImageFilter<TInputImage, TOutputImage>
 ::ThreadedCalculateChange(const ThreadRegionType &regionToProcess, 
-    const ThreadDiffusionImageRegionType & diffusionRegionToProcess, int)
+    const ThreadDiffusionImageRegionType &, int)
 {
   typedef typename OutputImageType::RegionType      RegionType;
   typedef typename OutputImageType::SizeType        SizeType;
@@ -665,20 +733,24 @@ AnisotropicDiffusionVesselEnhancementImageFilter<TInputImage, TOutputImage>
    // Process the non-boundary region.
   NeighborhoodIteratorType nD(radius, output, *fIt);
 
-  typedef NeighborhoodAlgorithm::ImageBoundaryFacesCalculator<DiffusionTensorImageType>
-    DiffusionTensorFaceCalculatorType;
+  // The tensors are read in place: the tensor image has the buffered
+  // region of the output, and the neighbours along each axis are one stride
+  // away, or the center pixel itself at the image boundary.
+  typedef DiffusionTensorImageType::OffsetValueType TensorOffsetValueType;
 
-  typedef typename DiffusionTensorFaceCalculatorType::FaceListType 
-                                                DiffusionTensorFaceListType;
+  const DiffusionTensorImageType::RegionType &tensorRegion = 
+    m_DiffusionTensorImage->GetBufferedRegion();
+  const TensorOffsetValueType *tensorStrides = 
+    m_DiffusionTensorImage->GetOffsetTable();
 
-  DiffusionTensorFaceCalculatorType diffusionTensorFaceCalculator;
-  
-  DiffusionTensorFaceListType diffusionTensorFaceList = 
-     diffusionTensorFaceCalculator(m_DiffusionTensorImage, diffusionRegionToProcess, radius);
+  TensorOffsetValueType tensorOffsets[2 * ImageDimension];
+  for( unsigned int i = 0; i < ImageDimension; i++ )
+    {
+    tensorOffsets[2 * i] = -tensorStrides[i];
+    tensorOffsets[2 * i + 1] = tensorStrides[i];
+    }
 
-  typename DiffusionTensorFaceListType::iterator dfIt = diffusionTensorFaceList.begin();
-  
-  DiffusionTensorNeighborhoodType  dTN(radius,m_DiffusionTensorImage, *dfIt); 
+  typedef ImageRegionConstIterator<DiffusionTensorImageType> TensorIteratorType;
 
   // Ask the function object for a pointer to a data structure it
   // will use to manage any global values it needs.  We'll pass this
@@ -689,36 +761,51 @@ AnisotropicDiffusionVesselEnhancementImageFilter<TInputImage, TOutputImage>
 
 
   UpdateIteratorType       nU(m_UpdateBuffer,  *fIt);
+  TensorIteratorType       nT(m_DiffusionTensorImage, *fIt);
   nD.GoToBegin();
   while( !nD.IsAtEnd() )
     {
-    nU.Value() = df->ComputeUpdate(nD, dTN, globalData);
+    nU.Value() = df->ComputeUpdate(nD, &nT.Value(), tensorOffsets, globalData);
     ++nD;
     ++nU;
+    ++nT;
     }
 
   // Process each of the boundary faces.
 
   NeighborhoodIteratorType bD;
   
-  DiffusionTensorNeighborhoodType bDD;
+  TensorIteratorType bT;
 
   UpdateIteratorType   bU;
+
+  TensorOffsetValueType boundaryOffsets[2 * ImageDimension];
+
   for (++fIt; fIt != faceList.end(); ++fIt)
     {
     bD = NeighborhoodIteratorType(radius, output, *fIt);
-    bDD = DiffusionTensorNeighborhoodType(radius, m_DiffusionTensorImage, *dfIt);
+    bT = TensorIteratorType(m_DiffusionTensorImage, *fIt);
     bU = UpdateIteratorType  (m_UpdateBuffer, *fIt);
      
     bD.GoToBegin();
+    bT.GoToBegin();
     bU.GoToBegin();
     while ( !bD.IsAtEnd() )
       {
-      bU.Value() = df->ComputeUpdate(bD,bDD,globalData);
+      const IndexType index = bT.GetIndex();
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        boundaryOffsets[2 * i] = ( index[i] > tensorRegion.GetIndex()[i] ) ?
+          tensorOffsets[2 * i] : 0;
+        boundaryOffsets[2 * i + 1] = ( index[i] < tensorRegion.GetIndex()[i] + 
+          static_cast<IndexValueType>( tensorRegion.GetSize()[i] ) - 1 ) ?
+          tensorOffsets[2 * i + 1] : 0;
+        }
+      bU.Value() = df->ComputeUpdate(bD, &bT.Value(), boundaryOffsets, globalData);
       ++bD;
+      ++bT;
       ++bU;
       }
-    ++dfIt;
     }
 
   // Ask the finite difference function to compute the time step for
@@ -793,6 +880,9 @@ AnisotropicDiffusionVesselEnhancementImageFilter<TInputImage, TOutputImage>
 ::PrintSelf(std::ostream& os, Indent indent) const
 {
   Superclass::PrintSelf(os, indent);
+
+  os << indent << "TensorUpdateInterval: " << m_TensorUpdateInterval << std::endl;
+  os << indent << "TensorUpdateTolerance: " << m_TensorUpdateTolerance << std::endl;
 }
 
 }// end namespace itk
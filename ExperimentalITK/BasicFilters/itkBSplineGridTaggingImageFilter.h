@@ -21,6 +21,7 @@
 
 #include "itkBSplineScatteredDataPointSetToImageFilter.h"
 #include "itkPointSet.h"
+#include "itkSparseMatrixSinkhornNormalization.h"
 #include "itkVector.h"
 
 #include "vnl/vnl_sparse_matrix.h"
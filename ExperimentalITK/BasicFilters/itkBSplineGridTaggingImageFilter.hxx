@@ -422,77 +422,18 @@ void
 BSplineGridTaggingImageFilter<TControlPointLattice, TCandidatePointImage, TOutputImage>
 ::NormalizeCorrespondenceMatrix()
 {
-  RealType epsilon = 0.0025;
-  RealType deviation = NumericTraits<RealType>::max(); 
-
-  unsigned int maximumNumberOfIterations = 100;
-  unsigned int iterations = 0;
-
-  while ( vnl_math_abs( deviation ) > epsilon && iterations++ < maximumNumberOfIterations )
-    {
-    /**
-     * do row normalization
-     */
-    OutlierArrayType rowSum;
-    rowSum = this->m_OutlierColumn;
-
-    for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.rows(); i++ )
-      {
-      rowSum[i] += this->m_CorrespondenceMatrix.sum_row( i );
-      } 
-    for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.rows(); i++ )
-      {
-      this->m_CorrespondenceMatrix.scale_row( i, 1.0 / rowSum[i] );
-      }
-    for ( unsigned int i = 0; i < this->m_OutlierColumn.size(); i++ )
-      {
-      this->m_OutlierColumn[i] /= rowSum[i];     
-      }
-
-    /**
-     * do column normalization
-     */
-    OutlierArrayType columnSum;
-    columnSum = this->m_OutlierRow;
-
-    for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.rows(); i++ )
-      {
-      typename SparseMatrixType::row &rw = this->m_CorrespondenceMatrix.get_row( i );
-      typename SparseMatrixType::row::iterator ri;
-      for ( ri = rw.begin(); ri != rw.end(); ++ri )
-        { 
-        columnSum[(*ri).first] += (*ri).second;
-        }
-      } 
-    for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.rows(); i++ )
-      {
-      typename SparseMatrixType::row &rw = this->m_CorrespondenceMatrix.get_row( i );
-      typename SparseMatrixType::row::iterator ri;
-      for ( ri = rw.begin(); ri != rw.end(); ++ri )
-        { 
-        (*ri).second /= columnSum[(*ri).first];
-        }
-      }
-    for ( unsigned int i = 0; i < this->m_OutlierRow.size(); i++ )
-      {
-      this->m_OutlierRow[i] /= columnSum[i];     
-      }
-
-    /**
-     * Calculate current deviation from 1
-     */
-    for ( unsigned int i = 0; i < rowSum.size(); i++ )
-      {
-      rowSum[i] -= 1.0;     
-      }
-    for ( unsigned int i = 0; i < columnSum.size(); i++ )
-      {
-      columnSum[i] -= 1.0;     
-      }
-
-    deviation = ( rowSum.squared_magnitude() + columnSum.squared_magnitude() ) 
-      / ( static_cast<RealType>( rowSum.size() + columnSum.size() ) );
-    }  
+  typedef SparseMatrixSinkhornNormalization<RealType, 
+    SparseMatrixType, OutlierArrayType> NormalizerType;
+
+  typename NormalizerType::Pointer normalizer = NormalizerType::New();
+  normalizer->SetMatrix( &this->m_CorrespondenceMatrix );
+  normalizer->SetOutlierColumn( &this->m_OutlierColumn );
+  normalizer->SetOutlierRow( &this->m_OutlierRow );
+  normalizer->SetTolerance( 0.0025 );
+  normalizer->SetMaximumNumberOfIterations( 100 );
+  normalizer->NormalizeRowsFirstOn();
+  normalizer->SetNumberOfThreads( this->GetNumberOfThreads() );
+  normalizer->Update();
 }
 
 template <class TControlPointLattice, class TCandidatePointImage, class TOutputImage>
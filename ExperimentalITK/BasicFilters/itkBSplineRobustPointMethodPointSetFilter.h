@@ -20,16 +20,38 @@
 #include "itkPointSetToImageFilter.h"
 
 #include "itkBSplineScatteredDataPointSetToImageFilter.h"
+#include "itkKdTreeGenerator.h"
+#include "itkListSample.h"
+#include "itkMultiThreader.h"
 #include "itkPointSet.h"
-#include "itkVariableLengthVector.h"
-#include "itkVariableSizeMatrix.h"
+#include "itkSparseMatrixSinkhornNormalization.h"
 #include "itkVector.h"
 
+#include "vnl/vnl_sparse_matrix.h"
+#include "vnl/vnl_vector.h"
+
+#include <vector>
+
 namespace itk
 {
 
 /** \class BSplineRobustPointMethodPointSetFilter.h
  * \brief point set filter.
+ *
+ * The correspondence matrix is stored as a sparse matrix.  By default every
+ * entry is kept.  With UseSparseCorrespondence on, the moving point i only
+ * keeps the fixed points whose Gaussian weight at the current temperature
+ * is above CorrespondenceCutoff times the peak weight.  These points are
+ * found with a radius query in a kd-tree of the fixed points and, if
+ * MaximumNumberOfNeighbors is non-zero, a nearest neighbor query bounds
+ * their number per row, which bounds the memory and the time of an
+ * annealing step by O( K * MaximumNumberOfNeighbors ).  When the radius is
+ * infinite (before the annealing starts, or with a zero cutoff) and
+ * MaximumNumberOfNeighbors is 0, NumberOfUnboundedNeighbors is used instead
+ * so that the sparse matrix never becomes dense.
+ *
+ * The correspondence matrix update and its normalization are multithreaded
+ * over the rows.
  */
 
 template <class TPointSet, 
@@ -59,8 +81,19 @@ public:
   typedef typename VectorType::ValueType                      RealType;
 
   /** Other typedef */
-  typedef VariableSizeMatrix<RealType>                        MatrixType;
-  typedef VariableLengthVector<RealType>                      OutlierVectorType;
+  typedef vnl_sparse_matrix<RealType>                         SparseMatrixType;
+  typedef vnl_vector<RealType>                                OutlierVectorType;
+  typedef SparseMatrixSinkhornNormalization<RealType, 
+    SparseMatrixType, OutlierVectorType>                      NormalizerType;
+
+  /** kd-tree typedefs */
+  typedef Vector<RealType, 
+    itkGetStaticConstMacro( Dimension )>                      MeasurementVectorType;
+  typedef typename Statistics::ListSample
+    <MeasurementVectorType>                                   SampleType;
+  typedef typename Statistics
+    ::KdTreeGenerator<SampleType>                             TreeGeneratorType;
+  typedef typename TreeGeneratorType::KdTreeType              KdTreeType;
 
   /** B-spline typedefs */
   typedef PointSet<VectorType, 
@@ -103,6 +136,24 @@ public:
   itkSetMacro( UseBoundingBox, bool );
   itkGetConstMacro( UseBoundingBox, bool );
 
+  itkBooleanMacro( UseSparseCorrespondence );
+  itkSetMacro( UseSparseCorrespondence, bool );
+  itkGetConstMacro( UseSparseCorrespondence, bool );
+
+  itkSetClampMacro( CorrespondenceCutoff, RealType, 0, 1 );
+  itkGetConstMacro( CorrespondenceCutoff, RealType );
+
+  itkSetMacro( MaximumNumberOfNeighbors, unsigned int );
+  itkGetConstMacro( MaximumNumberOfNeighbors, unsigned int );
+
+  /** Number of nearest fixed points kept per row when the sparse rows are
+   * not bounded otherwise, i.e. MaximumNumberOfNeighbors is 0 and the
+   * radius is infinite (uniform correspondences before the annealing
+   * starts, or a zero CorrespondenceCutoff).  Default is 20. */
+  itkSetClampMacro( NumberOfUnboundedNeighbors, unsigned int, 1,
+    NumericTraits<unsigned int>::max() );
+  itkGetConstMacro( NumberOfUnboundedNeighbors, unsigned int );
+
   itkGetConstMacro( VPoints, typename InputPointSetType::Pointer );
   itkGetConstMacro( ControlPointLattice, typename ControlPointLatticeType::Pointer );
 
@@ -116,11 +167,20 @@ protected:
 
 private:
   void Initialize();
+  void GenerateKdTrees();
   void CalculateInitialAndFinalTemperatures();
   void UpdateCorrespondenceMatrix();
+  void ThreadedUpdateCorrespondenceMatrix( unsigned int, unsigned int );
   void NormalizeCorrespondenceMatrix();
   void UpdateTransformation();
  
+  /** Multi-threading support. */
+  struct ThreadStruct
+    {
+    Self *Filter;
+    };
+
+  static ITK_THREAD_RETURN_TYPE UpdateCorrespondenceMatrixThreaderCallback( void * );
 
   void VisualizeCurrentState();
 
@@ -130,7 +190,7 @@ private:
 
   typename InputPointSetType::Pointer                        m_VPoints;
 
-  MatrixType                                                 m_CorrespondenceMatrix;
+  SparseMatrixType                                           m_CorrespondenceMatrix;
   OutlierVectorType                                          m_OutlierRow;
   OutlierVectorType                                          m_OutlierColumn;
   typename InputPointSetType::PointType                      m_OutlierPointX;
@@ -143,6 +203,14 @@ private:
   unsigned int                                               m_NumberOfIterationsPerTemperature;
   bool                                                       m_SolveSimplerLeastSquaresProblem;
   bool                                                       m_UseBoundingBox;
+
+  bool                                                       m_UseSparseCorrespondence;
+  RealType                                                   m_CorrespondenceCutoff;
+  unsigned int                                               m_MaximumNumberOfNeighbors;
+  unsigned int                                               m_NumberOfUnboundedNeighbors;
+  typename SampleType::Pointer                               m_SamplePoints;
+  std::vector<typename TreeGeneratorType::Pointer>           m_KdTreeGenerators;
+  MultiThreader::Pointer                                     m_Threader;
     
   typename ControlPointLatticeType::Pointer                  m_ControlPointLattice;
 
@@ -9,6 +9,9 @@
 
 #include "fstream.h"
 
+#include <algorithm>
+#include <utility>
+
 namespace itk
 {
 
@@ -37,6 +40,11 @@ BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
   this->m_UseBoundingBox = true;
 
   this->m_SolveSimplerLeastSquaresProblem = false;
+
+  this->m_UseSparseCorrespondence = false;
+  this->m_CorrespondenceCutoff = 1e-6;
+  this->m_MaximumNumberOfNeighbors = 0;
+  this->m_NumberOfUnboundedNeighbors = 20;
 }
 
 template <class TPointSet, class TOutputImage>
@@ -144,18 +152,24 @@ BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
   /**
    * Initialize correspondence matrix and outlier row/column
    */
-  this->m_CorrespondenceMatrix.SetSize( 
+  this->m_CorrespondenceMatrix.set_size( 
     this->m_VPoints->GetNumberOfPoints(), this->GetInput( 0 )->GetNumberOfPoints() );
-  this->m_OutlierColumn.SetSize( this->m_VPoints->GetNumberOfPoints() );
-  this->m_OutlierRow.SetSize( this->GetInput( 0 )->GetNumberOfPoints() );
+  this->m_OutlierColumn.set_size( this->m_VPoints->GetNumberOfPoints() );
+  this->m_OutlierRow.set_size( this->GetInput( 0 )->GetNumberOfPoints() );
 
   RealType K = static_cast<RealType>( this->m_VPoints->GetNumberOfPoints() );
   RealType N = static_cast<RealType>( this->GetInput( 0 )->GetNumberOfPoints() );
 
-  this->m_CorrespondenceMatrix.Fill( 1.0 / ( N * K ) );
+  this->m_OutlierColumn.fill( 1.0 / ( 1000 * N * K ) );
+  this->m_OutlierRow.fill( 1.0 / ( 1000 * N * K ) );
 
-  this->m_OutlierColumn.Fill( 1.0 / ( 1000 * N * K ) );
-  this->m_OutlierRow.Fill( 1.0 / ( 1000 * N * K ) );
+  this->m_Threader = MultiThreader::New();
+  this->m_Threader->SetNumberOfThreads( this->GetNumberOfThreads() );
+
+  if ( this->m_UseSparseCorrespondence )
+    {
+    this->GenerateKdTrees();
+    }
 
 
   /**
@@ -193,7 +207,12 @@ BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
     this->m_OutlierPointX[d] /= N;
     }
 */
-  this->NormalizeCorrespondenceMatrix();
+
+  /**
+   * The current temperature is still infinite so the correspondences
+   * are uniform.
+   */
+  this->UpdateCorrespondenceMatrix();
 
   this->UpdateTransformation();
 
@@ -212,6 +231,48 @@ BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
   RealType maxSquaredDistance = 0;
   RealType sumMinSquaredDistance = 0;
 
+  if ( this->m_UseSparseCorrespondence )
+    {
+    /**
+     * Avoid the O( N * K ) search:  the nearest fixed point is found with
+     * the kd-tree and the largest distance is bounded by the farthest 
+     * corner of the bounding box of the fixed points.
+     */
+    const KdTreeType *tree = this->m_KdTreeGenerators[0]->GetOutput();
+    typename KdTreeType::InstanceIdentifierVectorType neighbors;
+
+    for ( unsigned int i = 0; i < this->m_VPoints->GetNumberOfPoints(); i++ )
+      {
+      typename InputPointSetType::PointType pointV;
+      this->m_VPoints->GetPoint( i, &pointV );    
+
+      MeasurementVectorType mv;
+      RealType squaredDistance = 0;
+      for ( unsigned int d = 0; d < Dimension; d++ )
+        {
+        mv[d] = pointV[d];
+        squaredDistance += vnl_math_max( 
+          vnl_math_sqr( pointV[d] - this->GetInput( 0 )->GetBoundingBox()->GetMinimum()[d] ),
+          vnl_math_sqr( pointV[d] - this->GetInput( 0 )->GetBoundingBox()->GetMaximum()[d] ) );
+        }
+      if ( squaredDistance > maxSquaredDistance )
+        {
+        maxSquaredDistance = squaredDistance;
+        } 
+
+      tree->Search( mv, 1u, neighbors );
+
+      typename InputPointSetType::PointType pointX;      
+      this->GetInput( 0 )->GetPoint( neighbors[0], &pointX );      
+      sumMinSquaredDistance += ( pointX - pointV ).GetSquaredNorm();
+      } 
+
+    this->m_InitialTemperature = maxSquaredDistance;
+    this->m_FinalTemperature = sumMinSquaredDistance 
+      / static_cast<RealType>( this->m_VPoints->GetNumberOfPoints() );
+    return;
+    }
+
   for ( unsigned int i = 0; i < this->m_VPoints->GetNumberOfPoints(); i++ )
     {
     typename InputPointSetType::PointType pointV;
@@ -249,24 +310,49 @@ BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
 template <class TPointSet, class TOutputImage>
 void
 BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
-::UpdateCorrespondenceMatrix()
+::GenerateKdTrees()
 {
-  for ( unsigned int i = 0; i < this->m_VPoints->GetNumberOfPoints(); i++ )
+  this->m_SamplePoints = SampleType::New();
+  this->m_SamplePoints->SetMeasurementVectorSize( Dimension );
+
+  for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ )
     {
-    typename InputPointSetType::PointType pointV;
-    this->m_VPoints->GetPoint( i, &pointV );    
+    typename InputPointSetType::PointType pointX;      
+    this->GetInput( 0 )->GetPoint( j, &pointX );      
 
-    for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ )
+    MeasurementVectorType mv;
+    for ( unsigned int d = 0; d < Dimension; d++ )
       {
-      typename InputPointSetType::PointType pointX;      
-      this->GetInput( 0 )->GetPoint( j, &pointX );      
- 
-      this->m_CorrespondenceMatrix( i, j )  
-        = vcl_exp( -0.5 * ( pointX - pointV ).GetSquaredNorm() / this->m_CurrentTemperature )
-          / this->m_CurrentTemperature;
+      mv[d] = pointX[d];
+      }
+    this->m_SamplePoints->PushBack( mv );
+    }
 
-      }  
-    } 
+  /**
+   * The kd-tree searches keep their state in the tree so each thread
+   * gets its own tree.  The fixed points do not move so the trees are
+   * built once.
+   */
+  this->m_KdTreeGenerators.resize( this->m_Threader->GetNumberOfThreads() );
+  for ( unsigned int n = 0; n < this->m_KdTreeGenerators.size(); n++ )
+    {
+    this->m_KdTreeGenerators[n] = TreeGeneratorType::New();
+    this->m_KdTreeGenerators[n]->SetSample( this->m_SamplePoints );
+    this->m_KdTreeGenerators[n]->SetBucketSize( 16 );
+    this->m_KdTreeGenerators[n]->Update();
+    }
+}
+
+template <class TPointSet, class TOutputImage>
+void
+BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
+::UpdateCorrespondenceMatrix()
+{
+  ThreadStruct str;
+  str.Filter = this;
+
+  this->m_Threader->SetSingleMethod( this->UpdateCorrespondenceMatrixThreaderCallback, &str );
+  this->m_Threader->SingleMethodExecute();
 
 /*
   this->m_OutlierColumn.Fill( 0 );
@@ -296,75 +382,148 @@ BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
   this->NormalizeCorrespondenceMatrix();
 }
 
+template <class TPointSet, class TOutputImage>
+ITK_THREAD_RETURN_TYPE
+BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
+::UpdateCorrespondenceMatrixThreaderCallback( void *arg )
+{
+  unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct *str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  str->Filter->ThreadedUpdateCorrespondenceMatrix( threadId, threadCount );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
 template <class TPointSet, class TOutputImage>
 void
 BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
-::NormalizeCorrespondenceMatrix()
+::ThreadedUpdateCorrespondenceMatrix( unsigned int threadId, unsigned int threadCount )
 {
-  RealType epsilon = 1e-4;
-  RealType deviation = NumericTraits<RealType>::max(); 
+  const unsigned long numberOfRows = this->m_VPoints->GetNumberOfPoints();
+  const unsigned long firstRow = ( numberOfRows * threadId ) / threadCount;
+  const unsigned long lastRow = ( numberOfRows * ( threadId + 1 ) ) / threadCount;
 
-  OutlierVectorType rowSum;
-  OutlierVectorType columnSum;
+  RealType K = static_cast<RealType>( this->m_VPoints->GetNumberOfPoints() );
+  RealType N = static_cast<RealType>( this->GetInput( 0 )->GetNumberOfPoints() );
 
-  unsigned int maximumNumberOfIterations = 100;
-  unsigned int iterations = 0;
+  /**
+   * Before the annealing starts, the temperature is infinite and the 
+   * correspondences are uniform.  Otherwise, the fixed points whose weight
+   * exp( -0.5 * d^2 / T ) is below the cutoff are dropped.
+   */
+  bool isUniform = ( this->m_CurrentTemperature == NumericTraits<RealType>::max() );
 
-  while ( vnl_math_abs( deviation ) > epsilon && iterations++ < maximumNumberOfIterations )
+  RealType squaredRadius = NumericTraits<RealType>::max();
+  if ( !isUniform && this->m_CorrespondenceCutoff > 0 )
     {
-    /**
-     * do row normalization
-     */
-    rowSum = this->m_OutlierColumn;
+    squaredRadius = -2.0 * this->m_CurrentTemperature 
+      * vcl_log( this->m_CorrespondenceCutoff );
+    }
 
-    for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.Rows(); i++ )
+  /**
+   * An infinite radius would keep every fixed point and make the sparse
+   * matrix dense, so the rows are then bounded by a nearest neighbor query.
+   */
+  unsigned int maximumNumberOfNeighbors = this->m_MaximumNumberOfNeighbors;
+  if ( maximumNumberOfNeighbors == 0 
+    && squaredRadius == NumericTraits<RealType>::max() )
+    {
+    maximumNumberOfNeighbors = this->m_NumberOfUnboundedNeighbors;
+    }
+  unsigned int numberOfNeighbors = vnl_math_min( maximumNumberOfNeighbors, 
+    static_cast<unsigned int>( this->GetInput( 0 )->GetNumberOfPoints() ) );
+
+  std::vector<std::pair<int, RealType> > entries;
+  vcl_vector<int> columns;
+  vcl_vector<RealType> values;
+  typename KdTreeType::InstanceIdentifierVectorType neighbors;
+
+  for ( unsigned long i = firstRow; i < lastRow; i++ )
+    {
+    typename InputPointSetType::PointType pointV;
+    this->m_VPoints->GetPoint( i, &pointV );    
+
+    entries.clear();
+    if ( this->m_UseSparseCorrespondence )
       {
-      for ( unsigned int j = 0; j < this->m_CorrespondenceMatrix.Cols(); j++ )
+      MeasurementVectorType mv;
+      for ( unsigned int d = 0; d < Dimension; d++ )
         {
-        rowSum[i] += this->m_CorrespondenceMatrix( i, j );
+        mv[d] = pointV[d];
         }
-      } 
-    for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.Rows(); i++ )
-      {
-      for ( unsigned int j = 0; j < this->m_CorrespondenceMatrix.Cols(); j++ )
+
+      const KdTreeType *tree = this->m_KdTreeGenerators[threadId]->GetOutput();
+      if ( numberOfNeighbors > 0 )
         {
-        this->m_CorrespondenceMatrix( i, j ) /= rowSum[i];
+        tree->Search( mv, numberOfNeighbors, neighbors );
         }
-      this->m_OutlierColumn[i] /= rowSum[i];
-      } 
-    
-
-    /**
-     * do column normalization
-     */
-    columnSum = this->m_OutlierRow;
+      else
+        {
+        tree->Search( mv, vcl_sqrt( squaredRadius ), neighbors );
+        }  
 
-    for ( unsigned int j = 0; j < this->m_CorrespondenceMatrix.Cols(); j++ )
-      {
-      for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.Rows(); i++ )
+      for ( unsigned int n = 0; n < neighbors.size(); n++ )
         {
-        columnSum[j] += this->m_CorrespondenceMatrix( i, j );
+        typename InputPointSetType::PointType pointX;      
+        this->GetInput( 0 )->GetPoint( neighbors[n], &pointX );      
+
+        RealType squaredDistance = ( pointX - pointV ).GetSquaredNorm();
+        if ( squaredDistance <= squaredRadius )
+          {
+          entries.push_back( std::make_pair( 
+            static_cast<int>( neighbors[n] ), squaredDistance ) );
+          }
         }
-      } 
-    for ( unsigned int j = 0; j < this->m_CorrespondenceMatrix.Cols(); j++ )
+      std::sort( entries.begin(), entries.end() );
+      }
+    else
       {
-      for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.Rows(); i++ )
+      for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ )
         {
-        this->m_CorrespondenceMatrix( i, j ) /= columnSum[j];
-        }
-      this->m_OutlierRow[j] /= columnSum[j];
-      } 
+        typename InputPointSetType::PointType pointX;      
+        this->GetInput( 0 )->GetPoint( j, &pointX );      
 
-    /**
-     * Calculate current deviation from 1
-     */
-    rowSum -= 1.0;
-    columnSum -= 1.0;
+        entries.push_back( std::make_pair( 
+          static_cast<int>( j ), ( pointX - pointV ).GetSquaredNorm() ) );
+        }  
+      }
 
-    deviation = ( rowSum.GetSquaredNorm() + columnSum.GetSquaredNorm() )
-      / ( static_cast<RealType>( rowSum.GetSize() + columnSum.GetSize() ) );
-    }  
+    columns.resize( entries.size() );
+    values.resize( entries.size() );
+    for ( unsigned int n = 0; n < entries.size(); n++ )
+      {
+      columns[n] = entries[n].first;
+      if ( isUniform )
+        {
+        values[n] = 1.0 / ( N * K );
+        }
+      else
+        {  
+        values[n] = vcl_exp( -0.5 * entries[n].second / this->m_CurrentTemperature )
+          / this->m_CurrentTemperature;
+        }
+      }
+    this->m_CorrespondenceMatrix.set_row( i, columns, values );
+    } 
+}
 
+template <class TPointSet, class TOutputImage>
+void
+BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
+::NormalizeCorrespondenceMatrix()
+{
+  typename NormalizerType::Pointer normalizer = NormalizerType::New();
+  normalizer->SetMatrix( &this->m_CorrespondenceMatrix );
+  normalizer->SetOutlierColumn( &this->m_OutlierColumn );
+  normalizer->SetOutlierRow( &this->m_OutlierRow );
+  normalizer->SetTolerance( 1e-4 );
+  normalizer->SetMaximumNumberOfIterations( 100 );
+  normalizer->NormalizeRowsFirstOn();
+  normalizer->SetNumberOfThreads( this->GetNumberOfThreads() );
+  normalizer->Update();
 }
 
 template <class TPointSet, class TOutputImage>
@@ -382,21 +541,24 @@ BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
     typename InputPointSetType::PointType V;
     this->m_VPoints->GetPoint( i, &V );
 
+    typename SparseMatrixType::row &rw = this->m_CorrespondenceMatrix.get_row( i );
+    typename SparseMatrixType::row::iterator ri;
+
     if ( this->m_SolveSimplerLeastSquaresProblem )
       { 
       typename InputPointSetType::PointType Y;
       Y.Fill( 0 );
       RealType weight = 0;
-      for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ ) 
+      for ( ri = rw.begin(); ri != rw.end(); ++ri ) 
         {
         typename InputPointSetType::PointType X;
-        this->GetInput( 0 )->GetPoint( j, &X );
+        this->GetInput( 0 )->GetPoint( (*ri).first, &X );
         for ( unsigned int d = 0; d < Dimension; d++ )
           {
-          Y[d] += ( X[d] * this->m_CorrespondenceMatrix( i, j ) ); 
+          Y[d] += ( X[d] * (*ri).second ); 
           }
         
-        weight += this->m_CorrespondenceMatrix( i, j );
+        weight += (*ri).second;
         }
       VectorType vector = Y - V;
 
@@ -407,20 +569,20 @@ BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
       }
     else
       {
-      for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ ) 
+      for ( ri = rw.begin(); ri != rw.end(); ++ri ) 
         {
-        if ( this->m_CorrespondenceMatrix( i, j ) <= 0 )
+        if ( (*ri).second <= 0 )
           {
           continue;
           } 
         typename InputPointSetType::PointType X;
-        this->GetInput( 0 )->GetPoint( j, &X );
+        this->GetInput( 0 )->GetPoint( (*ri).first, &X );
 
         VectorType vector = X - V;
 
         points->SetPoint( count, V );  
         points->SetPointData( count, vector );
-        weights->InsertElement( count, this->m_CorrespondenceMatrix( i, j ) );
+        weights->InsertElement( count, (*ri).second );
         count++;
         }
       }     
@@ -489,12 +651,14 @@ BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
     typename InputPointSetType::PointType V;
     this->m_VPoints->GetPoint( i, &V );
 
-    for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ ) 
+    typename SparseMatrixType::row &rw = this->m_CorrespondenceMatrix.get_row( i );
+    typename SparseMatrixType::row::iterator ri;
+    for ( ri = rw.begin(); ri != rw.end(); ++ri ) 
       {
       typename InputPointSetType::PointType X;
-      this->GetInput( 0 )->GetPoint( j, &X );
+      this->GetInput( 0 )->GetPoint( (*ri).first, &X );
 
-      error += ( this->m_CorrespondenceMatrix( i, j ) * ( X - V ).GetNorm() );  
+      error += ( (*ri).second * ( X - V ).GetNorm() );  
       }
     }     
 
@@ -530,12 +694,14 @@ BSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
     typename InputPointSetType::PointType V;
     this->m_VPoints->GetPoint( i, &V );
 
-    for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ ) 
+    typename SparseMatrixType::row &rw = this->m_CorrespondenceMatrix.get_row( i );
+    typename SparseMatrixType::row::iterator ri;
+    for ( ri = rw.begin(); ri != rw.end(); ++ri ) 
       {
       typename InputPointSetType::PointType X;
-      this->GetInput( 0 )->GetPoint( j, &X );
+      this->GetInput( 0 )->GetPoint( (*ri).first, &X );
 
-      error += ( this->m_CorrespondenceMatrix(i, j) * ( X - V ).GetNorm() );  
+      error += ( (*ri).second * ( X - V ).GetNorm() );  
       }
     }     
 
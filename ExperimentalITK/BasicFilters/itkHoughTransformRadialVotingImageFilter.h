@@ -55,6 +55,10 @@
 #include <itkGaussianDistribution.h>
 #include "itkAddImageFilter.h"
 #include "itkImageRegionIterator.h"
+#include "itkConstNeighborhoodIterator.h"
+
+#include <list>
+#include <vector>
 
 namespace itk
 {
@@ -75,6 +79,16 @@ namespace itk
  * point and votes on a small region defined using the minimum and maximum
  * radius given by the user, and fill in the array of radii.
  *
+ *  The Gaussian vote kernel only depends on the radii and on the spacing so
+ * it is tabulated once (the vote stamp) before voting.  Each thread votes
+ * into its own accumulator covering its region of the input plus the voting
+ * reach; the thread accumulators are summed at the end so no
+ * synchronization is needed.
+ *
+ *  GetSpheres() extracts the local maxima of the blurred accumulator in a
+ * single pass and keeps the strongest ones, discarding the maxima which fall
+ * inside the box (SphereRadiusRatio times the radius) of a stronger sphere.
+ *
  * \ingroup ImageFeatureExtraction
  * \todo Update the doxygen documentation!!!
  * */
@@ -125,6 +139,9 @@ public:
   typedef typename InternalImageType::SizeType        InternalSizeType;
   typedef typename InternalSizeType::SizeValueType    InternalSizeValueType;
   typedef typename InternalImageType::SpacingType     InternalSpacingType;
+  typedef typename InternalImageType::OffsetType      InternalOffsetType;
+  typedef typename InternalImageType::OffsetValueType InternalOffsetValueType;
+  typedef Vector< double, ImageDimension >            VoteVectorType;
 
   /** Sphere typedef */
   typedef EllipseSpatialObject< ImageDimension > SphereType;
@@ -269,6 +286,17 @@ protected:
   unsigned int          m_NbOfThreads;
   bool                  m_AllSeedsProcessed;
 
+  /** Vote stamp: offsets from the voted center, their physical
+   *  coordinates and the Gaussian weight of the vote */
+  InternalSizeType                    m_VoteStampRadius;
+  std::vector< InternalOffsetType >   m_VoteStampOffsets;
+  std::vector< VoteVectorType >       m_VoteStampPoints;
+  std::vector< InternalPixelType >    m_VoteStampWeights;
+
+  /** Per-thread accumulator and radius images */
+  std::vector< InternalImagePointer > m_ThreadAccumulatorImages;
+  std::vector< InternalImagePointer > m_ThreadRadiusImages;
+
 
   /** Method for evaluating the implicit function over the image. */
   virtual void BeforeThreadedGenerateData();
@@ -291,6 +319,9 @@ protected:
 
   void ComputeMeanRadiusImage( );
 
+  /** Tabulate the Gaussian vote kernel */
+  void ComputeVoteStamp( );
+
 
 
 private:
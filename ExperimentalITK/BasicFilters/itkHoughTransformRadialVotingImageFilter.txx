@@ -43,6 +43,9 @@
 
 #include "itkHoughTransformRadialVotingImageFilter.h"
 
+#include <algorithm>
+#include <functional>
+#include <utility>
 
 namespace itk
 {
@@ -106,6 +109,61 @@ HoughTransformRadialVotingImageFilter< TInputImage, TOutputImage>
     }
 }
 
+template<class TInputImage, class TOutputImage>
+void
+HoughTransformRadialVotingImageFilter< TInputImage, TOutputImage>
+::ComputeVoteStamp()
+{
+  InputSpacingType spacing = this->GetInput()->GetSpacing();
+
+  InputCoordType averageRadius = 0.5 * ( m_MinimumRadius + m_MaximumRadius );
+  InputCoordType averageRadius2 = averageRadius * averageRadius;
+
+  unsigned int numberOfVotes = 1;
+  for ( unsigned int i = 0; i < ImageDimension; i++ )
+    {
+    InputCoordType rad = m_VotingRadiusRatio * m_MinimumRadius/spacing[i];
+    m_VoteStampRadius[i] = static_cast<InternalSizeValueType>( rad );
+    numberOfVotes *= 1 + 2 * m_VoteStampRadius[i];
+    }
+
+  m_VoteStampOffsets.resize( numberOfVotes );
+  m_VoteStampPoints.resize( numberOfVotes );
+  m_VoteStampWeights.resize( numberOfVotes );
+
+  // Same ordering as a region iterator over the voting region
+  InternalOffsetType offset;
+  for ( unsigned int i = 0; i < ImageDimension; i++ )
+    {
+    offset[i] = -static_cast<InternalOffsetValueType>( m_VoteStampRadius[i] );
+    }
+
+  for ( unsigned int n = 0; n < numberOfVotes; n++ )
+    {
+    double d = 0;
+    for ( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      m_VoteStampPoints[n][i] = static_cast<double>( offset[i] ) * spacing[i];
+      d += vnl_math_sqr( m_VoteStampPoints[n][i] );
+      }
+    m_VoteStampOffsets[n] = offset;
+
+    // Apply a normal distribution weight;
+    m_VoteStampWeights[n] = static_cast<InternalPixelType>(
+      GaussianFunctionType::EvaluatePDF( vcl_sqrt( d ), 0, averageRadius2 ) );
+
+    for ( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      if ( offset[i] < static_cast<InternalOffsetValueType>( m_VoteStampRadius[i] ) )
+        {
+        ++offset[i];
+        break;
+        }
+      offset[i] = -static_cast<InternalOffsetValueType>( m_VoteStampRadius[i] );
+      }
+    }
+}
+
 template<class TInputImage, class TOutputImage>
 void
 HoughTransformRadialVotingImageFilter< TInputImage, TOutputImage>
@@ -130,6 +188,14 @@ HoughTransformRadialVotingImageFilter< TInputImage, TOutputImage>
   m_RadiusImage->SetDirection( inputImage->GetDirection() );
   m_RadiusImage->Allocate();
   m_RadiusImage->FillBuffer( 0 );
+
+  this->ComputeVoteStamp();
+
+  // The thread images are allocated by each thread over its own region
+  m_ThreadAccumulatorImages.clear();
+  m_ThreadAccumulatorImages.resize( this->GetNumberOfThreads() );
+  m_ThreadRadiusImages.clear();
+  m_ThreadRadiusImages.resize( this->GetNumberOfThreads() );
 }
 
 template<class TInputImage, class TOutputImage>
@@ -137,6 +203,29 @@ void
 HoughTransformRadialVotingImageFilter< TInputImage, TOutputImage>
 ::AfterThreadedGenerateData()
 {
+  // Sum the votes of each thread
+  for ( unsigned int n = 0; n < m_ThreadAccumulatorImages.size(); n++ )
+    {
+    if ( !m_ThreadAccumulatorImages[n] )
+      {
+      continue;
+      }
+    InternalRegionType region = m_ThreadAccumulatorImages[n]->GetBufferedRegion();
+
+    ImageRegionConstIterator< InternalImageType > tAccIt( m_ThreadAccumulatorImages[n], region );
+    ImageRegionConstIterator< InternalImageType > tRadIt( m_ThreadRadiusImages[n], region );
+    InternalIteratorType accIt( m_AccumulatorImage, region );
+    InternalIteratorType radIt( m_RadiusImage, region );
+    for ( tAccIt.GoToBegin(), tRadIt.GoToBegin(), accIt.GoToBegin(), radIt.GoToBegin();
+      !tAccIt.IsAtEnd(); ++tAccIt, ++tRadIt, ++accIt, ++radIt )
+      {
+      accIt.Set( accIt.Get() + tAccIt.Get() );
+      radIt.Set( radIt.Get() + tRadIt.Get() );
+      }
+    }
+  m_ThreadAccumulatorImages.clear();
+  m_ThreadRadiusImages.clear();
+
   ComputeMeanRadiusImage();
 
   // Copy the typecast m_AccumulatorImage to Output image
@@ -168,8 +257,6 @@ ThreadedGenerateData(const OutputImageRegionType& windowRegion,
   DoGFunction->SetInputImage( inputImage );
   DoGFunction->SetSigma( m_SigmaGradient );
 
-  GaussianFunctionPointer GaussianFunction = GaussianFunctionType::New();
-
   unsigned int i;
 
   InternalRegionType region;
@@ -179,15 +266,50 @@ ThreadedGenerateData(const OutputImageRegionType& windowRegion,
   DoGVectorType grad;
   typename DoGVectorType::ValueType norm2, inv_norm;
 
-  Index< ImageDimension > index, indexAtVote, center;
-  InputCoordType distance;
+  Index< ImageDimension > index, center;
+  VoteVectorType centerToIndex;
 
-  double d;
   InputCoordType averageRadius = 0.5 * ( m_MinimumRadius + m_MaximumRadius );
-  InputCoordType averageRadius2 = averageRadius * averageRadius;
 
-  InputCoordType rad;
-  double weight;
+  // The votes of this thread are accumulated in images covering the
+  // window region plus the maximum distance of a vote
+  InternalSizeType reach;
+  for ( i = 0; i < ImageDimension; i++ )
+    {
+    reach[i] = m_VoteStampRadius[i] + 1 + static_cast<InternalSizeValueType>(
+      vcl_ceil( averageRadius/spacing[i] ) );
+    }
+  InternalRegionType threadRegion = windowRegion;
+  threadRegion.PadByRadius( reach );
+  threadRegion.Crop( inputImage->GetRequestedRegion() );
+
+  InternalImagePointer accumulator = InternalImageType::New();
+  accumulator->CopyInformation( m_AccumulatorImage );
+  accumulator->SetRegions( threadRegion );
+  accumulator->Allocate();
+  accumulator->FillBuffer( 0 );
+
+  InternalImagePointer radius = InternalImageType::New();
+  radius->CopyInformation( m_RadiusImage );
+  radius->SetRegions( threadRegion );
+  radius->Allocate();
+  radius->FillBuffer( 0 );
+
+  m_ThreadAccumulatorImages[threadId] = accumulator;
+  m_ThreadRadiusImages[threadId] = radius;
+
+  InternalPixelType *accumulatorBuffer = accumulator->GetBufferPointer();
+  InternalPixelType *radiusBuffer = radius->GetBufferPointer();
+
+  // Stamp offsets in the thread buffers
+  const unsigned int numberOfVotes = m_VoteStampOffsets.size();
+  std::vector< InternalOffsetValueType > bufferOffsets( numberOfVotes );
+  for ( unsigned int n = 0; n < numberOfVotes; n++ )
+    {
+    bufferOffsets[n] = accumulator->ComputeOffset(
+      threadRegion.GetIndex() + m_VoteStampOffsets[n] ) -
+      accumulator->ComputeOffset( threadRegion.GetIndex() );
+    }
 
   ImageRegionConstIteratorWithIndex< InputImageType >
     image_it( inputImage, windowRegion );
@@ -224,10 +346,10 @@ ThreadedGenerateData(const OutputImageRegionType& windowRegion,
             {
             center[i] = index[i] - static_cast< InternalIndexValueType >(
               averageRadius * grad[i]/spacing[i] );
+            centerToIndex[i] = static_cast<double>( center[i] - index[i] ) * spacing[i];
 
-            rad = m_VotingRadiusRatio * m_MinimumRadius/spacing[i];
-            start[i] = center[i] - static_cast<InternalIndexValueType>( rad );
-            size[i] = 1 + 2 * static_cast<InternalSizeValueType>( rad );
+            start[i] = center[i] - static_cast<InternalIndexValueType>( m_VoteStampRadius[i] );
+            size[i] = 1 + 2 * m_VoteStampRadius[i];
             }
 
           region.SetSize( size );
@@ -235,33 +357,19 @@ ThreadedGenerateData(const OutputImageRegionType& windowRegion,
 
           if ( inputImage->GetRequestedRegion().IsInside( region ) )
             {
-            ImageRegionIteratorWithIndex< InternalImageType >
-              It1( m_AccumulatorImage, region );
-            ImageRegionIterator< InternalImageType > It2( m_RadiusImage, region );
-            It1.GoToBegin();
-            It2.GoToBegin();
+            const InternalOffsetValueType centerOffset = accumulator->ComputeOffset( center );
+            const double centerToIndex2 = centerToIndex.GetSquaredNorm();
 
-            while ( !It1.IsAtEnd() )
+            for ( unsigned int n = 0; n < numberOfVotes; n++ )
               {
-              indexAtVote = It1.GetIndex();
-              distance = 0;
-              d = 0;
-              for ( i = 0; i < ImageDimension; i++ )
-                {
-                d += vnl_math_sqr(
-                  static_cast<double>( indexAtVote[i] - center[i] ) * spacing[i] );
-                distance += vnl_math_sqr(
-                  static_cast<InputCoordType>( indexAtVote[i] - index[i] ) * spacing[i] );
-                }
-              d = vcl_sqrt( d );
-              distance = vcl_sqrt( distance );
-
-              // Apply a normal distribution weight;
-              weight = GaussianFunction->EvaluatePDF( d, 0, averageRadius2 );
-              It1.Set( It1.Get() + weight );
-              It2.Set( It2.Get() + distance*weight );
-              ++It1;
-              ++It2;
+              // distance between the edge point and the voted point
+              const double distance = vcl_sqrt( vnl_math_max( 0.0, centerToIndex2 +
+                2.0 * ( centerToIndex * m_VoteStampPoints[n] ) +
+                m_VoteStampPoints[n].GetSquaredNorm() ) );
+
+              const InternalOffsetValueType k = centerOffset + bufferOffsets[n];
+              accumulatorBuffer[k] += m_VoteStampWeights[n];
+              radiusBuffer[k] += static_cast<InternalPixelType>( distance ) * m_VoteStampWeights[n];
               }
             }
           } // end counter
@@ -321,35 +429,78 @@ HoughTransformRadialVotingImageFilter< TInputImage, TOutputImage>
 
   InternalImagePointer postProcessImage = gaussianFilter->GetOutput();
   InternalSpacingType spacing = postProcessImage->GetSpacing();
-  InternalSizeType size = postProcessImage->GetRequestedRegion().GetSize();
 
-  MinMaxCalculatorPointer minMaxCalculator = MinMaxCalculatorType::New();
-  minMaxCalculator->SetImage( postProcessImage );
-  minMaxCalculator->ComputeMaximum();
+  // Find the local maxima of the blurred accumulator in a single pass
+  typedef ConstNeighborhoodIterator< InternalImageType > NeighborhoodIteratorType;
+  typename NeighborhoodIteratorType::RadiusType radius;
+  radius.Fill( 1 );
+
+  NeighborhoodIteratorType nIt( radius, postProcessImage,
+    postProcessImage->GetRequestedRegion() );
+  const unsigned int neighborhoodSize = nIt.Size();
+
+  typedef std::pair< InternalPixelType, InternalOffsetValueType > PeakType;
+  std::vector< PeakType > peaks;
+
+  InternalPixelType pmax = NumericTraits< InternalPixelType >::NonpositiveMin();
+
+  for ( nIt.GoToBegin(); !nIt.IsAtEnd(); ++nIt )
+    {
+    const InternalPixelType value = nIt.GetCenterPixel();
+    bool isMaximum = true;
+    for ( unsigned int k = 0; k < neighborhoodSize && isMaximum; k++ )
+      {
+      isMaximum = ( nIt.GetPixel( k ) <= value );
+      }
+    if ( isMaximum )
+      {
+      peaks.push_back( PeakType( value,
+        postProcessImage->ComputeOffset( nIt.GetIndex() ) ) );
+      pmax = vnl_math_max( pmax, value );
+      }
+    }
+
+  std::sort( peaks.begin(), peaks.end(), std::greater< PeakType >() );
+
+  // Keep the strongest maxima which are not within the box of a stronger
+  // sphere
+  std::vector< InternalIndexType > centers;
+  std::vector< InternalSizeType > boxes;
 
-  InternalPixelType  pmax = minMaxCalculator->GetMaximum();
   InternalIndexType idx;
-  InternalPixelType max;
-  InternalRegionType region;
-  InternalIndexType start, end;
-  InternalSizeType sizeOfROI;
-  InternalIndexValueType rad;
+  InternalSizeType box;
 
   unsigned int circles=0;
   unsigned int i;
 
-  // Find maxima
-  do
+  for ( unsigned int p = 0; p < peaks.size() && circles < m_NumberOfSpheres; p++ )
     {
-    minMaxCalculator->ComputeMaximum();
-    max = minMaxCalculator->GetMaximum();
-    idx = minMaxCalculator->GetIndexOfMaximum();
-
-    if ( max < m_OutputThreshold * pmax )
+    if ( peaks[p].first < m_OutputThreshold * pmax )
       {
       break;
       }
 
+    idx = postProcessImage->ComputeIndex( peaks[p].second );
+
+    bool isSuppressed = false;
+    for ( unsigned int c = 0; c < centers.size() && !isSuppressed; c++ )
+      {
+      isSuppressed = true;
+      for ( i = 0; i < ImageDimension; i++ )
+        {
+        if ( vnl_math_abs( idx[i] - centers[c][i] ) >
+          static_cast<InternalIndexValueType>( boxes[c][i] ) )
+          {
+          isSuppressed = false;
+          break;
+          }
+        }
+      }
+    if ( isSuppressed )
+      {
+      continue;
+      }
+
     SphereVectorType center;
     for ( i = 0; i < ImageDimension; i++ )
       {
@@ -365,46 +516,17 @@ HoughTransformRadialVotingImageFilter< TInputImage, TOutputImage>
 
     m_SpheresList.push_back(Sphere);
 
-    // Remove a black disc from the hough space domain
+    // Box around the sphere where weaker maxima are discarded
     for( i = 0; i < ImageDimension; i++ )
       {
-      rad = static_cast<InternalIndexValueType>(
+      box[i] = static_cast<InternalSizeValueType>(
         m_SphereRadiusRatio * Sphere->GetRadius()[i]/spacing[i] );
-
-      if( idx[i] > static_cast<InternalIndexValueType>( rad ) )
-        {
-        start[i] = idx[i] - static_cast<InternalIndexValueType>( rad );
-        }
-      else
-        {
-        start[i] = 0;
-        }
-
-      if( idx[i] + rad < static_cast<InternalIndexValueType>( size[i] - 1 ) )
-        {
-        end[i] = idx[i] + static_cast<InternalIndexValueType>( rad );
-        }
-      else
-        {
-        end[i] = postProcessImage->GetLargestPossibleRegion().GetSize()[i] - 1;
-        }
-
-      sizeOfROI[i] = end[i] - start[i] + 1;
-      }
-
-    region.SetSize( sizeOfROI );
-    region.SetIndex( start );
-
-    ImageRegionIterator<InternalImageType> It( postProcessImage, region );
-    It.GoToBegin();
-    while( !It.IsAtEnd() )
-      {
-      It.Set( 0 );
-      ++It;
       }
+    centers.push_back( idx );
+    boxes.push_back( box );
 
     ++circles;
-    } while(circles < m_NumberOfSpheres);
+    }
 
   m_OldModifiedTime = this->GetMTime();
 
@@ -21,9 +21,9 @@
 
 #include "itkGradientImageFilter.h"
 #include "itkPolyLineParametricPath.h"
+#include "itkRadixHeap.h"
 
 #include <vector>
-#include <queue>
 
 namespace itk
 {
@@ -39,6 +39,16 @@ namespace itk
  * \reference
  * W. A. Barrett and E. N. Mortenson, "Interactive live-wire boundary 
  * extraction", Medical Image Analysis, 1(4):331-341, 1996/7.
+ *
+ * The shortest paths from the anchor seed are computed lazily: Dijkstra's
+ * algorithm is only run until the requested index is settled and the
+ * search state is kept, so that subsequent evaluations from the same anchor
+ * continue from the pixels already settled.  The search is also restricted
+ * to a band of SearchBandWidth (physical units) around the segment joining
+ * the anchor to the requested index if this width is positive.  In that
+ * case the state is only reused for the same requested index.  Changing
+ * the anchor seed or any other parameter restarts the search.
+ *
  * \ingroup ImageFunctions
  */
 template <class TInputImage>
@@ -94,19 +104,11 @@ public:
     itkGetStaticConstMacro( ImageDimension )>               MaskImageType;
   typedef typename MaskImageType::PixelType                 MaskPixelType;
 
-  struct NodeType 
-    {
-    IndexType index;
-    RealType cost;
-
-    const bool operator>( const NodeType &node ) const
-      {
-      return cost > node.cost;
-      } 
-    };
-
-  typedef std::priority_queue<RealType, 
-    std::vector<NodeType>, std::greater<NodeType> >         PriorityQueueType;
+  typedef typename InputImageType::OffsetType               OffsetType;
+  typedef typename PointType::VectorType                    VectorType;
+  typedef Image<bool, 
+    itkGetStaticConstMacro( ImageDimension )>               BooleanImageType;
+  typedef RadixHeap<IndexType>                              HeapType;
 
   /** Set the input image.
    * \warning this method caches BufferedRegion information.
@@ -155,6 +157,8 @@ public:
   itkSetMacro( MaskImage, typename MaskImageType::Pointer );
   itkGetConstMacro( MaskImage, typename MaskImageType::Pointer );
 
+  /** Cost of the paths from the anchor seed.  Only the settled pixels hold
+   * their final cost, the others hold a tentative cost or the maximum. */
   itkGetConstMacro( PathDirectionCostImage, typename RealImageType::Pointer );
 
   itkSetMacro( InsidePixelValue, MaskPixelType );
@@ -166,15 +170,22 @@ public:
     if ( this->m_AnchorSeed != index ) 
       {
       this->m_AnchorSeed = index;
-      if ( this->GetInputImage() != NULL )
-        {
-        this->GeneratePathDirectionImage();
-        }
+      this->m_IsSearchInitialized = false;
       this->Modified(); 
       } 
     } 
   itkGetConstMacro( AnchorSeed, IndexType );
 
+  /** Half width (physical units) of the band around the segment from the
+   * anchor seed to the requested index outside of which no path is
+   * searched.  Default is 0 (no band). */
+  itkSetClampMacro( SearchBandWidth, RealType, 0, 
+                    NumericTraits<RealType>::max() );
+  itkGetConstMacro( SearchBandWidth, RealType );
+
+  /** Number of pixels settled by the current search. */
+  itkGetConstMacro( NumberOfSettledPixels, unsigned long );
+
   itkSetMacro( UseFaceConnectedness, bool );
   itkGetConstMacro( UseFaceConnectedness, bool );
   itkBooleanMacro( UseFaceConnectedness );
@@ -197,7 +208,18 @@ private:
   LiveWireImageFunction(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
 
-  void GeneratePathDirectionImage();
+  /** Reset the search state to the anchor seed for the given target. */
+  void InitializeSearch( const IndexType & ) const;
+
+  /** Run Dijkstra's algorithm until the given index is settled.  Returns
+   * false if it cannot be reached (mask or search band). */
+  bool ExpandSearch( const IndexType & ) const;
+
+  /** Local cost of the link from a pixel to its n-th neighbor. */
+  RealType ComputeLocalCost( const IndexType &, const IndexType &, 
+    unsigned int ) const;
+
+  bool IsInsideSearchBand( const IndexType & ) const;
 
   RealType                                   m_GradientMagnitudeWeight;
   RealType                                   m_ZeroCrossingWeight;
@@ -208,13 +230,27 @@ private:
   typename RealImageType::Pointer            m_RescaledGradientMagnitudeImage;  
   typename RealImageType::Pointer            m_ZeroCrossingImage;
   
-  typename OffsetImageType::Pointer          m_PathDirectionImage;
-  typename RealImageType::Pointer            m_PathDirectionCostImage;
+  /** Search state, updated by the (const) evaluation methods */
+  mutable typename OffsetImageType::Pointer  m_PathDirectionImage;
+  mutable typename RealImageType::Pointer    m_PathDirectionCostImage;
+  mutable typename BooleanImageType::Pointer m_SettledImage;
+  mutable HeapType                           m_Heap;
+  mutable bool                               m_IsSearchInitialized;
+  mutable unsigned long                      m_SearchMTime;
+  mutable IndexType                          m_SearchTarget;
+  mutable unsigned long                      m_NumberOfSettledPixels;
+
+  /** Neighbor offsets with their length and physical link vector */
+  mutable std::vector<OffsetType>            m_NeighborOffsets;
+  mutable std::vector<RealType>              m_NeighborScaleFactors;
+  mutable std::vector<VectorType>            m_NeighborVectors;
+  mutable std::vector<RealType>              m_NeighborVectorNorms;
 
   typename MaskImageType::Pointer            m_MaskImage;
   MaskPixelType                              m_InsidePixelValue;
 
   IndexType                                  m_AnchorSeed;
+  RealType                                   m_SearchBandWidth;
 
   bool                                       m_UseFaceConnectedness;
   bool                                       m_UseImageSpacing;
@@ -21,7 +21,7 @@
 #include "itkLiveWireImageFunction.h"
 
 #include "itkCastImageFilter.h"
-#include "itkConstNeighborhoodIterator.h"
+#include "itkImageRegionIterator.h"
 #include "itkNeighborhood.h"
 #include "itkRescaleIntensityImageFilter.h"
 #include "itkZeroCrossingBasedEdgeDetectionImageFilter.h"
@@ -49,6 +49,12 @@ LiveWireImageFunction<TInputImage>
   this->m_InsidePixelValue = NumericTraits<MaskPixelType>::One;
 
   this->m_AnchorSeed.Fill( 0 );
+  this->m_SearchBandWidth = 0.0;
+
+  this->m_IsSearchInitialized = false;
+  this->m_SearchMTime = 0;
+  this->m_SearchTarget.Fill( 0 );
+  this->m_NumberOfSettledPixels = 0;
 }
  
 // Destructor
@@ -121,13 +127,13 @@ LiveWireImageFunction<TInputImage>
     this->m_ZeroCrossingImage = zeroCrossing->GetOutput();
     }
 
-  this->GeneratePathDirectionImage();
+  this->m_IsSearchInitialized = false;
 }
 
 template <class TInputImage>
 void
 LiveWireImageFunction<TInputImage>
-::GeneratePathDirectionImage()
+::InitializeSearch( const IndexType &target ) const
 {
   if ( !this->IsInsideBuffer( this->m_AnchorSeed ) )
     {
@@ -137,87 +143,90 @@ LiveWireImageFunction<TInputImage>
   /**
    * Initialize data structures
    */
-  typedef Image<bool, ImageDimension> BooleanImageType;
-  typename BooleanImageType::Pointer expanded = BooleanImageType::New();
-  expanded->SetOrigin( this->GetInputImage()->GetOrigin() );
-  expanded->SetSpacing( this->GetInputImage()->GetSpacing() );
-  expanded->SetRegions( this->GetInputImage()->GetRequestedRegion() );
-  expanded->Allocate();
-  expanded->FillBuffer( false );
-  expanded->SetPixel( this->m_AnchorSeed, true );
-
-  this->m_PathDirectionImage = OffsetImageType::New();
-  this->m_PathDirectionImage->SetOrigin( this->GetInputImage()->GetOrigin() );
-  this->m_PathDirectionImage->SetSpacing( this->GetInputImage()->GetSpacing() );
-  this->m_PathDirectionImage->SetRegions( this->GetInputImage()->GetRequestedRegion() );
-  this->m_PathDirectionImage->Allocate();
-
-  this->m_PathDirectionCostImage = RealImageType::New();
-  this->m_PathDirectionCostImage->SetOrigin( this->GetInputImage()->GetOrigin() );
-  this->m_PathDirectionCostImage->SetSpacing( this->GetInputImage()->GetSpacing() );
-  this->m_PathDirectionCostImage->SetRegions( this->GetInputImage()->GetRequestedRegion() );
-  this->m_PathDirectionCostImage->Allocate();
-  this->m_PathDirectionCostImage->FillBuffer( 0 );
- 
-  typename ConstNeighborhoodIterator<InputImageType>::RadiusType radius;
-  radius.Fill( 1 );
-  ConstNeighborhoodIterator<BooleanImageType> It( radius, expanded, 
-    expanded->GetRequestedRegion() );
-  unsigned int numberOfNeighbors = 1;
-  for ( unsigned int d = 0; d < ImageDimension; d++ )
+  InputImageRegionType region = this->GetInputImage()->GetRequestedRegion();
+
+  if ( !this->m_SettledImage || 
+       this->m_SettledImage->GetBufferedRegion() != region )
     {
-    numberOfNeighbors *= ( 2*radius[d] + 1 ); 
+    this->m_SettledImage = BooleanImageType::New();
+    this->m_SettledImage->SetOrigin( this->GetInputImage()->GetOrigin() );
+    this->m_SettledImage->SetSpacing( this->GetInputImage()->GetSpacing() );
+    this->m_SettledImage->SetRegions( region );
+    this->m_SettledImage->Allocate();
+
+    this->m_PathDirectionImage = OffsetImageType::New();
+    this->m_PathDirectionImage->SetOrigin( this->GetInputImage()->GetOrigin() );
+    this->m_PathDirectionImage->SetSpacing( this->GetInputImage()->GetSpacing() );
+    this->m_PathDirectionImage->SetRegions( region );
+    this->m_PathDirectionImage->Allocate();
+
+    this->m_PathDirectionCostImage = RealImageType::New();
+    this->m_PathDirectionCostImage->SetOrigin( this->GetInputImage()->GetOrigin() );
+    this->m_PathDirectionCostImage->SetSpacing( this->GetInputImage()->GetSpacing() );
+    this->m_PathDirectionCostImage->SetRegions( region );
+    this->m_PathDirectionCostImage->Allocate();
     }
-  Neighborhood<RealType, ImageDimension> scaleFactors;
-  scaleFactors.SetRadius( radius );
-  for ( unsigned int n = 0; n < numberOfNeighbors; n++ )
+  this->m_SettledImage->FillBuffer( false );
+  this->m_PathDirectionCostImage->FillBuffer( NumericTraits<RealType>::max() );
+
+  /**
+   * Tabulate the neighbor offsets with their length (scale factor) and 
+   * their physical link vector.
+   */
+  this->m_NeighborOffsets.clear();
+  this->m_NeighborScaleFactors.clear();
+  this->m_NeighborVectors.clear();
+  this->m_NeighborVectorNorms.clear();
+
+  Neighborhood<RealType, ImageDimension> neighborhood;
+  neighborhood.SetRadius( 1 );
+  for ( unsigned int n = 0; n < neighborhood.Size(); n++ )
     {
-    scaleFactors[n] = 0;
-    if ( n == static_cast<unsigned int>( 0.5 * numberOfNeighbors ) )
-      {
-      continue; 
-      } 
-    typename Neighborhood<RealType, ImageDimension>::OffsetType offset 
-      = scaleFactors.GetOffset( n );
-   
-    bool isFaceConnected = true;
+    OffsetType offset = neighborhood.GetOffset( n );
+
     unsigned int sumOffset = 0; 
+    RealType scaleFactor = 0.0;
     for ( unsigned int d = 0; d < ImageDimension; d++ )
       {
       sumOffset += vnl_math_abs( offset[d] );
       if ( this->m_UseImageSpacing )
         {
-        scaleFactors[n] += ( static_cast<RealType>( offset[d] * offset[d] ) 
+        scaleFactor += ( static_cast<RealType>( offset[d] * offset[d] ) 
           * this->GetInputImage()->GetSpacing()[d] 
           * this->GetInputImage()->GetSpacing()[d] );  
         }
       else
         {
-        scaleFactors[n] += static_cast<RealType>( offset[d] * offset[d] );  
-        }
-      if ( sumOffset > 1 && this->m_UseFaceConnectedness )
-        {
-        isFaceConnected = false;
-        break;
+        scaleFactor += static_cast<RealType>( offset[d] * offset[d] );  
         }
       }      
-    if ( !isFaceConnected )
+    if ( sumOffset == 0 || ( sumOffset > 1 && this->m_UseFaceConnectedness ) )
       {
-      scaleFactors[n] = 0;
+      continue;
       }
-    if ( scaleFactors[n] > 0 )
+
+    VectorType vector;
+    for ( unsigned int i = 0; i < ImageDimension; i++ )
       {
-      scaleFactors[n] = vcl_sqrt( scaleFactors[n] );
-      } 
-    }   
+      vector[i] = 0.0;
+      for ( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        vector[i] += this->GetInputImage()->GetDirection()[i][j] 
+          * this->GetInputImage()->GetSpacing()[j] * offset[j];
+        }
+      }
 
-  /**
-   * Generate the PathDirectionImage with Dijkstra's algorithm
-   */
-  
-  NodeType anchorNode;
-  anchorNode.cost = 0.0;
-  anchorNode.index = this->m_AnchorSeed;
+    this->m_NeighborOffsets.push_back( offset );
+    this->m_NeighborScaleFactors.push_back( vcl_sqrt( scaleFactor ) );
+    this->m_NeighborVectors.push_back( vector );
+    this->m_NeighborVectorNorms.push_back( vector.GetNorm() );
+    }
+
+  this->m_Heap.Clear();
+  this->m_NumberOfSettledPixels = 0;
+  this->m_SearchTarget = target;
+  this->m_SearchMTime = this->GetMTime();
+  this->m_IsSearchInitialized = true;
 
   if ( this->m_MaskImage && 
        this->m_MaskImage->GetPixel( this->m_AnchorSeed ) 
@@ -227,134 +236,180 @@ LiveWireImageFunction<TInputImage>
     return;
     }    
 
-  PriorityQueueType Q;
-  Q.push( anchorNode );
+  OffsetType zeroOffset;
+  zeroOffset.Fill( 0 );
+  this->m_PathDirectionImage->SetPixel( this->m_AnchorSeed, zeroOffset );
+  this->m_PathDirectionCostImage->SetPixel( this->m_AnchorSeed, 0.0 );
+  this->m_Heap.Push( 0.0, this->m_AnchorSeed );
+}
 
-  while ( !Q.empty() )
+template <class TInputImage>
+bool
+LiveWireImageFunction<TInputImage>
+::ExpandSearch( const IndexType &target ) const
+{
+  /**
+   * Without a band, the settled pixels are the same for every target so 
+   * the search simply continues from where the previous one stopped.
+   */
+  if ( !this->m_IsSearchInitialized || this->m_SearchMTime != this->GetMTime() 
+    || ( this->m_SearchBandWidth > 0.0 && this->m_SearchTarget != target ) )
     {
-    NodeType centerNode = Q.top(); 
-    Q.pop();
-
-    expanded->SetPixel( centerNode.index, true );
-    It.SetLocation( centerNode.index ); 
-    PointType centerPoint;
-    this->GetInputImage()->TransformIndexToPhysicalPoint( 
-      centerNode.index, centerPoint );
+    this->InitializeSearch( target );
+    }
 
-    typename GradientImageType::PixelType centerGradient 
-      = this->m_GradientImage->GetPixel( centerNode.index );
-    RealType centerNorm 
-      = this->m_GradientMagnitudeImage->GetPixel( centerNode.index );
+  /**
+   * Dijkstra's algorithm.  A pixel is pushed again each time its cost 
+   * decreases; the stale entries are skipped when popped.
+   */
+  while ( !this->m_SettledImage->GetPixel( target ) && !this->m_Heap.Empty() )
+    {
+    RealType centerCost;
+    IndexType centerIndex;
+    this->m_Heap.Pop( centerCost, centerIndex );
+    if ( this->m_SettledImage->GetPixel( centerIndex ) )
+      {
+      continue;
+      } 
+    this->m_SettledImage->SetPixel( centerIndex, true );
+    this->m_NumberOfSettledPixels++;
 
-    for ( unsigned int n = 0; n < numberOfNeighbors; n++ )
+    for ( unsigned int n = 0; n < this->m_NeighborOffsets.size(); n++ )
       {
-      if ( scaleFactors[n] == 0 )
-        {
-        continue;
-        } 
-      bool inBounds;
-      bool isExpanded = It.GetPixel( n, inBounds );
-      if ( isExpanded || !inBounds )
+      IndexType index = centerIndex + this->m_NeighborOffsets[n];
+      if ( !this->IsInsideBuffer( index ) 
+           || this->m_SettledImage->GetPixel( index ) )
         {
         continue;
         }  
-
-      IndexType index = It.GetIndex( n );
-      NodeType neighborNode;
-      neighborNode.index = index;
-
       if ( this->m_MaskImage && 
            this->m_MaskImage->GetPixel( index ) != this->m_InsidePixelValue )
         {
         continue;
         }    
-
-      typename GradientImageType::PixelType neighborGradient 
-        = this->m_GradientImage->GetPixel( index );
-      RealType neighborNorm = this->m_GradientMagnitudeImage->GetPixel( index );
-      
-      RealType fz = 0.0;
-      RealType fg = 0.0;
-      RealType fd = 0.0;
-
-      if ( this->m_ZeroCrossingWeight > 0 && this->m_ZeroCrossingImage )
-        {
-        fz = 1.0 - this->m_ZeroCrossingImage->GetPixel( index );
-        } 
-      if ( this->m_FindStepEdges )
+      if ( this->m_SearchBandWidth > 0.0 && !this->IsInsideSearchBand( index ) )
         {
-        if ( this->m_GradientMagnitudeWeight > 0.0 )
-          {
-          fg = 1.0 - this->m_RescaledGradientMagnitudeImage->GetPixel( index );
-          }
-        if ( this->m_GradientDirectionWeight > 0.0 
-             && neighborNorm > 0 && centerNorm > 0 )
-          {
-          PointType neighborPoint;
-          this->GetInputImage()->TransformIndexToPhysicalPoint( 
-            neighborNode.index, neighborPoint );
-          typename PointType::VectorType vector 
-            = neighborPoint - centerPoint;
-          RealType vectorNorm = vector.GetNorm();            
-
-          RealType centerMin = vnl_math_min( centerGradient * vector, 
-            centerGradient * -vector );            
-          RealType neighborMin = vnl_math_min( neighborGradient * vector, 
-            neighborGradient * -vector );            
-
-          fd = 1.0 - ( vcl_acos( centerMin / ( centerNorm * vectorNorm ) ) +  
-            vcl_acos( neighborMin / ( neighborNorm * vectorNorm ) ) )
-            / vnl_math::pi;
-          }
+        continue;
         }
-      else
+
+      RealType cost = centerCost + this->m_NeighborScaleFactors[n] * 
+        this->ComputeLocalCost( centerIndex, index, n );
+
+      if ( cost < this->m_PathDirectionCostImage->GetPixel( index ) )
         {
-        if ( this->m_GradientMagnitudeWeight > 0.0 )
-          {
-          fg = this->m_RescaledGradientMagnitudeImage->GetPixel( index );
-          } 
-        if ( this->m_GradientDirectionWeight > 0.0 
-             && neighborNorm > 0 && centerNorm > 0 )
-          {
-          PointType neighborPoint;
-          this->GetInputImage()->TransformIndexToPhysicalPoint( 
-            neighborNode.index, neighborPoint );
-          typename PointType::VectorType vector 
-            = neighborPoint - centerPoint;
-          RealType vectorNorm = vector.GetNorm();            
-
-          RealType centerMin = vnl_math_min( centerGradient * vector, 
-            centerGradient * -vector );            
-          RealType neighborMin = vnl_math_min( neighborGradient * vector, 
-            neighborGradient * -vector );            
-
-          fd = 1.0 - ( vcl_acos( centerMin / ( centerNorm * vectorNorm ) ) + 
-            vcl_acos( neighborMin / ( neighborNorm * vectorNorm ) ) )
-            / vnl_math::pi;
-          } 
+        this->m_PathDirectionCostImage->SetPixel( index, cost ); 
+        this->m_PathDirectionImage->SetPixel( index, 
+          -this->m_NeighborOffsets[n] ); 
+        this->m_Heap.Push( cost, index ); 
         }
+      }  
+    }  
 
-      neighborNode.cost = centerNode.cost + scaleFactors[n] *
-        ( fg * this->m_GradientMagnitudeWeight
-        + fz * this->m_ZeroCrossingWeight
-        + fd * this->m_GradientDirectionWeight );
+  return this->m_SettledImage->GetPixel( target );
+}
 
-      Q.push( neighborNode ); 
+template <class TInputImage>
+typename LiveWireImageFunction<TInputImage>::RealType
+LiveWireImageFunction<TInputImage>
+::ComputeLocalCost( const IndexType &centerIndex, const IndexType &index,
+  unsigned int n ) const
+{
+  RealType fz = 0.0;
+  RealType fg = 0.0;
+  RealType fd = 0.0;
 
-      this->m_PathDirectionImage->SetPixel( neighborNode.index, 
-        centerNode.index - neighborNode.index ); 
+  if ( this->m_ZeroCrossingWeight > 0 && this->m_ZeroCrossingImage )
+    {
+    fz = 1.0 - this->m_ZeroCrossingImage->GetPixel( index );
+    } 
+  if ( this->m_GradientMagnitudeWeight > 0.0 )
+    {
+    fg = this->m_RescaledGradientMagnitudeImage->GetPixel( index );
+    if ( this->m_FindStepEdges )
+      {
+      fg = 1.0 - fg;
+      }
+    }
+
+  if ( this->m_GradientDirectionWeight > 0.0 )
+    {
+    RealType centerNorm = this->m_GradientMagnitudeImage->GetPixel( centerIndex );
+    RealType neighborNorm = this->m_GradientMagnitudeImage->GetPixel( index );
 
-      this->m_PathDirectionCostImage->SetPixel( neighborNode.index, 
-        neighborNode.cost ); 
+    if ( neighborNorm > 0 && centerNorm > 0 )
+      {
+      const VectorType &vector = this->m_NeighborVectors[n];
+      RealType vectorNorm = this->m_NeighborVectorNorms[n];
 
-      NodeType node = Q.top();
-      while ( expanded->GetPixel( node.index ) )
+      typename GradientImageType::PixelType centerGradient 
+        = this->m_GradientImage->GetPixel( centerIndex );
+      typename GradientImageType::PixelType neighborGradient 
+        = this->m_GradientImage->GetPixel( index );
+
+      RealType centerDot = 0.0;
+      RealType neighborDot = 0.0;
+      for ( unsigned int d = 0; d < ImageDimension; d++ )
         {
-        Q.pop();
-        node = Q.top();
-        } 
-      }  
-    }  
+        centerDot += centerGradient[d] * vector[d];
+        neighborDot += neighborGradient[d] * vector[d];
+        }
+
+      /**
+       * The angles between the link and the gradients, folded to 
+       * [pi/2, pi], so that fd is 0 when the link is perpendicular to 
+       * both gradients and 1 when it is parallel to them.
+       */
+      RealType centerCos = vnl_math_max( static_cast<RealType>( -1.0 ), 
+        -vnl_math_abs( centerDot ) / ( centerNorm * vectorNorm ) );
+      RealType neighborCos = vnl_math_max( static_cast<RealType>( -1.0 ), 
+        -vnl_math_abs( neighborDot ) / ( neighborNorm * vectorNorm ) );
+
+      fd = ( vcl_acos( centerCos ) + vcl_acos( neighborCos ) ) 
+        / vnl_math::pi - 1.0;
+      fd = vnl_math_max( NumericTraits<RealType>::Zero, fd );
+      }
+    }
+
+  return ( fg * this->m_GradientMagnitudeWeight
+    + fz * this->m_ZeroCrossingWeight
+    + fd * this->m_GradientDirectionWeight );
+}
+
+template <class TInputImage>
+bool
+LiveWireImageFunction<TInputImage>
+::IsInsideSearchBand( const IndexType &index ) const
+{
+  /**
+   * Distance to the segment from the anchor to the target in index space 
+   * scaled by the spacing, which is the physical distance.
+   */
+  RealType segmentDotPoint = 0.0;
+  RealType segmentNorm2 = 0.0;
+  for ( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    RealType spacing = this->GetInputImage()->GetSpacing()[d];
+    RealType segment = spacing * 
+      ( this->m_SearchTarget[d] - this->m_AnchorSeed[d] );
+    segmentDotPoint += segment * spacing * ( index[d] - this->m_AnchorSeed[d] );
+    segmentNorm2 += segment * segment;
+    }
+  RealType t = 0.0;
+  if ( segmentNorm2 > 0.0 )
+    {
+    t = vnl_math_min( static_cast<RealType>( 1.0 ), vnl_math_max( 
+      static_cast<RealType>( 0.0 ), segmentDotPoint / segmentNorm2 ) );
+    }
+
+  RealType distance2 = 0.0;
+  for ( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    RealType spacing = this->GetInputImage()->GetSpacing()[d];
+    RealType delta = spacing * ( index[d] - this->m_AnchorSeed[d] 
+      - t * ( this->m_SearchTarget[d] - this->m_AnchorSeed[d] ) );
+    distance2 += delta * delta;
+    }
+  return ( distance2 <= vnl_math_sqr( this->m_SearchBandWidth ) );
 }
 
 template <class TInputImage>
@@ -375,6 +430,12 @@ LiveWireImageFunction<TInputImage>
     return NULL;
     }    
 
+  if ( !this->ExpandSearch( index ) )
+    {
+    itkWarningMacro( "The index cannot be reached from the anchor seed." ); 
+    return NULL;
+    }
+
   typename OutputType::Pointer output = OutputType::New();
   output->Initialize();
 
@@ -411,6 +472,10 @@ LiveWireImageFunction<TInputImage>
      << this->m_UseImageSpacing << std::endl;
   os << indent << "UseFaceConnectedness: " 
      << this->m_UseFaceConnectedness << std::endl;
+  os << indent << "SearchBandWidth: " 
+     << this->m_SearchBandWidth << std::endl;
+  os << indent << "NumberOfSettledPixels: " 
+     << this->m_NumberOfSettledPixels << std::endl;
 
   os << indent << "MaskImage"
      << this->m_MaskImage << std::endl;
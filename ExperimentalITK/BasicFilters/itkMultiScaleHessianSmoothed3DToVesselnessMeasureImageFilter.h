@@ -20,8 +20,7 @@
 
 #include "itkImageToImageFilter.h"
 #include "itkImage.h"
-#include "itkHessianSmoothed3DToVesselnessMeasureImageFilter.h" 
-#include "itkHessianRecursiveGaussianImageFilter.h"
+#include "itkMultiThreader.h"
 
 namespace itk
 {
@@ -35,12 +34,26 @@ namespace itk
  * image of any pixel type and generates a Hessian image pixels at different
  * scale levels. The vesselness measure is computed from the Hessian image 
  * at each scale level and the best response is selected.  The vesselness 
- * measure is computed using HessianSmoothed3DToVesselnessMeasureImageFilter.
+ * measure is the one of HessianSmoothed3DToVesselnessMeasureImageFilter
+ * (without the scaling by the largest eigenvalue).
  *
  * Minimum and maximum sigma value can be set using SetMinSigma and SetMaxSigma
  * methods respectively. The number of scale levels is set using 
  * SetNumberOfSigmaSteps method. Exponentially distributed scale levels are 
  * computed within the bound set by the minimum and maximum sigma values 
+ *
+ * No Hessian image is stored.  At each scale the input is smoothed into a
+ * scalar image, and each thread takes its lines, computes the scale
+ * normalized Hessian by central differences, the eigenvalues in closed form
+ * and the vesselness, and keeps the maximum in the output.
+ *
+ * Large scales are computed on a decimated grid.  The input is smoothed
+ * by the coarse spacing and subsampled by the largest integer factors that
+ * keep MinimumSamplesPerSigma samples per sigma along each axis; the rest of
+ * the smoothing is done on the coarse grid (Gaussians compose, so the total
+ * scale is unchanged) and the response is linearly interpolated back to the
+ * output grid.  The coarse grid is shared by the scales with the same
+ * factors.
  *  
  *
  * \par References
@@ -77,9 +90,9 @@ public:
 
   typedef typename TInputImage::PixelType                InputPixelType;
   typedef typename TOutputImage::PixelType               OutputPixelType;
-
-  /** Update image buffer that holds the best vesselness response */ 
-  typedef Image< double, 3>                              UpdateBufferType;
+  typedef typename TOutputImage::RegionType              RegionType;
+  typedef typename TOutputImage::IndexType               IndexType;
+  typedef typename TOutputImage::SizeType                SizeType;
 
   /** Image dimension = 3. */
   itkStaticConstMacro(ImageDimension, unsigned int,
@@ -88,11 +101,11 @@ public:
   /** Method for creation through the object factory. */
   itkNewMacro(Self);
   
-  /** Set/Get macros for Alpha */
+  /** Set/Get macros for SigmaMin */
   itkSetMacro(SigmaMin, double);
   itkGetMacro(SigmaMin, double);
   
-  /** Set/Get macros for Beta */
+  /** Set/Get macros for SigmaMax */
   itkSetMacro(SigmaMax, double);
   itkGetMacro(SigmaMax, double);
 
@@ -100,27 +113,68 @@ public:
   itkSetMacro(NumberOfSigmaSteps, int);
   itkGetMacro(NumberOfSigmaSteps, int);
 
+  /** Set/Get macros for the vesselness function parameters (see
+   * HessianSmoothed3DToVesselnessMeasureImageFilter) */
+  itkSetMacro(Alpha, double);
+  itkGetMacro(Alpha, double);
+
+  itkSetMacro(Beta, double);
+  itkGetMacro(Beta, double);
+
+  itkSetMacro(Gamma, double);
+  itkGetMacro(Gamma, double);
+
+  itkSetMacro(C, double);
+  itkGetMacro(C, double);
+
+  /** Minimum number of grid samples per sigma before a scale is computed
+   * on a decimated grid.  Default is 3; a very large value computes every
+   * scale at full resolution. */
+  itkSetClampMacro(MinimumSamplesPerSigma, double, 1.5,
+                   NumericTraits<double>::max());
+  itkGetMacro(MinimumSamplesPerSigma, double);
+
 
 protected:
   MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter();
   ~MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter() {};
   void PrintSelf(std::ostream& os, Indent indent) const;
-  
-  typedef HessianRecursiveGaussianImageFilter< InputImageType >
-                                                        HessianFilterType;
 
-  typedef HessianSmoothed3DToVesselnessMeasureImageFilter< double >
-                                                        VesselnessFilterType;
+  /** The smoothing needs the whole input */
+  void GenerateInputRequestedRegion();
 
   /** Generate Data */
   void GenerateData( void );
 
 private:
-  void UpdateMaximumResponse();
+  /** Smoothed image (one scale) and vesselness on a decimated grid */
+  typedef Image< float, 3 >                              RealImageType;
 
   double ComputeSigmaValue( int scaleLevel );
-  
-  void   AllocateUpdateBuffer();
+
+  /** Eigenvalues of the symmetric matrix (h00 h01 h02; h11 h12; h22),
+   * sorted by increasing magnitude */
+  static void ComputeEigenValues( double, double, double,
+                                  double, double, double, double * );
+
+  double ComputeVesselness( const double * ) const;
+
+  /** Multi-threading support */
+  struct ThreadStruct
+    {
+    Self *Filter;
+    };
+
+  enum ScaleStepType { ResponseStep, UpsampleStep };
+
+  static ITK_THREAD_RETURN_TYPE ScaleThreaderCallback( void * );
+
+  /** Vesselness of the smoothed image over a region of its grid, kept as
+   * the maximum in the output, or written to the coarse response image */
+  void ThreadedComputeResponse( const RegionType & );
+
+  /** Maximum of the output and the interpolated coarse response */
+  void ThreadedUpsampleResponse( const RegionType & );
 
   //purposely not implemented
   MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter(const Self&); 
@@ -131,11 +185,23 @@ private:
 
   int                                               m_NumberOfSigmaSteps;
 
-  typename VesselnessFilterType::Pointer            m_VesselnessFilter;
-  typename HessianFilterType::Pointer               m_HessianFilter;
+  double                                            m_Alpha;
+  double                                            m_Beta;
+  double                                            m_Gamma;
+  double                                            m_C;
+
+  double                                            m_MinimumSamplesPerSigma;
 
+  /** State of the current scale */
+  double                                            m_CurrentSigma;
+  ScaleStepType                                     m_ScaleStep;
+  RealImageType::Pointer                            m_SmoothedImage;
+  RealImageType::Pointer                            m_ResponseImage;
 
-  UpdateBufferType::Pointer                         m_UpdateBuffer;
+  /** Continuous index on the decimated grid is
+   * m_CoarseIndexOffset[d] + m_CoarseIndexScale[d] * index[d] */
+  double                                            m_CoarseIndexOffset[3];
+  double                                            m_CoarseIndexScale[3];
 };
 
 } // end namespace itk
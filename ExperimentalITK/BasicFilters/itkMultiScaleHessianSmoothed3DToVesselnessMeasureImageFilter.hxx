@@ -18,10 +18,14 @@
 #define __itkMultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter_hxx
 
 #include "itkMultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter.h"
-#include "itkImageRegionIterator.h"
-#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionSplitter.h"
+#include "itkShrinkImageFilter.h"
+#include "itkSmoothingRecursiveGaussianImageFilter.h"
 #include "vnl/vnl_math.h"
 
+#include <algorithm>
+#include <vector>
+
 #define EPSILON  1e-03
 
 namespace itk
@@ -40,35 +44,37 @@ MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
 
   m_NumberOfSigmaSteps = 10;
 
-  m_HessianFilter                = HessianFilterType::New();
-  m_VesselnessFilter             = VesselnessFilterType::New();
+  m_Alpha = 0.5;
+  m_Beta  = 0.5;
+  m_Gamma = 5.0;
+
+  m_C = 10e-6;
 
-  //Turn off vesselness measure scaling
-  m_VesselnessFilter->SetScaleVesselnessMeasure( false );
+  m_MinimumSamplesPerSigma = 3.0;
 
-  //Instantiate Update buffer
-  m_UpdateBuffer                 = UpdateBufferType::New();
+  m_CurrentSigma = m_SigmaMin;
+  m_ScaleStep = ResponseStep;
+  for( unsigned int d = 0; d < 3; d++ )
+    {
+    m_CoarseIndexOffset[d] = 0.0;
+    m_CoarseIndexScale[d] = 1.0;
+    }
 }
 
 template <typename TInputImage, typename TOutputImage >
 void
 MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
 <TInputImage,TOutputImage>
-::AllocateUpdateBuffer()
+::GenerateInputRequestedRegion()
 {
-  /* The update buffer looks just like the output and holds the best response
-     in the  vesselness measure */
-  
-  typename TOutputImage::Pointer output = this->GetOutput();
-
-  m_UpdateBuffer->SetSpacing(output->GetSpacing());
-  m_UpdateBuffer->SetOrigin(output->GetOrigin());
-  m_UpdateBuffer->SetLargestPossibleRegion(output->GetLargestPossibleRegion());
-  m_UpdateBuffer->SetRequestedRegion(output->GetRequestedRegion());
-  m_UpdateBuffer->SetBufferedRegion(output->GetBufferedRegion());
-  m_UpdateBuffer->Allocate();
-}
+  Superclass::GenerateInputRequestedRegion();
 
+  InputImageType *input = const_cast<InputImageType *>( this->GetInput() );
+  if( input )
+    {
+    input->SetRequestedRegionToLargestPossibleRegion();
+    }
+}
 
 template <typename TInputImage, typename TOutputImage >
 void
@@ -76,20 +82,32 @@ MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
 <TInputImage,TOutputImage>
 ::GenerateData()
 {
-  // Allocate the output
+  // Allocate the output, which holds the best response
   this->GetOutput()->SetBufferedRegion( 
                  this->GetOutput()->GetRequestedRegion() );
   this->GetOutput()->Allocate();
-
-  // Allocate the buffer
-  AllocateUpdateBuffer();
+  this->GetOutput()->FillBuffer( NumericTraits<OutputPixelType>::Zero );
 
   typename InputImageType::ConstPointer input = this->GetInput();
- 
-  this->m_HessianFilter->SetInput( input );
+  const typename InputImageType::SpacingType spacing = input->GetSpacing();
+
+  typedef SmoothingRecursiveGaussianImageFilter
+    <InputImageType, RealImageType>                      InputSmootherType;
+  typedef SmoothingRecursiveGaussianImageFilter
+    <RealImageType, RealImageType>                       CoarseSmootherType;
+  typedef ShrinkImageFilter<RealImageType, RealImageType> ShrinkerType;
+
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+
+  ThreadStruct str;
+  str.Filter = this;
+  this->GetMultiThreader()->SetSingleMethod(
+    this->ScaleThreaderCallback, &str );
+
+  /** Decimated input of the current shrink factors */
+  RealImageType::Pointer coarseImage;
+  unsigned int coarseFactors[3] = { 1, 1, 1 };
 
-  this->m_HessianFilter->SetNormalizeAcrossScale( true );
- 
   double sigma = m_SigmaMin;
 
   int scaleLevel = 1;
@@ -99,68 +117,475 @@ MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
     std::cout << "Computing vesselness for scale with sigma= " 
               << sigma << std::endl;
 
-    m_HessianFilter->SetSigma( sigma );
+    m_CurrentSigma = sigma;
 
-    m_VesselnessFilter->SetInput ( m_HessianFilter->GetOutput() ); 
+    unsigned int factors[3];
+    bool decimate = false;
+    for( unsigned int d = 0; d < 3; d++ )
+      {
+      factors[d] = static_cast<unsigned int>( vnl_math_max( 1.0,
+        vcl_floor( sigma / ( m_MinimumSamplesPerSigma * spacing[d] ) ) ) );
+      decimate = decimate || ( factors[d] > 1 );
+      }
 
-    m_VesselnessFilter->Update();
- 
-    this->UpdateMaximumResponse();
+    if( !decimate )
+      {
+      typename InputSmootherType::Pointer smoother = InputSmootherType::New();
+      smoother->SetInput( input );
+      smoother->SetSigma( sigma );
+      smoother->SetNormalizeAcrossScale( false );
+      smoother->SetNumberOfThreads( this->GetNumberOfThreads() );
+      smoother->Update();
+      m_SmoothedImage = smoother->GetOutput();
+      m_SmoothedImage->DisconnectPipeline();
+
+      m_ResponseImage = NULL;
+      m_ScaleStep = ResponseStep;
+      this->GetMultiThreader()->SingleMethodExecute();
+      }
+    else
+      {
+      /** The input is smoothed by the coarse spacing before it is
+       * subsampled, which leaves sqrt( sigma^2 - coarseSigma^2 ) to the
+       * coarse grid. */
+      double coarseSigma = 0.0;
+      for( unsigned int d = 0; d < 3; d++ )
+        {
+        coarseSigma = vnl_math_max( coarseSigma, factors[d] * spacing[d] );
+        }
+
+      if( coarseImage.IsNull() || factors[0] != coarseFactors[0] ||
+          factors[1] != coarseFactors[1] || factors[2] != coarseFactors[2] )
+        {
+        typename InputSmootherType::Pointer smoother = InputSmootherType::New();
+        smoother->SetInput( input );
+        smoother->SetSigma( coarseSigma );
+        smoother->SetNormalizeAcrossScale( false );
+        smoother->SetNumberOfThreads( this->GetNumberOfThreads() );
+
+        typename ShrinkerType::Pointer shrinker = ShrinkerType::New();
+        shrinker->SetInput( smoother->GetOutput() );
+        shrinker->SetShrinkFactors( factors );
+        shrinker->SetNumberOfThreads( this->GetNumberOfThreads() );
+        shrinker->Update();
+        coarseImage = shrinker->GetOutput();
+        coarseImage->DisconnectPipeline();
+
+        for( unsigned int d = 0; d < 3; d++ )
+          {
+          coarseFactors[d] = factors[d];
+          }
+
+        typename OutputImageType::PointType point;
+        ContinuousIndex<double, 3> cidx;
+        IndexType index;
+        index.Fill( 0 );
+        this->GetOutput()->TransformIndexToPhysicalPoint( index, point );
+        coarseImage->TransformPhysicalPointToContinuousIndex( point, cidx );
+        for( unsigned int d = 0; d < 3; d++ )
+          {
+          m_CoarseIndexOffset[d] = cidx[d];
+          }
+        for( unsigned int d = 0; d < 3; d++ )
+          {
+          index.Fill( 0 );
+          index[d] = 1;
+          this->GetOutput()->TransformIndexToPhysicalPoint( index, point );
+          coarseImage->TransformPhysicalPointToContinuousIndex( point, cidx );
+          m_CoarseIndexScale[d] = cidx[d] - m_CoarseIndexOffset[d];
+          }
+        }
+
+      const double remainingSigma =
+        vcl_sqrt( vnl_math_sqr( sigma ) - vnl_math_sqr( coarseSigma ) );
+
+      typename CoarseSmootherType::Pointer smoother = CoarseSmootherType::New();
+      smoother->SetInput( coarseImage );
+      smoother->SetSigma( remainingSigma );
+      smoother->SetNormalizeAcrossScale( false );
+      smoother->SetNumberOfThreads( this->GetNumberOfThreads() );
+      smoother->Update();
+      m_SmoothedImage = smoother->GetOutput();
+      m_SmoothedImage->DisconnectPipeline();
+
+      m_ResponseImage = RealImageType::New();
+      m_ResponseImage->CopyInformation( m_SmoothedImage );
+      m_ResponseImage->SetRegions( m_SmoothedImage->GetLargestPossibleRegion() );
+      m_ResponseImage->Allocate();
+
+      m_ScaleStep = ResponseStep;
+      this->GetMultiThreader()->SingleMethodExecute();
+
+      m_ScaleStep = UpsampleStep;
+      this->GetMultiThreader()->SingleMethodExecute();
+      }
 
     sigma  = this->ComputeSigmaValue( scaleLevel );
 
     scaleLevel++;
     } 
 
-  //Write out the best response to the output image
-  ImageRegionIterator<UpdateBufferType> 
-               it(m_UpdateBuffer,m_UpdateBuffer->GetLargestPossibleRegion());
-  it.GoToBegin();
+  m_SmoothedImage = NULL;
+  m_ResponseImage = NULL;
+}
 
-  ImageRegionIterator<TOutputImage> oit(this->GetOutput(),
-                          this->GetOutput()->GetLargestPossibleRegion());
-  oit.GoToBegin();
+template <typename TInputImage, typename TOutputImage >
+ITK_THREAD_RETURN_TYPE
+MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
+<TInputImage,TOutputImage>
+::ScaleThreaderCallback( void *arg )
+{
+  unsigned int threadId =
+    ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount =
+    ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct *str = (ThreadStruct *)
+    ( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+  Self *filter = str->Filter;
+
+  typedef ImageRegionSplitter<3> SplitterType;
+  SplitterType::Pointer splitter = SplitterType::New();
+
+  /** The response step runs over the grid of the smoothed image, which is
+   * the output grid unless the scale is decimated. */
+  RegionType region = filter->GetOutput()->GetRequestedRegion();
+  if( filter->m_ScaleStep == ResponseStep && filter->m_ResponseImage.IsNotNull() )
+    {
+    region = filter->m_ResponseImage->GetLargestPossibleRegion();
+    }
 
-  while(!oit.IsAtEnd())
+  unsigned int total = splitter->GetNumberOfSplits( region, threadCount );
+  if( threadId < total )
     {
-    oit.Value() = static_cast< OutputPixelType >( it.Get() );
-    ++oit;
-    ++it;
+    region = splitter->GetSplit( threadId, total, region );
+    if( filter->m_ScaleStep == ResponseStep )
+      {
+      filter->ThreadedComputeResponse( region );
+      }
+    else
+      {
+      filter->ThreadedUpsampleResponse( region );
+      }
     }
+
+  return ITK_THREAD_RETURN_VALUE;
 }
 
 template <typename TInputImage, typename TOutputImage >
 void
 MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
 <TInputImage,TOutputImage>
-::UpdateMaximumResponse()
+::ThreadedComputeResponse( const RegionType &region )
 {
+  const RealImageType *smoothed = m_SmoothedImage;
+  const RegionType bufferedRegion = smoothed->GetBufferedRegion();
+  const IndexType bufferStart = bufferedRegion.GetIndex();
+  const SizeType bufferSize = bufferedRegion.GetSize();
+  const float *buffer = smoothed->GetBufferPointer();
+
+  const long strideY = bufferSize[0];
+  const long strideZ = bufferSize[0] * bufferSize[1];
+
+  /** Second differences in physical units, scale normalized by sigma^2 */
+  const typename RealImageType::SpacingType spacing = smoothed->GetSpacing();
+  const double sigmaSqr = vnl_math_sqr( m_CurrentSigma );
+  const double wxx = sigmaSqr / ( spacing[0] * spacing[0] );
+  const double wyy = sigmaSqr / ( spacing[1] * spacing[1] );
+  const double wzz = sigmaSqr / ( spacing[2] * spacing[2] );
+  const double wxy = 0.25 * sigmaSqr / ( spacing[0] * spacing[1] );
+  const double wxz = 0.25 * sigmaSqr / ( spacing[0] * spacing[2] );
+  const double wyz = 0.25 * sigmaSqr / ( spacing[1] * spacing[2] );
+
+  const unsigned long length = region.GetSize()[0];
+  const long x0 = region.GetIndex()[0] - bufferStart[0];
+  const long lastX = static_cast<long>( bufferSize[0] ) - 1;
+
+  /** Neighbours along x of the line, clamped at the border */
+  std::vector<long> xm( length );
+  std::vector<long> xp( length );
+  for( unsigned long i = 0; i < length; i++ )
+    {
+    const long x = x0 + static_cast<long>( i );
+    xm[i] = ( x > 0 ) ? x - 1 : 0;
+    xp[i] = ( x < lastX ) ? x + 1 : lastX;
+    }
+
+  std::vector<double> hessian[6];
+  for( unsigned int k = 0; k < 6; k++ )
+    {
+    hessian[k].resize( length );
+    }
+  std::vector<double> response( length );
+
+  const long zBegin = region.GetIndex()[2];
+  const long zEnd = zBegin + static_cast<long>( region.GetSize()[2] );
+  const long yBegin = region.GetIndex()[1];
+  const long yEnd = yBegin + static_cast<long>( region.GetSize()[1] );
 
-  ImageRegionIterator<UpdateBufferType> 
-            oit(m_UpdateBuffer,m_UpdateBuffer->GetLargestPossibleRegion());
+  for( long z = zBegin; z < zEnd; z++ )
+    {
+    const long zc = z - bufferStart[2];
+    const long zm = ( zc > 0 ) ? zc - 1 : 0;
+    const long zp = ( zc < static_cast<long>( bufferSize[2] ) - 1 ) ? zc + 1 : zc;
+
+    for( long y = yBegin; y < yEnd; y++ )
+      {
+      const long yc = y - bufferStart[1];
+      const long ym = ( yc > 0 ) ? yc - 1 : 0;
+      const long yp = ( yc < static_cast<long>( bufferSize[1] ) - 1 ) ? yc + 1 : yc;
+
+      const float *c   = buffer + zc * strideZ + yc * strideY;
+      const float *cym = buffer + zc * strideZ + ym * strideY;
+      const float *cyp = buffer + zc * strideZ + yp * strideY;
+      const float *czm = buffer + zm * strideZ + yc * strideY;
+      const float *czp = buffer + zp * strideZ + yc * strideY;
+      const float *cmm = buffer + zm * strideZ + ym * strideY;
+      const float *cmp = buffer + zp * strideZ + ym * strideY;
+      const float *cpm = buffer + zm * strideZ + yp * strideY;
+      const float *cpp = buffer + zp * strideZ + yp * strideY;
+
+      for( unsigned long i = 0; i < length; i++ )
+        {
+        const long x = x0 + static_cast<long>( i );
+        const long a = xm[i];
+        const long b = xp[i];
+        const double center = 2.0 * c[x];
+
+        hessian[0][i] = wxx * ( c[b] - center + c[a] );
+        hessian[1][i] = wxy * ( cyp[b] - cyp[a] - cym[b] + cym[a] );
+        hessian[2][i] = wxz * ( czp[b] - czp[a] - czm[b] + czm[a] );
+        hessian[3][i] = wyy * ( cyp[x] - center + cym[x] );
+        hessian[4][i] = wyz * ( cpp[x] - cpm[x] - cmp[x] + cmm[x] );
+        hessian[5][i] = wzz * ( czp[x] - center + czm[x] );
+        }
+
+      for( unsigned long i = 0; i < length; i++ )
+        {
+        double eigenValues[3];
+        ComputeEigenValues( hessian[0][i], hessian[1][i], hessian[2][i],
+          hessian[3][i], hessian[4][i], hessian[5][i], eigenValues );
+        response[i] = this->ComputeVesselness( eigenValues );
+        }
+
+      IndexType lineIndex;
+      lineIndex[0] = region.GetIndex()[0];
+      lineIndex[1] = y;
+      lineIndex[2] = z;
+
+      if( m_ResponseImage.IsNotNull() )
+        {
+        float *out = m_ResponseImage->GetBufferPointer() +
+          m_ResponseImage->ComputeOffset( lineIndex );
+        for( unsigned long i = 0; i < length; i++ )
+          {
+          out[i] = static_cast<float>( response[i] );
+          }
+        }
+      else
+        {
+        OutputPixelType *out = this->GetOutput()->GetBufferPointer() +
+          this->GetOutput()->ComputeOffset( lineIndex );
+        for( unsigned long i = 0; i < length; i++ )
+          {
+          if( out[i] < response[i] )
+            {
+            out[i] = static_cast<OutputPixelType>( response[i] );
+            }
+          }
+        }
+      }
+    }
+}
 
-  oit.GoToBegin();
+template <typename TInputImage, typename TOutputImage >
+void
+MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
+<TInputImage,TOutputImage>
+::ThreadedUpsampleResponse( const RegionType &region )
+{
+  const RegionType coarseRegion = m_ResponseImage->GetBufferedRegion();
+  const float *coarse = m_ResponseImage->GetBufferPointer();
 
-  typedef typename VesselnessFilterType::OutputImageType   
-                                         VesselnessOutputImageType;
+  const long strideY = coarseRegion.GetSize()[0];
+  const long strideZ = coarseRegion.GetSize()[0] * coarseRegion.GetSize()[1];
 
-  ImageRegionIterator<VesselnessOutputImageType> 
-            it(m_VesselnessFilter->GetOutput(),
-            this->m_VesselnessFilter->GetOutput()->GetLargestPossibleRegion());
+  /** Lower coarse sample (relative to the buffer) and weight of the upper
+   * one along an axis, clamped at the border */
+  std::vector<long> lower[3];
+  std::vector<double> weight[3];
+  for( unsigned int d = 0; d < 3; d++ )
+    {
+    const unsigned long n = region.GetSize()[d];
+    const long last = static_cast<long>( coarseRegion.GetSize()[d] ) - 1;
+    lower[d].resize( n );
+    weight[d].resize( n );
+    for( unsigned long i = 0; i < n; i++ )
+      {
+      const double u = m_CoarseIndexOffset[d] + m_CoarseIndexScale[d] *
+        ( region.GetIndex()[d] + static_cast<long>( i ) ) -
+        coarseRegion.GetIndex()[d];
+      long k = static_cast<long>( vcl_floor( u ) );
+      double t = u - k;
+      if( k < 0 )
+        {
+        k = 0;
+        t = 0.0;
+        }
+      if( k >= last )
+        {
+        k = vnl_math_max( last - 1, 0L );
+        t = ( last > 0 ) ? 1.0 : 0.0;
+        }
+      lower[d][i] = k;
+      weight[d][i] = t;
+      }
+    }
+  const long stepX = ( coarseRegion.GetSize()[0] > 1 ) ? 1 : 0;
+  const long stepY = ( coarseRegion.GetSize()[1] > 1 ) ? strideY : 0;
+  const long stepZ = ( coarseRegion.GetSize()[2] > 1 ) ? strideZ : 0;
 
-  it.GoToBegin();
+  const unsigned long length = region.GetSize()[0];
+  IndexType lineIndex = region.GetIndex();
 
-  while(!oit.IsAtEnd())
+  for( unsigned long z = 0; z < region.GetSize()[2]; z++ )
     {
-    if( oit.Value() < it.Value() )
+    const double tz = weight[2][z];
+    for( unsigned long y = 0; y < region.GetSize()[1]; y++ )
       {
-      oit.Value() = it.Value();
+      const double ty = weight[1][y];
+      const float *plane = coarse + lower[2][z] * strideZ +
+        lower[1][y] * strideY;
+
+      lineIndex[1] = region.GetIndex()[1] + static_cast<long>( y );
+      lineIndex[2] = region.GetIndex()[2] + static_cast<long>( z );
+      OutputPixelType *out = this->GetOutput()->GetBufferPointer() +
+        this->GetOutput()->ComputeOffset( lineIndex );
+
+      for( unsigned long i = 0; i < length; i++ )
+        {
+        const float *p = plane + lower[0][i];
+        const double tx = weight[0][i];
+
+        const double c00 = p[0] + tx * ( p[stepX] - p[0] );
+        const double c10 = p[stepY] + tx * ( p[stepY + stepX] - p[stepY] );
+        const double c01 = p[stepZ] + tx * ( p[stepZ + stepX] - p[stepZ] );
+        const double c11 = p[stepZ + stepY] +
+          tx * ( p[stepZ + stepY + stepX] - p[stepZ + stepY] );
+        const double c0 = c00 + ty * ( c10 - c00 );
+        const double c1 = c01 + ty * ( c11 - c01 );
+        const double value = c0 + tz * ( c1 - c0 );
+
+        if( out[i] < value )
+          {
+          out[i] = static_cast<OutputPixelType>( value );
+          }
+        }
       }
-    ++oit;
-    ++it;
     }
 }
 
+template <typename TInputImage, typename TOutputImage >
+void
+MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
+<TInputImage,TOutputImage>
+::ComputeEigenValues( double h00, double h01, double h02,
+                      double h11, double h12, double h22, double *lambda )
+{
+  /** Trigonometric solution of the characteristic polynomial: with
+   * q = trace / 3 and B = ( H - q I ) / p, the eigenvalues are
+   * q + 2 p cos( acos( det( B ) / 2 ) / 3 + 2 k pi / 3 ). */
+  const double offDiagonal = h01 * h01 + h02 * h02 + h12 * h12;
+  const double q = ( h00 + h11 + h22 ) / 3.0;
+  const double b00 = h00 - q;
+  const double b11 = h11 - q;
+  const double b22 = h22 - q;
+  const double p = vcl_sqrt( ( b00 * b00 + b11 * b11 + b22 * b22 +
+    2.0 * offDiagonal ) / 6.0 );
+
+  if( p <= 1e-12 * ( vnl_math_abs( q ) + 1e-300 ) )
+    {
+    lambda[0] = lambda[1] = lambda[2] = q;
+    return;
+    }
+
+  const double determinant = b00 * ( b11 * b22 - h12 * h12 ) -
+    h01 * ( h01 * b22 - h12 * h02 ) + h02 * ( h01 * h12 - b11 * h02 );
+  double r = 0.5 * determinant / ( p * p * p );
+  r = vnl_math_max( -1.0, vnl_math_min( 1.0, r ) );
+
+  const double phi = vcl_acos( r ) / 3.0;
+  const double largest = q + 2.0 * p * vcl_cos( phi );
+  const double smallest = q + 2.0 * p * vcl_cos( phi + 2.0 * vnl_math::pi / 3.0 );
+  const double middle = 3.0 * q - largest - smallest;
+
+  /** Sort by magnitude */
+  lambda[0] = largest;
+  lambda[1] = middle;
+  lambda[2] = smallest;
+  if( vnl_math_abs( lambda[0] ) > vnl_math_abs( lambda[1] ) )
+    {
+    std::swap( lambda[0], lambda[1] );
+    }
+  if( vnl_math_abs( lambda[1] ) > vnl_math_abs( lambda[2] ) )
+    {
+    std::swap( lambda[1], lambda[2] );
+    }
+  if( vnl_math_abs( lambda[0] ) > vnl_math_abs( lambda[1] ) )
+    {
+    std::swap( lambda[0], lambda[1] );
+    }
+}
+
+template <typename TInputImage, typename TOutputImage >
+double
+MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
+<TInputImage,TOutputImage>
+::ComputeVesselness( const double *lambda ) const
+{
+  const double Lambda1 = lambda[0];
+  const double Lambda2 = lambda[1];
+  const double Lambda3 = lambda[2];
+
+  if ( Lambda2 >= 0.0 ||  Lambda3 >= 0.0 || 
+       vnl_math_abs( Lambda2) < EPSILON  || 
+       vnl_math_abs( Lambda3 ) < EPSILON )
+    {
+    return 0.0;
+    }
+
+  double Lambda1Abs = vnl_math_abs( Lambda1 );
+  double Lambda2Abs = vnl_math_abs( Lambda2 );
+  double Lambda3Abs = vnl_math_abs( Lambda3 );
+
+  double Lambda1Sqr = vnl_math_sqr( Lambda1 );
+  double Lambda2Sqr = vnl_math_sqr( Lambda2 );
+  double Lambda3Sqr = vnl_math_sqr( Lambda3 );
+
+  double AlphaSqr = vnl_math_sqr( m_Alpha );
+  double BetaSqr = vnl_math_sqr( m_Beta );
+  double GammaSqr = vnl_math_sqr( m_Gamma );
+
+  double A  = Lambda2Abs / Lambda3Abs; 
+  double B  = Lambda1Abs / vcl_sqrt ( vnl_math_abs( Lambda2 * Lambda3 )); 
+  double S  = vcl_sqrt( Lambda1Sqr + Lambda2Sqr + Lambda3Sqr );
+
+  double vesMeasure_1  = 
+     ( 1 - vcl_exp(-1.0*(( vnl_math_sqr(A) ) / ( 2.0 * ( AlphaSqr)))));
+
+  double vesMeasure_2  = 
+     vcl_exp ( -1.0 * ((vnl_math_sqr( B )) /  ( 2.0 * (BetaSqr))));
+
+  double vesMeasure_3  = 
+     ( 1 - vcl_exp( -1.0 * (( vnl_math_sqr( S )) / ( 2.0 * ( GammaSqr)))));
+
+  double vesMeasure_4  = 
+     vcl_exp ( -1.0 * ( 2.0 * vnl_math_sqr( m_C )) / 
+                               ( Lambda2Abs * (Lambda3Sqr))); 
+
+  return vesMeasure_1 * vesMeasure_2 * vesMeasure_3 * vesMeasure_4; 
+}
+
 template <typename TInputImage, typename TOutputImage >
 double
 MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
@@ -188,6 +613,13 @@ MultiScaleHessianSmoothed3DToVesselnessMeasureImageFilter
   
   os << indent << "SigmaMin:  " << m_SigmaMin << std::endl;
   os << indent << "SigmaMax:  " << m_SigmaMax  << std::endl;
+  os << indent << "NumberOfSigmaSteps:  " << m_NumberOfSigmaSteps << std::endl;
+  os << indent << "Alpha: " << m_Alpha << std::endl;
+  os << indent << "Beta:  " << m_Beta  << std::endl;
+  os << indent << "Gamma: " << m_Gamma << std::endl;
+  os << indent << "C: " << m_C << std::endl;
+  os << indent << "MinimumSamplesPerSigma: " << m_MinimumSamplesPerSigma
+     << std::endl;
 }
 
 
@@ -27,6 +27,8 @@
 
 #include "vnl/vnl_vector.h"
 
+#include <vector>
+
 namespace itk {
 
 /** \class N4MRIBiasFieldCorrectionImageFilter.h
@@ -60,6 +62,16 @@ namespace itk {
  *  5. The 'Z' parameter in Sled's 1998 paper is the square root
  *     of the class variable 'm_WeinerFilterNoise'.
  *
+ * The residual bias field is fitted directly on the voxel grid rather than
+ * through a point set and BSplineScatteredDataPointSetToImageFilter.  The
+ * parametric coordinate of a voxel along an axis only depends on its index
+ * along that axis, so the B-spline weights are tabulated once per axis and
+ * each thread accumulates the numerator and denominator lattices of the
+ * single level fit over a slab of the image.  Since the field is linear in
+ * the control points, the field estimate is updated at the masked voxels
+ * by evaluating only the control point increment; the field is evaluated
+ * at every voxel once, at the end.
+ *
  * \author Nicholas J. Tustison
  *
  * Contributed by Nicholas J. Tustison, James C. Gee
@@ -108,6 +120,7 @@ public:
 
   typedef float                                      RealType;
   typedef Image<RealType, ImageDimension>            RealImageType;
+  typedef typename RealImageType::RegionType         RegionType;
 
   /** B-spline smoothing filter typedefs */
   typedef Vector<RealType, 1>                        ScalarType;
@@ -214,11 +227,41 @@ private:
 
   typename RealImageType::Pointer SharpenImage(
     typename RealImageType::Pointer );
-  typename RealImageType::Pointer UpdateBiasFieldEstimate(
-    typename RealImageType::Pointer );
-  RealType CalculateConvergenceMeasurement(
-    typename RealImageType::Pointer,
-    typename RealImageType::Pointer );
+  /** Fit the residual, add the control points to the lattice and add the
+   * fitted field to the log bias field at the masked voxels.  Returns the
+   * coefficient of variation of the ratio of the old and new bias fields
+   * over the mask. */
+  RealType UpdateBiasFieldEstimate( RealImageType *, RealImageType * );
+
+  /** Tabulate the B-spline weights of the voxel coordinates of the region
+   * for a lattice of the given size. */
+  void ComputeLatticeBasis( const RegionType &,
+    const typename BiasFieldControlPointLatticeType::SizeType & );
+
+  /** Add (masked voxels only) or write (all voxels) the field of the
+   * control point values m_LatticeValues. */
+  void EvaluateLattice( RealImageType *, bool );
+
+  /** Multi-threading support. */
+  struct ThreadStruct
+    {
+    Self *Filter;
+    };
+
+  enum LatticeStepType { FitLatticeStep, EvaluateLatticeStep };
+
+  static ITK_THREAD_RETURN_TYPE LatticeThreaderCallback( void * );
+
+  void ThreadedFitLattice( const RegionType &, unsigned int );
+  void ThreadedEvaluateLattice( const RegionType &, unsigned int );
+
+  /** Weights of the control points of the line of the index (all axes
+   * except 0), with their offsets in the lattice.  Returns the product of
+   * the sums of squared weights over these axes. */
+  double ComputeLineBasis( const typename RegionType::IndexType &,
+    double *, long * ) const;
+
+  static double EvaluateBSplineBasis( unsigned int, double );
 
   MaskPixelType                               m_MaskLabel;
 
@@ -249,6 +292,28 @@ private:
   RealType                                    m_SigmoidNormalizedAlpha;
   RealType                                    m_SigmoidNormalizedBeta;
 
+  /** State of the current fit: weights and first control point of each
+   * voxel coordinate, (SplineOrder+1) weights per coordinate */
+  RegionType                                  m_LatticeBasisRegion;
+  typename
+    BiasFieldControlPointLatticeType::SizeType m_LatticeBasisSize;
+  std::vector<long>                           m_SpanIndices[ImageDimension];
+  std::vector<double>                         m_BasisWeights[ImageDimension];
+  std::vector<double>                         m_BasisSquareSums[ImageDimension];
+  long                                        m_LatticeStrides[ImageDimension];
+
+  LatticeStepType                             m_LatticeStep;
+  RealImageType                               *m_LatticeImage;
+  bool                                        m_IncrementMaskedOnly;
+  bool                                        m_UseSigmoidWeights;
+  RealType                                    m_SigmoidAlpha;
+  RealType                                    m_SigmoidBeta;
+  std::vector<double>                         m_LatticeValues;
+  std::vector<std::vector<double> >           m_ThreadNumerators;
+  std::vector<std::vector<double> >           m_ThreadDenominators;
+  std::vector<double>                         m_ThreadSums;
+  std::vector<double>                         m_ThreadSquareSums;
+  std::vector<double>                         m_ThreadCounts;
 
 }; // end of class
 
@@ -19,12 +19,14 @@
 
 #include "itkN4MRIBiasFieldCorrectionImageFilter.h"
 
-#include "itkAddImageFilter.h"
 #include "itkBSplineControlPointImageFilter.h"
 #include "itkDivideImageFilter.h"
 #include "itkExpImageFilter.h"
+#include "itkImageLinearIteratorWithIndex.h"
+#include "itkImageRegionConstIterator.h"
 #include "itkImageRegionIterator.h"
 #include "itkImageRegionIteratorWithIndex.h"
+#include "itkImageRegionSplitter.h"
 #include "itkIterationReporter.h"
 #include "itkLogImageFilter.h"
 #include "itkSubtractImageFilter.h"
@@ -57,6 +59,10 @@ N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
   this->m_MaximumNumberOfIterations.SetSize( 1 );
   this->m_MaximumNumberOfIterations.Fill( 50 );
   this->m_ConvergenceThreshold = 0.001;
+
+  this->m_LatticeBasisSize.Fill( 0 );
+  this->m_LatticeImage = NULL;
+  this->m_UseSigmoidWeights = false;
 }
 
 template<class TInputImage, class TMaskImage, class TOutputImage>
@@ -64,6 +70,9 @@ void
 N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
 ::GenerateData()
 {
+  this->m_LogBiasFieldControlPointLattice = NULL;
+  this->m_LatticeBasisSize.Fill( 0 );
+
   /**
    * Calculate the log of the input image.
    */
@@ -152,13 +161,10 @@ N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
       /**
        * Smooth the residual bias field estimate and add the resulting
        * control point grid to get the new total bias field estimate.
+       * The log bias field is only updated at the masked voxels.
        */
-      typename RealImageType::Pointer newLogBiasField
-        = this->UpdateBiasFieldEstimate( subtracter1->GetOutput() );
-
-      this->m_CurrentConvergenceMeasurement =
-        this->CalculateConvergenceMeasurement( logBiasField, newLogBiasField );
-      logBiasField = newLogBiasField;
+      this->m_CurrentConvergenceMeasurement = this->UpdateBiasFieldEstimate(
+        subtracter1->GetOutput(), logBiasField );
 
       typename SubtracterType::Pointer subtracter2 = SubtracterType::New();
       subtracter2->SetInput1( logFilter->GetOutput() );
@@ -194,6 +200,25 @@ N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
       RefineControlPointLattice( numberOfLevels );
     }
 
+  /**
+   * Evaluate the final log bias field at all the voxels.
+   */
+  if( this->m_LogBiasFieldControlPointLattice )
+    {
+    this->ComputeLatticeBasis( logBiasField->GetLargestPossibleRegion(),
+      this->m_LogBiasFieldControlPointLattice->GetLargestPossibleRegion().GetSize() );
+
+    const ScalarType *lattice =
+      this->m_LogBiasFieldControlPointLattice->GetBufferPointer();
+    this->m_LatticeValues.resize( this->m_LogBiasFieldControlPointLattice->
+      GetLargestPossibleRegion().GetNumberOfPixels() );
+    for( unsigned long n = 0; n < this->m_LatticeValues.size(); n++ )
+      {
+      this->m_LatticeValues[n] = lattice[n][0];
+      }
+    this->EvaluateLattice( logBiasField, false );
+    }
+
   typedef ExpImageFilter<RealImageType, RealImageType> ExpImageFilterType;
   typename ExpImageFilterType::Pointer expFilter = ExpImageFilterType::New();
   expFilter->SetInput( logBiasField );
@@ -444,9 +469,10 @@ N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
 
 template<class TInputImage, class TMaskImage, class TOutputImage>
 typename N4MRIBiasFieldCorrectionImageFilter
-  <TInputImage, TMaskImage, TOutputImage>::RealImageType::Pointer
+  <TInputImage, TMaskImage, TOutputImage>::RealType
 N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
-::UpdateBiasFieldEstimate( typename RealImageType::Pointer fieldEstimate )
+::UpdateBiasFieldEstimate( RealImageType *fieldEstimate,
+  RealImageType *logBiasField )
 {
   /**
    * Calculate min/max for sigmoid weighting.  Calculate mean for offseting
@@ -478,194 +504,507 @@ N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
         }
       }
     }
+  this->m_UseSigmoidWeights = ( this->m_SigmoidNormalizedAlpha > 0.0 );
+  if( this->m_UseSigmoidWeights )
+    {
+    this->m_SigmoidAlpha = ( maxAbsValue - minAbsValue ) /
+      ( 12.0 * this->m_SigmoidNormalizedAlpha );
+    this->m_SigmoidBeta = minAbsValue + ( maxAbsValue - minAbsValue ) *
+      this->m_SigmoidNormalizedBeta;
+    }
 
   /**
-   * Get original direction and change to identity temporarily for the
-   * b-spline fitting.
+   * The lattice is fitted in the index space of the image, as the point set
+   * fit was done with an identity direction and a parametric origin at the
+   * first voxel.
    */
-  typename RealImageType::DirectionType direction
-    = fieldEstimate->GetDirection();
-  typename RealImageType::DirectionType identity;
-  identity.SetIdentity();
-  fieldEstimate->SetDirection( identity );
-
-  typename PointSetType::Pointer fieldPoints = PointSetType::New();
-  fieldPoints->Initialize();
-
-  typename BSplineFilterType::WeightsContainerType::Pointer weights =
-    BSplineFilterType::WeightsContainerType::New();
-  weights->Initialize();
-  ImageRegionConstIteratorWithIndex<RealImageType>
-    It( fieldEstimate, fieldEstimate->GetRequestedRegion() );
-  unsigned int index = 0;
-  for ( It.GoToBegin(); !It.IsAtEnd(); ++It )
+  typename BiasFieldControlPointLatticeType::SizeType numberOfControlPoints;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
     {
-    if( ( !this->GetMaskImage() ||
-      this->GetMaskImage()->GetPixel( It.GetIndex() ) == this->m_MaskLabel )
-      && ( !this->GetConfidenceImage() ||
-      this->GetConfidenceImage()->GetPixel( It.GetIndex() ) > 0.0 ) )
+    if( !this->m_LogBiasFieldControlPointLattice )
       {
-      typename PointSetType::PointType point;
-      fieldEstimate->TransformIndexToPhysicalPoint( It.GetIndex(), point );
+      numberOfControlPoints[d] = this->m_NumberOfControlPoints[d];
+      }
+    else
+      {
+      numberOfControlPoints[d] = this->m_LogBiasFieldControlPointLattice->
+        GetLargestPossibleRegion().GetSize()[d];
+      }
+    }
+  this->ComputeLatticeBasis( fieldEstimate->GetLargestPossibleRegion(),
+    numberOfControlPoints );
 
-      ScalarType scalar;
-      scalar[0] = It.Get();
+  unsigned long numberOfLatticeValues = 1;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    numberOfLatticeValues *= numberOfControlPoints[d];
+    }
 
-      fieldPoints->SetPointData( index, scalar );
-      fieldPoints->SetPoint( index, point );
+  /**
+   * Each thread accumulates the numerator and the denominator of the
+   * control point values over a slab, the lattices are summed afterwards.
+   */
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+  const unsigned int numberOfThreads =
+    this->GetMultiThreader()->GetNumberOfThreads();
+
+  this->m_ThreadNumerators.assign( numberOfThreads,
+    std::vector<double>( numberOfLatticeValues, 0.0 ) );
+  this->m_ThreadDenominators.assign( numberOfThreads,
+    std::vector<double>( numberOfLatticeValues, 0.0 ) );
+
+  ThreadStruct str;
+  str.Filter = this;
+
+  this->m_LatticeStep = FitLatticeStep;
+  this->m_LatticeImage = fieldEstimate;
+  this->GetMultiThreader()->SetSingleMethod(
+    this->LatticeThreaderCallback, &str );
+  this->GetMultiThreader()->SingleMethodExecute();
+
+  this->m_LatticeValues.assign( numberOfLatticeValues, 0.0 );
+  for( unsigned long n = 0; n < numberOfLatticeValues; n++ )
+    {
+    double numerator = 0.0;
+    double denominator = 0.0;
+    for( unsigned int i = 0; i < numberOfThreads; i++ )
+      {
+      numerator += this->m_ThreadNumerators[i][n];
+      denominator += this->m_ThreadDenominators[i][n];
+      }
+    if( denominator != 0.0 )
+      {
+      this->m_LatticeValues[n] = numerator / denominator;
+      }
+    }
+  this->m_ThreadNumerators.clear();
+  this->m_ThreadDenominators.clear();
 
-      RealType confidenceWeight = 1.0;
-      if( this->GetConfidenceImage() )
+  /**
+   * Add the bias field control points to the current estimate.
+   */
+  if( !this->m_LogBiasFieldControlPointLattice )
+    {
+    this->m_LogBiasFieldControlPointLattice =
+      BiasFieldControlPointLatticeType::New();
+    this->m_LogBiasFieldControlPointLattice->SetRegions( numberOfControlPoints );
+    this->m_LogBiasFieldControlPointLattice->Allocate();
+    ScalarType zero;
+    zero.Fill( 0.0 );
+    this->m_LogBiasFieldControlPointLattice->FillBuffer( zero );
+    }
+  ScalarType *lattice =
+    this->m_LogBiasFieldControlPointLattice->GetBufferPointer();
+  for( unsigned long n = 0; n < numberOfLatticeValues; n++ )
+    {
+    lattice[n][0] += static_cast<RealType>( this->m_LatticeValues[n] );
+    }
+  this->m_LogBiasFieldControlPointLattice->Modified();
+
+  /**
+   * Add the field of the new control points to the log bias field at the
+   * masked voxels and calculate the statistics of exp( old - new ) there.
+   * The sums are of exp( old - new ) - 1, which is small.
+   */
+  this->EvaluateLattice( logBiasField, true );
+
+  double N = 0.0;
+  double sum = 0.0;
+  double squareSum = 0.0;
+  for( unsigned int i = 0; i < this->m_ThreadCounts.size(); i++ )
+    {
+    N += this->m_ThreadCounts[i];
+    sum += this->m_ThreadSums[i];
+    squareSum += this->m_ThreadSquareSums[i];
+    }
+  RealType mu = 1.0 + sum / N;
+  RealType sigma = vcl_sqrt( vnl_math_max( 0.0,
+    ( squareSum - sum * sum / N ) / ( N - 1.0 ) ) );
+
+  return ( sigma / mu );
+}
+
+template<class TInputImage, class TMaskImage, class TOutputImage>
+void
+N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
+::ComputeLatticeBasis( const RegionType &region,
+  const typename BiasFieldControlPointLatticeType::SizeType &latticeSize )
+{
+  if( region == this->m_LatticeBasisRegion &&
+    latticeSize == this->m_LatticeBasisSize )
+    {
+    return;
+    }
+
+  const unsigned int width = this->m_SplineOrder + 1;
+
+  long stride = 1;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    if( latticeSize[d] <= this->m_SplineOrder )
+      {
+      itkExceptionMacro( "The number of control points must be greater "
+        << "than the spline order." );
+      }
+    this->m_LatticeStrides[d] = stride;
+    stride *= latticeSize[d];
+
+    /**
+     * The coordinate j of a voxel maps to u = j / ( size - 1 ) * spans.
+     * The last voxel belongs to the last span.
+     */
+    const unsigned long size = region.GetSize()[d];
+    const long numberOfSpans = latticeSize[d] - this->m_SplineOrder;
+
+    this->m_SpanIndices[d].resize( size );
+    this->m_BasisWeights[d].resize( size * width );
+    this->m_BasisSquareSums[d].resize( size );
+    for( unsigned long j = 0; j < size; j++ )
+      {
+      double u = 0.0;
+      if( size > 1 )
         {
-        confidenceWeight =
-          this->GetConfidenceImage()->GetPixel( It.GetIndex() );
+        u = static_cast<double>( numberOfSpans ) * static_cast<double>( j )
+          / static_cast<double>( size - 1 );
         }
-      RealType sigmoidWeight = 1.0;
-      if( this->m_SigmoidNormalizedAlpha > 0.0 )
-        {
-        RealType alpha = ( maxAbsValue - minAbsValue ) /
-          ( 12.0 * this->m_SigmoidNormalizedAlpha );
-        RealType beta = minAbsValue + ( maxAbsValue - minAbsValue ) *
-          this->m_SigmoidNormalizedBeta;
+      long span = vnl_math_min( static_cast<long>( vcl_floor( u ) ),
+        numberOfSpans - 1 );
+      double t = u - static_cast<double>( span );
 
-        sigmoidWeight = 1.0 / ( 1.0 + vcl_exp(
-          -( scalar[0] - beta ) / alpha ) );
+      double squareSum = 0.0;
+      for( unsigned int k = 0; k < width; k++ )
+        {
+        double weight = EvaluateBSplineBasis( this->m_SplineOrder,
+          t - static_cast<double>( k ) + 0.5 * ( this->m_SplineOrder - 1.0 ) );
+        this->m_BasisWeights[d][j * width + k] = weight;
+        squareSum += weight * weight;
         }
-      weights->InsertElement( index, sigmoidWeight * confidenceWeight );
-      index++;
+      this->m_SpanIndices[d][j] = span;
+      this->m_BasisSquareSums[d][j] = squareSum;
       }
     }
-  fieldEstimate->SetDirection( direction );
 
-  typename BSplineFilterType::Pointer bspliner = BSplineFilterType::New();
+  this->m_LatticeBasisRegion = region;
+  this->m_LatticeBasisSize = latticeSize;
+}
 
-  typename BSplineFilterType::ArrayType numberOfControlPoints;
-  typename BSplineFilterType::ArrayType numberOfFittingLevels;
-  numberOfFittingLevels.Fill( 1 );
-  for( unsigned int d = 0; d < ImageDimension; d++ )
+template<class TInputImage, class TMaskImage, class TOutputImage>
+void
+N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
+::EvaluateLattice( RealImageType *field, bool incrementMaskedOnly )
+{
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+  const unsigned int numberOfThreads =
+    this->GetMultiThreader()->GetNumberOfThreads();
+  this->m_ThreadSums.assign( numberOfThreads, 0.0 );
+  this->m_ThreadSquareSums.assign( numberOfThreads, 0.0 );
+  this->m_ThreadCounts.assign( numberOfThreads, 0.0 );
+
+  ThreadStruct str;
+  str.Filter = this;
+
+  this->m_LatticeStep = EvaluateLatticeStep;
+  this->m_LatticeImage = field;
+  this->m_IncrementMaskedOnly = incrementMaskedOnly;
+  this->GetMultiThreader()->SetSingleMethod(
+    this->LatticeThreaderCallback, &str );
+  this->GetMultiThreader()->SingleMethodExecute();
+
+  this->m_LatticeImage = NULL;
+  field->Modified();
+}
+
+template<class TInputImage, class TMaskImage, class TOutputImage>
+ITK_THREAD_RETURN_TYPE
+N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
+::LatticeThreaderCallback( void *arg )
+{
+  unsigned int threadId =
+    ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount =
+    ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct *str = (ThreadStruct *)
+    ( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+  Self *filter = str->Filter;
+
+  typedef ImageRegionSplitter<ImageDimension> SplitterType;
+  typename SplitterType::Pointer splitter = SplitterType::New();
+
+  RegionType region = filter->m_LatticeBasisRegion;
+  unsigned int total = splitter->GetNumberOfSplits( region, threadCount );
+  if( threadId < total )
     {
-    if( !this->m_LogBiasFieldControlPointLattice )
+    region = splitter->GetSplit( threadId, total, region );
+    if( filter->m_LatticeStep == FitLatticeStep )
       {
-      numberOfControlPoints[d] = this->m_NumberOfControlPoints[d];
+      filter->ThreadedFitLattice( region, threadId );
       }
     else
       {
-      numberOfControlPoints[d] = this->m_LogBiasFieldControlPointLattice->
-        GetLargestPossibleRegion().GetSize()[d];
+      filter->ThreadedEvaluateLattice( region, threadId );
       }
     }
 
-  typename ScalarImageType::PointType parametricOrigin =
-    fieldEstimate->GetOrigin();
-  for( unsigned int d = 0; d < ImageDimension; d++ )
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template<class TInputImage, class TMaskImage, class TOutputImage>
+void
+N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
+::ThreadedFitLattice( const RegionType &region, unsigned int threadId )
+{
+  const unsigned int width = this->m_SplineOrder + 1;
+  unsigned int numberOfLineWeights = 1;
+  for( unsigned int d = 1; d < ImageDimension; d++ )
     {
-    parametricOrigin[d] += ( fieldEstimate->GetSpacing()[d] *
-      fieldEstimate->GetLargestPossibleRegion().GetIndex()[d] );
-    }
-  bspliner->SetOrigin( parametricOrigin );
-  bspliner->SetSpacing( fieldEstimate->GetSpacing() );
-  bspliner->SetSize( fieldEstimate->GetLargestPossibleRegion().GetSize() );
-  bspliner->SetDirection( fieldEstimate->GetDirection() );
-  bspliner->SetGenerateOutputImage( false );
-  bspliner->SetNumberOfLevels( numberOfFittingLevels );
-  bspliner->SetSplineOrder( this->m_SplineOrder );
-  bspliner->SetNumberOfControlPoints( numberOfControlPoints );
-  bspliner->SetInput( fieldPoints );
-  bspliner->SetPointWeights( weights );
-  bspliner->Update();
+    numberOfLineWeights *= width;
+    }
+  std::vector<double> lineWeights( numberOfLineWeights );
+  std::vector<long> lineOffsets( numberOfLineWeights );
 
-  /**
-   * Add the bias field control points to the current estimate.
-   */
-  if( !this->m_LogBiasFieldControlPointLattice )
+  double *numerator = &this->m_ThreadNumerators[threadId][0];
+  double *denominator = &this->m_ThreadDenominators[threadId][0];
+  const long start = this->m_LatticeBasisRegion.GetIndex()[0];
+
+  const MaskImageType *mask = this->GetMaskImage();
+  const RealImageType *confidence = this->GetConfidenceImage();
+  ImageRegionConstIterator<MaskImageType> ItM;
+  if( mask )
     {
-    this->m_LogBiasFieldControlPointLattice = bspliner->GetPhiLattice();
+    ItM = ImageRegionConstIterator<MaskImageType>( mask, region );
+    ItM.GoToBegin();
     }
-  else
+  ImageRegionConstIterator<RealImageType> ItC;
+  if( confidence )
     {
-    typedef AddImageFilter<BiasFieldControlPointLatticeType,
-      BiasFieldControlPointLatticeType, BiasFieldControlPointLatticeType> AdderType;
-    typename AdderType::Pointer adder = AdderType::New();
-    adder->SetInput1( this->m_LogBiasFieldControlPointLattice );
-    adder->SetInput2( bspliner->GetPhiLattice() );
-    adder->Update();
+    ItC = ImageRegionConstIterator<RealImageType>( confidence, region );
+    ItC.GoToBegin();
+    }
 
-    this->m_LogBiasFieldControlPointLattice = adder->GetOutput();
+  ImageLinearConstIteratorWithIndex<RealImageType> It(
+    this->m_LatticeImage, region );
+  It.SetDirection( 0 );
+  It.GoToBegin();
+  while( !It.IsAtEnd() )
+    {
+    const double lineSquareSum = this->ComputeLineBasis( It.GetIndex(),
+      &lineWeights[0], &lineOffsets[0] );
+    while( !It.IsAtEndOfLine() )
+      {
+      RealType weight = 1.0;
+      bool isInside = true;
+      if( mask )
+        {
+        isInside = ( ItM.Get() == this->m_MaskLabel );
+        ++ItM;
+        }
+      if( confidence )
+        {
+        weight = ItC.Get();
+        isInside = isInside && ( weight > 0.0 );
+        ++ItC;
+        }
+      if( isInside )
+        {
+        const RealType value = It.Get();
+        if( this->m_UseSigmoidWeights )
+          {
+          weight *= 1.0 / ( 1.0 + vcl_exp(
+            -( value - this->m_SigmoidBeta ) / this->m_SigmoidAlpha ) );
+          }
+
+        /**
+         * Each control point of the support gets w B^2 in the denominator
+         * and w B^2 ( r B / sum B^2 ) in the numerator.
+         */
+        const long j = It.GetIndex()[0] - start;
+        const long span = this->m_SpanIndices[0][j];
+        const double *weights = &this->m_BasisWeights[0][j * width];
+        const double scale = weight * value /
+          ( lineSquareSum * this->m_BasisSquareSums[0][j] );
+        for( unsigned int n = 0; n < numberOfLineWeights; n++ )
+          {
+          double *num = numerator + lineOffsets[n] + span;
+          double *den = denominator + lineOffsets[n] + span;
+          for( unsigned int k = 0; k < width; k++ )
+            {
+            const double B = weights[k] * lineWeights[n];
+            const double B2 = B * B;
+            den[k] += weight * B2;
+            num[k] += scale * B2 * B;
+            }
+          }
+        }
+      ++It;
+      }
+    It.NextLine();
     }
+}
 
-  typedef BSplineControlPointImageFilter<BiasFieldControlPointLatticeType,
-    ScalarImageType> BSplineReconstructerType;
-  typename BSplineReconstructerType::Pointer reconstructer =
-    BSplineReconstructerType::New();
-  reconstructer->SetInput( this->m_LogBiasFieldControlPointLattice );
-  reconstructer->SetOrigin( fieldEstimate->GetOrigin() );
-  reconstructer->SetSpacing( fieldEstimate->GetSpacing() );
-  reconstructer->SetDirection( direction );
-  reconstructer->SetSize( fieldEstimate->GetLargestPossibleRegion().GetSize() );
-  reconstructer->Update();
+template<class TInputImage, class TMaskImage, class TOutputImage>
+void
+N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
+::ThreadedEvaluateLattice( const RegionType &region, unsigned int threadId )
+{
+  const unsigned int width = this->m_SplineOrder + 1;
+  unsigned int numberOfLineWeights = 1;
+  for( unsigned int d = 1; d < ImageDimension; d++ )
+    {
+    numberOfLineWeights *= width;
+    }
+  std::vector<double> lineWeights( numberOfLineWeights );
+  std::vector<long> lineOffsets( numberOfLineWeights );
 
-  typename RealImageType::Pointer smoothField = RealImageType::New();
-  smoothField->SetOrigin( fieldEstimate->GetOrigin() );
-  smoothField->SetSpacing( fieldEstimate->GetSpacing() );
-  smoothField->SetRegions( fieldEstimate->GetLargestPossibleRegion() );
-  smoothField->SetDirection( direction );
-  smoothField->Allocate();
+  const double *values = &this->m_LatticeValues[0];
+  const long start = this->m_LatticeBasisRegion.GetIndex()[0];
 
-  ImageRegionIterator<ScalarImageType> ItR( reconstructer->GetOutput(),
-    reconstructer->GetOutput()->GetLargestPossibleRegion() );
-  ImageRegionIterator<RealImageType> ItF( smoothField,
-    smoothField->GetLargestPossibleRegion() );
-  for( ItR.GoToBegin(), ItF.GoToBegin(); !ItR.IsAtEnd(); ++ItR, ++ItF )
+  const MaskImageType *mask = NULL;
+  const RealImageType *confidence = NULL;
+  if( this->m_IncrementMaskedOnly )
+    {
+    mask = this->GetMaskImage();
+    confidence = this->GetConfidenceImage();
+    }
+  ImageRegionConstIterator<MaskImageType> ItM;
+  if( mask )
     {
-    ItF.Set( ItR.Get()[0] );
+    ItM = ImageRegionConstIterator<MaskImageType>( mask, region );
+    ItM.GoToBegin();
+    }
+  ImageRegionConstIterator<RealImageType> ItC;
+  if( confidence )
+    {
+    ItC = ImageRegionConstIterator<RealImageType>( confidence, region );
+    ItC.GoToBegin();
+    }
+
+  double N = 0.0;
+  double sum = 0.0;
+  double squareSum = 0.0;
+
+  ImageLinearIteratorWithIndex<RealImageType> It(
+    this->m_LatticeImage, region );
+  It.SetDirection( 0 );
+  It.GoToBegin();
+  while( !It.IsAtEnd() )
+    {
+    this->ComputeLineBasis( It.GetIndex(), &lineWeights[0], &lineOffsets[0] );
+    while( !It.IsAtEndOfLine() )
+      {
+      bool isInside = true;
+      if( mask )
+        {
+        isInside = ( ItM.Get() == this->m_MaskLabel );
+        ++ItM;
+        }
+      if( confidence )
+        {
+        isInside = isInside && ( ItC.Get() > 0.0 );
+        ++ItC;
+        }
+      if( isInside )
+        {
+        const long j = It.GetIndex()[0] - start;
+        const long span = this->m_SpanIndices[0][j];
+        const double *weights = &this->m_BasisWeights[0][j * width];
+
+        double fieldValue = 0.0;
+        for( unsigned int n = 0; n < numberOfLineWeights; n++ )
+          {
+          const double *v = values + lineOffsets[n] + span;
+          double lineValue = 0.0;
+          for( unsigned int k = 0; k < width; k++ )
+            {
+            lineValue += weights[k] * v[k];
+            }
+          fieldValue += lineWeights[n] * lineValue;
+          }
+
+        if( this->m_IncrementMaskedOnly )
+          {
+          const RealType oldValue = It.Get();
+          const RealType newValue =
+            oldValue + static_cast<RealType>( fieldValue );
+          It.Set( newValue );
+
+          const double ratio = vcl_exp( oldValue - newValue ) - 1.0;
+          N += 1.0;
+          sum += ratio;
+          squareSum += ratio * ratio;
+          }
+        else
+          {
+          It.Set( static_cast<RealType>( fieldValue ) );
+          }
+        }
+      ++It;
+      }
+    It.NextLine();
     }
 
-  return smoothField;
+  this->m_ThreadCounts[threadId] = N;
+  this->m_ThreadSums[threadId] = sum;
+  this->m_ThreadSquareSums[threadId] = squareSum;
 }
 
 template<class TInputImage, class TMaskImage, class TOutputImage>
-typename N4MRIBiasFieldCorrectionImageFilter
-  <TInputImage, TMaskImage, TOutputImage>::RealType
+double
 N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
-::CalculateConvergenceMeasurement( typename RealImageType::Pointer
-  fieldEstimate1, typename RealImageType::Pointer fieldEstimate2 )
+::ComputeLineBasis( const typename RegionType::IndexType &index,
+  double *weights, long *offsets ) const
 {
-  typedef SubtractImageFilter<RealImageType, RealImageType, RealImageType>
-    SubtracterType;
-  typename SubtracterType::Pointer subtracter = SubtracterType::New();
-  subtracter->SetInput1( fieldEstimate1 );
-  subtracter->SetInput2( fieldEstimate2 );
-  subtracter->Update();
+  const unsigned int width = this->m_SplineOrder + 1;
 
   /**
-   * Calculate statistics over the mask region
+   * Outer product of the weights of axes 1, 2, ...; axis d is the more
+   * significant digit of the product index, so it is filled from the top.
    */
-  RealType mu = 0.0;
-  RealType sigma = 0.0;
-  RealType N = 0.0;
-
-  ImageRegionConstIteratorWithIndex<RealImageType> It( subtracter->GetOutput(),
-    subtracter->GetOutput()->GetLargestPossibleRegion() );
-  for( It.GoToBegin(); !It.IsAtEnd(); ++It )
+  weights[0] = 1.0;
+  offsets[0] = 0;
+  unsigned int count = 1;
+  double squareSum = 1.0;
+  for( unsigned int d = 1; d < ImageDimension; d++ )
     {
-    if( ( !this->GetMaskImage() ||
-      this->GetMaskImage()->GetPixel( It.GetIndex() ) == this->m_MaskLabel )
-      && ( !this->GetConfidenceImage() ||
-      this->GetConfidenceImage()->GetPixel( It.GetIndex() ) > 0.0 ) )
+    const long j = index[d] - this->m_LatticeBasisRegion.GetIndex()[d];
+    const long span = this->m_SpanIndices[d][j];
+    const double *w = &this->m_BasisWeights[d][j * width];
+    squareSum *= this->m_BasisSquareSums[d][j];
+    for( int k = width - 1; k >= 0; k-- )
       {
-      RealType pixel = vcl_exp( It.Get() );
-      N += 1.0;
-
-      if( N > 1.0 )
+      for( unsigned int c = 0; c < count; c++ )
         {
-        sigma = sigma + vnl_math_sqr( pixel - mu ) * ( N - 1.0 ) / N;
+        weights[k * count + c] = weights[c] * w[k];
+        offsets[k * count + c] = offsets[c] +
+          ( span + k ) * this->m_LatticeStrides[d];
         }
-      mu = mu * ( 1.0 - 1.0 / N ) + pixel / N;
       }
+    count *= width;
     }
-  sigma = vcl_sqrt( sigma / ( N - 1.0 ) );
+  return squareSum;
+}
 
-  return ( sigma / mu );
+template<class TInputImage, class TMaskImage, class TOutputImage>
+double
+N4MRIBiasFieldCorrectionImageFilter<TInputImage, TMaskImage, TOutputImage>
+::EvaluateBSplineBasis( unsigned int order, double x )
+{
+  /**
+   * Centered uniform B-spline of the given order (Cox-de Boor recursion),
+   * the kernel of BSplineScatteredDataPointSetToImageFilter.
+   */
+  if( order == 0 )
+    {
+    return ( x >= -0.5 && x < 0.5 ) ? 1.0 : 0.0;
+    }
+  const double halfWidth = 0.5 * static_cast<double>( order + 1 );
+  if( x <= -halfWidth || x >= halfWidth )
+    {
+    return 0.0;
+    }
+  return ( ( halfWidth + x ) * EvaluateBSplineBasis( order - 1, x + 0.5 )
+    + ( halfWidth - x ) * EvaluateBSplineBasis( order - 1, x - 0.5 ) )
+    / static_cast<double>( order );
 }
 
 template<class TInputImage, class TMaskImage, class TOutputImage>
@@ -21,10 +21,22 @@
 
 #include "itkConstNeighborhoodIterator.h"
 
+#include <vector>
+
 namespace itk {
 
 /** \class ScalarToFractalImageFilter
-
+ * \brief Local fractal dimension from the power law of the mean absolute
+ * intensity difference versus the distance of the voxel pairs of the
+ * neighborhood.
+ *
+ * The voxel pairs of the neighborhood are grouped in distance bins.  The
+ * bin of each pair displacement is tabulated once.  For every displacement
+ * the sum of the absolute intensity differences of the pairs in the
+ * neighborhood is updated incrementally as the neighborhood slides along
+ * the image lines:  only the columns of pairs entering and leaving the
+ * neighborhood are visited.  The filter is multithreaded over the output
+ * region.
  */
 template<class TInputImage, class TOutputImage>
 class ITK_EXPORT ScalarToFractalImageFilter :
@@ -49,6 +61,7 @@ public:
   typedef TInputImage                             InputImageType;
   typedef TOutputImage                            OutputImageType;
   typedef Image<char, ImageDimension>             MaskImageType;
+  typedef typename OutputImageType::RegionType    OutputImageRegionType;
 
 
   /** Runtime information support. */
@@ -70,15 +83,51 @@ protected:
   ~ScalarToFractalImageFilter() {};
   void PrintSelf( std::ostream& os, Indent indent ) const;
 
-  void GenerateData();
+  void GenerateInputRequestedRegion() throw( InvalidRequestedRegionError );
+
+  void BeforeThreadedGenerateData();
+
+  void ThreadedGenerateData( const OutputImageRegionType& outputRegionForThread,
+                             int threadId );
 
 private:
   ScalarToFractalImageFilter( const Self& ); //purposely not implemented
   void operator=( const Self& ); //purposely not implemented
 
+  typedef typename InputImageType::IndexType      IndexType;
+  typedef typename InputImageType::OffsetType     OffsetType;
+  typedef typename InputImageType::OffsetValueType OffsetValueType;
+
+  /** Displacement between the two voxels of a pair.  Only one of the
+   *  displacements +/-Offset is kept since both give the same absolute
+   *  differences.  The pairs of the neighborhood centered at c with this
+   *  displacement are ( a, a + Offset ) with a[0] in
+   *  [c[0] + FirstColumn, c[0] + LastColumn] and a[d] - c[d] given by
+   *  ColumnOffsets for the other dimensions. */
+  struct DisplacementType
+    {
+    OffsetType                     Offset;
+    OffsetValueType                BufferOffset;
+    long                           FirstColumn;
+    long                           LastColumn;
+    std::vector<OffsetType>        ColumnOffsets;
+    std::vector<OffsetValueType>   ColumnBufferOffsets;
+    unsigned int                   Bin;
+    };
+
+  /** Sum and number of the absolute intensity differences of the pairs of
+   *  one column of a displacement.  The index is the first voxel of the
+   *  column. */
+  void ComputeColumn( const DisplacementType &, const IndexType &, bool,
+    RealType &, RealType & ) const;
+
   RadiusType                       m_NeighborhoodRadius;
   typename MaskImageType::Pointer  m_MaskImage;
 
+  std::vector<DisplacementType>    m_Displacements;
+  std::vector<RealType>            m_BinLogDistances;
+  bool                             m_UseMaskBuffer;
+
 }; // end of class
 
 } // end namespace itk
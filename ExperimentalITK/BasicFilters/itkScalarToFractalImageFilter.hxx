@@ -19,9 +19,13 @@
 
 #include "itkScalarToFractalImageFilter.h"
 
-#include "itkNeighborhoodAlgorithm.h"
+#include "itkImageLinearIteratorWithIndex.h"
+#include "itkNeighborhood.h"
 #include "itkProgressReporter.h"
 
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
 #include <vector>
 
 namespace itk {
@@ -38,146 +42,415 @@ ScalarToFractalImageFilter<TInputImage, TOutputImage>
 template<class TInputImage, class TOutputImage>
 void
 ScalarToFractalImageFilter<TInputImage, TOutputImage>
-::GenerateData()
+::GenerateInputRequestedRegion() throw( InvalidRequestedRegionError )
 {
-  this->AllocateOutputs();
+  Superclass::GenerateInputRequestedRegion();
+
+  typename InputImageType::Pointer inputPtr =
+    const_cast<InputImageType *>( this->GetInput() );
+  typename OutputImageType::Pointer outputPtr = this->GetOutput();
+
+  if( !inputPtr || !outputPtr )
+    {
+    return;
+    }
+
+  // The neighborhood of the output voxels must be in the input
+  typename InputImageType::RegionType inputRequestedRegion;
+  inputRequestedRegion = outputPtr->GetRequestedRegion();
+  inputRequestedRegion.PadByRadius( this->m_NeighborhoodRadius );
 
-  ProgressReporter progress( this, 0, 
-    this->GetInput()->GetRequestedRegion().GetNumberOfPixels(), 100 );
+  if( inputRequestedRegion.Crop( inputPtr->GetLargestPossibleRegion() ) )
+    {
+    inputPtr->SetRequestedRegion( inputRequestedRegion );
+    return;
+    }
+  else
+    {
+    inputPtr->SetRequestedRegion( inputRequestedRegion );
 
-  typedef typename NeighborhoodAlgorithm
-    ::ImageBoundaryFacesCalculator<InputImageType> FaceCalculatorType;
-  FaceCalculatorType faceCalculator;
+    InvalidRequestedRegionError e( __FILE__, __LINE__ );
+    e.SetLocation( ITK_LOCATION );
+    e.SetDescription( "Requested region is (at least partially) outside the largest possible region." );
+    e.SetDataObject( inputPtr );
+    throw e;
+    }
+}
 
-  typename FaceCalculatorType::FaceListType faceList
-    = faceCalculator( this->GetInput(),
-    this->GetInput()->GetRequestedRegion(), this->m_NeighborhoodRadius );
-  typename FaceCalculatorType::FaceListType::iterator fit;
+template<class TInputImage, class TOutputImage>
+void
+ScalarToFractalImageFilter<TInputImage, TOutputImage>
+::BeforeThreadedGenerateData()
+{
+  const InputImageType *input = this->GetInput();
 
-  RealType minSpacing = this->GetInput()->GetSpacing()[0];
+  RealType minSpacing = input->GetSpacing()[0];
   for( unsigned int d = 0; d < ImageDimension; d++ )
     {
-    if( this->GetInput()->GetSpacing()[d] < minSpacing )
+    if( input->GetSpacing()[d] < minSpacing )
       {
-      minSpacing = this->GetInput()->GetSpacing()[d];
+      minSpacing = input->GetSpacing()[d];
+      }
+    }
+
+  /**
+   * The distance bins are the ones found by a pass over all the voxel
+   * pairs of the neighborhood:  a pair goes in the first bin whose squared
+   * distance is within half the minimum spacing of its own, otherwise it
+   * starts a new bin.
+   */
+  Neighborhood<char, ImageDimension> neighborhood;
+  neighborhood.SetRadius( this->m_NeighborhoodRadius );
+
+  std::vector<RealType> binDistances;
+  for( unsigned int i = 0; i < neighborhood.Size(); i++ )
+    {
+    for( unsigned int j = 0; j < neighborhood.Size(); j++ )
+      {
+      if( i == j )
+        {
+        continue;
+        }
+      RealType distance = 0.0;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        distance += vnl_math_sqr( input->GetSpacing()[d] *
+          ( neighborhood.GetOffset( j )[d] - neighborhood.GetOffset( i )[d] ) );
+        }
+
+      bool distanceFound = false;
+      for( unsigned int k = 0; k < binDistances.size(); k++ )
+        {
+        if( vnl_math_abs( binDistances[k] - distance ) < 0.5 * minSpacing )
+          {
+          distanceFound = true;
+          break;
+          }
+        }
+      if( !distanceFound )
+        {
+        binDistances.push_back( distance );
+        }
+      }
+    }
+
+  this->m_BinLogDistances.resize( binDistances.size() );
+  for( unsigned int k = 0; k < binDistances.size(); k++ )
+    {
+    this->m_BinLogDistances[k] = vcl_log( vcl_sqrt( binDistances[k] ) );
+    }
+
+  /**
+   * The displacements between two voxels of the neighborhood are the
+   * offsets of the neighborhood of twice the radius.  The ones after the
+   * center are the opposites of the ones before.
+   */
+  RadiusType displacementRadius;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    displacementRadius[d] = 2 * this->m_NeighborhoodRadius[d];
+    }
+  Neighborhood<char, ImageDimension> displacementNeighborhood;
+  displacementNeighborhood.SetRadius( displacementRadius );
+
+  const OffsetValueType *offsetTable = input->GetOffsetTable();
+
+  this->m_Displacements.clear();
+  for( unsigned int n = displacementNeighborhood.GetCenterNeighborhoodIndex() + 1;
+    n < displacementNeighborhood.Size(); n++ )
+    {
+    DisplacementType displacement;
+    displacement.Offset = displacementNeighborhood.GetOffset( n );
+
+    RealType distance = 0.0;
+    displacement.BufferOffset = 0;
+    OffsetType lower;
+    OffsetType upper;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      long radius = static_cast<long>( this->m_NeighborhoodRadius[d] );
+      lower[d] = -radius + vnl_math_max( 0L,
+        static_cast<long>( -displacement.Offset[d] ) );
+      upper[d] = radius - vnl_math_max( 0L,
+        static_cast<long>( displacement.Offset[d] ) );
+
+      distance += vnl_math_sqr( input->GetSpacing()[d] * displacement.Offset[d] );
+      displacement.BufferOffset += displacement.Offset[d] * offsetTable[d];
+      }
+    displacement.FirstColumn = lower[0];
+    displacement.LastColumn = upper[0];
+
+    OffsetType columnOffset;
+    columnOffset[0] = 0;
+    for( unsigned int d = 1; d < ImageDimension; d++ )
+      {
+      columnOffset[d] = lower[d];
+      }
+    bool isAtEnd = false;
+    while( !isAtEnd )
+      {
+      OffsetValueType bufferOffset = 0;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        bufferOffset += columnOffset[d] * offsetTable[d];
+        }
+      displacement.ColumnOffsets.push_back( columnOffset );
+      displacement.ColumnBufferOffsets.push_back( bufferOffset );
+
+      isAtEnd = true;
+      for( unsigned int d = 1; d < ImageDimension; d++ )
+        {
+        if( ++columnOffset[d] <= upper[d] )
+          {
+          isAtEnd = false;
+          break;
+          }
+        columnOffset[d] = lower[d];
+        }
+      }
+
+    displacement.Bin = 0;
+    for( unsigned int k = 0; k < binDistances.size(); k++ )
+      {
+      if( vnl_math_abs( binDistances[k] - distance ) < 0.5 * minSpacing )
+        {
+        displacement.Bin = k;
+        break;
+        }
       }
+
+    this->m_Displacements.push_back( displacement );
     }
 
-  std::vector<RealType> distances;
-  std::vector<RealType> distancesFrequency;
-  std::vector<RealType> averageAbsoluteIntensityDifference;
+  /**
+   * Away from the boundary, the mask is read through the input offsets
+   * if both images have the same buffer.
+   */
+  this->m_UseMaskBuffer = ( !this->m_MaskImage ||
+    this->m_MaskImage->GetBufferedRegion() == input->GetBufferedRegion() );
+}
+
+template<class TInputImage, class TOutputImage>
+void
+ScalarToFractalImageFilter<TInputImage, TOutputImage>
+::ComputeColumn( const DisplacementType &displacement, const IndexType &index,
+  bool isInterior, RealType &sum, RealType &count ) const
+{
+  const InputImageType *input = this->GetInput();
+
+  sum = 0.0;
+  count = 0.0;
 
-  for( fit = faceList.begin(); fit != faceList.end(); ++fit )
+  if( isInterior )
     {
-    ConstNeighborhoodIteratorType It(
-      this->m_NeighborhoodRadius, this->GetInput(), *fit );
-    NeighborhoodIterator<OutputImageType> ItO(
-      this->m_NeighborhoodRadius, this->GetOutput(), *fit );
+    const typename InputImageType::PixelType *buffer
+      = input->GetBufferPointer();
+    const typename MaskImageType::PixelType *maskBuffer = NULL;
+    if( this->m_MaskImage )
+      {
+      maskBuffer = this->m_MaskImage->GetBufferPointer();
+      }
 
-    for( It.GoToBegin(), ItO.GoToBegin(); !It.IsAtEnd(); ++It, ++ItO )
+    const OffsetValueType offset = input->ComputeOffset( index );
+    for( unsigned int k = 0; k < displacement.ColumnBufferOffsets.size(); k++ )
       {
-      if( this->m_MaskImage &&
-        !this->m_MaskImage->GetPixel( It.GetIndex() ) )
+      const OffsetValueType offset1 = offset + displacement.ColumnBufferOffsets[k];
+      const OffsetValueType offset2 = offset1 + displacement.BufferOffset;
+      if( maskBuffer && ( !maskBuffer[offset1] || !maskBuffer[offset2] ) )
         {
-        ItO.SetCenterPixel(
-          NumericTraits<typename OutputImageType::PixelType>::Zero );
-        progress.CompletedPixel();
         continue;
         }
-      
-      distances.clear();
-      distancesFrequency.clear();
-      averageAbsoluteIntensityDifference.clear();
+      sum += vnl_math_abs( static_cast<RealType>( buffer[offset1] )
+        - static_cast<RealType>( buffer[offset2] ) );
+      count++;
+      }
+    }
+  else
+    {
+    const typename InputImageType::RegionType &region
+      = input->GetBufferedRegion();
 
-      for( unsigned int i = 0; i < It.GetNeighborhood().Size(); i++ )
+    for( unsigned int k = 0; k < displacement.ColumnOffsets.size(); k++ )
+      {
+      const IndexType index1 = index + displacement.ColumnOffsets[k];
+      const IndexType index2 = index1 + displacement.Offset;
+      if( !region.IsInside( index1 ) || !region.IsInside( index2 ) )
         {
-        bool IsInBounds1;
-        typename InputImageType::PixelType pixel1
-          = It.GetPixel( i, IsInBounds1 );
+        continue;
+        }
+      if( this->m_MaskImage && ( !this->m_MaskImage->GetPixel( index1 ) ||
+        !this->m_MaskImage->GetPixel( index2 ) ) )
+        {
+        continue;
+        }
+      sum += vnl_math_abs( static_cast<RealType>( input->GetPixel( index1 ) )
+        - static_cast<RealType>( input->GetPixel( index2 ) ) );
+      count++;
+      }
+    }
+}
 
-        if( IsInBounds1 && ( !this->m_MaskImage || ( this->m_MaskImage &&
-          this->m_MaskImage->GetPixel( It.GetIndex( i ) ) ) ) )
+template<class TInputImage, class TOutputImage>
+void
+ScalarToFractalImageFilter<TInputImage, TOutputImage>
+::ThreadedGenerateData( const OutputImageRegionType& outputRegionForThread,
+  int threadId )
+{
+  ProgressReporter progress( this, threadId,
+    outputRegionForThread.GetNumberOfPixels(), 100 );
+
+  const InputImageType *input = this->GetInput();
+  const typename InputImageType::RegionType &bufferedRegion
+    = input->GetBufferedRegion();
+
+  const unsigned int numberOfDisplacements = this->m_Displacements.size();
+  const unsigned int numberOfBins = this->m_BinLogDistances.size();
+
+  /**
+   * Running sums of each displacement over the current neighborhood and
+   * ring buffers with the sums of the columns of the neighborhood, so that
+   * the leaving column is not recomputed.
+   */
+  const long ringSize = 2 * static_cast<long>( this->m_NeighborhoodRadius[0] ) + 1;
+
+  std::vector<double> sums( numberOfDisplacements );
+  std::vector<double> counts( numberOfDisplacements );
+  std::vector<RealType> columnSums( numberOfDisplacements * ringSize );
+  std::vector<RealType> columnCounts( numberOfDisplacements * ringSize );
+  std::vector<double> binSums( numberOfBins );
+  std::vector<double> binCounts( numberOfBins );
+
+  ImageLinearIteratorWithIndex<OutputImageType> ItO(
+    this->GetOutput(), outputRegionForThread );
+  ItO.SetDirection( 0 );
+
+  ItO.GoToBegin();
+  while( !ItO.IsAtEnd() )
+    {
+    IndexType index = ItO.GetIndex();
+
+    const long firstX = index[0];
+    const long lastX = firstX + outputRegionForThread.GetSize()[0] - 1;
+
+    /**
+     * The bounds and mask buffer checks are skipped if all the
+     * neighborhoods of the line are in the buffer.
+     */
+    bool isInterior = this->m_UseMaskBuffer;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      long radius = static_cast<long>( this->m_NeighborhoodRadius[d] );
+      long lower = ( d == 0 ? firstX : index[d] ) - radius;
+      long upper = ( d == 0 ? lastX : index[d] ) + radius;
+      if( lower < bufferedRegion.GetIndex()[d] || upper >
+        bufferedRegion.GetIndex()[d] + static_cast<long>( bufferedRegion.GetSize()[d] ) - 1 )
+        {
+        isInterior = false;
+        }
+      }
+
+    for( unsigned int n = 0; n < numberOfDisplacements; n++ )
+      {
+      const DisplacementType &displacement = this->m_Displacements[n];
+
+      sums[n] = 0.0;
+      counts[n] = 0.0;
+      for( long x = firstX + displacement.FirstColumn;
+        x <= firstX + displacement.LastColumn; x++ )
+        {
+        IndexType columnIndex = index;
+        columnIndex[0] = x;
+
+        const long slot = n * ringSize + ( ( x % ringSize ) + ringSize ) % ringSize;
+        this->ComputeColumn( displacement, columnIndex, isInterior,
+          columnSums[slot], columnCounts[slot] );
+        sums[n] += columnSums[slot];
+        counts[n] += columnCounts[slot];
+        }
+      }
+
+    while( !ItO.IsAtEndOfLine() )
+      {
+      index = ItO.GetIndex();
+
+      if( this->m_MaskImage && !this->m_MaskImage->GetPixel( index ) )
+        {
+        ItO.Set( NumericTraits<typename OutputImageType::PixelType>::Zero );
+        }
+      else
+        {
+        std::fill( binSums.begin(), binSums.end(), 0.0 );
+        std::fill( binCounts.begin(), binCounts.end(), 0.0 );
+        for( unsigned int n = 0; n < numberOfDisplacements; n++ )
           {
-          typename InputImageType::PointType point1;
-          this->GetInput()->TransformIndexToPhysicalPoint(
-            It.GetIndex( i ), point1 );
+          binSums[this->m_Displacements[n].Bin] += sums[n];
+          binCounts[this->m_Displacements[n].Bin] += counts[n];
+          }
+
+        RealType sumY = 0.0;
+        RealType sumX = 0.0;
+        RealType sumXY = 0.0;
+        RealType sumXX = 0.0;
+        RealType N = 0.0;
 
-          for( unsigned int j = 0; j < It.GetNeighborhood().Size(); j++ )
+        for( unsigned int k = 0; k < numberOfBins; k++ )
+          {
+          if( binCounts[k] < 0.5 )
             {
-            if( i != j )
-              {
-              bool IsInBounds2;
-              typename InputImageType::PixelType pixel2
-                = It.GetPixel( j, IsInBounds2 );
-
-              if( IsInBounds2 && ( !this->m_MaskImage || ( this->m_MaskImage &&
-                this->m_MaskImage->GetPixel( It.GetIndex( j ) ) ) ) )
-                {
-                typename InputImageType::PointType point2;
-                this->GetInput()->TransformIndexToPhysicalPoint(
-                  It.GetIndex( j ), point2 );
-
-                RealType distance
-                  = point1.SquaredEuclideanDistanceTo( point2 );
-
-                bool distanceFound = false;
-                for( unsigned int k = 0; k < distances.size(); k++ )
-                  {
-                  if( vnl_math_abs( distances[k] - distance )
-                    < 0.5 * minSpacing )
-                    {
-                    distancesFrequency[k]++;
-                    averageAbsoluteIntensityDifference[k]
-                      += vnl_math_abs( pixel1 - pixel2 );
-                    distanceFound = true;
-                    break;
-                    }
-                  }
-                if( !distanceFound )
-                  {
-                  distances.push_back( distance );
-                  distancesFrequency.push_back( 1 );
-                  averageAbsoluteIntensityDifference.push_back(
-                    vnl_math_abs( pixel1 - pixel2 ) );
-                  }
-                }
-              }
+            continue;
             }
+
+          // The running sums can drift slightly below zero
+          RealType averageAbsoluteIntensityDifference = vcl_log(
+            vnl_math_max( 0.0, binSums[k] ) / binCounts[k] );
+          RealType distance = this->m_BinLogDistances[k];
+
+          sumY += averageAbsoluteIntensityDifference;
+          sumX += distance;
+          sumXX += ( distance * distance );
+          sumXY += ( averageAbsoluteIntensityDifference * distance );
+          N++;
           }
+
+        RealType slope = ( N * sumXY - sumX * sumY )
+          / ( N * sumXX - sumX * sumX );
+
+        ItO.Set( static_cast<typename OutputImageType::PixelType>( 3.0 - slope ) );
         }
-      RealType sumY = 0.0;
-      RealType sumX = 0.0;
-      RealType sumXY = 0.0;
-      RealType sumXX = 0.0;
+      progress.CompletedPixel();
 
-      for( unsigned int k = 0; k < distances.size(); k++ )
+      ++ItO;
+      if( ItO.IsAtEndOfLine() )
         {
-        if( distancesFrequency[k] == 0 )
-          {
-          continue;
-          }
+        break;
+        }
 
-        averageAbsoluteIntensityDifference[k]
-          /= static_cast<RealType>( distancesFrequency[k] );
-        averageAbsoluteIntensityDifference[k]
-          = vcl_log( averageAbsoluteIntensityDifference[k] );
+      /**
+       * Slide the neighborhood by one voxel:  one column of pairs leaves
+       * and one enters for each displacement.
+       */
+      for( unsigned int n = 0; n < numberOfDisplacements; n++ )
+        {
+        const DisplacementType &displacement = this->m_Displacements[n];
 
-        RealType distance = vcl_log( vcl_sqrt( distances[k] ) );
+        const long leavingX = index[0] + displacement.FirstColumn;
+        const long enteringX = index[0] + 1 + displacement.LastColumn;
 
-        sumY += averageAbsoluteIntensityDifference[k];
-        sumX += distance;
-        sumXX += ( distance * distance );
-        sumXY += ( averageAbsoluteIntensityDifference[k] * distance );
-        }
-      RealType N = static_cast<RealType>( distances.size() );
+        long slot = n * ringSize + ( ( leavingX % ringSize ) + ringSize ) % ringSize;
+        sums[n] -= columnSums[slot];
+        counts[n] -= columnCounts[slot];
 
-      RealType slope = ( N * sumXY - sumX * sumY )
-        / ( N * sumXX - sumX * sumX );
+        IndexType columnIndex = index;
+        columnIndex[0] = enteringX;
 
-      ItO.SetCenterPixel(
-        static_cast<typename OutputImageType::PixelType>( 3.0 - slope ) );
-      progress.CompletedPixel();
+        slot = n * ringSize + ( ( enteringX % ringSize ) + ringSize ) % ringSize;
+        this->ComputeColumn( displacement, columnIndex, isInterior,
+          columnSums[slot], columnCounts[slot] );
+        sums[n] += columnSums[slot];
+        counts[n] += columnCounts[slot];
+        }
       }
+    ItO.NextLine();
     }
 }
 
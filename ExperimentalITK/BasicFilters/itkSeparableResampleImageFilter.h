@@ -0,0 +1,213 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkSeparableResampleImageFilter.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkSeparableResampleImageFilter_h
+#define __itkSeparableResampleImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkFixedArray.h"
+#include "itkMultiThreader.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class SeparableResampleImageFilter
+ * \brief Resample an image on an axis-aligned grid with a separable kernel.
+ *
+ * This filter produces the same result as ResampleImageFilter with an
+ * IdentityTransform when the output grid has the same direction as the
+ * input (only the origin, spacing and size change) and the interpolator is
+ * one of the linear, nearest neighbor, Gaussian, windowed sinc or B-spline
+ * interpolators.  All these kernels are separable, so instead of
+ * evaluating the N-D kernel at every output voxel, the 1-D weights of each
+ * output coordinate are tabulated once per axis and the image is resampled
+ * with one pass per axis.  Each pass is multithreaded over the image lines.
+ *
+ * The boundary handling follows the corresponding ITK interpolators:
+ * output voxels mapped outside of the input buffer are set to
+ * DefaultPixelValue, the linear and windowed sinc kernels replicate the
+ * border voxels, the Gaussian kernel is truncated at the border and
+ * renormalized and the B-spline kernel uses mirror boundary conditions on
+ * the B-spline coefficients.
+ *
+ * \sa ResampleImageFilter
+ */
+template <class TInputImage, class TOutputImage = TInputImage>
+class ITK_EXPORT SeparableResampleImageFilter :
+    public ImageToImageFilter<TInputImage, TOutputImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef SeparableResampleImageFilter         Self;
+  typedef ImageToImageFilter<
+                       TInputImage,
+                       TOutputImage>           Superclass;
+  typedef SmartPointer<Self>                   Pointer;
+  typedef SmartPointer<const Self>             ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( SeparableResampleImageFilter, ImageToImageFilter );
+
+  /** Extract dimension from input and output image. */
+  itkStaticConstMacro( ImageDimension, unsigned int,
+                       TInputImage::ImageDimension );
+
+  /** Convenient typedefs for simplifying declarations. */
+  typedef TInputImage                           InputImageType;
+  typedef TOutputImage                          OutputImageType;
+
+  typedef typename InputImageType::PixelType    InputPixelType;
+  typedef typename OutputImageType::PixelType   OutputPixelType;
+
+  typedef typename OutputImageType::SizeType       SizeType;
+  typedef typename OutputImageType::SpacingType    SpacingType;
+  typedef typename OutputImageType::PointType      PointType;
+  typedef typename OutputImageType::DirectionType  DirectionType;
+  typedef typename OutputImageType::RegionType     OutputImageRegionType;
+
+  typedef double                                RealType;
+  typedef Image<RealType, ImageDimension>       RealImageType;
+  typedef FixedArray<RealType, ImageDimension>  ArrayType;
+
+  /** Kernel used for the resampling */
+  enum KernelType { Linear, NearestNeighbor, Gaussian, WindowedSinc, BSpline };
+
+  /** Window of the windowed sinc kernel */
+  enum WindowType { Hamming, Cosine, Welch, Lanczos, Blackman };
+
+  /** Set/Get the size of the output image. */
+  itkSetMacro( Size, SizeType );
+  itkGetConstReferenceMacro( Size, SizeType );
+
+  /** Set/Get the output image spacing. */
+  itkSetMacro( OutputSpacing, SpacingType );
+  itkGetConstReferenceMacro( OutputSpacing, SpacingType );
+
+  /** Set/Get the output image origin. */
+  itkSetMacro( OutputOrigin, PointType );
+  itkGetConstReferenceMacro( OutputOrigin, PointType );
+
+  /** Set/Get the output direction cosine matrix.  It must be the one of the
+   *  input image. */
+  itkSetMacro( OutputDirection, DirectionType );
+  itkGetConstReferenceMacro( OutputDirection, DirectionType );
+
+  /** Set/Get the pixel value when a transformed pixel is outside of the
+   *  image. The default value is 0. */
+  itkSetMacro( DefaultPixelValue, OutputPixelType );
+  itkGetConstReferenceMacro( DefaultPixelValue, OutputPixelType );
+
+  /** Set/Get the resampling kernel.  Default is linear. */
+  itkSetMacro( Kernel, KernelType );
+  itkGetConstMacro( Kernel, KernelType );
+
+  /** Set/Get the window of the windowed sinc kernel.  Default is Hamming. */
+  itkSetMacro( Window, WindowType );
+  itkGetConstMacro( Window, WindowType );
+
+  /** Set/Get the radius of the windowed sinc kernel.  Default is 3. */
+  itkSetClampMacro( WindowRadius, unsigned int, 1, 100 );
+  itkGetConstMacro( WindowRadius, unsigned int );
+
+  /** Set/Get the standard deviation (in physical units) of the Gaussian
+   *  kernel and the cutoff (in multiples of sigma).  See
+   *  GaussianInterpolateImageFunction.  A non-positive sigma selects the
+   *  input spacing (default). */
+  itkSetMacro( Sigma, ArrayType );
+  itkGetConstReferenceMacro( Sigma, ArrayType );
+  itkSetMacro( Alpha, RealType );
+  itkGetConstMacro( Alpha, RealType );
+
+  /** Set/Get the order of the B-spline kernel.  Default is 3. */
+  itkSetClampMacro( SplineOrder, unsigned int, 0, 5 );
+  itkGetConstMacro( SplineOrder, unsigned int );
+
+protected:
+
+  SeparableResampleImageFilter();
+  virtual ~SeparableResampleImageFilter() {}
+
+  void PrintSelf( std::ostream& os, Indent indent ) const;
+
+  void GenerateOutputInformation();
+  void GenerateInputRequestedRegion();
+  void EnlargeOutputRequestedRegion( DataObject *output );
+
+  void GenerateData();
+
+private:
+  SeparableResampleImageFilter( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  /** 1-D weights of every output coordinate along one axis.  The taps of
+   *  the output coordinate j are Indices[j*NumberOfTaps+k] with weights
+   *  Weights[j*NumberOfTaps+k]. */
+  struct WeightTableType
+    {
+    unsigned int            NumberOfTaps;
+    std::vector<long>       Indices;
+    std::vector<RealType>   Weights;
+    std::vector<bool>       IsInside;
+    };
+
+  /** Multi-threading support. */
+  struct ThreadStruct
+    {
+    Self *Filter;
+    };
+
+  static ITK_THREAD_RETURN_TYPE ResampleAxisThreaderCallback( void * );
+
+  void ComputeWeightTable( unsigned int, WeightTableType & );
+
+  /** Resample the lines [first, last) of the current pass */
+  void ResampleLines( unsigned long, unsigned long );
+
+  RealType EvaluateWindowedSinc( RealType ) const;
+  RealType EvaluateBSpline( unsigned int, RealType ) const;
+
+  SizeType                    m_Size;
+  SpacingType                 m_OutputSpacing;
+  PointType                   m_OutputOrigin;
+  DirectionType               m_OutputDirection;
+  OutputPixelType             m_DefaultPixelValue;
+
+  KernelType                  m_Kernel;
+  WindowType                  m_Window;
+  unsigned int                m_WindowRadius;
+  ArrayType                   m_Sigma;
+  RealType                    m_Alpha;
+  unsigned int                m_SplineOrder;
+
+  /** State of the current pass */
+  std::vector<WeightTableType>      m_WeightTables;
+  unsigned int                      m_CurrentAxis;
+  typename RealImageType::Pointer   m_CurrentInput;
+  typename RealImageType::Pointer   m_CurrentOutput;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSeparableResampleImageFilter.hxx"
+#endif
+
+#endif
@@ -0,0 +1,525 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkSeparableResampleImageFilter.hxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkSeparableResampleImageFilter_hxx
+#define __itkSeparableResampleImageFilter_hxx
+
+#include "itkSeparableResampleImageFilter.h"
+
+#include "itkBSplineDecompositionImageFilter.h"
+#include "itkCastImageFilter.h"
+#include "itkContinuousIndex.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+#include "vnl/vnl_erf.h"
+#include "vnl/vnl_math.h"
+
+namespace itk
+{
+
+template <class TInputImage, class TOutputImage>
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::SeparableResampleImageFilter()
+{
+  this->m_Size.Fill( 0 );
+  this->m_OutputSpacing.Fill( 1.0 );
+  this->m_OutputOrigin.Fill( 0.0 );
+  this->m_OutputDirection.SetIdentity();
+  this->m_DefaultPixelValue = NumericTraits<OutputPixelType>::Zero;
+
+  this->m_Kernel = Linear;
+  this->m_Window = Hamming;
+  this->m_WindowRadius = 3;
+  this->m_Sigma.Fill( 0.0 );
+  this->m_Alpha = 1.0;
+  this->m_SplineOrder = 3;
+
+  this->m_CurrentAxis = 0;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::GenerateOutputInformation()
+{
+  Superclass::GenerateOutputInformation();
+
+  OutputImageType *output = this->GetOutput();
+  if( !output )
+    {
+    return;
+    }
+
+  OutputImageRegionType region;
+  region.SetSize( this->m_Size );
+
+  output->SetLargestPossibleRegion( region );
+  output->SetSpacing( this->m_OutputSpacing );
+  output->SetOrigin( this->m_OutputOrigin );
+  output->SetDirection( this->m_OutputDirection );
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+
+  if( this->GetInput() )
+    {
+    InputImageType *input = const_cast<InputImageType *>( this->GetInput() );
+    input->SetRequestedRegionToLargestPossibleRegion();
+    }
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::EnlargeOutputRequestedRegion( DataObject *output )
+{
+  Superclass::EnlargeOutputRequestedRegion( output );
+  output->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template <class TInputImage, class TOutputImage>
+typename SeparableResampleImageFilter<TInputImage, TOutputImage>::RealType
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::EvaluateWindowedSinc( RealType x ) const
+{
+  if( vnl_math_abs( x ) < 1e-12 )
+    {
+    return 1.0;
+    }
+
+  const RealType m = static_cast<RealType>( this->m_WindowRadius );
+  const RealType px = vnl_math::pi * x;
+
+  RealType window = 1.0;
+  switch( this->m_Window )
+    {
+    case Hamming: default:
+      window = 0.54 + 0.46 * vcl_cos( px / m );
+      break;
+    case Cosine:
+      window = vcl_cos( 0.5 * px / m );
+      break;
+    case Welch:
+      window = 1.0 - vnl_math_sqr( x / m );
+      break;
+    case Lanczos:
+      window = vcl_sin( px / m ) / ( px / m );
+      break;
+    case Blackman:
+      window = 0.42 + 0.5 * vcl_cos( px / m ) + 0.08 * vcl_cos( 2.0 * px / m );
+      break;
+    }
+  return window * vcl_sin( px ) / px;
+}
+
+template <class TInputImage, class TOutputImage>
+typename SeparableResampleImageFilter<TInputImage, TOutputImage>::RealType
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::EvaluateBSpline( unsigned int order, RealType x ) const
+{
+  // Centered B-spline of the given order (Cox-de Boor recursion)
+  if( order == 0 )
+    {
+    return ( x >= -0.5 && x < 0.5 ) ? 1.0 : 0.0;
+    }
+  const RealType half = 0.5 * static_cast<RealType>( order + 1 );
+  return ( ( x + half ) * this->EvaluateBSpline( order - 1, x + 0.5 ) +
+    ( half - x ) * this->EvaluateBSpline( order - 1, x - 0.5 ) ) /
+    static_cast<RealType>( order );
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::ComputeWeightTable( unsigned int d, WeightTableType & table )
+{
+  const InputImageType *input = this->GetInput();
+
+  const long N = static_cast<long>( input->GetLargestPossibleRegion().GetSize()[d] );
+  const RealType inputSpacing = input->GetSpacing()[d];
+
+  // Continuous index (relative to the start of the input region) of the
+  // first output voxel and increment between two output voxels.  The output
+  // and input directions are the same so the axes are independent.
+  ContinuousIndex<RealType, ImageDimension> originIndex;
+  input->TransformPhysicalPointToContinuousIndex( this->m_OutputOrigin, originIndex );
+
+  const RealType c0 = originIndex[d] -
+    static_cast<RealType>( input->GetLargestPossibleRegion().GetIndex()[d] );
+  const RealType step = this->m_OutputSpacing[d] / inputSpacing;
+
+  // Gaussian kernel parameters (see GaussianInterpolateImageFunction)
+  RealType sigma = this->m_Sigma[d];
+  if( sigma <= 0.0 )
+    {
+    sigma = inputSpacing;
+    }
+  const RealType cutoff = sigma * this->m_Alpha / inputSpacing;
+  const RealType scaling = 1.0 / ( vnl_math::sqrt2 * sigma / inputSpacing );
+
+  switch( this->m_Kernel )
+    {
+    case Linear: default:
+      table.NumberOfTaps = 2;
+      break;
+    case NearestNeighbor:
+      table.NumberOfTaps = 1;
+      break;
+    case Gaussian:
+      table.NumberOfTaps = static_cast<unsigned int>( vcl_ceil( 2.0 * cutoff ) ) + 2;
+      break;
+    case WindowedSinc:
+      table.NumberOfTaps = 2 * this->m_WindowRadius;
+      break;
+    case BSpline:
+      table.NumberOfTaps = this->m_SplineOrder + 1;
+      break;
+    }
+
+  const unsigned long numberOfOutputVoxels = this->m_Size[d];
+  const unsigned int T = table.NumberOfTaps;
+
+  table.Indices.assign( numberOfOutputVoxels * T, 0 );
+  table.Weights.assign( numberOfOutputVoxels * T, 0.0 );
+  table.IsInside.assign( numberOfOutputVoxels, false );
+
+  for( unsigned long j = 0; j < numberOfOutputVoxels; j++ )
+    {
+    const RealType c = c0 + static_cast<RealType>( j ) * step;
+
+    // Same test as ImageFunction::IsInsideBuffer()
+    if( c < -0.5 || c >= static_cast<RealType>( N ) - 0.5 )
+      {
+      continue;
+      }
+    table.IsInside[j] = true;
+
+    long *indices = &table.Indices[j * T];
+    RealType *weights = &table.Weights[j * T];
+
+    switch( this->m_Kernel )
+      {
+      case Linear: default:
+        {
+        const long base = static_cast<long>( vcl_floor( c ) );
+        const RealType distance = c - static_cast<RealType>( base );
+        indices[0] = vnl_math_max( 0L, vnl_math_min( N - 1, base ) );
+        indices[1] = vnl_math_max( 0L, vnl_math_min( N - 1, base + 1 ) );
+        weights[0] = 1.0 - distance;
+        weights[1] = distance;
+        break;
+        }
+      case NearestNeighbor:
+        {
+        indices[0] = vnl_math_max( 0L, vnl_math_min( N - 1,
+          static_cast<long>( vcl_floor( c + 0.5 ) ) ) );
+        weights[0] = 1.0;
+        break;
+        }
+      case Gaussian:
+        {
+        // Integral of the Gaussian over each voxel, truncated to the
+        // cutoff and the image, then normalized.
+        const long begin = vnl_math_max( 0L,
+          static_cast<long>( vcl_floor( c + 0.5 - cutoff ) ) );
+        const long end = vnl_math_min( N,
+          static_cast<long>( vcl_ceil( c + 0.5 + cutoff ) ) );
+
+        RealType sumOfWeights = 0.0;
+        RealType erfLast = vnl_erf( ( static_cast<RealType>( begin ) - 0.5 - c ) * scaling );
+        for( long i = begin; i < end && static_cast<unsigned int>( i - begin ) < T; i++ )
+          {
+          const RealType erfNow = vnl_erf( ( static_cast<RealType>( i ) + 0.5 - c ) * scaling );
+          indices[i - begin] = i;
+          weights[i - begin] = erfNow - erfLast;
+          sumOfWeights += erfNow - erfLast;
+          erfLast = erfNow;
+          }
+        if( sumOfWeights > 0.0 )
+          {
+          for( unsigned int k = 0; k < T; k++ )
+            {
+            weights[k] /= sumOfWeights;
+            }
+          }
+        break;
+        }
+      case WindowedSinc:
+        {
+        // Zero flux Neumann boundary condition
+        const long base = static_cast<long>( vcl_floor( c ) );
+        const long m = static_cast<long>( this->m_WindowRadius );
+        for( unsigned int k = 0; k < T; k++ )
+          {
+          const long tap = base - m + 1 + static_cast<long>( k );
+          indices[k] = vnl_math_max( 0L, vnl_math_min( N - 1, tap ) );
+          weights[k] = this->EvaluateWindowedSinc( c - static_cast<RealType>( tap ) );
+          }
+        break;
+        }
+      case BSpline:
+        {
+        // Same support and mirror boundary conditions as
+        // BSplineInterpolateImageFunction
+        const RealType halfOffset = ( this->m_SplineOrder & 1 ) ? 0.0 : 0.5;
+        const long base = static_cast<long>( vcl_floor( c + halfOffset ) ) -
+          static_cast<long>( this->m_SplineOrder / 2 );
+        const long dataLength2 = 2 * N - 2;
+        for( unsigned int k = 0; k < T; k++ )
+          {
+          const long tap = base + static_cast<long>( k );
+          long index = 0;
+          if( N > 1 )
+            {
+            index = ( tap < 0 ) ? ( -tap - dataLength2 * ( ( -tap ) / dataLength2 ) )
+              : ( tap - dataLength2 * ( tap / dataLength2 ) );
+            if( N <= index )
+              {
+              index = dataLength2 - index;
+              }
+            }
+          indices[k] = index;
+          weights[k] = this->EvaluateBSpline( this->m_SplineOrder,
+            c - static_cast<RealType>( tap ) );
+          }
+        break;
+        }
+      }
+    }
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::ResampleLines( unsigned long first, unsigned long last )
+{
+  const unsigned int d = this->m_CurrentAxis;
+  const WeightTableType & table = this->m_WeightTables[d];
+  const unsigned int T = table.NumberOfTaps;
+
+  const typename RealImageType::SizeType inputSize =
+    this->m_CurrentInput->GetBufferedRegion().GetSize();
+  const typename RealImageType::SizeType outputSize =
+    this->m_CurrentOutput->GetBufferedRegion().GetSize();
+
+  const RealType *inputBuffer = this->m_CurrentInput->GetBufferPointer();
+  RealType *outputBuffer = this->m_CurrentOutput->GetBufferPointer();
+
+  // The sizes only differ along the current axis
+  unsigned long inputStrides[ImageDimension];
+  unsigned long outputStrides[ImageDimension];
+  inputStrides[0] = 1;
+  outputStrides[0] = 1;
+  for( unsigned int e = 1; e < ImageDimension; e++ )
+    {
+    inputStrides[e] = inputStrides[e - 1] * inputSize[e - 1];
+    outputStrides[e] = outputStrides[e - 1] * outputSize[e - 1];
+    }
+  const unsigned long stride = inputStrides[d];
+
+  for( unsigned long line = first; line < last; line++ )
+    {
+    unsigned long inputOffset = 0;
+    unsigned long outputOffset = 0;
+    unsigned long remainder = line;
+    for( unsigned int e = 0; e < ImageDimension; e++ )
+      {
+      if( e == d )
+        {
+        continue;
+        }
+      const unsigned long index = remainder % outputSize[e];
+      remainder /= outputSize[e];
+      inputOffset += index * inputStrides[e];
+      outputOffset += index * outputStrides[e];
+      }
+
+    const RealType *in = inputBuffer + inputOffset;
+    RealType *out = outputBuffer + outputOffset;
+
+    const long *indices = &table.Indices[0];
+    const RealType *weights = &table.Weights[0];
+    for( unsigned long j = 0; j < outputSize[d]; j++ )
+      {
+      RealType value = 0.0;
+      for( unsigned int k = 0; k < T; k++ )
+        {
+        value += weights[k] * in[indices[k] * stride];
+        }
+      out[j * stride] = value;
+      indices += T;
+      weights += T;
+      }
+    }
+}
+
+template <class TInputImage, class TOutputImage>
+ITK_THREAD_RETURN_TYPE
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::ResampleAxisThreaderCallback( void *arg )
+{
+  unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct *str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  // Split the lines along the current axis between the threads
+  const typename RealImageType::SizeType size =
+    str->Filter->m_CurrentOutput->GetBufferedRegion().GetSize();
+  unsigned long numberOfLines = 1;
+  for( unsigned int e = 0; e < ImageDimension; e++ )
+    {
+    if( e != str->Filter->m_CurrentAxis )
+      {
+      numberOfLines *= size[e];
+      }
+    }
+
+  const unsigned long first = ( numberOfLines * threadId ) / threadCount;
+  const unsigned long last = ( numberOfLines * ( threadId + 1 ) ) / threadCount;
+
+  str->Filter->ResampleLines( first, last );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::GenerateData()
+{
+  const InputImageType *input = this->GetInput();
+
+  if( input->GetDirection() != this->m_OutputDirection )
+    {
+    itkExceptionMacro( "The output direction must be the same as the input direction." );
+    }
+
+  this->AllocateOutputs();
+
+  // Resampled image: either the input or its B-spline coefficients
+  if( this->m_Kernel == BSpline )
+    {
+    typedef BSplineDecompositionImageFilter<InputImageType, RealImageType> DecompositionType;
+    typename DecompositionType::Pointer decomposition = DecompositionType::New();
+    decomposition->SetInput( input );
+    decomposition->SetSplineOrder( this->m_SplineOrder );
+    decomposition->Update();
+    this->m_CurrentInput = decomposition->GetOutput();
+    }
+  else
+    {
+    typedef CastImageFilter<InputImageType, RealImageType> CasterType;
+    typename CasterType::Pointer caster = CasterType::New();
+    caster->SetInput( input );
+    caster->Update();
+    this->m_CurrentInput = caster->GetOutput();
+    }
+  this->m_CurrentInput->DisconnectPipeline();
+
+  this->m_WeightTables.resize( ImageDimension );
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    this->ComputeWeightTable( d, this->m_WeightTables[d] );
+    }
+
+  ThreadStruct str;
+  str.Filter = this;
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( this->GetNumberOfThreads() );
+  threader->SetSingleMethod( this->ResampleAxisThreaderCallback, &str );
+
+  // One pass per axis: after the pass along axis d, the axes 0..d have the
+  // output size and the remaining ones the input size.
+  typename RealImageType::SizeType size =
+    this->m_CurrentInput->GetBufferedRegion().GetSize();
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    size[d] = this->m_Size[d];
+
+    this->m_CurrentOutput = RealImageType::New();
+    this->m_CurrentOutput->SetRegions( size );
+    this->m_CurrentOutput->Allocate();
+
+    this->m_CurrentAxis = d;
+    threader->SingleMethodExecute();
+
+    this->m_CurrentInput = this->m_CurrentOutput;
+    }
+
+  // Cast with bounds checking as in ResampleImageFilter
+  const RealType minimum = static_cast<RealType>( NumericTraits<OutputPixelType>::NonpositiveMin() );
+  const RealType maximum = static_cast<RealType>( NumericTraits<OutputPixelType>::max() );
+
+  ImageRegionConstIterator<RealImageType> ItR( this->m_CurrentOutput,
+    this->m_CurrentOutput->GetBufferedRegion() );
+  ImageRegionIteratorWithIndex<OutputImageType> ItO( this->GetOutput(),
+    this->GetOutput()->GetRequestedRegion() );
+  for( ItR.GoToBegin(), ItO.GoToBegin(); !ItO.IsAtEnd(); ++ItR, ++ItO )
+    {
+    bool isInside = true;
+    for( unsigned int d = 0; d < ImageDimension && isInside; d++ )
+      {
+      isInside = this->m_WeightTables[d].IsInside[ItO.GetIndex()[d]];
+      }
+    if( !isInside )
+      {
+      ItO.Set( this->m_DefaultPixelValue );
+      }
+    else
+      {
+      ItO.Set( static_cast<OutputPixelType>(
+        vnl_math_max( minimum, vnl_math_min( maximum, ItR.Get() ) ) ) );
+      }
+    }
+
+  this->m_CurrentInput = NULL;
+  this->m_CurrentOutput = NULL;
+  this->m_WeightTables.clear();
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SeparableResampleImageFilter<TInputImage, TOutputImage>
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Size: " << this->m_Size << std::endl;
+  os << indent << "Output spacing: " << this->m_OutputSpacing << std::endl;
+  os << indent << "Output origin: " << this->m_OutputOrigin << std::endl;
+  os << indent << "Output direction: " << this->m_OutputDirection << std::endl;
+  os << indent << "Default pixel value: "
+     << static_cast<typename NumericTraits<OutputPixelType>::PrintType>(
+       this->m_DefaultPixelValue ) << std::endl;
+  os << indent << "Kernel: " << this->m_Kernel << std::endl;
+  os << indent << "Window: " << this->m_Window << std::endl;
+  os << indent << "Window radius: " << this->m_WindowRadius << std::endl;
+  os << indent << "Sigma: " << this->m_Sigma << std::endl;
+  os << indent << "Alpha: " << this->m_Alpha << std::endl;
+  os << indent << "Spline order: " << this->m_SplineOrder << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,213 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkSliceStackContourExtractor.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkSliceStackContourExtractor_h
+#define __itkSliceStackContourExtractor_h
+
+#include "itkObject.h"
+
+#include "itkContinuousIndex.h"
+#include "itkMultiThreader.h"
+#include "itkNumericTraits.h"
+#include "itk_hash_map.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class SliceStackContourExtractor
+ * \brief Extracts the iso-contours of every slice of a 3-D image in one pass.
+ *
+ * Each slice perpendicular to \c SliceDimension is contoured with the
+ * marching squares of ContourExtractor2DImageFilter (same square cases, same
+ * handling of the ambiguous cases through VertexConnectHighPixels, same
+ * orientation of the contours) but without building a 2-D image and a set of
+ * PolyLineParametricPath outputs for every slice.
+ *
+ * The vertices of a slice are identified by the pixel edge they lie on (or
+ * by the pixel itself when it has exactly the contour value), so the
+ * segments are stitched by hashing integer keys into flat vertex and
+ * segment buffers instead of merging deques of floating point vertices.
+ * The slices are distributed over \c NumberOfThreads threads.
+ *
+ * The result is a single multi-slice polyline set: the vertices of all the
+ * contours, in physical coordinates, are concatenated slice by slice and
+ * contour n is made of the vertices GetContourOffsets()[n] to
+ * GetContourOffsets()[n+1] - 1.  Closed contours repeat their first vertex.
+ *
+ * Only the buffered region of the input is contoured.
+ */
+template <class TInputImage>
+class ITK_EXPORT SliceStackContourExtractor
+: public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef SliceStackContourExtractor  Self;
+  typedef Object                      Superclass;
+  typedef SmartPointer<Self>          Pointer;
+  typedef SmartPointer<const Self>    ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( SliceStackContourExtractor, Object );
+
+  /** Extract dimension from the input image. */
+  itkStaticConstMacro( ImageDimension, unsigned int,
+                       TInputImage::ImageDimension );
+
+  typedef TInputImage                                    InputImageType;
+  typedef typename InputImageType::PixelType             InputPixelType;
+  typedef typename NumericTraits<InputPixelType>::RealType
+                                                         InputRealType;
+  typedef typename InputImageType::PointType             PointType;
+  typedef typename InputImageType::RegionType            RegionType;
+  typedef ContinuousIndex<double,
+    itkGetStaticConstMacro( ImageDimension )>            ContinuousIndexType;
+
+  typedef std::vector<PointType>                         VertexContainerType;
+  typedef std::vector<unsigned long>                     OffsetContainerType;
+  typedef std::vector<long>                              SliceContainerType;
+
+  /** Set/Get the image to contour. */
+  itkSetConstObjectMacro( Input, InputImageType );
+  itkGetConstObjectMacro( Input, InputImageType );
+
+  /** Set/Get the value of the iso-contours.  Default is 0. */
+  itkSetMacro( ContourValue, InputRealType );
+  itkGetConstMacro( ContourValue, InputRealType );
+
+  /** See ContourExtractor2DImageFilter.  Default is off. */
+  itkSetMacro( VertexConnectHighPixels, bool );
+  itkGetConstMacro( VertexConnectHighPixels, bool );
+  itkBooleanMacro( VertexConnectHighPixels );
+
+  /** See ContourExtractor2DImageFilter.  Default is off. */
+  itkSetMacro( ReverseContourOrientation, bool );
+  itkGetConstMacro( ReverseContourOrientation, bool );
+  itkBooleanMacro( ReverseContourOrientation );
+
+  /** Set/Get the dimension perpendicular to the slices.  Default is the
+   * last dimension. */
+  itkSetMacro( SliceDimension, unsigned int );
+  itkGetConstMacro( SliceDimension, unsigned int );
+
+  /** Set/Get the number of threads the slices are distributed over. */
+  itkSetClampMacro( NumberOfThreads, unsigned int, 1, ITK_MAX_THREADS );
+  itkGetConstMacro( NumberOfThreads, unsigned int );
+
+  /** Contour every slice of the input. */
+  void Update();
+
+  /** Results of the last update. */
+  unsigned long GetNumberOfContours() const
+    {
+    return this->m_ContourSlices.size();
+    }
+  const VertexContainerType & GetVertices() const
+    {
+    return this->m_Vertices;
+    }
+  const OffsetContainerType & GetContourOffsets() const
+    {
+    return this->m_ContourOffsets;
+    }
+  /** Index (along SliceDimension) of the slice of each contour. */
+  const SliceContainerType & GetContourSlices() const
+    {
+    return this->m_ContourSlices;
+    }
+
+protected:
+  SliceStackContourExtractor();
+  virtual ~SliceStackContourExtractor() {}
+
+  void PrintSelf( std::ostream& os, Indent indent ) const;
+
+private:
+  SliceStackContourExtractor( const Self & ); // purposely not implemented
+  void operator=( const Self & );             // purposely not implemented
+
+  /** Contours of a single slice. */
+  struct SliceContoursType
+    {
+    VertexContainerType                 Vertices;
+    OffsetContainerType                 ContourLengths;
+    };
+
+  /** Working buffers of a thread, reused from one slice to the next.  The
+   * positions are the in-plane continuous indices of the vertices. */
+  struct SliceBuffersType
+    {
+    hash_map<unsigned long, unsigned long>  VertexIds;
+    std::vector<double>                     Positions;
+    std::vector<unsigned long>              SegmentFrom;
+    std::vector<unsigned long>              SegmentTo;
+    std::vector<unsigned long>              Outgoing;
+    std::vector<unsigned long>              Incoming;
+    std::vector<unsigned long>              Successors;
+    std::vector<unsigned long>              Predecessors;
+    std::vector<bool>                       Visited;
+    };
+
+  /** Multi-threading support. */
+  struct ThreadStruct
+    {
+    Self *Extractor;
+    };
+
+  static ITK_THREAD_RETURN_TYPE ExtractSlicesThreaderCallback( void * );
+
+  /** Run the marching squares over slice n and chain the segments. */
+  void ExtractSlice( unsigned long, SliceBuffersType &,
+    SliceContoursType & ) const;
+
+  /** Id of the vertex where the contour crosses the edge going from pixel
+   * (x, y) in the given in-plane direction. */
+  unsigned long AddVertex( SliceBuffersType &, InputPixelType, InputPixelType,
+    unsigned long, unsigned long, unsigned int ) const;
+
+  typename InputImageType::ConstPointer           m_Input;
+  InputRealType                                   m_ContourValue;
+  bool                                            m_VertexConnectHighPixels;
+  bool                                            m_ReverseContourOrientation;
+  unsigned int                                    m_SliceDimension;
+  unsigned int                                    m_NumberOfThreads;
+
+  /** Geometry of the current update: the two in-plane dimensions followed
+   * by the slice dimension, and the size, start index and buffer stride of
+   * the buffered region along each of them. */
+  unsigned int                                    m_Axes[3];
+  unsigned long                                   m_RegionSize[3];
+  long                                            m_RegionIndex[3];
+  long                                            m_Strides[3];
+  std::vector<SliceContoursType>                  m_SliceContours;
+
+  VertexContainerType                             m_Vertices;
+  OffsetContainerType                             m_ContourOffsets;
+  SliceContainerType                              m_ContourSlices;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSliceStackContourExtractor.hxx"
+#endif
+
+#endif
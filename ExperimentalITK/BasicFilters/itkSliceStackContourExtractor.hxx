@@ -0,0 +1,441 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkSliceStackContourExtractor.hxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkSliceStackContourExtractor_hxx
+#define __itkSliceStackContourExtractor_hxx
+
+#include "itkSliceStackContourExtractor.h"
+
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+template <class TInputImage>
+SliceStackContourExtractor<TInputImage>
+::SliceStackContourExtractor()
+{
+  this->m_Input = NULL;
+  this->m_ContourValue = NumericTraits<InputRealType>::Zero;
+  this->m_VertexConnectHighPixels = false;
+  this->m_ReverseContourOrientation = false;
+  this->m_SliceDimension = ImageDimension - 1;
+  this->m_NumberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
+}
+
+template <class TInputImage>
+void
+SliceStackContourExtractor<TInputImage>
+::Update()
+{
+  if( !this->m_Input )
+    {
+    itkExceptionMacro( "The input image is not set." );
+    }
+  if( ImageDimension != 3 )
+    {
+    itkExceptionMacro( "Only 3-D images are supported." );
+    }
+  if( this->m_SliceDimension >= ImageDimension )
+    {
+    itkExceptionMacro( "The slice dimension must be less than "
+      << ImageDimension << "." );
+    }
+
+  unsigned int a = 0;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    if( d != this->m_SliceDimension )
+      {
+      this->m_Axes[a++] = d;
+      }
+    }
+  this->m_Axes[2] = this->m_SliceDimension;
+
+  const RegionType region = this->m_Input->GetBufferedRegion();
+  const typename InputImageType::OffsetValueType *offsetTable =
+    this->m_Input->GetOffsetTable();
+  for( unsigned int i = 0; i < 3; i++ )
+    {
+    this->m_RegionSize[i] = region.GetSize()[this->m_Axes[i]];
+    this->m_RegionIndex[i] = region.GetIndex()[this->m_Axes[i]];
+    this->m_Strides[i] = static_cast<long>( offsetTable[this->m_Axes[i]] );
+    }
+
+  this->m_Vertices.clear();
+  this->m_ContourOffsets.assign( 1, 0 );
+  this->m_ContourSlices.clear();
+
+  const unsigned long numberOfSlices = this->m_RegionSize[2];
+  if( numberOfSlices == 0 || this->m_RegionSize[0] < 2
+    || this->m_RegionSize[1] < 2 )
+    {
+    return;
+    }
+
+  this->m_SliceContours.clear();
+  this->m_SliceContours.resize( numberOfSlices );
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( vnl_math_min(
+    static_cast<unsigned long>( this->m_NumberOfThreads ), numberOfSlices ) );
+
+  ThreadStruct str;
+  str.Extractor = this;
+  threader->SetSingleMethod( this->ExtractSlicesThreaderCallback, &str );
+  threader->SingleMethodExecute();
+
+  // Concatenate the slices in order.
+  unsigned long numberOfVertices = 0;
+  unsigned long numberOfContours = 0;
+  for( unsigned long n = 0; n < numberOfSlices; n++ )
+    {
+    numberOfVertices += this->m_SliceContours[n].Vertices.size();
+    numberOfContours += this->m_SliceContours[n].ContourLengths.size();
+    }
+  this->m_Vertices.reserve( numberOfVertices );
+  this->m_ContourOffsets.reserve( numberOfContours + 1 );
+  this->m_ContourSlices.reserve( numberOfContours );
+
+  for( unsigned long n = 0; n < numberOfSlices; n++ )
+    {
+    SliceContoursType &contours = this->m_SliceContours[n];
+    this->m_Vertices.insert( this->m_Vertices.end(),
+      contours.Vertices.begin(), contours.Vertices.end() );
+    for( unsigned long c = 0; c < contours.ContourLengths.size(); c++ )
+      {
+      this->m_ContourOffsets.push_back(
+        this->m_ContourOffsets.back() + contours.ContourLengths[c] );
+      this->m_ContourSlices.push_back(
+        this->m_RegionIndex[2] + static_cast<long>( n ) );
+      }
+    contours.Vertices = VertexContainerType();
+    contours.ContourLengths = OffsetContainerType();
+    }
+  this->m_SliceContours.clear();
+}
+
+template <class TInputImage>
+ITK_THREAD_RETURN_TYPE
+SliceStackContourExtractor<TInputImage>
+::ExtractSlicesThreaderCallback( void *arg )
+{
+  unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct *str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  // Slices are interleaved between the threads so that the (usually more
+  // populated) middle slices of the volume are shared by all of them.
+  SliceBuffersType buffers;
+  const unsigned long numberOfSlices = str->Extractor->m_SliceContours.size();
+  for( unsigned long n = threadId; n < numberOfSlices; n += threadCount )
+    {
+    str->Extractor->ExtractSlice( n, buffers,
+      str->Extractor->m_SliceContours[n] );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TInputImage>
+inline unsigned long
+SliceStackContourExtractor<TInputImage>
+::AddVertex( SliceBuffersType &buffers, InputPixelType fromValue,
+  InputPixelType toValue, unsigned long x, unsigned long y,
+  unsigned int direction ) const
+{
+  // Each pixel owns three keys: its edge to the next pixel along x, its edge
+  // to the next pixel along y, and itself, which is used when the contour
+  // goes exactly through it so that both edges yield the same vertex.
+  const unsigned long toX = x + ( direction == 0 ? 1 : 0 );
+  const unsigned long toY = y + ( direction == 1 ? 1 : 0 );
+
+  unsigned long key;
+  double t;
+  if( static_cast<InputRealType>( fromValue ) == this->m_ContourValue )
+    {
+    key = 3 * ( y * this->m_RegionSize[0] + x ) + 2;
+    t = 0.0;
+    }
+  else if( static_cast<InputRealType>( toValue ) == this->m_ContourValue )
+    {
+    key = 3 * ( toY * this->m_RegionSize[0] + toX ) + 2;
+    t = 1.0;
+    }
+  else
+    {
+    key = 3 * ( y * this->m_RegionSize[0] + x ) + direction;
+    t = ( this->m_ContourValue - static_cast<InputRealType>( fromValue ) )
+      / ( toValue - static_cast<InputRealType>( fromValue ) );
+    }
+
+  std::pair<typename hash_map<unsigned long, unsigned long>::iterator, bool>
+    inserted = buffers.VertexIds.insert( std::make_pair( key,
+    static_cast<unsigned long>( buffers.Positions.size() / 2 ) ) );
+  if( inserted.second )
+    {
+    buffers.Positions.push_back( x + t * ( toX - x ) );
+    buffers.Positions.push_back( y + t * ( toY - y ) );
+    }
+  return inserted.first->second;
+}
+
+template <class TInputImage>
+void
+SliceStackContourExtractor<TInputImage>
+::ExtractSlice( unsigned long n, SliceBuffersType &buffers,
+  SliceContoursType &contours ) const
+{
+  const unsigned long nx = this->m_RegionSize[0];
+  const unsigned long ny = this->m_RegionSize[1];
+  const long sx = this->m_Strides[0];
+  const long sy = this->m_Strides[1];
+  const InputPixelType *slice = this->m_Input->GetBufferPointer()
+    + n * this->m_Strides[2];
+
+  buffers.VertexIds.clear();
+  buffers.Positions.clear();
+  buffers.SegmentFrom.clear();
+  buffers.SegmentTo.clear();
+
+  // (1) March the squares as in ContourExtractor2DImageFilter::GenerateData,
+  // the square of pixel (x, y) being
+  // 01
+  // 23
+  // with the lower-valued pixels on the left of each segment.
+
+#define TOP     this->AddVertex( buffers, v0, v1, x,     y,     0 )
+#define BOTTOM  this->AddVertex( buffers, v2, v3, x,     y + 1, 0 )
+#define LEFT    this->AddVertex( buffers, v0, v2, x,     y,     1 )
+#define RIGHT   this->AddVertex( buffers, v1, v3, x + 1, y,     1 )
+#define SEGMENT( from, to ) \
+  { \
+  unsigned long fromId = from; \
+  unsigned long toId = to; \
+  if( fromId != toId ) \
+    { \
+    buffers.SegmentFrom.push_back( fromId ); \
+    buffers.SegmentTo.push_back( toId ); \
+    } \
+  }
+
+  for( unsigned long y = 0; y + 1 < ny; y++ )
+    {
+    const InputPixelType *row = slice + y * sy;
+    for( unsigned long x = 0; x + 1 < nx; x++ )
+      {
+      const InputPixelType *p = row + x * sx;
+      const InputPixelType v0 = p[0];
+      const InputPixelType v1 = p[sx];
+      const InputPixelType v2 = p[sy];
+      const InputPixelType v3 = p[sx + sy];
+
+      unsigned char squareCase = 0;
+      if( v0 > this->m_ContourValue ) squareCase += 1;
+      if( v1 > this->m_ContourValue ) squareCase += 2;
+      if( v2 > this->m_ContourValue ) squareCase += 4;
+      if( v3 > this->m_ContourValue ) squareCase += 8;
+
+      switch( squareCase )
+        {
+        case 0: case 15:
+          break;
+        case 1:
+          SEGMENT( TOP, LEFT );
+          break;
+        case 2:
+          SEGMENT( RIGHT, TOP );
+          break;
+        case 3:
+          SEGMENT( RIGHT, LEFT );
+          break;
+        case 4:
+          SEGMENT( LEFT, BOTTOM );
+          break;
+        case 5:
+          SEGMENT( TOP, BOTTOM );
+          break;
+        case 6:
+          if( this->m_VertexConnectHighPixels )
+            {
+            SEGMENT( LEFT, TOP );
+            SEGMENT( RIGHT, BOTTOM );
+            }
+          else
+            {
+            SEGMENT( RIGHT, TOP );
+            SEGMENT( LEFT, BOTTOM );
+            }
+          break;
+        case 7:
+          SEGMENT( RIGHT, BOTTOM );
+          break;
+        case 8:
+          SEGMENT( BOTTOM, RIGHT );
+          break;
+        case 9:
+          if( this->m_VertexConnectHighPixels )
+            {
+            SEGMENT( TOP, RIGHT );
+            SEGMENT( BOTTOM, LEFT );
+            }
+          else
+            {
+            SEGMENT( TOP, LEFT );
+            SEGMENT( BOTTOM, RIGHT );
+            }
+          break;
+        case 10:
+          SEGMENT( BOTTOM, TOP );
+          break;
+        case 11:
+          SEGMENT( BOTTOM, LEFT );
+          break;
+        case 12:
+          SEGMENT( LEFT, RIGHT );
+          break;
+        case 13:
+          SEGMENT( TOP, RIGHT );
+          break;
+        case 14:
+          SEGMENT( LEFT, TOP );
+          break;
+        }
+      }
+    }
+
+#undef TOP
+#undef BOTTOM
+#undef LEFT
+#undef RIGHT
+#undef SEGMENT
+
+  // (2) Chain the segments.  A vertex keeps the first segment leaving it and
+  // the first segment reaching it; two segments are linked only when each is
+  // the other's choice, so the links form disjoint open or closed chains.
+  const unsigned long none = NumericTraits<unsigned long>::max();
+  const unsigned long numberOfVertices = buffers.Positions.size() / 2;
+  const unsigned long numberOfSegments = buffers.SegmentFrom.size();
+
+  buffers.Outgoing.assign( numberOfVertices, none );
+  buffers.Incoming.assign( numberOfVertices, none );
+  for( unsigned long s = 0; s < numberOfSegments; s++ )
+    {
+    if( buffers.Outgoing[buffers.SegmentFrom[s]] == none )
+      {
+      buffers.Outgoing[buffers.SegmentFrom[s]] = s;
+      }
+    if( buffers.Incoming[buffers.SegmentTo[s]] == none )
+      {
+      buffers.Incoming[buffers.SegmentTo[s]] = s;
+      }
+    }
+  buffers.Successors.resize( numberOfSegments );
+  buffers.Predecessors.resize( numberOfSegments );
+  for( unsigned long s = 0; s < numberOfSegments; s++ )
+    {
+    const unsigned long to = buffers.SegmentTo[s];
+    buffers.Successors[s] = ( buffers.Incoming[to] == s )
+      ? buffers.Outgoing[to] : none;
+    const unsigned long from = buffers.SegmentFrom[s];
+    buffers.Predecessors[s] = ( buffers.Outgoing[from] == s )
+      ? buffers.Incoming[from] : none;
+    }
+
+  // (3) Walk the chains in the order of their first segment, which keeps the
+  // top-to-bottom order of the 2-D filter, and emit the vertices.
+  ContinuousIndexType index;
+  index[this->m_Axes[2]] = this->m_RegionIndex[2] + static_cast<long>( n );
+  PointType point;
+
+  contours.Vertices.clear();
+  contours.ContourLengths.clear();
+  buffers.Visited.assign( numberOfSegments, false );
+  for( unsigned long s = 0; s < numberOfSegments; s++ )
+    {
+    if( buffers.Visited[s] )
+      {
+      continue;
+      }
+    unsigned long first = s;
+    while( buffers.Predecessors[first] != none
+      && buffers.Predecessors[first] != s )
+      {
+      first = buffers.Predecessors[first];
+      }
+    if( buffers.Predecessors[first] == s )
+      {
+      first = s;
+      }
+
+    const unsigned long start = contours.Vertices.size();
+    unsigned long vertex = buffers.SegmentFrom[first];
+    unsigned long segment = first;
+    while( true )
+      {
+      index[this->m_Axes[0]] = this->m_RegionIndex[0]
+        + buffers.Positions[2 * vertex];
+      index[this->m_Axes[1]] = this->m_RegionIndex[1]
+        + buffers.Positions[2 * vertex + 1];
+      this->m_Input->TransformContinuousIndexToPhysicalPoint( index, point );
+      contours.Vertices.push_back( point );
+
+      if( segment == none )
+        {
+        break;
+        }
+      buffers.Visited[segment] = true;
+      vertex = buffers.SegmentTo[segment];
+      segment = buffers.Successors[segment];
+      if( segment == first )
+        {
+        segment = none;
+        }
+      }
+
+    if( this->m_ReverseContourOrientation )
+      {
+      std::reverse( contours.Vertices.begin() + start, contours.Vertices.end() );
+      }
+    contours.ContourLengths.push_back( contours.Vertices.size() - start );
+    }
+}
+
+template <class TInputImage>
+void
+SliceStackContourExtractor<TInputImage>
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+  os << indent << "Contour value: "
+     << static_cast<typename NumericTraits<InputRealType>::PrintType>(
+       this->m_ContourValue ) << std::endl;
+  os << indent << "VertexConnectHighPixels: "
+     << this->m_VertexConnectHighPixels << std::endl;
+  os << indent << "ReverseContourOrientation: "
+     << this->m_ReverseContourOrientation << std::endl;
+  os << indent << "Slice dimension: " << this->m_SliceDimension << std::endl;
+  os << indent << "Number of threads: " << this->m_NumberOfThreads << std::endl;
+  os << indent << "Number of contours: " << this->GetNumberOfContours()
+     << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,189 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkThinPlateSplineDeformationFieldSource.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkThinPlateSplineDeformationFieldSource_h
+#define __itkThinPlateSplineDeformationFieldSource_h
+
+#include "itkImageSource.h"
+
+#include "itkMatrix.h"
+#include "itkNumericTraits.h"
+#include "itkPoint.h"
+#include "itkVector.h"
+#include "itkVectorContainer.h"
+#include "itkVectorLinearInterpolateImageFunction.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class ThinPlateSplineDeformationFieldSource
+ * \brief Samples a thin-plate spline mapping on an image grid as a
+ * deformation field.
+ *
+ * The mapping of a point x is
+ *
+ *   y = A_0 + sum_d x_d A_{d+1} + sum_n U( |x - p_n| ) w_n
+ *
+ * where A is the (ImageDimension+1) x ImageDimension affine matrix, p_n are
+ * the landmarks and w_n their kernel weights; U(r) = r^2 log r in 2-D and
+ * U(r) = -r otherwise.  The output pixel is y - x.
+ *
+ * The landmarks and the weights are kept as one array per coordinate.  Each
+ * thread takes a slab of the output and evaluates the points of an image
+ * line in blocks against all the landmarks, so that the inner loop runs over
+ * contiguous arrays and nothing is allocated per pixel.  The sums are done
+ * in double: far from the landmarks the kernel terms are large and cancel.
+ *
+ * With an ApproximationFactor k > 1, the kernel sum is evaluated exactly
+ * only on a grid k times coarser than the output and linearly interpolated
+ * in between, which divides the cost by k^ImageDimension for large
+ * landmark sets.  The affine part is always exact.  In 3-D the kernel has a
+ * cusp at the landmarks, so the interpolation error is largest there.
+ *
+ * \ingroup DataSources
+ */
+template <typename TOutputImage>
+class ITK_EXPORT ThinPlateSplineDeformationFieldSource
+: public ImageSource<TOutputImage>
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef ThinPlateSplineDeformationFieldSource  Self;
+  typedef ImageSource<TOutputImage>              Superclass;
+  typedef SmartPointer<Self>                     Pointer;
+  typedef SmartPointer<const Self>               ConstPointer;
+
+  /** Output image typedefs */
+  typedef TOutputImage                           OutputImageType;
+  typedef typename OutputImageType::PixelType    PixelType;
+  typedef typename PixelType::ValueType          PixelValueType;
+  typedef typename OutputImageType::RegionType   RegionType;
+  typedef typename OutputImageType::SpacingType  SpacingType;
+  typedef typename OutputImageType::PointType    OriginType;
+  typedef typename OutputImageType::DirectionType DirectionType;
+
+  typedef typename RegionType::SizeType          SizeType;
+  typedef typename RegionType::IndexType         IndexType;
+
+  typedef double                                 RealType;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ThinPlateSplineDeformationFieldSource, ImageSource );
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Dimensionality of the output image */
+  itkStaticConstMacro( ImageDimension, unsigned int,
+                       OutputImageType::ImageDimension );
+
+  typedef Point<RealType,
+    itkGetStaticConstMacro( ImageDimension )>    PointType;
+  typedef Vector<RealType,
+    itkGetStaticConstMacro( ImageDimension )>    VectorType;
+  typedef Matrix<RealType,
+    itkGetStaticConstMacro( ImageDimension ) + 1,
+    itkGetStaticConstMacro( ImageDimension )>    AffineMatrixType;
+  typedef VectorContainer<unsigned long,
+    PointType>                                   LandmarkContainerType;
+  typedef VectorContainer<unsigned long,
+    VectorType>                                  WeightContainerType;
+
+  /** Output image parameters */
+  itkSetMacro( Size, SizeType );
+  itkGetConstMacro( Size, SizeType );
+
+  itkSetMacro( Spacing, SpacingType );
+  itkGetConstMacro( Spacing, SpacingType );
+
+  itkSetMacro( Origin, OriginType );
+  itkGetConstMacro( Origin, OriginType );
+
+  itkSetMacro( Direction, DirectionType );
+  itkGetConstMacro( Direction, DirectionType );
+
+  /** Landmarks p_n and their kernel weights w_n (same number). */
+  itkSetConstObjectMacro( Landmarks, LandmarkContainerType );
+  itkGetConstObjectMacro( Landmarks, LandmarkContainerType );
+
+  itkSetConstObjectMacro( KernelWeights, WeightContainerType );
+  itkGetConstObjectMacro( KernelWeights, WeightContainerType );
+
+  /** Affine part: row 0 is the translation, row d+1 multiplies x_d. */
+  itkSetMacro( AffineMatrix, AffineMatrixType );
+  itkGetConstMacro( AffineMatrix, AffineMatrixType );
+
+  /** Ratio between the output grid and the grid on which the kernel sum is
+   * evaluated exactly.  Default is 1 (exact everywhere). */
+  itkSetClampMacro( ApproximationFactor, unsigned int, 1,
+    NumericTraits<unsigned int>::max() );
+  itkGetConstMacro( ApproximationFactor, unsigned int );
+
+protected:
+  ThinPlateSplineDeformationFieldSource();
+  ~ThinPlateSplineDeformationFieldSource() {}
+  void PrintSelf( std::ostream& os, Indent indent ) const;
+
+  virtual void GenerateOutputInformation();
+  void BeforeThreadedGenerateData();
+  void ThreadedGenerateData( const RegionType &, int );
+  void AfterThreadedGenerateData();
+
+private:
+  ThinPlateSplineDeformationFieldSource( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  typedef VectorLinearInterpolateImageFunction
+    <OutputImageType, RealType>                  InterpolatorType;
+
+  /** Number of points of a line evaluated together. */
+  enum { BlockSize = 128 };
+
+  /** Add the kernel sum at points x[d][i], i < n, to sum[d][i]. */
+  void EvaluateKernelSum( const RealType * const *, RealType * const *,
+    unsigned int ) const;
+
+  SizeType                                       m_Size;
+  SpacingType                                    m_Spacing;
+  OriginType                                     m_Origin;
+  DirectionType                                  m_Direction;
+
+  typename LandmarkContainerType::ConstPointer   m_Landmarks;
+  typename WeightContainerType::ConstPointer     m_KernelWeights;
+  AffineMatrixType                               m_AffineMatrix;
+  unsigned int                                   m_ApproximationFactor;
+
+  /** Set on the internal coarse source, which only evaluates the kernel
+   * sum. */
+  bool                                           m_KernelSumOnly;
+
+  /** State of the current update */
+  std::vector<RealType>                          m_LandmarkCoordinates[ImageDimension];
+  std::vector<RealType>                          m_WeightComponents[ImageDimension];
+  typename OutputImageType::Pointer              m_CoarseKernelSum;
+  typename InterpolatorType::Pointer             m_Interpolator;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkThinPlateSplineDeformationFieldSource.hxx"
+#endif
+
+#endif
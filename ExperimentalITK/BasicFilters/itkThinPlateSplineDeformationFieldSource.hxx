@@ -0,0 +1,329 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkThinPlateSplineDeformationFieldSource.hxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itkThinPlateSplineDeformationFieldSource_hxx
+#define _itkThinPlateSplineDeformationFieldSource_hxx
+
+#include "itkThinPlateSplineDeformationFieldSource.h"
+
+#include "itkContinuousIndex.h"
+#include "itkImageLinearIteratorWithIndex.h"
+#include "itkProgressReporter.h"
+
+#include "vnl/vnl_math.h"
+
+namespace itk
+{
+
+template <class TOutputImage>
+ThinPlateSplineDeformationFieldSource<TOutputImage>
+::ThinPlateSplineDeformationFieldSource()
+{
+  this->m_Size.Fill( 0 );
+  this->m_Spacing.Fill( 1.0 );
+  this->m_Origin.Fill( 0.0 );
+  this->m_Direction.SetIdentity();
+
+  this->m_Landmarks = NULL;
+  this->m_KernelWeights = NULL;
+
+  // Identity mapping
+  this->m_AffineMatrix.Fill( 0.0 );
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    this->m_AffineMatrix( d + 1, d ) = 1.0;
+    }
+
+  this->m_ApproximationFactor = 1;
+  this->m_KernelSumOnly = false;
+}
+
+template <class TOutputImage>
+void
+ThinPlateSplineDeformationFieldSource<TOutputImage>
+::GenerateOutputInformation()
+{
+  OutputImageType *output = this->GetOutput();
+
+  IndexType index;
+  index.Fill( 0 );
+
+  RegionType largestPossibleRegion;
+  largestPossibleRegion.SetSize( this->m_Size );
+  largestPossibleRegion.SetIndex( index );
+  output->SetLargestPossibleRegion( largestPossibleRegion );
+
+  output->SetSpacing( this->m_Spacing );
+  output->SetOrigin( this->m_Origin );
+  output->SetDirection( this->m_Direction );
+}
+
+template <class TOutputImage>
+void
+ThinPlateSplineDeformationFieldSource<TOutputImage>
+::BeforeThreadedGenerateData()
+{
+  if( !this->m_Landmarks || !this->m_KernelWeights )
+    {
+    itkExceptionMacro( "The landmarks and the kernel weights are not set." );
+    }
+  if( this->m_Landmarks->Size() != this->m_KernelWeights->Size() )
+    {
+    itkExceptionMacro( "There are " << this->m_Landmarks->Size()
+      << " landmarks but " << this->m_KernelWeights->Size()
+      << " kernel weights." );
+    }
+
+  const unsigned long numberOfLandmarks = this->m_Landmarks->Size();
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    this->m_LandmarkCoordinates[d].resize( numberOfLandmarks );
+    this->m_WeightComponents[d].resize( numberOfLandmarks );
+    }
+  for( unsigned long n = 0; n < numberOfLandmarks; n++ )
+    {
+    const PointType &landmark = this->m_Landmarks->ElementAt( n );
+    const VectorType &weight = this->m_KernelWeights->ElementAt( n );
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      this->m_LandmarkCoordinates[d][n] = landmark[d];
+      this->m_WeightComponents[d][n] = weight[d];
+      }
+    }
+
+  this->m_CoarseKernelSum = NULL;
+  this->m_Interpolator = NULL;
+
+  if( this->m_ApproximationFactor > 1 && !this->m_KernelSumOnly )
+    {
+    // The coarse grid has the same origin and covers the output.
+    const unsigned int factor = this->m_ApproximationFactor;
+    SizeType coarseSize;
+    SpacingType coarseSpacing;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      coarseSize[d] = 1;
+      if( this->m_Size[d] > 1 )
+        {
+        coarseSize[d] += ( this->m_Size[d] - 2 ) / factor + 1;
+        }
+      coarseSpacing[d] = this->m_Spacing[d] * factor;
+      }
+
+    typename Self::Pointer coarseSource = Self::New();
+    coarseSource->SetSize( coarseSize );
+    coarseSource->SetSpacing( coarseSpacing );
+    coarseSource->SetOrigin( this->m_Origin );
+    coarseSource->SetDirection( this->m_Direction );
+    coarseSource->SetLandmarks( this->m_Landmarks );
+    coarseSource->SetKernelWeights( this->m_KernelWeights );
+    coarseSource->m_KernelSumOnly = true;
+    coarseSource->SetNumberOfThreads( this->GetNumberOfThreads() );
+    coarseSource->Update();
+
+    this->m_CoarseKernelSum = coarseSource->GetOutput();
+    this->m_Interpolator = InterpolatorType::New();
+    this->m_Interpolator->SetInputImage( this->m_CoarseKernelSum );
+    }
+}
+
+template <class TOutputImage>
+void
+ThinPlateSplineDeformationFieldSource<TOutputImage>
+::ThreadedGenerateData( const RegionType &region, int threadId )
+{
+  OutputImageType *output = this->GetOutput();
+
+  const unsigned long lineLength = region.GetSize()[0];
+  if( lineLength == 0 )
+    {
+    return;
+    }
+
+  ProgressReporter progress( this, threadId,
+    region.GetNumberOfPixels() / lineLength );
+
+  // Points of a block of a line and their kernel sums, one array per
+  // coordinate.
+  std::vector<RealType> buffer( 2 * ImageDimension * BlockSize );
+  RealType *x[ImageDimension];
+  RealType *sum[ImageDimension];
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    x[d] = &buffer[d * BlockSize];
+    sum[d] = &buffer[( ImageDimension + d ) * BlockSize];
+    }
+
+  // Physical step between neighbors along a line
+  VectorType step;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    step[d] = this->m_Direction[d][0] * this->m_Spacing[0];
+    }
+
+  ImageLinearIteratorWithIndex<OutputImageType> It( output, region );
+  It.SetDirection( 0 );
+
+  for( It.GoToBegin(); !It.IsAtEnd(); It.NextLine() )
+    {
+    const IndexType lineIndex = It.GetIndex();
+    typename OutputImageType::PointType lineStart;
+    output->TransformIndexToPhysicalPoint( lineIndex, lineStart );
+
+    for( unsigned long first = 0; first < lineLength; first += BlockSize )
+      {
+      const unsigned int numberOfPoints = static_cast<unsigned int>(
+        vnl_math_min( static_cast<unsigned long>( BlockSize ), lineLength - first ) );
+
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        for( unsigned int i = 0; i < numberOfPoints; i++ )
+          {
+          x[d][i] = lineStart[d] + ( first + i ) * step[d];
+          sum[d][i] = 0.0;
+          }
+        }
+
+      if( !this->m_CoarseKernelSum )
+        {
+        this->EvaluateKernelSum( x, sum, numberOfPoints );
+        }
+      else
+        {
+        ContinuousIndex<RealType, ImageDimension> coarseIndex;
+        for( unsigned int d = 1; d < ImageDimension; d++ )
+          {
+          coarseIndex[d] = static_cast<RealType>( lineIndex[d] )
+            / this->m_ApproximationFactor;
+          }
+        for( unsigned int i = 0; i < numberOfPoints; i++ )
+          {
+          coarseIndex[0] = static_cast<RealType>( lineIndex[0] + first + i )
+            / this->m_ApproximationFactor;
+          typename InterpolatorType::OutputType value =
+            this->m_Interpolator->EvaluateAtContinuousIndex( coarseIndex );
+          for( unsigned int d = 0; d < ImageDimension; d++ )
+            {
+            sum[d][i] = value[d];
+            }
+          }
+        }
+
+      for( unsigned int i = 0; i < numberOfPoints; i++ )
+        {
+        PixelType pixel;
+        for( unsigned int d = 0; d < ImageDimension; d++ )
+          {
+          RealType value = sum[d][i];
+          if( !this->m_KernelSumOnly )
+            {
+            value += this->m_AffineMatrix( 0, d ) - x[d][i];
+            for( unsigned int e = 0; e < ImageDimension; e++ )
+              {
+              value += x[e][i] * this->m_AffineMatrix( e + 1, d );
+              }
+            }
+          pixel[d] = static_cast<PixelValueType>( value );
+          }
+        It.Set( pixel );
+        ++It;
+        }
+      }
+    progress.CompletedPixel();
+    }
+}
+
+template <class TOutputImage>
+void
+ThinPlateSplineDeformationFieldSource<TOutputImage>
+::EvaluateKernelSum( const RealType * const *x, RealType * const *sum,
+  unsigned int numberOfPoints ) const
+{
+  const unsigned long numberOfLandmarks = this->m_LandmarkCoordinates[0].size();
+
+  for( unsigned long n = 0; n < numberOfLandmarks; n++ )
+    {
+    RealType landmark[ImageDimension];
+    RealType weight[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      landmark[d] = this->m_LandmarkCoordinates[d][n];
+      weight[d] = this->m_WeightComponents[d][n];
+      }
+
+    for( unsigned int i = 0; i < numberOfPoints; i++ )
+      {
+      RealType r2 = 0.0;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        const RealType t = x[d][i] - landmark[d];
+        r2 += t * t;
+        }
+
+      // r^2 log r = 0.5 r^2 log r^2 in 2-D, -r otherwise
+      RealType u;
+      if( ImageDimension == 2 )
+        {
+        u = ( r2 > 0.0 ) ? 0.5 * r2 * vcl_log( r2 ) : 0.0;
+        }
+      else
+        {
+        u = -vcl_sqrt( r2 );
+        }
+
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        sum[d][i] += u * weight[d];
+        }
+      }
+    }
+}
+
+template <class TOutputImage>
+void
+ThinPlateSplineDeformationFieldSource<TOutputImage>
+::AfterThreadedGenerateData()
+{
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    std::vector<RealType>().swap( this->m_LandmarkCoordinates[d] );
+    std::vector<RealType>().swap( this->m_WeightComponents[d] );
+    }
+  this->m_CoarseKernelSum = NULL;
+  this->m_Interpolator = NULL;
+}
+
+template <class TOutputImage>
+void
+ThinPlateSplineDeformationFieldSource<TOutputImage>
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Size: " << this->m_Size << std::endl;
+  os << indent << "Origin: " << this->m_Origin << std::endl;
+  os << indent << "Spacing: " << this->m_Spacing << std::endl;
+  os << indent << "Direction: " << this->m_Direction << std::endl;
+  os << indent << "Number of landmarks: "
+    << ( this->m_Landmarks ? this->m_Landmarks->Size() : 0 ) << std::endl;
+  os << indent << "Affine matrix: " << std::endl << this->m_AffineMatrix;
+  os << indent << "Approximation factor: "
+    << this->m_ApproximationFactor << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -19,17 +19,28 @@
 
 #include "itkPointSetToImageFilter.h"
 
-#include "itkPointSet.h"
+#include "itkKdTreeGenerator.h"
 #include "itkKernelTransform.h"
-#include "itkVariableLengthVector.h"
-#include "itkVariableSizeMatrix.h"
+#include "itkListSample.h"
+#include "itkMultiThreader.h"
+#include "itkPointSet.h"
+#include "itkSparseMatrixSinkhornNormalization.h"
 #include "itkVector.h"
 
+#include "vnl/vnl_sparse_matrix.h"
+#include "vnl/vnl_vector.h"
+
+#include <vector>
+
 namespace itk
 {
 
 /** \class ThinPlateSplineRobustPointMethodPointSetFilter.h
  * \brief point set filter.
+ *
+ * The correspondence matrix is stored as a sparse matrix.  See 
+ * BSplineRobustPointMethodPointSetFilter for the meaning of 
+ * UseSparseCorrespondence, CorrespondenceCutoff and MaximumNumberOfNeighbors.
  */
 
 template <class TPointSet, 
@@ -60,8 +71,19 @@ public:
   typedef typename VectorType::ValueType                      RealType;
 
   /** Other typedef */
-  typedef VariableSizeMatrix<RealType>                        MatrixType;
-  typedef VariableLengthVector<RealType>                      OutlierVectorType;
+  typedef vnl_sparse_matrix<RealType>                         SparseMatrixType;
+  typedef vnl_vector<RealType>                                OutlierVectorType;
+  typedef SparseMatrixSinkhornNormalization<RealType, 
+    SparseMatrixType, OutlierVectorType>                      NormalizerType;
+
+  /** kd-tree typedefs */
+  typedef Vector<RealType, 
+    itkGetStaticConstMacro( Dimension )>                      MeasurementVectorType;
+  typedef typename Statistics::ListSample
+    <MeasurementVectorType>                                   SampleType;
+  typedef typename Statistics
+    ::KdTreeGenerator<SampleType>                             TreeGeneratorType;
+  typedef typename TreeGeneratorType::KdTreeType              KdTreeType;
 
   /** thin-plate spline typedefs */
   typedef KernelTransform<RealType,                      
@@ -94,6 +116,24 @@ public:
   itkSetMacro( UseBoundingBox, bool );
   itkGetConstMacro( UseBoundingBox, bool );
 
+  itkBooleanMacro( UseSparseCorrespondence );
+  itkSetMacro( UseSparseCorrespondence, bool );
+  itkGetConstMacro( UseSparseCorrespondence, bool );
+
+  itkSetClampMacro( CorrespondenceCutoff, RealType, 0, 1 );
+  itkGetConstMacro( CorrespondenceCutoff, RealType );
+
+  itkSetMacro( MaximumNumberOfNeighbors, unsigned int );
+  itkGetConstMacro( MaximumNumberOfNeighbors, unsigned int );
+
+  /** Number of nearest fixed points kept per row when the sparse rows are
+   * not bounded otherwise, i.e. MaximumNumberOfNeighbors is 0 and the
+   * radius is infinite (uniform correspondences before the annealing
+   * starts, or a zero CorrespondenceCutoff).  Default is 20. */
+  itkSetClampMacro( NumberOfUnboundedNeighbors, unsigned int, 1,
+    NumericTraits<unsigned int>::max() );
+  itkGetConstMacro( NumberOfUnboundedNeighbors, unsigned int );
+
   itkGetConstMacro( VPoints, typename InputPointSetType::Pointer );
 
 protected:
@@ -105,9 +145,19 @@ protected:
 
 private:
   void Initialize();
+  void GenerateKdTrees();
   void CalculateInitialAndFinalTemperatures();
   void UpdateCorrespondenceMatrix();
+  void ThreadedUpdateCorrespondenceMatrix( unsigned int, unsigned int );
   void UpdateTransformation();
+
+  /** Multi-threading support. */
+  struct ThreadStruct
+    {
+    Self *Filter;
+    };
+
+  static ITK_THREAD_RETURN_TYPE UpdateCorrespondenceMatrixThreaderCallback( void * );
  
   void VisualizeCurrentState();
 
@@ -117,7 +167,7 @@ private:
 
   typename InputPointSetType::Pointer                        m_VPoints;
 
-  MatrixType                                                 m_CorrespondenceMatrix;
+  SparseMatrixType                                           m_CorrespondenceMatrix;
   OutlierVectorType                                          m_OutlierRow;
   OutlierVectorType                                          m_OutlierColumn;
   typename InputPointSetType::PointType                      m_OutlierPointX;
@@ -132,6 +182,14 @@ private:
   unsigned int                                               m_NumberOfIterationsPerTemperature;
   bool                                                       m_SolveSimplerLeastSquaresProblem;
   bool                                                       m_UseBoundingBox;
+
+  bool                                                       m_UseSparseCorrespondence;
+  RealType                                                   m_CorrespondenceCutoff;
+  unsigned int                                               m_MaximumNumberOfNeighbors;
+  unsigned int                                               m_NumberOfUnboundedNeighbors;
+  typename SampleType::Pointer                               m_SamplePoints;
+  std::vector<typename TreeGeneratorType::Pointer>           m_KdTreeGenerators;
+  MultiThreader::Pointer                                     m_Threader;
     
 };
 
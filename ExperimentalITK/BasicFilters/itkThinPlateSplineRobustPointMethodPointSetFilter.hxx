@@ -11,6 +11,9 @@
 
 #include "fstream.h"
 
+#include <algorithm>
+#include <utility>
+
 namespace itk
 {
 
@@ -33,6 +36,11 @@ ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
   this->m_UseBoundingBox = true;
 
   this->m_SolveSimplerLeastSquaresProblem = true;
+
+  this->m_UseSparseCorrespondence = false;
+  this->m_CorrespondenceCutoff = 1e-6;
+  this->m_MaximumNumberOfNeighbors = 0;
+  this->m_NumberOfUnboundedNeighbors = 20;
 }
 
 template <class TPointSet, class TOutputImage>
@@ -102,13 +110,15 @@ ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
       { 
       typename PointSetType::PointType Y;
       Y.Fill( 0 );
-      for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ ) 
+      typename SparseMatrixType::row &rw = this->m_CorrespondenceMatrix.get_row( i );
+      typename SparseMatrixType::row::iterator ri;
+      for ( ri = rw.begin(); ri != rw.end(); ++ri ) 
         {
-        RealType m = this->m_CorrespondenceMatrix( i, j );
+        RealType m = (*ri).second;
         if ( m > 0 )
           {  
           typename InputPointSetType::PointType X;
-          this->GetInput( 0 )->GetPoint( j, &X );
+          this->GetInput( 0 )->GetPoint( (*ri).first, &X );
           for ( unsigned int d = 0; d < Dimension; d++ )
             {
             Y[d] += ( X[d] * m ); 
@@ -223,12 +233,21 @@ ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
   RealType K = static_cast<RealType>( this->GetInput( 1 )->GetNumberOfPoints() );
   RealType N = static_cast<RealType>( this->GetInput( 0 )->GetNumberOfPoints() );
 
-  this->m_CorrespondenceMatrix.SetSize( K, N );
-  this->m_OutlierColumn.SetSize( K );
-  this->m_OutlierRow.SetSize( N );
+  this->m_CorrespondenceMatrix.set_size( 
+    this->GetInput( 1 )->GetNumberOfPoints(), this->GetInput( 0 )->GetNumberOfPoints() );
+  this->m_OutlierColumn.set_size( this->GetInput( 1 )->GetNumberOfPoints() );
+  this->m_OutlierRow.set_size( this->GetInput( 0 )->GetNumberOfPoints() );
 
-  this->m_OutlierColumn.Fill( 0.1 / K );
-  this->m_OutlierRow.Fill( 0.1 / K );
+  this->m_OutlierColumn.fill( 0.1 / K );
+  this->m_OutlierRow.fill( 0.1 / K );
+
+  this->m_Threader = MultiThreader::New();
+  this->m_Threader->SetNumberOfThreads( this->GetNumberOfThreads() );
+
+  if ( this->m_UseSparseCorrespondence )
+    {
+    this->GenerateKdTrees();
+    }
 
   if ( this->m_FinalTemperature == NumericTraits<RealType>::max() || 
        this->m_InitialTemperature == NumericTraits<RealType>::max() )
@@ -246,6 +265,48 @@ ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
   RealType maxSquaredDistance = 0;
   RealType sumMinSquaredDistance = 0;
 
+  if ( this->m_UseSparseCorrespondence )
+    {
+    /**
+     * Avoid the O( N * K ) search:  the nearest fixed point is found with
+     * the kd-tree and the largest distance is bounded by the farthest 
+     * corner of the bounding box of the fixed points.
+     */
+    const KdTreeType *tree = this->m_KdTreeGenerators[0]->GetOutput();
+    typename KdTreeType::InstanceIdentifierVectorType neighbors;
+
+    for ( unsigned int i = 0; i < this->GetInput( 1 )->GetNumberOfPoints(); i++ )
+      {
+      typename InputPointSetType::PointType V;
+      this->GetInput( 1 )->GetPoint( i, &V );    
+
+      MeasurementVectorType mv;
+      RealType squaredDistance = 0;
+      for ( unsigned int d = 0; d < Dimension; d++ )
+        {
+        mv[d] = V[d];
+        squaredDistance += vnl_math_max( 
+          vnl_math_sqr( V[d] - this->GetInput( 0 )->GetBoundingBox()->GetMinimum()[d] ),
+          vnl_math_sqr( V[d] - this->GetInput( 0 )->GetBoundingBox()->GetMaximum()[d] ) );
+        }
+      if ( squaredDistance > maxSquaredDistance )
+        {
+        maxSquaredDistance = squaredDistance;
+        } 
+
+      tree->Search( mv, 1u, neighbors );
+
+      typename InputPointSetType::PointType X;      
+      this->GetInput( 0 )->GetPoint( neighbors[0], &X );      
+      sumMinSquaredDistance += ( X - V ).GetSquaredNorm();
+      } 
+
+    this->m_InitialTemperature = maxSquaredDistance;
+    this->m_FinalTemperature = sumMinSquaredDistance 
+      / static_cast<RealType>( this->GetInput( 1 )->GetNumberOfPoints() );
+    return;
+    }
+
   for ( unsigned int i = 0; i < this->GetInput( 1 )->GetNumberOfPoints(); i++ )
     {
     typename InputPointSetType::PointType V;
@@ -283,103 +344,188 @@ ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
 template <class TPointSet, class TOutputImage>
 void
 ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
-::UpdateCorrespondenceMatrix()
+::GenerateKdTrees()
 {
-  for ( unsigned int i = 0; i < this->m_VPoints->GetNumberOfPoints(); i++ )
+  this->m_SamplePoints = SampleType::New();
+  this->m_SamplePoints->SetMeasurementVectorSize( Dimension );
+
+  for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ )
     {
-    typename InputPointSetType::PointType V;
-    this->m_VPoints->GetPoint( i, &V );    
+    typename InputPointSetType::PointType X;      
+    this->GetInput( 0 )->GetPoint( j, &X );      
 
-    for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ )
+    MeasurementVectorType mv;
+    for ( unsigned int d = 0; d < Dimension; d++ )
       {
-      typename InputPointSetType::PointType X;      
-      this->GetInput( 0 )->GetPoint( j, &X );      
- 
-      this->m_CorrespondenceMatrix( i, j )  
-        = vcl_exp( -( X - V ).GetSquaredNorm() / this->m_CurrentTemperature );
-      }  
-    } 
+      mv[d] = X[d];
+      }
+    this->m_SamplePoints->PushBack( mv );
+    }
+
+  /**
+   * The kd-tree searches keep their state in the tree so each thread
+   * gets its own tree.
+   */
+  this->m_KdTreeGenerators.resize( this->m_Threader->GetNumberOfThreads() );
+  for ( unsigned int n = 0; n < this->m_KdTreeGenerators.size(); n++ )
+    {
+    this->m_KdTreeGenerators[n] = TreeGeneratorType::New();
+    this->m_KdTreeGenerators[n]->SetSample( this->m_SamplePoints );
+    this->m_KdTreeGenerators[n]->SetBucketSize( 16 );
+    this->m_KdTreeGenerators[n]->Update();
+    }
+}
+
+template <class TPointSet, class TOutputImage>
+void
+ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
+::UpdateCorrespondenceMatrix()
+{
+  ThreadStruct str;
+  str.Filter = this;
+
+  this->m_Threader->SetSingleMethod( this->UpdateCorrespondenceMatrixThreaderCallback, &str );
+  this->m_Threader->SingleMethodExecute();
 
   RealType K = static_cast<RealType>( this->GetInput( 1 )->GetNumberOfPoints() );
   if ( this->m_CurrentTemperature == this->m_InitialTemperature )
     {
-    this->m_OutlierColumn.Fill( 0.0017 /*0.1 / K*/ );
-    this->m_OutlierRow.Fill( 0.0017 /*0.1 / K*/ );
+    this->m_OutlierColumn.fill( 0.0017 /*0.1 / K*/ );
+    this->m_OutlierRow.fill( 0.0017 /*0.1 / K*/ );
     }
   else
     {  
-    this->m_OutlierColumn.Fill( 0.3078 /*0.1 / K*/ );
-    this->m_OutlierRow.Fill( 0.3078 /*0.1 / K*/ );
+    this->m_OutlierColumn.fill( 0.3078 /*0.1 / K*/ );
+    this->m_OutlierRow.fill( 0.3078 /*0.1 / K*/ );
     }
 
   /**
    * Normalize correspondence matrix
    */
- 
   RealType epsilon = 0.05;
-  RealType deviation = NumericTraits<RealType>::max(); 
 
-  OutlierVectorType rowSum;
-  OutlierVectorType columnSum;
+  typename NormalizerType::Pointer normalizer = NormalizerType::New();
+  normalizer->SetMatrix( &this->m_CorrespondenceMatrix );
+  normalizer->SetOutlierColumn( &this->m_OutlierColumn );
+  normalizer->SetOutlierRow( &this->m_OutlierRow );
+  normalizer->SetTolerance( epsilon * epsilon );
+  normalizer->SetMaximumNumberOfIterations( 10 );
+  normalizer->NormalizeRowsFirstOff();
+  normalizer->SetNumberOfThreads( this->GetNumberOfThreads() );
+  normalizer->Update();
+}
 
-  unsigned int maximumNumberOfIterations = 10;
-  unsigned int iterations = 0;
+template <class TPointSet, class TOutputImage>
+ITK_THREAD_RETURN_TYPE
+ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
+::UpdateCorrespondenceMatrixThreaderCallback( void *arg )
+{
+  unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct *str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  str->Filter->ThreadedUpdateCorrespondenceMatrix( threadId, threadCount );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
 
-  while ( deviation > epsilon*epsilon && iterations++ < maximumNumberOfIterations )
+template <class TPointSet, class TOutputImage>
+void
+ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
+::ThreadedUpdateCorrespondenceMatrix( unsigned int threadId, unsigned int threadCount )
+{
+  const unsigned long numberOfRows = this->m_VPoints->GetNumberOfPoints();
+  const unsigned long firstRow = ( numberOfRows * threadId ) / threadCount;
+  const unsigned long lastRow = ( numberOfRows * ( threadId + 1 ) ) / threadCount;
+
+  /**
+   * Drop the fixed points whose weight exp( -d^2 / T ) is below the cutoff.
+   */
+  RealType squaredRadius = NumericTraits<RealType>::max();
+  if ( this->m_CorrespondenceCutoff > 0 )
     {
-    /**
-     * do column normalization
-     */
-    columnSum = this->m_OutlierRow;
+    squaredRadius = -this->m_CurrentTemperature 
+      * vcl_log( this->m_CorrespondenceCutoff );
+    }
+
+  /**
+   * An infinite radius would keep every fixed point and make the sparse
+   * matrix dense, so the rows are then bounded by a nearest neighbor query.
+   */
+  unsigned int maximumNumberOfNeighbors = this->m_MaximumNumberOfNeighbors;
+  if ( maximumNumberOfNeighbors == 0 
+    && squaredRadius == NumericTraits<RealType>::max() )
+    {
+    maximumNumberOfNeighbors = this->m_NumberOfUnboundedNeighbors;
+    }
+  unsigned int numberOfNeighbors = vnl_math_min( maximumNumberOfNeighbors, 
+    static_cast<unsigned int>( this->GetInput( 0 )->GetNumberOfPoints() ) );
+
+  std::vector<std::pair<int, RealType> > entries;
+  vcl_vector<int> columns;
+  vcl_vector<RealType> values;
+  typename KdTreeType::InstanceIdentifierVectorType neighbors;
+
+  for ( unsigned long i = firstRow; i < lastRow; i++ )
+    {
+    typename InputPointSetType::PointType V;
+    this->m_VPoints->GetPoint( i, &V );    
 
-    for ( unsigned int j = 0; j < this->m_CorrespondenceMatrix.Cols(); j++ )
+    entries.clear();
+    if ( this->m_UseSparseCorrespondence )
       {
-      for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.Rows(); i++ )
+      MeasurementVectorType mv;
+      for ( unsigned int d = 0; d < Dimension; d++ )
         {
-        columnSum[j] += this->m_CorrespondenceMatrix( i, j );
+        mv[d] = V[d];
         }
-      } 
-    for ( unsigned int j = 0; j < this->m_CorrespondenceMatrix.Cols(); j++ )
-      {
-      for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.Rows(); i++ )
+
+      const KdTreeType *tree = this->m_KdTreeGenerators[threadId]->GetOutput();
+      if ( numberOfNeighbors > 0 )
         {
-        this->m_CorrespondenceMatrix( i, j ) /= columnSum[j];
+        tree->Search( mv, numberOfNeighbors, neighbors );
         }
-      this->m_OutlierRow[j] /= columnSum[j];
-      } 
-
-    /**
-     * do row normalization
-     */
-    rowSum = this->m_OutlierColumn;
+      else
+        {
+        tree->Search( mv, vcl_sqrt( squaredRadius ), neighbors );
+        }  
 
-    for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.Rows(); i++ )
-      {
-      for ( unsigned int j = 0; j < this->m_CorrespondenceMatrix.Cols(); j++ )
+      for ( unsigned int n = 0; n < neighbors.size(); n++ )
         {
-        rowSum[i] += this->m_CorrespondenceMatrix( i, j );
+        typename InputPointSetType::PointType X;      
+        this->GetInput( 0 )->GetPoint( neighbors[n], &X );      
+
+        RealType squaredDistance = ( X - V ).GetSquaredNorm();
+        if ( squaredDistance <= squaredRadius )
+          {
+          entries.push_back( std::make_pair( 
+            static_cast<int>( neighbors[n] ), squaredDistance ) );
+          }
         }
-      } 
-    for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.Rows(); i++ )
+      std::sort( entries.begin(), entries.end() );
+      }
+    else
       {
-      for ( unsigned int j = 0; j < this->m_CorrespondenceMatrix.Cols(); j++ )
+      for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ )
         {
-        this->m_CorrespondenceMatrix( i, j ) /= rowSum[i];
-        }
-      this->m_OutlierColumn[i] /= rowSum[i];
-      } 
-    
+        typename InputPointSetType::PointType X;      
+        this->GetInput( 0 )->GetPoint( j, &X );      
 
-    /**
-     * Calculate current deviation from 1
-     */
-    rowSum -= 1.0;
-    columnSum -= 1.0;
+        entries.push_back( std::make_pair( 
+          static_cast<int>( j ), ( X - V ).GetSquaredNorm() ) );
+        }  
+      }
 
-    deviation = ( rowSum.GetSquaredNorm() + columnSum.GetSquaredNorm() )
-      / ( static_cast<RealType>( rowSum.GetSize() + columnSum.GetSize() ) );
+    columns.resize( entries.size() );
+    values.resize( entries.size() );
+    for ( unsigned int n = 0; n < entries.size(); n++ )
+      {
+      columns[n] = entries[n].first;
+      values[n] = vcl_exp( -entries[n].second / this->m_CurrentTemperature );
+      }
+    this->m_CorrespondenceMatrix.set_row( i, columns, values );
     } 
-
 }
 
 template <class TPointSet, class TOutputImage>
@@ -402,13 +548,15 @@ ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
       { 
       typename PointSetType::PointType Y;
       Y.Fill( 0 );
-      for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ ) 
+      typename SparseMatrixType::row &rw = this->m_CorrespondenceMatrix.get_row( i );
+      typename SparseMatrixType::row::iterator ri;
+      for ( ri = rw.begin(); ri != rw.end(); ++ri ) 
         {
-        RealType m = this->m_CorrespondenceMatrix( i, j );
+        RealType m = (*ri).second;
         if ( m > 0 )
           {  
           typename InputPointSetType::PointType X;
-          this->GetInput( 0 )->GetPoint( j, &X );
+          this->GetInput( 0 )->GetPoint( (*ri).first, &X );
           for ( unsigned int d = 0; d < Dimension; d++ )
             {
             Y[d] += ( X[d] * m ); 
@@ -511,12 +659,14 @@ ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
     {
     typename InputPointSetType::PointType V;
     this->m_VPoints->GetPoint( i, &V );
-    for ( unsigned int j = 0; j < this->GetInput( 0 )->GetNumberOfPoints(); j++ )
+    typename SparseMatrixType::row &rw = this->m_CorrespondenceMatrix.get_row( i );
+    typename SparseMatrixType::row::iterator ri;
+    for ( ri = rw.begin(); ri != rw.end(); ++ri )
       {
-      if ( this->m_CorrespondenceMatrix( i, j ) > 1.0 / static_cast<RealType>( K ) )
+      if ( (*ri).second > 1.0 / static_cast<RealType>( K ) )
         {
         typename InputPointSetType::PointType X;
-        this->GetInput( 0 )->GetPoint( j, &X );
+        this->GetInput( 0 )->GetPoint( (*ri).first, &X );
         str3 << X[0] << " " << X[1] << " 0 " << i+1 << std::endl;      
         str3 << V[0] << " " << V[1] << " 0 " << i+1 << std::endl;   
         } 
@@ -528,11 +678,21 @@ ThinPlateSplineRobustPointMethodPointSetFilter<TPointSet, TOutputImage>
 
   std::ofstream str4( "CorrespondenceMatrix.txt" );
 
-  for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.Rows(); i++ )
+  for ( unsigned int i = 0; i < this->m_CorrespondenceMatrix.rows(); i++ )
     {
-    for ( unsigned int j = 0; j < this->m_CorrespondenceMatrix.Cols(); j++ )
+    typename SparseMatrixType::row &rw = this->m_CorrespondenceMatrix.get_row( i );
+    typename SparseMatrixType::row::iterator ri = rw.begin();
+    for ( unsigned int j = 0; j < this->m_CorrespondenceMatrix.cols(); j++ )
       {
-      str4 << this->m_CorrespondenceMatrix( i, j ) << " ";
+      if ( ri != rw.end() && static_cast<unsigned int>( (*ri).first ) == j )
+        {
+        str4 << (*ri).second << " ";
+        ++ri;
+        }
+      else
+        {
+        str4 << 0 << " ";
+        }
       } 
     str4 << std::endl;   
     } 
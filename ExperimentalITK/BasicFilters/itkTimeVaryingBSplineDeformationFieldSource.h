@@ -0,0 +1,181 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkTimeVaryingBSplineDeformationFieldSource.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTimeVaryingBSplineDeformationFieldSource_h
+#define __itkTimeVaryingBSplineDeformationFieldSource_h
+
+#include "itkImageSource.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class TimeVaryingBSplineDeformationFieldSource
+ * \brief Evaluates the deformation fields of a spatio-temporal B-spline
+ * control point lattice at several time points.
+ *
+ * The input lattice has one more dimension than the output, the last one
+ * being time.  Output n is the field at the n-th time point, sampled on the
+ * output grid like BSplineControlPointImageFilter does: the control points
+ * span the whole grid, and the temporal domain [TemporalOrigin, TemporalEnd]
+ * spans the temporal control points (cyclically if WrapTime is on).
+ *
+ * The temporal basis is collapsed first, once per time point, which leaves
+ * one spatial lattice per time point.  The spatial basis weights of each
+ * grid index are tabulated per dimension, and each image line is evaluated
+ * by reducing the lattices over the other dimensions to a single lattice
+ * line, so that the weights are shared by all the pixels of a line and by
+ * all the time points.
+ *
+ * Only the requested region of the outputs is evaluated, so that a
+ * downstream streaming filter can consume the fields tile by tile.
+ *
+ * \ingroup DataSources
+ */
+template <class TControlPointLattice, class TOutputImage>
+class ITK_EXPORT TimeVaryingBSplineDeformationFieldSource
+: public ImageSource<TOutputImage>
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef TimeVaryingBSplineDeformationFieldSource  Self;
+  typedef ImageSource<TOutputImage>                 Superclass;
+  typedef SmartPointer<Self>                        Pointer;
+  typedef SmartPointer<const Self>                  ConstPointer;
+
+  /** Output image typedefs */
+  typedef TOutputImage                              OutputImageType;
+  typedef typename OutputImageType::PixelType       PixelType;
+  typedef typename PixelType::ValueType             PixelValueType;
+  typedef typename OutputImageType::RegionType      RegionType;
+  typedef typename OutputImageType::SpacingType     SpacingType;
+  typedef typename OutputImageType::PointType       OriginType;
+  typedef typename OutputImageType::DirectionType   DirectionType;
+
+  typedef typename RegionType::SizeType             SizeType;
+  typedef typename RegionType::IndexType            IndexType;
+
+  typedef TControlPointLattice                      ControlPointLatticeType;
+
+  typedef double                                    RealType;
+  typedef std::vector<RealType>                     TimePointContainerType;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( TimeVaryingBSplineDeformationFieldSource, ImageSource );
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Dimensionality of the output image */
+  itkStaticConstMacro( ImageDimension, unsigned int,
+                       OutputImageType::ImageDimension );
+
+  /** Number of components of a pixel */
+  itkStaticConstMacro( VectorDimension, unsigned int,
+                       PixelType::Dimension );
+
+  /** Output image parameters */
+  itkSetMacro( Size, SizeType );
+  itkGetConstMacro( Size, SizeType );
+
+  itkSetMacro( Spacing, SpacingType );
+  itkGetConstMacro( Spacing, SpacingType );
+
+  itkSetMacro( Origin, OriginType );
+  itkGetConstMacro( Origin, OriginType );
+
+  itkSetMacro( Direction, DirectionType );
+  itkGetConstMacro( Direction, DirectionType );
+
+  /** Control points, the last dimension being time. */
+  itkSetConstObjectMacro( ControlPointLattice, ControlPointLatticeType );
+  itkGetConstObjectMacro( ControlPointLattice, ControlPointLatticeType );
+
+  /** Spline order of the spatial dimensions.  Default is 3. */
+  itkSetMacro( SplineOrder, unsigned int );
+  itkGetConstMacro( SplineOrder, unsigned int );
+
+  /** Spline order of the temporal dimension.  Default is 3. */
+  itkSetMacro( TemporalSplineOrder, unsigned int );
+  itkGetConstMacro( TemporalSplineOrder, unsigned int );
+
+  itkSetMacro( TemporalOrigin, RealType );
+  itkGetConstMacro( TemporalOrigin, RealType );
+
+  itkSetMacro( TemporalEnd, RealType );
+  itkGetConstMacro( TemporalEnd, RealType );
+
+  /** Whether the temporal dimension is closed.  Default is off. */
+  itkSetMacro( WrapTime, bool );
+  itkGetConstMacro( WrapTime, bool );
+  itkBooleanMacro( WrapTime );
+
+  /** The time points; there is one output per time point. */
+  void SetTimePoints( const TimePointContainerType & );
+  const TimePointContainerType & GetTimePoints() const
+    {
+    return this->m_TimePoints;
+    }
+
+protected:
+  TimeVaryingBSplineDeformationFieldSource();
+  ~TimeVaryingBSplineDeformationFieldSource() {}
+  void PrintSelf( std::ostream& os, Indent indent ) const;
+
+  virtual void GenerateOutputInformation();
+  void BeforeThreadedGenerateData();
+  void ThreadedGenerateData( const RegionType &, int );
+  void AfterThreadedGenerateData();
+
+private:
+  TimeVaryingBSplineDeformationFieldSource( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  /** Weights of the order + 1 control points of a span at u in [0, 1]. */
+  static void EvaluateBasis( RealType u, unsigned int order, RealType *weights );
+
+  SizeType                                          m_Size;
+  SpacingType                                       m_Spacing;
+  OriginType                                        m_Origin;
+  DirectionType                                     m_Direction;
+
+  typename ControlPointLatticeType::ConstPointer    m_ControlPointLattice;
+  unsigned int                                      m_SplineOrder;
+  unsigned int                                      m_TemporalSplineOrder;
+  RealType                                          m_TemporalOrigin;
+  RealType                                          m_TemporalEnd;
+  bool                                              m_WrapTime;
+  TimePointContainerType                            m_TimePoints;
+
+  /** State of the current update: the spatial lattice of each time point
+   * (components interleaved, first dimension fastest), and for each grid
+   * index of each dimension its first control point and their weights. */
+  std::vector<RealType>                             m_CollapsedLattices;
+  unsigned long                                     m_NumberOfLatticePoints;
+  unsigned long                                     m_LatticeStrides[ImageDimension];
+  std::vector<long>                                 m_FirstControlPoints[ImageDimension];
+  std::vector<RealType>                             m_BasisWeights[ImageDimension];
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTimeVaryingBSplineDeformationFieldSource.hxx"
+#endif
+
+#endif
@@ -0,0 +1,427 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkTimeVaryingBSplineDeformationFieldSource.hxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itkTimeVaryingBSplineDeformationFieldSource_hxx
+#define _itkTimeVaryingBSplineDeformationFieldSource_hxx
+
+#include "itkTimeVaryingBSplineDeformationFieldSource.h"
+
+#include "itkImageLinearIteratorWithIndex.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkProgressReporter.h"
+
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+template <class TControlPointLattice, class TOutputImage>
+TimeVaryingBSplineDeformationFieldSource<TControlPointLattice, TOutputImage>
+::TimeVaryingBSplineDeformationFieldSource()
+{
+  this->m_Size.Fill( 0 );
+  this->m_Spacing.Fill( 1.0 );
+  this->m_Origin.Fill( 0.0 );
+  this->m_Direction.SetIdentity();
+
+  this->m_ControlPointLattice = NULL;
+  this->m_SplineOrder = 3;
+  this->m_TemporalSplineOrder = 3;
+  this->m_TemporalOrigin = 0.0;
+  this->m_TemporalEnd = 1.0;
+  this->m_WrapTime = false;
+
+  this->m_NumberOfLatticePoints = 0;
+}
+
+template <class TControlPointLattice, class TOutputImage>
+void
+TimeVaryingBSplineDeformationFieldSource<TControlPointLattice, TOutputImage>
+::SetTimePoints( const TimePointContainerType &timePoints )
+{
+  if( timePoints == this->m_TimePoints )
+    {
+    return;
+    }
+  this->m_TimePoints = timePoints;
+
+  const unsigned int numberOfOutputs = vnl_math_max(
+    static_cast<unsigned int>( timePoints.size() ), 1u );
+  const unsigned int numberOfExistingOutputs = this->GetNumberOfOutputs();
+  this->SetNumberOfOutputs( numberOfOutputs );
+  this->SetNumberOfRequiredOutputs( numberOfOutputs );
+  for( unsigned int n = numberOfExistingOutputs; n < numberOfOutputs; n++ )
+    {
+    this->SetNthOutput( n, this->MakeOutput( n ) );
+    }
+  this->Modified();
+}
+
+template <class TControlPointLattice, class TOutputImage>
+void
+TimeVaryingBSplineDeformationFieldSource<TControlPointLattice, TOutputImage>
+::GenerateOutputInformation()
+{
+  IndexType index;
+  index.Fill( 0 );
+
+  RegionType largestPossibleRegion;
+  largestPossibleRegion.SetSize( this->m_Size );
+  largestPossibleRegion.SetIndex( index );
+
+  for( unsigned int n = 0; n < this->GetNumberOfOutputs(); n++ )
+    {
+    OutputImageType *output = this->GetOutput( n );
+    if( !output )
+      {
+      continue;
+      }
+    output->SetLargestPossibleRegion( largestPossibleRegion );
+    output->SetSpacing( this->m_Spacing );
+    output->SetOrigin( this->m_Origin );
+    output->SetDirection( this->m_Direction );
+    }
+}
+
+template <class TControlPointLattice, class TOutputImage>
+void
+TimeVaryingBSplineDeformationFieldSource<TControlPointLattice, TOutputImage>
+::BeforeThreadedGenerateData()
+{
+  if( !this->m_ControlPointLattice )
+    {
+    itkExceptionMacro( "The control point lattice is not set." );
+    }
+  if( this->m_TimePoints.empty() )
+    {
+    itkExceptionMacro( "The time points are not set." );
+    }
+  if( this->m_TemporalEnd <= this->m_TemporalOrigin )
+    {
+    itkExceptionMacro( "The temporal end must be greater than the temporal origin." );
+    }
+
+  typedef typename ControlPointLatticeType::RegionType LatticeRegionType;
+  const LatticeRegionType latticeRegion =
+    this->m_ControlPointLattice->GetLargestPossibleRegion();
+
+  // Spatial lattice layout and number of spans of each dimension
+  long numberOfSpans[ImageDimension];
+  this->m_NumberOfLatticePoints = 1;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    this->m_LatticeStrides[d] = this->m_NumberOfLatticePoints;
+    this->m_NumberOfLatticePoints *= latticeRegion.GetSize()[d];
+    numberOfSpans[d] = static_cast<long>( latticeRegion.GetSize()[d] )
+      - static_cast<long>( this->m_SplineOrder );
+    if( numberOfSpans[d] < 1 )
+      {
+      itkExceptionMacro( "The lattice has " << latticeRegion.GetSize()[d]
+        << " control points in dimension " << d << ", at least "
+        << this->m_SplineOrder + 1 << " are needed." );
+      }
+    }
+
+  const long numberOfTemporalControlPoints =
+    static_cast<long>( latticeRegion.GetSize()[ImageDimension] );
+  long numberOfTemporalSpans = numberOfTemporalControlPoints;
+  if( !this->m_WrapTime )
+    {
+    numberOfTemporalSpans -= this->m_TemporalSplineOrder;
+    }
+  if( numberOfTemporalSpans < 1 )
+    {
+    itkExceptionMacro( "The lattice has " << numberOfTemporalControlPoints
+      << " temporal control points, at least "
+      << this->m_TemporalSplineOrder + 1 << " are needed." );
+    }
+
+  // Weight of each temporal slice of the lattice for each time point
+  const unsigned int numberOfTimePoints = this->m_TimePoints.size();
+  std::vector<RealType> sliceWeights( numberOfTimePoints * numberOfTemporalControlPoints, 0.0 );
+  std::vector<RealType> weights( this->m_TemporalSplineOrder + 1 );
+  for( unsigned int n = 0; n < numberOfTimePoints; n++ )
+    {
+    RealType u = ( this->m_TimePoints[n] - this->m_TemporalOrigin )
+      / ( this->m_TemporalEnd - this->m_TemporalOrigin )
+      * static_cast<RealType>( numberOfTemporalSpans );
+    long span;
+    if( this->m_WrapTime )
+      {
+      u -= vcl_floor( u / numberOfTemporalSpans ) * numberOfTemporalSpans;
+      span = static_cast<long>( vcl_floor( u ) );
+      }
+    else
+      {
+      u = vnl_math_max( 0.0, vnl_math_min( u,
+        static_cast<RealType>( numberOfTemporalSpans ) ) );
+      span = vnl_math_min( static_cast<long>( vcl_floor( u ) ),
+        numberOfTemporalSpans - 1 );
+      }
+    EvaluateBasis( u - span, this->m_TemporalSplineOrder, &weights[0] );
+    for( unsigned int k = 0; k <= this->m_TemporalSplineOrder; k++ )
+      {
+      const long slice = ( span + k ) % numberOfTemporalControlPoints;
+      sliceWeights[n * numberOfTemporalControlPoints + slice] += weights[k];
+      }
+    }
+
+  // Collapse the temporal dimension in one pass over the lattice.
+  this->m_CollapsedLattices.assign(
+    numberOfTimePoints * this->m_NumberOfLatticePoints * VectorDimension, 0.0 );
+
+  ImageRegionConstIteratorWithIndex<ControlPointLatticeType> ItL(
+    this->m_ControlPointLattice, latticeRegion );
+  for( ItL.GoToBegin(); !ItL.IsAtEnd(); ++ItL )
+    {
+    const typename ControlPointLatticeType::IndexType index = ItL.GetIndex();
+    unsigned long offset = 0;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      offset += ( index[d] - latticeRegion.GetIndex()[d] ) * this->m_LatticeStrides[d];
+      }
+    const long slice = index[ImageDimension] - latticeRegion.GetIndex()[ImageDimension];
+    const typename ControlPointLatticeType::PixelType value = ItL.Get();
+
+    for( unsigned int n = 0; n < numberOfTimePoints; n++ )
+      {
+      const RealType weight = sliceWeights[n * numberOfTemporalControlPoints + slice];
+      if( weight != 0.0 )
+        {
+        RealType *collapsed = &this->m_CollapsedLattices[
+          ( n * this->m_NumberOfLatticePoints + offset ) * VectorDimension];
+        for( unsigned int c = 0; c < VectorDimension; c++ )
+          {
+          collapsed[c] += weight * value[c];
+          }
+        }
+      }
+    }
+
+  // The grid indices 0 and size - 1 map to the ends of the spatial domain.
+  const unsigned int K = this->m_SplineOrder + 1;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    const unsigned long size = this->m_Size[d];
+    this->m_FirstControlPoints[d].resize( size );
+    this->m_BasisWeights[d].resize( size * K );
+    for( unsigned long i = 0; i < size; i++ )
+      {
+      RealType u = 0.0;
+      if( size > 1 )
+        {
+        u = static_cast<RealType>( numberOfSpans[d] ) * i
+          / static_cast<RealType>( size - 1 );
+        }
+      const long span = vnl_math_min( static_cast<long>( vcl_floor( u ) ),
+        numberOfSpans[d] - 1 );
+      this->m_FirstControlPoints[d][i] = span;
+      EvaluateBasis( u - span, this->m_SplineOrder, &this->m_BasisWeights[d][i * K] );
+      }
+    }
+}
+
+template <class TControlPointLattice, class TOutputImage>
+void
+TimeVaryingBSplineDeformationFieldSource<TControlPointLattice, TOutputImage>
+::ThreadedGenerateData( const RegionType &region, int threadId )
+{
+  const unsigned long lineLength = region.GetSize()[0];
+  if( lineLength == 0 )
+    {
+    return;
+    }
+
+  ProgressReporter progress( this, threadId,
+    region.GetNumberOfPixels() / lineLength );
+
+  const unsigned int numberOfTimePoints = this->m_TimePoints.size();
+  const unsigned int K = this->m_SplineOrder + 1;
+
+  // Control points of the first dimension used by the lines of the region
+  const long lineBegin = region.GetIndex()[0];
+  const long firstControlPoint = this->m_FirstControlPoints[0][lineBegin];
+  const unsigned long lineLatticeLength = K - firstControlPoint
+    + this->m_FirstControlPoints[0][lineBegin + lineLength - 1];
+  const unsigned long lineLatticeSize = lineLatticeLength * VectorDimension;
+
+  std::vector<RealType> lineLattices( numberOfTimePoints * lineLatticeSize );
+
+  typedef ImageLinearIteratorWithIndex<OutputImageType> IteratorType;
+  std::vector<IteratorType> Its;
+  for( unsigned int n = 0; n < numberOfTimePoints; n++ )
+    {
+    IteratorType It( this->GetOutput( n ), region );
+    It.SetDirection( 0 );
+    It.GoToBegin();
+    Its.push_back( It );
+    }
+
+  while( !Its[0].IsAtEnd() )
+    {
+    const IndexType lineIndex = Its[0].GetIndex();
+
+    // Reduce the lattices over the other dimensions, visiting their
+    // K^(ImageDimension-1) control points with an odometer.
+    std::fill( lineLattices.begin(), lineLattices.end(), 0.0 );
+
+    unsigned int k[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      k[d] = 0;
+      }
+    while( true )
+      {
+      RealType weight = 1.0;
+      unsigned long offset = firstControlPoint;
+      for( unsigned int d = 1; d < ImageDimension; d++ )
+        {
+        weight *= this->m_BasisWeights[d][lineIndex[d] * K + k[d]];
+        offset += ( this->m_FirstControlPoints[d][lineIndex[d]] + k[d] )
+          * this->m_LatticeStrides[d];
+        }
+      if( weight != 0.0 )
+        {
+        for( unsigned int n = 0; n < numberOfTimePoints; n++ )
+          {
+          const RealType *collapsed = &this->m_CollapsedLattices[
+            ( n * this->m_NumberOfLatticePoints + offset ) * VectorDimension];
+          RealType *lineLattice = &lineLattices[n * lineLatticeSize];
+          for( unsigned long c = 0; c < lineLatticeSize; c++ )
+            {
+            lineLattice[c] += weight * collapsed[c];
+            }
+          }
+        }
+
+      unsigned int d = 1;
+      while( d < ImageDimension && ++k[d] == K )
+        {
+        k[d] = 0;
+        d++;
+        }
+      if( d >= ImageDimension )
+        {
+        break;
+        }
+      }
+
+    // Evaluate the line from the reduced lattices.
+    for( unsigned long i = 0; i < lineLength; i++ )
+      {
+      const long index = lineBegin + i;
+      const RealType *weights = &this->m_BasisWeights[0][index * K];
+      const unsigned long first =
+        ( this->m_FirstControlPoints[0][index] - firstControlPoint ) * VectorDimension;
+
+      for( unsigned int n = 0; n < numberOfTimePoints; n++ )
+        {
+        const RealType *lineLattice = &lineLattices[n * lineLatticeSize + first];
+        RealType value[VectorDimension];
+        for( unsigned int c = 0; c < VectorDimension; c++ )
+          {
+          value[c] = 0.0;
+          }
+        for( unsigned int j = 0; j < K; j++ )
+          {
+          for( unsigned int c = 0; c < VectorDimension; c++ )
+            {
+            value[c] += weights[j] * lineLattice[j * VectorDimension + c];
+            }
+          }
+
+        PixelType pixel;
+        for( unsigned int c = 0; c < VectorDimension; c++ )
+          {
+          pixel[c] = static_cast<PixelValueType>( value[c] );
+          }
+        Its[n].Set( pixel );
+        ++Its[n];
+        }
+      }
+
+    for( unsigned int n = 0; n < numberOfTimePoints; n++ )
+      {
+      Its[n].NextLine();
+      }
+    progress.CompletedPixel();
+    }
+}
+
+template <class TControlPointLattice, class TOutputImage>
+void
+TimeVaryingBSplineDeformationFieldSource<TControlPointLattice, TOutputImage>
+::AfterThreadedGenerateData()
+{
+  std::vector<RealType>().swap( this->m_CollapsedLattices );
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    std::vector<long>().swap( this->m_FirstControlPoints[d] );
+    std::vector<RealType>().swap( this->m_BasisWeights[d] );
+    }
+}
+
+template <class TControlPointLattice, class TOutputImage>
+void
+TimeVaryingBSplineDeformationFieldSource<TControlPointLattice, TOutputImage>
+::EvaluateBasis( RealType u, unsigned int order, RealType *weights )
+{
+  // Cox-de Boor recursion on uniform knots
+  weights[0] = 1.0;
+  for( unsigned int k = 1; k <= order; k++ )
+    {
+    for( unsigned int j = k + 1; j-- > 0; )
+      {
+      RealType value = 0.0;
+      if( j > 0 )
+        {
+        value += ( u + k - j ) * weights[j - 1];
+        }
+      if( j < k )
+        {
+        value += ( j + 1 - u ) * weights[j];
+        }
+      weights[j] = value / k;
+      }
+    }
+}
+
+template <class TControlPointLattice, class TOutputImage>
+void
+TimeVaryingBSplineDeformationFieldSource<TControlPointLattice, TOutputImage>
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Size: " << this->m_Size << std::endl;
+  os << indent << "Origin: " << this->m_Origin << std::endl;
+  os << indent << "Spacing: " << this->m_Spacing << std::endl;
+  os << indent << "Direction: " << this->m_Direction << std::endl;
+  os << indent << "Spline order: " << this->m_SplineOrder << std::endl;
+  os << indent << "Temporal spline order: "
+    << this->m_TemporalSplineOrder << std::endl;
+  os << indent << "Temporal origin: " << this->m_TemporalOrigin << std::endl;
+  os << indent << "Temporal end: " << this->m_TemporalEnd << std::endl;
+  os << indent << "Wrap time: " << this->m_WrapTime << std::endl;
+  os << indent << "Number of time points: "
+    << this->m_TimePoints.size() << std::endl;
+}
+
+} // end namespace itk
+
+#endif
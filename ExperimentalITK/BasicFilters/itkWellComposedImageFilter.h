@@ -6,6 +6,7 @@
 #include "itkNeighborhoodIterator.h"
 
 #include <deque>
+#include <vector>
 
 /** \class WellComposedImageFilter
  *  This filter transforms a multilabeled image to its well-composed analog.
@@ -18,6 +19,18 @@
  *  \par Parameters
  *  The user specifies the number of labels in addition to the input.
  *
+ *  \par Implementation
+ *  In 3-D the critical configurations of all the labels are located in one
+ *  multi-threaded pass over the 2x2x2 cells.  They are then removed from
+ *  the highest label down, and each change only queues the cells around the
+ *  modified voxel.  A large worklist is split into slabs along the last
+ *  axis.  The cells whose repair stays inside their slab are processed in
+ *  parallel, and the cells on the slab boundaries are processed serially
+ *  afterwards.  In 2-D only the labels present in the 3x3 neighborhood of
+ *  a pixel are examined.  When a repair has several candidate voxels, the
+ *  choice is a hash of the cell index, so the output does not depend on a
+ *  random seed.
+ *
  *  \cite
  * Marcelo Siqueira and Longin Jan Latecki and Jean Gallier,
  * "Making 3D Binary Digital Images Well-Composed",
@@ -60,6 +73,9 @@ public:
   /** Image typedef support. */
   typedef typename ImageType::PixelType          PixelType;
   typedef typename ImageType::IndexType          IndexType;
+  typedef typename ImageType::OffsetType         OffsetType;
+  typedef typename OffsetType::OffsetValueType   OffsetValueType;
+  typedef typename ImageType::RegionType         RegionType;
   typedef std::deque<IndexType>                  IndexContainerType;
   typedef std::deque<IndexContainerType>         MultipleIndexContainerType; 
   typedef NeighborhoodIterator<ImageType>        NeighborhoodIteratorType;
@@ -92,16 +108,35 @@ private:
   unsigned long                   m_TotalNumberOfLabels;
   MultipleIndexContainerType      m_CriticalConfigurationIndices;
 
+  /** 3^ImageDimension neighborhood of a pixel, as index offsets and as
+   * offsets into the output buffer.  Outside the image the nearest pixel
+   * is used. */
+  void InitializeNeighborhoodOffsets();
+  void GetNeighborhood( const IndexType &, PixelType * );
+  unsigned int ChooseIndex( const IndexType &, unsigned int ) const;
+
+  OffsetType                      m_NeighborhoodOffsets[27];
+  OffsetValueType                 m_NeighborhoodBufferOffsets[27];
+
+  /** Multi-threading support */
+  struct ThreadStruct
+    {
+    Self *Filter;
+    };
+
+  enum { MinimumNumberOfConfigurationsPerThread = 256 };
+  enum { MinimumSlabThickness = 8 };
+
   /**
    * Functions/data for the 2-D case
    */
   void MakeImageWellComposed2D();
   void InitializeIndices2D();
   bool IsChangeSafe2D( PixelType, IndexType );
-  bool IsCriticalC1Configuration2D( Array<char> );
-  bool IsCriticalC2Configuration2D( Array<char> );
-  bool IsCriticalC3Configuration2D( Array<char> );
-  bool IsCriticalC4Configuration2D( Array<char> );
+  bool IsCriticalC1Configuration2D( const Array<char> & );
+  bool IsCriticalC2Configuration2D( const Array<char> & );
+  bool IsCriticalC3Configuration2D( const Array<char> & );
+  bool IsCriticalC4Configuration2D( const Array<char> & );
   bool IsSpecialCaseOfC4Configuration2D( PixelType, IndexType, 
                                          IndexType, IndexType );
 
@@ -114,20 +149,44 @@ private:
    */
   void MakeImageWellComposed3D();
   void InitializeIndices3D();
-  void LocateCriticalConfigurations3D( PixelType );
-  void InsertCriticalConfiguration3D( PixelType, IndexType );  
-  bool IsCriticalC1Configuration3D( Array<PixelType> );
-  unsigned int IsCriticalC2Configuration3D( Array<PixelType> );
+  void LocateCriticalConfigurations3D();
+  void ThreadedLocateCriticalConfigurations3D( const RegionType &,
+                                               MultipleIndexContainerType & );
+  void InsertCriticalConfiguration3D( PixelType, IndexType,
+                                      MultipleIndexContainerType & );
+  bool IsCellInside3D( const IndexType & );
   bool IsChangeSafe3D( PixelType, IndexType );
-  void RemoveCriticalC1Configuration3D( int, PixelType, IndexType );
-  void RemoveCriticalC2Configuration3D( int, PixelType, IndexType );
+  void RemoveCriticalConfiguration3D( PixelType, IndexType,
+                                      MultipleIndexContainerType & );
+  void RemoveCriticalC1Configuration3D( int, PixelType, IndexType,
+                                        MultipleIndexContainerType & );
+  void RemoveCriticalC2Configuration3D( int, PixelType, IndexType,
+                                        MultipleIndexContainerType & );
+
+  /** Removes the configurations of a label whose repair stays inside one
+   * slab in parallel, and leaves the others on the worklist. */
+  void RemoveCriticalConfigurationsInSlabs3D( PixelType );
+  void ThreadedRemoveCriticalConfigurations3D( unsigned int );
+  bool IsInsideSlab3D( const IndexType &, unsigned int ) const;
+
+  enum ThreadedStepType { LocateStep, RemoveStep };
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback3D( void * );
+
+  ThreadedStepType                         m_ThreadedStep;
+  PixelType                                m_SlabLabel;
+  std::vector<OffsetValueType>             m_SlabBoundaries;
+  std::vector<IndexContainerType>          m_SlabWorkLists;
+  std::vector<MultipleIndexContainerType>  m_ThreadCriticalConfigurationIndices;
 
   /**
    * Debugging utilities
    */
   void CountCriticalConfigurations3D();
-  bool IsCriticalC1Configuration3D( Array<char> );
-  unsigned int IsCriticalC2Configuration3D( Array<char> );
+  bool IsCriticalC1Configuration3D( const Array<char> & );
+  unsigned int IsCriticalC2Configuration3D( const Array<char> & );
+  bool IsCriticalC1Configuration3D( const Array<PixelType> & );
+  unsigned int IsCriticalC2Configuration3D( const Array<PixelType> & );
 
 
   Array<unsigned int>             m_C1Indices[12];
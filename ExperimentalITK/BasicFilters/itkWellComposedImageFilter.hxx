@@ -2,9 +2,12 @@
 #define __itkWellComposedImageFilter_hxx
 
 #include "itkWellComposedImageFilter.h"
-#include "itkMersenneTwisterRandomVariateGenerator.h"
 #include "itkConstantPadImageFilter.h"
 #include "itkExtractImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionSplitter.h"
+
+#include <algorithm>
 
 namespace itk
 {
@@ -60,6 +63,7 @@ WellComposedImageFilter<TImage>
   padder->Update();
 
   this->GraftOutput( padder->GetOutput() );
+  this->InitializeNeighborhoodOffsets();
 
   if ( ImageDimension == 2 )
     {
@@ -84,6 +88,92 @@ WellComposedImageFilter<TImage>
   this->GraftOutput( cropper->GetOutput() );
 }
 
+template<class TImage>
+void
+WellComposedImageFilter<TImage>
+::InitializeNeighborhoodOffsets()
+{
+  const OffsetValueType *offsetTable = this->GetOutput()->GetOffsetTable();
+
+  unsigned int numberOfNeighbors = 1;
+  for ( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    numberOfNeighbors *= 3;
+    }
+  for ( unsigned int n = 0; n < numberOfNeighbors; n++ )
+    {
+    unsigned int m = n;
+    this->m_NeighborhoodBufferOffsets[n] = 0;
+    for ( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      this->m_NeighborhoodOffsets[n][d] = static_cast<OffsetValueType>( m % 3 ) - 1;
+      this->m_NeighborhoodBufferOffsets[n] +=
+        this->m_NeighborhoodOffsets[n][d] * offsetTable[d];
+      m /= 3;
+      }
+    }
+}
+
+template<class TImage>
+void
+WellComposedImageFilter<TImage>
+::GetNeighborhood( const IndexType &idx, PixelType *neighborhood )
+{
+  const ImageType *output = this->GetOutput();
+  const RegionType region = output->GetBufferedRegion();
+
+  unsigned int numberOfNeighbors = 1;
+  bool isInterior = true;
+  for ( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    numberOfNeighbors *= 3;
+    if ( idx[d] <= region.GetIndex()[d] || idx[d] + 1 >= region.GetIndex()[d] +
+         static_cast<OffsetValueType>( region.GetSize()[d] ) )
+      {
+      isInterior = false;
+      }
+    }
+
+  if ( isInterior )
+    {
+    const PixelType *pixel =
+      output->GetBufferPointer() + output->ComputeOffset( idx );
+    for ( unsigned int n = 0; n < numberOfNeighbors; n++ )
+      {
+      neighborhood[n] = pixel[this->m_NeighborhoodBufferOffsets[n]];
+      }
+    }
+  else
+    {
+    // zero flux Neumann boundary, as with a neighborhood iterator
+    for ( unsigned int n = 0; n < numberOfNeighbors; n++ )
+      {
+      IndexType neighborIndex = idx + this->m_NeighborhoodOffsets[n];
+      for ( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        neighborIndex[d] = vnl_math_max( neighborIndex[d], region.GetIndex()[d] );
+        neighborIndex[d] = vnl_math_min( neighborIndex[d], region.GetIndex()[d] +
+          static_cast<OffsetValueType>( region.GetSize()[d] ) - 1 );
+        }
+      neighborhood[n] = output->GetPixel( neighborIndex );
+      }
+    }
+}
+
+template<class TImage>
+unsigned int
+WellComposedImageFilter<TImage>
+::ChooseIndex( const IndexType &idx, unsigned int numberOfCandidates ) const
+{
+  unsigned long hash = 0;
+  for ( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    hash = hash * 2654435761UL + static_cast<unsigned long>( idx[d] );
+    }
+  hash ^= ( hash >> 16 );
+  return static_cast<unsigned int>( hash % numberOfCandidates );
+}
+
 /*
  * 2-D
  */
@@ -116,6 +206,27 @@ WellComposedImageFilter<TImage>
     while ( currentLabel <
       static_cast<PixelType>( this->m_TotalNumberOfLabels ) )
       {
+      // Every configuration has the label at pixels 1 and 3, so only the
+      // labels of the neighborhood need to be examined.
+      bool isLabelInNeighborhood = false;
+      PixelType nextLabel = currentLabel;
+      for ( unsigned int n = 0; n < 9; n++ )
+        {
+        const PixelType pixel = It.GetPixel( n );
+        if ( pixel >= currentLabel &&
+             ( !isLabelInNeighborhood || pixel < nextLabel ) )
+          {
+          nextLabel = pixel;
+          isLabelInNeighborhood = true;
+          }
+        }
+      if ( !isLabelInNeighborhood || nextLabel >=
+           static_cast<PixelType>( this->m_TotalNumberOfLabels ) )
+        {
+        break;
+        }
+      currentLabel = nextLabel;
+
       // Check for critical configurations: 4 90-degree rotations
       for ( unsigned int i = 0; i < 4; i++ )
         {
@@ -396,18 +507,15 @@ WellComposedImageFilter<TImage>
 {
   Array<char> neighborhoodPixels( 9 );
 
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType It( radius, this->GetOutput(),
-        this->GetOutput()->GetLargestPossibleRegion() );
-  It.SetLocation( idx );
+  PixelType neighborhood[9];
+  this->GetNeighborhood( idx, neighborhood );
 
   for ( unsigned int i = 0; i < 4; i++ )
     {
     for ( unsigned int j = 0; j < 9; j++ )
       {
       neighborhoodPixels[j] =
-        ( It.GetPixel( this->m_RotationIndices[i][j] ) == label );
+        ( neighborhood[this->m_RotationIndices[i][j]] == label );
       if ( this->m_RotationIndices[i][j] == 4 )
         {
         neighborhoodPixels[j] = !neighborhoodPixels[j];
@@ -427,7 +535,7 @@ WellComposedImageFilter<TImage>
     for ( unsigned int j = 0; j < 9; j++ )
       {
       neighborhoodPixels[j] =
-        ( It.GetPixel( this->m_ReflectionIndices[i][j] ) == label );
+        ( neighborhood[this->m_ReflectionIndices[i][j]] == label );
       if ( this->m_ReflectionIndices[i][j] == 4 )
         {
         neighborhoodPixels[j] = !neighborhoodPixels[j];
@@ -448,7 +556,7 @@ WellComposedImageFilter<TImage>
 template<class TImage>
 bool
 WellComposedImageFilter<TImage>
-::IsCriticalC1Configuration2D( Array<char> neighborhood )
+::IsCriticalC1Configuration2D( const Array<char> &neighborhood )
 {
   return ( !neighborhood[0] &&  neighborhood[1] &&
             neighborhood[3] && !neighborhood[4] &&
@@ -461,7 +569,7 @@ WellComposedImageFilter<TImage>
 template<class TImage>
 bool
 WellComposedImageFilter<TImage>
-::IsCriticalC2Configuration2D( Array<char> neighborhood )
+::IsCriticalC2Configuration2D( const Array<char> &neighborhood )
 {
   return ( !neighborhood[0] &&  neighborhood[1] &&
             neighborhood[3] && !neighborhood[4] &&
@@ -475,7 +583,7 @@ WellComposedImageFilter<TImage>
 template<class TImage>
 bool
 WellComposedImageFilter<TImage>
-::IsCriticalC3Configuration2D( Array<char> neighborhood )
+::IsCriticalC3Configuration2D( const Array<char> &neighborhood )
 {
   return ( !neighborhood[0] &&  neighborhood[1] &&
             neighborhood[3] && !neighborhood[4] &&
@@ -489,7 +597,7 @@ WellComposedImageFilter<TImage>
 template<class TImage>
 bool
 WellComposedImageFilter<TImage>
-::IsCriticalC4Configuration2D( Array<char> neighborhood )
+::IsCriticalC4Configuration2D( const Array<char> &neighborhood )
 {
   return ( !neighborhood[0] &&  neighborhood[1] &&
             neighborhood[3] && !neighborhood[4] &&
@@ -614,24 +722,14 @@ WellComposedImageFilter<TImage>
   /**
    * Find critical configurations for all the labels
    */
-  this->m_CriticalConfigurationIndices.resize( this->m_TotalNumberOfLabels );
-  for ( int i = this->m_TotalNumberOfLabels-1; i >= 0; i-- )
-    {
-    this->LocateCriticalConfigurations3D( static_cast<PixelType>( i ) );
-    }
-
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType It( radius, this->GetOutput(),
-    this->GetOutput()->GetLargestPossibleRegion() );
+  this->LocateCriticalConfigurations3D();
 
   /**
-   * Remove critical configurations
+   * Remove critical configurations, highest label first.  A repair only
+   * queues the cells around the modified voxel.
    */
-  bool foundCriticalConfiguration = true;
-  while ( foundCriticalConfiguration )
+  while ( true )
     {
-    foundCriticalConfiguration = false;
     int label;
     for ( label = this->m_TotalNumberOfLabels-1; label >= 0; label-- )
       {
@@ -646,52 +744,214 @@ WellComposedImageFilter<TImage>
       }
     itkDebugMacro( << "Removing the " << this->m_CriticalConfigurationIndices[label].size()
                    << " critical configurations of label " << label );
-    while ( !this->m_CriticalConfigurationIndices[label].empty() )
+
+    this->RemoveCriticalConfigurationsInSlabs3D( static_cast<PixelType>( label ) );
+
+    // What is left are the cells on the slab boundaries (or all of them
+    // for a small worklist).
+    IndexContainerType &workList = this->m_CriticalConfigurationIndices[label];
+    while ( !workList.empty() )
+      {
+      IndexType idx = workList.front();
+      workList.pop_front();
+      this->RemoveCriticalConfiguration3D( static_cast<PixelType>( label ),
+        idx, this->m_CriticalConfigurationIndices );
+      }
+    }
+  if ( this->GetDebug() )
+    {
+    this->CountCriticalConfigurations3D();
+    }
+}
+
+/*
+ * 3-D
+ */
+template<class TImage>
+void
+WellComposedImageFilter<TImage>
+::LocateCriticalConfigurations3D()
+{
+  this->m_CriticalConfigurationIndices.clear();
+  this->m_CriticalConfigurationIndices.resize( this->m_TotalNumberOfLabels );
+
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+  const unsigned int numberOfThreads =
+    this->GetMultiThreader()->GetNumberOfThreads();
+
+  this->m_ThreadCriticalConfigurationIndices.assign( numberOfThreads,
+    MultipleIndexContainerType( this->m_TotalNumberOfLabels ) );
+  this->m_ThreadedStep = LocateStep;
+
+  ThreadStruct str;
+  str.Filter = this;
+  this->GetMultiThreader()->SetSingleMethod( this->ThreaderCallback3D, &str );
+  this->GetMultiThreader()->SingleMethodExecute();
+
+  // The threads split the image along the last axis, so appending their
+  // lists in order gives the cells in scan order.
+  for ( unsigned int n = 0; n < numberOfThreads; n++ )
+    {
+    for ( unsigned long i = 0; i < this->m_TotalNumberOfLabels; i++ )
       {
-      foundCriticalConfiguration = true;
+      IndexContainerType &indices = this->m_ThreadCriticalConfigurationIndices[n][i];
+      this->m_CriticalConfigurationIndices[i].insert(
+        this->m_CriticalConfigurationIndices[i].end(),
+        indices.begin(), indices.end() );
+      }
+    }
+  this->m_ThreadCriticalConfigurationIndices.clear();
+
+  for ( unsigned long i = 0; i < this->m_TotalNumberOfLabels; i++ )
+    {
+    itkDebugMacro( << "Label " << i << ": "
+                   << this->m_CriticalConfigurationIndices[i].size()
+                   << " critical configurations." );
+    }
+}
+
+/*
+ * 3-D
+ */
+template<class TImage>
+ITK_THREAD_RETURN_TYPE
+WellComposedImageFilter<TImage>
+::ThreaderCallback3D( void *arg )
+{
+  unsigned int threadId =
+    ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount =
+    ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
 
-      It.SetLocation( this->m_CriticalConfigurationIndices[label].front() );
-      this->m_CriticalConfigurationIndices[label].pop_front();
+  ThreadStruct *str = (ThreadStruct *)
+    ( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+  Self *filter = str->Filter;
+
+  if ( filter->m_ThreadedStep == LocateStep )
+    {
+    // Cells whose 3x3x3 neighborhood is inside the image
+    RegionType region = filter->GetOutput()->GetBufferedRegion();
+    typename RegionType::IndexType index = region.GetIndex();
+    typename RegionType::SizeType size = region.GetSize();
+    for ( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      if ( size[d] < 3 )
+        {
+        return ITK_THREAD_RETURN_VALUE;
+        }
+      index[d] += 1;
+      size[d] -= 2;
+      }
+    region.SetIndex( index );
+    region.SetSize( size );
+
+    typedef ImageRegionSplitter<ImageDimension> SplitterType;
+    typename SplitterType::Pointer splitter = SplitterType::New();
+    unsigned int total = splitter->GetNumberOfSplits( region, threadCount );
+    if ( threadId < total )
+      {
+      region = splitter->GetSplit( threadId, total, region );
+      filter->ThreadedLocateCriticalConfigurations3D( region,
+        filter->m_ThreadCriticalConfigurationIndices[threadId] );
+      }
+    }
+  else
+    {
+    if ( threadId < filter->m_SlabWorkLists.size() )
+      {
+      filter->ThreadedRemoveCriticalConfigurations3D( threadId );
+      }
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+/*
+ * 3-D
+ */
+template<class TImage>
+void
+WellComposedImageFilter<TImage>
+::ThreadedLocateCriticalConfigurations3D( const RegionType &region,
+  MultipleIndexContainerType &criticalConfigurationIndices )
+{
+  Array<char> neighborhoodPixels( 8 );
+  PixelType cellPixels[8];
+
+  ImageRegionConstIterator<ImageType> It( this->GetOutput(), region );
+  for ( It.GoToBegin(); !It.IsAtEnd(); ++It )
+    {
+    const PixelType *pixel = &It.Value();
+    for ( unsigned int j = 0; j < 8; j++ )
+      {
+      cellPixels[j] = pixel[this->m_NeighborhoodBufferOffsets[this->m_C2Indices[0][j]]];
+      }
+
+    // Only the labels of the cell can have a critical configuration in it.
+    for ( unsigned int k = 0; k < 8; k++ )
+      {
+      const PixelType label = cellPixels[k];
+      bool isFirstOccurrence = true;
+      for ( unsigned int l = 0; l < k; l++ )
+        {
+        if ( cellPixels[l] == label )
+          {
+          isFirstOccurrence = false;
+          break;
+          }
+        }
+      if ( !isFirstOccurrence ||
+           static_cast<unsigned long>( label ) >= this->m_TotalNumberOfLabels )
+        {
+        continue;
+        }
 
-      Array<char> neighborhoodPixels( 8 );
-      bool removedCriticalConfiguration = false;
       /**
-       * Deal with the C1 configurations
+       * Check for C1 critical configurations
        */
-      for ( unsigned int i = 0; i < 3; i++ )
+      bool isCritical = false;
+      for ( unsigned int i = 0; i < 3 && !isCritical; i++ )
         {
         for ( unsigned int j = 0; j < 4; j++ )
           {
-          neighborhoodPixels[j] = ( It.GetPixel( this->m_C1Indices[i][j] ) == label );
-          }
-        if ( this->IsCriticalC1Configuration3D( neighborhoodPixels ) )
-          {
-          this->RemoveCriticalC1Configuration3D( i, label, It.GetIndex() );
-          removedCriticalConfiguration = true;
+          neighborhoodPixels[j] = ( pixel[
+            this->m_NeighborhoodBufferOffsets[this->m_C1Indices[i][j]]] == label );
           }
+        isCritical = this->IsCriticalC1Configuration3D( neighborhoodPixels );
         }
 
       /**
-       * Deal with the C2 configurations
+       * Check for C2 critical configurations
        */
-      if ( !removedCriticalConfiguration )
+      if ( !isCritical )
         {
         for ( unsigned int j = 0; j < 8; j++ )
           {
-          neighborhoodPixels[j]
-            = ( It.GetPixel( this->m_C2Indices[0][j] ) == label );
-          }
-        if ( this->IsCriticalC2Configuration3D( neighborhoodPixels ) )
-          {
-          this->RemoveCriticalC2Configuration3D( 0, label, It.GetIndex() );
+          neighborhoodPixels[j] = ( cellPixels[j] == label );
           }
+        isCritical = ( this->IsCriticalC2Configuration3D( neighborhoodPixels ) > 0 );
+        }
+
+      if ( isCritical )
+        {
+        criticalConfigurationIndices[label].push_back( It.GetIndex() );
         }
       }
     }
-  if ( this->GetDebug() )
-    {
-    this->CountCriticalConfigurations3D();
-    }
+}
+
+/*
+ * 3-D
+ */
+template<class TImage>
+bool
+WellComposedImageFilter<TImage>
+::IsInsideSlab3D( const IndexType &idx, unsigned int slab ) const
+{
+  // The repair of the cell at idx reads the voxels idx-1 to idx+2.
+  const OffsetValueType z = idx[ImageDimension-1];
+  return ( z - 1 >= this->m_SlabBoundaries[slab] &&
+           z + 2 < this->m_SlabBoundaries[slab+1] );
 }
 
 /*
@@ -700,120 +960,221 @@ WellComposedImageFilter<TImage>
 template<class TImage>
 void
 WellComposedImageFilter<TImage>
-::LocateCriticalConfigurations3D( PixelType label )
+::RemoveCriticalConfigurationsInSlabs3D( PixelType label )
 {
-  this->m_CriticalConfigurationIndices[label].clear();
+  IndexContainerType &workList = this->m_CriticalConfigurationIndices[label];
+
+  const RegionType region = this->GetOutput()->GetBufferedRegion();
+  const OffsetValueType start = region.GetIndex()[ImageDimension-1];
+  const unsigned long size = region.GetSize()[ImageDimension-1];
+
+  unsigned long numberOfSlabs = this->GetNumberOfThreads();
+  numberOfSlabs = vnl_math_min( numberOfSlabs,
+    size / static_cast<unsigned long>( MinimumSlabThickness ) );
+  numberOfSlabs = vnl_math_min( numberOfSlabs, static_cast<unsigned long>(
+    workList.size() / MinimumNumberOfConfigurationsPerThread ) );
+  if ( numberOfSlabs < 2 )
+    {
+    return;
+    }
 
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType It( radius, this->GetOutput(),
-    this->GetOutput()->GetLargestPossibleRegion() );
+  this->m_SlabBoundaries.resize( numberOfSlabs + 1 );
+  for ( unsigned long s = 0; s <= numberOfSlabs; s++ )
+    {
+    this->m_SlabBoundaries[s] = start +
+      static_cast<OffsetValueType>( ( size * s ) / numberOfSlabs );
+    }
 
-  Array<char> neighborhoodPixels( 8 );
+  // Each slab takes the cells it can repair without reading another slab;
+  // the others stay on the worklist.
+  this->m_SlabWorkLists.assign( numberOfSlabs, IndexContainerType() );
+  IndexContainerType boundaryIndices;
+  typename IndexContainerType::const_iterator it;
+  for ( it = workList.begin(); it != workList.end(); ++it )
+    {
+    const unsigned int slab = vnl_math_min( numberOfSlabs - 1,
+      static_cast<unsigned long>( std::upper_bound( this->m_SlabBoundaries.begin(),
+      this->m_SlabBoundaries.end(), (*it)[ImageDimension-1] )
+      - this->m_SlabBoundaries.begin() - 1 ) );
+    if ( this->IsInsideSlab3D( *it, slab ) )
+      {
+      this->m_SlabWorkLists[slab].push_back( *it );
+      }
+    else
+      {
+      boundaryIndices.push_back( *it );
+      }
+    }
+  workList.swap( boundaryIndices );
 
-  int countC1 = 0;
-  int countC2 = 0;
+  this->m_ThreadCriticalConfigurationIndices.assign( numberOfSlabs,
+    MultipleIndexContainerType( this->m_TotalNumberOfLabels ) );
+  this->m_SlabLabel = label;
+  this->m_ThreadedStep = RemoveStep;
 
-  for ( It.GoToBegin(); !It.IsAtEnd(); ++It )
+  this->GetMultiThreader()->SetNumberOfThreads( numberOfSlabs );
+  ThreadStruct str;
+  str.Filter = this;
+  this->GetMultiThreader()->SetSingleMethod( this->ThreaderCallback3D, &str );
+  this->GetMultiThreader()->SingleMethodExecute();
+
+  for ( unsigned long s = 0; s < numberOfSlabs; s++ )
     {
-    if ( !It.InBounds() )
+    for ( unsigned long i = 0; i < this->m_TotalNumberOfLabels; i++ )
       {
-      continue;
+      IndexContainerType &indices = this->m_ThreadCriticalConfigurationIndices[s][i];
+      this->m_CriticalConfigurationIndices[i].insert(
+        this->m_CriticalConfigurationIndices[i].end(),
+        indices.begin(), indices.end() );
       }
+    }
+  this->m_ThreadCriticalConfigurationIndices.clear();
+  this->m_SlabWorkLists.clear();
+}
 
-    /**
-     * Check for C1 critical configurations
-     */
-    bool foundC1 = false;
-    for ( unsigned int i = 0; i < 3; i++ )
+/*
+ * 3-D
+ */
+template<class TImage>
+void
+WellComposedImageFilter<TImage>
+::ThreadedRemoveCriticalConfigurations3D( unsigned int slab )
+{
+  const PixelType label = this->m_SlabLabel;
+  IndexContainerType &workList = this->m_SlabWorkLists[slab];
+  MultipleIndexContainerType &criticalConfigurationIndices =
+    this->m_ThreadCriticalConfigurationIndices[slab];
+
+  IndexContainerType boundaryIndices;
+  while ( !workList.empty() )
+    {
+    IndexType idx = workList.front();
+    workList.pop_front();
+    this->RemoveCriticalConfiguration3D( label, idx,
+      criticalConfigurationIndices );
+
+    // New cells of this label are repaired here if they are inside the
+    // slab; the other labels wait for their turn.
+    IndexContainerType &newIndices = criticalConfigurationIndices[label];
+    while ( !newIndices.empty() )
       {
-      for ( unsigned int j = 0; j < 4; j++ )
+      if ( this->IsInsideSlab3D( newIndices.front(), slab ) )
         {
-        neighborhoodPixels[j] = ( It.GetPixel( this->m_C1Indices[i][j] ) == label );
+        workList.push_back( newIndices.front() );
         }
-      if ( this->IsCriticalC1Configuration3D( neighborhoodPixels ) )
+      else
         {
-        foundC1 = true;
-        countC1++;
+        boundaryIndices.push_back( newIndices.front() );
         }
+      newIndices.pop_front();
+      }
+    }
+  criticalConfigurationIndices[label].swap( boundaryIndices );
+}
+
+/*
+ * 3-D
+ */
+template<class TImage>
+void
+WellComposedImageFilter<TImage>
+::RemoveCriticalConfiguration3D( PixelType label, IndexType idx,
+  MultipleIndexContainerType &criticalConfigurationIndices )
+{
+  PixelType neighborhood[27];
+  this->GetNeighborhood( idx, neighborhood );
+
+  Array<char> neighborhoodPixels( 8 );
+  bool removedCriticalConfiguration = false;
+  /**
+   * Deal with the C1 configurations
+   */
+  for ( unsigned int i = 0; i < 3; i++ )
+    {
+    for ( unsigned int j = 0; j < 4; j++ )
+      {
+      neighborhoodPixels[j] = ( neighborhood[this->m_C1Indices[i][j]] == label );
       }
-    if ( foundC1 )
+    if ( this->IsCriticalC1Configuration3D( neighborhoodPixels ) )
       {
-      this->m_CriticalConfigurationIndices[label].push_back( It.GetIndex() );
+      this->RemoveCriticalC1Configuration3D( i, label, idx,
+        criticalConfigurationIndices );
+      this->GetNeighborhood( idx, neighborhood );
+      removedCriticalConfiguration = true;
       }
+    }
 
-    /**
-     * Check for C2 critical configurations
-     */
-    else
+  /**
+   * Deal with the C2 configurations
+   */
+  if ( !removedCriticalConfiguration )
+    {
+    for ( unsigned int j = 0; j < 8; j++ )
       {
-      for ( unsigned int j = 0; j < 8; j++ )
-        {
-        neighborhoodPixels[j] = ( It.GetPixel( this->m_C2Indices[0][j] ) == label );
-        }
-      if ( this->IsCriticalC2Configuration3D( neighborhoodPixels ) )
-        {
-        this->m_CriticalConfigurationIndices[label].push_back( It.GetIndex() );
-        countC2++;
-        }
+      neighborhoodPixels[j] = ( neighborhood[this->m_C2Indices[0][j]] == label );
+      }
+    if ( this->IsCriticalC2Configuration3D( neighborhoodPixels ) )
+      {
+      this->RemoveCriticalC2Configuration3D( 0, label, idx,
+        criticalConfigurationIndices );
       }
     }
-  itkDebugMacro( << "Label " << label << ": " << countC1 << " C1 and " << countC2
-                 << " C2 critical configurations." );
 }
 
 template<class TImage>
 void
 WellComposedImageFilter<TImage>
-::RemoveCriticalC1Configuration3D( int which, PixelType label, IndexType idx )
+::RemoveCriticalC1Configuration3D( int which, PixelType label, IndexType idx,
+  MultipleIndexContainerType &criticalConfigurationIndices )
 {
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType It( radius, this->GetOutput(),
-    this->GetOutput()->GetLargestPossibleRegion() );
-  It.SetLocation( idx );
+  PixelType neighborhood[27];
+  this->GetNeighborhood( idx, neighborhood );
+
+  PixelType pixels[4];
+  IndexType pixelIndices[4];
+  for ( unsigned int j = 0; j < 4; j++ )
+    {
+    pixels[j] = neighborhood[this->m_C1Indices[which][j]];
+    pixelIndices[j] = idx + this->m_NeighborhoodOffsets[this->m_C1Indices[which][j]];
+    }
 
   IndexContainerType indices;
   PixelType newLabel = label;
 
-  if ( It.GetPixel( this->m_C1Indices[which][0] ) == label )
+  if ( pixels[0] == label )
     {
-    if ( It.GetPixel( this->m_C1Indices[which][2] ) < label  )
+    if ( pixels[2] < label  )
       {
-      indices.push_back( It.GetIndex( this->m_C1Indices[which][2] ) );
+      indices.push_back( pixelIndices[2] );
       }
-    if ( It.GetPixel( this->m_C1Indices[which][3] ) < label  )
+    if ( pixels[3] < label  )
       {
-      indices.push_back( It.GetIndex( this->m_C1Indices[which][3] ) );
+      indices.push_back( pixelIndices[3] );
       }
 
     if ( indices.empty() )
       {
-      newLabel = vnl_math_max(
-        It.GetPixel( this->m_C1Indices[which][2] ),
-        It.GetPixel( this->m_C1Indices[which][3] ) );
-      indices.push_back( It.GetIndex( this->m_C1Indices[which][0] ) );
-      indices.push_back( It.GetIndex( this->m_C1Indices[which][1] ) );
+      newLabel = vnl_math_max( pixels[2], pixels[3] );
+      indices.push_back( pixelIndices[0] );
+      indices.push_back( pixelIndices[1] );
       }
     }
   else
     {
-    if ( It.GetPixel( this->m_C1Indices[which][0] ) < label  )
+    if ( pixels[0] < label  )
       {
-      indices.push_back( It.GetIndex( this->m_C1Indices[which][0] ) );
+      indices.push_back( pixelIndices[0] );
       }
-    if ( It.GetPixel( this->m_C1Indices[which][1] ) < label  )
+    if ( pixels[1] < label  )
       {
-      indices.push_back( It.GetIndex( this->m_C1Indices[which][1] ) );
+      indices.push_back( pixelIndices[1] );
       }
 
     if ( indices.empty() )
       {
-      newLabel = vnl_math_max(
-        It.GetPixel( this->m_C1Indices[which][0] ),
-        It.GetPixel( this->m_C1Indices[which][1] ) );
-      indices.push_back( It.GetIndex( this->m_C1Indices[which][2] ) );
-      indices.push_back( It.GetIndex( this->m_C1Indices[which][3] ) );
+      newLabel = vnl_math_max( pixels[0], pixels[1] );
+      indices.push_back( pixelIndices[2] );
+      indices.push_back( pixelIndices[3] );
       }
     }
 
@@ -826,37 +1187,38 @@ WellComposedImageFilter<TImage>
       unsafeIndices.push_back( *it );
       }
     }
-  typedef typename Statistics
-     ::MersenneTwisterRandomVariateGenerator GeneratorType;
-  typename GeneratorType::Pointer generator = GeneratorType::New();
-  generator->SetSeed();
 
   if ( !unsafeIndices.empty() )
     {
-    int n = generator->GetIntegerVariate( unsafeIndices.size()-1 );
+    int n = this->ChooseIndex( idx, unsafeIndices.size() );
     if ( newLabel == label )
       {
       this->InsertCriticalConfiguration3D(
-        this->GetOutput()->GetPixel( unsafeIndices[n] ), unsafeIndices[n] );
+        this->GetOutput()->GetPixel( unsafeIndices[n] ), unsafeIndices[n],
+        criticalConfigurationIndices );
       }
     else
       {
-      this->InsertCriticalConfiguration3D( newLabel, unsafeIndices[n] );
+      this->InsertCriticalConfiguration3D( newLabel, unsafeIndices[n],
+        criticalConfigurationIndices );
       }
     this->GetOutput()->SetPixel( unsafeIndices[n], newLabel );
     }
   else
     {
-    int n = generator->GetIntegerVariate( indices.size()-1 );
-    this->InsertCriticalConfiguration3D( label, indices[n] );
+    int n = this->ChooseIndex( idx, indices.size() );
+    this->InsertCriticalConfiguration3D( label, indices[n],
+      criticalConfigurationIndices );
     if ( newLabel == label )
       {
       this->InsertCriticalConfiguration3D(
-        this->GetOutput()->GetPixel( indices[n] ), indices[n] );
+        this->GetOutput()->GetPixel( indices[n] ), indices[n],
+        criticalConfigurationIndices );
       }
     else
       {
-      this->InsertCriticalConfiguration3D( newLabel, indices[n] );
+      this->InsertCriticalConfiguration3D( newLabel, indices[n],
+        criticalConfigurationIndices );
       }
     this->GetOutput()->SetPixel( indices[n], newLabel );
     }
@@ -865,22 +1227,20 @@ WellComposedImageFilter<TImage>
 template<class TImage>
 void
 WellComposedImageFilter<TImage>
-::RemoveCriticalC2Configuration3D( int which, PixelType label, IndexType idx )
+::RemoveCriticalC2Configuration3D( int which, PixelType label, IndexType idx,
+  MultipleIndexContainerType &criticalConfigurationIndices )
 {
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType It( radius, this->GetOutput(),
-    this->GetOutput()->GetLargestPossibleRegion() );
-  It.SetLocation( idx );
+  PixelType neighborhood[27];
+  this->GetNeighborhood( idx, neighborhood );
 
   PixelType newLabel = label;
 
   IndexContainerType indices;
   for ( unsigned int i = 0; i < 8; i++ )
     {
-    if ( It.GetPixel( this->m_C2Indices[which][i] ) < label )
+    if ( neighborhood[this->m_C2Indices[which][i]] < label )
       {
-      indices.push_back( It.GetIndex( this->m_C2Indices[which][i] ) );
+      indices.push_back( idx + this->m_NeighborhoodOffsets[this->m_C2Indices[which][i]] );
       }
     }
 
@@ -889,10 +1249,10 @@ WellComposedImageFilter<TImage>
     newLabel = NumericTraits<PixelType>::Zero;
     for ( unsigned int i = 0; i < 8; i++ )
       {
-      PixelType pix = It.GetPixel( this->m_C2Indices[which][i] );
+      PixelType pix = neighborhood[this->m_C2Indices[which][i]];
       if ( pix == label )
         {
-        indices.push_back( It.GetIndex( this->m_C2Indices[which][i] ) );
+        indices.push_back( idx + this->m_NeighborhoodOffsets[this->m_C2Indices[which][i]] );
         }
       else if ( pix > newLabel )
         {
@@ -910,37 +1270,38 @@ WellComposedImageFilter<TImage>
       unsafeIndices.push_back( *it );
       }
     }
-  typedef typename Statistics
-     ::MersenneTwisterRandomVariateGenerator GeneratorType;
-  typename GeneratorType::Pointer generator = GeneratorType::New();
-  generator->SetSeed();
 
   if ( !unsafeIndices.empty() )
     {
-    int n = generator->GetIntegerVariate( unsafeIndices.size()-1 );
+    int n = this->ChooseIndex( idx, unsafeIndices.size() );
     if ( newLabel == label )
       {
       this->InsertCriticalConfiguration3D(
-        this->GetOutput()->GetPixel( unsafeIndices[n] ), unsafeIndices[n] );
+        this->GetOutput()->GetPixel( unsafeIndices[n] ), unsafeIndices[n],
+        criticalConfigurationIndices );
       }
     else
       {
-      this->InsertCriticalConfiguration3D( newLabel, unsafeIndices[n] );
+      this->InsertCriticalConfiguration3D( newLabel, unsafeIndices[n],
+        criticalConfigurationIndices );
       }
     this->GetOutput()->SetPixel( unsafeIndices[n], newLabel );
     }
   else
     {
-    int n = generator->GetIntegerVariate( indices.size()-1 );
-    this->InsertCriticalConfiguration3D( label, indices[n] );
+    int n = this->ChooseIndex( idx, indices.size() );
+    this->InsertCriticalConfiguration3D( label, indices[n],
+      criticalConfigurationIndices );
     if ( newLabel == label )
       {
       this->InsertCriticalConfiguration3D(
-        this->GetOutput()->GetPixel( indices[n] ), indices[n] );
+        this->GetOutput()->GetPixel( indices[n] ), indices[n],
+        criticalConfigurationIndices );
       }
     else
       {
-      this->InsertCriticalConfiguration3D( newLabel, indices[n] );
+      this->InsertCriticalConfiguration3D( newLabel, indices[n],
+        criticalConfigurationIndices );
       }
     this->GetOutput()->SetPixel( indices[n], newLabel );
     }
@@ -956,18 +1317,15 @@ WellComposedImageFilter<TImage>
 {
   Array<char> neighborhoodPixels( 8 );
 
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType It( radius, this->GetOutput(),
-        this->GetOutput()->GetLargestPossibleRegion() );
-  It.SetLocation( idx );
+  PixelType neighborhood[27];
+  this->GetNeighborhood( idx, neighborhood );
 
   // Check for C1 critical configurations
   for ( unsigned int i = 0; i < 12; i++ )
     {
     for ( unsigned int j = 0; j < 4; j++ )
       {
-      neighborhoodPixels[j] = ( It.GetPixel( this->m_C1Indices[i][j] ) == label );
+      neighborhoodPixels[j] = ( neighborhood[this->m_C1Indices[i][j]] == label );
       if ( this->m_C1Indices[i][j] == 13 )
         {
         neighborhoodPixels[j] = !neighborhoodPixels[j];
@@ -984,7 +1342,7 @@ WellComposedImageFilter<TImage>
     {
     for ( unsigned int j = 0; j < 8; j++ )
       {
-      neighborhoodPixels[j] = ( It.GetPixel( this->m_C2Indices[i][j] ) == label );
+      neighborhoodPixels[j] = ( neighborhood[this->m_C2Indices[i][j]] == label );
       if ( this->m_C2Indices[i][j] == 13 )
         {
         neighborhoodPixels[j] = !neighborhoodPixels[j];
@@ -998,29 +1356,51 @@ WellComposedImageFilter<TImage>
   return true;
 }
 
+/*
+ * 3-D
+ */
+template<class TImage>
+bool
+WellComposedImageFilter<TImage>
+::IsCellInside3D( const IndexType &idx )
+{
+  const RegionType region = this->GetOutput()->GetBufferedRegion();
+  for ( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    if ( idx[d] < region.GetIndex()[d] || idx[d] + 1 >= region.GetIndex()[d] +
+         static_cast<OffsetValueType>( region.GetSize()[d] ) )
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
 /*
  * 3-D
  */
 template<class TImage>
 void
 WellComposedImageFilter<TImage>
-::InsertCriticalConfiguration3D( PixelType label,
-                                 IndexType idx )
+::InsertCriticalConfiguration3D( PixelType label, IndexType idx,
+  MultipleIndexContainerType &criticalConfigurationIndices )
 {
+  if ( static_cast<unsigned long>( label ) >= criticalConfigurationIndices.size() )
+    {
+    return;
+    }
+
   Array<char> neighborhoodPixels( 8 );
 
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType It( radius, this->GetOutput(),
-        this->GetOutput()->GetLargestPossibleRegion() );
-  It.SetLocation( idx );
+  PixelType neighborhood[27];
+  this->GetNeighborhood( idx, neighborhood );
 
   // C1 configurations
   for ( unsigned int i = 0; i < 12; i++ )
     {
     for ( unsigned int j = 0; j < 4; j++ )
       {
-      neighborhoodPixels[j] = ( It.GetPixel( this->m_C1Indices[i][j] ) == label );
+      neighborhoodPixels[j] = ( neighborhood[this->m_C1Indices[i][j]] == label );
       if ( this->m_C1Indices[i][j] == 13 )
         {
         neighborhoodPixels[j] = !neighborhoodPixels[j];
@@ -1028,8 +1408,11 @@ WellComposedImageFilter<TImage>
       }
     if ( this->IsCriticalC1Configuration3D( neighborhoodPixels ) )
       {
-      this->m_CriticalConfigurationIndices[label].push_back(
-        It.GetIndex( this->m_C1Indices[i][0] ) );
+      IndexType cellIndex = idx + this->m_NeighborhoodOffsets[this->m_C1Indices[i][0]];
+      if ( this->IsCellInside3D( cellIndex ) )
+        {
+        criticalConfigurationIndices[label].push_back( cellIndex );
+        }
       }
     }
 
@@ -1038,7 +1421,7 @@ WellComposedImageFilter<TImage>
     {
     for ( unsigned int j = 0; j < 8; j++ )
       {
-      neighborhoodPixels[j] = ( It.GetPixel( this->m_C2Indices[i][j] ) == label );
+      neighborhoodPixels[j] = ( neighborhood[this->m_C2Indices[i][j]] == label );
       if ( this->m_C2Indices[i][j] == 13 )
         {
         neighborhoodPixels[j] = !neighborhoodPixels[j];
@@ -1046,8 +1429,11 @@ WellComposedImageFilter<TImage>
       }
     if ( this->IsCriticalC2Configuration3D( neighborhoodPixels ) )
       {
-      this->m_CriticalConfigurationIndices[label].push_back(
-        It.GetIndex( this->m_C2Indices[i][0] ) );
+      IndexType cellIndex = idx + this->m_NeighborhoodOffsets[this->m_C2Indices[i][0]];
+      if ( this->IsCellInside3D( cellIndex ) )
+        {
+        criticalConfigurationIndices[label].push_back( cellIndex );
+        }
       }
     }
 }
@@ -1058,7 +1444,7 @@ WellComposedImageFilter<TImage>
 template<class TImage>
 bool
 WellComposedImageFilter<TImage>
-::IsCriticalC1Configuration3D( Array<char> neighborhood )
+::IsCriticalC1Configuration3D( const Array<char> &neighborhood )
 {
   return ( (  neighborhood[0] &&  neighborhood[1] &&
              !neighborhood[2] && !neighborhood[3] ) ||
@@ -1072,7 +1458,7 @@ WellComposedImageFilter<TImage>
 template<class TImage>
 unsigned int
 WellComposedImageFilter<TImage>
-::IsCriticalC2Configuration3D( Array<char> neighborhood )
+::IsCriticalC2Configuration3D( const Array<char> &neighborhood )
 {
   // Check if Type 1 or Type 2
   for ( unsigned int i = 0; i < 4; i++ )
@@ -1227,7 +1613,7 @@ WellComposedImageFilter<TImage>
 template<class TImage>
 bool
 WellComposedImageFilter<TImage>
-::IsCriticalC1Configuration3D( Array<PixelType> neighborhood )
+::IsCriticalC1Configuration3D( const Array<PixelType> &neighborhood )
 {
   return ( ( ( neighborhood[1] == neighborhood[0] ) &&
              ( neighborhood[2] != neighborhood[0] ) &&
@@ -1243,7 +1629,7 @@ WellComposedImageFilter<TImage>
 template<class TImage>
 unsigned int
 WellComposedImageFilter<TImage>
-::IsCriticalC2Configuration3D( Array<PixelType> neighborhood )
+::IsCriticalC2Configuration3D( const Array<PixelType> &neighborhood )
 {
   // Check for Subtype 1 of C.C. Type 2
   if ( ( ( neighborhood[0] == neighborhood[1] ) && ( neighborhood[0] != neighborhood[2] ) &&
@@ -18,6 +18,7 @@
 #define __itkDenseFiniteDifferenceImageFilter_h_
 
 #include "itkFiniteDifferenceImageFilter.h"
+#include "itkImageRegionBrickSplitter.h"
 #include "itkMultiThreader.h"
 
 namespace itk {
@@ -59,6 +60,13 @@ namespace itk {
  * it does not define the stopping criteria (Halt method).  To use this class,
  * subclass it to a specific instance that supplies a function and Halt()
  * method.
+ *
+ * \par Curve ordered traversal
+ * With UseCurveOrderedTraversalOn(), the change is calculated brick by
+ * brick, the bricks being ordered along a Hilbert curve and each thread
+ * taking one segment of the curve instead of a slab.  This keeps the
+ * neighborhoods of consecutive pixels in cache when the function has a
+ * large radius.  See ImageRegionBrickSplitter.
  * 
  * \ingroup ImageFilters
  * \sa FiniteDifferenceImageFilter */
@@ -95,10 +103,30 @@ public:
 
   /** The container type for the update buffer. */
   typedef OutputImageType UpdateBufferType;
+
+  typedef ImageRegionBrickSplitter<
+    itkGetStaticConstMacro(ImageDimension)> BrickSplitterType;
+  typedef typename BrickSplitterType::SizeType BrickSizeType;
+
+  /** Calculate the change brick by brick along a Hilbert curve.  Default
+   * is off. */
+  itkSetMacro(UseCurveOrderedTraversal, bool);
+  itkGetConstMacro(UseCurveOrderedTraversal, bool);
+  itkBooleanMacro(UseCurveOrderedTraversal);
+
+  /** Brick size of the curve ordered traversal.  Default is the one of
+   * ImageRegionBrickSplitter. */
+  itkSetMacro(BrickSize, BrickSizeType);
+  itkGetConstMacro(BrickSize, BrickSizeType);
   
 protected:
   DenseFiniteDifferenceImageFilter()
-    { m_UpdateBuffer = UpdateBufferType::New(); }
+    {
+    m_UpdateBuffer = UpdateBufferType::New();
+    m_UseCurveOrderedTraversal = false;
+    m_BrickSplitter = BrickSplitterType::New();
+    m_BrickSize = m_BrickSplitter->GetBrickSize();
+    }
   ~DenseFiniteDifferenceImageFilter() {}
   void PrintSelf(std::ostream& os, Indent indent) const;
 
@@ -180,8 +208,18 @@ private:
                                        int threadId);
   // FOR ALL : iterator(input, splitRegion), iterator(update, splitRegion)
 
+  /** Calls ThreadedCalculateChange() on each brick of segment i of n of
+   * the curve and returns the smallest time step. */
+  TimeStepType ThreadedCalculateChangeOverCurveSegment(unsigned int i,
+                                                       unsigned int n,
+                                                       int threadId);
+
   /** The buffer that holds the updates for an iteration of the algorithm. */
   typename UpdateBufferType::Pointer m_UpdateBuffer;
+
+  bool                                  m_UseCurveOrderedTraversal;
+  BrickSizeType                         m_BrickSize;
+  typename BrickSplitterType::Pointer   m_BrickSplitter;
 };
   
 
@@ -23,6 +23,7 @@
 #include "itkImageRegionIterator.h"
 #include "itkNumericTraits.h"
 #include "itkNeighborhoodAlgorithm.h"
+#include "vnl/vnl_math.h"
 
 namespace itk {
 
@@ -138,6 +139,20 @@ DenseFiniteDifferenceImageFilter<TInputImage, TOutputImage>
   this->GetMultiThreader()->SetSingleMethod(this->CalculateChangeThreaderCallback,
                                             &str);
 
+  // The bricks along the curve only change with the requested region.
+  if ( m_UseCurveOrderedTraversal )
+    {
+    const ThreadRegionType region = this->GetOutput()->GetRequestedRegion();
+    if ( m_BrickSplitter->GetRegion() != region ||
+         m_BrickSplitter->GetBrickSize() != m_BrickSize ||
+         m_BrickSplitter->GetNumberOfBricks() == 0 )
+      {
+      m_BrickSplitter->SetRegion(region);
+      m_BrickSplitter->SetBrickSize(m_BrickSize);
+      m_BrickSplitter->Initialize();
+      }
+    }
+
   // Initialize the list of time step values that will be generated by the
   // various threads.  There is one distinct slot for each possible thread,
   // so this data structure is thread-safe.
@@ -179,7 +194,15 @@ DenseFiniteDifferenceImageFilter<TInputImage, TOutputImage>
   total = str->Filter->SplitRequestedRegion(threadId, threadCount,
                                             splitRegion);
 
-  if (threadId < total)
+  if (threadId < total && str->Filter->m_UseCurveOrderedTraversal)
+    {
+    // One segment of the curve per thread that would get a slab
+    str->TimeStepList[threadId]
+      = str->Filter->ThreadedCalculateChangeOverCurveSegment(threadId, total,
+                                                             threadId);
+    str->ValidTimeStepList[threadId] = true;
+    }
+  else if (threadId < total)
     { 
     str->TimeStepList[threadId]
       = str->Filter->ThreadedCalculateChange(splitRegion, threadId);
@@ -291,6 +314,26 @@ DenseFiniteDifferenceImageFilter<TInputImage, TOutputImage>
   return timeStep;
 }
 
+template <class TInputImage, class TOutputImage>
+typename
+DenseFiniteDifferenceImageFilter<TInputImage, TOutputImage>::TimeStepType
+DenseFiniteDifferenceImageFilter<TInputImage, TOutputImage>
+::ThreadedCalculateChangeOverCurveSegment(unsigned int i, unsigned int n,
+                                          int threadId)
+{
+  unsigned long first, last;
+  m_BrickSplitter->GetSegment(i, n, first, last);
+
+  // The time steps are resolved as the smallest one, as between threads.
+  TimeStepType timeStep = NumericTraits<TimeStepType>::max();
+  for (unsigned long b = first; b < last; ++b)
+    {
+    timeStep = vnl_math_min(timeStep,
+      this->ThreadedCalculateChange(m_BrickSplitter->GetBrick(b), threadId));
+    }
+  return timeStep;
+}
+
 template <class TInputImage, class TOutputImage>
 void
 DenseFiniteDifferenceImageFilter<TInputImage, TOutputImage>
@@ -298,7 +341,9 @@ DenseFiniteDifferenceImageFilter<TInputImage, TOutputImage>
 {
   Superclass::PrintSelf(os, indent);
 
-  
+  os << indent << "UseCurveOrderedTraversal: "
+     << m_UseCurveOrderedTraversal << std::endl;
+  os << indent << "BrickSize: " << m_BrickSize << std::endl;
 }
 
 }// end namespace itk
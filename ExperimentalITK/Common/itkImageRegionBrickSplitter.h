@@ -0,0 +1,151 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkImageRegionBrickSplitter.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkImageRegionBrickSplitter_h
+#define __itkImageRegionBrickSplitter_h
+
+#include "itkObject.h"
+#include "itkImageRegion.h"
+#include "itkObjectFactory.h"
+
+#include "vxl_config.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class ImageRegionBrickSplitter
+ * \brief Splits an image region into bricks ordered along a space-filling
+ * curve.
+ *
+ * Filters that evaluate large neighborhoods at every pixel walk the image
+ * in raster order, so that in 3-D the neighborhoods of consecutive pixels
+ * span 2r+1 whole slices, which do not fit in cache for large images.
+ * Visiting the image brick by brick instead (raster order inside a brick)
+ * keeps the working set to about (b+2r)^ImageDimension pixels for a brick
+ * size b, and ordering the bricks along a Hilbert (or Morton) curve makes
+ * consecutive bricks neighbors, so most of the halo of the next brick is
+ * already in cache.  The image buffer itself keeps its raster layout.
+ *
+ * The curve also gives the partition of the region between threads:
+ * GetSegment() returns a contiguous run of bricks along the curve, with
+ * about the same number of pixels in each segment.  A filter threaded by
+ * ImageSource can use it from ThreadedGenerateData() by processing the
+ * segment threadId of the requested region instead of the region it is
+ * given, the number of segments being the number of pieces returned by
+ * SplitRequestedRegion().
+ *
+ * The default brick size is the largest power of two with at most 4096
+ * pixels per brick (64x64 in 2-D, 16x16x16 in 3-D).  The bricks at the
+ * upper end of the region are cropped.
+ *
+ * \sa ImageRegionCurveConstIteratorWithIndex
+ */
+template <unsigned int VImageDimension>
+class ITK_EXPORT ImageRegionBrickSplitter : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef ImageRegionBrickSplitter                 Self;
+  typedef Object                                   Superclass;
+  typedef SmartPointer<Self>                       Pointer;
+  typedef SmartPointer<const Self>                 ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImageRegionBrickSplitter, Object );
+
+  itkStaticConstMacro( ImageDimension, unsigned int, VImageDimension );
+
+  typedef ImageRegion<VImageDimension>             RegionType;
+  typedef typename RegionType::IndexType           IndexType;
+  typedef typename RegionType::SizeType            SizeType;
+
+  typedef vxl_uint_64                              KeyType;
+
+  /** Order of the bricks. */
+  typedef enum { RasterCurve, MortonCurve, HilbertCurve } CurveType;
+
+  itkSetMacro( Region, RegionType );
+  itkGetConstReferenceMacro( Region, RegionType );
+
+  itkSetMacro( BrickSize, SizeType );
+  itkGetConstReferenceMacro( BrickSize, SizeType );
+
+  /** Default is HilbertCurve. */
+  itkSetMacro( Curve, CurveType );
+  itkGetConstMacro( Curve, CurveType );
+
+  /** Split the region into bricks and sort them along the curve. */
+  void Initialize();
+
+  unsigned long GetNumberOfBricks() const
+    {
+    return this->m_BrickOrder.size();
+    }
+
+  /** Brick n along the curve. */
+  RegionType GetBrick( unsigned long n ) const;
+
+  /** The bricks [first, last) of segment i of n along the curve. */
+  void GetSegment( unsigned int i, unsigned int n,
+    unsigned long &first, unsigned long &last ) const;
+
+  /** Position along the Hilbert curve of order numberOfBits of the point
+   * x (VImageDimension coordinates less than 2^numberOfBits).
+   * VImageDimension * numberOfBits must be at most 64. */
+  static KeyType ComputeHilbertKey( const unsigned long *x,
+    unsigned int numberOfBits );
+
+  /** Position along the Morton (Z-order) curve, with the same
+   * constraints. */
+  static KeyType ComputeMortonKey( const unsigned long *x,
+    unsigned int numberOfBits );
+
+protected:
+  ImageRegionBrickSplitter();
+  virtual ~ImageRegionBrickSplitter() {}
+  void PrintSelf( std::ostream& os, Indent indent ) const;
+
+private:
+  ImageRegionBrickSplitter( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  RegionType                                       m_Region;
+  SizeType                                         m_BrickSize;
+  CurveType                                        m_Curve;
+
+  /** Number of bricks along each axis */
+  unsigned long                                    m_GridSize[VImageDimension];
+
+  /** Raster number of each brick of the grid, in curve order */
+  std::vector<unsigned long>                       m_BrickOrder;
+
+  /** Number of pixels in the bricks before each brick (and in all of
+   * them at the end) */
+  std::vector<unsigned long>                       m_PixelOffsets;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkImageRegionBrickSplitter.hxx"
+#endif
+
+#endif
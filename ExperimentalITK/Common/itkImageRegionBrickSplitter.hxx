@@ -0,0 +1,266 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkImageRegionBrickSplitter.hxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkImageRegionBrickSplitter_hxx
+#define __itkImageRegionBrickSplitter_hxx
+
+#include "itkImageRegionBrickSplitter.h"
+
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace itk
+{
+
+template <unsigned int VImageDimension>
+ImageRegionBrickSplitter<VImageDimension>
+::ImageRegionBrickSplitter()
+{
+  // Largest power of two side with at most 4096 pixels per brick
+  unsigned long side = 1;
+  while( true )
+    {
+    unsigned long next = 1;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      next *= 2 * side;
+      }
+    if( next > 4096 )
+      {
+      break;
+      }
+    side *= 2;
+    }
+  this->m_BrickSize.Fill( side );
+  this->m_Curve = HilbertCurve;
+
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    this->m_GridSize[d] = 0;
+    }
+}
+
+template <unsigned int VImageDimension>
+void
+ImageRegionBrickSplitter<VImageDimension>
+::Initialize()
+{
+  unsigned long numberOfBricks = 1;
+  unsigned long maximumGridSize = 1;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    if( this->m_BrickSize[d] == 0 )
+      {
+      itkExceptionMacro( "The brick size must be positive." );
+      }
+    this->m_GridSize[d] = ( this->m_Region.GetSize()[d] + this->m_BrickSize[d] - 1 )
+      / this->m_BrickSize[d];
+    numberOfBricks *= this->m_GridSize[d];
+    maximumGridSize = vnl_math_max( maximumGridSize, this->m_GridSize[d] );
+    }
+
+  unsigned int numberOfBits = 0;
+  while( ( 1UL << numberOfBits ) < maximumGridSize )
+    {
+    numberOfBits++;
+    }
+  if( this->m_Curve != RasterCurve && numberOfBits * ImageDimension > 64 )
+    {
+    itkExceptionMacro( "Too many bricks along an axis (" << maximumGridSize
+      << ") for a curve key of 64 bits." );
+    }
+
+  // Sort the bricks by their position along the curve
+  std::vector<std::pair<KeyType, unsigned long> > keys( numberOfBricks );
+  unsigned long x[VImageDimension];
+  for( unsigned long n = 0; n < numberOfBricks; n++ )
+    {
+    unsigned long remainder = n;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      x[d] = remainder % this->m_GridSize[d];
+      remainder /= this->m_GridSize[d];
+      }
+    KeyType key = n;
+    if( this->m_Curve == HilbertCurve )
+      {
+      key = ComputeHilbertKey( x, numberOfBits );
+      }
+    else if( this->m_Curve == MortonCurve )
+      {
+      key = ComputeMortonKey( x, numberOfBits );
+      }
+    keys[n] = std::make_pair( key, n );
+    }
+  std::sort( keys.begin(), keys.end() );
+
+  this->m_BrickOrder.resize( numberOfBricks );
+  this->m_PixelOffsets.resize( numberOfBricks + 1 );
+  this->m_PixelOffsets[0] = 0;
+  for( unsigned long n = 0; n < numberOfBricks; n++ )
+    {
+    this->m_BrickOrder[n] = keys[n].second;
+    this->m_PixelOffsets[n + 1] = this->m_PixelOffsets[n]
+      + this->GetBrick( n ).GetNumberOfPixels();
+    }
+}
+
+template <unsigned int VImageDimension>
+typename ImageRegionBrickSplitter<VImageDimension>::RegionType
+ImageRegionBrickSplitter<VImageDimension>
+::GetBrick( unsigned long n ) const
+{
+  IndexType index;
+  SizeType size;
+
+  unsigned long remainder = this->m_BrickOrder[n];
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    const unsigned long x = remainder % this->m_GridSize[d];
+    remainder /= this->m_GridSize[d];
+
+    const unsigned long offset = x * this->m_BrickSize[d];
+    index[d] = this->m_Region.GetIndex()[d] + offset;
+    size[d] = vnl_math_min( this->m_BrickSize[d],
+      this->m_Region.GetSize()[d] - offset );
+    }
+
+  RegionType brick;
+  brick.SetIndex( index );
+  brick.SetSize( size );
+  return brick;
+}
+
+template <unsigned int VImageDimension>
+void
+ImageRegionBrickSplitter<VImageDimension>
+::GetSegment( unsigned int i, unsigned int n,
+  unsigned long &first, unsigned long &last ) const
+{
+  // Segment i starts at the first brick that starts at or after i/n of the
+  // pixels.
+  const vxl_uint_64 numberOfPixels = this->m_PixelOffsets.back();
+  const unsigned long begin = static_cast<unsigned long>( numberOfPixels * i / n );
+  const unsigned long end = static_cast<unsigned long>( numberOfPixels * ( i + 1 ) / n );
+
+  first = std::lower_bound( this->m_PixelOffsets.begin(),
+    this->m_PixelOffsets.end() - 1, begin ) - this->m_PixelOffsets.begin();
+  last = ( i + 1 == n ) ? this->GetNumberOfBricks() :
+    std::lower_bound( this->m_PixelOffsets.begin(),
+    this->m_PixelOffsets.end() - 1, end ) - this->m_PixelOffsets.begin();
+}
+
+template <unsigned int VImageDimension>
+typename ImageRegionBrickSplitter<VImageDimension>::KeyType
+ImageRegionBrickSplitter<VImageDimension>
+::ComputeHilbertKey( const unsigned long *x, unsigned int numberOfBits )
+{
+  // J. Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707, 2004:
+  // transform the coordinates in place to the "transposed" Hilbert index,
+  // whose bits are then interleaved.
+  unsigned long X[VImageDimension];
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    X[d] = x[d];
+    }
+
+  if( numberOfBits > 0 )
+    {
+    const unsigned long M = 1UL << ( numberOfBits - 1 );
+
+    // Inverse undo
+    for( unsigned long Q = M; Q > 1; Q >>= 1 )
+      {
+      const unsigned long P = Q - 1;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        if( X[d] & Q )
+          {
+          X[0] ^= P;
+          }
+        else
+          {
+          const unsigned long t = ( X[0] ^ X[d] ) & P;
+          X[0] ^= t;
+          X[d] ^= t;
+          }
+        }
+      }
+
+    // Gray encode
+    for( unsigned int d = 1; d < ImageDimension; d++ )
+      {
+      X[d] ^= X[d - 1];
+      }
+    unsigned long t = 0;
+    for( unsigned long Q = M; Q > 1; Q >>= 1 )
+      {
+      if( X[ImageDimension - 1] & Q )
+        {
+        t ^= Q - 1;
+        }
+      }
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      X[d] ^= t;
+      }
+    }
+
+  KeyType key = 0;
+  for( int b = static_cast<int>( numberOfBits ) - 1; b >= 0; b-- )
+    {
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      key = ( key << 1 ) | ( ( X[d] >> b ) & 1 );
+      }
+    }
+  return key;
+}
+
+template <unsigned int VImageDimension>
+typename ImageRegionBrickSplitter<VImageDimension>::KeyType
+ImageRegionBrickSplitter<VImageDimension>
+::ComputeMortonKey( const unsigned long *x, unsigned int numberOfBits )
+{
+  KeyType key = 0;
+  for( int b = static_cast<int>( numberOfBits ) - 1; b >= 0; b-- )
+    {
+    for( int d = ImageDimension - 1; d >= 0; d-- )
+      {
+      key = ( key << 1 ) | ( ( x[d] >> b ) & 1 );
+      }
+    }
+  return key;
+}
+
+template <unsigned int VImageDimension>
+void
+ImageRegionBrickSplitter<VImageDimension>
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Region: " << this->m_Region << std::endl;
+  os << indent << "Brick size: " << this->m_BrickSize << std::endl;
+  os << indent << "Curve: " << this->m_Curve << std::endl;
+  os << indent << "Number of bricks: " << this->GetNumberOfBricks() << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,111 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkImageRegionCurveConstIteratorWithIndex.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkImageRegionCurveConstIteratorWithIndex_h
+#define __itkImageRegionCurveConstIteratorWithIndex_h
+
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionBrickSplitter.h"
+
+namespace itk
+{
+
+/** \class ImageRegionCurveConstIteratorWithIndex
+ * \brief Iterates over a region brick by brick, the bricks being ordered
+ * along a space-filling curve.
+ *
+ * The pixels of each brick are visited in raster order and the bricks in
+ * the order of an ImageRegionBrickSplitter (a Hilbert curve by default).
+ * SetSegment() restricts the iteration to one segment of the curve, e.g.
+ * the part of a thread.  The brick size, the curve and the segment must be
+ * set before GoToBegin().
+ *
+ * Only GoToBegin(), operator++() and IsAtEnd() follow the curve; the other
+ * moves of the superclass act within the current brick.
+ *
+ * \sa ImageRegionBrickSplitter
+ * \sa ImageRegionCurveIteratorWithIndex
+ * \ingroup ImageIterators
+ */
+template <typename TImage>
+class ITK_EXPORT ImageRegionCurveConstIteratorWithIndex
+: public ImageRegionConstIteratorWithIndex<TImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef ImageRegionCurveConstIteratorWithIndex           Self;
+  typedef ImageRegionConstIteratorWithIndex<TImage>        Superclass;
+
+  typedef typename Superclass::ImageType                   ImageType;
+  typedef typename Superclass::RegionType                  RegionType;
+  typedef typename Superclass::IndexType                   IndexType;
+  typedef typename Superclass::SizeType                    SizeType;
+  typedef typename Superclass::PixelType                   PixelType;
+
+  typedef ImageRegionBrickSplitter
+    <ImageType::ImageDimension>                            SplitterType;
+  typedef typename SplitterType::CurveType                 CurveType;
+
+  /** Default constructor.  Needed since we provide a cast constructor. */
+  ImageRegionCurveConstIteratorWithIndex();
+
+  /** Iterate over region of the image ptr. */
+  ImageRegionCurveConstIteratorWithIndex( const ImageType *ptr,
+    const RegionType &region );
+
+  void SetBrickSize( const SizeType & );
+  void SetCurve( CurveType );
+
+  /** Visit only the bricks of segment i of n along the curve. */
+  void SetSegment( unsigned int i, unsigned int n );
+
+  /** Move to the first pixel of the first brick. */
+  void GoToBegin();
+
+  bool IsAtEnd() const
+    {
+    return this->m_IsAtEndOfCurve;
+    }
+
+  Self & operator++();
+
+  /** The brick being visited. */
+  const RegionType & GetBrick() const
+    {
+    return this->m_Region;
+    }
+
+protected:
+  /** Initialize the iterator of the superclass on brick n. */
+  void MoveToBrick( unsigned long n );
+
+  typename SplitterType::Pointer                           m_Splitter;
+  RegionType                                               m_CurveRegion;
+  bool                                                     m_IsSplitterInitialized;
+  unsigned int                                             m_SegmentId;
+  unsigned int                                             m_NumberOfSegments;
+  unsigned long                                            m_Brick;
+  unsigned long                                            m_LastBrick;
+  bool                                                     m_IsAtEndOfCurve;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkImageRegionCurveConstIteratorWithIndex.hxx"
+#endif
+
+#endif
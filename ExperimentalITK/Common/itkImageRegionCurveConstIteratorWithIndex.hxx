@@ -0,0 +1,140 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkImageRegionCurveConstIteratorWithIndex.hxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkImageRegionCurveConstIteratorWithIndex_hxx
+#define __itkImageRegionCurveConstIteratorWithIndex_hxx
+
+#include "itkImageRegionCurveConstIteratorWithIndex.h"
+
+namespace itk
+{
+
+template <typename TImage>
+ImageRegionCurveConstIteratorWithIndex<TImage>
+::ImageRegionCurveConstIteratorWithIndex()
+  : Superclass()
+{
+  this->m_Splitter = SplitterType::New();
+  this->m_IsSplitterInitialized = false;
+  this->m_SegmentId = 0;
+  this->m_NumberOfSegments = 1;
+  this->m_Brick = 0;
+  this->m_LastBrick = 0;
+  this->m_IsAtEndOfCurve = true;
+}
+
+template <typename TImage>
+ImageRegionCurveConstIteratorWithIndex<TImage>
+::ImageRegionCurveConstIteratorWithIndex( const ImageType *ptr,
+  const RegionType &region )
+  : Superclass( ptr, region )
+{
+  this->m_CurveRegion = region;
+  this->m_Splitter = SplitterType::New();
+  this->m_Splitter->SetRegion( region );
+  this->m_IsSplitterInitialized = false;
+  this->m_SegmentId = 0;
+  this->m_NumberOfSegments = 1;
+  this->m_Brick = 0;
+  this->m_LastBrick = 0;
+  this->m_IsAtEndOfCurve = true;
+}
+
+template <typename TImage>
+void
+ImageRegionCurveConstIteratorWithIndex<TImage>
+::SetBrickSize( const SizeType &size )
+{
+  this->m_Splitter->SetBrickSize( size );
+  this->m_IsSplitterInitialized = false;
+}
+
+template <typename TImage>
+void
+ImageRegionCurveConstIteratorWithIndex<TImage>
+::SetCurve( CurveType curve )
+{
+  this->m_Splitter->SetCurve( curve );
+  this->m_IsSplitterInitialized = false;
+}
+
+template <typename TImage>
+void
+ImageRegionCurveConstIteratorWithIndex<TImage>
+::SetSegment( unsigned int i, unsigned int n )
+{
+  this->m_SegmentId = i;
+  this->m_NumberOfSegments = n;
+}
+
+template <typename TImage>
+void
+ImageRegionCurveConstIteratorWithIndex<TImage>
+::GoToBegin()
+{
+  if( !this->m_IsSplitterInitialized )
+    {
+    this->m_Splitter->Initialize();
+    this->m_IsSplitterInitialized = true;
+    }
+
+  unsigned long first;
+  this->m_Splitter->GetSegment( this->m_SegmentId, this->m_NumberOfSegments,
+    first, this->m_LastBrick );
+
+  this->m_IsAtEndOfCurve = ( first >= this->m_LastBrick );
+  if( !this->m_IsAtEndOfCurve )
+    {
+    this->MoveToBrick( first );
+    }
+}
+
+template <typename TImage>
+typename ImageRegionCurveConstIteratorWithIndex<TImage>::Self &
+ImageRegionCurveConstIteratorWithIndex<TImage>
+::operator++()
+{
+  Superclass::operator++();
+  if( Superclass::IsAtEnd() )
+    {
+    if( this->m_Brick + 1 < this->m_LastBrick )
+      {
+      this->MoveToBrick( this->m_Brick + 1 );
+      }
+    else
+      {
+      this->m_IsAtEndOfCurve = true;
+      }
+    }
+  return *this;
+}
+
+template <typename TImage>
+void
+ImageRegionCurveConstIteratorWithIndex<TImage>
+::MoveToBrick( unsigned long n )
+{
+  this->m_Brick = n;
+
+  Superclass &brickIterator = *this;
+  brickIterator = Superclass( this->m_Image.GetPointer(),
+    this->m_Splitter->GetBrick( n ) );
+  brickIterator.GoToBegin();
+}
+
+} // end namespace itk
+
+#endif
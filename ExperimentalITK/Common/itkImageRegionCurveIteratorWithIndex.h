@@ -0,0 +1,72 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkImageRegionCurveIteratorWithIndex.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkImageRegionCurveIteratorWithIndex_h
+#define __itkImageRegionCurveIteratorWithIndex_h
+
+#include "itkImageRegionCurveConstIteratorWithIndex.h"
+
+namespace itk
+{
+
+/** \class ImageRegionCurveIteratorWithIndex
+ * \brief Write access version of ImageRegionCurveConstIteratorWithIndex.
+ *
+ * \sa ImageRegionCurveConstIteratorWithIndex
+ * \ingroup ImageIterators
+ */
+template <typename TImage>
+class ITK_EXPORT ImageRegionCurveIteratorWithIndex
+: public ImageRegionCurveConstIteratorWithIndex<TImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef ImageRegionCurveIteratorWithIndex                Self;
+  typedef ImageRegionCurveConstIteratorWithIndex<TImage>   Superclass;
+
+  typedef typename Superclass::ImageType                   ImageType;
+  typedef typename Superclass::RegionType                  RegionType;
+  typedef typename Superclass::PixelType                   PixelType;
+  typedef typename Superclass::InternalPixelType           InternalPixelType;
+
+  ImageRegionCurveIteratorWithIndex()
+    : Superclass()
+    {
+    }
+
+  ImageRegionCurveIteratorWithIndex( ImageType *ptr, const RegionType &region )
+    : Superclass( ptr, region )
+    {
+    }
+
+  /** Set the pixel value */
+  void Set( const PixelType &value ) const
+    {
+    this->m_PixelAccessorFunctor.Set(
+      *( const_cast<InternalPixelType *>( this->m_Position ) ), value );
+    }
+
+  /** Return a reference to the pixel.  This method will provide the
+   * fastest access to pixel data, but it will NOT support ImageAdaptors. */
+  PixelType & Value()
+    {
+    return *( const_cast<InternalPixelType *>( this->m_Position ) );
+    }
+};
+
+} // end namespace itk
+
+#endif
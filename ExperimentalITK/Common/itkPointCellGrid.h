@@ -0,0 +1,420 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkPointCellGrid.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkPointCellGrid_h
+#define __itkPointCellGrid_h
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace itk
+{
+
+/** \class PointCellGrid
+ * \brief Uniform grid of cells over a point set for exact k-nearest and
+ * fixed-radius neighbor queries.
+ *
+ * The points are sorted by cell with a counting sort, so (re)building the
+ * grid after the points have moved is O(n).  The queries do not modify the
+ * grid and can be run concurrently from several threads.
+ *
+ * A k-nearest query visits the cells in shells of increasing Chebyshev
+ * distance around the cell of the query point and stops when the k-th
+ * closest point found is nearer than any cell not yet visited.
+ */
+template <unsigned int VDimension>
+class PointCellGrid
+{
+public:
+  typedef PointCellGrid                     Self;
+  typedef double                            RealType;
+  typedef std::vector<RealType>             CoordinateContainerType;
+  typedef std::vector<unsigned long>        IdentifierContainerType;
+  typedef std::vector<RealType>             DistanceContainerType;
+
+  PointCellGrid()
+    {
+    this->m_NumberOfPoints = 0;
+    this->m_CellWidth = 1.0;
+    for( unsigned int d = 0; d < VDimension; d++ )
+      {
+      this->m_Origin[d] = 0.0;
+      this->m_Size[d] = 0;
+      }
+    }
+
+  /** Bin the points, given as VDimension consecutive coordinates each.
+   * With a cell width <= 0, the width is chosen to put about two points
+   * in each cell of the bounding box. */
+  void Initialize( const CoordinateContainerType &coordinates,
+    RealType cellWidth = 0.0 )
+    {
+    this->m_Points = coordinates;
+    this->m_NumberOfPoints = coordinates.size() / VDimension;
+    this->m_CellStart.clear();
+    this->m_CellPoints.clear();
+    if( this->m_NumberOfPoints == 0 )
+      {
+      return;
+      }
+
+    RealType upper[VDimension];
+    for( unsigned int d = 0; d < VDimension; d++ )
+      {
+      this->m_Origin[d] = upper[d] = this->m_Points[d];
+      }
+    for( unsigned long i = 1; i < this->m_NumberOfPoints; i++ )
+      {
+      for( unsigned int d = 0; d < VDimension; d++ )
+        {
+        const RealType x = this->m_Points[i * VDimension + d];
+        this->m_Origin[d] = std::min( this->m_Origin[d], x );
+        upper[d] = std::max( upper[d], x );
+        }
+      }
+
+    if( cellWidth <= 0.0 )
+      {
+      RealType volume = 1.0;
+      unsigned int numberOfExtents = 0;
+      for( unsigned int d = 0; d < VDimension; d++ )
+        {
+        if( upper[d] > this->m_Origin[d] )
+          {
+          volume *= upper[d] - this->m_Origin[d];
+          numberOfExtents++;
+          }
+        }
+      cellWidth = 1.0;
+      if( numberOfExtents > 0 )
+        {
+        cellWidth = std::pow( 2.0 * volume / this->m_NumberOfPoints,
+          1.0 / numberOfExtents );
+        }
+      }
+
+    // Do not let a small width (or flat point sets) create many more cells
+    // than points.
+    const RealType maximumNumberOfCells = 4.0 * this->m_NumberOfPoints + 16.0;
+    while( true )
+      {
+      RealType numberOfCells = 1.0;
+      for( unsigned int d = 0; d < VDimension; d++ )
+        {
+        this->m_Size[d] = static_cast<long>(
+          std::floor( ( upper[d] - this->m_Origin[d] ) / cellWidth ) ) + 1;
+        numberOfCells *= this->m_Size[d];
+        }
+      if( numberOfCells <= maximumNumberOfCells )
+        {
+        break;
+        }
+      cellWidth *= 1.5;
+      }
+    this->m_CellWidth = cellWidth;
+
+    unsigned long numberOfCells = 1;
+    for( unsigned int d = 0; d < VDimension; d++ )
+      {
+      numberOfCells *= this->m_Size[d];
+      }
+
+    std::vector<unsigned long> pointCells( this->m_NumberOfPoints );
+    this->m_CellStart.assign( numberOfCells + 1, 0 );
+    for( unsigned long i = 0; i < this->m_NumberOfPoints; i++ )
+      {
+      long cell[VDimension];
+      this->GetCell( &this->m_Points[i * VDimension], cell );
+      pointCells[i] = this->GetCellOffset( cell );
+      this->m_CellStart[pointCells[i] + 1]++;
+      }
+    for( unsigned long c = 0; c < numberOfCells; c++ )
+      {
+      this->m_CellStart[c + 1] += this->m_CellStart[c];
+      }
+    std::vector<unsigned long> position( this->m_CellStart.begin(),
+      this->m_CellStart.end() - 1 );
+    this->m_CellPoints.resize( this->m_NumberOfPoints );
+    for( unsigned long i = 0; i < this->m_NumberOfPoints; i++ )
+      {
+      this->m_CellPoints[position[pointCells[i]]++] = i;
+      }
+    }
+
+  unsigned long GetNumberOfPoints() const
+    {
+    return this->m_NumberOfPoints;
+    }
+
+  const RealType * GetPoint( unsigned long i ) const
+    {
+    return &this->m_Points[i * VDimension];
+    }
+
+  const CoordinateContainerType & GetCoordinates() const
+    {
+    return this->m_Points;
+    }
+
+  /** The min(k, n) points closest to the query, by increasing distance,
+   * and their squared distances. */
+  void FindNearestPoints( const RealType *query, unsigned int k,
+    IdentifierContainerType &identifiers,
+    DistanceContainerType &squaredDistances ) const
+    {
+    identifiers.clear();
+    squaredDistances.clear();
+    if( this->m_NumberOfPoints == 0 || k == 0 )
+      {
+      return;
+      }
+    if( k > this->m_NumberOfPoints )
+      {
+      k = this->m_NumberOfPoints;
+      }
+
+    long center[VDimension];
+    this->GetCell( query, center );
+
+    // Max-heap of the k closest points found so far.
+    std::vector<std::pair<RealType, unsigned long> > closest;
+    closest.reserve( k + 1 );
+
+    for( long s = 0; ; s++ )
+      {
+      this->VisitShell( query, center, s, k, closest );
+
+      // Distance from the query to the cells outside the visited block.
+      bool isCovered = true;
+      RealType bound = 0.0;
+      for( unsigned int d = 0; d < VDimension; d++ )
+        {
+        if( center[d] - s > 0 )
+          {
+          const RealType distance = query[d] -
+            ( this->m_Origin[d] + ( center[d] - s ) * this->m_CellWidth );
+          bound = isCovered ? distance : std::min( bound, distance );
+          isCovered = false;
+          }
+        if( center[d] + s < this->m_Size[d] - 1 )
+          {
+          const RealType distance =
+            ( this->m_Origin[d] + ( center[d] + s + 1 ) * this->m_CellWidth ) - query[d];
+          bound = isCovered ? distance : std::min( bound, distance );
+          isCovered = false;
+          }
+        }
+      if( isCovered || ( closest.size() == k && bound > 0.0 &&
+        bound * bound >= closest.front().first ) )
+        {
+        break;
+        }
+      }
+
+    std::sort_heap( closest.begin(), closest.end() );
+    identifiers.resize( closest.size() );
+    squaredDistances.resize( closest.size() );
+    for( unsigned int n = 0; n < closest.size(); n++ )
+      {
+      squaredDistances[n] = closest[n].first;
+      identifiers[n] = closest[n].second;
+      }
+    }
+
+  /** All the points within radius of the query (in no particular order)
+   * and their squared distances. */
+  void FindPointsWithinRadius( const RealType *query, RealType radius,
+    IdentifierContainerType &identifiers,
+    DistanceContainerType &squaredDistances ) const
+    {
+    identifiers.clear();
+    squaredDistances.clear();
+    if( this->m_NumberOfPoints == 0 || radius < 0.0 )
+      {
+      return;
+      }
+
+    long first[VDimension];
+    long last[VDimension];
+    for( unsigned int d = 0; d < VDimension; d++ )
+      {
+      first[d] = this->GetCell( query[d] - radius, d );
+      last[d] = this->GetCell( query[d] + radius, d );
+      }
+
+    const RealType squaredRadius = radius * radius;
+    long cell[VDimension];
+    std::copy( first, first + VDimension, cell );
+    while( true )
+      {
+      const unsigned long offset = this->GetCellOffset( cell );
+      for( unsigned long n = this->m_CellStart[offset];
+        n < this->m_CellStart[offset + 1]; n++ )
+        {
+        const unsigned long i = this->m_CellPoints[n];
+        const RealType squaredDistance = this->GetSquaredDistance( query, i );
+        if( squaredDistance <= squaredRadius )
+          {
+          identifiers.push_back( i );
+          squaredDistances.push_back( squaredDistance );
+          }
+        }
+
+      unsigned int d = 0;
+      for( ; d < VDimension; d++ )
+        {
+        if( cell[d] < last[d] )
+          {
+          cell[d]++;
+          break;
+          }
+        cell[d] = first[d];
+        }
+      if( d == VDimension )
+        {
+        break;
+        }
+      }
+    }
+
+private:
+  /** Cell containing a point, clamped to the grid. */
+  long GetCell( RealType x, unsigned int d ) const
+    {
+    const RealType c = std::floor( ( x - this->m_Origin[d] ) / this->m_CellWidth );
+    if( c < 0.0 )
+      {
+      return 0;
+      }
+    if( c > static_cast<RealType>( this->m_Size[d] - 1 ) )
+      {
+      return this->m_Size[d] - 1;
+      }
+    return static_cast<long>( c );
+    }
+
+  void GetCell( const RealType *point, long *cell ) const
+    {
+    for( unsigned int d = 0; d < VDimension; d++ )
+      {
+      cell[d] = this->GetCell( point[d], d );
+      }
+    }
+
+  unsigned long GetCellOffset( const long *cell ) const
+    {
+    unsigned long offset = 0;
+    for( int d = VDimension - 1; d >= 0; d-- )
+      {
+      offset = offset * this->m_Size[d] + cell[d];
+      }
+    return offset;
+    }
+
+  RealType GetSquaredDistance( const RealType *query, unsigned long i ) const
+    {
+    const RealType *point = &this->m_Points[i * VDimension];
+    RealType squaredDistance = 0.0;
+    for( unsigned int d = 0; d < VDimension; d++ )
+      {
+      squaredDistance += ( query[d] - point[d] ) * ( query[d] - point[d] );
+      }
+    return squaredDistance;
+    }
+
+  /** Offer the points of the cells at Chebyshev distance s from center to
+   * the heap of the k closest. */
+  void VisitShell( const RealType *query, const long *center, long s,
+    unsigned int k, std::vector<std::pair<RealType, unsigned long> > &closest ) const
+    {
+    long first[VDimension];
+    long last[VDimension];
+    for( unsigned int d = 0; d < VDimension; d++ )
+      {
+      first[d] = std::max( center[d] - s, 0L );
+      last[d] = std::min( center[d] + s, this->m_Size[d] - 1 );
+      }
+
+    // Odometer over the dimensions above the first one; along the first
+    // dimension only the two end cells are on the shell unless another
+    // coordinate already is.
+    long cell[VDimension];
+    std::copy( first, first + VDimension, cell );
+    while( true )
+      {
+      bool isOnShell = false;
+      for( unsigned int d = 1; d < VDimension; d++ )
+        {
+        isOnShell = isOnShell || ( cell[d] == center[d] - s || cell[d] == center[d] + s );
+        }
+      const long step = ( isOnShell || s == 0 ) ? 1 : 2 * s;
+      for( cell[0] = center[0] - s; cell[0] <= center[0] + s; cell[0] += step )
+        {
+        if( cell[0] < first[0] || cell[0] > last[0] )
+          {
+          continue;
+          }
+        const unsigned long offset = this->GetCellOffset( cell );
+        for( unsigned long n = this->m_CellStart[offset];
+          n < this->m_CellStart[offset + 1]; n++ )
+          {
+          const unsigned long i = this->m_CellPoints[n];
+          const RealType squaredDistance = this->GetSquaredDistance( query, i );
+          if( closest.size() < k )
+            {
+            closest.push_back( std::make_pair( squaredDistance, i ) );
+            std::push_heap( closest.begin(), closest.end() );
+            }
+          else if( squaredDistance < closest.front().first )
+            {
+            std::pop_heap( closest.begin(), closest.end() );
+            closest.back() = std::make_pair( squaredDistance, i );
+            std::push_heap( closest.begin(), closest.end() );
+            }
+          }
+        }
+
+      unsigned int d = 1;
+      for( ; d < VDimension; d++ )
+        {
+        if( cell[d] < last[d] )
+          {
+          cell[d]++;
+          break;
+          }
+        cell[d] = first[d];
+        }
+      if( d >= VDimension )
+        {
+        break;
+        }
+      }
+    }
+
+  unsigned long                             m_NumberOfPoints;
+  CoordinateContainerType                   m_Points;
+  RealType                                  m_Origin[VDimension];
+  long                                      m_Size[VDimension];
+  RealType                                  m_CellWidth;
+  std::vector<unsigned long>                m_CellStart;
+  std::vector<unsigned long>                m_CellPoints;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,163 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkRadixHeap.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkRadixHeap_h
+#define __itkRadixHeap_h
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace itk
+{
+
+/** \class RadixHeap
+ * \brief Monotone priority queue with non-negative float keys.
+ *
+ * A radix heap (Ahuja, Mehlhorn, Orlin and Tarjan) for the label-setting
+ * algorithms (Dijkstra, fast marching) where the popped keys never
+ * decrease.  The keys must be non-negative and not smaller than the last
+ * popped key, which holds for Dijkstra with non-negative edge costs.  For
+ * such floats the order of the keys is the order of their bit patterns, so
+ * the entries are stored in 33 buckets according to the highest bit in
+ * which their key differs from the last popped key.  Push is O(1) and Pop
+ * is amortized O(32).  Decrease-key is done by pushing the element again;
+ * the caller skips the stale entries when they are popped.
+ */
+template <class TValue>
+class RadixHeap
+{
+public:
+  typedef RadixHeap                         Self;
+  typedef TValue                            ValueType;
+  typedef float                             KeyType;
+
+  RadixHeap()
+    {
+    this->Clear();
+    }
+
+  bool Empty() const
+    {
+    return ( this->m_Size == 0 );
+    }
+
+  unsigned long Size() const
+    {
+    return this->m_Size;
+    }
+
+  void Clear()
+    {
+    for( unsigned int i = 0; i < NumberOfBuckets; i++ )
+      {
+      this->m_Buckets[i].clear();
+      }
+    this->m_Size = 0;
+    this->m_LastBits = 0;
+    }
+
+  /** Insert a value.  A key smaller than the last popped key is raised to
+   *  it to keep the heap consistent. */
+  void Push( KeyType key, const ValueType &value )
+    {
+    unsigned int bits = ToBits( key );
+    if( bits < this->m_LastBits || key < 0 )
+      {
+      bits = this->m_LastBits;
+      }
+    this->m_Buckets[this->GetBucket( bits )].push_back( EntryType( bits, value ) );
+    this->m_Size++;
+    }
+
+  /** Remove a value with the smallest key.  The heap must not be empty. */
+  void Pop( KeyType &key, ValueType &value )
+    {
+    if( this->m_Buckets[0].empty() )
+      {
+      unsigned int i = 1;
+      while( this->m_Buckets[i].empty() )
+        {
+        i++;
+        }
+
+      // The smallest key of the first non-empty bucket becomes the last
+      // key; all the entries of that bucket then move to lower buckets.
+      std::vector<EntryType> &bucket = this->m_Buckets[i];
+      unsigned int minimumBits = bucket[0].first;
+      for( unsigned int n = 1; n < bucket.size(); n++ )
+        {
+        if( bucket[n].first < minimumBits )
+          {
+          minimumBits = bucket[n].first;
+          }
+        }
+      this->m_LastBits = minimumBits;
+      for( unsigned int n = 0; n < bucket.size(); n++ )
+        {
+        this->m_Buckets[this->GetBucket( bucket[n].first )].push_back( bucket[n] );
+        }
+      bucket.clear();
+      }
+
+    key = FromBits( this->m_Buckets[0].back().first );
+    value = this->m_Buckets[0].back().second;
+    this->m_Buckets[0].pop_back();
+    this->m_Size--;
+    }
+
+private:
+  typedef std::pair<unsigned int, ValueType>  EntryType;
+
+  enum { NumberOfBuckets = 33 };
+
+  /** Bit pattern of a non-negative IEEE float (32 bits). */
+  static unsigned int ToBits( KeyType key )
+    {
+    unsigned int bits;
+    std::memcpy( &bits, &key, sizeof( bits ) );
+    return bits;
+    }
+
+  static KeyType FromBits( unsigned int bits )
+    {
+    KeyType key;
+    std::memcpy( &key, &bits, sizeof( key ) );
+    return key;
+    }
+
+  /** 0 if bits equals the last key, else 1 + the position of the highest
+   *  bit where they differ. */
+  unsigned int GetBucket( unsigned int bits ) const
+    {
+    unsigned int x = bits ^ this->m_LastBits;
+    unsigned int bucket = 0;
+    while( x )
+      {
+      x >>= 1;
+      bucket++;
+      }
+    return bucket;
+    }
+
+  std::vector<EntryType>                    m_Buckets[NumberOfBuckets];
+  unsigned long                             m_Size;
+  unsigned int                              m_LastBits;
+};
+
+} // end namespace itk
+
+#endif
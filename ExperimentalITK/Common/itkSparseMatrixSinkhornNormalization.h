@@ -0,0 +1,161 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkSparseMatrixSinkhornNormalization.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkSparseMatrixSinkhornNormalization_h
+#define __itkSparseMatrixSinkhornNormalization_h
+
+#include "itkObject.h"
+
+#include "itkMacro.h"
+#include "itkMultiThreader.h"
+
+#include "vnl/vnl_sparse_matrix.h"
+#include "vnl/vnl_vector.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class SparseMatrixSinkhornNormalization
+ * \brief Alternating row/column (Sinkhorn) normalization of a sparse
+ * correspondence matrix augmented with an outlier row and column.
+ *
+ * This is the normalization step of the robust point matching filters.
+ * The matrix has one row per moving point and one column per fixed point.
+ * The outlier column (one entry per row) and the outlier row (one entry per
+ * column) take part in the row and column sums but are not themselves
+ * normalized, so that points without a match can keep their mass in the
+ * outlier bins.  Only the stored entries of the matrix are visited, so the
+ * cost of one iteration is proportional to the number of non-zero entries.
+ *
+ * The row pass and the column pass are multithreaded over blocks of rows.
+ * For the column pass each thread accumulates the column sums of its rows
+ * into its own buffer; the buffers are then summed over blocks of columns.
+ * The result is therefore independent of the number of threads up to the
+ * order of the floating point additions.
+ */
+
+template < class TRealType = double,
+           class TSparseMatrix = vnl_sparse_matrix<TRealType>,
+           class TVector = vnl_vector<TRealType> >
+class ITK_EXPORT SparseMatrixSinkhornNormalization : public Object
+{
+public:
+  /** Standard "Self" typedef. */
+  typedef SparseMatrixSinkhornNormalization                Self;
+  typedef Object                                           Superclass;
+  typedef SmartPointer<Self>                               Pointer;
+  typedef SmartPointer<const Self>                         ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( SparseMatrixSinkhornNormalization, Object );
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  typedef TRealType                                        RealType;
+  typedef TSparseMatrix                                    SparseMatrixType;
+  typedef TVector                                          VectorType;
+
+  /** The matrix is normalized in place. */
+  itkSetObjectMacro( Matrix, SparseMatrixType );
+
+  /** Outlier entries of each row (size = number of rows). */
+  itkSetObjectMacro( OutlierColumn, VectorType );
+
+  /** Outlier entries of each column (size = number of columns). */
+  itkSetObjectMacro( OutlierRow, VectorType );
+
+  /** Stop when the mean squared deviation of the row and column sums
+   * from 1 falls below the tolerance. */
+  itkSetMacro( Tolerance, RealType );
+  itkGetConstMacro( Tolerance, RealType );
+
+  itkSetMacro( MaximumNumberOfIterations, unsigned int );
+  itkGetConstMacro( MaximumNumberOfIterations, unsigned int );
+
+  /** Normalize the rows before the columns in each iteration (default)
+   * or the columns before the rows. */
+  itkSetMacro( NormalizeRowsFirst, bool );
+  itkGetConstMacro( NormalizeRowsFirst, bool );
+  itkBooleanMacro( NormalizeRowsFirst );
+
+  itkSetClampMacro( NumberOfThreads, unsigned int, 1, ITK_MAX_THREADS );
+  itkGetConstMacro( NumberOfThreads, unsigned int );
+
+  itkGetConstMacro( ElapsedIterations, unsigned int );
+  itkGetConstMacro( Deviation, RealType );
+
+  /** dummy method that calls the GenerateData method to
+   * normalize the matrix. */
+  void Update()
+  { this->GenerateData(); }
+
+protected:
+  SparseMatrixSinkhornNormalization();
+  virtual ~SparseMatrixSinkhornNormalization();
+  void PrintSelf(std::ostream& os, Indent indent) const;
+
+  /** Normalizes the matrix. */
+  void GenerateData();
+
+private:
+  SparseMatrixSinkhornNormalization(const Self&); //purposely not implemented
+  void operator=(const Self&); //purposely not implemented
+
+  enum StepType { NormalizeRows, AccumulateColumns, SumColumns, NormalizeColumns };
+
+  /** Multi-threading support. */
+  struct ThreadStruct
+    {
+    Self *Filter;
+    };
+
+  static ITK_THREAD_RETURN_TYPE NormalizationThreaderCallback( void * );
+
+  void ThreadedNormalizationStep( unsigned int, unsigned int );
+  void RunNormalizationStep( StepType );
+
+  RealType                                                  m_Tolerance;
+  unsigned int                                              m_MaximumNumberOfIterations;
+  bool                                                      m_NormalizeRowsFirst;
+  unsigned int                                              m_NumberOfThreads;
+
+  unsigned int                                              m_ElapsedIterations;
+  RealType                                                  m_Deviation;
+
+  SparseMatrixType                                          *m_Matrix;
+  VectorType                                                *m_OutlierColumn;
+  VectorType                                                *m_OutlierRow;
+
+  /** State of the current iteration */
+  StepType                                                  m_CurrentStep;
+  VectorType                                                m_RowSum;
+  VectorType                                                m_ColumnSum;
+  std::vector<VectorType>                                   m_ThreadColumnSums;
+  MultiThreader::Pointer                                    m_Threader;
+};
+
+} // end namespace itk
+
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSparseMatrixSinkhornNormalization.hxx"
+#endif
+
+#endif
+
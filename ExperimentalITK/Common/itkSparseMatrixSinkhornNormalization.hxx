@@ -0,0 +1,252 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkSparseMatrixSinkhornNormalization.hxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkSparseMatrixSinkhornNormalization_hxx
+#define __itkSparseMatrixSinkhornNormalization_hxx
+
+#include "itkSparseMatrixSinkhornNormalization.h"
+
+#include "itkNumericTraits.h"
+
+#include "vnl/vnl_math.h"
+
+namespace itk
+{
+
+template <class TRealType, class TSparseMatrix, class TVector>
+SparseMatrixSinkhornNormalization<TRealType, TSparseMatrix, TVector>
+::SparseMatrixSinkhornNormalization()
+{
+  this->m_Tolerance = 1e-4;
+  this->m_MaximumNumberOfIterations = 100;
+  this->m_NormalizeRowsFirst = true;
+
+  this->m_Threader = MultiThreader::New();
+  this->m_NumberOfThreads = this->m_Threader->GetNumberOfThreads();
+
+  this->m_ElapsedIterations = 0;
+  this->m_Deviation = NumericTraits<RealType>::max();
+
+  this->m_Matrix = NULL;
+  this->m_OutlierColumn = NULL;
+  this->m_OutlierRow = NULL;
+
+  this->m_CurrentStep = NormalizeRows;
+}
+
+/**
+ * Destructor
+ */
+template <class TRealType, class TSparseMatrix, class TVector>
+SparseMatrixSinkhornNormalization<TRealType, TSparseMatrix, TVector>
+::~SparseMatrixSinkhornNormalization()
+{
+}
+
+template <class TRealType, class TSparseMatrix, class TVector>
+void
+SparseMatrixSinkhornNormalization<TRealType, TSparseMatrix, TVector>
+::GenerateData()
+{
+  if ( !this->m_Matrix || !this->m_OutlierColumn || !this->m_OutlierRow )
+    {
+    itkExceptionMacro( "The matrix and the outlier row and column must be set." );
+    }
+  if ( this->m_OutlierColumn->size() != this->m_Matrix->rows() ||
+       this->m_OutlierRow->size() != this->m_Matrix->cols() )
+    {
+    itkExceptionMacro( "The outlier column (row) size must equal the number "
+      << "of matrix rows (columns)." );
+    }
+
+  this->m_Threader->SetNumberOfThreads( this->m_NumberOfThreads );
+
+  this->m_RowSum.set_size( this->m_Matrix->rows() );
+  this->m_ColumnSum.set_size( this->m_Matrix->cols() );
+  this->m_ThreadColumnSums.resize( this->m_Threader->GetNumberOfThreads() );
+  for ( unsigned int n = 0; n < this->m_ThreadColumnSums.size(); n++ )
+    {
+    this->m_ThreadColumnSums[n].set_size( this->m_Matrix->cols() );
+    }
+
+  this->m_Deviation = NumericTraits<RealType>::max();
+  this->m_ElapsedIterations = 0;
+
+  while ( this->m_Deviation > this->m_Tolerance &&
+          this->m_ElapsedIterations++ < this->m_MaximumNumberOfIterations )
+    {
+    if ( this->m_NormalizeRowsFirst )
+      {
+      this->RunNormalizationStep( NormalizeRows );
+      }
+
+    this->RunNormalizationStep( AccumulateColumns );
+    this->RunNormalizationStep( SumColumns );
+    this->RunNormalizationStep( NormalizeColumns );
+
+    if ( !this->m_NormalizeRowsFirst )
+      {
+      this->RunNormalizationStep( NormalizeRows );
+      }
+
+    /**
+     * Calculate current deviation from 1
+     */
+    RealType deviation = 0.0;
+    for ( unsigned int i = 0; i < this->m_RowSum.size(); i++ )
+      {
+      deviation += vnl_math_sqr( this->m_RowSum[i] - 1.0 );
+      }
+    for ( unsigned int j = 0; j < this->m_ColumnSum.size(); j++ )
+      {
+      deviation += vnl_math_sqr( this->m_ColumnSum[j] - 1.0 );
+      }
+    this->m_Deviation = deviation /
+      static_cast<RealType>( this->m_RowSum.size() + this->m_ColumnSum.size() );
+    }
+}
+
+template <class TRealType, class TSparseMatrix, class TVector>
+void
+SparseMatrixSinkhornNormalization<TRealType, TSparseMatrix, TVector>
+::RunNormalizationStep( StepType step )
+{
+  ThreadStruct str;
+  str.Filter = this;
+
+  this->m_CurrentStep = step;
+  this->m_Threader->SetSingleMethod( this->NormalizationThreaderCallback, &str );
+  this->m_Threader->SingleMethodExecute();
+}
+
+template <class TRealType, class TSparseMatrix, class TVector>
+ITK_THREAD_RETURN_TYPE
+SparseMatrixSinkhornNormalization<TRealType, TSparseMatrix, TVector>
+::NormalizationThreaderCallback( void *arg )
+{
+  unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct *str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  str->Filter->ThreadedNormalizationStep( threadId, threadCount );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TRealType, class TSparseMatrix, class TVector>
+void
+SparseMatrixSinkhornNormalization<TRealType, TSparseMatrix, TVector>
+::ThreadedNormalizationStep( unsigned int threadId, unsigned int threadCount )
+{
+  const unsigned long numberOfRows = this->m_Matrix->rows();
+  const unsigned long numberOfColumns = this->m_Matrix->cols();
+
+  const unsigned long firstRow = ( numberOfRows * threadId ) / threadCount;
+  const unsigned long lastRow = ( numberOfRows * ( threadId + 1 ) ) / threadCount;
+
+  switch ( this->m_CurrentStep )
+    {
+    case NormalizeRows:
+      {
+      for ( unsigned long i = firstRow; i < lastRow; i++ )
+        {
+        RealType rowSum = ( *this->m_OutlierColumn )[i];
+
+        typename SparseMatrixType::row &rw = this->m_Matrix->get_row( i );
+        typename SparseMatrixType::row::iterator ri;
+        for ( ri = rw.begin(); ri != rw.end(); ++ri )
+          {
+          rowSum += (*ri).second;
+          }
+        for ( ri = rw.begin(); ri != rw.end(); ++ri )
+          {
+          (*ri).second /= rowSum;
+          }
+        ( *this->m_OutlierColumn )[i] /= rowSum;
+        this->m_RowSum[i] = rowSum;
+        }
+      break;
+      }
+    case AccumulateColumns:
+      {
+      VectorType &columnSum = this->m_ThreadColumnSums[threadId];
+      columnSum.fill( 0.0 );
+
+      for ( unsigned long i = firstRow; i < lastRow; i++ )
+        {
+        typename SparseMatrixType::row &rw = this->m_Matrix->get_row( i );
+        typename SparseMatrixType::row::iterator ri;
+        for ( ri = rw.begin(); ri != rw.end(); ++ri )
+          {
+          columnSum[(*ri).first] += (*ri).second;
+          }
+        }
+      break;
+      }
+    case SumColumns:
+      {
+      const unsigned long firstColumn = ( numberOfColumns * threadId ) / threadCount;
+      const unsigned long lastColumn = ( numberOfColumns * ( threadId + 1 ) ) / threadCount;
+
+      for ( unsigned long j = firstColumn; j < lastColumn; j++ )
+        {
+        RealType columnSum = ( *this->m_OutlierRow )[j];
+        for ( unsigned int n = 0; n < this->m_ThreadColumnSums.size(); n++ )
+          {
+          columnSum += this->m_ThreadColumnSums[n][j];
+          }
+        ( *this->m_OutlierRow )[j] /= columnSum;
+        this->m_ColumnSum[j] = columnSum;
+        }
+      break;
+      }
+    case NormalizeColumns:
+      {
+      for ( unsigned long i = firstRow; i < lastRow; i++ )
+        {
+        typename SparseMatrixType::row &rw = this->m_Matrix->get_row( i );
+        typename SparseMatrixType::row::iterator ri;
+        for ( ri = rw.begin(); ri != rw.end(); ++ri )
+          {
+          (*ri).second /= this->m_ColumnSum[(*ri).first];
+          }
+        }
+      break;
+      }
+    }
+}
+
+template <class TRealType, class TSparseMatrix, class TVector>
+void
+SparseMatrixSinkhornNormalization<TRealType, TSparseMatrix, TVector>
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Tolerance: " << this->m_Tolerance << std::endl;
+  os << indent << "Maximum number of iterations: "
+     << this->m_MaximumNumberOfIterations << std::endl;
+  os << indent << "Normalize rows first: "
+     << this->m_NormalizeRowsFirst << std::endl;
+  os << indent << "Number of threads: " << this->m_NumberOfThreads << std::endl;
+  os << indent << "Elapsed iterations: " << this->m_ElapsedIterations << std::endl;
+  os << indent << "Deviation: " << this->m_Deviation << std::endl;
+}
+
+} // end namespace itk
+
+#endif
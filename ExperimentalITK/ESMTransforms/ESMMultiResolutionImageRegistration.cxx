@@ -0,0 +1,317 @@
+#include "itkESMRigid3DTransform.h"
+#include "itkESMSimilarity3DTransform.h"
+#include "itkESMAffineTransform.h"
+#include "itkESMMeanSquaresImageToImageMetric.h"
+#include "itkESMDogLegOptimizer.h"
+#include "itkESMMultiResolutionImageRegistrationMethod.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkImage.h"
+
+#include "itkAffineTransform.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkResampleImageFilter.h"
+#include "itkTransformFileWriter.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+class CommandIterationUpdate : public itk::Command
+{
+public:
+  typedef  CommandIterationUpdate   Self;
+  typedef  itk::Command             Superclass;
+  typedef itk::SmartPointer<Self>  Pointer;
+  itkNewMacro( Self );
+
+protected:
+  CommandIterationUpdate() {};
+
+public:
+
+  static const unsigned int  Dimension = 3;
+  typedef  float             PixelType;
+
+  typedef itk::Image< PixelType, Dimension >  FixedImageType;
+  typedef itk::Image< PixelType, Dimension >  MovingImageType;
+
+  typedef itk::ESMOptimizerBase<
+    FixedImageType,MovingImageType>           OptimizerType;
+  typedef const OptimizerType                 *OptimizerPointer;
+
+  void Execute(itk::Object *caller, const itk::EventObject & event)
+  {
+    Execute( (const itk::Object *)caller, event);
+  }
+
+  void Execute(const itk::Object * object, const itk::EventObject & event)
+  {
+    OptimizerPointer optimizer =
+                         dynamic_cast< OptimizerPointer >( object );
+
+    if( ! itk::IterationEvent().CheckEvent( &event ) )
+      {
+      return;
+      }
+
+    std::cout << "    " << optimizer->GetCurrentIteration() << " = ";
+    std::cout << optimizer->GetValue() << " : ";
+    std::cout << optimizer->GetCurrentPosition() << std::endl;
+  }
+
+};
+
+template <class TRegistration>
+class RegistrationLevelUpdate : public itk::Command
+{
+public:
+  typedef  RegistrationLevelUpdate  Self;
+  typedef  itk::Command             Superclass;
+  typedef itk::SmartPointer<Self>  Pointer;
+  itkNewMacro( Self );
+
+protected:
+  RegistrationLevelUpdate() {};
+
+public:
+
+  void Execute(itk::Object *caller, const itk::EventObject & event)
+  {
+    Execute( (const itk::Object *)caller, event);
+  }
+
+  void Execute(const itk::Object * object, const itk::EventObject & event)
+  {
+    const TRegistration * registration =
+                         dynamic_cast< const TRegistration * >( object );
+
+    if( ! itk::IterationEvent().CheckEvent( &event ) )
+      {
+      return;
+      }
+
+    std::cout << "  Level " << registration->GetCurrentLevel() << std::endl;
+  }
+
+};
+
+template <class TValue>
+std::vector<TValue> ConvertVector( std::string optionString )
+{
+  std::vector<TValue> values;
+  std::string::size_type crosspos = optionString.find( 'x', 0 );
+
+  if ( crosspos == std::string::npos )
+    {
+    values.push_back( static_cast<TValue>( atof( optionString.c_str() ) ) );
+    }
+  else
+    {
+    std::string element = optionString.substr( 0, crosspos ) ;
+    values.push_back( static_cast<TValue>( atof( element.c_str() ) ) );
+    while ( crosspos != std::string::npos )
+      {
+      std::string::size_type crossposfrom = crosspos;
+      crosspos = optionString.find( 'x', crossposfrom + 1 );
+      if ( crosspos == std::string::npos )
+        {
+        element = optionString.substr( crossposfrom + 1, optionString.length() );
+        }
+      else
+        {
+        element = optionString.substr( crossposfrom + 1, crosspos ) ;
+        }
+      values.push_back( static_cast<TValue>( atof( element.c_str() ) ) );
+      }
+    }
+  return values;
+}
+
+int main( int argc, char *argv[] )
+{
+  if( argc < 4 )
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " fixedImageFile movingImageFile outputPrefix ";
+    std::cerr << "[transformType=rigid|similarity|affine] ";
+    std::cerr << "[numberOfLevels=3] [iterationsPerLevel=10x10x5]" << std::endl;
+    std::cerr << "  The affine registration is initialized by a rigid and a " << std::endl;
+    std::cerr << "  similarity registration. The resulting transform is written " << std::endl;
+    std::cerr << "  to outputPrefixAffine.txt and the warped moving image to " << std::endl;
+    std::cerr << "  outputPrefixWarped.nii.gz." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const    unsigned int    Dimension = 3;
+  typedef  float           PixelType;
+
+  typedef itk::Image< PixelType, Dimension >  FixedImageType;
+  typedef itk::Image< PixelType, Dimension >  MovingImageType;
+
+  typedef itk::ESMRigid3DTransform< double >          RigidTransformType;
+  typedef itk::ESMSimilarity3DTransform< double >     SimilarityTransformType;
+  typedef itk::ESMAffineTransform< double, Dimension > AffineTransformType;
+  typedef itk::ESMMatrixOffsetTransformBase<
+    double, Dimension >                               MatrixOffsetTransformType;
+
+  typedef itk::ESMDogLegOptimizer<
+    FixedImageType,MovingImageType>           OptimizerType;
+
+  typedef itk::ESMMeanSquaresImageToImageMetric<
+    FixedImageType, MovingImageType >         MetricType;
+
+  typedef itk:: LinearInterpolateImageFunction<
+    MovingImageType, double >                 InterpolatorType;
+
+  typedef itk::ESMMultiResolutionImageRegistrationMethod<
+    FixedImageType, MovingImageType >         RegistrationType;
+
+  typedef itk::ImageFileReader< FixedImageType  > FixedImageReaderType;
+  typedef itk::ImageFileReader< MovingImageType > MovingImageReaderType;
+  FixedImageReaderType::Pointer  fixedImageReader  = FixedImageReaderType::New();
+  MovingImageReaderType::Pointer movingImageReader = MovingImageReaderType::New();
+
+  fixedImageReader->SetFileName(  argv[1] );
+  movingImageReader->SetFileName( argv[2] );
+  fixedImageReader->Update();
+  movingImageReader->Update();
+
+  std::string transformType( "affine" );
+  if( argc > 4 )
+    {
+    transformType = std::string( argv[4] );
+    }
+
+  unsigned int numberOfLevels = 3;
+  if( argc > 5 )
+    {
+    numberOfLevels = static_cast<unsigned int>( atoi( argv[5] ) );
+    }
+
+  std::vector<unsigned long> iterations = ConvertVector<unsigned long>( std::string( "10x10x5" ) );
+  if( argc > 6 )
+    {
+    iterations = ConvertVector<unsigned long>( std::string( argv[6] ) );
+    }
+  RegistrationType::IterationsArrayType iterationsPerLevel( iterations.size() );
+  for( unsigned int n = 0; n < iterations.size(); n++ )
+    {
+    iterationsPerLevel[n] = iterations[n];
+    }
+
+  // Build the cascade of transforms. Each stage is initialized with the
+  // result of the previous one.
+  std::vector<MatrixOffsetTransformType::Pointer> stages;
+  stages.push_back( RigidTransformType::New().GetPointer() );
+  if( transformType == "similarity" || transformType == "affine" )
+    {
+    stages.push_back( SimilarityTransformType::New().GetPointer() );
+    }
+  if( transformType == "affine" )
+    {
+    stages.push_back( AffineTransformType::New().GetPointer() );
+    }
+
+  // Rotate and scale around the center of the fixed image
+  FixedImageType::Pointer fixedImage = fixedImageReader->GetOutput();
+  itk::ContinuousIndex<double, Dimension> centerContinuousIndex;
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    centerContinuousIndex[d] = fixedImage->GetLargestPossibleRegion().GetIndex()[d] +
+      0.5 * ( fixedImage->GetLargestPossibleRegion().GetSize()[d] - 1 );
+    }
+  MatrixOffsetTransformType::PointType center;
+  fixedImage->TransformContinuousIndexToPhysicalPoint( centerContinuousIndex, center );
+
+  MatrixOffsetTransformType::Pointer previous = NULL;
+  for( unsigned int s = 0; s < stages.size(); s++ )
+    {
+    MatrixOffsetTransformType::Pointer transform = stages[s];
+    transform->SetCenter( center );
+    if( previous )
+      {
+      transform->SetMatrix( previous->GetMatrix() );
+      transform->SetTranslation( previous->GetTranslation() );
+      }
+
+    std::cout << "Stage " << s << ": " << transform->GetNameOfClass() << std::endl;
+
+    MetricType::Pointer         metric        = MetricType::New();
+    OptimizerType::Pointer      optimizer     = OptimizerType::New();
+    InterpolatorType::Pointer   interpolator  = InterpolatorType::New();
+    RegistrationType::Pointer   registration  = RegistrationType::New();
+
+    registration->SetMetric( metric );
+    registration->SetOptimizer( optimizer );
+    registration->SetInterpolator( interpolator );
+    registration->SetTransform( transform );
+    registration->SetFixedImage( fixedImageReader->GetOutput() );
+    registration->SetMovingImage( movingImageReader->GetOutput() );
+    registration->SetNumberOfLevels( numberOfLevels );
+    registration->SetNumberOfIterationsPerLevel( iterationsPerLevel );
+    registration->SetInitialTransformParameters( transform->GetParameters() );
+
+    CommandIterationUpdate::Pointer observer = CommandIterationUpdate::New();
+    optimizer->AddObserver( itk::IterationEvent(), observer );
+
+    typedef RegistrationLevelUpdate<RegistrationType> LevelObserverType;
+    LevelObserverType::Pointer levelObserver = LevelObserverType::New();
+    registration->AddObserver( itk::IterationEvent(), levelObserver );
+
+    try
+      {
+      registration->StartRegistration();
+      }
+    catch( itk::ExceptionObject & err )
+      {
+      std::cerr << "ExceptionObject caught !" << std::endl;
+      std::cerr << err << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    std::cout << " Parameters    = " << registration->GetLastTransformParameters() << std::endl;
+    std::cout << " Stop code     = " << optimizer->GetStopConditionDescription() << std::endl;
+    std::cout << " Metric value  = " << optimizer->GetOptimalValue() << std::endl;
+
+    previous = transform;
+    }
+
+  // Write the result as a standard affine transform
+  typedef itk::AffineTransform<double, Dimension> ITKAffineTransformType;
+  ITKAffineTransformType::Pointer affine = ITKAffineTransformType::New();
+  affine->SetCenter( previous->GetCenter() );
+  affine->SetMatrix( previous->GetMatrix() );
+  affine->SetTranslation( previous->GetTranslation() );
+
+  std::string outputPrefix( argv[3] );
+
+  typedef itk::TransformFileWriter TransformWriterType;
+  TransformWriterType::Pointer transformWriter = TransformWriterType::New();
+  transformWriter->SetInput( affine );
+  transformWriter->SetFileName( ( outputPrefix + std::string( "Affine.txt" ) ).c_str() );
+  transformWriter->Update();
+
+  typedef itk::ResampleImageFilter<
+                            MovingImageType,
+                            FixedImageType >    ResampleFilterType;
+
+  ResampleFilterType::Pointer resampler = ResampleFilterType::New();
+  resampler->SetInput( movingImageReader->GetOutput() );
+  resampler->SetTransform( affine );
+  resampler->SetSize( fixedImage->GetLargestPossibleRegion().GetSize() );
+  resampler->SetOutputOrigin(  fixedImage->GetOrigin() );
+  resampler->SetOutputSpacing( fixedImage->GetSpacing() );
+  resampler->SetOutputDirection( fixedImage->GetDirection() );
+  resampler->SetDefaultPixelValue( 0 );
+
+  typedef itk::ImageFileWriter< FixedImageType >  WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName( ( outputPrefix + std::string( "Warped.nii.gz" ) ).c_str() );
+  writer->SetInput( resampler->GetOutput() );
+  writer->Update();
+
+  return EXIT_SUCCESS;
+}
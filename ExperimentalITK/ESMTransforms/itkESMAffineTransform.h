@@ -0,0 +1,139 @@
+#ifndef MZ_ESMAffineTransform_H_
+#define MZ_ESMAffineTransform_H_
+
+#include "itkESMMatrixOffsetTransformBase.h"
+
+#include <iostream>
+#include <itkExceptionObject.h>
+#include <vnl/vnl_det.h>
+
+namespace itk
+{
+
+/** \class ESMAffineTransform
+ * \brief ESMAffineTransform of a vector space (e.g. space coordinates)
+ *
+ * This transform applies a general affine transformation around an
+ * arbitrary center. The parameters are the ones of
+ * ESMMatrixOffsetTransformBase, i.e. the NDimensions x NDimensions matrix
+ * entries in row-major order followed by the translation.
+ *
+ * The incremental update is performed in the Lie group of homogeneous
+ * affine matrices: the update vector is interpreted as an element of the
+ * Lie algebra (same layout as the parameters) and mapped back to the group
+ * with the matrix exponential.
+ *
+ * \sa ESMMatrixOffsetTransformBase
+ * \sa ESMRigid3DTransform
+ * \sa ESMSimilarity3DTransform
+ *
+ * \ingroup Transforms
+ */
+template <
+   class TScalarType=double,   // Data type for scalars
+   unsigned int NDimensions=3> // Number of dimensions in the space
+class ITK_EXPORT ESMAffineTransform :
+      public ESMMatrixOffsetTransformBase< TScalarType, NDimensions >
+{
+public:
+   /** Standard class typedefs. */
+   typedef ESMAffineTransform                             Self;
+   typedef ESMMatrixOffsetTransformBase< TScalarType,
+                                         NDimensions >    Superclass;
+   typedef SmartPointer<Self>                             Pointer;
+   typedef SmartPointer<const Self>                       ConstPointer;
+
+   /** Run-time type information (and related methods). */
+   itkTypeMacro( ESMAffineTransform, ESMMatrixOffsetTransformBase );
+
+   /** New macro for creation of through a Smart Pointer */
+   itkNewMacro( Self );
+
+   /** Dimension of the space. */
+   itkStaticConstMacro(SpaceDimension, unsigned int, NDimensions);
+   itkStaticConstMacro(ParametersDimension, unsigned int,
+                       NDimensions*(NDimensions+1));
+
+   /** Scalar type. */
+   typedef typename Superclass::ScalarType      ScalarType;
+
+   /** Parameters type. */
+   typedef typename Superclass::ParametersType  ParametersType;
+
+   /** Jacobian type. */
+   typedef typename Superclass::JacobianType    JacobianType;
+
+   /// Standard matrix type for this class
+   typedef typename Superclass::MatrixType      MatrixType;
+
+   /// Standard vector type for this class
+   typedef typename Superclass::OffsetType      OffsetType;
+
+   /// Standard vector type for this class
+   typedef typename Superclass::VectorType      VectorType;
+
+   /// Standard coordinate point type for this class
+   typedef typename Superclass::PointType       PointType;
+
+   /** Base inverse transform type. This type should not be changed to the
+    * concrete inverse transform type or inheritance would be lost.*/
+   typedef typename Superclass::InverseESMTransformBaseType InverseESMTransformBaseType;
+   typedef typename InverseESMTransformBaseType::Pointer    InverseESMTransformBasePointer;
+
+   /** Return an inverse of this transform. Returns a null pointer
+    * if the matrix is singular. */
+   virtual InverseESMTransformBasePointer GetInverseESMTransform() const
+   {
+      const MatrixType & mat = this->GetMatrix();
+      if( vnl_det( mat.GetVnlMatrix() ) == 0.0 )
+      {
+         return NULL;
+      }
+      const MatrixType invmat( mat.GetInverse() );
+
+      Pointer inverse = New();
+      inverse->SetCenter( this->GetCenter() );
+      inverse->SetMatrix( invmat );
+      inverse->SetOffset( -( invmat * this->GetOffset() ) );
+
+      return inverse.GetPointer();
+   }
+
+   /**
+    * This method creates and returns a new ESMAffineTransform object
+    * which has the same parameters.
+    */
+   void CloneTo( Pointer & result ) const
+   {
+      result = New();
+      result->SetFixedParameters( this->GetFixedParameters() );
+      result->SetParameters( this->GetParameters() );
+   }
+
+protected:
+   ESMAffineTransform()
+      : Superclass(SpaceDimension, ParametersDimension)
+   {
+      this->m_FixedParameters.SetSize( NDimensions );
+      this->m_FixedParameters.Fill( 0.0 );
+   }
+
+   ESMAffineTransform( unsigned int outputSpaceDimension,
+                       unsigned int parametersDimension )
+      : Superclass(outputSpaceDimension, parametersDimension)
+   {
+   }
+
+   ~ESMAffineTransform()
+   {
+   }
+
+private:
+   ESMAffineTransform(const Self&); //purposely not implemented
+   void operator=(const Self&); //purposely not implemented
+
+}; //class ESMAffineTransform
+
+}  // namespace itk
+
+#endif /* MZ_ESMAffineTransform_H_ */
@@ -0,0 +1,220 @@
+#ifndef MZ_ESMMultiResolutionImageRegistrationMethod_H_
+#define MZ_ESMMultiResolutionImageRegistrationMethod_H_
+
+#include "itkESMImageToImageMetric.h"
+#include "itkESMOptimizerBase.h"
+#include "itkESMTransform.h"
+
+#include "itkArray.h"
+#include "itkArray2D.h"
+#include "itkMultiResolutionPyramidImageFilter.h"
+#include "itkObject.h"
+
+namespace itk
+{
+
+/** \class ESMMultiResolutionImageRegistrationMethod
+ * \brief Coarse-to-fine driver for ESM image registration.
+ *
+ * This class runs an ESM optimizer (e.g. ESMDogLegOptimizer) on a sequence
+ * of image pyramid levels. At each level the ESM metric is connected to the
+ * downsampled fixed and moving images, the optimizer is started from the
+ * parameters found at the previous level and the result is propagated to
+ * the next one. Since the ESM transforms are parameterized in physical
+ * space the parameters do not need to be rescaled between levels.
+ *
+ * Because the ESM optimizers have a quadratic convergence rate close to the
+ * solution, a few iterations per level are usually sufficient.
+ *
+ * An IterationEvent is invoked at the beginning of every level so that
+ * observers can adjust the optimizer or the metric (number of samples,
+ * trust region radius, ...) for that level.
+ *
+ * \sa ESMDogLegOptimizer
+ * \sa ESMImageToImageMetric
+ * \sa MultiResolutionPyramidImageFilter
+ *
+ * \ingroup RegistrationFilters
+ */
+template <class TFixedImage, class TMovingImage>
+class ITK_EXPORT ESMMultiResolutionImageRegistrationMethod : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef ESMMultiResolutionImageRegistrationMethod  Self;
+  typedef Object                                     Superclass;
+  typedef SmartPointer<Self>                         Pointer;
+  typedef SmartPointer<const Self>                   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ESMMultiResolutionImageRegistrationMethod, Object );
+
+  /**  Type of the Fixed image. */
+  typedef          TFixedImage                       FixedImageType;
+  typedef typename FixedImageType::ConstPointer      FixedImageConstPointer;
+  typedef typename FixedImageType::RegionType        FixedImageRegionType;
+
+  /**  Type of the Moving image. */
+  typedef          TMovingImage                      MovingImageType;
+  typedef typename MovingImageType::ConstPointer     MovingImageConstPointer;
+
+  itkStaticConstMacro( ImageDimension, unsigned int,
+                       TFixedImage::ImageDimension );
+
+  /**  Type of the metric. */
+  typedef ESMImageToImageMetric<FixedImageType,
+                                MovingImageType>     MetricType;
+  typedef typename MetricType::Pointer               MetricPointer;
+
+  /**  Type of the Transform . */
+  typedef typename MetricType::ESMTransformType      TransformType;
+  typedef typename TransformType::Pointer            TransformPointer;
+
+  /**  Type of the Interpolator. */
+  typedef typename MetricType::InterpolatorType      InterpolatorType;
+  typedef typename InterpolatorType::Pointer         InterpolatorPointer;
+
+  /**  Type of the optimizer. */
+  typedef ESMOptimizerBase<FixedImageType,
+                           MovingImageType>          OptimizerType;
+  typedef typename OptimizerType::Pointer            OptimizerPointer;
+
+  /** Type of the Fixed image multiresolution pyramid. */
+  typedef MultiResolutionPyramidImageFilter<FixedImageType,
+                                            FixedImageType>
+                                                     FixedImagePyramidType;
+  typedef typename FixedImagePyramidType::Pointer    FixedImagePyramidPointer;
+
+  /** Type of the moving image multiresolution pyramid. */
+  typedef MultiResolutionPyramidImageFilter<MovingImageType,
+                                            MovingImageType>
+                                                     MovingImagePyramidType;
+  typedef typename MovingImagePyramidType::Pointer   MovingImagePyramidPointer;
+
+  /** Type of the shrink factor schedule. */
+  typedef Array2D<unsigned int>                      ScheduleType;
+
+  /** Type of the per-level number of iterations. */
+  typedef Array<unsigned long>                       IterationsArrayType;
+
+  /** Type of the Transformation parameters This is the same type used to
+   *  represent the search space of the optimization algorithm */
+  typedef typename MetricType::TransformParametersType ParametersType;
+
+  /** Method to stop the registration. */
+  void StopRegistration( void );
+
+  /** Set/Get the Fixed image. */
+  itkSetConstObjectMacro( FixedImage, FixedImageType );
+  itkGetConstObjectMacro( FixedImage, FixedImageType );
+
+  /** Set/Get the Moving image. */
+  itkSetConstObjectMacro( MovingImage, MovingImageType );
+  itkGetConstObjectMacro( MovingImage, MovingImageType );
+
+  /** Set/Get the Optimizer. */
+  itkSetObjectMacro( Optimizer,  OptimizerType );
+  itkGetObjectMacro( Optimizer,  OptimizerType );
+
+  /** Set/Get the Metric. */
+  itkSetObjectMacro( Metric, MetricType );
+  itkGetObjectMacro( Metric, MetricType );
+
+  /** Set/Get the Transfrom. */
+  itkSetObjectMacro( Transform, TransformType );
+  itkGetObjectMacro( Transform, TransformType );
+
+  /** Set/Get the Interpolator. */
+  itkSetObjectMacro( Interpolator, InterpolatorType );
+  itkGetObjectMacro( Interpolator, InterpolatorType );
+
+  /** Set/Get the Fixed image pyramid. */
+  itkSetObjectMacro( FixedImagePyramid, FixedImagePyramidType );
+  itkGetObjectMacro( FixedImagePyramid, FixedImagePyramidType );
+
+  /** Set/Get the Moving image pyramid. */
+  itkSetObjectMacro( MovingImagePyramid, MovingImagePyramidType );
+  itkGetObjectMacro( MovingImagePyramid, MovingImagePyramidType );
+
+  /** Set/Get the region of the fixed image at full resolution used by
+   *  the metric. By default the buffered region of the fixed image. */
+  void SetFixedImageRegion( const FixedImageRegionType & region );
+  itkGetConstReferenceMacro( FixedImageRegion, FixedImageRegionType );
+
+  /** Set/Get the number of multi-resolution levels. */
+  itkSetClampMacro( NumberOfLevels, unsigned long, 1,
+                    NumericTraits<unsigned long>::max() );
+  itkGetConstMacro( NumberOfLevels, unsigned long );
+
+  /** Set the maximum number of optimizer iterations at each level. If
+   *  not set the optimizer setting is used for all the levels. */
+  void SetNumberOfIterationsPerLevel( const IterationsArrayType & iterations );
+  itkGetConstReferenceMacro( NumberOfIterationsPerLevel, IterationsArrayType );
+
+  /** Get the current resolution level being processed. */
+  itkGetConstMacro( CurrentLevel, unsigned long );
+
+  /** Set/Get the initial transformation parameters. */
+  itkSetMacro( InitialTransformParameters, ParametersType );
+  itkGetConstReferenceMacro( InitialTransformParameters, ParametersType );
+
+  /** Get the last transformation parameters visited by
+   * the optimizer. */
+  itkGetConstReferenceMacro( LastTransformParameters, ParametersType );
+
+  /** Method that initiates the registration. */
+  void StartRegistration( void );
+
+protected:
+  ESMMultiResolutionImageRegistrationMethod();
+  virtual ~ESMMultiResolutionImageRegistrationMethod() {};
+  void PrintSelf( std::ostream& os, Indent indent ) const;
+
+  /** Initialize by setting the interconnects between the components.
+      This method is executed at every level of the pyramid with the
+      values corresponding to this resolution. */
+  void Initialize() throw ( ExceptionObject );
+
+  /** Compute the size of the fixed region for each level of the pyramid. */
+  void PreparePyramids( void );
+
+private:
+  ESMMultiResolutionImageRegistrationMethod(const Self&); //purposely not implemented
+  void operator=(const Self&); //purposely not implemented
+
+  MetricPointer                    m_Metric;
+  OptimizerPointer                 m_Optimizer;
+
+  MovingImageConstPointer          m_MovingImage;
+  FixedImageConstPointer           m_FixedImage;
+
+  TransformPointer                 m_Transform;
+  InterpolatorPointer              m_Interpolator;
+
+  MovingImagePyramidPointer        m_MovingImagePyramid;
+  FixedImagePyramidPointer         m_FixedImagePyramid;
+
+  ParametersType                   m_InitialTransformParameters;
+  ParametersType                   m_InitialTransformParametersOfNextLevel;
+  ParametersType                   m_LastTransformParameters;
+
+  FixedImageRegionType             m_FixedImageRegion;
+  bool                             m_FixedImageRegionDefined;
+  std::vector<FixedImageRegionType> m_FixedImageRegionPyramid;
+
+  IterationsArrayType              m_NumberOfIterationsPerLevel;
+
+  unsigned long                    m_NumberOfLevels;
+  unsigned long                    m_CurrentLevel;
+
+  bool                             m_Stop;
+};
+
+} // end namespace itk
+
+#include "itkESMMultiResolutionImageRegistrationMethod.hxx"
+
+#endif
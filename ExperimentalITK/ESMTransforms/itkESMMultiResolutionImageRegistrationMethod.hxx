@@ -0,0 +1,308 @@
+#ifndef MZ_ESMMultiResolutionImageRegistrationMethod_TXX_
+#define MZ_ESMMultiResolutionImageRegistrationMethod_TXX_
+
+#include "itkESMMultiResolutionImageRegistrationMethod.h"
+
+#include <vnl/vnl_math.h>
+
+namespace itk
+{
+
+/*
+ * Constructor
+ */
+template <class TFixedImage, class TMovingImage>
+ESMMultiResolutionImageRegistrationMethod<TFixedImage,TMovingImage>
+::ESMMultiResolutionImageRegistrationMethod()
+   :m_Metric(0)
+   ,m_Optimizer(0)
+   ,m_MovingImage(0)
+   ,m_FixedImage(0)
+   ,m_Transform(0)
+   ,m_Interpolator(0)
+   ,m_FixedImageRegionDefined(false)
+   ,m_NumberOfLevels(1)
+   ,m_CurrentLevel(0)
+   ,m_Stop(false)
+{
+   m_MovingImagePyramid = MovingImagePyramidType::New();
+   m_FixedImagePyramid  = FixedImagePyramidType::New();
+
+   m_InitialTransformParameters = ParametersType(1);
+   m_InitialTransformParametersOfNextLevel = ParametersType(1);
+   m_LastTransformParameters = ParametersType(1);
+
+   m_InitialTransformParameters.Fill( 0.0f );
+   m_InitialTransformParametersOfNextLevel.Fill( 0.0f );
+   m_LastTransformParameters.Fill( 0.0f );
+}
+
+
+/*
+ * Set the region of the fixed image to be considered for registration
+ */
+template <class TFixedImage, class TMovingImage>
+void
+ESMMultiResolutionImageRegistrationMethod<TFixedImage,TMovingImage>
+::SetFixedImageRegion( const FixedImageRegionType & region )
+{
+   m_FixedImageRegion = region;
+   m_FixedImageRegionDefined = true;
+   this->Modified();
+}
+
+
+/*
+ * Set the number of iterations for each level
+ */
+template <class TFixedImage, class TMovingImage>
+void
+ESMMultiResolutionImageRegistrationMethod<TFixedImage,TMovingImage>
+::SetNumberOfIterationsPerLevel( const IterationsArrayType & iterations )
+{
+   m_NumberOfIterationsPerLevel = iterations;
+   this->Modified();
+}
+
+
+/*
+ * Stop the Registration Process
+ */
+template <class TFixedImage, class TMovingImage>
+void
+ESMMultiResolutionImageRegistrationMethod<TFixedImage,TMovingImage>
+::StopRegistration( void )
+{
+   m_Stop = true;
+}
+
+
+/*
+ * Initialize by setting the interconnects between components.
+ */
+template <class TFixedImage, class TMovingImage>
+void
+ESMMultiResolutionImageRegistrationMethod<TFixedImage,TMovingImage>
+::Initialize() throw (ExceptionObject)
+{
+   // Sanity checks
+   if ( !m_Metric )
+   {
+      itkExceptionMacro(<<"Metric is not present" );
+   }
+
+   if ( !m_Optimizer )
+   {
+      itkExceptionMacro(<<"Optimizer is not present" );
+   }
+
+   if( !m_Transform )
+   {
+      itkExceptionMacro(<<"Transform is not present");
+   }
+
+   if( !m_Interpolator )
+   {
+      itkExceptionMacro(<<"Interpolator is not present");
+   }
+
+   // Setup the metric
+   m_Metric->SetMovingImage( m_MovingImagePyramid->GetOutput(m_CurrentLevel) );
+   m_Metric->SetFixedImage( m_FixedImagePyramid->GetOutput(m_CurrentLevel) );
+   m_Metric->SetESMTransform( m_Transform );
+   m_Metric->SetInterpolator( m_Interpolator );
+   m_Metric->SetFixedImageRegion( m_FixedImageRegionPyramid[ m_CurrentLevel ] );
+
+   // Setup the optimizer
+   m_Optimizer->SetESMCostFunction( m_Metric );
+   m_Optimizer->SetInitialPosition( m_InitialTransformParametersOfNextLevel );
+
+   if ( m_NumberOfIterationsPerLevel.Size() > 0 )
+   {
+      const unsigned long level = vnl_math_min(
+         m_CurrentLevel, static_cast<unsigned long>( m_NumberOfIterationsPerLevel.Size() - 1 ) );
+      m_Optimizer->SetMaximumNumberOfIterations( m_NumberOfIterationsPerLevel[level] );
+   }
+}
+
+
+/*
+ * Compute the size of the fixed region for each level of the pyramid.
+ */
+template <class TFixedImage, class TMovingImage>
+void
+ESMMultiResolutionImageRegistrationMethod<TFixedImage,TMovingImage>
+::PreparePyramids( void )
+{
+   if( !m_Transform )
+   {
+      itkExceptionMacro(<<"Transform is not present");
+   }
+
+   m_InitialTransformParametersOfNextLevel = m_InitialTransformParameters;
+
+   if ( m_InitialTransformParametersOfNextLevel.Size() !=
+        m_Transform->GetNumberOfParameters() )
+   {
+      itkExceptionMacro(<<"Size mismatch between initial parameter and transform");
+   }
+
+   // Sanity checks
+   if( !m_FixedImage )
+   {
+      itkExceptionMacro(<<"FixedImage is not present");
+   }
+
+   if( !m_MovingImage )
+   {
+      itkExceptionMacro(<<"MovingImage is not present");
+   }
+
+   if( !m_FixedImageRegionDefined )
+   {
+      m_FixedImageRegion = m_FixedImage->GetBufferedRegion();
+   }
+
+   // Setup the fixed image pyramid
+   m_FixedImagePyramid->SetNumberOfLevels( m_NumberOfLevels );
+   m_FixedImagePyramid->SetInput( m_FixedImage );
+   m_FixedImagePyramid->UpdateLargestPossibleRegion();
+
+   // Setup the moving image pyramid
+   m_MovingImagePyramid->SetNumberOfLevels( m_NumberOfLevels );
+   m_MovingImagePyramid->SetInput( m_MovingImage );
+   m_MovingImagePyramid->UpdateLargestPossibleRegion();
+
+   typedef typename FixedImageRegionType::SizeType         SizeType;
+   typedef typename FixedImageRegionType::IndexType        IndexType;
+
+   ScheduleType schedule = m_FixedImagePyramid->GetSchedule();
+
+   SizeType  inputSize  = m_FixedImageRegion.GetSize();
+   IndexType inputStart = m_FixedImageRegion.GetIndex();
+
+   m_FixedImageRegionPyramid.resize( m_NumberOfLevels );
+   for ( unsigned int level=0; level < m_NumberOfLevels; level++ )
+   {
+      SizeType  size;
+      IndexType start;
+      for ( unsigned int dim = 0; dim < ImageDimension; dim++)
+      {
+         const float scaleFactor = static_cast<float>( schedule[ level ][ dim ] );
+
+         size[ dim ] = static_cast<typename SizeType::SizeValueType>(
+            vcl_floor( static_cast<float>( inputSize[ dim ] ) / scaleFactor ) );
+         if( size[ dim ] < 1 )
+         {
+            size[ dim ] = 1;
+         }
+
+         start[ dim ] = static_cast<typename IndexType::IndexValueType>(
+            vcl_ceil(  static_cast<float>( inputStart[ dim ] ) / scaleFactor ) );
+      }
+      m_FixedImageRegionPyramid[ level ].SetSize( size );
+      m_FixedImageRegionPyramid[ level ].SetIndex( start );
+   }
+}
+
+
+/*
+ * Starts the Registration Process
+ */
+template <class TFixedImage, class TMovingImage>
+void
+ESMMultiResolutionImageRegistrationMethod<TFixedImage,TMovingImage>
+::StartRegistration( void )
+{
+   m_Stop = false;
+
+   this->PreparePyramids();
+
+   for ( m_CurrentLevel = 0; m_CurrentLevel < m_NumberOfLevels;
+         m_CurrentLevel++ )
+   {
+      // Invoke an iteration event.
+      // This allows a UI to reset any of the components between
+      // resolution level.
+      this->InvokeEvent( IterationEvent() );
+
+      // Check if there has been a stop request
+      if ( m_Stop )
+      {
+         break;
+      }
+
+      try
+      {
+         // initialize the interconnects between components
+         this->Initialize();
+      }
+      catch( ExceptionObject& err )
+      {
+         m_LastTransformParameters = ParametersType(1);
+         m_LastTransformParameters.Fill( 0.0f );
+
+         // pass exception to caller
+         throw err;
+      }
+
+      m_Optimizer->StartOptimization();
+
+      // Keep the best parameters visited at this level. The ESM optimizer
+      // only accepts an update when it decreases the cost function so these
+      // are also the parameters of the last accepted step.
+      m_LastTransformParameters = m_Optimizer->GetOptimalParameters();
+      m_Transform->SetParameters( m_LastTransformParameters );
+
+      // setup the initial parameters for next level
+      if ( m_CurrentLevel < m_NumberOfLevels - 1 )
+      {
+         m_InitialTransformParametersOfNextLevel =
+            m_LastTransformParameters;
+      }
+   }
+}
+
+
+/*
+ * PrintSelf
+ */
+template <class TFixedImage, class TMovingImage>
+void
+ESMMultiResolutionImageRegistrationMethod<TFixedImage,TMovingImage>
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+   Superclass::PrintSelf( os, indent );
+   os << indent << "Metric: " << m_Metric.GetPointer() << std::endl;
+   os << indent << "Optimizer: " << m_Optimizer.GetPointer() << std::endl;
+   os << indent << "Transform: " << m_Transform.GetPointer() << std::endl;
+   os << indent << "Interpolator: " << m_Interpolator.GetPointer() << std::endl;
+   os << indent << "FixedImage: " << m_FixedImage.GetPointer() << std::endl;
+   os << indent << "MovingImage: " << m_MovingImage.GetPointer() << std::endl;
+   os << indent << "FixedImagePyramid: ";
+   os << m_FixedImagePyramid.GetPointer() << std::endl;
+   os << indent << "MovingImagePyramid: ";
+   os << m_MovingImagePyramid.GetPointer() << std::endl;
+
+   os << indent << "NumberOfLevels: ";
+   os << m_NumberOfLevels << std::endl;
+
+   os << indent << "CurrentLevel: ";
+   os << m_CurrentLevel << std::endl;
+
+   os << indent << "NumberOfIterationsPerLevel: ";
+   os << m_NumberOfIterationsPerLevel << std::endl;
+
+   os << indent << "InitialTransformParameters: ";
+   os << m_InitialTransformParameters << std::endl;
+   os << indent << "InitialTransformParametersOfNextLevel: ";
+   os << m_InitialTransformParametersOfNextLevel << std::endl;
+   os << indent << "LastTransformParameters: ";
+   os << m_LastTransformParameters << std::endl;
+   os << indent << "FixedImageRegion: ";
+   os << m_FixedImageRegion << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef MZ_ESMRigid3DTransform_H_
+#define MZ_ESMRigid3DTransform_H_
+
+#include "itkESMMatrixOffsetTransformBase.h"
+
+#include <iostream>
+#include <itkExceptionObject.h>
+
+namespace itk
+{
+
+/** \class ESMRigid3DTransform
+ * \brief ESMRigid3DTransform of a vector space (e.g. space coordinates)
+ *
+ * This transform applies a rigid transformation in 3D space.
+ * The transform is specified as a rotation around a arbitrary center
+ * and is followed by a translation.
+ *
+ * The rotation is parameterized by its rotation vector (axis times angle
+ * in radians), i.e. by the logarithm of the rotation matrix in so(3).
+ * Incremental updates are performed in the Lie group SE(3) using the
+ * closed-form (Rodrigues) exponential so that no numerical matrix
+ * exponential is required.
+ *
+ * The serialization of the optimizable parameters is an array of 6 elements
+ * ordered as follows:
+ * p[0] = x component of the rotation vector
+ * p[1] = y component of the rotation vector
+ * p[2] = z component of the rotation vector
+ * p[3] = x component of the translation
+ * p[4] = y component of the translation
+ * p[5] = z component of the translation
+ *
+ * The serialization of the fixed parameters is an array of 3 elements
+ * ordered as follows:
+ * p[0] = x coordinate of the center
+ * p[1] = y coordinate of the center
+ * p[2] = z coordinate of the center
+ *
+ * The incremental update vector has the same layout as the parameters,
+ * i.e. (omega, v) in se(3).
+ *
+ * \sa ESMRigid2DTransform
+ * \sa ESMMatrixOffsetTransformBase
+ *
+ * \ingroup Transforms
+ */
+template < class TScalarType=double >    // Data type for scalars (float or double)
+class ITK_EXPORT ESMRigid3DTransform :
+      public ESMMatrixOffsetTransformBase< TScalarType, 3> // Dimensions of input and output spaces
+{
+public:
+   /** Standard class typedefs. */
+   typedef ESMRigid3DTransform                            Self;
+   typedef ESMMatrixOffsetTransformBase< TScalarType, 3 > Superclass;
+   typedef SmartPointer<Self>                             Pointer;
+   typedef SmartPointer<const Self>                       ConstPointer;
+
+   /** Run-time type information (and related methods). */
+   itkTypeMacro( ESMRigid3DTransform, ESMMatrixOffsetTransformBase );
+
+   /** New macro for creation of through a Smart Pointer */
+   itkNewMacro( Self );
+
+   /** Dimension of the space. */
+   itkStaticConstMacro(SpaceDimension, unsigned int, 3);
+   itkStaticConstMacro(ParametersDimension, unsigned int, 6);
+
+   /** Scalar type. */
+   typedef typename Superclass::ScalarType      ScalarType;
+
+   /** Parameters type. */
+   typedef typename Superclass::ParametersType  ParametersType;
+
+   /** Jacobian type. */
+   typedef typename Superclass::JacobianType    JacobianType;
+
+   /// Standard matrix type for this class
+   typedef typename Superclass::MatrixType      MatrixType;
+
+   /// Standard vector type for this class
+   typedef typename Superclass::OffsetType      OffsetType;
+
+   /// Standard vector type for this class
+   typedef typename Superclass::VectorType      VectorType;
+
+   /// Standard covariant vector type for this class
+   typedef typename Superclass::CovariantVectorType CovariantVectorType;
+
+   /// Standard vnl_vector type for this class
+   typedef typename Superclass::VnlVectorType   VnlVectorType;
+
+   /// Standard coordinate point type for this class
+   typedef typename Superclass::PointType       PointType;
+
+   /** Base inverse transform type. This type should not be changed to the
+    * concrete inverse transform type or inheritance would be lost.*/
+   typedef typename Superclass::InverseESMTransformBaseType InverseESMTransformBaseType;
+   typedef typename InverseESMTransformBaseType::Pointer    InverseESMTransformBasePointer;
+
+   /**
+    * Set the rotation Matrix of a Rigid3D Transform
+    *
+    * This method sets the 3x3 matrix representing the rotation
+    * in the transform.  The Matrix is expected to be orthogonal
+    * with a certain tolerance.
+    *
+    * \warning This method will throw an exception is the matrix
+    * provided as argument is not orthogonal.
+    *
+    * \sa ESMMatrixOffsetTransformBase::SetMatrix()
+    */
+   virtual void SetMatrix( const MatrixType & matrix );
+
+   /**
+    * Compose the transformation with a translation
+    *
+    * This method modifies self to include a translation of the
+    * origin.
+    */
+   void Translate(const OffsetType &offset, bool pre=false);
+
+   /** Set/Get the rotation vector (axis times angle in radians) */
+   void SetRotationVector( const VectorType & rotation );
+   itkGetConstReferenceMacro( RotationVector, VectorType );
+
+   /** Set the transformation from a container of parameters
+    * This is typically used by optimizers.
+    * There are 6 parameters. The first three represent the
+    * rotation vector and the last three represent the translation.
+    * The center of rotation is fixed.
+    *
+    * \sa Transform::SetParameters()
+    * \sa Transform::SetFixedParameters() */
+   void SetParameters( const ParametersType & parameters );
+
+   /** Get the parameters that uniquely define the transform
+    * This is typically used by optimizers.
+    *
+    * \sa Transform::GetParameters()
+    * \sa Transform::GetFixedParameters() */
+   const ParametersType & GetParameters( void ) const;
+
+   /** This method computes the Jacobian matrix of the transformation
+    * at a given input point w.r.t. the rotation vector and translation.
+    * The rotation part is evaluated with the exact derivative of the
+    * Rodrigues formula.
+    *
+    * \sa Transform::GetJacobian() */
+   const JacobianType & GetJacobian(const PointType  &point ) const;
+
+   /** Return an inverse of this transform. */
+   virtual InverseESMTransformBasePointer GetInverseESMTransform() const;
+
+   /**
+    * This method creates and returns a new ESMRigid3DTransform object
+    * which has the same parameters.
+    */
+   void CloneTo( Pointer & clone ) const;
+
+   /** Reset the parameters to create and identity transform. */
+   virtual void SetIdentity(void);
+
+   /** Use the given update vector to update the current transform
+    *  this <- this o exp ( update ) with the closed-form SE(3) exponential
+    */
+   virtual void IncrementalUpdate( const ParametersType & updatevector );
+
+   virtual const JacobianType & GetIncrementalUpdateJacobian(const PointType  & point ) const;
+
+protected:
+   ESMRigid3DTransform();
+   ESMRigid3DTransform( unsigned int outputSpaceDimension,
+                        unsigned int parametersDimension);
+
+   ~ESMRigid3DTransform();
+
+   /**
+    * Print contents of an ESMRigid3DTransform
+    */
+   void PrintSelf(std::ostream &os, Indent indent) const;
+
+   /** Compute the matrix from the rotation vector. This is used in Set
+    * methods to update the underlying matrix whenever a transform parameter
+    * is changed. */
+   virtual void ComputeMatrix(void);
+
+   /** Compute the rotation vector from the matrix (logarithm of SO(3)).
+    * This is used in ESMMatrixOffsetTransformBase::Compose() and
+    * ESMMatrixOffsetTransformBase::GetInverse(). */
+   virtual void ComputeMatrixParameters(void);
+
+   /** Update the rotation vector without recomputation of other internal
+    * variables. */
+   void SetVarRotationVector( const VectorType & rotation )
+   {
+      m_RotationVector = rotation;
+   }
+
+   /** Fill the coefficients of the Rodrigues formula
+    *  exp([w]x) = I + a [w]x + b [w]x^2  and
+    *  V(w)      = I + b [w]x + c [w]x^2  (left Jacobian of SO(3))
+    *  for a rotation vector of squared norm theta2. */
+   static void GetRodriguesCoefficients( TScalarType theta2,
+                                         TScalarType & a,
+                                         TScalarType & b,
+                                         TScalarType & c );
+
+private:
+   ESMRigid3DTransform(const Self&); //purposely not implemented
+   void operator=(const Self&); //purposely not implemented
+
+   VectorType          m_RotationVector;
+
+}; //class ESMRigid3DTransform
+
+}  // namespace itk
+
+#include "itkESMRigid3DTransform.hxx"
+
+#endif /* MZ_ESMRigid3DTransform_H_ */
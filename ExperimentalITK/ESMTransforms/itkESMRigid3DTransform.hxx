@@ -0,0 +1,473 @@
+#ifndef MZ_ESMRigid3DTransform_TXX_
+#define MZ_ESMRigid3DTransform_TXX_
+
+#include "itkESMRigid3DTransform.h"
+
+#include <vnl/vnl_math.h>
+#include <vnl/vnl_matrix_fixed.h>
+#include <vnl/vnl_det.h>
+
+
+namespace itk
+{
+
+// Constructor with default arguments
+template<class TScalarType>
+ESMRigid3DTransform<TScalarType>::
+ESMRigid3DTransform():
+   Superclass(SpaceDimension, ParametersDimension)
+{
+   m_RotationVector.Fill( NumericTraits< TScalarType >::Zero );
+
+   this->m_IncrementalUpdateJacobian.Fill( 0.0 );
+   for( unsigned int dim=0; dim < SpaceDimension; dim++ )
+   {
+      this->m_IncrementalUpdateJacobian(dim,SpaceDimension+dim) = 1.0;
+   }
+}
+
+
+// Constructor with arguments
+template<class TScalarType>
+ESMRigid3DTransform<TScalarType>::
+ESMRigid3DTransform( unsigned int spaceDimension,
+                     unsigned int parametersDimension):
+   Superclass(spaceDimension,parametersDimension)
+{
+   m_RotationVector.Fill( NumericTraits< TScalarType >::Zero );
+
+   this->m_IncrementalUpdateJacobian.Fill( 0.0 );
+   for( unsigned int dim=0; dim < SpaceDimension; dim++ )
+   {
+      this->m_IncrementalUpdateJacobian(dim,SpaceDimension+dim) = 1.0;
+   }
+}
+
+
+// Destructor
+template<class TScalarType>
+ESMRigid3DTransform<TScalarType>::
+~ESMRigid3DTransform()
+{
+}
+
+
+// Print self
+template<class TScalarType>
+void
+ESMRigid3DTransform<TScalarType>::
+PrintSelf(std::ostream &os, Indent indent) const
+{
+   Superclass::PrintSelf(os,indent);
+   os << indent << "RotationVector = " << m_RotationVector << std::endl;
+}
+
+
+// Set the rotation matrix
+template<class TScalarType>
+void
+ESMRigid3DTransform<TScalarType>::
+SetMatrix(const MatrixType & matrix )
+{
+   itkDebugMacro("setting  m_Matrix  to " << matrix );
+   // The matrix must be orthogonal with a positive determinant otherwise
+   // it is not representing a valid rotation in 3D space
+   typename MatrixType::InternalMatrixType test =
+      matrix.GetVnlMatrix() * matrix.GetTranspose();
+
+   const double tolerance = 1e-10;
+   if( !test.is_identity( tolerance ) ||
+       vnl_det( matrix.GetVnlMatrix() ) < 0.0 )
+   {
+      itk::ExceptionObject ex(__FILE__,__LINE__,"Attempt to set a Non-Orthogonal matrix",ITK_LOCATION);
+      throw ex;
+   }
+
+   this->m_Matrix = matrix;
+   this->ComputeOffset();
+   this->ComputeMatrixParameters();
+   this->m_MatrixMTime.Modified();
+   this->Modified();
+}
+
+
+/** Coefficients of the closed-form exponential */
+template <class TScalarType>
+void
+ESMRigid3DTransform<TScalarType>
+::GetRodriguesCoefficients( TScalarType theta2,
+                            TScalarType & a,
+                            TScalarType & b,
+                            TScalarType & c )
+{
+   if ( theta2 > 1e-8 )
+   {
+      const TScalarType theta = vcl_sqrt( theta2 );
+      const TScalarType sintheta = vcl_sin( theta );
+      const TScalarType costheta = vcl_cos( theta );
+
+      a = sintheta / theta;
+      b = ( 1.0 - costheta ) / theta2;
+      c = ( theta - sintheta ) / ( theta2 * theta );
+   }
+   else
+   {
+      // Use Taylor expansion up to order 2
+      a = 1.0 - theta2 / 6.0;
+      b = 0.5 - theta2 / 24.0;
+      c = 1.0 / 6.0 - theta2 / 120.0;
+   }
+}
+
+
+/** Compute the rotation vector from the rotation matrix */
+template <class TScalarType>
+void
+ESMRigid3DTransform<TScalarType>
+::ComputeMatrixParameters( void )
+{
+   const MatrixType & mat = this->GetMatrix();
+
+   // vee( R - R^T ) / 2 = sin(theta) * axis
+   VectorType sinaxis;
+   sinaxis[0] = 0.5 * ( mat[2][1] - mat[1][2] );
+   sinaxis[1] = 0.5 * ( mat[0][2] - mat[2][0] );
+   sinaxis[2] = 0.5 * ( mat[1][0] - mat[0][1] );
+
+   double costheta = 0.5 * ( mat[0][0] + mat[1][1] + mat[2][2] - 1.0 );
+   costheta = vnl_math_max( -1.0, vnl_math_min( 1.0, costheta ) );
+   const double theta = vcl_acos( costheta );
+
+   if ( theta < 1e-4 )
+   {
+      // First order: log(R) ~ ( R - R^T ) / 2
+      m_RotationVector = sinaxis * ( 1.0 + theta * theta / 6.0 );
+   }
+   else if ( vnl_math::pi - theta > 1e-4 )
+   {
+      m_RotationVector = sinaxis * ( theta / vcl_sin( theta ) );
+   }
+   else
+   {
+      // Close to pi the antisymmetric part vanishes. Recover the axis from
+      // the symmetric part: ( R + R^T ) / 2 = cos(theta) I + (1-cos(theta)) n n^T
+      MatrixType nnt;
+      for ( unsigned int i = 0; i < SpaceDimension; i++ )
+      {
+         for ( unsigned int j = 0; j < SpaceDimension; j++ )
+         {
+            nnt[i][j] = 0.5 * ( mat[i][j] + mat[j][i] );
+         }
+         nnt[i][i] -= costheta;
+      }
+      nnt /= ( 1.0 - costheta );
+
+      unsigned int k = 0;
+      for ( unsigned int i = 1; i < SpaceDimension; i++ )
+      {
+         if ( nnt[i][i] > nnt[k][k] )
+         {
+            k = i;
+         }
+      }
+      VectorType axis;
+      const double nk = vcl_sqrt( vnl_math_max( 0.0, static_cast<double>( nnt[k][k] ) ) );
+      for ( unsigned int i = 0; i < SpaceDimension; i++ )
+      {
+         axis[i] = nnt[i][k] / nk;
+      }
+      if ( axis * sinaxis < 0.0 )
+      {
+         axis = -axis;
+      }
+      m_RotationVector = axis * theta;
+   }
+}
+
+
+// Compose with a translation
+template<class TScalarType>
+void
+ESMRigid3DTransform<TScalarType>::
+Translate(const OffsetType &offset, bool)
+{
+   VectorType newOffset = this->GetOffset();
+   newOffset += offset;
+   this->SetOffset(newOffset);
+   this->ComputeTranslation();
+}
+
+// Return an inverse of this transform
+template<class TScalarType>
+typename ESMRigid3DTransform<TScalarType>::InverseESMTransformBasePointer
+ESMRigid3DTransform<TScalarType>
+::GetInverseESMTransform() const
+{
+   Pointer inverse = New();
+
+   // R^-1 = R^T = exp( -[w]x )
+   const MatrixType rotT( this->GetMatrix().GetTranspose() );
+
+   inverse->SetCenter( this->GetCenter() );  // inverse have the same center
+   inverse->SetRotationVector( -this->GetRotationVector() );
+   inverse->SetTranslation( -( rotT * this->GetTranslation() ) );
+
+   return inverse.GetPointer();
+}
+
+// Create and return a clone of the transformation
+template<class TScalarType>
+void
+ESMRigid3DTransform<TScalarType>::
+CloneTo( Pointer & result ) const
+{
+   result = New();
+   result->SetCenter( this->GetCenter() );
+   result->SetRotationVector( this->GetRotationVector() );
+   result->SetTranslation( this->GetTranslation() );
+}
+
+
+// Reset the transform to an identity transform
+template<class TScalarType >
+void
+ESMRigid3DTransform< TScalarType >::
+SetIdentity( void )
+{
+   this->Superclass::SetIdentity();
+   m_RotationVector.Fill( NumericTraits< TScalarType >::Zero );
+}
+
+// Set the rotation vector
+template <class TScalarType>
+void
+ESMRigid3DTransform<TScalarType>
+::SetRotationVector( const VectorType & rotation )
+{
+   m_RotationVector = rotation;
+   this->ComputeMatrix();
+   this->ComputeOffset();
+   this->m_MatrixMTime.Modified();
+   this->Modified();
+}
+
+// Compute the matrix from the rotation vector
+template <class TScalarType>
+void
+ESMRigid3DTransform<TScalarType>
+::ComputeMatrix( void )
+{
+   const VectorType & w = m_RotationVector;
+
+   TScalarType a, b, c;
+   GetRodriguesCoefficients( w.GetSquaredNorm(), a, b, c );
+
+   // R = I + a [w]x + b [w]x^2 with [w]x^2 = w w^T - |w|^2 I
+   const TScalarType theta2 = w.GetSquaredNorm();
+   for ( unsigned int i = 0; i < SpaceDimension; i++ )
+   {
+      for ( unsigned int j = 0; j < SpaceDimension; j++ )
+      {
+         this->m_Matrix[i][j] = b * w[i] * w[j];
+      }
+      this->m_Matrix[i][i] += 1.0 - b * theta2;
+   }
+
+   this->m_Matrix[0][1] -= a * w[2];
+   this->m_Matrix[0][2] += a * w[1];
+   this->m_Matrix[1][0] += a * w[2];
+   this->m_Matrix[1][2] -= a * w[0];
+   this->m_Matrix[2][0] -= a * w[1];
+   this->m_Matrix[2][1] += a * w[0];
+}
+
+// Set Parameters
+template <class TScalarType>
+void
+ESMRigid3DTransform<TScalarType>::
+SetParameters( const ParametersType & parameters )
+{
+   itkDebugMacro( << "Setting parameters " << parameters );
+
+   // Set rotation vector
+   VectorType rotation;
+   for(unsigned int i=0; i < SpaceDimension; i++)
+   {
+      rotation[i] = parameters[i];
+   }
+   this->SetVarRotationVector( rotation );
+
+   // Set translation
+   for(unsigned int i=0; i < SpaceDimension; i++)
+   {
+      this->m_Translation[i] = parameters[i+SpaceDimension];
+   }
+
+   // Update matrix and offset
+   this->ComputeMatrix();
+   this->ComputeOffset();
+   this->m_MatrixMTime.Modified();
+
+   // Modified is always called since we just have a pointer to the
+   // parameters and cannot know if the parameters have changed.
+   this->Modified();
+
+   itkDebugMacro(<<"After setting parameters ");
+}
+
+// Get Parameters
+template <class TScalarType>
+const typename ESMRigid3DTransform<TScalarType>::ParametersType &
+ESMRigid3DTransform<TScalarType>::
+GetParameters( void ) const
+{
+   itkDebugMacro( << "Getting parameters ");
+
+   for(unsigned int i=0; i < SpaceDimension; i++)
+   {
+      this->m_Parameters[i] = this->GetRotationVector()[i];
+      this->m_Parameters[i+SpaceDimension] = this->GetTranslation()[i];
+   }
+
+   itkDebugMacro(<<"After getting parameters " << this->m_Parameters );
+
+   return this->m_Parameters;
+}
+
+// Compute transformation Jacobian
+template<class TScalarType>
+const typename ESMRigid3DTransform<TScalarType>::JacobianType &
+ESMRigid3DTransform<TScalarType>::
+GetJacobian( const PointType & p ) const
+{
+   // d( R(w) v ) / dw = - R [v]x Jr(w)
+   // with the right Jacobian of SO(3) Jr(w) = I - b [w]x + c [w]x^2
+   typedef vnl_matrix_fixed<double, 3, 3> Matrix3Type;
+
+   const VectorType & w = m_RotationVector;
+   const VectorType v = p - this->GetCenter();
+
+   TScalarType a, b, c;
+   GetRodriguesCoefficients( w.GetSquaredNorm(), a, b, c );
+
+   Matrix3Type wx;
+   wx(0,0) =  0.0;  wx(0,1) = -w[2]; wx(0,2) =  w[1];
+   wx(1,0) =  w[2]; wx(1,1) =  0.0;  wx(1,2) = -w[0];
+   wx(2,0) = -w[1]; wx(2,1) =  w[0]; wx(2,2) =  0.0;
+
+   Matrix3Type vx;
+   vx(0,0) =  0.0;  vx(0,1) = -v[2]; vx(0,2) =  v[1];
+   vx(1,0) =  v[2]; vx(1,1) =  0.0;  vx(1,2) = -v[0];
+   vx(2,0) = -v[1]; vx(2,1) =  v[0]; vx(2,2) =  0.0;
+
+   Matrix3Type jr;
+   jr.set_identity();
+   jr -= b * wx;
+   jr += c * ( wx * wx );
+
+   Matrix3Type R;
+   for ( unsigned int i = 0; i < SpaceDimension; i++ )
+   {
+      for ( unsigned int j = 0; j < SpaceDimension; j++ )
+      {
+         R(i,j) = this->GetMatrix()[i][j];
+      }
+   }
+
+   const Matrix3Type drot = -( R * vx * jr );
+
+   this->m_Jacobian.Fill(0.0);
+   for ( unsigned int i = 0; i < SpaceDimension; i++ )
+   {
+      for ( unsigned int j = 0; j < SpaceDimension; j++ )
+      {
+         this->m_Jacobian[i][j] = drot(i,j);
+      }
+      // compute derivatives for the translation part
+      this->m_Jacobian[i][SpaceDimension+i] = 1.0;
+   }
+
+   return this->m_Jacobian;
+}
+
+template<class TScalarType>
+void
+ESMRigid3DTransform<TScalarType>::
+IncrementalUpdate( const ParametersType & updatevector )
+{
+   // We have a closed-form solution for the matrix exponential in this case
+   VectorType w, v;
+   for ( unsigned int i = 0; i < SpaceDimension; i++ )
+   {
+      w[i] = updatevector[i];
+      v[i] = updatevector[i+SpaceDimension];
+   }
+
+   const TScalarType theta2 = w.GetSquaredNorm();
+   TScalarType a, b, c;
+   GetRodriguesCoefficients( theta2, a, b, c );
+
+   // exp( update ) = [ I + a[w]x + b[w]x^2 ,  ( I + b[w]x + c[w]x^2 ) v ]
+   // Use [w]x u = w ^ u and [w]x^2 u = w (w.u) - |w|^2 u
+   const VectorType wv = CrossProduct( w, v );
+   const VectorType wwv = w * ( w * v ) - v * theta2;
+
+   VectorType inc_trans = v + wv * b + wwv * c;
+
+   MatrixType inc_rot;
+   for ( unsigned int i = 0; i < SpaceDimension; i++ )
+   {
+      for ( unsigned int j = 0; j < SpaceDimension; j++ )
+      {
+         inc_rot[i][j] = b * w[i] * w[j];
+      }
+      inc_rot[i][i] += 1.0 - b * theta2;
+   }
+   inc_rot[0][1] -= a * w[2];
+   inc_rot[0][2] += a * w[1];
+   inc_rot[1][0] += a * w[2];
+   inc_rot[1][2] -= a * w[0];
+   inc_rot[2][0] -= a * w[1];
+   inc_rot[2][1] += a * w[0];
+
+   // Compose with current transfomation
+   // First the translation part: Trans_new = Trans_old + Mat_old * Trans_expup
+   this->m_Translation += this->m_Matrix*inc_trans;
+
+   // Then the rotation part: Mat_new = Mat_old * Mat_expup
+   this->m_Matrix = this->m_Matrix * inc_rot;
+
+   // Go back to the rotation vector and recompute the matrix from it so
+   // that numerical drift never moves us away from SO(3)
+   this->ComputeMatrixParameters();
+   this->ComputeMatrix();
+   this->ComputeOffset();
+
+   this->m_MatrixMTime.Modified();
+   this->Modified();
+}
+
+template<class TScalarType>
+const typename ESMRigid3DTransform<TScalarType>::JacobianType &
+ESMRigid3DTransform<TScalarType>::
+GetIncrementalUpdateJacobian( const PointType & p ) const
+{
+   // d( w ^ (p-c) ) / dw = -[p-c]x
+   const VectorType v = p - this->GetCenter();
+
+   this->m_IncrementalUpdateJacobian(0,0) =  0.0;
+   this->m_IncrementalUpdateJacobian(0,1) =  v[2];
+   this->m_IncrementalUpdateJacobian(0,2) = -v[1];
+   this->m_IncrementalUpdateJacobian(1,0) = -v[2];
+   this->m_IncrementalUpdateJacobian(1,1) =  0.0;
+   this->m_IncrementalUpdateJacobian(1,2) =  v[0];
+   this->m_IncrementalUpdateJacobian(2,0) =  v[1];
+   this->m_IncrementalUpdateJacobian(2,1) = -v[0];
+   this->m_IncrementalUpdateJacobian(2,2) =  0.0;
+
+   return this->m_IncrementalUpdateJacobian;
+}
+
+} // namespace
+
+#endif
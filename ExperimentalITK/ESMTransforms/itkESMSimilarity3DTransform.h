@@ -0,0 +1,167 @@
+#ifndef MZ_ESMSimilarity3DTransform_H_
+#define MZ_ESMSimilarity3DTransform_H_
+
+#include "itkESMRigid3DTransform.h"
+
+#include <iostream>
+#include <itkExceptionObject.h>
+
+namespace itk
+{
+
+/** \class ESMSimilarity3DTransform
+ * \brief ESMSimilarity3DTransform of a vector space (e.g. space coordinates)
+ *
+ * This transform applies a rotation, an isotropic scaling and a translation
+ * in 3D space. The rotation and scaling are performed around an arbitrary
+ * center.
+ *
+ * The rotation is parameterized by its rotation vector as in
+ * ESMRigid3DTransform. Incremental updates are performed in the Lie group
+ * Sim(3), the update vector holding the logarithm of the scale increment.
+ *
+ * The serialization of the optimizable parameters is an array of 7 elements
+ * ordered as follows:
+ * p[0] = x component of the rotation vector
+ * p[1] = y component of the rotation vector
+ * p[2] = z component of the rotation vector
+ * p[3] = x component of the translation
+ * p[4] = y component of the translation
+ * p[5] = z component of the translation
+ * p[6] = scale factor
+ *
+ * The incremental update vector is (omega, v, log(scale increment)).
+ *
+ * The serialization of the fixed parameters is the center of rotation.
+ *
+ * \sa ESMRigid3DTransform
+ * \sa ESMMatrixOffsetTransformBase
+ *
+ * \ingroup Transforms
+ */
+template < class TScalarType=double >    // Data type for scalars (float or double)
+class ITK_EXPORT ESMSimilarity3DTransform :
+      public ESMRigid3DTransform< TScalarType >
+{
+public:
+   /** Standard class typedefs. */
+   typedef ESMSimilarity3DTransform                       Self;
+   typedef ESMRigid3DTransform< TScalarType >             Superclass;
+   typedef SmartPointer<Self>                             Pointer;
+   typedef SmartPointer<const Self>                       ConstPointer;
+
+   /** Run-time type information (and related methods). */
+   itkTypeMacro( ESMSimilarity3DTransform, ESMRigid3DTransform );
+
+   /** New macro for creation of through a Smart Pointer */
+   itkNewMacro( Self );
+
+   /** Dimension of the space. */
+   itkStaticConstMacro(SpaceDimension, unsigned int, 3);
+   itkStaticConstMacro(ParametersDimension, unsigned int, 7);
+
+   /** Scalar type. */
+   typedef typename Superclass::ScalarType      ScalarType;
+
+   /** Parameters type. */
+   typedef typename Superclass::ParametersType  ParametersType;
+
+   /** Jacobian type. */
+   typedef typename Superclass::JacobianType    JacobianType;
+
+   /// Standard matrix type for this class
+   typedef typename Superclass::MatrixType      MatrixType;
+
+   /// Standard vector type for this class
+   typedef typename Superclass::OffsetType      OffsetType;
+
+   /// Standard vector type for this class
+   typedef typename Superclass::VectorType      VectorType;
+
+   /// Standard coordinate point type for this class
+   typedef typename Superclass::PointType       PointType;
+
+   /** Base inverse transform type. This type should not be changed to the
+    * concrete inverse transform type or inheritance would be lost.*/
+   typedef typename Superclass::InverseESMTransformBaseType InverseESMTransformBaseType;
+   typedef typename InverseESMTransformBaseType::Pointer    InverseESMTransformBasePointer;
+
+   /**
+    * Set the matrix of a Similarity3D Transform
+    *
+    * The matrix is expected to be a scaled rotation, i.e. M.M^T = s^2 I
+    * with a positive determinant.
+    *
+    * \warning This method will throw an exception if the matrix
+    * provided as argument is not a scaled rotation.
+    */
+   virtual void SetMatrix( const MatrixType & matrix );
+
+   /** Set/Get the isotropic scale factor */
+   void SetScale( TScalarType scale );
+   itkGetConstReferenceMacro( Scale, TScalarType );
+
+   /** Set the transformation from a container of parameters.
+    * \sa Transform::SetParameters() */
+   void SetParameters( const ParametersType & parameters );
+
+   /** Get the parameters that uniquely define the transform.
+    * \sa Transform::GetParameters() */
+   const ParametersType & GetParameters( void ) const;
+
+   /** This method computes the Jacobian matrix of the transformation
+    * at a given input point.
+    *
+    * \sa Transform::GetJacobian() */
+   const JacobianType & GetJacobian(const PointType  &point ) const;
+
+   /** Return an inverse of this transform. */
+   virtual InverseESMTransformBasePointer GetInverseESMTransform() const;
+
+   /**
+    * This method creates and returns a new ESMSimilarity3DTransform object
+    * which has the same parameters.
+    */
+   void CloneTo( Pointer & clone ) const;
+
+   /** Reset the parameters to create and identity transform. */
+   virtual void SetIdentity(void);
+
+   /** Use the given update vector to update the current transform
+    *  this <- this o exp ( update ) in Sim(3)
+    */
+   virtual void IncrementalUpdate( const ParametersType & updatevector );
+
+   virtual const JacobianType & GetIncrementalUpdateJacobian(const PointType  & point ) const;
+
+protected:
+   ESMSimilarity3DTransform();
+   ESMSimilarity3DTransform( unsigned int outputSpaceDimension,
+                             unsigned int parametersDimension);
+
+   ~ESMSimilarity3DTransform();
+
+   /**
+    * Print contents of an ESMSimilarity3DTransform
+    */
+   void PrintSelf(std::ostream &os, Indent indent) const;
+
+   /** Compute the matrix from the rotation vector and scale. */
+   virtual void ComputeMatrix(void);
+
+   /** Compute the rotation vector and scale from the matrix. */
+   virtual void ComputeMatrixParameters(void);
+
+private:
+   ESMSimilarity3DTransform(const Self&); //purposely not implemented
+   void operator=(const Self&); //purposely not implemented
+
+   TScalarType         m_Scale;
+
+}; //class ESMSimilarity3DTransform
+
+}  // namespace itk
+
+#include "itkESMSimilarity3DTransform.hxx"
+
+#endif /* MZ_ESMSimilarity3DTransform_H_ */
@@ -0,0 +1,320 @@
+#ifndef MZ_ESMSimilarity3DTransform_TXX_
+#define MZ_ESMSimilarity3DTransform_TXX_
+
+#include "itkESMSimilarity3DTransform.h"
+#include "vnl_sd_matrix_tools.h"
+
+#include <vnl/vnl_math.h>
+#include <vnl/vnl_det.h>
+
+
+namespace itk
+{
+
+// Constructor with default arguments
+template<class TScalarType>
+ESMSimilarity3DTransform<TScalarType>::
+ESMSimilarity3DTransform():
+   Superclass(SpaceDimension, ParametersDimension)
+{
+   m_Scale = NumericTraits< TScalarType >::One;
+}
+
+
+// Constructor with arguments
+template<class TScalarType>
+ESMSimilarity3DTransform<TScalarType>::
+ESMSimilarity3DTransform( unsigned int spaceDimension,
+                          unsigned int parametersDimension):
+   Superclass(spaceDimension,parametersDimension)
+{
+   m_Scale = NumericTraits< TScalarType >::One;
+}
+
+
+// Destructor
+template<class TScalarType>
+ESMSimilarity3DTransform<TScalarType>::
+~ESMSimilarity3DTransform()
+{
+}
+
+
+// Print self
+template<class TScalarType>
+void
+ESMSimilarity3DTransform<TScalarType>::
+PrintSelf(std::ostream &os, Indent indent) const
+{
+   Superclass::PrintSelf(os,indent);
+   os << indent << "Scale = " << m_Scale << std::endl;
+}
+
+
+// Set the scaled rotation matrix
+template<class TScalarType>
+void
+ESMSimilarity3DTransform<TScalarType>::
+SetMatrix(const MatrixType & matrix )
+{
+   itkDebugMacro("setting  m_Matrix  to " << matrix );
+
+   const double det = vnl_det( matrix.GetVnlMatrix() );
+   if( det <= 0.0 )
+   {
+      itk::ExceptionObject ex(__FILE__,__LINE__,"Attempt to set a matrix with a non-positive determinant",ITK_LOCATION);
+      throw ex;
+   }
+
+   // The matrix divided by its scale must be orthogonal
+   const double s = vcl_pow( det, 1.0/3.0 );
+   typename MatrixType::InternalMatrixType test =
+      matrix.GetVnlMatrix() * matrix.GetTranspose();
+   test /= ( s * s );
+
+   const double tolerance = 1e-10;
+   if( !test.is_identity( tolerance ) )
+   {
+      itk::ExceptionObject ex(__FILE__,__LINE__,"Attempt to set a matrix which is not a scaled rotation",ITK_LOCATION);
+      throw ex;
+   }
+
+   this->m_Matrix = matrix;
+   this->ComputeOffset();
+   this->ComputeMatrixParameters();
+   this->m_MatrixMTime.Modified();
+   this->Modified();
+}
+
+
+/** Compute the rotation vector and scale from the matrix */
+template <class TScalarType>
+void
+ESMSimilarity3DTransform<TScalarType>
+::ComputeMatrixParameters( void )
+{
+   m_Scale = vcl_pow( vnl_det( this->m_Matrix.GetVnlMatrix() ), 1.0/3.0 );
+
+   // Extract the rotation from the normalized matrix
+   const MatrixType scaledMatrix = this->m_Matrix;
+   this->m_Matrix /= m_Scale;
+   this->Superclass::ComputeMatrixParameters();
+   this->m_Matrix = scaledMatrix;
+}
+
+
+/** Compute the matrix from the rotation vector and scale */
+template <class TScalarType>
+void
+ESMSimilarity3DTransform<TScalarType>
+::ComputeMatrix( void )
+{
+   this->Superclass::ComputeMatrix();
+   this->m_Matrix *= m_Scale;
+}
+
+
+// Return an inverse of this transform
+template<class TScalarType>
+typename ESMSimilarity3DTransform<TScalarType>::InverseESMTransformBasePointer
+ESMSimilarity3DTransform<TScalarType>
+::GetInverseESMTransform() const
+{
+   Pointer inverse = New();
+
+   // (s R)^-1 = s^-1 R^T
+   const MatrixType invMatrix( this->GetMatrix().GetTranspose() / ( m_Scale * m_Scale ) );
+
+   inverse->SetCenter( this->GetCenter() );  // inverse have the same center
+   inverse->SetVarRotationVector( -this->GetRotationVector() );
+   inverse->SetScale( 1.0 / m_Scale );
+   inverse->SetTranslation( -( invMatrix * this->GetTranslation() ) );
+
+   return inverse.GetPointer();
+}
+
+// Create and return a clone of the transformation
+template<class TScalarType>
+void
+ESMSimilarity3DTransform<TScalarType>::
+CloneTo( Pointer & result ) const
+{
+   result = New();
+   result->SetCenter( this->GetCenter() );
+   result->SetVarRotationVector( this->GetRotationVector() );
+   result->SetScale( this->GetScale() );
+   result->SetTranslation( this->GetTranslation() );
+}
+
+
+// Reset the transform to an identity transform
+template<class TScalarType >
+void
+ESMSimilarity3DTransform< TScalarType >::
+SetIdentity( void )
+{
+   this->Superclass::SetIdentity();
+   m_Scale = NumericTraits< TScalarType >::One;
+}
+
+// Set the scale
+template <class TScalarType>
+void
+ESMSimilarity3DTransform<TScalarType>
+::SetScale( TScalarType scale )
+{
+   m_Scale = scale;
+   this->ComputeMatrix();
+   this->ComputeOffset();
+   this->m_MatrixMTime.Modified();
+   this->Modified();
+}
+
+// Set Parameters
+template <class TScalarType>
+void
+ESMSimilarity3DTransform<TScalarType>::
+SetParameters( const ParametersType & parameters )
+{
+   itkDebugMacro( << "Setting parameters " << parameters );
+
+   // Set rotation vector
+   VectorType rotation;
+   for(unsigned int i=0; i < SpaceDimension; i++)
+   {
+      rotation[i] = parameters[i];
+   }
+   this->SetVarRotationVector( rotation );
+
+   // Set translation
+   for(unsigned int i=0; i < SpaceDimension; i++)
+   {
+      this->m_Translation[i] = parameters[i+SpaceDimension];
+   }
+
+   // Set scale
+   m_Scale = parameters[2*SpaceDimension];
+
+   // Update matrix and offset
+   this->ComputeMatrix();
+   this->ComputeOffset();
+   this->m_MatrixMTime.Modified();
+
+   // Modified is always called since we just have a pointer to the
+   // parameters and cannot know if the parameters have changed.
+   this->Modified();
+
+   itkDebugMacro(<<"After setting parameters ");
+}
+
+// Get Parameters
+template <class TScalarType>
+const typename ESMSimilarity3DTransform<TScalarType>::ParametersType &
+ESMSimilarity3DTransform<TScalarType>::
+GetParameters( void ) const
+{
+   itkDebugMacro( << "Getting parameters ");
+
+   for(unsigned int i=0; i < SpaceDimension; i++)
+   {
+      this->m_Parameters[i] = this->GetRotationVector()[i];
+      this->m_Parameters[i+SpaceDimension] = this->GetTranslation()[i];
+   }
+   this->m_Parameters[2*SpaceDimension] = m_Scale;
+
+   itkDebugMacro(<<"After getting parameters " << this->m_Parameters );
+
+   return this->m_Parameters;
+}
+
+// Compute transformation Jacobian
+template<class TScalarType>
+const typename ESMSimilarity3DTransform<TScalarType>::JacobianType &
+ESMSimilarity3DTransform<TScalarType>::
+GetJacobian( const PointType & p ) const
+{
+   // The rotation and translation blocks are the ones of the rigid
+   // transform. The rotation block is already multiplied by the scale
+   // since the superclass uses the scaled matrix.
+   this->Superclass::GetJacobian( p );
+
+   // derivative with respect to the scale: R (p-c)
+   const VectorType v = p - this->GetCenter();
+   const VectorType rv = this->GetMatrix() * v / m_Scale;
+
+   for ( unsigned int i = 0; i < SpaceDimension; i++ )
+   {
+      this->m_Jacobian[i][2*SpaceDimension] = rv[i];
+   }
+
+   return this->m_Jacobian;
+}
+
+template<class TScalarType>
+void
+ESMSimilarity3DTransform<TScalarType>::
+IncrementalUpdate( const ParametersType & updatevector )
+{
+   // Store update parameters in homogeneous matrix
+   //   [ sigma I + [w]x   v ]
+   //   [        0         0 ]
+   const double sigma = updatevector[2*SpaceDimension];
+
+   this->m_LogIncMatrix.fill( 0.0 );
+   for(unsigned int i=0; i<SpaceDimension; i++)
+   {
+      this->m_LogIncMatrix(i,i) = sigma;
+      this->m_LogIncMatrix(i,SpaceDimension) = updatevector[SpaceDimension+i];
+   }
+   this->m_LogIncMatrix(0,1) = -updatevector[2];
+   this->m_LogIncMatrix(0,2) =  updatevector[1];
+   this->m_LogIncMatrix(1,0) =  updatevector[2];
+   this->m_LogIncMatrix(1,2) = -updatevector[0];
+   this->m_LogIncMatrix(2,0) = -updatevector[1];
+   this->m_LogIncMatrix(2,1) =  updatevector[0];
+
+   // Compute matrix exponential of the homogeneous matrix
+   const vnl_matrix<double> incexp = sdtools::GetExponential(this->m_LogIncMatrix.as_ref());
+
+   // Compose with current transfomation
+   // First the translation part: Trans_new = Trans_old + Mat_old * Trans_expup
+   for(unsigned int i=0; i<SpaceDimension; i++)
+   {
+      for(unsigned int j=0; j<SpaceDimension; j++)
+      {
+         this->m_Translation[i] += this->m_Matrix[i][j]*incexp(j,SpaceDimension);
+      }
+   }
+   // Then the matrix part: Mat_new = Mat_old * Mat_expup
+   this->m_Matrix *= incexp.extract(SpaceDimension, SpaceDimension, 0, 0);
+
+   // Go back to the (rotation vector, scale) parameterization and recompute
+   // the matrix from it so that we stay in Sim(3)
+   this->ComputeMatrixParameters();
+   this->ComputeMatrix();
+   this->ComputeOffset();
+
+   this->m_MatrixMTime.Modified();
+   this->Modified();
+}
+
+template<class TScalarType>
+const typename ESMSimilarity3DTransform<TScalarType>::JacobianType &
+ESMSimilarity3DTransform<TScalarType>::
+GetIncrementalUpdateJacobian( const PointType & p ) const
+{
+   this->Superclass::GetIncrementalUpdateJacobian( p );
+
+   // d( exp( sigma ) (p-c) ) / dsigma = p-c
+   const VectorType v = p - this->GetCenter();
+   for ( unsigned int i = 0; i < SpaceDimension; i++ )
+   {
+      this->m_IncrementalUpdateJacobian(i,2*SpaceDimension) = v[i];
+   }
+
+   return this->m_IncrementalUpdateJacobian;
+}
+
+} // namespace
+
+#endif
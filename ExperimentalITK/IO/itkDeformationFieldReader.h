@@ -24,6 +24,9 @@
 #include "itkImageRegion.h"
 #include "itkDefaultConvertPixelTraits.h"
 
+#include <string>
+#include <vector>
+
 namespace itk
 {
 
@@ -76,8 +79,15 @@ public:
  * raw binary format) have no accepted suffix, so you will have to
  * manually create the ImageIO instance of the write type.
  *
+ * If FileName is an existing file, it is read as a single file with
+ * interleaved vector components (e.g. a MetaImage with
+ * ElementNumberOfChannels = ImageDimension).  Uncompressed MetaImage files
+ * are then memory mapped.  Otherwise one scalar file per component is
+ * read, the files being read in parallel.
+ *
  * \sa ImageSeriesReader
  * \sa ImageIOBase
+ * \sa VectorImageBufferReader
  *
  * \ingroup IOFilters
  *
@@ -116,6 +126,16 @@ public:
   itkSetMacro(UseAvantsNamingConvention,bool);
   itkGetConstReferenceMacro(UseAvantsNamingConvention,bool);
   itkBooleanMacro(UseAvantsNamingConvention);
+
+  /** Set/Get whether uncompressed interleaved MetaImage files are memory
+   * mapped (default On). */
+  itkSetMacro(UseMemoryMapping,bool);
+  itkGetConstReferenceMacro(UseMemoryMapping,bool);
+  itkBooleanMacro(UseMemoryMapping);
+
+  /** Whether FileName is a single file with interleaved components. Set by
+   * GenerateOutputInformation(). */
+  itkGetConstReferenceMacro(IsInterleaved,bool);
   
   /** Set/Get the ImageIO helper class. Often this is created via the object
    * factory mechanism that determines whether a particular ImageIO can
@@ -167,8 +187,13 @@ private:
   DeformationFieldReader(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
   
+  /** The files holding the components */
+  void GetComponentFileNames( std::vector<std::string> & ) const;
+
   typename TImage::Pointer m_Image;
   bool     m_UseAvantsNamingConvention;
+  bool     m_UseMemoryMapping;
+  bool     m_IsInterleaved;
 
 };
 
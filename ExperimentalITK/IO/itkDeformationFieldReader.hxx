@@ -25,6 +25,7 @@
 #include "itkPixelTraits.h"
 #include "itkVectorImage.h"
 #include "itkImageRegionIterator.h"
+#include "itkVectorImageBufferReader.h"
 
 #include <itksys/SystemTools.hxx>
 #include <fstream>
@@ -40,6 +41,8 @@ DeformationFieldReader<TImage, TDeformationField, ConvertPixelTraits>
   m_FileName = "";
   m_UserSpecifiedImageIO = false;
   m_UseAvantsNamingConvention = false;
+  m_UseMemoryMapping = true;
+  m_IsInterleaved = false;
   
   this->m_Image = TImage::New();
 }
@@ -68,6 +71,8 @@ void DeformationFieldReader<TImage, TDeformationField, ConvertPixelTraits>
 
   os << indent << "UserSpecifiedImageIO flag: " << m_UserSpecifiedImageIO << "\n";
   os << indent << "m_FileName: " << m_FileName << "\n";
+  os << indent << "UseMemoryMapping: " << m_UseMemoryMapping << "\n";
+  os << indent << "IsInterleaved: " << m_IsInterleaved << "\n";
 }
 
 
@@ -103,11 +108,17 @@ DeformationFieldReader<TImage, TDeformationField, ConvertPixelTraits>
     throw DeformationFieldReaderException(__FILE__, __LINE__, "FileName must be specified", ITK_LOCATION);
     }
 
-  // Test if the files exist and if it can be open.
-  // and exception will be thrown otherwise.
+  // A single file with interleaved components takes precedence over the 
+  // per-component files.  Otherwise test if the files exist and if they 
+  // can be open, an exception will be thrown otherwise.
   //
-
-  this->TestFileExistanceAndReadability();
+  this->m_IsInterleaved = 
+    itksys::SystemTools::FileExists( m_FileName.c_str() ) &&
+    !itksys::SystemTools::FileIsDirectory( m_FileName.c_str() );
+  if ( !this->m_IsInterleaved )
+    {
+    this->TestFileExistanceAndReadability();
+    }
   
   unsigned int dimension = itk::GetVectorDimension
      <DeformationFieldPixelType>::VectorDimension;
@@ -145,6 +156,10 @@ DeformationFieldReader<TImage, TDeformationField, ConvertPixelTraits>
       this->m_FileName += ( std::string( "." )  + std::string( buf.str().c_str() ) );
       }
     this->m_FileName += extension;
+    if ( this->m_IsInterleaved )
+      {
+      this->m_FileName = filename;
+      }
 
     if ( i == 0 )
       {
@@ -364,19 +379,16 @@ DeformationFieldReader<TImage, TDeformationField, ConvertPixelTraits>
 {
   typename TDeformationField::Pointer out = dynamic_cast<TDeformationField*>(output);
 
-  // the ImageIO object cannot stream, then set the RequestedRegion to the
-  // LargestPossibleRegion
-  if (!m_ImageIO->CanStreamRead())
+  // The components are always read (or mapped) as a whole, so set the
+  // RequestedRegion to the LargestPossibleRegion
+  if (out)
     {
-    if (out)
-      {
-      out->SetRequestedRegion( out->GetLargestPossibleRegion() );
-      }
-    else
-      {
-      throw DeformationFieldReaderException(__FILE__, __LINE__,
-                                     "Invalid output object type");
-      }
+    out->SetRequestedRegion( out->GetLargestPossibleRegion() );
+    }
+  else
+    {
+    throw DeformationFieldReaderException(__FILE__, __LINE__,
+                                   "Invalid output object type");
     }
 }
 
@@ -387,43 +399,62 @@ void DeformationFieldReader<TImage, TDeformationField, ConvertPixelTraits>
 {
   typename TDeformationField::Pointer output = this->GetOutput();
 
-  // allocate the output buffer
-  output->SetBufferedRegion( output->GetRequestedRegion() );
-  output->Allocate();
-
-  this->m_Image->SetBufferedRegion( output->GetRequestedRegion() );
-  this->m_Image->Allocate();
+  std::vector<std::string> fileNames;
+  if ( this->m_IsInterleaved )
+    {
+    fileNames.push_back( this->m_FileName );
+    }
+  else
+    {
+    // Test if the file exist and if it can be open.
+    // and exception will be thrown otherwise.
+    this->TestFileExistanceAndReadability();
+    this->GetComponentFileNames( fileNames );
+    }
 
-  // Test if the file exist and if it can be open.
-  // and exception will be thrown otherwise.
-  this->TestFileExistanceAndReadability();
+  // Read the components directly into the output buffer (or map the file).
+  // The largest possible region is always read.
+  typedef VectorImageBufferReader<TDeformationField> BufferReaderType;
+  typename BufferReaderType::Pointer bufferReader = BufferReaderType::New();
+  bufferReader->SetFileNames( fileNames );
+  bufferReader->SetUseMemoryMapping( this->m_UseMemoryMapping );
+  if ( m_UserSpecifiedImageIO )
+    {
+    bufferReader->SetImageIO( m_ImageIO );
+    }
+  bufferReader->Read( output );
+}
 
+template <class TImage, class TDeformationField, class ConvertPixelTraits>
+void DeformationFieldReader<TImage, TDeformationField, ConvertPixelTraits>
+::GetComponentFileNames( std::vector<std::string> &fileNames ) const
+{
   unsigned int dimension = itk::GetVectorDimension
      <DeformationFieldPixelType>::VectorDimension;
 
-  std::string filename = this->m_FileName; 
   std::string::size_type Pos = this->m_FileName.rfind( "." );
   std::string extension( this->m_FileName, Pos, this->m_FileName.length()-1 );
 
+  fileNames.clear();
   for ( unsigned int i = 0; i < dimension; i++ )
     {
-    this->m_FileName = std::string( filename, 0, Pos );
+    std::string fileName( this->m_FileName, 0, Pos );
 
     if ( this->m_UseAvantsNamingConvention )
       {
       switch ( i )
         {
         case 0:
-          this->m_FileName += std::string( "xvec" );
+          fileName += std::string( "xvec" );
           break;
         case 1:
-          this->m_FileName += std::string( "yvec" );
+          fileName += std::string( "yvec" );
           break;
         case 2:
-          this->m_FileName += std::string( "zvec" );
+          fileName += std::string( "zvec" );
           break;
         default:
-          this->m_FileName += std::string( "you_are_screwed_vec" );
+          fileName += std::string( "you_are_screwed_vec" );
           break;
         }  
       }
@@ -431,105 +462,11 @@ void DeformationFieldReader<TImage, TDeformationField, ConvertPixelTraits>
       {
       itk::OStringStream buf;
       buf << i;
-      this->m_FileName += ( std::string( "." )  + std::string( buf.str().c_str() ) );
+      fileName += ( std::string( "." )  + std::string( buf.str().c_str() ) );
       }
-    this->m_FileName += extension;
-
-    itkDebugMacro( << "Reading image buffer from the file " << this->m_FileName );
-    
-    // Tell the ImageIO to read the file
-    //
-    ImagePixelType *buffer = 
-      this->m_Image->GetPixelContainer()->GetBufferPointer();
-    m_ImageIO->SetFileName(m_FileName.c_str());
-
-    ImageIORegion ioRegion(TImage::ImageDimension);
-    
-    ImageIORegion::SizeType ioSize = ioRegion.GetSize();
-    ImageIORegion::IndexType ioStart = ioRegion.GetIndex();
-
-    typename TImage::SizeType dimSize;
-    for(unsigned int j=0; j<TImage::ImageDimension; j++)
-      {
-      if (j < m_ImageIO->GetNumberOfDimensions())
-        {
-        dimSize[j] = m_ImageIO->GetDimensions(j);
-        }
-      else
-        {
-        // Number of dimensions in the output is more than number of dimensions
-        // in the ImageIO object (the file).  Use default values for the size,
-        // spacing, and origin for the final (degenerate) dimensions.
-        dimSize[j] = 1;
-        }
-      }
-
-    for(unsigned int j = 0; j < dimSize.GetSizeDimension(); ++j)
-      {
-      ioSize[j] = dimSize[j];
-      }
-
-    typedef typename TImage::IndexType   IndexType;
-    IndexType start;
-    start.Fill(0);
-    for(unsigned int j = 0; j < start.GetIndexDimension(); ++j)
-      {
-      ioStart[j] = start[j];
-      }
-
-    ioRegion.SetSize(ioSize);
-    ioRegion.SetIndex(ioStart);
-
-    itkDebugMacro (<< "ioRegion: " << ioRegion);
- 
-    m_ImageIO->SetIORegion(ioRegion);
-
-    if ( m_ImageIO->GetComponentTypeInfo()
-         == typeid(ITK_TYPENAME ConvertPixelTraits::ComponentType)
-         && (m_ImageIO->GetNumberOfComponents()
-             == ConvertPixelTraits::GetNumberOfComponents()))
-      {
-      itkDebugMacro(<< "No buffer conversion required.");
-      // allocate a buffer and have the ImageIO read directly into it
-      m_ImageIO->Read(buffer);
-//      return;
-      }
-    else // a type conversion is necessary
-      {
-      itkDebugMacro(<< "Buffer conversion required.");
-      // note: char is used here because the buffer is read in bytes
-      // regardles of the actual type of the pixels.
-      ImageRegionType region = this->m_Image->GetBufferedRegion();
-      char * loadBuffer = 
-        new char[m_ImageIO->GetImageSizeInBytes()];
-
-      m_ImageIO->Read(loadBuffer);
-      
-      itkDebugMacro(<< "Buffer conversion required from: "
-                    << m_ImageIO->GetComponentTypeInfo().name()
-                    << " to: "
-                    << typeid(ITK_TYPENAME ConvertPixelTraits::ComponentType).name());
-
-      this->DoConvertBuffer(loadBuffer, region.GetNumberOfPixels());
-      delete [] loadBuffer;
-      }
-
-    ImageRegionIterator<TDeformationField> Id( this->GetOutput(),
-      this->GetOutput()->GetLargestPossibleRegion() );
-    ImageRegionIterator<TImage> It( this->m_Image,
-      this->m_Image->GetLargestPossibleRegion() );
-
-    Id.GoToBegin();
-    It.GoToBegin();
-    while ( !Id.IsAtEnd() || !It.IsAtEnd() )
-      {
-      DeformationFieldPixelType V = Id.Get();
-      V[i] = static_cast< typename DeformationFieldPixelType::ValueType>( It.Get() );
-      Id.Set( V );     
-      ++Id;
-      ++It;
-      }
-    }  
+    fileName += extension;
+    fileNames.push_back( fileName );
+    }
 }
 
 
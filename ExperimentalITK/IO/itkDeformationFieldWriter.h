@@ -53,6 +53,12 @@ public:
 /** \class DeformationFieldWriter
  * \brief Writes the deformation field as component images files.
  *
+ * By default one scalar image is written per vector component.  With
+ * SplitComponentsOff() the field is written to FileName as a single file
+ * with interleaved components instead, which DeformationFieldReader can
+ * read back in one pass (and memory map when the file is an uncompressed
+ * MetaImage).
+ *
  * \sa DeformationFieldWriter
  * \sa ImageSeriesReader
  * \sa ImageIOBase
@@ -145,6 +151,12 @@ public:
   itkGetConstReferenceMacro(UseAvantsNamingConvention,bool);
   itkBooleanMacro(UseAvantsNamingConvention);
 
+  /** Write one file per component (default) or a single file with
+   *  interleaved components. */
+  itkSetMacro(SplitComponents,bool);
+  itkGetConstReferenceMacro(SplitComponents,bool);
+  itkBooleanMacro(SplitComponents);
+
   /** By default the MetaDataDictionary is taken from the input image and 
    *  passed to the ImageIO. In some cases, however, a user may prefer to 
    *  introduce her/his own MetaDataDictionary. This is often the case of
@@ -168,9 +180,13 @@ private:
   DeformationFieldWriter(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
 
+  /** Writes the whole field to m_FileName with interleaved components. */
+  void WriteInterleaved();
+
   std::string        m_FileName;
   std::string        m_ComponentImageFileName;
   bool               m_UseAvantsNamingConvention;
+  bool               m_SplitComponents;
   
   ImagePointer m_Image;
   
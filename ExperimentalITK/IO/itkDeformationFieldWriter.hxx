@@ -42,6 +42,7 @@ DeformationFieldWriter<TDeformationField, TImage>
   m_UseInputMetaDataDictionary = true;
   m_FactorySpecifiedImageIO = false;
   m_UseAvantsNamingConvention = false;
+  m_SplitComponents = true;
 }
 
 
@@ -146,6 +147,12 @@ void
 DeformationFieldWriter<TDeformationField, TImage>
 ::Write()
 {
+  if ( !this->m_SplitComponents )
+    {
+    this->WriteInterleaved();
+    return;
+    }
+
   std::string::size_type Pos = this->m_FileName.rfind( "." );
   std::string extension( this->m_FileName, Pos, this->m_FileName.length()-1 );
 
@@ -329,6 +336,98 @@ DeformationFieldWriter<TDeformationField, TImage>
 }
 
 
+//---------------------------------------------------------
+template <class TDeformationField, class TImage>
+void 
+DeformationFieldWriter<TDeformationField, TImage>
+::WriteInterleaved()
+{
+  const DeformationFieldType *input = this->GetInput();
+
+  if ( input == 0 )
+    {
+    itkExceptionMacro(<< "No input to writer!");
+    }
+  if ( m_FileName == "" )
+    {
+    itkExceptionMacro(<<"No filename was specified");
+    }
+
+  if ( m_ImageIO.IsNull() ||
+    ( m_FactorySpecifiedImageIO && !m_ImageIO->CanWriteFile( m_FileName.c_str() ) ) )
+    {
+    m_ImageIO = ImageIOFactory::CreateImageIO( m_FileName.c_str(), 
+                                               ImageIOFactory::WriteMode );
+    m_FactorySpecifiedImageIO = true;
+    }
+  if ( m_ImageIO.IsNull() )
+    {
+    ImageFileWriterException e(__FILE__, __LINE__);
+    OStringStream msg;
+    msg << " Could not create IO object for file "
+        << m_FileName.c_str() << std::endl;
+    e.SetDescription(msg.str().c_str());
+    e.SetLocation(ITK_LOCATION);
+    throw e;
+    }
+
+  // NOTE: this const_cast<> is due to the lack of const-correctness
+  // of the ProcessObject.
+  DeformationFieldType *nonConstField = const_cast<DeformationFieldType *>( input );
+  if( nonConstField->GetSource() )
+    {
+    nonConstField->GetSource()->UpdateLargestPossibleRegion();
+    }
+
+  // The whole field is written; a user specified IORegion only applies to
+  // the component files.
+  typedef typename TDeformationField::RegionType RegionType;
+  RegionType region = input->GetLargestPossibleRegion();
+  const typename TDeformationField::SpacingType& spacing = input->GetSpacing();
+  const typename TDeformationField::PointType& origin = input->GetOrigin();
+  const typename TDeformationField::DirectionType& direction = input->GetDirection();
+
+  ImageIORegion ioRegion(TDeformationField::ImageDimension);
+  m_ImageIO->SetNumberOfDimensions(TDeformationField::ImageDimension);
+  for(unsigned int i=0; i<TDeformationField::ImageDimension; i++)
+    {
+    ioRegion.SetSize(i,region.GetSize(i));
+    ioRegion.SetIndex(i,region.GetIndex(i));
+    m_ImageIO->SetDimensions(i,region.GetSize(i));
+    m_ImageIO->SetSpacing(i,spacing[i]);
+    m_ImageIO->SetOrigin(i,origin[i]);
+    vnl_vector< double > axisDirection(TDeformationField::ImageDimension);
+    for(unsigned int j=0; j<TDeformationField::ImageDimension; j++)
+      {
+      axisDirection[j] = direction[j][i];
+      }
+    m_ImageIO->SetDirection( i, axisDirection );
+    }
+
+  typedef typename DeformationFieldPixelType::ValueType ComponentType;
+  m_ImageIO->SetPixelTypeInfo( typeid(ComponentType) );
+  m_ImageIO->SetNumberOfComponents( itk::GetVectorDimension
+    <DeformationFieldPixelType>::VectorDimension );
+  m_ImageIO->SetPixelType( ImageIOBase::VECTOR );
+
+  m_ImageIO->SetFileName( m_FileName.c_str() );
+  m_ImageIO->SetUseCompression(m_UseCompression);
+  m_ImageIO->SetIORegion(ioRegion);
+  if( m_UseInputMetaDataDictionary )
+    {
+    m_ImageIO->SetMetaDataDictionary(input->GetMetaDataDictionary());
+    }
+
+  this->InvokeEvent( StartEvent() );
+  m_ImageIO->Write( (const void*) input->GetBufferPointer() );
+  this->InvokeEvent( EndEvent() );
+
+  if ( input->ShouldIReleaseData() )
+    {
+    nonConstField->ReleaseData();
+    }
+}
+
 //---------------------------------------------------------
 template <class TDeformationField, class TImage>
 void 
@@ -355,6 +454,7 @@ DeformationFieldWriter<TDeformationField, TImage>
     }
 
   os << indent << "IO Region: " << m_IORegion << "\n";
+  os << indent << "SplitComponents: " << m_SplitComponents << "\n";
 
 
   if (m_UseCompression)
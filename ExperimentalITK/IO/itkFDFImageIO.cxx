@@ -20,9 +20,22 @@
 #include "itkByteSwapper.h"
 #include "itkRGBPixel.h"
 #include "itkRGBAPixel.h"
+
+#include "vnl/vnl_math.h"
+
+#include <itksys/Directory.hxx>
+#include <itksys/SystemTools.hxx>
+
 #include <stdio.h>
+#include <string.h>
 #include <fstream>
 
+#if !defined( _WIN32 )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace itk
 {
 
@@ -38,6 +51,30 @@ bool FDFImageIO::CanReadFile(const char* file)
     return false;
     }
 
+  // A Varian acquisition directory (name.img) with one .fdf file per slice
+  if( itksys::SystemTools::FileIsDirectory( filename.c_str() ) )
+    {
+    if( itksys::SystemTools::GetFilenameLastExtension(
+          itksys::SystemTools::GetFilenameName( filename ) ) != ".img" )
+      {
+      itkDebugMacro(<<"The directory extension is not recognized");
+      return false;
+      }
+    itksys::Directory directory;
+    directory.Load( filename.c_str() );
+    for( unsigned long n = 0; n < directory.GetNumberOfFiles(); n++ )
+      {
+      std::string extension = itksys::SystemTools::LowerCase(
+        itksys::SystemTools::GetFilenameLastExtension( directory.GetFile( n ) ) );
+      if( extension == ".fdf" )
+        {
+        return true;
+        }
+      }
+    itkDebugMacro(<<"The directory contains no .fdf file");
+    return false;
+    }
+
   bool extensionFound = false;
   std::string::size_type FDFPos = filename.rfind(".fdf");
   if ((FDFPos != std::string::npos)
@@ -75,216 +112,561 @@ bool FDFImageIO::CanReadFile(const char* file)
   return true;
 }
 
+void FDFImageIO::ParseHeader( const std::string &fileName, SliceHeader &header )
+{
+  header.FileName = fileName;
+  header.ComponentType = UNKNOWNCOMPONENTTYPE;
+  header.DataByteOrder = OrderNotApplicable;
+  header.SliceNumber = 0;
+  header.EchoNumber = 0;
+  header.ArrayIndex = 0;
+  header.Position = 0.0;
+
+  std::ifstream inFile( fileName.c_str(), std::ios::in | std::ios::binary );
+  if( !inFile )
+    {
+    ExceptionObject exception( __FILE__, __LINE__ );
+    std::string msg = "File \"" + fileName + "\" cannot be read.";
+    exception.SetDescription( msg.c_str() );
+    throw exception;
+    }
+  inFile.seekg( 0, std::ios::end );
+  header.FileSize = static_cast<unsigned long>( inFile.tellg() );
+  inFile.seekg( 0, std::ios::beg );
+
+  // The text header ends with a NUL character.  Read it in blocks rather
+  // than line by line and split the lines in memory.
+  std::string text;
+  char block[4096];
+  while( inFile )
+    {
+    inFile.read( block, sizeof( block ) );
+    const std::streamsize count = inFile.gcount();
+    const char *end = static_cast<const char *>( memchr( block, '\0', count ) );
+    if( end )
+      {
+      text.append( block, end - block );
+      break;
+      }
+    text.append( block, count );
+    }
+
+  std::vector<std::string> tokens;
+  std::string::size_type lineStart = 0;
+  while( lineStart < text.size() )
+    {
+    std::string::size_type lineEnd = text.find( '\n', lineStart );
+    if( lineEnd == std::string::npos )
+      {
+      lineEnd = text.size();
+      }
+
+    // Formats the lines in the FDF header such as removing whitespace between {}
+    std::string line = ParseLine( text.substr( lineStart, lineEnd - lineStart ) );
+    lineStart = lineEnd + 1;
+
+    tokens.clear();
+    Tokenize( line, tokens, " ;" );
+    if( tokens.size() != 4 )
+      {
+      continue;
+      }
+
+    const std::string &name = tokens[1];
+    const std::string &value = tokens[3];
+
+    if( name == "spatial_rank" )
+      {
+      header.SpatialRank = value;
+      }
+    else if( name == "matrix" )
+      {
+      StringToVector( value, header.Matrix );
+      }
+    else if( name == "orientation" )
+      {
+      StringToVector( value, header.Orientation );
+      }
+    else if( name == "span" )
+      {
+      StringToVector( value, header.Span );
+      }
+    else if( name == "origin" )
+      {
+      StringToVector( value, header.Origin );
+      }
+    else if( name == "roi" )
+      {
+      StringToVector( value, header.Roi );
+      }
+    else if( name == "location" )
+      {
+      StringToVector( value, header.Location );
+      }
+    else if( name == "bigendian" )
+      {
+      header.DataByteOrder = ( value == "0" ) ? LittleEndian : BigEndian;
+      }
+    else if( name == "storage" )
+      {
+      // Get the binary data type
+      if( value == "double" )
+        {
+        header.ComponentType = DOUBLE;
+        }
+      else if( value == "float" )
+        {
+        header.ComponentType = FLOAT;
+        }
+      else if( value == "long" )
+        {
+        header.ComponentType = LONG;
+        }
+      else if( value == "unsigned long" )
+        {
+        header.ComponentType = ULONG;
+        }
+      else if( value == "int" )
+        {
+        header.ComponentType = INT;
+        }
+      else if( value == "unsigned int" )
+        {
+        header.ComponentType = UINT;
+        }
+      else if( value == "short" )
+        {
+        header.ComponentType = SHORT;
+        }
+      else if( value == "unsigned short" )
+        {
+        header.ComponentType = USHORT;
+        }
+      else if( value == "char" )
+        {
+        header.ComponentType = CHAR;
+        }
+      else if( value == "unsigned char" )
+        {
+        header.ComponentType = UCHAR;
+        }
+      else
+        {
+        ExceptionObject exception( __FILE__, __LINE__ );
+        std::string msg = "Unknown component type: " + value;
+        exception.SetDescription( msg.c_str() );
+        throw exception;
+        }
+      }
+    else if( name == "bits" )
+      {
+      ConvertFromString( value, header.Bits );
+      }
+    else if( name == "checksum" )
+      {
+      ConvertFromString( value, header.Checksum );
+      }
+    else if( name == "slice_no" )
+      {
+      ConvertFromString( value, header.SliceNumber );
+      }
+    else if( name == "echo_no" )
+      {
+      ConvertFromString( value, header.EchoNumber );
+      }
+    else if( name == "array_index" )
+      {
+      ConvertFromString( value, header.ArrayIndex );
+      }
+    }
+
+  // Slices of a 2D series are stacked along the slice axis of the logical
+  // frame, the third component of their location.
+  if( header.Matrix.size() == 2 && header.Location.size() > 2 )
+    {
+    header.Position = header.Location[2];
+    }
+}
+
 void FDFImageIO::ReadImageInformation()
 {
   if(!this->CanReadFile(m_FileName.c_str()))
     RAISE_EXCEPTION();
 
-  std::string line;
-  std::vector<std::string> tokens;
-  std::string type, name, value;
+  this->SetFileTypeToBinary();
+
+  std::vector<std::string> fileNames;
+  if( itksys::SystemTools::FileIsDirectory( m_FileName.c_str() ) )
+    {
+    itksys::Directory directory;
+    directory.Load( m_FileName.c_str() );
+    for( unsigned long n = 0; n < directory.GetNumberOfFiles(); n++ )
+      {
+      std::string file = directory.GetFile( n );
+      if( itksys::SystemTools::LowerCase(
+            itksys::SystemTools::GetFilenameLastExtension( file ) ) == ".fdf" )
+        {
+        fileNames.push_back( m_FileName + "/" + file );
+        }
+      }
+    std::sort( fileNames.begin(), fileNames.end() );
+    }
+  else
+    {
+    fileNames.push_back( m_FileName );
+    }
 
-  ImageIORegion region;
+  this->m_Slices.clear();
+  this->m_Slices.resize( fileNames.size() );
+  for( unsigned int n = 0; n < fileNames.size(); n++ )
+    {
+    this->m_Slices[n].FileName = fileNames[n];
+    }
+  this->RunSeriesStep( ParseHeaders );
+
+  const SliceHeader &header = this->m_Slices[0];
+  if( header.Matrix.empty() || header.ComponentType == UNKNOWNCOMPONENTTYPE )
+    {
+    itkExceptionMacro( "No matrix or storage in the header of "
+      << header.FileName );
+    }
 
-  std::ifstream inFile(m_FileName.c_str(), std::ios::in | std::ios::binary);
+  this->m_SpatialRank = header.SpatialRank;
+  this->m_Checksum = header.Checksum;
+  this->m_Bits = header.Bits;
+  this->m_Location = header.Location;
+  this->m_Span = header.Span;
+  this->m_Roi = header.Roi;
 
-  // Check if there was an error opening the file
-  if (!inFile)
+  this->SetPixelType( SCALAR );
+  this->SetComponentType( header.ComponentType );
+  if( header.DataByteOrder == LittleEndian )
     {
-    std::cout << "Unable to open the file\n";
-    RAISE_EXCEPTION();
+    this->SetByteOrderToLittleEndian();
+    }
+  else if( header.DataByteOrder == BigEndian )
+    {
+    this->SetByteOrderToBigEndian();
     }
 
-  this->SetFileTypeToBinary();
+  this->AssembleSeries();
 
-  while( getline( inFile, line, '\n' ) )
+  if( this->m_Slices.size() == 1 )
     {
-    if ( line == "\0" )
+    if( header.FileSize < this->GetImageSizeInBytes() )
       {
-      break;
+      itkExceptionMacro( << header.FileName << " is too small for its matrix." );
       }
+    this->m_InputPosition = header.FileSize - this->GetImageSizeInBytes();
+    }
+}
 
-    // Formats the lines in the FDF header such as removing whitespace between {}
-    line = ParseLine( line );
-    Tokenize( line, tokens, " ;" );
+namespace
+{
+// Order of the slices of a series: by position, then echo, array index
+// and file name.
+struct FDFSliceOrder
+{
+  FDFSliceOrder( const std::vector<double> &positions,
+    const std::vector<int> &echoes, const std::vector<int> &arrays )
+    : m_Positions( positions ), m_Echoes( echoes ), m_Arrays( arrays ) {}
+
+  bool operator()( unsigned int a, unsigned int b ) const
+    {
+    if( m_Positions[a] != m_Positions[b] )
+      {
+      return m_Positions[a] < m_Positions[b];
+      }
+    if( m_Echoes[a] != m_Echoes[b] )
+      {
+      return m_Echoes[a] < m_Echoes[b];
+      }
+    if( m_Arrays[a] != m_Arrays[b] )
+      {
+      return m_Arrays[a] < m_Arrays[b];
+      }
+    return a < b;
+    }
+
+  const std::vector<double> &m_Positions;
+  const std::vector<int>    &m_Echoes;
+  const std::vector<int>    &m_Arrays;
+};
+}
 
-    if( tokens.size() == 4 )
+void FDFImageIO::AssembleSeries()
+{
+  const SliceHeader &header = this->m_Slices[0];
+  const unsigned int numberOfFiles = this->m_Slices.size();
+  const unsigned int rank = header.Matrix.size();
+
+  std::vector<double> positions( numberOfFiles );
+  std::vector<int> echoes( numberOfFiles );
+  std::vector<int> arrays( numberOfFiles );
+  for( unsigned int n = 0; n < numberOfFiles; n++ )
+    {
+    const SliceHeader &slice = this->m_Slices[n];
+    if( slice.Matrix != header.Matrix ||
+        slice.ComponentType != header.ComponentType ||
+        slice.DataByteOrder != header.DataByteOrder )
       {
-      type = tokens[0];
-      name = tokens[1];
-      value = tokens[3];
+      itkExceptionMacro( "The matrix, storage or byte order of "
+        << slice.FileName << " differs from the one of " << header.FileName );
+      }
+    positions[n] = slice.Position;
+    echoes[n] = slice.EchoNumber;
+    arrays[n] = slice.ArrayIndex;
+    }
 
-      if( name == "spatial_rank" )
+  std::vector<unsigned int> order( numberOfFiles );
+  for( unsigned int n = 0; n < numberOfFiles; n++ )
+    {
+    order[n] = n;
+    }
+  std::sort( order.begin(), order.end(), FDFSliceOrder( positions, echoes, arrays ) );
+
+  // Group the sorted files by slice position (1e-4 cm apart at least).
+  std::vector<double> slicePositions;
+  std::vector<unsigned int> sliceOfFile( numberOfFiles );
+  std::vector<unsigned int> volumeOfFile( numberOfFiles );
+  std::vector<unsigned int> filesPerSlice;
+  for( unsigned int k = 0; k < numberOfFiles; k++ )
+    {
+    const double position = positions[order[k]];
+    if( slicePositions.empty() ||
+        vnl_math_abs( position - slicePositions.back() ) > 1e-4 )
+      {
+      slicePositions.push_back( position );
+      filesPerSlice.push_back( 0 );
+      }
+    sliceOfFile[order[k]] = slicePositions.size() - 1;
+    volumeOfFile[order[k]] = filesPerSlice.back()++;
+    }
+  const unsigned int numberOfSlices = slicePositions.size();
+  const unsigned int numberOfVolumes = filesPerSlice[0];
+  for( unsigned int s = 1; s < numberOfSlices; s++ )
+    {
+    if( filesPerSlice[s] != numberOfVolumes )
+      {
+      itkExceptionMacro( "The slice positions of " << m_FileName
+        << " do not have the same number of files." );
+      }
+    }
+
+  // A 2D series adds the slice axis, several files per slice a volume axis.
+  unsigned int numberOfDimensions = rank;
+  if( rank == 2 && numberOfFiles > 1 )
+    {
+    numberOfDimensions++;
+    }
+  if( numberOfVolumes > 1 )
+    {
+    numberOfDimensions++;
+    }
+  if( numberOfDimensions < header.Origin.size() )
+    {
+    numberOfDimensions = header.Origin.size();
+    }
+  this->SetNumberOfDimensions( numberOfDimensions );
+
+  ImageIORegion region( numberOfDimensions );
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    unsigned int size = 1;
+    double spacing = 1.0;
+    double origin = 0.0;
+    bool isSliceAxis = false;
+    if( i < rank )
+      {
+      size = static_cast<unsigned int>( header.Matrix[i] );
+      if( i < header.Roi.size() )
         {
-        this->m_SpatialRank = value;
+        spacing = ( header.Roi[i] * 10 ) / size;
         }
+      }
+    else if( i == rank && rank == 2 && numberOfFiles > 1 )
+      {
+      // The slice axis, positions are in cm.
+      size = numberOfSlices;
+      if( numberOfSlices > 1 )
+        {
+        spacing = ( slicePositions[1] - slicePositions[0] ) * 10;
+        }
+      else if( header.Roi.size() > 2 )
+        {
+        spacing = header.Roi[2] * 10;
+        }
+      origin = slicePositions[0] * 10;
+      isSliceAxis = true;
+      }
+    else if( i == numberOfDimensions - 1 && numberOfVolumes > 1 )
+      {
+      size = numberOfVolumes;
+      }
+    if( i < header.Origin.size() && !isSliceAxis )
+      {
+      // Also in cm, like the roi and the slice positions.
+      origin = header.Origin[i] * 10;
+      }
+
+    this->SetDimensions( i, size );
+    this->SetSpacing( i, spacing );
+    this->SetOrigin( i, origin );
+    region.SetSize( i, size );
+    region.SetIndex( i, 0 );
 
-      if( name == "matrix" )
+    // The orientation is a row-major 3x3 matrix of the logical axes.
+    std::vector<double> direction( numberOfDimensions, 0.0 );
+    direction[i] = 1.0;
+    if( i < 3 && header.Orientation.size() == 9 )
+      {
+      for( unsigned int j = 0; j < numberOfDimensions && j < 3; j++ )
         {
-        std::vector<float> dimensions;
-        StringToVector( value, dimensions );
+        direction[j] = header.Orientation[i * 3 + j];
+        }
+      }
+    this->SetDirection( i, direction );
+    }
+  this->SetIORegion( region );
 
-        // Set the number of dimensions
-        if( this->GetNumberOfDimensions() < dimensions.size() )
-          {
-          this->SetNumberOfDimensions( dimensions.size() );
-          }
+  // Offset of each file in the output buffer
+  unsigned long slicePixels = 1;
+  for( unsigned int i = 0; i < rank; i++ )
+    {
+    slicePixels *= static_cast<unsigned long>( header.Matrix[i] );
+    }
+  this->m_SliceOffsets.resize( numberOfFiles );
+  for( unsigned int n = 0; n < numberOfFiles; n++ )
+    {
+    this->m_SliceOffsets[n] = slicePixels *
+      ( volumeOfFile[n] * numberOfSlices + sliceOfFile[n] );
+    }
+}
 
-        ImageIORegion::SizeType   size( dimensions.size() );
-        ImageIORegion::IndexType  index( dimensions.size() );
+void FDFImageIO::ReadPayload( const std::string &fileName, unsigned long offset,
+  unsigned long length, char *buffer )
+{
+#if !defined( _WIN32 )
+  int fd = open( fileName.c_str(), O_RDONLY );
+  if( fd >= 0 )
+    {
+    const unsigned long pageSize = sysconf( _SC_PAGESIZE );
+    const unsigned long base = offset - offset % pageSize;
+    const unsigned long mappedLength = length + ( offset - base );
+    void *address = mmap( NULL, mappedLength, PROT_READ, MAP_PRIVATE, fd,
+      static_cast<off_t>( base ) );
+    close( fd );
+    if( address != MAP_FAILED )
+      {
+      madvise( address, mappedLength, MADV_SEQUENTIAL );
+      memcpy( buffer, static_cast<const char *>( address ) + ( offset - base ),
+        length );
+      munmap( address, mappedLength );
+      return;
+      }
+    }
+#endif
 
-        for( unsigned int i = 0; i < dimensions.size(); i++ )
-          {
-          this->SetDimensions( i, dimensions[i] );
-          size[i] = dimensions[i];
-          index[i] = 0;
-          }
+  std::ifstream inFile( fileName.c_str(), std::ios::in | std::ios::binary );
+  inFile.seekg( offset );
+  inFile.read( buffer, length );
+  if( !inFile )
+    {
+    ExceptionObject exception( __FILE__, __LINE__ );
+    std::string msg = "Error reading image data from " + fileName;
+    exception.SetDescription( msg.c_str() );
+    throw exception;
+    }
+}
 
-        region.SetSize( size );
-        region.SetIndex( index );
-        this->SetIORegion( region );
-        }
+void FDFImageIO::RunSeriesStep( ThreadedStepType step )
+{
+  MultiThreader::Pointer threader = MultiThreader::New();
+  if( static_cast<unsigned int>( threader->GetNumberOfThreads() ) > this->m_Slices.size() )
+    {
+    threader->SetNumberOfThreads( this->m_Slices.size() );
+    }
 
-      if( name == "orientation" )
-        {
-        std::vector<double> orientation;
-        StringToVector( value, orientation );
+  this->m_CurrentStep = step;
+  this->m_ThreadErrors.clear();
+  this->m_ThreadErrors.resize( threader->GetNumberOfThreads() );
 
-        for( unsigned int i = 0; i < this->GetNumberOfDimensions(); i++ )
-          {
-          std::vector<double> componentVector;
-          for( unsigned int j = 0; j < this->GetNumberOfDimensions(); j++ )
-            {
-            componentVector.push_back( orientation[i * this->GetNumberOfDimensions() + j] );
-            }
-          this->SetDirection( i, componentVector );
-          }
-        }
+  ThreadStruct str;
+  str.IO = this;
+  threader->SetSingleMethod( this->SeriesThreaderCallback, &str );
+  threader->SingleMethodExecute();
 
-      if( name == "span" )
-        {
-        StringToVector( value, this->m_Span );
-        }
+  for( unsigned int n = 0; n < this->m_ThreadErrors.size(); n++ )
+    {
+    if( !this->m_ThreadErrors[n].empty() )
+      {
+      itkExceptionMacro( << this->m_ThreadErrors[n] );
+      }
+    }
+}
 
-      if( name == "origin" )
-        {
-        std::vector<float> origin;
-        StringToVector( value, origin );
+ITK_THREAD_RETURN_TYPE FDFImageIO::SeriesThreaderCallback( void *arg )
+{
+  unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
 
-        if( this->GetNumberOfDimensions() < origin.size() )
-          {
-          this->SetNumberOfDimensions( origin.size() );
-          }
+  ThreadStruct *str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
 
-        for( unsigned int i = 0; i < origin.size(); i++ )
-          {
-          this->SetOrigin( i, origin[i] / 10.0 );
-          }
-        }
+  str->IO->ThreadedSeriesStep( threadId, threadCount );
 
-      if( name == "roi" )
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+void FDFImageIO::ThreadedSeriesStep( unsigned int threadId, unsigned int threadCount )
+{
+  try
+    {
+    const unsigned long componentSize = this->GetComponentSize();
+
+    for( unsigned int n = threadId; n < this->m_Slices.size(); n += threadCount )
+      {
+      SliceHeader &slice = this->m_Slices[n];
+      if( this->m_CurrentStep == ParseHeaders )
         {
-        StringToVector( value, this->m_Roi );
+        ParseHeader( slice.FileName, slice );
+        continue;
         }
 
-      if( name == "location" )
+      unsigned long slicePixels = 1;
+      for( unsigned int i = 0; i < slice.Matrix.size(); i++ )
         {
-        StringToVector( value, this->m_Location );
+        slicePixels *= static_cast<unsigned long>( slice.Matrix[i] );
         }
-
-      if( name == "bigendian" )
+      const unsigned long sliceBytes = slicePixels * componentSize;
+      if( slice.FileSize < sliceBytes )
         {
-        if( value == "0" )
-          {
-          this->SetByteOrderToLittleEndian();
-          }
-        else
-          {
-          this->SetByteOrderToBigEndian();
-          }
+        itkExceptionMacro( << slice.FileName << " is too small for its matrix." );
         }
 
-      // Get the binary data type
-      if( name == "storage" )
-        {
-        this->SetPixelType( SCALAR );
-
-        if( value == "double" )
-          {
-          this->SetComponentType( DOUBLE );
-          }
-        else if( value == "float" )
-          {
-          this->SetComponentType( FLOAT );
-          }
-        else if( value == "long" )
-          {
-          this->SetComponentType( LONG );
-          }
-        else if( value == "unsigned long" )
-          {
-          this->SetComponentType( ULONG );
-          }
-        else if( value == "int" )
-          {
-          this->SetComponentType( INT );
-          }
-        else if( value == "unsigned int" )
-          {
-          this->SetComponentType( UINT );
-          }
-        else if( value == "short" )
-          {
-          this->SetComponentType( SHORT );
-          }
-        else if( value == "unsigned short" )
-          {
-          this->SetComponentType( USHORT );
-          }
-        else if( value == "char" )
-          {
-          this->SetComponentType( CHAR );
-          }
-        else if( value == "unsigned char" )
-          {
-          this->SetComponentType( UCHAR );
-          }
-        else
-          {
-          itkExceptionMacro( "Unknown component type: " << value );
-          }
-        }
-
-      // Get the bits
-      if( name == "bits" )
-        {
-        ConvertFromString( value, this->m_Bits );
-        }
-
-      // Get the checksum
-      if( name == "checksum" )
-        {
-        ConvertFromString( value, this->m_Checksum );
-        }
+      char *out = this->m_ReadBuffer + this->m_SliceOffsets[n] * componentSize;
+      ReadPayload( slice.FileName, slice.FileSize - sliceBytes, sliceBytes, out );
+      this->SwapBytesIfNecessary( out, slicePixels );
       }
-
-    tokens.clear();
     }
-
-  inFile.seekg( 0, std::ios::end );
-  long int fileSize = inFile.tellg();
-  this->m_InputPosition = fileSize - this->GetImageSizeInBytes();
-
-  for( unsigned int i = 0; i < this->GetNumberOfDimensions(); i++ )
+  catch( ExceptionObject &err )
+    {
+    this->m_ThreadErrors[threadId] = err.GetDescription();
+    }
+  catch( std::exception &err )
     {
-    this->SetSpacing( i, ( this->m_Roi[i] * 10 ) / this->GetDimensions( i ) );
+    this->m_ThreadErrors[threadId] = err.what();
     }
 }
 
-
-void FDFImageIO::ReadVolume(void*)
+void FDFImageIO::ReadVolume(void* buffer)
 {
-
+  if( this->m_Slices.empty() )
+    {
+    itkExceptionMacro( "ReadImageInformation() must be called first." );
+    }
+  this->m_ReadBuffer = static_cast<char *>( buffer );
+  this->RunSeriesStep( ReadSlices );
+  this->m_ReadBuffer = NULL;
 }
 
 // const std::type_info& FDFImageIO::GetPixelType() const
@@ -368,31 +750,16 @@ void FDFImageIO::ReadVolume(void*)
 
 void FDFImageIO::Read(void* buffer)
 {
-  std::ifstream inFile(m_FileName.c_str(), std::ios::in | std::ios::binary);
-
-  // Check if there was an error opening the file
-  if (!inFile)
-  {
-    RAISE_EXCEPTION();
-  }
-
-  inFile.seekg( this->m_InputPosition );
-
-  if (!inFile)
+  if( this->m_Slices.size() > 1 )
     {
-    RAISE_EXCEPTION();
+    this->ReadVolume( buffer );
+    return;
     }
 
-  char * p = static_cast<char *>(buffer);
-
-  inFile.read( p, this->GetImageSizeInBytes() );
-
-  bool success = !inFile.bad();
-  inFile.close();
-  if( !success )
-    {
-    itkExceptionMacro("Error reading image data.");
-    }
+  const std::string fileName =
+    this->m_Slices.empty() ? m_FileName : this->m_Slices[0].FileName;
+  ReadPayload( fileName, this->m_InputPosition, this->GetImageSizeInBytes(),
+    static_cast<char *>( buffer ) );
 
   this->SwapBytesIfNecessary( buffer, this->GetImageSizeInPixels() );
 }
@@ -400,6 +767,9 @@ void FDFImageIO::Read(void* buffer)
 
 FDFImageIO::FDFImageIO()
 {
+  this->m_InputPosition = 0;
+  this->m_CurrentStep = ParseHeaders;
+  this->m_ReadBuffer = NULL;
 }
 
 FDFImageIO::~FDFImageIO() {}
@@ -407,6 +777,7 @@ FDFImageIO::~FDFImageIO() {}
 void FDFImageIO::PrintSelf(std::ostream& os, Indent indent) const
 {
   Superclass::PrintSelf(os, indent);
+  os << indent << "Number of files: " << this->m_Slices.size() << "\n";
 //   os << indent << "PixelType " << m_PixelType << "\n";
 //   os << indent << "Start of image in bytes from start of file " << this->m_InputPosition << "\n";
 //   os << indent << "Number of pixels in image: " << this->GetImageSizeInPixels() << "\n";
@@ -458,6 +829,20 @@ void FDFImageIO::SwapBytesIfNecessary( void* buffer, unsigned long numberOfPixel
         }
       break;
       }
+    case DOUBLE:
+      {
+      if ( this->m_ByteOrder == LittleEndian )
+        {
+        ByteSwapper<double>::SwapRangeFromSystemToLittleEndian(
+          (double *)buffer, numberOfPixels );
+        }
+      else if ( this->m_ByteOrder == BigEndian )
+        {
+        ByteSwapper<double>::SwapRangeFromSystemToBigEndian(
+          (double *)buffer, numberOfPixels );
+        }
+      break;
+      }
     case UCHAR:
       {
       if ( this->m_ByteOrder == LittleEndian )
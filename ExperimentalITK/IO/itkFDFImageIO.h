@@ -19,11 +19,23 @@
 #define __itkFDFImageIO_h
 
 #include "itkImageIOBase.h"
+#include "itkMultiThreader.h"
+
+#include <string>
+#include <vector>
 
 namespace itk
 {
 
 /* \brief ImageIO object for reading and writing FDF images
+ *
+ * Besides single .fdf files, the IO reads a Varian acquisition directory
+ * (name.img) holding one .fdf file per slice as a single 3D image, or as
+ * a 4D image when several files (echoes, array elements) share a slice
+ * position.  The headers are parsed in parallel and the slices are sorted
+ * by position and then by echo and array index.  Each slice payload is
+ * memory mapped and copied straight into its place in the output buffer,
+ * where it is byte swapped in place.
  *
  * \ingroup IOFilters
  *
@@ -44,7 +56,7 @@ public:
 
   virtual bool SupportsDimension( unsigned long dim )
     {
-    if( dim == 2 || dim == 3 )
+    if( dim == 2 || dim == 3 || dim == 4 )
       {
       return true;
       }
@@ -70,7 +82,8 @@ public:
   /** Reads the data from disk into the memory buffer provided. */
   virtual void Read(void* buffer);
 
-  /** Reads 3D data from multiple files assuming one slice per file. */
+  /** Reads 3D (or 4D) data from multiple files assuming one slice per
+   * file.  ReadImageInformation() must have been called on the directory. */
   virtual void ReadVolume(void* buffer);
 
   /** Compute the size (in bytes) of the components of a pixel. For
@@ -105,6 +118,53 @@ private:
   FDFImageIO(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
 
+  /** The header fields of one .fdf file. */
+  struct SliceHeader
+    {
+    std::string          FileName;
+    unsigned long        FileSize;
+    std::string          SpatialRank;
+    std::string          Checksum;
+    std::string          Bits;
+    std::vector<float>   Matrix;
+    std::vector<float>   Location;
+    std::vector<float>   Span;
+    std::vector<float>   Roi;
+    std::vector<float>   Origin;
+    std::vector<double>  Orientation;
+    IOComponentType      ComponentType;
+    ByteOrder            DataByteOrder;
+    int                  SliceNumber;
+    int                  EchoNumber;
+    int                  ArrayIndex;
+    double               Position;
+    };
+
+  /** Parse the header of a file, which is read in one block rather than
+   * line by line.  Thread safe; throws on error. */
+  static void ParseHeader( const std::string &fileName, SliceHeader &header );
+
+  /** Copy bytes [offset, offset + length) of a file into buffer through a
+   * memory mapping.  Thread safe; throws on error. */
+  static void ReadPayload( const std::string &fileName, unsigned long offset,
+    unsigned long length, char *buffer );
+
+  /** Sort the slices of a series and set the geometry of the image. */
+  void AssembleSeries();
+
+  /** Multi-threading support. */
+  enum ThreadedStepType { ParseHeaders, ReadSlices };
+
+  struct ThreadStruct
+    {
+    Self *IO;
+    };
+
+  static ITK_THREAD_RETURN_TYPE SeriesThreaderCallback( void * );
+
+  void ThreadedSeriesStep( unsigned int, unsigned int );
+  void RunSeriesStep( ThreadedStepType );
+
   void SwapBytesIfNecessary(void* buffer, unsigned long numberOfPixels);
 
   // Position after ReadImageInformation.
@@ -117,6 +177,16 @@ private:
   std::vector<float>   m_Location;
   std::vector<float>   m_Span;
   std::vector<float>   m_Roi;
+
+  /** The files of the current image (one unless reading a directory) and
+   * the offset (in pixels) of each one in the output buffer. */
+  std::vector<SliceHeader>   m_Slices;
+  std::vector<unsigned long> m_SliceOffsets;
+
+  /** State of the current threaded step */
+  ThreadedStepType           m_CurrentStep;
+  char                       *m_ReadBuffer;
+  std::vector<std::string>   m_ThreadErrors;
 };
 
 } // end namespace itk
@@ -33,6 +33,26 @@ namespace itk
  * \brief
  * Reads a file and creates an itkMesh.
  *
+ * The file type is given by the extension: .txt (Avants' format, one
+ * "x y z label" row per point), .vtk (legacy VTK polydata, ASCII or
+ * BINARY), .lps (the binary format of LabeledPointSetFileWriter) or an
+ * image, whose non-zero voxels become the points.
+ *
+ * Text and VTK files are memory mapped and parsed in one pass: each
+ * numeric block is located first and then parsed in parallel chunks with
+ * a locale independent number parser (see TextNumberParser).
+ *
+ * The .lps format is little endian:
+ *   char[8]        "ITKLPS01"
+ *   uint32         dimension, coordinate size (4 or 8), number of
+ *                  multi-component scalar components (0 if none)
+ *   uint64         number of points, number of lines, number of line values
+ *   coordinates    number of points x dimension (float32 or float64)
+ *   float64        number of points labels
+ *   float64        number of points x components scalars
+ *   uint64         lines, each one as its length followed by its point ids
+ *
+ * \sa LabeledPointSetFileWriter
  */
 template <class TOutputMesh>
 class LabeledPointSetFileReader 
@@ -119,11 +139,24 @@ private:
   
   void ReadPointsFromImageFile();
   void ReadPointsFromAvantsFile();
+  void ReadPointsFromBinaryFile();
 
+  /** The VTK sections are read in one pass over the mapped file.  Each
+   * method reads the section whose header line starts at the given
+   * position and returns the position after its data.  Only the first
+   * SCALARS array is stored. */
   void ReadVTKFile();
-  void ReadPointsFromVTKFile();
-  void ReadScalarsFromVTKFile();
-  void ReadLinesFromVTKFile();
+  const char * ReadPointsFromVTKFile( const char *, const char *, bool );
+  const char * ReadScalarsFromVTKFile( const char *, const char *, bool, bool );
+  const char * ReadLinesFromVTKFile( const char *, const char *, bool );
+
+  /** Read count values of a VTK data block of the given type starting at
+   * p.  ASCII blocks end at the next line starting with a keyword. */
+  const char * ReadVTKValues( const char *p, const char *end, bool isBinary,
+    const std::string &type, unsigned long count, std::vector<double> &values );
+
+  template<class TValue>
+  static void ReadBigEndianValues( const char *, unsigned long, double * );
 
 };
 
@@ -26,8 +26,15 @@
 #include "itkLabelContourImageFilter.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 #include "itkByteSwapper.h"
+#include "itkMemoryMappedFile.h"
+#include "itkTextNumberParser.h"
 
+#include "vxl_config.h"
+
+#include <algorithm>
 #include <fstream>
+#include <set>
+#include <sstream>
 #include <stdio.h>
 #include <string>
 
@@ -96,6 +103,10 @@ LabeledPointSetFileReader<TOutputMesh>
     {
     this->ReadVTKFile();
     }
+  else if( extension == "lps" )
+    {
+    this->ReadPointsFromBinaryFile();
+    }
   else // try reading the file as an image
     {
     this->ReadPointsFromImageFile();
@@ -160,12 +171,13 @@ LabeledPointSetFileReader<TOutputMesh>
 
   if( this->GetOutput()->GetNumberOfPoints() > 0 )
     {
+    // The labels are kept in the order they first appear.
+    std::set<PixelType> labels;
     typename OutputMeshType::PointDataContainerIterator ItD =
       this->GetOutput()->GetPointData()->Begin();
     while( ItD != this->GetOutput()->GetPointData()->End() )
       {
-      if( find( this->m_LabelSet.begin(), 
-        this->m_LabelSet.end(), ItD.Value() ) == this->m_LabelSet.end() )
+      if( labels.insert( ItD.Value() ).second )
         {
         this->m_LabelSet.push_back( ItD.Value() );
         }
@@ -181,23 +193,35 @@ LabeledPointSetFileReader<TOutputMesh>
 {
   typename OutputMeshType::Pointer outputMesh = this->GetOutput();
 
-  std::ifstream inputFile( m_FileName.c_str() );
+  MemoryMappedFile file;
+  if( !file.Open( this->m_FileName ) )
+    {
+    itkExceptionMacro( "Unable to open file " << this->m_FileName );
+    }
+
+  // Rows of four values: x y z label (x y 0 label in 2-D).
+  std::vector<double> values;
+  if( !TextNumberParser::ParseReals( file.GetData(), file.GetEnd(), values ) )
+    {
+    itkExceptionMacro( "Invalid number in " << this->m_FileName );
+    }
+  file.Close();
+
+  const unsigned long numberOfRows = values.size() / 4;
 
   unsigned long count = 0;
-  while( !inputFile.eof() )
+  for( unsigned long n = 0; n < numberOfRows; n++ )
     {
-    PointType point;
-    PixelType label;
+    const double *row = &values[4 * n];
 
-    if( Dimension == 2 )
-      {
-      float trash;
-      inputFile >> point >> trash >> label;
-      }
-    else // Dimension == 3
+    PointType point;
+    for( unsigned int d = 0; d < Dimension; d++ )
       {
-      inputFile >> point >> label;
+      point[d] = row[d];
       }
+    PixelType label = static_cast<PixelType>( row[3] );
+
+    // Skip the "0 0 0 0" rows that delimit the file.
     if( ( point.GetVectorFromOrigin() ).GetSquaredNorm() > 0.0
          || label != 0 )
       {
@@ -206,331 +230,484 @@ LabeledPointSetFileReader<TOutputMesh>
       count++;
       }
     }
-  inputFile.close();
-}
-
-template<class TOutputMesh>
-void
-LabeledPointSetFileReader<TOutputMesh>
-::ReadVTKFile()
-{
-  this->ReadPointsFromVTKFile(); 
-  this->ReadScalarsFromVTKFile();
-  this->ReadLinesFromVTKFile();
 }
 
 template<class TOutputMesh>
 void
 LabeledPointSetFileReader<TOutputMesh>
-::ReadPointsFromVTKFile()
+::ReadPointsFromBinaryFile()
 {
   typename OutputMeshType::Pointer outputMesh = this->GetOutput();
 
-  std::ifstream inputFile( this->m_FileName.c_str() );
+  MemoryMappedFile file;
+  if( !file.Open( this->m_FileName ) )
+    {
+    itkExceptionMacro( "Unable to open file " << this->m_FileName );
+    }
 
-  std::string line;
-  
-  bool isBinary = false;
+  const unsigned long headerSize = 8 + 3 * 4 + 3 * 8;
+  if( file.GetSize() < headerSize ||
+      strncmp( file.GetData(), "ITKLPS01", 8 ) != 0 )
+    {
+    itkExceptionMacro( << this->m_FileName << " is not a labeled point set file." );
+    }
 
-  while( !inputFile.eof() )
+  vxl_uint_32 header32[3];
+  vxl_uint_64 header64[3];
+  memcpy( header32, file.GetData() + 8, sizeof( header32 ) );
+  memcpy( header64, file.GetData() + 8 + sizeof( header32 ), sizeof( header64 ) );
+  ByteSwapper<vxl_uint_32>::SwapRangeFromSystemToLittleEndian( header32, 3 );
+  ByteSwapper<vxl_uint_64>::SwapRangeFromSystemToLittleEndian( header64, 3 );
+
+  const unsigned int dimension = header32[0];
+  const unsigned int coordinateSize = header32[1];
+  const unsigned int numberOfComponents = header32[2];
+  const unsigned long numberOfPoints = static_cast<unsigned long>( header64[0] );
+  const unsigned long numberOfLines = static_cast<unsigned long>( header64[1] );
+  const unsigned long numberOfLineValues = static_cast<unsigned long>( header64[2] );
+
+  if( dimension != Dimension || ( coordinateSize != 4 && coordinateSize != 8 ) )
     {
-    std::getline( inputFile, line );
+    itkExceptionMacro( << this->m_FileName << " holds " << dimension
+      << "-D points (" << coordinateSize << " bytes per coordinate)." );
+    }
+  const unsigned long expectedSize = headerSize
+    + numberOfPoints * dimension * coordinateSize
+    + numberOfPoints * ( 1 + numberOfComponents ) * 8
+    + ( numberOfLines + numberOfLineValues ) * 8;
+  if( file.GetSize() < expectedSize )
+    {
+    itkExceptionMacro( << this->m_FileName << " is truncated." );
+    }
 
-    if (line.find( "BINARY" ) != std::string::npos )
-      {
-      isBinary = true;
-      }
+  const char *p = file.GetData() + headerSize;
 
-    if( line.find( "POINTS" ) != std::string::npos )
+  // Points
+  std::vector<double> coordinates( numberOfPoints * dimension );
+  if( coordinateSize == 4 )
+    {
+    std::vector<float> buffer( coordinates.size() );
+    if( !buffer.empty() )
       {
-      break;
+      memcpy( &buffer[0], p, buffer.size() * 4 );
+      ByteSwapper<float>::SwapRangeFromSystemToLittleEndian( &buffer[0], buffer.size() );
       }
+    std::copy( buffer.begin(), buffer.end(), coordinates.begin() );
     }
-
-  itkDebugMacro( "POINTS line" << line );
-
-  std::string pointLine( line, strlen( "POINTS " ), line.length() );
-  itkDebugMacro( "pointLine " << pointLine );
-
-  int numberOfPoints = -1;
-
-  if( sscanf( pointLine.c_str(),"%d",&numberOfPoints ) != 1 )
+  else if( !coordinates.empty() )
     {
-    itkExceptionMacro( "ERROR: Failed to read numberOfPoints\n"
-        "       pointLine = " << pointLine );
-    return;
+    memcpy( &coordinates[0], p, coordinates.size() * 8 );
+    ByteSwapper<double>::SwapRangeFromSystemToLittleEndian( &coordinates[0], coordinates.size() );
     }
+  p += coordinates.size() * coordinateSize;
 
-  itkDebugMacro( "numberOfPoints = " << numberOfPoints );
-
-  if( numberOfPoints < 1 )
+  // Labels and scalars
+  std::vector<double> data( numberOfPoints * ( 1 + numberOfComponents ) );
+  if( !data.empty() )
     {
-    itkExceptionMacro( "numberOfPoints < 1"
-        << "       numberOfPoints = " << numberOfPoints );
-    return;
+    memcpy( &data[0], p, data.size() * 8 );
+    ByteSwapper<double>::SwapRangeFromSystemToLittleEndian( &data[0], data.size() );
     }
+  p += data.size() * 8;
 
   outputMesh->GetPoints()->Reserve( numberOfPoints );
+  for( unsigned long i = 0; i < numberOfPoints; i++ )
+    {
+    PointType point;
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      point[d] = coordinates[i * dimension + d];
+      }
+    outputMesh->SetPoint( i, point );
+    outputMesh->SetPointData( i, static_cast<PixelType>( data[i] ) );
+    }
 
-  //
-  // Load the point coordinates into the itk::Mesh
-  //
-  PointType point;
-
-  if (isBinary)
+  if( numberOfComponents > 0 )
     {
-    itkDebugMacro( "Data is binary" );
-          
-    float p;
-    float * ptData = new float [ numberOfPoints*3 ];
-    inputFile.read( reinterpret_cast< char * >( ptData ), 3 * numberOfPoints * sizeof(p) );
-    ByteSwapper<float>::SwapRangeFromSystemToBigEndian(ptData,numberOfPoints*3); 
-    
-    for (long i = 0; i < numberOfPoints; i++ )
+    this->m_MultiComponentScalars = MultiComponentScalarSetType::New();
+    this->m_MultiComponentScalars->Initialize();
+    this->m_MultiComponentScalars->Reserve( numberOfPoints );
+
+    const double *scalars = data.empty() ? 0 : &data[numberOfPoints];
+    for( unsigned long i = 0; i < numberOfPoints; i++ )
       {
-      for (long j = 0; j < Dimension; j++ )
+      MultiComponentScalarType scalar;
+      scalar.SetSize( numberOfComponents );
+      for( unsigned int d = 0; d < numberOfComponents; d++ )
         {
-        point[j] = ptData[i*3+j];
+        scalar[d] = static_cast<PixelType>( scalars[i * numberOfComponents + d] );
         }
-      outputMesh->SetPoint( i, point );
+      this->m_MultiComponentScalars->InsertElement( i, scalar );
       }
-      
-    delete [] ptData;
     }
-  else 
+
+  // Lines
+  if( numberOfLines > 0 )
     {
-    for( long i = 0; i < numberOfPoints; i++ )
+    std::vector<vxl_uint_64> lineData( numberOfLines + numberOfLineValues );
+    memcpy( &lineData[0], p, lineData.size() * 8 );
+    ByteSwapper<vxl_uint_64>::SwapRangeFromSystemToLittleEndian( &lineData[0], lineData.size() );
+
+    this->m_Lines = LineSetType::New();
+    this->m_Lines->Initialize();
+
+    unsigned long valueId = 0;
+    for( unsigned long lineId = 0; lineId < numberOfLines; lineId++ )
       {
-      if( Dimension == 2 )
+      const unsigned long lineLength = static_cast<unsigned long>( lineData[valueId++] );
+      if( valueId + lineLength > lineData.size() )
         {
-        float trash;
-        inputFile >> point >> trash;
+        itkExceptionMacro( << this->m_FileName << " has an invalid line." );
         }
-      else  // Dimension = 3
+      LineType polyLine;
+      polyLine.SetSize( lineLength );
+      for( unsigned long i = 0; i < lineLength; i++ )
         {
-        inputFile >> point;
+        polyLine[i] = static_cast<unsigned long>( lineData[valueId++] );
         }
-      outputMesh->SetPoint( i, point );
+      this->m_Lines->InsertElement( lineId, polyLine );
       }
     }
-
-  inputFile.close();
 }
 
 template<class TOutputMesh>
 void
 LabeledPointSetFileReader<TOutputMesh>
-::ReadScalarsFromVTKFile()
+::ReadVTKFile()
 {
-  typename OutputMeshType::Pointer outputMesh = this->GetOutput();
-
-  std::ifstream inputFile( this->m_FileName.c_str() );
+  MemoryMappedFile file;
+  if( !file.Open( this->m_FileName ) )
+    {
+    itkExceptionMacro( "Unable to open file " << this->m_FileName );
+    }
 
-  std::string line;
+  const char *p = file.GetData();
+  const char *end = file.GetEnd();
 
   bool isBinary = false;
+  bool hasPoints = false;
+  bool hasScalars = false;
 
-  //
-  // Find the labels associated with each pixel
-  //
-  while( !inputFile.eof() )
+  // One pass over the sections.  The header lines before the first
+  // section tell whether the file is binary.
+  while( ( p = TextNumberParser::SkipSpace( p, end ) ) < end )
     {
-    std::getline( inputFile, line );
-    
-   if (line.find( "BINARY" ) != std::string::npos )
+    const char *lineEnd = TextNumberParser::SkipLine( p, end );
+    std::string line( p, lineEnd );
+
+    if( !hasPoints && line.find( "BINARY" ) != std::string::npos )
       {
       isBinary = true;
       }
 
-    if( line.find( "SCALARS" ) != std::string::npos )
+    if( line.compare( 0, 6, "POINTS" ) == 0 )
       {
-      break;
+      p = this->ReadPointsFromVTKFile( p, end, isBinary );
+      hasPoints = true;
+      }
+    else if( line.compare( 0, 5, "LINES" ) == 0 && hasPoints )
+      {
+      p = this->ReadLinesFromVTKFile( p, end, isBinary );
+      }
+    else if( line.compare( 0, 7, "SCALARS" ) == 0 && hasPoints )
+      {
+      // Only the first array is read; the others are skipped.
+      p = this->ReadScalarsFromVTKFile( p, end, isBinary, !hasScalars );
+      hasScalars = true;
+      }
+    else if( ( line.compare( 0, 8, "VERTICES" ) == 0 ||
+               line.compare( 0, 8, "POLYGONS" ) == 0 ||
+               line.compare( 0, 6, "STRIPS" ) == 0 ) && hasPoints )
+      {
+      // Cells other than lines are skipped.
+      std::istringstream fields( line );
+      std::string keyword;
+      unsigned long numberOfCells = 0;
+      unsigned long numberOfValues = 0;
+      fields >> keyword >> numberOfCells >> numberOfValues;
+      std::vector<double> values;
+      p = this->ReadVTKValues( lineEnd, end, isBinary, "int", numberOfValues, values );
+      }
+    else
+      {
+      p = lineEnd;
       }
     }
 
-  if( inputFile.eof() )
+  if( !hasPoints )
     {
-    inputFile.close();
-    return;
+    itkExceptionMacro( "No POINTS in " << this->m_FileName );
     }
+}
 
-  std::string::size_type pos = line.rfind( " " );
-
-  std::string temp = std::string( line, pos+1, line.length()-1 );
-  
-  unsigned int numberOfComponents = std::atoi( temp.c_str() );
-
-  std::getline( inputFile, line );
-
-  if (isBinary)
+template<class TOutputMesh>
+const char *
+LabeledPointSetFileReader<TOutputMesh>
+::ReadVTKValues( const char *p, const char *end, bool isBinary,
+  const std::string &type, unsigned long count, std::vector<double> &values )
+{
+  if( isBinary )
     {
- 
-  
-    int numberOfValues = outputMesh->GetNumberOfPoints()*numberOfComponents;
-    float p;
-    int * scalarData = new int [ numberOfValues ];
-    inputFile.read( reinterpret_cast< char * >( scalarData ), numberOfComponents * sizeof(p) );
-    ByteSwapper<int>::SwapRangeFromSystemToBigEndian(scalarData,numberOfValues); 
-  
-    if( numberOfComponents == 1 )
+    // Binary legacy VTK data are big endian.
+    unsigned int size = 0;
+    if( type == "float" || type == "int" || type == "unsigned_int" )
       {
-      //PixelType label;
-      for( unsigned long i = 0; i < outputMesh->GetNumberOfPoints(); i++ )
-        {
-        outputMesh->SetPointData( i, scalarData[i] );
-        }
-  //    itkExceptionMacro( "Only single label components are readable" );
+      size = 4;
+      }
+    else if( type == "double" || type == "vtktypeint64" || type == "vtkidtype" )
+      {
+      size = 8;
+      }
+    else if( type == "short" || type == "unsigned_short" )
+      {
+      size = 2;
+      }
+    else if( type == "char" || type == "unsigned_char" )
+      {
+      size = 1;
       }
     else
       {
-      this->m_MultiComponentScalars = MultiComponentScalarSetType::New(); 
-      this->m_MultiComponentScalars->Initialize();
-      
-      for( unsigned long i = 0; i < outputMesh->GetNumberOfPoints(); i++ )
-        {
-        MultiComponentScalarType scalar;
-        scalar.SetSize( numberOfComponents );
-        for( unsigned int d = 0; d < numberOfComponents; d++ )
-          {
-          scalar[d] = scalarData[i*numberOfComponents + d];
-          }
-        this->m_MultiComponentScalars->InsertElement( i, scalar );
-        }
-      } 
-    
-      delete [] scalarData;
-   
-    }
-  else
-    {
+      itkExceptionMacro( "Unsupported binary VTK data type: " << type );
+      }
+    if( static_cast<unsigned long>( end - p ) < count * size )
+      {
+      itkExceptionMacro( "Binary VTK data are truncated in " << this->m_FileName );
+      }
 
-    if( numberOfComponents == 1 )
+    values.resize( count );
+    double *out = values.empty() ? 0 : &values[0];
+    if( type == "float" )
       {
-      PixelType label;
-      for( unsigned long i = 0; i < outputMesh->GetNumberOfPoints(); i++ )
-        {
-        inputFile >> label;
-        outputMesh->SetPointData( i, label );
-        }
-  //    itkExceptionMacro( "Only single label components are readable" );
+      ReadBigEndianValues<float>( p, count, out );
+      }
+    else if( type == "double" )
+      {
+      ReadBigEndianValues<double>( p, count, out );
+      }
+    else if( type == "int" )
+      {
+      ReadBigEndianValues<vxl_int_32>( p, count, out );
+      }
+    else if( type == "unsigned_int" )
+      {
+      ReadBigEndianValues<vxl_uint_32>( p, count, out );
+      }
+    else if( size == 8 )
+      {
+      ReadBigEndianValues<vxl_int_64>( p, count, out );
+      }
+    else if( type == "short" )
+      {
+      ReadBigEndianValues<short>( p, count, out );
+      }
+    else if( type == "unsigned_short" )
+      {
+      ReadBigEndianValues<unsigned short>( p, count, out );
+      }
+    else if( type == "char" )
+      {
+      ReadBigEndianValues<signed char>( p, count, out );
       }
     else
       {
-      this->m_MultiComponentScalars = MultiComponentScalarSetType::New(); 
-      this->m_MultiComponentScalars->Initialize();
-      
-      for( unsigned long i = 0; i < outputMesh->GetNumberOfPoints(); i++ )
-        {
-        MultiComponentScalarType scalar;
-        scalar.SetSize( numberOfComponents );
-        for( unsigned int d = 0; d < numberOfComponents; d++ )
-          {
-          inputFile >> scalar[d];
-          }
-        this->m_MultiComponentScalars->InsertElement( i, scalar );
-        }
+      ReadBigEndianValues<unsigned char>( p, count, out );
+      }
+    p += count * size;
+    return p;
+    }
+
+  // The ASCII block ends at the next line that starts with a keyword, i.e.
+  // with a letter that cannot start a number (nan and inf can).
+  const char *blockEnd = p;
+  while( blockEnd < end )
+    {
+    const char *q = blockEnd;
+    while( q < end && ( *q == ' ' || *q == '\t' ) )
+      {
+      ++q;
+      }
+    if( q < end && ( ( *q >= 'A' && *q <= 'Z' ) || ( *q >= 'a' && *q <= 'z' ) ) &&
+        *q != 'n' && *q != 'N' && *q != 'i' && *q != 'I' )
+      {
+      break;
       }
-    
+    blockEnd = TextNumberParser::SkipLine( blockEnd, end );
     }
 
-  inputFile.close();
+  if( !TextNumberParser::ParseReals( p, blockEnd, values ) )
+    {
+    itkExceptionMacro( "Invalid number in " << this->m_FileName );
+    }
+  if( values.size() < count )
+    {
+    itkExceptionMacro( "Expected " << count << " values but found "
+      << values.size() << " in " << this->m_FileName );
+    }
+  values.resize( count );
+  return blockEnd;
 }
 
 template<class TOutputMesh>
-void
+const char *
 LabeledPointSetFileReader<TOutputMesh>
-::ReadLinesFromVTKFile()
+::ReadPointsFromVTKFile( const char *p, const char *end, bool isBinary )
 {
   typename OutputMeshType::Pointer outputMesh = this->GetOutput();
 
-  std::ifstream inputFile( this->m_FileName.c_str() );
+  const char *lineEnd = TextNumberParser::SkipLine( p, end );
+  std::string line( p, lineEnd );
 
-  std::string line;
-  
-  bool isBinary = false;
+  itkDebugMacro( "POINTS line" << line );
 
-  //
-  // Find the labels associated with each pixel
-  //
-  while( !inputFile.eof() )
+  std::istringstream fields( line );
+  std::string keyword;
+  std::string type( "float" );
+  long numberOfPoints = -1;
+  fields >> keyword >> numberOfPoints >> type;
+
+  itkDebugMacro( "numberOfPoints = " << numberOfPoints );
+
+  if( numberOfPoints < 1 )
     {
-    std::getline( inputFile, line );
-    
-    if (line.find( "BINARY" ) != std::string::npos )
-      {
-      isBinary = true;
-      }
+    itkExceptionMacro( "numberOfPoints < 1"
+        << "       numberOfPoints = " << numberOfPoints );
+    }
+
+  // VTK points always have three coordinates.
+  std::vector<double> coordinates;
+  const char *dataEnd = this->ReadVTKValues( lineEnd, end, isBinary, type,
+    3 * numberOfPoints, coordinates );
 
-    if( line.find( "LINES" ) != std::string::npos )
+  outputMesh->GetPoints()->Reserve( numberOfPoints );
+
+  PointType point;
+  for( long i = 0; i < numberOfPoints; i++ )
+    {
+    for( unsigned int j = 0; j < Dimension; j++ )
       {
-      break;
+      point[j] = coordinates[3 * i + j];
       }
+    outputMesh->SetPoint( i, point );
+    }
+
+  return dataEnd;
+}
+
+template<class TOutputMesh>
+const char *
+LabeledPointSetFileReader<TOutputMesh>
+::ReadScalarsFromVTKFile( const char *p, const char *end, bool isBinary,
+  bool store )
+{
+  typename OutputMeshType::Pointer outputMesh = this->GetOutput();
+
+  // SCALARS name type [numberOfComponents]
+  const char *lineEnd = TextNumberParser::SkipLine( p, end );
+  std::istringstream fields( std::string( p, lineEnd ) );
+  std::string keyword;
+  std::string name;
+  std::string type;
+  unsigned int numberOfComponents = 1;
+  fields >> keyword >> name >> type;
+  if( !( fields >> numberOfComponents ) || numberOfComponents < 1 )
+    {
+    numberOfComponents = 1;
     }
 
-  if( inputFile.eof() )
+  // The LOOKUP_TABLE line is optional.
+  p = TextNumberParser::SkipSpace( lineEnd, end );
+  if( static_cast<unsigned long>( end - p ) > 12 &&
+      std::string( p, 12 ) == "LOOKUP_TABLE" )
     {
-    inputFile.close();
-    return;
+    p = TextNumberParser::SkipLine( p, end );
     }
+  else
+    {
+    p = lineEnd;
+    }
+
+  const unsigned long numberOfPoints = outputMesh->GetNumberOfPoints();
+  std::vector<double> values;
+  const char *dataEnd = this->ReadVTKValues( p, end, isBinary, type,
+    numberOfPoints * numberOfComponents, values );
 
-  std::string::size_type pos = line.rfind( " " );
+  if( !store )
+    {
+    return dataEnd;
+    }
 
-  std::string temp = std::string( line, 6, pos-1 );
-  unsigned int numberOfLines = std::atoi( temp.c_str() );
+  if( numberOfComponents == 1 )
+    {
+    for( unsigned long i = 0; i < numberOfPoints; i++ )
+      {
+      outputMesh->SetPointData( i, static_cast<PixelType>( values[i] ) );
+      }
+    }
+  else
+    {
+    this->m_MultiComponentScalars = MultiComponentScalarSetType::New(); 
+    this->m_MultiComponentScalars->Initialize();
+    this->m_MultiComponentScalars->Reserve( numberOfPoints );
 
-  temp = std::string(line, pos, line.length()-1 );
-  unsigned int numberOfValues = std::atoi( temp.c_str() );
+    for( unsigned long i = 0; i < numberOfPoints; i++ )
+      {
+      MultiComponentScalarType scalar;
+      scalar.SetSize( numberOfComponents );
+      for( unsigned int d = 0; d < numberOfComponents; d++ )
+        {
+        scalar[d] = static_cast<PixelType>( values[i * numberOfComponents + d] );
+        }
+      this->m_MultiComponentScalars->InsertElement( i, scalar );
+      }
+    } 
+
+  return dataEnd;
+}
+
+template<class TOutputMesh>
+const char *
+LabeledPointSetFileReader<TOutputMesh>
+::ReadLinesFromVTKFile( const char *p, const char *end, bool isBinary )
+{
+  // LINES numberOfLines numberOfValues
+  const char *lineEnd = TextNumberParser::SkipLine( p, end );
+  std::istringstream fields( std::string( p, lineEnd ) );
+  std::string keyword;
+  unsigned long numberOfLines = 0;
+  unsigned long numberOfValues = 0;
+  fields >> keyword >> numberOfLines >> numberOfValues;
+
+  std::vector<double> lineData;
+  const char *dataEnd = this->ReadVTKValues( lineEnd, end, isBinary, "int",
+    numberOfValues, lineData );
 
   this->m_Lines = LineSetType::New(); 
   this->m_Lines->Initialize();
-  
-  if (isBinary)
-    {
-    int p;
-    int * lineData = new int [ numberOfValues ];
-    inputFile.read( reinterpret_cast< char * >( lineData ), numberOfValues * sizeof(p) );
-    ByteSwapper<int>::SwapRangeFromSystemToBigEndian(lineData,numberOfValues); 
-    
-    unsigned long valueId = 0;
-    unsigned long lineId = 0;
-    while (valueId < numberOfValues)
+
+  unsigned long valueId = 0;
+  unsigned long lineId = 0;
+  while( valueId < numberOfValues && lineId < numberOfLines )
     {
-      int lineLength = lineData[valueId];
+    unsigned long lineLength = static_cast<unsigned long>( lineData[valueId] );
+    ++valueId;
+    if( valueId + lineLength > numberOfValues )
+      {
+      itkExceptionMacro( "Invalid LINES in " << this->m_FileName );
+      }
+
+    LineType polyLine;
+    polyLine.SetSize( lineLength );
+    for( unsigned long i = 0; i < lineLength; i++ )
+      {
+      polyLine[i] = static_cast<unsigned long>( lineData[valueId] );
       ++valueId;
-      
-      LineType polyLine;
-      polyLine.SetSize( lineLength );
-        
-      for (long i = 0; i < lineLength; i++)
-        {
-        polyLine[i] = lineData[valueId];
-        ++valueId;
-        }
-      this->m_Lines->InsertElement( lineId, polyLine );
-      ++lineId;
-    }  
-    
-    delete [] lineData;
-  }
-  else 
-  {
-    
-    
-    for( unsigned int i = 0; i < numberOfLines; i++ )
-      {
-      LineType line;
-      unsigned int numberOfPoints;
-      inputFile >> numberOfPoints;
-      line.SetSize( numberOfPoints );
-      for( unsigned int d = 0; d < numberOfPoints; d++ )
-        {
-        inputFile >> line[d];
-        }
-      this->m_Lines->InsertElement( i, line );
       }
+    this->m_Lines->InsertElement( lineId, polyLine );
+    ++lineId;
     }
 
-  inputFile.close();
+  return dataEnd;
 }
 
 template<class TOutputMesh>
@@ -610,6 +787,21 @@ LabeledPointSetFileReader<TOutputMesh>
     }  
 }
 
+template<class TOutputMesh>
+template<class TValue>
+void
+LabeledPointSetFileReader<TOutputMesh>
+::ReadBigEndianValues( const char *p, unsigned long count, double *values )
+{
+  for( unsigned long i = 0; i < count; i++, p += sizeof( TValue ) )
+    {
+    TValue value;
+    memcpy( &value, p, sizeof( TValue ) );
+    ByteSwapper<TValue>::SwapFromSystemToBigEndian( &value );
+    values[i] = static_cast<double>( value );
+    }
+}
+
 template<class TOutputMesh>
 void
 LabeledPointSetFileReader<TOutputMesh>
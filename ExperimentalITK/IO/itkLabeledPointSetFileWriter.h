@@ -23,12 +23,19 @@
 #include "itkImage.h"
 #include "itkVectorContainer.h"
 
+#include <ostream>
+#include <vector>
+
 namespace itk
 {
 /** \class LabeledPointSetFileWriter
  * \brief
  * Writes an itkMesh to a file in various txt file formats.
  *
+ * The format is given by the extension: .txt, .vtk (ASCII, or BINARY with
+ * UseBinaryFormatOn()), .lps (the compact binary format described in
+ * LabeledPointSetFileReader) or an image format.
+ *
  */
 template <class TInputMesh>
 class LabeledPointSetFileWriter : public Object
@@ -87,6 +94,12 @@ public:
   itkSetStringMacro( FileName );
   itkGetStringMacro( FileName );
 
+  /** Write .vtk files in the BINARY legacy VTK format instead of ASCII.
+   * Default is off. */
+  itkSetMacro( UseBinaryFormat, bool );
+  itkGetConstMacro( UseBinaryFormat, bool );
+  itkBooleanMacro( UseBinaryFormat );
+
   /** Specify other attributes */
   itkSetMacro( Lines, typename LineSetType::Pointer );
 
@@ -114,6 +127,7 @@ protected:
 
   std::string                         m_FileName;
   InputMeshPointer                    m_Input;
+  bool                                m_UseBinaryFormat;
 
   typename MultiComponentScalarSetType::Pointer   m_MultiComponentScalars;
   typename LineSetType::Pointer                   m_Lines;
@@ -134,6 +148,12 @@ private:
 
   void WritePointsToAvantsFile();
   void WritePointsToImageFile();
+  void WritePointsToBinaryFile();
+
+  /** Convert values to TValue and write them with the given byte order. */
+  template<class TValue, class TInputValue>
+  static void WriteValues( std::ostream &, const std::vector<TInputValue> &,
+    bool bigEndian );
 
 
   void WriteVTKFile();
@@ -20,8 +20,11 @@
 #include "itkLabeledPointSetFileWriter.h"
 
 #include "itkBoundingBox.h"
+#include "itkByteSwapper.h"
 #include "itkImageFileWriter.h"
 
+#include "vxl_config.h"
+
 #include <fstream>
 
 namespace itk
@@ -36,6 +39,7 @@ LabeledPointSetFileWriter<TInputMesh>
 {
   this->m_Input = NULL;
   this->m_FileName = "";
+  this->m_UseBinaryFormat = false;
   this->m_MultiComponentScalars = NULL;
   this->m_Lines = NULL;
 
@@ -143,6 +147,10 @@ LabeledPointSetFileWriter<TInputMesh>
     {
     this->WriteVTKFile();
     }
+  else if( extension == "lps" )
+    {
+    this->WritePointsToBinaryFile();
+    }
   else
     {
     try
@@ -174,11 +182,12 @@ LabeledPointSetFileWriter<TInputMesh>
   //
   // Write to output file
   //
-  std::ofstream outputFile( this->m_FileName.c_str() );
+  std::ofstream outputFile( this->m_FileName.c_str(),
+    std::ios::out | std::ios::binary );
 
   outputFile << "# vtk DataFile Version 2.0" << std::endl;
   outputFile << "File written by itkLabeledPointSetFileWriter" << std::endl;
-  outputFile << "ASCII" << std::endl;
+  outputFile << ( this->m_UseBinaryFormat ? "BINARY" : "ASCII" ) << std::endl;
   outputFile << "DATASET POLYDATA" << std::endl;
 
   // POINTS go first
@@ -190,6 +199,26 @@ LabeledPointSetFileWriter<TInputMesh>
     = this->m_Input->GetPoints()->Begin();
   typename InputMeshType::PointsContainerIterator pointEnd
     = this->m_Input->GetPoints()->End();
+
+  if( this->m_UseBinaryFormat )
+    {
+    std::vector<float> coordinates;
+    coordinates.reserve( 3 * numberOfPoints );
+    while( pointIterator != pointEnd )
+      {
+      PointType point = pointIterator.Value();
+      for( unsigned int d = 0; d < 3; d++ )
+        {
+        coordinates.push_back( d < Dimension ? point[d] : 0.0 );
+        }
+      pointIterator++;
+      }
+    WriteValues<float>( outputFile, coordinates, true );
+    outputFile << std::endl;
+    outputFile.close();
+    return;
+    }
+
   while( pointIterator != pointEnd )
     {
     PointType point = pointIterator.Value();
@@ -215,7 +244,8 @@ LabeledPointSetFileWriter<TInputMesh>
   //
   // Write to output file
   //
-  std::ofstream outputFile( this->m_FileName.c_str(), std::ios::app );
+  std::ofstream outputFile( this->m_FileName.c_str(),
+    std::ios::app | std::ios::binary );
 
   // No point data conditions
   if (!this->m_Input->GetPointData()) return;
@@ -239,10 +269,24 @@ LabeledPointSetFileWriter<TInputMesh>
     typename InputMeshType::PointDataContainerIterator pointDataEnd
       = this->m_Input->GetPointData()->End();
 
-    while( pointDataIterator != pointDataEnd )
+    if( this->m_UseBinaryFormat )
       {
-      outputFile << pointDataIterator.Value() << " ";
-      pointDataIterator++;
+      std::vector<float> labels;
+      labels.reserve( numberOfPoints );
+      while( pointDataIterator != pointDataEnd )
+        {
+        labels.push_back( static_cast<float>( pointDataIterator.Value() ) );
+        pointDataIterator++;
+        }
+      WriteValues<float>( outputFile, labels, true );
+      }
+    else
+      {
+      while( pointDataIterator != pointDataEnd )
+        {
+        outputFile << pointDataIterator.Value() << " ";
+        pointDataIterator++;
+        }
       }
     outputFile << std::endl;
     }
@@ -253,7 +297,7 @@ LabeledPointSetFileWriter<TInputMesh>
     unsigned int numberOfComponents = scalar.GetSize();
 
     outputFile << "SCALARS scalars " << type
-      << numberOfComponents << std::endl;
+      << " " << numberOfComponents << std::endl;
     outputFile << "LOOKUP_TABLE default" << std::endl;
 
     typename MultiComponentScalarSetType::Iterator It
@@ -261,10 +305,27 @@ LabeledPointSetFileWriter<TInputMesh>
     typename MultiComponentScalarSetType::Iterator ItEnd
       = this->m_MultiComponentScalars->End();
 
-    while( It != ItEnd )
+    if( this->m_UseBinaryFormat )
       {
-      outputFile << It.Value() << " ";
-      It++;
+      std::vector<float> scalars;
+      scalars.reserve( numberOfPoints * numberOfComponents );
+      while( It != ItEnd )
+        {
+        for( unsigned int d = 0; d < numberOfComponents; d++ )
+          {
+          scalars.push_back( static_cast<float>( ( It.Value() )[d] ) );
+          }
+        It++;
+        }
+      WriteValues<float>( outputFile, scalars, true );
+      }
+    else
+      {
+      while( It != ItEnd )
+        {
+        outputFile << It.Value() << " ";
+        It++;
+        }
       }
     outputFile << std::endl;
     }
@@ -279,7 +340,8 @@ LabeledPointSetFileWriter<TInputMesh>
   if( this->m_Lines )
     {
 
-    std::ofstream outputFile( this->m_FileName.c_str(), std::ios::app );
+    std::ofstream outputFile( this->m_FileName.c_str(),
+      std::ios::app | std::ios::binary );
 
     unsigned int numberOfLines = this->m_Lines->Size();
     unsigned int totalSize = 0;
@@ -299,6 +361,22 @@ LabeledPointSetFileWriter<TInputMesh>
       numberOfLines << " " << totalSize << std::endl;
 
     It = this->m_Lines->Begin();
+    if( this->m_UseBinaryFormat )
+      {
+      std::vector<unsigned long> lineData;
+      lineData.reserve( totalSize );
+      while( It != ItEnd )
+        {
+        unsigned int numberOfPoints = ( It.Value() ).Size();
+        lineData.push_back( numberOfPoints );
+        for( unsigned int d = 0; d < numberOfPoints; d++ )
+          {
+          lineData.push_back( ( It.Value() )[d] );
+          }
+        ++It;
+        }
+      WriteValues<vxl_int_32>( outputFile, lineData, true );
+      }
     while( It != ItEnd )
       {
       unsigned int numberOfPoints = ( It.Value() ).Size();
@@ -409,6 +487,157 @@ LabeledPointSetFileWriter<TInputMesh>
   writer->Update();
 }
 
+template<class TInputMesh>
+void
+LabeledPointSetFileWriter<TInputMesh>
+::WritePointsToBinaryFile()
+{
+  std::ofstream outputFile( this->m_FileName.c_str(),
+    std::ios::out | std::ios::binary );
+
+  const unsigned long numberOfPoints = this->m_Input->GetNumberOfPoints();
+  const unsigned int coordinateSize =
+    ( sizeof( typename InputMeshType::CoordRepType ) > 4 ) ? 8 : 4;
+
+  unsigned int numberOfComponents = 0;
+  if( this->m_MultiComponentScalars &&
+      this->m_MultiComponentScalars->Size() == numberOfPoints &&
+      numberOfPoints > 0 )
+    {
+    numberOfComponents = this->m_MultiComponentScalars->GetElement( 0 ).GetSize();
+    }
+
+  unsigned long numberOfLines = 0;
+  unsigned long numberOfLineValues = 0;
+  if( this->m_Lines )
+    {
+    numberOfLines = this->m_Lines->Size();
+    typename LineSetType::Iterator It = this->m_Lines->Begin();
+    while( It != this->m_Lines->End() )
+      {
+      numberOfLineValues += ( It.Value() ).Size();
+      ++It;
+      }
+    }
+
+  std::vector<unsigned long> header32( 3 );
+  header32[0] = Dimension;
+  header32[1] = coordinateSize;
+  header32[2] = numberOfComponents;
+  std::vector<unsigned long> header64( 3 );
+  header64[0] = numberOfPoints;
+  header64[1] = numberOfLines;
+  header64[2] = numberOfLineValues;
+
+  outputFile.write( "ITKLPS01", 8 );
+  WriteValues<vxl_uint_32>( outputFile, header32, false );
+  WriteValues<vxl_uint_64>( outputFile, header64, false );
+
+  // Points
+  std::vector<double> coordinates;
+  coordinates.reserve( numberOfPoints * Dimension );
+  typename InputMeshType::PointsContainerIterator pointIterator
+    = this->m_Input->GetPoints()->Begin();
+  while( pointIterator != this->m_Input->GetPoints()->End() )
+    {
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      coordinates.push_back( ( pointIterator.Value() )[d] );
+      }
+    ++pointIterator;
+    }
+  if( coordinateSize == 8 )
+    {
+    WriteValues<double>( outputFile, coordinates, false );
+    }
+  else
+    {
+    WriteValues<float>( outputFile, coordinates, false );
+    }
+
+  // Labels (zero for the points without data) and scalars
+  std::vector<double> data( numberOfPoints * ( 1 + numberOfComponents ), 0.0 );
+  if( this->m_Input->GetPointData() &&
+      this->m_Input->GetPointData()->Size() == numberOfPoints )
+    {
+    unsigned long i = 0;
+    typename InputMeshType::PointDataContainerIterator pointDataIterator
+      = this->m_Input->GetPointData()->Begin();
+    while( pointDataIterator != this->m_Input->GetPointData()->End() )
+      {
+      data[i++] = pointDataIterator.Value();
+      ++pointDataIterator;
+      }
+    }
+  if( numberOfComponents > 0 )
+    {
+    unsigned long i = numberOfPoints;
+    typename MultiComponentScalarSetType::Iterator It
+      = this->m_MultiComponentScalars->Begin();
+    while( It != this->m_MultiComponentScalars->End() )
+      {
+      for( unsigned int d = 0; d < numberOfComponents; d++ )
+        {
+        data[i++] = d < ( It.Value() ).Size() ? ( It.Value() )[d] : 0.0;
+        }
+      ++It;
+      }
+    }
+  WriteValues<double>( outputFile, data, false );
+
+  // Lines
+  if( numberOfLines > 0 )
+    {
+    std::vector<unsigned long> lineData;
+    lineData.reserve( numberOfLines + numberOfLineValues );
+    typename LineSetType::Iterator It = this->m_Lines->Begin();
+    while( It != this->m_Lines->End() )
+      {
+      lineData.push_back( ( It.Value() ).Size() );
+      for( unsigned int d = 0; d < ( It.Value() ).Size(); d++ )
+        {
+        lineData.push_back( ( It.Value() )[d] );
+        }
+      ++It;
+      }
+    WriteValues<vxl_uint_64>( outputFile, lineData, false );
+    }
+
+  if( !outputFile )
+    {
+    itkExceptionMacro( "Error writing " << this->m_FileName );
+    }
+  outputFile.close();
+}
+
+template<class TInputMesh>
+template<class TValue, class TInputValue>
+void
+LabeledPointSetFileWriter<TInputMesh>
+::WriteValues( std::ostream &os, const std::vector<TInputValue> &values,
+  bool bigEndian )
+{
+  if( values.empty() )
+    {
+    return;
+    }
+  std::vector<TValue> buffer( values.size() );
+  for( unsigned long i = 0; i < values.size(); i++ )
+    {
+    buffer[i] = static_cast<TValue>( values[i] );
+    }
+  if( bigEndian )
+    {
+    ByteSwapper<TValue>::SwapRangeFromSystemToBigEndian( &buffer[0], buffer.size() );
+    }
+  else
+    {
+    ByteSwapper<TValue>::SwapRangeFromSystemToLittleEndian( &buffer[0], buffer.size() );
+    }
+  os.write( reinterpret_cast<const char *>( &buffer[0] ),
+    buffer.size() * sizeof( TValue ) );
+}
+
 template<class TInputMesh>
 void
 LabeledPointSetFileWriter<TInputMesh>
@@ -417,6 +646,7 @@ LabeledPointSetFileWriter<TInputMesh>
   Superclass::PrintSelf(os,indent);
 
   os << indent << "FileName: " << this->m_FileName << std::endl;
+  os << indent << "UseBinaryFormat: " << this->m_UseBinaryFormat << std::endl;
 }
 
 } //end of namespace itk
@@ -0,0 +1,141 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkMemoryMappedFile.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkMemoryMappedFile_h
+#define __itkMemoryMappedFile_h
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if !defined( _WIN32 )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+/** \class MemoryMappedFile
+ * \brief Read-only view of the whole contents of a file.
+ *
+ * The file is memory mapped where mmap is available and read into memory
+ * in one block otherwise (or when the mapping fails), so the parsers of
+ * the text and binary point-set formats can work on one contiguous range
+ * of characters instead of a stream.
+ */
+class MemoryMappedFile
+{
+public:
+  MemoryMappedFile()
+    : m_Data( 0 ), m_Size( 0 ), m_MappedAddress( 0 )
+    {
+    }
+
+  ~MemoryMappedFile()
+    {
+    this->Close();
+    }
+
+  /** Returns false if the file cannot be opened. */
+  bool Open( const std::string &fileName )
+    {
+    this->Close();
+
+#if !defined( _WIN32 )
+    int fd = open( fileName.c_str(), O_RDONLY );
+    if( fd < 0 )
+      {
+      return false;
+      }
+    struct stat status;
+    if( fstat( fd, &status ) == 0 && status.st_size > 0 )
+      {
+      void *address = mmap( NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if( address != MAP_FAILED )
+        {
+        madvise( address, status.st_size, MADV_SEQUENTIAL );
+        this->m_MappedAddress = address;
+        this->m_Size = status.st_size;
+        this->m_Data = static_cast<const char *>( address );
+        close( fd );
+        return true;
+        }
+      }
+    close( fd );
+#endif
+
+    std::ifstream file( fileName.c_str(), std::ios::in | std::ios::binary );
+    if( !file )
+      {
+      return false;
+      }
+    file.seekg( 0, std::ios::end );
+    this->m_Buffer.resize( static_cast<unsigned long>( file.tellg() ) );
+    file.seekg( 0, std::ios::beg );
+    if( !this->m_Buffer.empty() )
+      {
+      file.read( &this->m_Buffer[0], this->m_Buffer.size() );
+      }
+    this->m_Size = this->m_Buffer.size();
+    this->m_Data = this->m_Buffer.empty() ? 0 : &this->m_Buffer[0];
+    return true;
+    }
+
+  void Close()
+    {
+#if !defined( _WIN32 )
+    if( this->m_MappedAddress )
+      {
+      munmap( this->m_MappedAddress, this->m_Size );
+      }
+#endif
+    this->m_MappedAddress = 0;
+    this->m_Buffer.clear();
+    this->m_Data = 0;
+    this->m_Size = 0;
+    }
+
+  const char * GetData() const
+    {
+    return this->m_Data;
+    }
+
+  const char * GetEnd() const
+    {
+    return this->m_Data + this->m_Size;
+    }
+
+  unsigned long GetSize() const
+    {
+    return this->m_Size;
+    }
+
+private:
+  MemoryMappedFile( const MemoryMappedFile & ); //purposely not implemented
+  void operator=( const MemoryMappedFile & ); //purposely not implemented
+
+  const char                *m_Data;
+  unsigned long             m_Size;
+  void                      *m_MappedAddress;
+  std::vector<char>         m_Buffer;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,312 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkTextNumberParser.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTextNumberParser_h
+#define __itkTextNumberParser_h
+
+#include "itkMultiThreader.h"
+
+#include <locale>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class TextNumberParser
+ * \brief Locale independent parsing of whitespace separated numbers held
+ * in memory.
+ *
+ * ParseReal() handles the common decimal forms ([+-]digits[.digits][e[+-]
+ * digits] with at most 15 significant digits and a decimal exponent within
+ * +-22) exactly with one multiplication or division by a power of ten,
+ * which is correctly rounded.  Other tokens (longer mantissas such as the
+ * %.17g output of a double, larger exponents) are read by a stream imbued
+ * with the classic "C" locale, so the decimal point is always '.' whatever
+ * LC_NUMERIC is.  Only the tokens that stream rejects (nan, inf) are handed
+ * to strtod, and must still be consumed entirely.
+ *
+ * ParseReals() splits a range into chunks at whitespace and parses them in
+ * parallel: a first pass counts the tokens of each chunk so that the second
+ * pass can write each chunk to its place in the output.
+ */
+class TextNumberParser
+{
+public:
+  static bool IsSpace( char c )
+    {
+    return ( c == ' ' || c == '\n' || c == '\r' || c == '\t' ||
+             c == '\v' || c == '\f' );
+    }
+
+  static const char * SkipSpace( const char *p, const char *end )
+    {
+    while( p < end && IsSpace( *p ) )
+      {
+      ++p;
+      }
+    return p;
+    }
+
+  /** The start of the next line (or end). */
+  static const char * SkipLine( const char *p, const char *end )
+    {
+    const char *newLine = static_cast<const char *>( memchr( p, '\n', end - p ) );
+    return newLine ? newLine + 1 : end;
+    }
+
+  /** Parse the number starting at p (no leading whitespace).  Returns the
+   * character after the number or 0 if the token is not a number. */
+  static const char * ParseReal( const char *p, const char *end, double &value )
+    {
+    static const double powersOfTen[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char *start = p;
+    bool negative = false;
+    if( p < end && ( *p == '-' || *p == '+' ) )
+      {
+      negative = ( *p == '-' );
+      ++p;
+      }
+
+    double mantissa = 0.0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+
+    for( ; p < end && *p >= '0' && *p <= '9'; ++p )
+      {
+      hasDigits = true;
+      if( mantissa > 0.0 || *p != '0' )
+        {
+        mantissa = mantissa * 10.0 + ( *p - '0' );
+        significantDigits++;
+        }
+      }
+    if( p < end && *p == '.' )
+      {
+      for( ++p; p < end && *p >= '0' && *p <= '9'; ++p )
+        {
+        hasDigits = true;
+        if( mantissa > 0.0 || *p != '0' )
+          {
+          mantissa = mantissa * 10.0 + ( *p - '0' );
+          significantDigits++;
+          }
+        exponent--;
+        }
+      }
+    if( hasDigits && p < end && ( *p == 'e' || *p == 'E' ) )
+      {
+      const char *q = p + 1;
+      bool negativeExponent = false;
+      if( q < end && ( *q == '-' || *q == '+' ) )
+        {
+        negativeExponent = ( *q == '-' );
+        ++q;
+        }
+      if( q < end && *q >= '0' && *q <= '9' )
+        {
+        int explicitExponent = 0;
+        for( ; q < end && *q >= '0' && *q <= '9'; ++q )
+          {
+          if( explicitExponent < 10000 )
+            {
+            explicitExponent = explicitExponent * 10 + ( *q - '0' );
+            }
+          }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+        p = q;
+        }
+      }
+
+    if( hasDigits && ( p == end || IsSpace( *p ) ) &&
+        significantDigits <= 15 && exponent >= -22 && exponent <= 22 )
+      {
+      value = ( exponent < 0 ) ? mantissa / powersOfTen[-exponent]
+                               : mantissa * powersOfTen[exponent];
+      if( negative )
+        {
+        value = -value;
+        }
+      return p;
+      }
+
+    return ParseRealInClassicLocale( start, end, value );
+    }
+
+  /** Parse all the numbers of [begin, end) into values.  Returns false if
+   * a token is not a number. */
+  static bool ParseReals( const char *begin, const char *end,
+    std::vector<double> &values, unsigned int numberOfThreads = 0 )
+    {
+    // Chunks of less than 256 KB are not worth a thread.
+    const unsigned long minimumChunkSize = 1UL << 18;
+    unsigned long maximumNumberOfChunks =
+      static_cast<unsigned long>( end - begin ) / minimumChunkSize + 1;
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    if( numberOfThreads > 0 )
+      {
+      threader->SetNumberOfThreads( numberOfThreads );
+      }
+    if( static_cast<unsigned long>( threader->GetNumberOfThreads() ) > maximumNumberOfChunks )
+      {
+      threader->SetNumberOfThreads( maximumNumberOfChunks );
+      }
+    const unsigned int numberOfChunks = threader->GetNumberOfThreads();
+
+    ChunkStruct str;
+    str.Values = &values;
+    str.Counting = true;
+    str.Boundaries.resize( numberOfChunks + 1 );
+    str.Counts.assign( numberOfChunks, 0 );
+    str.Offsets.assign( numberOfChunks, 0 );
+    str.Failed.assign( numberOfChunks, false );
+
+    // Chunk boundaries are moved forward to whitespace so that no token
+    // is split.
+    str.Boundaries[0] = begin;
+    str.Boundaries[numberOfChunks] = end;
+    for( unsigned int n = 1; n < numberOfChunks; n++ )
+      {
+      const char *p = begin + ( ( end - begin ) / numberOfChunks ) * n;
+      if( p < str.Boundaries[n - 1] )
+        {
+        p = str.Boundaries[n - 1];
+        }
+      while( p < end && !IsSpace( *p ) )
+        {
+        ++p;
+        }
+      str.Boundaries[n] = p;
+      }
+
+    threader->SetSingleMethod( ChunkThreaderCallback, &str );
+    threader->SingleMethodExecute();
+
+    unsigned long numberOfValues = 0;
+    for( unsigned int n = 0; n < numberOfChunks; n++ )
+      {
+      str.Offsets[n] = numberOfValues;
+      numberOfValues += str.Counts[n];
+      }
+    values.resize( numberOfValues );
+
+    str.Counting = false;
+    threader->SingleMethodExecute();
+
+    for( unsigned int n = 0; n < numberOfChunks; n++ )
+      {
+      if( str.Failed[n] )
+        {
+        return false;
+        }
+      }
+    return true;
+    }
+
+private:
+  static const char * ParseRealInClassicLocale( const char *p,
+    const char *end, double &value )
+    {
+    const char *tokenEnd = p;
+    while( tokenEnd < end && !IsSpace( *tokenEnd ) )
+      {
+      ++tokenEnd;
+      }
+    if( tokenEnd == p )
+      {
+      return 0;
+      }
+    const std::string token( p, tokenEnd );
+
+    std::istringstream stream( token );
+    stream.imbue( std::locale::classic() );
+    stream >> value;
+    if( !stream.fail() && stream.eof() )
+      {
+      return tokenEnd;
+      }
+
+    char *strtodEnd = 0;
+    value = strtod( token.c_str(), &strtodEnd );
+    if( strtodEnd != token.c_str() + token.size() )
+      {
+      return 0;
+      }
+    return tokenEnd;
+    }
+
+  struct ChunkStruct
+    {
+    std::vector<const char *>   Boundaries;
+    std::vector<unsigned long>  Counts;
+    std::vector<unsigned long>  Offsets;
+    std::vector<char>           Failed;
+    std::vector<double>         *Values;
+    bool                        Counting;
+    };
+
+  static ITK_THREAD_RETURN_TYPE ChunkThreaderCallback( void *arg )
+    {
+    unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+
+    ChunkStruct *str = (ChunkStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+    const char *p = str->Boundaries[threadId];
+    const char *end = str->Boundaries[threadId + 1];
+
+    if( str->Counting )
+      {
+      unsigned long count = 0;
+      for( p = SkipSpace( p, end ); p < end; p = SkipSpace( p, end ) )
+        {
+        count++;
+        while( p < end && !IsSpace( *p ) )
+          {
+          ++p;
+          }
+        }
+      str->Counts[threadId] = count;
+      }
+    else
+      {
+      double *out = str->Values->empty() ? 0 : &( *str->Values )[0];
+      out += str->Offsets[threadId];
+      for( p = SkipSpace( p, end ); p < end; p = SkipSpace( p, end ) )
+        {
+        p = ParseReal( p, end, *out++ );
+        if( !p )
+          {
+          str->Failed[threadId] = true;
+          break;
+          }
+        }
+      }
+
+    return ITK_THREAD_RETURN_VALUE;
+    }
+};
+
+} // end namespace itk
+
+#endif
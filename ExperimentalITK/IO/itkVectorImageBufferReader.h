@@ -0,0 +1,176 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkVectorImageBufferReader.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkVectorImageBufferReader_h
+#define __itkVectorImageBufferReader_h
+
+#include "itkObject.h"
+
+#include "itkImageIOBase.h"
+#include "itkMultiThreader.h"
+#include "itkPixelTraits.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class VectorImageBufferReader
+ * \brief Reads the pixel buffer of an image of vectors either from one
+ * file with interleaved components or from one scalar file per component.
+ *
+ * This is the data reading part of DeformationFieldReader and
+ * VectorImageFileReader.  The caller sets the regions of the output image;
+ * Read() then fills its largest possible region.
+ *
+ * With one file, the components are read straight into the output buffer
+ * when the component type matches and converted otherwise.  If the file is
+ * an uncompressed MetaImage (.mha/.mhd) whose data have the byte order and
+ * component type of the output, the data file is memory mapped and the
+ * mapping is adopted as the output buffer, so no data are copied until
+ * they are accessed.  The mapping is private: writing to the output does
+ * not modify the file.
+ *
+ * With one file per component, the files are read in parallel (one thread
+ * per component) and each thread scatters its component into the output.
+ *
+ * \sa DeformationFieldReader
+ * \sa VectorImageFileReader
+ */
+template <class TVectorImage>
+class ITK_EXPORT VectorImageBufferReader : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef VectorImageBufferReader                          Self;
+  typedef Object                                           Superclass;
+  typedef SmartPointer<Self>                               Pointer;
+  typedef SmartPointer<const Self>                         ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( VectorImageBufferReader, Object );
+
+  typedef TVectorImage                                     VectorImageType;
+  typedef typename VectorImageType::PixelType              PixelType;
+  typedef typename PixelType::ValueType                    ValueType;
+  typedef typename VectorImageType::PixelContainer         PixelContainerType;
+  typedef std::vector<std::string>                         FileNamesType;
+
+  itkStaticConstMacro( VectorDimension, unsigned int,
+    GetVectorDimension<PixelType>::VectorDimension );
+
+  /** One file with interleaved components or one file per component. */
+  void SetFileNames( const FileNamesType &fileNames )
+    {
+    this->m_FileNames = fileNames;
+    this->Modified();
+    }
+  const FileNamesType & GetFileNames() const
+    {
+    return this->m_FileNames;
+    }
+
+  /** ImageIO used (as prototype) for all the files instead of the ImageIO
+   * factory. */
+  itkSetObjectMacro( ImageIO, ImageIOBase );
+  itkGetObjectMacro( ImageIO, ImageIOBase );
+
+  /** Set/Get whether uncompressed MetaImage files are memory mapped.
+   * Default is on. */
+  itkSetMacro( UseMemoryMapping, bool );
+  itkGetConstMacro( UseMemoryMapping, bool );
+  itkBooleanMacro( UseMemoryMapping );
+
+  itkSetClampMacro( NumberOfThreads, unsigned int, 1, ITK_MAX_THREADS );
+  itkGetConstMacro( NumberOfThreads, unsigned int );
+
+  /** Whether the last Read() adopted a memory mapping. */
+  itkGetConstMacro( IsMemoryMapped, bool );
+
+  /** Read the largest possible region of the output, allocating or
+   * adopting its buffer. */
+  void Read( VectorImageType *output );
+
+protected:
+  VectorImageBufferReader();
+  virtual ~VectorImageBufferReader() {}
+  void PrintSelf( std::ostream& os, Indent indent ) const;
+
+private:
+  VectorImageBufferReader( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  /** Multi-threading support. */
+  struct ThreadStruct
+    {
+    Self *Reader;
+    };
+
+  static ITK_THREAD_RETURN_TYPE ReadComponentsThreaderCallback( void * );
+
+  void ThreadedReadComponents( unsigned int, unsigned int );
+
+  /** Adopt a mapping of the file as the output buffer. */
+  bool MapFile( VectorImageType * );
+
+  /** Location of the data of an uncompressed MetaImage file with the byte
+   * order of this system.  A negative offset means that the data are at the
+   * end of the file. */
+  bool GetMetaImageDataLocation( const std::string &, std::string &, long & );
+
+  void SetIORegion( ImageIOBase * );
+
+  /** Copy one component of a buffer of any type into the output:
+   * component c of pixel p is buffer[p * stride + offset] */
+  void ScatterComponent( const void *, ImageIOBase::IOComponentType,
+    unsigned int, unsigned int, unsigned int );
+
+  template <class TComponent>
+  void ScatterTypedComponent( const TComponent *buffer, unsigned int stride,
+    unsigned int offset, unsigned int component )
+    {
+    PixelType *out = this->m_Output->GetBufferPointer();
+    const unsigned long numberOfPixels =
+      this->m_Output->GetBufferedRegion().GetNumberOfPixels();
+    for ( unsigned long p = 0; p < numberOfPixels; p++ )
+      {
+      out[p][component] = static_cast<ValueType>( buffer[p * stride + offset] );
+      }
+    }
+
+  FileNamesType                                 m_FileNames;
+  ImageIOBase::Pointer                          m_ImageIO;
+  bool                                          m_UseMemoryMapping;
+  unsigned int                                  m_NumberOfThreads;
+  bool                                          m_IsMemoryMapped;
+
+  /** State of the current read */
+  VectorImageType                               *m_Output;
+  std::vector<ImageIOBase::Pointer>             m_ImageIOs;
+  std::vector<std::string>                      m_ThreadErrors;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkVectorImageBufferReader.hxx"
+#endif
+
+#endif
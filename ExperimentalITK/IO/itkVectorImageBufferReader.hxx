@@ -0,0 +1,508 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkVectorImageBufferReader.hxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkVectorImageBufferReader_hxx
+#define __itkVectorImageBufferReader_hxx
+
+#include "itkVectorImageBufferReader.h"
+
+#include "itkByteSwapper.h"
+#include "itkImageIOFactory.h"
+#include "itkImportImageContainer.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+
+#if !defined( _WIN32 )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+/** \class MemoryMappedImportImageContainer
+ * \brief Pixel container whose memory is a file mapping, unmapped when the
+ * container is destroyed.
+ */
+template <class TElementIdentifier, class TElement>
+class MemoryMappedImportImageContainer
+: public ImportImageContainer<TElementIdentifier, TElement>
+{
+public:
+  typedef MemoryMappedImportImageContainer                 Self;
+  typedef ImportImageContainer<TElementIdentifier, TElement> Superclass;
+  typedef SmartPointer<Self>                               Pointer;
+  typedef SmartPointer<const Self>                         ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( MemoryMappedImportImageContainer, ImportImageContainer );
+
+  /** The mapping [address, address + length) containing the elements */
+  void SetMapping( void *address, unsigned long length )
+    {
+    this->m_MappedAddress = address;
+    this->m_MappedLength = length;
+    }
+
+protected:
+  MemoryMappedImportImageContainer()
+    {
+    this->m_MappedAddress = NULL;
+    this->m_MappedLength = 0;
+    }
+  virtual ~MemoryMappedImportImageContainer()
+    {
+#if !defined( _WIN32 )
+    if ( this->m_MappedAddress )
+      {
+      munmap( this->m_MappedAddress, this->m_MappedLength );
+      }
+#endif
+    }
+
+private:
+  MemoryMappedImportImageContainer( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  void                                          *m_MappedAddress;
+  unsigned long                                 m_MappedLength;
+};
+
+template <class TVectorImage>
+VectorImageBufferReader<TVectorImage>
+::VectorImageBufferReader()
+{
+  this->m_ImageIO = NULL;
+  this->m_UseMemoryMapping = true;
+  this->m_NumberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->m_IsMemoryMapped = false;
+  this->m_Output = NULL;
+}
+
+template <class TVectorImage>
+void
+VectorImageBufferReader<TVectorImage>
+::Read( VectorImageType *output )
+{
+  if ( this->m_FileNames.size() != 1 &&
+       this->m_FileNames.size() != VectorDimension )
+    {
+    itkExceptionMacro( "One file or one file per component ("
+      << VectorDimension << ") is required." );
+    }
+
+  this->m_Output = output;
+  this->m_IsMemoryMapped = false;
+
+  const unsigned long numberOfPixels =
+    output->GetLargestPossibleRegion().GetNumberOfPixels();
+
+  /**
+   * Create an ImageIO per file.  This is done here rather than in the
+   * threads since the object factory is not thread safe.
+   */
+  this->m_ImageIOs.clear();
+  for ( unsigned int n = 0; n < this->m_FileNames.size(); n++ )
+    {
+    ImageIOBase::Pointer io;
+    if ( this->m_ImageIO )
+      {
+      io = dynamic_cast<ImageIOBase *>(
+        this->m_ImageIO->CreateAnother().GetPointer() );
+      }
+    else
+      {
+      io = ImageIOFactory::CreateImageIO( this->m_FileNames[n].c_str(),
+        ImageIOFactory::ReadMode );
+      }
+    if ( !io )
+      {
+      itkExceptionMacro( "Could not create IO object for file "
+        << this->m_FileNames[n] );
+      }
+    io->SetFileName( this->m_FileNames[n].c_str() );
+    io->ReadImageInformation();
+    if ( io->GetImageSizeInPixels() != numberOfPixels )
+      {
+      itkExceptionMacro( "The size of " << this->m_FileNames[n]
+        << " differs from the size of the output." );
+      }
+    this->m_ImageIOs.push_back( io );
+    }
+
+  if ( this->m_FileNames.size() == 1 )
+    {
+    ImageIOBase *io = this->m_ImageIOs[0];
+    if ( io->GetNumberOfComponents() != VectorDimension )
+      {
+      itkExceptionMacro( this->m_FileNames[0] << " has "
+        << io->GetNumberOfComponents() << " components instead of "
+        << VectorDimension << "." );
+      }
+
+    output->SetBufferedRegion( output->GetLargestPossibleRegion() );
+    if ( this->m_UseMemoryMapping && this->MapFile( output ) )
+      {
+      this->m_IsMemoryMapped = true;
+      return;
+      }
+
+    // A new container, so that a previous mapping is not written to
+    output->SetPixelContainer( PixelContainerType::New() );
+    output->Allocate();
+
+    this->SetIORegion( io );
+    if ( io->GetComponentTypeInfo() == typeid( ValueType ) &&
+         sizeof( PixelType ) == VectorDimension * sizeof( ValueType ) )
+      {
+      io->Read( output->GetBufferPointer() );
+      }
+    else
+      {
+      std::vector<char> buffer( io->GetImageSizeInBytes() );
+      io->Read( &buffer[0] );
+      for ( unsigned int c = 0; c < VectorDimension; c++ )
+        {
+        this->ScatterComponent( &buffer[0], io->GetComponentType(),
+          VectorDimension, c, c );
+        }
+      }
+    }
+  else
+    {
+    output->SetBufferedRegion( output->GetLargestPossibleRegion() );
+    output->SetPixelContainer( PixelContainerType::New() );
+    output->Allocate();
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    threader->SetNumberOfThreads(
+      std::min<unsigned int>( this->m_NumberOfThreads, VectorDimension ) );
+    this->m_ThreadErrors.clear();
+    this->m_ThreadErrors.resize( threader->GetNumberOfThreads() );
+
+    ThreadStruct str;
+    str.Reader = this;
+    threader->SetSingleMethod( this->ReadComponentsThreaderCallback, &str );
+    threader->SingleMethodExecute();
+
+    for ( unsigned int n = 0; n < this->m_ThreadErrors.size(); n++ )
+      {
+      if ( !this->m_ThreadErrors[n].empty() )
+        {
+        itkExceptionMacro( << this->m_ThreadErrors[n] );
+        }
+      }
+    }
+  this->m_ImageIOs.clear();
+}
+
+template <class TVectorImage>
+ITK_THREAD_RETURN_TYPE
+VectorImageBufferReader<TVectorImage>
+::ReadComponentsThreaderCallback( void *arg )
+{
+  unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct *str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  str->Reader->ThreadedReadComponents( threadId, threadCount );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TVectorImage>
+void
+VectorImageBufferReader<TVectorImage>
+::ThreadedReadComponents( unsigned int threadId, unsigned int threadCount )
+{
+  /**
+   * Exceptions cannot cross the thread boundary, the messages are
+   * rethrown by Read().
+   */
+  try
+    {
+    for ( unsigned int c = threadId; c < VectorDimension; c += threadCount )
+      {
+      ImageIOBase *io = this->m_ImageIOs[c];
+      if ( io->GetNumberOfComponents() != 1 )
+        {
+        std::ostringstream msg;
+        msg << this->m_FileNames[c] << " is not a scalar image.";
+        this->m_ThreadErrors[threadId] = msg.str();
+        return;
+        }
+      this->SetIORegion( io );
+      std::vector<char> buffer( io->GetImageSizeInBytes() );
+      io->Read( &buffer[0] );
+      this->ScatterComponent( &buffer[0], io->GetComponentType(), 1, 0, c );
+      }
+    }
+  catch ( ExceptionObject &err )
+    {
+    this->m_ThreadErrors[threadId] = err.GetDescription();
+    }
+  catch ( ... )
+    {
+    this->m_ThreadErrors[threadId] = "Unknown error while reading components.";
+    }
+}
+
+template <class TVectorImage>
+void
+VectorImageBufferReader<TVectorImage>
+::SetIORegion( ImageIOBase *io )
+{
+  ImageIORegion ioRegion( io->GetNumberOfDimensions() );
+  for ( unsigned int d = 0; d < io->GetNumberOfDimensions(); d++ )
+    {
+    ioRegion.SetSize( d, io->GetDimensions( d ) );
+    ioRegion.SetIndex( d, 0 );
+    }
+  io->SetIORegion( ioRegion );
+}
+
+template <class TVectorImage>
+void
+VectorImageBufferReader<TVectorImage>
+::ScatterComponent( const void *buffer, ImageIOBase::IOComponentType type,
+  unsigned int stride, unsigned int offset, unsigned int component )
+{
+  switch ( type )
+    {
+    case ImageIOBase::UCHAR:
+      this->ScatterTypedComponent( static_cast<const unsigned char *>( buffer ),
+        stride, offset, component );
+      break;
+    case ImageIOBase::CHAR:
+      this->ScatterTypedComponent( static_cast<const char *>( buffer ),
+        stride, offset, component );
+      break;
+    case ImageIOBase::USHORT:
+      this->ScatterTypedComponent( static_cast<const unsigned short *>( buffer ),
+        stride, offset, component );
+      break;
+    case ImageIOBase::SHORT:
+      this->ScatterTypedComponent( static_cast<const short *>( buffer ),
+        stride, offset, component );
+      break;
+    case ImageIOBase::UINT:
+      this->ScatterTypedComponent( static_cast<const unsigned int *>( buffer ),
+        stride, offset, component );
+      break;
+    case ImageIOBase::INT:
+      this->ScatterTypedComponent( static_cast<const int *>( buffer ),
+        stride, offset, component );
+      break;
+    case ImageIOBase::ULONG:
+      this->ScatterTypedComponent( static_cast<const unsigned long *>( buffer ),
+        stride, offset, component );
+      break;
+    case ImageIOBase::LONG:
+      this->ScatterTypedComponent( static_cast<const long *>( buffer ),
+        stride, offset, component );
+      break;
+    case ImageIOBase::FLOAT:
+      this->ScatterTypedComponent( static_cast<const float *>( buffer ),
+        stride, offset, component );
+      break;
+    case ImageIOBase::DOUBLE:
+      this->ScatterTypedComponent( static_cast<const double *>( buffer ),
+        stride, offset, component );
+      break;
+    default:
+      itkExceptionMacro( "Unsupported component type." );
+    }
+}
+
+template <class TVectorImage>
+bool
+VectorImageBufferReader<TVectorImage>
+::MapFile( VectorImageType *output )
+{
+#if defined( _WIN32 )
+  return false;
+#else
+  ImageIOBase *io = this->m_ImageIOs[0];
+  if ( strcmp( io->GetNameOfClass(), "MetaImageIO" ) != 0 ||
+       io->GetComponentTypeInfo() != typeid( ValueType ) ||
+       sizeof( PixelType ) != VectorDimension * sizeof( ValueType ) )
+    {
+    return false;
+    }
+
+  std::string dataFileName;
+  long offset;
+  if ( !this->GetMetaImageDataLocation( this->m_FileNames[0], dataFileName, offset ) )
+    {
+    return false;
+    }
+
+  const unsigned long numberOfPixels =
+    output->GetLargestPossibleRegion().GetNumberOfPixels();
+  const unsigned long bytes = numberOfPixels * sizeof( PixelType );
+
+  int fd = open( dataFileName.c_str(), O_RDONLY );
+  if ( fd < 0 )
+    {
+    return false;
+    }
+  struct stat status;
+  if ( fstat( fd, &status ) != 0 )
+    {
+    close( fd );
+    return false;
+    }
+  if ( offset < 0 )
+    {
+    offset = static_cast<long>( status.st_size ) - static_cast<long>( bytes );
+    }
+  if ( offset < 0 || offset % sizeof( ValueType ) != 0 ||
+       static_cast<unsigned long>( status.st_size ) < offset + bytes )
+    {
+    close( fd );
+    return false;
+    }
+
+  // The mapping must start on a page boundary
+  const long pageSize = sysconf( _SC_PAGESIZE );
+  const long base = offset - offset % pageSize;
+  const unsigned long length = bytes + ( offset - base );
+  void *address = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+    fd, base );
+  close( fd );
+  if ( address == MAP_FAILED )
+    {
+    return false;
+    }
+
+  typedef MemoryMappedImportImageContainer<
+    typename PixelContainerType::ElementIdentifier, PixelType> ContainerType;
+  typename ContainerType::Pointer container = ContainerType::New();
+  container->SetMapping( address, length );
+  container->SetImportPointer( reinterpret_cast<PixelType *>(
+    static_cast<char *>( address ) + ( offset - base ) ), numberOfPixels, false );
+  output->SetPixelContainer( container );
+
+  itkDebugMacro( "Mapped " << bytes << " bytes of " << dataFileName );
+  return true;
+#endif
+}
+
+template <class TVectorImage>
+bool
+VectorImageBufferReader<TVectorImage>
+::GetMetaImageDataLocation( const std::string &fileName,
+  std::string &dataFileName, long &offset )
+{
+  std::ifstream file( fileName.c_str(), std::ios::in | std::ios::binary );
+  if ( !file )
+    {
+    return false;
+    }
+
+  bool compressed = false;
+  bool msb = false;
+  offset = 0;
+
+  /**
+   * ElementDataFile is the last field of the header
+   */
+  std::string line;
+  while ( std::getline( file, line ) )
+    {
+    std::string::size_type pos = line.find( '=' );
+    if ( pos == std::string::npos )
+      {
+      continue;
+      }
+    std::string key = line.substr( 0, pos );
+    std::string value = line.substr( pos + 1 );
+    key.erase( key.find_last_not_of( " \t\r" ) + 1 );
+    key.erase( 0, key.find_first_not_of( " \t" ) );
+    value.erase( value.find_last_not_of( " \t\r" ) + 1 );
+    value.erase( 0, value.find_first_not_of( " \t" ) );
+
+    if ( key == "CompressedData" )
+      {
+      compressed = ( value == "True" || value == "true" );
+      }
+    else if ( key == "BinaryDataByteOrderMSB" || key == "ElementByteOrderMSB" )
+      {
+      msb = ( value == "True" || value == "true" );
+      }
+    else if ( key == "HeaderSize" )
+      {
+      offset = atol( value.c_str() );
+      }
+    else if ( key == "ElementDataFile" )
+      {
+      if ( compressed || msb != ByteSwapper<int>::SystemIsBigEndian() )
+        {
+        return false;
+        }
+      if ( value == "LOCAL" )
+        {
+        dataFileName = fileName;
+        offset = static_cast<long>( file.tellg() );
+        return ( offset > 0 );
+        }
+      if ( value.find( "LIST" ) == 0 || value.find( '%' ) != std::string::npos
+        || value.find( ' ' ) != std::string::npos )
+        {
+        return false;
+        }
+      dataFileName = value;
+      if ( !itksys::SystemTools::FileIsFullPath( value.c_str() ) )
+        {
+        std::string path = itksys::SystemTools::GetFilenamePath( fileName );
+        if ( !path.empty() )
+          {
+          dataFileName = path + "/" + value;
+          }
+        }
+      return true;
+      }
+    }
+  return false;
+}
+
+template <class TVectorImage>
+void
+VectorImageBufferReader<TVectorImage>
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  for ( unsigned int n = 0; n < this->m_FileNames.size(); n++ )
+    {
+    os << indent << "FileName[" << n << "]: " << this->m_FileNames[n] << std::endl;
+    }
+  os << indent << "UseMemoryMapping: " << this->m_UseMemoryMapping << std::endl;
+  os << indent << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
+  os << indent << "IsMemoryMapped: " << this->m_IsMemoryMapped << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -25,6 +25,9 @@
 #include "itkImageRegion.h"
 #include "itkDefaultConvertPixelTraits.h"
 
+#include <string>
+#include <vector>
+
 namespace itk
 {
 
@@ -77,8 +80,14 @@ public:
  * raw binary format) have no accepted suffix, so you will have to
  * manually create the ImageIO instance of the write type.
  *
+ * If FileName itself exists it is read as a single file with interleaved
+ * vector components (memory mapped when it is an uncompressed MetaImage);
+ * otherwise the per-component files derived from FileName are read in
+ * parallel.
+ *
  * \sa ImageSeriesReader
  * \sa ImageIOBase
+ * \sa VectorImageBufferReader
  *
  * \ingroup IOFilters
  *
@@ -118,6 +127,15 @@ public:
   itkGetConstReferenceMacro(UseAvantsNamingConvention,bool);
   itkBooleanMacro(UseAvantsNamingConvention);
 
+  /** Set/Get whether an interleaved, uncompressed MetaImage file is memory
+   * mapped instead of read.  Default is on. */
+  itkSetMacro(UseMemoryMapping,bool);
+  itkGetConstReferenceMacro(UseMemoryMapping,bool);
+  itkBooleanMacro(UseMemoryMapping);
+
+  /** Whether FileName is a single file with interleaved components. */
+  itkGetConstReferenceMacro(IsInterleaved,bool);
+
   /** Set/Get the ImageIO helper class. Often this is created via the object
    * factory mechanism that determines whether a particular ImageIO can
    * read a certain file. This method provides a way to get the ImageIO
@@ -169,8 +187,13 @@ private:
   void operator=(const Self&); //purposely not implemented
   std::string m_ExceptionMessage;
 
+  /** Names of the files holding the vector components. */
+  void GetComponentFileNames( std::vector<std::string> & ) const;
+
   typename TImage::Pointer m_Image;
   bool     m_UseAvantsNamingConvention;
+  bool     m_UseMemoryMapping;
+  bool     m_IsInterleaved;
 
 };
 
@@ -26,6 +26,7 @@
 #include "itkPixelTraits.h"
 #include "itkVectorImage.h"
 #include "itkImageRegionIterator.h"
+#include "itkVectorImageBufferReader.h"
 
 #include <itksys/SystemTools.hxx>
 #include <fstream>
@@ -41,6 +42,8 @@ VectorImageFileReader<TImage, TVectorImage, ConvertPixelTraits>
   m_FileName = "";
   m_UserSpecifiedImageIO = false;
   m_UseAvantsNamingConvention = true;
+  m_UseMemoryMapping = true;
+  m_IsInterleaved = false;
 
   this->m_Image = TImage::New();
 }
@@ -69,6 +72,8 @@ void VectorImageFileReader<TImage, TVectorImage, ConvertPixelTraits>
 
   os << indent << "UserSpecifiedImageIO flag: " << m_UserSpecifiedImageIO << "\n";
   os << indent << "m_FileName: " << m_FileName << "\n";
+  os << indent << "UseMemoryMapping: " << m_UseMemoryMapping << "\n";
+  os << indent << "IsInterleaved: " << m_IsInterleaved << "\n";
 }
 
 
@@ -113,10 +118,19 @@ VectorImageFileReader<TImage, TVectorImage, ConvertPixelTraits>
   // We catch the exception because some ImageIO's may not actually
   // open a file. Still reports file error if no ImageIO is loaded.
 
+  // A single file with interleaved components takes precedence over the
+  // per-component files.
+  this->m_IsInterleaved =
+    itksys::SystemTools::FileExists( m_FileName.c_str() ) &&
+    !itksys::SystemTools::FileIsDirectory( m_FileName.c_str() );
+
   try
     {
     m_ExceptionMessage = "";
-    this->TestFileExistanceAndReadability();
+    if ( !this->m_IsInterleaved )
+      {
+      this->TestFileExistanceAndReadability();
+      }
     }
   catch(itk::ExceptionObject &err)
     {
@@ -174,6 +188,10 @@ VectorImageFileReader<TImage, TVectorImage, ConvertPixelTraits>
       {
       this->m_FileName += std::string( ".gz" );
       }
+    if ( this->m_IsInterleaved )
+      {
+      this->m_FileName = tmpFileName;
+      }
 
     if ( i == 0 )
       {
@@ -414,19 +432,16 @@ VectorImageFileReader<TImage, TVectorImage, ConvertPixelTraits>
 {
   typename TVectorImage::Pointer out = dynamic_cast<TVectorImage*>(output);
 
-  // the ImageIO object cannot stream, then set the RequestedRegion to the
-  // LargestPossibleRegion
-  if (!m_ImageIO->CanStreamRead())
+  // The components are always read (or mapped) as a whole, so set the
+  // RequestedRegion to the LargestPossibleRegion
+  if (out)
     {
-    if (out)
-      {
-      out->SetRequestedRegion( out->GetLargestPossibleRegion() );
-      }
-    else
-      {
-      throw VectorImageFileReaderException(__FILE__, __LINE__,
-                                     "Invalid output object type");
-      }
+    out->SetRequestedRegion( out->GetLargestPossibleRegion() );
+    }
+  else
+    {
+    throw VectorImageFileReaderException(__FILE__, __LINE__,
+                                   "Invalid output object type");
     }
 }
 
@@ -437,27 +452,43 @@ void VectorImageFileReader<TImage, TVectorImage, ConvertPixelTraits>
 {
   typename TVectorImage::Pointer output = this->GetOutput();
 
-  // allocate the output buffer
-  output->SetBufferedRegion( output->GetRequestedRegion() );
-  output->Allocate();
-
-  this->m_Image->SetBufferedRegion( output->GetRequestedRegion() );
-  this->m_Image->Allocate();
-
-  // Test if the file exist and if it can be open.
-  // and exception will be thrown otherwise.
-  try
+  std::vector<std::string> fileNames;
+  if ( this->m_IsInterleaved )
     {
-    m_ExceptionMessage = "";
-    this->TestFileExistanceAndReadability();
+    fileNames.push_back( this->m_FileName );
     }
-  catch(itk::ExceptionObject &err)
+  else
     {
-    m_ExceptionMessage = err.GetDescription();
+    // Test if the file exist and if it can be open.
+    // and exception will be thrown otherwise.
+    try
+      {
+      m_ExceptionMessage = "";
+      this->TestFileExistanceAndReadability();
+      }
+    catch(itk::ExceptionObject &err)
+      {
+      m_ExceptionMessage = err.GetDescription();
+      }
+    this->GetComponentFileNames( fileNames );
     }
 
-  std::string tmpFileName = this->m_FileName;
+  // Read the components directly into the output buffer (or map the file).
+  typedef VectorImageBufferReader<TVectorImage> BufferReaderType;
+  typename BufferReaderType::Pointer bufferReader = BufferReaderType::New();
+  bufferReader->SetFileNames( fileNames );
+  bufferReader->SetUseMemoryMapping( this->m_UseMemoryMapping );
+  if ( m_UserSpecifiedImageIO )
+    {
+    bufferReader->SetImageIO( m_ImageIO );
+    }
+  bufferReader->Read( output );
+}
 
+template <class TImage, class TVectorImage, class ConvertPixelTraits>
+void VectorImageFileReader<TImage, TVectorImage, ConvertPixelTraits>
+::GetComponentFileNames( std::vector<std::string> &fileNames ) const
+{
   std::string::size_type pos = this->m_FileName.rfind( "." );
   std::string extension( this->m_FileName, pos, this->m_FileName.length()-1 );
   std::string filename = std::string( this->m_FileName, 0, pos );
@@ -466,33 +497,34 @@ void VectorImageFileReader<TImage, TVectorImage, ConvertPixelTraits>
   if ( extension == std::string( ".gz" ) )
     {
     gzExtension = extension;
-				std::string::size_type pos2 = filename.rfind( "." );
-				extension = std::string( filename, pos2, filename.length()-1 );
+    std::string::size_type pos2 = filename.rfind( "." );
+    extension = std::string( filename, pos2, filename.length()-1 );
     filename = std::string( this->m_FileName, 0, pos2 );
     }
 
   unsigned int dimension = itk::GetVectorDimension
      <VectorImagePixelType>::VectorDimension;
 
+  fileNames.clear();
   for ( unsigned int i = 0; i < dimension; i++ )
     {
-    this->m_FileName = filename;
+    std::string componentFileName = filename;
 
     if ( this->m_UseAvantsNamingConvention )
       {
       switch ( i )
         {
         case 0:
-          this->m_FileName += std::string( "xvec" );
+          componentFileName += std::string( "xvec" );
           break;
         case 1:
-          this->m_FileName += std::string( "yvec" );
+          componentFileName += std::string( "yvec" );
           break;
         case 2:
-          this->m_FileName += std::string( "zvec" );
+          componentFileName += std::string( "zvec" );
           break;
         default:
-          this->m_FileName += std::string( "you_are_screwed_vec" );
+          componentFileName += std::string( "you_are_screwed_vec" );
           break;
         }
       }
@@ -500,134 +532,11 @@ void VectorImageFileReader<TImage, TVectorImage, ConvertPixelTraits>
       {
       std::stringstream buf;
       buf << i;
-      this->m_FileName += ( std::string( "." )  + std::string( buf.str().c_str() ) );
-      }
-    this->m_FileName += extension;
-    if ( !gzExtension.empty() )
-      {
-      this->m_FileName += std::string( ".gz" );
-      }
-
-    itkDebugMacro( << "Reading image buffer from the file " << this->m_FileName );
-
-    // Tell the ImageIO to read the file
-    m_ImageIO->SetFileName(m_FileName.c_str());
-
-    this->m_FileName = tmpFileName;
-    ImageIORegion ioRegion(TImage::ImageDimension);
-
-    ImageIORegion::SizeType ioSize = ioRegion.GetSize();
-    ImageIORegion::IndexType ioStart = ioRegion.GetIndex();
-
-    typename TImage::SizeType dimSize;
-    for(unsigned int j=0; j<TImage::ImageDimension; j++)
-      {
-      if (j < m_ImageIO->GetNumberOfDimensions())
-        {
-        dimSize[j] = m_ImageIO->GetDimensions(j);
-        }
-      else
-        {
-        // Number of dimensions in the output is more than number of dimensions
-        // in the ImageIO object (the file).  Use default values for the size,
-        // spacing, and origin for the final (degenerate) dimensions.
-        dimSize[j] = 1;
-        }
-      }
-
-    for(unsigned int j = 0; j < dimSize.GetSizeDimension(); ++j)
-      {
-      ioSize[j] = dimSize[j];
-      }
-
-    typedef typename TImage::IndexType   IndexType;
-    IndexType start;
-    start.Fill(0);
-    for(unsigned int j = 0; j < start.GetIndexDimension(); ++j)
-      {
-      ioStart[j] = start[j];
-      }
-
-    ioRegion.SetSize(ioSize);
-    ioRegion.SetIndex(ioStart);
-
-    itkDebugMacro (<< "ioRegion: " << ioRegion);
-
-    m_ImageIO->SetIORegion(ioRegion);
-
-    char *loadBuffer = 0;
-    // the size of the buffer is computed based on the actual number of
-    // pixels to be read and the actual size of the pixels to be read
-    // (as opposed to the sizes of the output)
-    try
-      {
-      if ( m_ImageIO->GetComponentTypeInfo()
-           != typeid(typename ConvertPixelTraits::ComponentType)
-           || (m_ImageIO->GetNumberOfComponents()
-               != ConvertPixelTraits::GetNumberOfComponents()))
-        {
-        // the pixel types don't match so a type conversion needs to be
-        // performed
-        itkDebugMacro(<< "Buffer conversion required from: "
-                      << m_ImageIO->GetComponentTypeInfo().name()
-                      << " to: "
-                      << typeid(ITK_TYPENAME ConvertPixelTraits::ComponentType).name());
-
-        loadBuffer = new char[m_ImageIO->GetImageSizeInBytes()];
-        m_ImageIO->Read( static_cast< void *>(loadBuffer) );
-
-        // See note below as to why the buffered region is needed and
-        // not actualIOregion
-        this->DoConvertBuffer(static_cast< void *>(loadBuffer),
-          output->GetBufferedRegion().GetNumberOfPixels() );
-        }
-      else // a type conversion is not necessary
-        {
-        itkDebugMacro(<< "No buffer conversion required.");
-
-        ImagePixelType *buffer =
-          this->m_Image->GetPixelContainer()->GetBufferPointer();
-        m_ImageIO->Read( buffer );
-        }
-      }
-    catch (...)
-      {
-      // if an exception is thrown catch it
-
-      if (loadBuffer)
-        {
-        // clean up
-        delete [] loadBuffer;
-        loadBuffer = 0;
-        }
-
-      // then rethrow
-      throw;
-      }
-
-    // clean up
-    if (loadBuffer)
-      {
-      delete [] loadBuffer;
-      loadBuffer = 0;
-      }
-
-
-    ImageRegionIterator<TVectorImage> Id( this->GetOutput(),
-      this->GetOutput()->GetLargestPossibleRegion() );
-    ImageRegionIterator<TImage> It( this->m_Image,
-      this->m_Image->GetLargestPossibleRegion() );
-
-    Id.GoToBegin();
-    It.GoToBegin();
-    while ( !Id.IsAtEnd() || !It.IsAtEnd() )
-      {
-      VectorImagePixelType V = Id.Get();
-      V[i] = static_cast< typename VectorImagePixelType::ValueType>( It.Get() );
-      Id.Set( V );
-      ++Id;
-      ++It;
+      componentFileName += ( std::string( "." )  + std::string( buf.str().c_str() ) );
       }
+    componentFileName += extension;
+    componentFileName += gzExtension;
+    fileNames.push_back( componentFileName );
     }
 }
 
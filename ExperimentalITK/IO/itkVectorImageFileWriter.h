@@ -53,6 +53,9 @@ public:
 /** \class VectorImageFileWriter
  * \brief Writes the deformation field as component images files.
  *
+ * With SplitComponentsOff() the image is written to FileName as a single
+ * file with interleaved components instead (see VectorImageFileReader).
+ *
  * \sa VectorImageFileWriter
  * \sa ImageSeriesReader
  * \sa ImageIOBase
@@ -150,6 +153,12 @@ public:
   itkGetConstReferenceMacro(UseZhangNamingConvention,bool);
   itkBooleanMacro(UseZhangNamingConvention);
 
+  /** Write one file per component (default) or a single file with
+   *  interleaved components. */
+  itkSetMacro(SplitComponents,bool);
+  itkGetConstReferenceMacro(SplitComponents,bool);
+  itkBooleanMacro(SplitComponents);
+
   /** By default the MetaDataDictionary is taken from the input image and 
    *  passed to the ImageIO. In some cases, however, a user may prefer to 
    *  introduce her/his own MetaDataDictionary. This is often the case of
@@ -173,10 +182,14 @@ private:
   VectorImageFileWriter(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
 
+  /** Writes the whole image to m_FileName with interleaved components. */
+  void WriteInterleaved();
+
   std::string        m_FileName;
   std::string        m_ComponentImageFileName;
   bool               m_UseAvantsNamingConvention;
   bool               m_UseZhangNamingConvention;
+  bool               m_SplitComponents;
   
   ImagePointer m_Image;
   
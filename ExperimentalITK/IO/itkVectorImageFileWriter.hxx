@@ -43,6 +43,7 @@ VectorImageFileWriter<TVectorImage, TImage>
   m_FactorySpecifiedImageIO = false;
   m_UseAvantsNamingConvention = true;
   m_UseZhangNamingConvention = false;
+  m_SplitComponents = true;
 }
 
 
@@ -147,6 +148,12 @@ void
 VectorImageFileWriter<TVectorImage, TImage>
 ::Write()
 {
+  if ( !this->m_SplitComponents )
+    {
+    this->WriteInterleaved();
+    return;
+    }
+
   typedef VectorIndexSelectionCastImageFilter
        <VectorImageType, ImageType> SelectorType;
   typename SelectorType::Pointer selector = SelectorType::New();
@@ -372,6 +379,98 @@ VectorImageFileWriter<TVectorImage, TImage>
 }
 
 
+//---------------------------------------------------------
+template <class TVectorImage, class TImage>
+void 
+VectorImageFileWriter<TVectorImage, TImage>
+::WriteInterleaved()
+{
+  const VectorImageType *input = this->GetInput();
+
+  if ( input == 0 )
+    {
+    itkExceptionMacro(<< "No input to writer!");
+    }
+  if ( m_FileName == "" )
+    {
+    itkExceptionMacro(<<"No filename was specified");
+    }
+
+  if ( m_ImageIO.IsNull() ||
+    ( m_FactorySpecifiedImageIO && !m_ImageIO->CanWriteFile( m_FileName.c_str() ) ) )
+    {
+    m_ImageIO = ImageIOFactory::CreateImageIO( m_FileName.c_str(), 
+                                               ImageIOFactory::WriteMode );
+    m_FactorySpecifiedImageIO = true;
+    }
+  if ( m_ImageIO.IsNull() )
+    {
+    ImageFileWriterException e(__FILE__, __LINE__);
+    OStringStream msg;
+    msg << " Could not create IO object for file "
+        << m_FileName.c_str() << std::endl;
+    e.SetDescription(msg.str().c_str());
+    e.SetLocation(ITK_LOCATION);
+    throw e;
+    }
+
+  // NOTE: this const_cast<> is due to the lack of const-correctness
+  // of the ProcessObject.
+  VectorImageType *nonConstImage = const_cast<VectorImageType *>( input );
+  if( nonConstImage->GetSource() )
+    {
+    nonConstImage->GetSource()->UpdateLargestPossibleRegion();
+    }
+
+  // The whole field is written; a user specified IORegion only applies to
+  // the component files.
+  typedef typename TVectorImage::RegionType RegionType;
+  RegionType region = input->GetLargestPossibleRegion();
+  const typename TVectorImage::SpacingType& spacing = input->GetSpacing();
+  const typename TVectorImage::PointType& origin = input->GetOrigin();
+  const typename TVectorImage::DirectionType& direction = input->GetDirection();
+
+  ImageIORegion ioRegion(TVectorImage::ImageDimension);
+  m_ImageIO->SetNumberOfDimensions(TVectorImage::ImageDimension);
+  for(unsigned int i=0; i<TVectorImage::ImageDimension; i++)
+    {
+    ioRegion.SetSize(i,region.GetSize(i));
+    ioRegion.SetIndex(i,region.GetIndex(i));
+    m_ImageIO->SetDimensions(i,region.GetSize(i));
+    m_ImageIO->SetSpacing(i,spacing[i]);
+    m_ImageIO->SetOrigin(i,origin[i]);
+    vnl_vector< double > axisDirection(TVectorImage::ImageDimension);
+    for(unsigned int j=0; j<TVectorImage::ImageDimension; j++)
+      {
+      axisDirection[j] = direction[j][i];
+      }
+    m_ImageIO->SetDirection( i, axisDirection );
+    }
+
+  typedef typename VectorImagePixelType::ValueType ComponentType;
+  m_ImageIO->SetPixelTypeInfo( typeid(ComponentType) );
+  m_ImageIO->SetNumberOfComponents( itk::GetVectorDimension
+    <VectorImagePixelType>::VectorDimension );
+  m_ImageIO->SetPixelType( ImageIOBase::VECTOR );
+
+  m_ImageIO->SetFileName( m_FileName.c_str() );
+  m_ImageIO->SetUseCompression(m_UseCompression);
+  m_ImageIO->SetIORegion(ioRegion);
+  if( m_UseInputMetaDataDictionary )
+    {
+    m_ImageIO->SetMetaDataDictionary(input->GetMetaDataDictionary());
+    }
+
+  this->InvokeEvent( StartEvent() );
+  m_ImageIO->Write( (const void*) input->GetBufferPointer() );
+  this->InvokeEvent( EndEvent() );
+
+  if ( input->ShouldIReleaseData() )
+    {
+    nonConstImage->ReleaseData();
+    }
+}
+
 //---------------------------------------------------------
 template <class TVectorImage, class TImage>
 void 
@@ -398,6 +497,7 @@ VectorImageFileWriter<TVectorImage, TImage>
     }
 
   os << indent << "IO Region: " << m_IORegion << "\n";
+  os << indent << "SplitComponents: " << m_SplitComponents << "\n";
 
 
   if (m_UseCompression)
@@ -19,9 +19,13 @@
 #include "itkExceptionObject.h"
 #include "itkMetaDataObject.h"
 #include "itkByteSwapper.h"
+#include "itkMultiThreader.h"
+#include <algorithm>
 #include <iostream>
 #include <list>
 #include <string>
+#include <string.h>
+#include <vector>
 #include <math.h>
 #include <time.h>
 
@@ -38,25 +42,53 @@ namespace itk {
 class GenericCUBFileAdaptor
 {
 public:
+  GenericCUBFileAdaptor() : m_DataOffset(0) {}
+  virtual ~GenericCUBFileAdaptor() {}
+
   virtual unsigned char ReadByte() = 0;
   virtual void ReadData(void *data, unsigned long bytes) = 0;
   virtual void WriteData(const void *data, unsigned long bytes) = 0;
 
+  /** Whether ReadDataAt is supported */
+  virtual bool CanSeek() 
+    { return false; }
+
+  /** Read data at a position of the (uncompressed) file */
+  virtual void ReadDataAt(unsigned long, void *, unsigned long)
+    {
+    ExceptionObject exception;
+    exception.SetDescription("File does not support random access");
+    throw exception;
+    }
+
+  /** Flush the written data and close the file */
+  virtual void Close() {}
+
+  /** Position of the first data byte, after the header */
+  unsigned long GetDataOffset() const
+    { return m_DataOffset; }
+
   std::string ReadHeader()
     {
     // Read everything up to the \f symbol
     std::ostringstream oss;
     unsigned char byte = ReadByte();
+    m_DataOffset = 1;
     while(byte != '\f')
       {
       oss << byte;
       byte = ReadByte();
+      m_DataOffset++;
       }
 
     // Read the next byte
     unsigned char term = ReadByte();
+    m_DataOffset++;
     if(term == '\r')
+      {
       term = ReadByte();
+      m_DataOffset++;
+      }
 
     // Throw exception if term is not there
     if(term != '\n')
@@ -69,6 +101,9 @@ public:
     // Return the header string
     return oss.str();
     }
+
+private:
+  unsigned long m_DataOffset;
 };
 
 /**
@@ -207,7 +242,7 @@ public:
       throw exception;
       }
 
-    int bread = fread(data, 1, bytes, m_File);
+    unsigned long bread = fread(data, 1, bytes, m_File);
     if(bread != bytes)
       {
       std::ostringstream oss;
@@ -221,6 +256,22 @@ public:
       }
     }
 
+  bool CanSeek()
+    {
+    return true;
+    }
+
+  void ReadDataAt(unsigned long position, void *data, unsigned long bytes)
+    {
+    if(m_File == NULL || fseek(m_File, position, SEEK_SET) != 0)
+      {
+      ExceptionObject exception;
+      exception.SetDescription("File cannot be read");
+      throw exception;
+      }
+    this->ReadData(data, bytes);
+    }
+
   void WriteData(const void *data, unsigned long bytes)
     {
     if(m_File == NULL)
@@ -243,6 +294,517 @@ private:
   FILE *m_File;
 };
 
+/**
+ * A reader and writer for block compressed gzip files (BGZF, as used by
+ * the SAM/BAM format).  The data are split into blocks of at most 64KB
+ * that are compressed as separate gzip members, so that the file remains
+ * a valid gzip file.  Each member stores its compressed size in a 'BC'
+ * extra field, so the blocks can be located without inflating the file
+ * and compressed or decompressed independently: in parallel, and only
+ * those covering the requested bytes.
+ */
+class BlockCompressedCUBFileAdaptor : public GenericCUBFileAdaptor
+{
+public:
+  enum 
+    {
+    BlockDataSize = 0xff00,         // Uncompressed bytes per block
+    MaximumBlockSize = 0x10000,     // Compressed bytes per block
+    BlockHeaderSize = 18,
+    BlockFooterSize = 8,
+    BlocksPerThread = 16            // Blocks per thread in one batch
+    };
+
+  BlockCompressedCUBFileAdaptor(const char *file, const char *mode,
+    unsigned int numberOfThreads)
+    {
+    m_File = fopen(file, mode);
+    if(!m_File)
+      {
+      ExceptionObject exception;
+      exception.SetDescription("File cannot be accessed");
+      throw exception;
+      }
+    m_IsWriting = (mode[0] == 'w');
+    m_Threader = MultiThreader::New();
+    m_Threader->SetNumberOfThreads(numberOfThreads);
+    m_ThreadBuffers.resize(m_Threader->GetNumberOfThreads());
+    m_ThreadFailed.resize(m_Threader->GetNumberOfThreads());
+
+    m_Position = 0;
+    m_DataSize = 0;
+    m_ScanOffset = 0;
+    m_IsIndexComplete = false;
+    m_CachedBlock = -1;
+    }
+
+  ~BlockCompressedCUBFileAdaptor()
+    {
+    try
+      {
+      this->Close();
+      }
+    catch(...)
+      {
+      }
+    }
+
+  /** Check whether the file starts with a BGZF block */
+  static bool IsBlockCompressed(const char *file)
+    {
+    FILE *f = fopen(file, "rb");
+    if(!f)
+      return false;
+    unsigned char header[BlockHeaderSize];
+    size_t bread = fread(header, 1, BlockHeaderSize, f);
+    fclose(f);
+    return (bread == BlockHeaderSize && IsBlockHeader(header));
+    }
+
+  bool CanSeek()
+    {
+    return !m_IsWriting;
+    }
+
+  unsigned char ReadByte()
+    {
+    if(!this->IndexBlocks(m_Position))
+      {
+      std::ostringstream oss;
+      oss << "Error reading byte from file at position: " << m_Position;
+      ExceptionObject exception;
+      exception.SetDescription(oss.str().c_str());
+      throw exception;
+      }
+
+    // Inflate the block containing the position unless it is cached
+    long block = this->FindBlock(m_Position);
+    if(block != m_CachedBlock)
+      {
+      const BlockInfo &info = m_Blocks[block];
+      std::vector<unsigned char> compressed(info.Size);
+      m_Cache.resize(info.DataSize);
+      if(fseek(m_File, info.Offset, SEEK_SET) != 0
+        || fread(&compressed[0], 1, info.Size, m_File) != info.Size
+        || !InflateBlock(&compressed[0], info.Size, &m_Cache[0], info.DataSize))
+        {
+        ExceptionObject exception;
+        exception.SetDescription("Corrupted compressed block");
+        throw exception;
+        }
+      m_CachedBlock = block;
+      }
+    return m_Cache[m_Position++ - m_Blocks[block].DataOffset];
+    }
+
+  void ReadData(void *data, unsigned long bytes)
+    {
+    this->ReadDataAt(m_Position, data, bytes);
+    m_Position += bytes;
+    }
+
+  void ReadDataAt(unsigned long position, void *data, unsigned long bytes)
+    {
+    if(bytes == 0)
+      return;
+    if(m_IsWriting || !this->IndexBlocks(position + bytes - 1))
+      {
+      std::ostringstream oss;
+      oss << "File size does not match header: " 
+        << bytes << " bytes requested at position " << position
+        << " but only " << m_DataSize << " bytes available!";
+      ExceptionObject exception;
+      exception.SetDescription(oss.str().c_str());
+      throw exception;
+      }
+
+    // The compressed blocks are contiguous, read them in batches and 
+    // inflate the blocks of a batch in parallel
+    unsigned long first = this->FindBlock(position);
+    unsigned long last = this->FindBlock(position + bytes - 1) + 1;
+    unsigned long batchSize = BlocksPerThread * m_ThreadBuffers.size();
+
+    m_JobIsCompression = false;
+    m_JobData = static_cast<unsigned char *>(data);
+    m_JobPosition = position;
+    m_JobBytes = bytes;
+    for(unsigned long begin = first; begin < last; begin += batchSize)
+      {
+      unsigned long end = std::min<unsigned long>(begin + batchSize, last);
+      unsigned long offset = m_Blocks[begin].Offset;
+      unsigned long size = m_Blocks[end-1].Offset + m_Blocks[end-1].Size - offset;
+
+      m_Compressed.resize(size);
+      if(fseek(m_File, offset, SEEK_SET) != 0
+        || fread(&m_Compressed[0], 1, size, m_File) != size)
+        {
+        ExceptionObject exception;
+        exception.SetDescription("Could not read compressed blocks");
+        throw exception;
+        }
+
+      m_JobBegin = begin;
+      m_JobEnd = end;
+      this->RunThreads("Corrupted compressed block");
+      }
+    }
+
+  void WriteData(const void *data, unsigned long bytes)
+    {
+    if(!m_IsWriting || m_File == NULL)
+      {
+      ExceptionObject exception;
+      exception.SetDescription("File cannot be written");
+      throw exception;
+      }
+
+    // Complete the pending partial block first, then compress the full
+    // blocks directly from the caller's buffer
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    if(m_Pending.size())
+      {
+      unsigned long n = std::min<unsigned long>(bytes, BlockDataSize - m_Pending.size());
+      m_Pending.insert(m_Pending.end(), p, p + n);
+      p += n;
+      bytes -= n;
+      if(m_Pending.size() == BlockDataSize)
+        {
+        this->CompressAndWrite(&m_Pending[0], m_Pending.size());
+        m_Pending.clear();
+        }
+      }
+    unsigned long full = (bytes / BlockDataSize) * BlockDataSize;
+    if(full)
+      {
+      this->CompressAndWrite(p, full);
+      }
+    m_Pending.insert(m_Pending.end(), p + full, p + bytes);
+    }
+
+  /** Write the pending data and the empty end-of-file block. */
+  void Close()
+    {
+    if(m_File == NULL)
+      return;
+    if(m_IsWriting)
+      {
+      FILE *file = m_File;
+      try
+        {
+        if(m_Pending.size())
+          {
+          this->CompressAndWrite(&m_Pending[0], m_Pending.size());
+          m_Pending.clear();
+          }
+        unsigned char eof[MaximumBlockSize];
+        unsigned long size = DeflateBlock(NULL, 0, eof);
+        if(fwrite(eof, 1, size, file) != size)
+          {
+          ExceptionObject exception;
+          exception.SetDescription("Could not write all bytes to file");
+          throw exception;
+          }
+        }
+      catch(...)
+        {
+        m_File = NULL;
+        fclose(file);
+        throw;
+        }
+      }
+    fclose(m_File);
+    m_File = NULL;
+    }
+
+private:
+  struct BlockInfo
+    {
+    unsigned long Offset;         // Offset of the block in the file
+    unsigned long Size;           // Compressed size of the block
+    unsigned long DataOffset;     // Offset of its data in the stream
+    unsigned long DataSize;       // Uncompressed size of the block
+    };
+
+  /** Multi-threading support. */
+  struct ThreadStruct
+    {
+    BlockCompressedCUBFileAdaptor *Adaptor;
+    };
+
+  static bool IsBlockHeader(const unsigned char *h)
+    {
+    return (h[0] == 31 && h[1] == 139 && h[2] == 8 && (h[3] & 4)
+      && h[10] == 6 && h[11] == 0 && h[12] == 'B' && h[13] == 'C'
+      && h[14] == 2 && h[15] == 0);
+    }
+
+  static unsigned long GetLittleEndian(const unsigned char *p, unsigned int n)
+    {
+    unsigned long value = 0;
+    for(unsigned int i = 0; i < n; i++)
+      value |= static_cast<unsigned long>(p[i]) << (8 * i);
+    return value;
+    }
+
+  static void SetLittleEndian(unsigned char *p, unsigned long value, unsigned int n)
+    {
+    for(unsigned int i = 0; i < n; i++)
+      p[i] = static_cast<unsigned char>((value >> (8 * i)) & 0xff);
+    }
+
+  /** Inflate a complete block, checking its size and CRC */
+  static bool InflateBlock(const unsigned char *block, unsigned long size,
+    unsigned char *data, unsigned long dataSize)
+    {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if(inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+      return false;
+    zs.next_in = const_cast<Bytef *>(block + BlockHeaderSize);
+    zs.avail_in = size - BlockHeaderSize - BlockFooterSize;
+    zs.next_out = data;
+    zs.avail_out = dataSize;
+    int status = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+    if(status != Z_STREAM_END || zs.total_out != dataSize)
+      return false;
+    unsigned long crc = crc32(crc32(0L, Z_NULL, 0), data, dataSize);
+    return (crc == GetLittleEndian(block + size - BlockFooterSize, 4));
+    }
+
+  /** Compress at most BlockDataSize bytes into a complete block of at most
+   *  MaximumBlockSize bytes.  Returns the block size. */
+  static unsigned long DeflateBlock(const unsigned char *data, 
+    unsigned long dataSize, unsigned char *block)
+    {
+    int level = Z_DEFAULT_COMPRESSION;
+    unsigned long size = 0;
+    while(size == 0)
+      {
+      z_stream zs;
+      memset(&zs, 0, sizeof(zs));
+      if(deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8, 
+        Z_DEFAULT_STRATEGY) != Z_OK)
+        return 0;
+      zs.next_in = const_cast<Bytef *>(data);
+      zs.avail_in = dataSize;
+      zs.next_out = block + BlockHeaderSize;
+      zs.avail_out = MaximumBlockSize - BlockHeaderSize - BlockFooterSize;
+      int status = deflate(&zs, Z_FINISH);
+      deflateEnd(&zs);
+      if(status == Z_STREAM_END)
+        size = zs.total_out + BlockHeaderSize + BlockFooterSize;
+      else if(level != Z_NO_COMPRESSION)
+        level = Z_NO_COMPRESSION;   // Incompressible data, store it
+      else
+        return 0;
+      }
+
+    static const unsigned char header[BlockHeaderSize - 2] = 
+      { 31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0 };
+    memcpy(block, header, BlockHeaderSize - 2);
+    SetLittleEndian(block + 16, size - 1, 2);
+    unsigned long crc = crc32(crc32(0L, Z_NULL, 0), data, dataSize);
+    SetLittleEndian(block + size - BlockFooterSize, crc, 4);
+    SetLittleEndian(block + size - 4, dataSize, 4);
+    return size;
+    }
+
+  /** Index the blocks up to the one containing the given position.  Only
+   *  the block headers and footers are read.  Returns false if the file
+   *  ends before the position. */
+  bool IndexBlocks(unsigned long position)
+    {
+    while(position >= m_DataSize && !m_IsIndexComplete)
+      {
+      unsigned char header[BlockHeaderSize], footer[4];
+      if(fseek(m_File, m_ScanOffset, SEEK_SET) != 0
+        || fread(header, 1, BlockHeaderSize, m_File) != BlockHeaderSize)
+        {
+        m_IsIndexComplete = true;
+        break;
+        }
+      if(!IsBlockHeader(header))
+        {
+        ExceptionObject exception;
+        exception.SetDescription("Invalid compressed block header");
+        throw exception;
+        }
+
+      BlockInfo info;
+      info.Offset = m_ScanOffset;
+      info.Size = GetLittleEndian(header + 16, 2) + 1;
+      info.DataOffset = m_DataSize;
+      if(fseek(m_File, info.Offset + info.Size - 4, SEEK_SET) != 0
+        || fread(footer, 1, 4, m_File) != 4)
+        {
+        ExceptionObject exception;
+        exception.SetDescription("Truncated compressed block");
+        throw exception;
+        }
+      info.DataSize = GetLittleEndian(footer, 4);
+
+      if(info.DataSize > 0)
+        m_Blocks.push_back(info);
+      m_ScanOffset += info.Size;
+      m_DataSize += info.DataSize;
+      }
+    return (position < m_DataSize);
+    }
+
+  /** Index of the block containing an indexed position */
+  long FindBlock(unsigned long position) const
+    {
+    long lo = 0, hi = static_cast<long>(m_Blocks.size()) - 1;
+    while(lo < hi)
+      {
+      long mid = (lo + hi + 1) / 2;
+      if(m_Blocks[mid].DataOffset <= position)
+        lo = mid;
+      else
+        hi = mid - 1;
+      }
+    return lo;
+    }
+
+  /** Compress the data in batches of blocks in parallel and write them */
+  void CompressAndWrite(const unsigned char *data, unsigned long bytes)
+    {
+    unsigned long numberOfBlocks = (bytes + BlockDataSize - 1) / BlockDataSize;
+    unsigned long batchSize = BlocksPerThread * m_ThreadBuffers.size();
+
+    m_JobIsCompression = true;
+    m_CompressedSizes.resize(batchSize);
+    m_Compressed.resize(batchSize * MaximumBlockSize);
+    for(unsigned long begin = 0; begin < numberOfBlocks; begin += batchSize)
+      {
+      m_JobBegin = begin;
+      m_JobEnd = std::min<unsigned long>(begin + batchSize, numberOfBlocks);
+      m_JobData = const_cast<unsigned char *>(data);
+      m_JobBytes = bytes;
+      this->RunThreads("Could not compress block");
+
+      for(unsigned long i = 0; i < m_JobEnd - m_JobBegin; i++)
+        {
+        if(fwrite(&m_Compressed[i * MaximumBlockSize], 1, 
+          m_CompressedSizes[i], m_File) != m_CompressedSizes[i])
+          {
+          ExceptionObject exception;
+          exception.SetDescription("Could not write all bytes to file");
+          throw exception;
+          }
+        }
+      }
+    }
+
+  void RunThreads(const char *error)
+    {
+    std::fill(m_ThreadFailed.begin(), m_ThreadFailed.end(), 0);
+
+    ThreadStruct str;
+    str.Adaptor = this;
+    m_Threader->SetSingleMethod(ThreaderCallback, &str);
+    m_Threader->SingleMethodExecute();
+
+    for(unsigned int n = 0; n < m_ThreadFailed.size(); n++)
+      {
+      if(m_ThreadFailed[n])
+        {
+        ExceptionObject exception;
+        exception.SetDescription(error);
+        throw exception;
+        }
+      }
+    }
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback(void *arg)
+    {
+    unsigned int threadId = ((MultiThreader::ThreadInfoStruct *)(arg))->ThreadID;
+    unsigned int threadCount = ((MultiThreader::ThreadInfoStruct *)(arg))->NumberOfThreads;
+
+    ThreadStruct *str = (ThreadStruct *)(((MultiThreader::ThreadInfoStruct *)(arg))->UserData);
+
+    str->Adaptor->ThreadedProcessBlocks(threadId, threadCount);
+
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+  /** Compress or inflate the blocks threadId, threadId + threadCount, ...
+   *  of the current batch */
+  void ThreadedProcessBlocks(unsigned int threadId, unsigned int threadCount)
+    {
+    for(unsigned long b = m_JobBegin + threadId; b < m_JobEnd; b += threadCount)
+      {
+      if(m_JobIsCompression)
+        {
+        unsigned long offset = b * BlockDataSize;
+        unsigned long size = std::min<unsigned long>(
+          BlockDataSize, m_JobBytes - offset);
+        unsigned long i = b - m_JobBegin;
+        m_CompressedSizes[i] = DeflateBlock(m_JobData + offset, size,
+          &m_Compressed[i * MaximumBlockSize]);
+        if(m_CompressedSizes[i] == 0)
+          m_ThreadFailed[threadId] = 1;
+        }
+      else
+        {
+        const BlockInfo &info = m_Blocks[b];
+        const unsigned char *block = 
+          &m_Compressed[info.Offset - m_Blocks[m_JobBegin].Offset];
+
+        // Blocks entirely inside the requested range are inflated in 
+        // place, the others in a scratch buffer
+        unsigned long first = std::max<unsigned long>(m_JobPosition, info.DataOffset);
+        unsigned long last = std::min<unsigned long>(m_JobPosition + m_JobBytes,
+          info.DataOffset + info.DataSize);
+        unsigned char *output = m_JobData + (first - m_JobPosition);
+        if(first != info.DataOffset || last - first != info.DataSize)
+          {
+          m_ThreadBuffers[threadId].resize(info.DataSize);
+          output = &m_ThreadBuffers[threadId][0];
+          }
+        if(!InflateBlock(block, info.Size, output, info.DataSize))
+          {
+          m_ThreadFailed[threadId] = 1;
+          }
+        else if(output != m_JobData + (first - m_JobPosition))
+          {
+          memcpy(m_JobData + (first - m_JobPosition), 
+            output + (first - info.DataOffset), last - first);
+          }
+        }
+      }
+    }
+
+  FILE *m_File;
+  bool m_IsWriting;
+  MultiThreader::Pointer m_Threader;
+
+  // Block index (reading)
+  std::vector<BlockInfo> m_Blocks;
+  unsigned long m_Position;
+  unsigned long m_DataSize;
+  unsigned long m_ScanOffset;
+  bool m_IsIndexComplete;
+  long m_CachedBlock;
+  std::vector<unsigned char> m_Cache;
+
+  // Partial block not yet compressed (writing)
+  std::vector<unsigned char> m_Pending;
+
+  // Current batch
+  bool m_JobIsCompression;
+  unsigned long m_JobBegin;
+  unsigned long m_JobEnd;
+  unsigned char *m_JobData;
+  unsigned long m_JobPosition;
+  unsigned long m_JobBytes;
+  std::vector<unsigned char> m_Compressed;
+  std::vector<unsigned long> m_CompressedSizes;
+  std::vector<std::vector<unsigned char> > m_ThreadBuffers;
+  std::vector<int> m_ThreadFailed;
+};
+
 
 /**
  * A swap helper class, used to perform swapping for any input
@@ -292,6 +854,8 @@ VoxBoCUBImageIO::VoxBoCUBImageIO()
   m_ByteOrder = BigEndian;
   m_Reader = NULL;
   m_Writer = NULL;
+  m_UseBlockCompression = true;
+  m_NumberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
 }
 
 
@@ -311,7 +875,9 @@ VoxBoCUBImageIO::CreateReader(const char *filename)
     {
     bool compressed;
     if(CheckExtension(filename, compressed))
-      if(compressed)
+      if(compressed && BlockCompressedCUBFileAdaptor::IsBlockCompressed(filename))
+        return new BlockCompressedCUBFileAdaptor(filename, "rb", m_NumberOfThreads);
+      else if(compressed)
           return new CompressedCUBFileAdaptor(filename, "rb");
       else
         return new DirectCUBFileAdaptor(filename, "rb");
@@ -331,7 +897,9 @@ VoxBoCUBImageIO::CreateWriter(const char *filename)
     {
     bool compressed;
     if(CheckExtension(filename, compressed))
-      if(compressed)
+      if(compressed && m_UseBlockCompression)
+        return new BlockCompressedCUBFileAdaptor(filename, "wb", m_NumberOfThreads);
+      else if(compressed)
           return new CompressedCUBFileAdaptor(filename, "wb");
       else
         return new DirectCUBFileAdaptor(filename, "wb");
@@ -398,8 +966,61 @@ void VoxBoCUBImageIO::Read(void* buffer)
     throw exception;
     }
 
-  m_Reader->ReadData(buffer, GetImageSizeInBytes());
-  this->SwapBytesIfNecessary(buffer, GetImageSizeInBytes());
+  if(!m_Reader->CanSeek())
+    {
+    m_Reader->ReadData(buffer, GetImageSizeInBytes());
+    this->SwapBytesIfNecessary(buffer, GetImageSizeInBytes());
+    return;
+    }
+
+  // Read the IO region.  Full slices are contiguous in the file, otherwise
+  // the rows spanned by the region are read slice by slice.
+  unsigned long start[3], size[3], dims[3];
+  for(unsigned int d = 0; d < 3; d++)
+    {
+    start[d] = 0;
+    size[d] = 1;
+    if(d < m_IORegion.GetImageDimension())
+      {
+      start[d] = m_IORegion.GetIndex()[d];
+      size[d] = m_IORegion.GetSize()[d];
+      }
+    dims[d] = m_Dimensions[d];
+    }
+
+  const unsigned long pixelSize = 
+    this->GetComponentSize() * this->GetNumberOfComponents();
+  const unsigned long sliceBytes = dims[0] * dims[1] * pixelSize;
+  const unsigned long lineBytes = dims[0] * pixelSize;
+  const unsigned long regionBytes = size[0] * size[1] * size[2] * pixelSize;
+  char *out = static_cast<char *>(buffer);
+
+  if(size[0] == dims[0] && size[1] == dims[1])
+    {
+    m_Reader->ReadDataAt(m_Reader->GetDataOffset() + start[2] * sliceBytes,
+      out, regionBytes);
+    }
+  else
+    {
+    std::vector<char> rows(size[1] * lineBytes);
+    for(unsigned long z = start[2]; z < start[2] + size[2]; z++)
+      {
+      m_Reader->ReadDataAt(m_Reader->GetDataOffset() + z * sliceBytes 
+        + start[1] * lineBytes, &rows[0], rows.size());
+      for(unsigned long y = 0; y < size[1]; y++)
+        {
+        memcpy(out, &rows[y * lineBytes + start[0] * pixelSize], 
+          size[0] * pixelSize);
+        out += size[0] * pixelSize;
+        }
+      }
+    }
+  this->SwapBytesIfNecessary(buffer, regionBytes);
+}
+
+bool VoxBoCUBImageIO::CanStreamRead()
+{
+  return (m_Reader != NULL && m_Reader->CanSeek());
 }
 
 /** 
@@ -657,6 +1278,7 @@ VoxBoCUBImageIO
   m_Writer = CreateWriter(m_FileName.c_str());
   WriteImageInformation();
   m_Writer->WriteData(buffer, GetImageSizeInBytes());
+  m_Writer->Close();
 delete m_Writer;
 m_Writer=NULL;
 }
@@ -666,6 +1288,8 @@ void VoxBoCUBImageIO::PrintSelf(std::ostream& os, Indent indent) const
 {
   Superclass::PrintSelf(os, indent);
   os << indent << "PixelType " << m_PixelType << "\n";
+  os << indent << "UseBlockCompression " << m_UseBlockCompression << "\n";
+  os << indent << "NumberOfThreads " << m_NumberOfThreads << "\n";
 }
 
 
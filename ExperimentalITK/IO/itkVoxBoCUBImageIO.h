@@ -36,6 +36,14 @@ namespace itk
  *
  *  \brief Read VoxBoCUBImage file format. 
  *
+ *  Compressed (.cub.gz) files are written by default as block compressed
+ *  gzip (BGZF): a series of gzip members of at most 64KB of data each, which
+ *  gunzip and zlib read as a regular gzip file.  The blocks are compressed
+ *  in parallel when writing and decompressed in parallel when reading.
+ *  Uncompressed and block compressed files support streamed reading: only
+ *  the requested region is read (and inflated).  Plain gzip files are
+ *  still read sequentially.
+ *
  *  \ingroup IOFilters
  *
  */
@@ -65,6 +73,9 @@ public:
   /** Reads the data from disk into the memory buffer provided. */
   virtual void Read(void* buffer);
 
+  /** Uncompressed and block compressed files can be read by region. */
+  virtual bool CanStreamRead();
+
   /*-------- This part of the interfaces deals with writing data. ----- */
 
   /** Determine the file type. Returns true if this ImageIO can write the
@@ -78,6 +89,16 @@ public:
    * that the IORegions has been set properly. */
   virtual void Write(const void* buffer);
 
+  /** Set/Get whether .cub.gz files are written as block compressed gzip
+   * (default) or as a single gzip stream. */
+  itkSetMacro(UseBlockCompression, bool);
+  itkGetConstMacro(UseBlockCompression, bool);
+  itkBooleanMacro(UseBlockCompression);
+
+  /** Set/Get the number of threads used to compress and decompress the
+   * blocks. */
+  itkSetClampMacro(NumberOfThreads, unsigned int, 1, ITK_MAX_THREADS);
+  itkGetConstMacro(NumberOfThreads, unsigned int);
 
   VoxBoCUBImageIO();
   ~VoxBoCUBImageIO();
@@ -92,6 +113,9 @@ private:
   GenericCUBFileAdaptor *CreateWriter(const char *filename);
   GenericCUBFileAdaptor *m_Reader, *m_Writer;
 
+  bool m_UseBlockCompression;
+  unsigned int m_NumberOfThreads;
+
   // Initialize the orientation map (from strings to ITK)
   void InitializeOrientationMap();
 
@@ -99,8 +99,8 @@ private:
   BoxPlotQuantileListSampleFilter( const Self& ); //purposely not implemented
   void operator=( const Self& ); //purposely not implemented
 
-  InstanceIdentifierType FindMaximumNonOutlierDeviationValue( RealType, RealType );
-  bool IsMeasurementAnOutlier( RealType, RealType, RealType, unsigned long );
+  /** Quantile of the values by selection (reorders the values) */
+  static RealType SelectQuantile( std::vector<RealType> &, RealType );
 
   OutlierHandlingType                                 m_OutlierHandling;
   InstanceIdentifierContainerType                     m_OutlierInstanceIdentifiers;
@@ -19,8 +19,7 @@
 
 #include "itkBoxPlotQuantileListSampleFilter.h"
 
-#include "itkHistogram.h"
-#include "itkListSampleToHistogramFilter.h"
+#include <algorithm>
 
 namespace itk {
 namespace Statistics {
@@ -63,50 +62,34 @@ BoxPlotQuantileListSampleFilter<TScalarListSample>
   this->GetOutput()->SetMeasurementVectorSize( scalarMeasurementVectorSize );
 
   /**
-   * Initialize the histogram in preparation for the
+   * The quantiles are found by selection on a copy of the measurements.
    */
-
-  typedef Histogram<RealType, 1> HistogramType;
-  typename HistogramType::Pointer histogram = HistogramType::New();
-
-  typename HistogramType::MeasurementVectorType minimumValue;
-  minimumValue[0] = NumericTraits<RealType>::max();
-  typename HistogramType::MeasurementVectorType maximumValue;
-  maximumValue[0] = NumericTraits<RealType>::NonpositiveMin();
-  typename HistogramType::SizeType histogramSize;
-  histogramSize.Fill( 200 );
+  std::vector<RealType> measurements;
+  measurements.reserve( this->GetInput()->Size() );
 
   typename ScalarListSampleType::ConstIterator It = this->GetInput()->Begin();
   while( It != this->GetInput()->End() )
     {
-    MeasurementVectorType inputMeasurement = It.GetMeasurementVector();
-    if( inputMeasurement[0] < minimumValue[0] )
-      {
-      minimumValue[0] = inputMeasurement[0];
-      }
-    if( inputMeasurement[0] > maximumValue[0] )
-      {
-      maximumValue[0] = inputMeasurement[0];
-      }
+    measurements.push_back( It.GetMeasurementVector()[0] );
     ++It;
     }
-  histogram->Initialize( histogramSize, minimumValue, maximumValue );
-
-  typedef ListSampleToHistogramFilter<ScalarListSampleType, HistogramType>
-    SampleFilterType;
-  typename SampleFilterType::Pointer sampleFilter = SampleFilterType::New();
-  sampleFilter->SetHistogram( histogram );
-  sampleFilter->SetListSample( this->GetInput() );
-  sampleFilter->Update();
+  if( measurements.empty() )
+    {
+    return;
+    }
 
-  RealType lowerQuantile = histogram->Quantile( 0, this->m_LowerPercentile );
-  RealType upperQuantile = histogram->Quantile( 0, this->m_UpperPercentile );
+  std::vector<RealType> selection( measurements );
+  RealType lowerQuantile =
+    this->SelectQuantile( selection, this->m_LowerPercentile );
+  RealType upperQuantile =
+    this->SelectQuantile( selection, this->m_UpperPercentile );
 
   RealType upperBound = upperQuantile +
     this->m_WhiskerScalingFactor * ( upperQuantile - lowerQuantile );
   RealType lowerBound = lowerQuantile -
     this->m_WhiskerScalingFactor * ( upperQuantile - lowerQuantile );
 
+  this->m_OutlierInstanceIdentifiers.clear();
   It = this->GetInput()->Begin();
   while( It != this->GetInput()->End() )
     {
@@ -133,34 +116,22 @@ BoxPlotQuantileListSampleFilter<TScalarListSample>
 
   if( this->m_OutlierHandling == Winsorize )
     {
-    /** Retabulate the histogram with the outliers removed */
-    minimumValue[0] = NumericTraits<RealType>::max();
-    maximumValue[0] = NumericTraits<RealType>::NonpositiveMin();
-
-    typename ScalarListSampleType::Iterator ItO = this->GetOutput()->Begin();
-    while( ItO != this->GetOutput()->End() )
+    /** Recompute the quantiles with the outliers removed */
+    selection.clear();
+    for( unsigned long n = 0; n < measurements.size(); n++ )
       {
-      MeasurementVectorType outputMeasurement = ItO.GetMeasurementVector();
-      if( outputMeasurement[0] < minimumValue[0] )
-        {
-        minimumValue[0] = outputMeasurement[0];
-        }
-      if( outputMeasurement[0] > maximumValue[0] )
+      if( measurements[n] >= lowerBound && measurements[n] <= upperBound )
         {
-        maximumValue[0] = outputMeasurement[0];
+        selection.push_back( measurements[n] );
         }
-      ++ItO;
       }
-    typename HistogramType::Pointer histogram2 = HistogramType::New();
-    histogram2->Initialize( histogramSize, minimumValue, maximumValue );
-
-    typename SampleFilterType::Pointer sampleFilter2 = SampleFilterType::New();
-    sampleFilter2->SetHistogram( histogram2 );
-    sampleFilter2->SetListSample( this->GetOutput() );
-    sampleFilter2->Update();
-
-    RealType lowerQuantile2 = histogram2->Quantile( 0, this->m_LowerPercentile );
-    RealType upperQuantile2 = histogram2->Quantile( 0, this->m_UpperPercentile );
+    RealType lowerQuantile2 = lowerQuantile;
+    RealType upperQuantile2 = upperQuantile;
+    if( !selection.empty() )
+      {
+      lowerQuantile2 = this->SelectQuantile( selection, this->m_LowerPercentile );
+      upperQuantile2 = this->SelectQuantile( selection, this->m_UpperPercentile );
+      }
 
     RealType upperBound2 = upperQuantile2 +
       this->m_WhiskerScalingFactor * ( upperQuantile2 - lowerQuantile2 );
@@ -190,6 +161,27 @@ BoxPlotQuantileListSampleFilter<TScalarListSample>
     }
 }
 
+template<class TScalarListSample>
+typename BoxPlotQuantileListSampleFilter<TScalarListSample>::RealType
+BoxPlotQuantileListSampleFilter<TScalarListSample>
+::SelectQuantile( std::vector<RealType> &values, RealType percentile )
+{
+  // Linear interpolation between the order statistics around
+  // percentile * ( N - 1 )
+  const RealType position = percentile *
+    static_cast<RealType>( values.size() - 1 );
+  const unsigned long k = static_cast<unsigned long>( position );
+
+  std::nth_element( values.begin(), values.begin() + k, values.end() );
+  RealType quantile = values[k];
+  if( k + 1 < values.size() && position > static_cast<RealType>( k ) )
+    {
+    RealType next = *std::min_element( values.begin() + k + 1, values.end() );
+    quantile += ( position - static_cast<RealType>( k ) ) * ( next - quantile );
+    }
+  return quantile;
+}
+
 template<class TScalarListSample>
 void
 BoxPlotQuantileListSampleFilter<TScalarListSample>
@@ -96,7 +96,6 @@ private:
   GrubbsRosnerListSampleFilter( const Self& ); //purposely not implemented
   void operator=( const Self& ); //purposely not implemented
 
-  InstanceIdentifierType FindMaximumNonOutlierDeviationValue( RealType, RealType );
   bool IsMeasurementAnOutlier( RealType, RealType, RealType, unsigned long );
 
   OutlierHandlingType                                 m_OutlierHandling;
@@ -21,6 +21,9 @@
 
 #include "itkTDistribution.h"
 
+#include <algorithm>
+#include <utility>
+
 namespace itk {
 namespace Statistics {
 
@@ -82,8 +85,17 @@ GrubbsRosnerListSampleFilter<TScalarListSample>
     }
 
   /**
-   * Otherwise, iterate through the input list, removing t
+   * Otherwise, sort the measurements once.  The remaining measurement with
+   * the largest deviation from the mean is then at one end of the sorted
+   * range, and the mean and variance are updated as outliers are removed
+   * from the ends.
    */
+  typedef std::pair<RealType, unsigned long> SortedMeasurementType;
+
+  std::vector<SortedMeasurementType> sortedMeasurements;
+  InstanceIdentifierContainerType identifiers;
+  sortedMeasurements.reserve( this->GetInput()->Size() );
+  identifiers.reserve( this->GetInput()->Size() );
 
   RealType mean = 0.0;
   RealType variance = 0.0;
@@ -98,35 +110,59 @@ GrubbsRosnerListSampleFilter<TScalarListSample>
     variance += ( count - 1.0 ) *
       vnl_math_sqr( inputMeasurement[0] - mean ) / count;
     mean = mean + ( inputMeasurement[0] - mean ) / count;
+
+    sortedMeasurements.push_back(
+      SortedMeasurementType( inputMeasurement[0], identifiers.size() ) );
+    identifiers.push_back( It.GetInstanceIdentifier() );
     ++It;
     }
   variance /= ( count - 1.0 );
 
-  bool outlierFound = true;
+  std::sort( sortedMeasurements.begin(), sortedMeasurements.end() );
+
+  std::vector<bool> isOutlier( identifiers.size(), false );
+  unsigned long lower = 0;
+  unsigned long upper = sortedMeasurements.size() - 1;
+
   this->m_OutlierInstanceIdentifiers.clear();
-  while( outlierFound == true &&
-    ( this->GetInput()->Size() - this->m_OutlierInstanceIdentifiers.size() > 6 ) )
+  while( upper - lower + 1 > 6 )
     {
-    outlierFound = false;
-    InstanceIdentifierType id =
-      this->FindMaximumNonOutlierDeviationValue( mean, variance );
-    if( this->GetInput()->GetFrequency( id ) > 0 )
+    RealType lowerDeviation =
+      vnl_math_abs( sortedMeasurements[lower].first - mean );
+    RealType upperDeviation =
+      vnl_math_abs( sortedMeasurements[upper].first - mean );
+    if( lowerDeviation <= 0.0 && upperDeviation <= 0.0 )
       {
-      MeasurementVectorType measurement =
-        this->GetInput()->GetMeasurementVector( id );
-      outlierFound = this->IsMeasurementAnOutlier( measurement[0], mean, variance,
-        this->GetInput()->Size() - this->m_OutlierInstanceIdentifiers.size() );
-      if( outlierFound )
-        {
-        /** Retabulate the variance and mean by removing the previous estimate */
-        RealType count = this->GetInput()->Size() -
-          this->m_OutlierInstanceIdentifiers.size();
-        mean = ( mean * count - measurement[0] ) / ( count - 1.0 );
-        variance = ( count - 1.0 ) * variance - ( count - 1.0 ) *
-          vnl_math_sqr( measurement[0] - mean ) / count;
-        variance /= ( count - 2.0 );
-        this->m_OutlierInstanceIdentifiers.push_back( id );
-        }
+      break;
+      }
+    unsigned long candidate =
+      ( upperDeviation > lowerDeviation ) ? upper : lower;
+    RealType measurement = sortedMeasurements[candidate].first;
+
+    unsigned long numberOfRemainingMeasurements = upper - lower + 1;
+    if( !this->IsMeasurementAnOutlier( measurement, mean, variance,
+      numberOfRemainingMeasurements ) )
+      {
+      break;
+      }
+
+    /** Retabulate the variance and mean by removing the previous estimate */
+    RealType remaining = static_cast<RealType>( numberOfRemainingMeasurements );
+    mean = ( mean * remaining - measurement ) / ( remaining - 1.0 );
+    variance = ( remaining - 1.0 ) * variance - ( remaining - 1.0 ) *
+      vnl_math_sqr( measurement - mean ) / remaining;
+    variance /= ( remaining - 2.0 );
+
+    isOutlier[sortedMeasurements[candidate].second] = true;
+    this->m_OutlierInstanceIdentifiers.push_back(
+      identifiers[sortedMeasurements[candidate].second] );
+    if( candidate == upper )
+      {
+      upper--;
+      }
+    else
+      {
+      lower++;
       }
     }
 
@@ -144,6 +180,7 @@ GrubbsRosnerListSampleFilter<TScalarListSample>
     upperWinsorBound = mean + t * vcl_sqrt( variance );
     }
 
+  unsigned long n = 0;
   It = this->GetInput()->Begin();
   while( It != this->GetInput()->End() )
     {
@@ -151,10 +188,7 @@ GrubbsRosnerListSampleFilter<TScalarListSample>
     MeasurementVectorType outputMeasurement;
     outputMeasurement.SetSize( scalarMeasurementVectorSize );
 
-    if( this->m_OutlierHandling == None || std::find(
-      this->m_OutlierInstanceIdentifiers.begin(),
-      this->m_OutlierInstanceIdentifiers.end(), It.GetInstanceIdentifier() ) ==
-      this->m_OutlierInstanceIdentifiers.end() )
+    if( this->m_OutlierHandling == None || !isOutlier[n] )
       {
       outputMeasurement[0] = inputMeasurement[0];
       this->GetOutput()->PushBack( outputMeasurement );
@@ -172,40 +206,10 @@ GrubbsRosnerListSampleFilter<TScalarListSample>
       this->GetOutput()->PushBack( outputMeasurement );
       }
     ++It;
+    ++n;
     }
 }
 
-template<class TScalarListSample>
-typename GrubbsRosnerListSampleFilter<TScalarListSample>
-::InstanceIdentifierType
-GrubbsRosnerListSampleFilter<TScalarListSample>
-::FindMaximumNonOutlierDeviationValue( RealType mean, RealType variance )
-{
-  RealType maximumDeviation = 0.0;
-  InstanceIdentifierType maximumID =
-    NumericTraits<InstanceIdentifierType>::max();
-
-  typename ScalarListSampleType::ConstIterator It = this->GetInput()->Begin();
-  while( It != this->GetInput()->End() )
-    {
-    MeasurementVectorType inputMeasurement = It.GetMeasurementVector();
-    InstanceIdentifierType inputID = It.GetInstanceIdentifier();
-
-    if( std::find( this->m_OutlierInstanceIdentifiers.begin(),
-      this->m_OutlierInstanceIdentifiers.end(), inputID ) ==
-      this->m_OutlierInstanceIdentifiers.end() )
-      {
-      if( vnl_math_abs( inputMeasurement[0] - mean ) > maximumDeviation )
-        {
-        maximumDeviation = vnl_math_abs( inputMeasurement[0] - mean );
-        maximumID = inputID;
-        }
-      }
-    ++It;
-    }
-  return maximumID;
-}
-
 template<class TScalarListSample>
 bool
 GrubbsRosnerListSampleFilter<TScalarListSample>
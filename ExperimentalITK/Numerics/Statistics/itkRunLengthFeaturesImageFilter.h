@@ -0,0 +1,226 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkRunLengthFeaturesImageFilter_h
+#define __itkRunLengthFeaturesImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkVectorImage.h"
+
+#include <vector>
+
+namespace itk
+{
+namespace Statistics
+{
+/** \class RunLengthFeaturesImageFilter
+ *  \brief This filter computes at each pixel the grey level run-length
+ * features of a window centered on it.
+ *
+ * The runs of a window are the maximal lines of pixels, along each offset,
+ * falling in the same intensity bin within the window.  As in
+ * ScalarImageToRunLengthMatrixFilter, the length of a run is the physical
+ * distance from its first pixel to the one after it.  The ten output
+ * components are the features of HistogramToRunLengthFeaturesFilter, in the
+ * same order.  Pixels outside the mask (or [Min, Max]) do not belong to any
+ * run and get zero features.
+ *
+ * The features are all sums over the runs, so only the per-bin run counts
+ * and these sums are kept.  Each thread moves the window along the image
+ * lines: when the window moves by one pixel, only the runs meeting the
+ * pixels that leave or enter it change, and only those are removed and
+ * added again.
+ *
+ * \author
+ * \ingroup
+ */
+template<class TInputImage, class TOutputImage
+  = VectorImage<typename TInputImage::PixelType, TInputImage::ImageDimension> >
+class ITK_EXPORT RunLengthFeaturesImageFilter:
+  public ImageToImageFilter<TInputImage, TOutputImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef RunLengthFeaturesImageFilter                    Self;
+  typedef ImageToImageFilter<TInputImage, TOutputImage>   Superclass;
+  typedef SmartPointer<Self>                              Pointer;
+  typedef SmartPointer<const Self>                        ConstPointer;
+
+  /** Standard New method. */
+  itkNewMacro( Self );
+
+  /** Runtime information support. */
+  itkTypeMacro( RunLengthFeaturesImageFilter, ImageToImageFilter );
+
+  /** ImageDimension constants */
+  itkStaticConstMacro( ImageDimension, unsigned int, TInputImage::ImageDimension );
+
+  /** Some convenient typedefs. */
+  typedef double                                     RealType;
+  typedef TInputImage                                InputImageType;
+  typedef typename InputImageType::RegionType        RegionType;
+  typedef typename InputImageType::IndexType         IndexType;
+  typedef typename InputImageType::SizeType          RadiusType;
+  typedef typename InputImageType::OffsetType        OffsetType;
+  typedef std::vector<OffsetType>                    OffsetVectorType;
+  typedef typename OffsetType::OffsetValueType       OffsetValueType;
+  typedef Image<unsigned int, ImageDimension>        MaskImageType;
+  typedef TOutputImage                               OutputImageType;
+  typedef typename InputImageType::PixelType         InputPixelType;
+  typedef typename OutputImageType::PixelType        OutputPixelType;
+
+  /** Set/Get the input mask image. */
+  void SetMaskImage( const MaskImageType *mask );
+
+  const MaskImageType * GetMaskImage() const;
+
+  /** Radius defining the local window for evaluating the features. */
+  itkSetMacro( NeighborhoodRadius, RadiusType );
+  itkGetConstMacro( NeighborhoodRadius, RadiusType );
+
+  /** Set the offset or offsets along which the runs are computed.  Calling
+      either of these methods clears the previous offsets. */
+  itkGetConstReferenceMacro( Offsets, OffsetVectorType );
+  void SetOffsets( const OffsetVectorType &offsets )
+  {
+    if ( this->m_Offsets != offsets )
+      {
+      this->m_Offsets.assign( offsets.begin(), offsets.end() );
+      this->Modified();
+      }
+  }
+  void SetOffset( const OffsetType &offset );
+
+  /** Set number of bins along the intensity and the distance axes */
+  itkSetMacro( NumberOfBinsPerAxis, unsigned int );
+  itkGetConstMacro( NumberOfBinsPerAxis, unsigned int );
+
+  /** Set the min and max (inclusive) pixel value of the intensity bins. */
+  void SetPixelValueMinMax( InputPixelType, InputPixelType );
+
+  itkGetConstMacro( Min, InputPixelType );
+  itkGetConstMacro( Max, InputPixelType );
+
+  /**
+   * Set the min and max (inclusive) run length of the distance bins.  By
+   * default (max <= min) the range is 0 to the longest run that fits in
+   * the window.
+   */
+  void SetDistanceValueMinMax( RealType, RealType );
+
+  itkGetConstMacro( MinDistance, RealType );
+  itkGetConstMacro( MaxDistance, RealType );
+
+  itkSetMacro( InsidePixelValue, typename MaskImageType::PixelType );
+  itkGetConstMacro( InsidePixelValue, typename MaskImageType::PixelType );
+
+  unsigned int GetNumberOfOutputComponents() { return 10; }
+
+protected:
+  RunLengthFeaturesImageFilter();
+  ~RunLengthFeaturesImageFilter() {};
+
+  virtual void GenerateInputRequestedRegion()
+  {
+    // currently we require the entire input image to process
+    TInputImage *input = const_cast<TInputImage *>( this->GetInput() );
+    input->SetRequestedRegionToLargestPossibleRegion();
+  }
+
+  virtual void BeforeThreadedGenerateData();
+
+  virtual void ThreadedGenerateData( const RegionType &, ThreadIdType );
+
+  virtual void AfterThreadedGenerateData();
+
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  void GenerateOutputInformation();
+
+private:
+  RunLengthFeaturesImageFilter( const Self & );        //purposely not implemented
+  void operator=( const Self & );                      //purposely not implemented
+
+  typedef Image<int, ImageDimension>                 BinImageType;
+
+  /** Run counts per intensity and per distance bin, and running sums of
+   * the features over the runs of a window. */
+  struct RunLengthSums
+    {
+    std::vector<long>   GreyLevelCounts;
+    std::vector<long>   RunLengthCounts;
+    long                NumberOfRuns;
+    RealType            GreyLevelSquares;
+    RealType            RunLengthSquares;
+    RealType            Emphasis[8];
+    };
+
+  void InitializeSums( RunLengthSums & ) const;
+
+  void ComputeFeatures( const RunLengthSums &, OutputPixelType & ) const;
+
+  /** Update the sums from the runs of a window to those of another one. */
+  void UpdateWindow( RunLengthSums &, const RegionType &, const RegionType & ) const;
+
+  /** Update the sums of the n-th offset line starting at pixel, from its
+   * runs within [a, b] to its runs within [newA, newB]. */
+  void UpdateLine( RunLengthSums &, const int *pixel, unsigned int n,
+    OffsetValueType a, OffsetValueType b,
+    OffsetValueType newA, OffsetValueType newB ) const;
+
+  /** Add (sign 1) or remove (sign -1) the runs of a line within [a, b]. */
+  void AddRuns( RunLengthSums &, const int *pixel, unsigned int n,
+    OffsetValueType a, OffsetValueType b, int sign ) const;
+
+  void AddRun( RunLengthSums &, int bin, unsigned int n, OffsetValueType length,
+    int sign ) const;
+
+  /** Interval of k such that index + k offset lies in region. */
+  void GetLineInterval( const IndexType &, const OffsetType &, const RegionType &,
+    OffsetValueType &, OffsetValueType & ) const;
+
+  /** Integer division rounded down, for any signs. */
+  static OffsetValueType FloorDivide( OffsetValueType, OffsetValueType );
+
+  int ComputeBin( RealType, RealType, RealType ) const;
+
+  OffsetVectorType                                  m_Offsets;
+  RadiusType                                        m_NeighborhoodRadius;
+  InputPixelType                                    m_Min;
+  InputPixelType                                    m_Max;
+  RealType                                          m_MinDistance;
+  RealType                                          m_MaxDistance;
+  unsigned int                                      m_NumberOfBinsPerAxis;
+  typename MaskImageType::PixelType                 m_InsidePixelValue;
+
+  /** State of the current update: the intensity bin of each pixel (-1
+   * outside the mask or [Min, Max]), the offsets oriented forward in memory
+   * and the distance bin of each run length along them. */
+  typename BinImageType::Pointer                    m_BinImage;
+  std::vector<OffsetType>                           m_RunOffsets;
+  std::vector<OffsetValueType>                      m_RunBufferOffsets;
+  std::vector<std::vector<int> >                    m_RunLengthBins;
+
+}; // end of class
+} // end namespace statistics
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkRunLengthFeaturesImageFilter.hxx"
+#endif
+
+#endif
@@ -0,0 +1,703 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkRunLengthFeaturesImageFilter_hxx
+#define __itkRunLengthFeaturesImageFilter_hxx
+
+#include "itkRunLengthFeaturesImageFilter.h"
+
+#include "itkImageLinearIteratorWithIndex.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIterator.h"
+#include "itkNeighborhood.h"
+#include "itkProgressReporter.h"
+
+#include "vnl/vnl_math.h"
+
+namespace itk
+{
+namespace Statistics
+{
+
+template<class TInputImage, class TOutputImage>
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::RunLengthFeaturesImageFilter()
+{
+  // Set the offset directions to their defaults: half of all the possible
+  // directions 1 pixel away (a run is the same in both directions).
+  typedef Neighborhood<typename InputImageType::PixelType, ImageDimension> NeighborhoodType;
+  NeighborhoodType neighborhood;
+  neighborhood.SetRadius( 1 );
+
+  unsigned int centerIndex = neighborhood.GetCenterNeighborhoodIndex();
+
+  this->m_Offsets.clear();
+  for ( unsigned int d = 0; d < centerIndex; d++ )
+    {
+    this->m_Offsets.push_back( neighborhood.GetOffset( d ) );
+    }
+
+  this->m_Min = NumericTraits<InputPixelType>::NonpositiveMin();
+  this->m_Max = NumericTraits<InputPixelType>::max();
+
+  this->m_MinDistance = NumericTraits<RealType>::Zero;
+  this->m_MaxDistance = NumericTraits<RealType>::Zero;
+
+  this->m_NumberOfBinsPerAxis = 64;
+
+  this->m_InsidePixelValue = 1;
+
+  this->m_NeighborhoodRadius.Fill( 10 );
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::SetMaskImage( const MaskImageType *mask )
+{
+  this->SetNthInput( 1, const_cast<MaskImageType *>( mask ) );
+}
+
+template<class TInputImage, class TOutputImage>
+const typename RunLengthFeaturesImageFilter<TInputImage, TOutputImage>::MaskImageType *
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::GetMaskImage() const
+{
+  const MaskImageType *maskImage = dynamic_cast<const MaskImageType *>( this->ProcessObject::GetInput( 1 ) );
+
+  return maskImage;
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::SetOffset( const OffsetType &offset )
+{
+  OffsetVectorType offsetVector;
+
+  offsetVector.push_back( offset );
+  this->SetOffsets( offsetVector );
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::SetPixelValueMinMax( InputPixelType min, InputPixelType max )
+{
+  if( this->m_Min != min || this->m_Max != max )
+    {
+    itkDebugMacro( "setting Min to " << min << "and Max to " << max );
+    this->m_Min = min;
+    this->m_Max = max;
+    this->Modified();
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::SetDistanceValueMinMax( RealType min, RealType max )
+{
+  if( this->m_MinDistance != min || this->m_MaxDistance != max )
+    {
+    itkDebugMacro( "setting MinDistance to " << min << "and MaxDistance to " << max );
+    this->m_MinDistance = min;
+    this->m_MaxDistance = max;
+    this->Modified();
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::GenerateOutputInformation()
+{
+  // this methods is overloaded so that if the output image is a
+  // VectorImage then the correct number of components are set.
+  Superclass::GenerateOutputInformation();
+  OutputImageType* output = this->GetOutput();
+
+  if ( !output )
+    {
+    return;
+    }
+  if ( output->GetNumberOfComponentsPerPixel() != this->GetNumberOfOutputComponents() )
+    {
+    output->SetNumberOfComponentsPerPixel( this->GetNumberOfOutputComponents() );
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::BeforeThreadedGenerateData()
+{
+  const InputImageType *inputImage = this->GetInput();
+  const MaskImageType  *maskImage = this->GetMaskImage();
+
+  const RegionType region = inputImage->GetRequestedRegion();
+
+  // Bin the intensities once for all the windows.
+  this->m_BinImage = BinImageType::New();
+  this->m_BinImage->SetRegions( region );
+  this->m_BinImage->Allocate();
+
+  ImageRegionConstIteratorWithIndex<InputImageType> ItI( inputImage, region );
+  ImageRegionIterator<BinImageType> ItB( this->m_BinImage, region );
+  for( ItI.GoToBegin(), ItB.GoToBegin(); !ItI.IsAtEnd(); ++ItI, ++ItB )
+    {
+    int bin = -1;
+    if( !maskImage || maskImage->GetPixel( ItI.GetIndex() ) == this->m_InsidePixelValue )
+      {
+      bin = this->ComputeBin( static_cast<RealType>( ItI.Get() ),
+        static_cast<RealType>( this->m_Min ), static_cast<RealType>( this->m_Max ) );
+      }
+    ItB.Set( bin );
+    }
+
+  // Orient the offsets forward in memory and find, for each of them, the
+  // longest run that fits in a window.
+  const typename BinImageType::OffsetValueType *offsetTable =
+    this->m_BinImage->GetOffsetTable();
+
+  this->m_RunOffsets.clear();
+  this->m_RunBufferOffsets.clear();
+
+  std::vector<RealType> offsetLengths;
+  std::vector<OffsetValueType> maximumLengths;
+
+  typename OffsetVectorType::const_iterator it;
+  for( it = this->m_Offsets.begin(); it != this->m_Offsets.end(); ++it )
+    {
+    OffsetType offset = *it;
+
+    int d = ImageDimension - 1;
+    while( d >= 0 && offset[d] == 0 )
+      {
+      d--;
+      }
+    if( d < 0 )
+      {
+      continue;
+      }
+    if( offset[d] < 0 )
+      {
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        offset[i] = -offset[i];
+        }
+      }
+
+    OffsetValueType bufferOffset = 0;
+    OffsetValueType maximumLength = NumericTraits<OffsetValueType>::max();
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      bufferOffset += offset[i] * offsetTable[i];
+      if( offset[i] != 0 )
+        {
+        maximumLength = vnl_math_min( maximumLength, static_cast<OffsetValueType>(
+          2 * this->m_NeighborhoodRadius[i] ) / vnl_math_abs( offset[i] ) + 1 );
+        }
+      }
+
+    typename InputImageType::PointType point;
+    inputImage->TransformIndexToPhysicalPoint( region.GetIndex(), point );
+    typename InputImageType::PointType offsetPoint;
+    inputImage->TransformIndexToPhysicalPoint( region.GetIndex() + offset, offsetPoint );
+
+    this->m_RunOffsets.push_back( offset );
+    this->m_RunBufferOffsets.push_back( bufferOffset );
+    offsetLengths.push_back( point.EuclideanDistanceTo( offsetPoint ) );
+    maximumLengths.push_back( maximumLength );
+    }
+
+  if( this->m_RunOffsets.empty() )
+    {
+    itkExceptionMacro( "No nonzero offset has been specified." );
+    }
+
+  RealType minDistance = this->m_MinDistance;
+  RealType maxDistance = this->m_MaxDistance;
+  if( maxDistance <= minDistance )
+    {
+    minDistance = 0.0;
+    maxDistance = 0.0;
+    for( unsigned int n = 0; n < this->m_RunOffsets.size(); n++ )
+      {
+      maxDistance = vnl_math_max( maxDistance, maximumLengths[n] * offsetLengths[n] );
+      }
+    }
+
+  this->m_RunLengthBins.resize( this->m_RunOffsets.size() );
+  for( unsigned int n = 0; n < this->m_RunOffsets.size(); n++ )
+    {
+    this->m_RunLengthBins[n].resize( maximumLengths[n] + 1 );
+    this->m_RunLengthBins[n][0] = -1;
+    for( OffsetValueType length = 1; length <= maximumLengths[n]; length++ )
+      {
+      this->m_RunLengthBins[n][length] = this->ComputeBin(
+        length * offsetLengths[n], minDistance, maxDistance );
+      }
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::ThreadedGenerateData( const RegionType & region, ThreadIdType threadId )
+{
+  ProgressReporter progress( this, threadId, region.GetNumberOfPixels() );
+
+  const MaskImageType *maskImage = this->GetMaskImage();
+  OutputImageType     *outputImage = this->GetOutput();
+
+  const RegionType imageRegion = this->m_BinImage->GetBufferedRegion();
+
+  OutputPixelType out;
+  NumericTraits<OutputPixelType>::SetLength( out, this->GetNumberOfOutputComponents() );
+
+  RunLengthSums sums;
+
+  ImageLinearIteratorWithIndex<OutputImageType> ItO( outputImage, region );
+  ItO.SetDirection( 0 );
+  for( ItO.GoToBegin(); !ItO.IsAtEnd(); ItO.NextLine() )
+    {
+    // The window is built from scratch at the start of each line and then
+    // moved along it.
+    this->InitializeSums( sums );
+    RegionType window;
+
+    for( ItO.GoToBeginOfLine(); !ItO.IsAtEndOfLine(); ++ItO )
+      {
+      const IndexType index = ItO.GetIndex();
+
+      IndexType windowIndex;
+      typename RegionType::SizeType windowSize;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        windowIndex[d] = index[d] - static_cast<OffsetValueType>( this->m_NeighborhoodRadius[d] );
+        windowSize[d] = 2 * this->m_NeighborhoodRadius[d] + 1;
+        }
+      RegionType newWindow( windowIndex, windowSize );
+      newWindow.Crop( imageRegion );
+
+      this->UpdateWindow( sums, window, newWindow );
+      window = newWindow;
+
+      if( maskImage && maskImage->GetPixel( index ) != this->m_InsidePixelValue )
+        {
+        out.Fill( 0 );
+        }
+      else
+        {
+        this->ComputeFeatures( sums, out );
+        }
+      ItO.Set( out );
+
+      progress.CompletedPixel();
+      }
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::AfterThreadedGenerateData()
+{
+  this->m_BinImage = NULL;
+  this->m_RunLengthBins.clear();
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::InitializeSums( RunLengthSums & sums ) const
+{
+  sums.GreyLevelCounts.assign( this->m_NumberOfBinsPerAxis, 0 );
+  sums.RunLengthCounts.assign( this->m_NumberOfBinsPerAxis, 0 );
+  sums.NumberOfRuns = 0;
+  sums.GreyLevelSquares = 0.0;
+  sums.RunLengthSquares = 0.0;
+  for( unsigned int i = 0; i < 8; i++ )
+    {
+    sums.Emphasis[i] = 0.0;
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::ComputeFeatures( const RunLengthSums & sums, OutputPixelType & out ) const
+{
+  if( sums.NumberOfRuns <= 0 )
+    {
+    out.Fill( 0 );
+    return;
+    }
+
+  const RealType numberOfRuns = static_cast<RealType>( sums.NumberOfRuns );
+
+  // Same order as HistogramToRunLengthFeaturesFilter::RunLengthFeatureName.
+  out[0] = sums.Emphasis[0] / numberOfRuns;
+  out[1] = sums.Emphasis[1] / numberOfRuns;
+  out[2] = sums.GreyLevelSquares / numberOfRuns;
+  out[3] = sums.RunLengthSquares / numberOfRuns;
+  for( unsigned int i = 2; i < 8; i++ )
+    {
+    out[i + 2] = sums.Emphasis[i] / numberOfRuns;
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::UpdateWindow( RunLengthSums & sums, const RegionType & window,
+  const RegionType & newWindow ) const
+{
+  const bool hasWindow = ( window.GetNumberOfPixels() > 0 );
+
+  // Bounding box of both windows.
+  OffsetValueType lower[ImageDimension];
+  OffsetValueType upper[ImageDimension];
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    lower[d] = newWindow.GetIndex()[d];
+    upper[d] = lower[d] + static_cast<OffsetValueType>( newWindow.GetSize()[d] ) - 1;
+    if( hasWindow )
+      {
+      lower[d] = vnl_math_min( lower[d],
+        static_cast<OffsetValueType>( window.GetIndex()[d] ) );
+      upper[d] = vnl_math_max( upper[d],
+        static_cast<OffsetValueType>( window.GetIndex()[d] ) +
+        static_cast<OffsetValueType>( window.GetSize()[d] ) - 1 );
+      }
+    }
+
+  const int *buffer = this->m_BinImage->GetBufferPointer();
+
+  for( unsigned int n = 0; n < this->m_RunOffsets.size(); n++ )
+    {
+    const OffsetType &offset = this->m_RunOffsets[n];
+
+    // Visit each line of the box once, through its first pixel: the pixels
+    // without predecessor along the offset form one slab per nonzero
+    // component, from which those of the previous slabs are left out.
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      if( offset[d] == 0 )
+        {
+        continue;
+        }
+
+      OffsetValueType first[ImageDimension];
+      OffsetValueType last[ImageDimension];
+      bool isEmpty = false;
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        first[i] = lower[i];
+        last[i] = upper[i];
+        if( i == d )
+          {
+          if( offset[i] > 0 )
+            {
+            last[i] = vnl_math_min( upper[i], lower[i] + offset[i] - 1 );
+            }
+          else
+            {
+            first[i] = vnl_math_max( lower[i], upper[i] + offset[i] + 1 );
+            }
+          }
+        else if( i < d && offset[i] != 0 )
+          {
+          if( offset[i] > 0 )
+            {
+            first[i] = lower[i] + offset[i];
+            }
+          else
+            {
+            last[i] = upper[i] + offset[i];
+            }
+          }
+        isEmpty = isEmpty || ( first[i] > last[i] );
+        }
+      if( isEmpty )
+        {
+        continue;
+        }
+
+      IndexType index;
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        index[i] = first[i];
+        }
+      while( true )
+        {
+        OffsetValueType a = 0;
+        OffsetValueType b = -1;
+        if( hasWindow )
+          {
+          this->GetLineInterval( index, offset, window, a, b );
+          }
+        OffsetValueType newA;
+        OffsetValueType newB;
+        this->GetLineInterval( index, offset, newWindow, newA, newB );
+
+        if( a != newA || b != newB )
+          {
+          this->UpdateLine( sums, buffer + this->m_BinImage->ComputeOffset( index ),
+            n, a, b, newA, newB );
+          }
+
+        unsigned int i = 0;
+        for( ; i < ImageDimension; i++ )
+          {
+          if( index[i] < last[i] )
+            {
+            index[i]++;
+            break;
+            }
+          index[i] = first[i];
+          }
+        if( i == ImageDimension )
+          {
+          break;
+          }
+        }
+      }
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::UpdateLine( RunLengthSums & sums, const int *pixel, unsigned int n,
+  OffsetValueType a, OffsetValueType b,
+  OffsetValueType newA, OffsetValueType newB ) const
+{
+  if( a > b || newA > newB || b < newA || newB < a )
+    {
+    this->AddRuns( sums, pixel, n, a, b, -1 );
+    this->AddRuns( sums, pixel, n, newA, newB, 1 );
+    return;
+    }
+
+  // The intervals overlap and differ only at their ends, so only the lines
+  // of same-bin pixels (within both intervals) meeting these ends change.
+  const OffsetValueType lower = vnl_math_min( a, newA );
+  const OffsetValueType upper = vnl_math_max( b, newB );
+  const OffsetValueType step = this->m_RunBufferOffsets[n];
+
+  OffsetValueType last = lower - 1;
+  if( a != newA )
+    {
+    const OffsetValueType end = vnl_math_max( a, newA ) - 1;
+    OffsetValueType s = lower;
+    while( s <= end )
+      {
+      const int bin = pixel[s * step];
+      OffsetValueType t = s;
+      while( t < upper && pixel[( t + 1 ) * step] == bin )
+        {
+        t++;
+        }
+      if( bin >= 0 )
+        {
+        this->AddRun( sums, bin, n, vnl_math_min( t, b ) - vnl_math_max( s, a ) + 1, -1 );
+        this->AddRun( sums, bin, n, vnl_math_min( t, newB ) - vnl_math_max( s, newA ) + 1, 1 );
+        }
+      s = t + 1;
+      }
+    last = s - 1;
+    }
+  if( b != newB )
+    {
+    const OffsetValueType begin = vnl_math_min( b, newB ) + 1;
+    OffsetValueType t = upper;
+    while( t >= begin && t > last )
+      {
+      const int bin = pixel[t * step];
+      OffsetValueType s = t;
+      while( s > last + 1 && pixel[( s - 1 ) * step] == bin )
+        {
+        s--;
+        }
+      if( bin >= 0 )
+        {
+        this->AddRun( sums, bin, n, vnl_math_min( t, b ) - vnl_math_max( s, a ) + 1, -1 );
+        this->AddRun( sums, bin, n, vnl_math_min( t, newB ) - vnl_math_max( s, newA ) + 1, 1 );
+        }
+      t = s - 1;
+      }
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::AddRuns( RunLengthSums & sums, const int *pixel, unsigned int n,
+  OffsetValueType a, OffsetValueType b, int sign ) const
+{
+  const OffsetValueType step = this->m_RunBufferOffsets[n];
+
+  OffsetValueType s = a;
+  while( s <= b )
+    {
+    const int bin = pixel[s * step];
+    OffsetValueType t = s;
+    while( t < b && pixel[( t + 1 ) * step] == bin )
+      {
+      t++;
+      }
+    if( bin >= 0 )
+      {
+      this->AddRun( sums, bin, n, t - s + 1, sign );
+      }
+    s = t + 1;
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::AddRun( RunLengthSums & sums, int bin, unsigned int n, OffsetValueType length,
+  int sign ) const
+{
+  // An empty intersection with the window, nothing to add or remove.
+  if( length <= 0 )
+    {
+    return;
+    }
+  const int runLengthBin = this->m_RunLengthBins[n][length];
+  if( runLengthBin < 0 )
+    {
+    return;
+    }
+
+  // Same weights as HistogramToRunLengthFeaturesFilter.
+  const RealType i2 = vnl_math_sqr( static_cast<RealType>( bin + 1 ) );
+  const RealType j2 = vnl_math_sqr( static_cast<RealType>( runLengthBin + 1 ) );
+  const RealType weight = static_cast<RealType>( sign );
+
+  long &greyLevelCount = sums.GreyLevelCounts[bin];
+  sums.GreyLevelSquares += weight * ( 2 * greyLevelCount + sign );
+  greyLevelCount += sign;
+
+  long &runLengthCount = sums.RunLengthCounts[runLengthBin];
+  sums.RunLengthSquares += weight * ( 2 * runLengthCount + sign );
+  runLengthCount += sign;
+
+  sums.NumberOfRuns += sign;
+
+  sums.Emphasis[0] += weight / j2;
+  sums.Emphasis[1] += weight * j2;
+  sums.Emphasis[2] += weight / i2;
+  sums.Emphasis[3] += weight * i2;
+  sums.Emphasis[4] += weight / ( i2 * j2 );
+  sums.Emphasis[5] += weight * i2 / j2;
+  sums.Emphasis[6] += weight * j2 / i2;
+  sums.Emphasis[7] += weight * i2 * j2;
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::GetLineInterval( const IndexType & index, const OffsetType & offset,
+  const RegionType & region, OffsetValueType & a, OffsetValueType & b ) const
+{
+  a = 0;
+  b = NumericTraits<OffsetValueType>::max();
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    const OffsetValueType lower = region.GetIndex()[d];
+    const OffsetValueType upper = lower + static_cast<OffsetValueType>( region.GetSize()[d] ) - 1;
+    const OffsetValueType position = index[d];
+    if( offset[d] == 0 )
+      {
+      if( position < lower || position > upper )
+        {
+        b = -1;
+        }
+      }
+    else if( offset[d] > 0 )
+      {
+      a = vnl_math_max( a, -FloorDivide( position - lower, offset[d] ) );
+      b = vnl_math_min( b, FloorDivide( upper - position, offset[d] ) );
+      }
+    else
+      {
+      a = vnl_math_max( a, -FloorDivide( position - upper, offset[d] ) );
+      b = vnl_math_min( b, FloorDivide( lower - position, offset[d] ) );
+      }
+    }
+  if( a > b )
+    {
+    a = 0;
+    b = -1;
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+typename RunLengthFeaturesImageFilter<TInputImage, TOutputImage>::OffsetValueType
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::FloorDivide( OffsetValueType a, OffsetValueType b )
+{
+  OffsetValueType q = a / b;
+  if( a % b != 0 && ( ( a < 0 ) != ( b < 0 ) ) )
+    {
+    q--;
+    }
+  return q;
+}
+
+template<class TInputImage, class TOutputImage>
+int
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::ComputeBin( RealType value, RealType minimum, RealType maximum ) const
+{
+  if( value < minimum || value > maximum )
+    {
+    return -1;
+    }
+  if( maximum <= minimum )
+    {
+    return 0;
+    }
+  const int bin = static_cast<int>( ( value - minimum ) / ( maximum - minimum ) *
+    static_cast<RealType>( this->m_NumberOfBinsPerAxis ) );
+  return vnl_math_min( bin, static_cast<int>( this->m_NumberOfBinsPerAxis ) - 1 );
+}
+
+template<class TInputImage, class TOutputImage>
+void
+RunLengthFeaturesImageFilter<TInputImage, TOutputImage>
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NeighborhoodRadius: " << this->m_NeighborhoodRadius << std::endl;
+  os << indent << "Min: " << this->GetMin() << std::endl;
+  os << indent << "Max: " << this->GetMax() << std::endl;
+  os << indent << "MinDistance: " << this->GetMinDistance() << std::endl;
+  os << indent << "MaxDistance: " << this->GetMaxDistance() << std::endl;
+  os << indent << "NumberOfBinsPerAxis: " << this->GetNumberOfBinsPerAxis() << std::endl;
+  os << indent << "InsidePixelValue: " << this->GetInsidePixelValue() << std::endl;
+}
+
+} // end namespace Statistics
+} // end namespace itk
+
+#endif
@@ -21,15 +21,31 @@
 #include "itkHistogram.h"
 #include "itkDenseFrequencyContainer2.h"
 #include "itkMacro.h"
+#include "itkMultiThreader.h"
 #include "itkNumericTraits.h"
 #include "itkProcessObject.h"
 #include "itkVectorContainer.h"
 
+#include <vector>
+
 namespace itk {
 namespace Statistics {
 
 /** \class ScalarImageToRunLengthMatrixFilter
 *
+* A run along an offset is a maximal line of pixels p, p + offset, ...
+* falling in the same intensity bin; it is counted from its first pixel
+* within [Min, Max] (and inside the mask) and its length is the physical
+* distance from that pixel to the one after the run.  The sign of an offset
+* does not matter.
+*
+* The pixels are binned once, then the image is traversed once for all the
+* offsets, each thread taking a slab and following, for each offset, the
+* runs that start in its slab.  A pixel starts a run when its predecessor
+* along the offset is outside the region or in another bin, so no pixel is
+* visited twice per offset.  The runs are counted in a flat matrix per
+* thread, which is added to the histogram at the end.
+*
 * Author: Nick Tustison
 */
 
@@ -121,8 +137,8 @@ protected:
   ScalarImageToRunLengthMatrixFilter();
   virtual ~ScalarImageToRunLengthMatrixFilter() {};
   void PrintSelf( std::ostream& os, Indent indent ) const;
-  virtual void FillHistogram( RadiusType radius, RegionType region );
-  virtual void FillHistogramWithMask( RadiusType radius, RegionType region,
+  virtual void FillHistogram( const RegionType & region );
+  virtual void FillHistogramWithMask( const RegionType & region,
     const ImageType * maskImage );
 
   /** Standard itk::ProcessObject subclass method. */
@@ -136,6 +152,24 @@ private:
   ScalarImageToRunLengthMatrixFilter(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
 
+  typedef Image<int, ImageDimension>                      BinImageType;
+  typedef typename OffsetType::OffsetValueType            OffsetValueType;
+
+  struct ThreadStruct
+    {
+    Self *Filter;
+    };
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback( void *arg );
+
+  /** First pass: bin the pixels of a slab.  Second pass: count the runs
+   * starting in a slab. */
+  void ThreadedBinPixels( const RegionType & region );
+  void ThreadedCountRuns( const RegionType & region, unsigned int threadId );
+
+  /** Histogram bin of a value along an axis, -1 if outside. */
+  int GetBin( unsigned int axis, MeasurementType value ) const;
+
   OffsetVectorPointer      m_Offsets;
   PixelType                m_Min;
   PixelType                m_Max;
@@ -147,6 +181,17 @@ private:
   MeasurementVectorType    m_UpperBound;
 
   PixelType                m_InsidePixelValue;
+
+  /** State of the current update.  A pixel of the bin image holds twice its
+   * intensity bin, plus one if a run may start there, or -1. */
+  bool                                      m_BinningStep;
+  const ImageType                          *m_CurrentMaskImage;
+  typename BinImageType::Pointer            m_BinImage;
+  std::vector<OffsetType>                   m_RunOffsets;
+  std::vector<RealType>                     m_RunOffsetLengths;
+  MeasurementType                           m_BinMinimum[2];
+  std::vector<MeasurementType>              m_BinMaxima[2];
+  std::vector<std::vector<unsigned long> >  m_ThreadRunCounts;
 };
 
 } // end of namespace Statistics
@@ -19,10 +19,15 @@
 
 #include "itkScalarImageToRunLengthMatrixFilter.h"
 
-#include "itkConstNeighborhoodIterator.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIterator.h"
+#include "itkImageRegionSplitter.h"
 #include "itkNeighborhood.h"
 #include "vnl/vnl_math.h"
 
+#include <algorithm>
+
 
 namespace itk {
 namespace Statistics {
@@ -60,6 +65,9 @@ ScalarImageToRunLengthMatrixFilter<TImageType, THistogramFrequencyContainer>
 
   this->m_NumberOfBinsPerAxis = DefaultBinsPerAxis;
 
+  this->m_BinningStep = false;
+  this->m_CurrentMaskImage = NULL;
+
   // Get a set of default offset values.
   typedef Neighborhood<PixelType, ImageDimension> NeighborhoodType;
   NeighborhoodType neighborhood;
@@ -189,24 +197,55 @@ GenerateData( void )
   size.Fill( this->m_NumberOfBinsPerAxis );
   output->Initialize( size, this->m_LowerBound, this->m_UpperBound );
 
-  // Next, find the minimum radius that encloses all the offsets.
-  unsigned int minRadius = 0;
+  // The bin limits are looked up directly rather than through the
+  // histogram for each run.
+  for( unsigned int axis = 0; axis < 2; axis++ )
+    {
+    this->m_BinMinimum[axis] = output->GetBinMin( axis, 0 );
+    this->m_BinMaxima[axis].resize( this->m_NumberOfBinsPerAxis );
+    for( unsigned int n = 0; n < this->m_NumberOfBinsPerAxis; n++ )
+      {
+      this->m_BinMaxima[axis][n] = output->GetBinMax( axis, n );
+      }
+    }
+
+  // Next, orient all the offsets forward in memory order (a run is the
+  // same in both directions) and compute their physical lengths.
+  this->m_RunOffsets.clear();
+  this->m_RunOffsetLengths.clear();
+
   typename OffsetVector::ConstIterator offsets;
   for( offsets = this->m_Offsets->Begin(); offsets != this->m_Offsets->End();
     offsets++ )
     {
-    for( unsigned int i = 0; i < offsets.Value().GetOffsetDimension(); i++ )
+    OffsetType offset = offsets.Value();
+
+    int d = ImageDimension - 1;
+    while( d >= 0 && offset[d] == 0 )
+      {
+      d--;
+      }
+    if( d < 0 )
+      {
+      continue;
+      }
+    if( offset[d] < 0 )
       {
-      unsigned int distance = vnl_math_abs( offsets.Value()[i] );
-      if( distance > minRadius )
+      for( unsigned int i = 0; i < ImageDimension; i++ )
         {
-        minRadius = distance;
+        offset[i] = -offset[i];
         }
       }
-    }
 
-  RadiusType radius;
-  radius.Fill( minRadius );
+    IndexType index = input->GetRequestedRegion().GetIndex();
+    PointType point;
+    input->TransformIndexToPhysicalPoint( index, point );
+    PointType offsetPoint;
+    input->TransformIndexToPhysicalPoint( index + offset, offsetPoint );
+
+    this->m_RunOffsets.push_back( offset );
+    this->m_RunOffsetLengths.push_back( point.EuclideanDistanceTo( offsetPoint ) );
+    }
 
   const ImageType *maskImage = NULL;
 
@@ -220,192 +259,282 @@ GenerateData( void )
   // Now fill in the histogram
   if ( maskImage != NULL )
     {
-    this->FillHistogramWithMask( radius, input->GetRequestedRegion(), maskImage );
+    this->FillHistogramWithMask( input->GetRequestedRegion(), maskImage );
     }
   else
     {
-    this->FillHistogram( radius, input->GetRequestedRegion() );
+    this->FillHistogram( input->GetRequestedRegion() );
     }
+
+  this->m_RunOffsets.clear();
+  this->m_RunOffsetLengths.clear();
 }
 
 template<class TImageType, class THistogramFrequencyContainer>
 void
 ScalarImageToRunLengthMatrixFilter<TImageType,
 THistogramFrequencyContainer>::
-FillHistogramWithMask( RadiusType radius, RegionType region, const ImageType *maskImage )
+FillHistogram( const RegionType & region )
 {
-  // Iterate over all of those pixels and offsets, adding each
-  // co-occurrence pair to the histogram
-
-  const ImageType *input = this->GetInput();
+  this->FillHistogramWithMask( region, NULL );
+}
 
+template<class TImageType, class THistogramFrequencyContainer>
+void
+ScalarImageToRunLengthMatrixFilter<TImageType,
+THistogramFrequencyContainer>::
+FillHistogramWithMask( const RegionType & region, const ImageType *maskImage )
+{
   HistogramType * output =
    static_cast< HistogramType * >( this->ProcessObject::GetOutput( 0 ) );
 
-  typedef ConstNeighborhoodIterator<ImageType> NeighborhoodIteratorType;
-  NeighborhoodIteratorType neighborIt, maskNeighborIt;
-  neighborIt = NeighborhoodIteratorType( radius, input, region );
-  maskNeighborIt = NeighborhoodIteratorType( radius, maskImage, region );
+  this->m_CurrentMaskImage = maskImage;
 
-  typename OffsetVector::ConstIterator offsets;
-  for( offsets = this->GetOffsets()->Begin();
-    offsets != this->GetOffsets()->End(); offsets++ )
+  this->m_BinImage = BinImageType::New();
+  this->m_BinImage->SetRegions( region );
+  this->m_BinImage->Allocate();
+
+  const unsigned int numberOfBins = this->m_NumberOfBinsPerAxis;
+
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+  const unsigned int numberOfThreads =
+    this->GetMultiThreader()->GetNumberOfThreads();
+
+  this->m_ThreadRunCounts.resize( numberOfThreads );
+  for( unsigned int n = 0; n < numberOfThreads; n++ )
     {
-    typedef Image<bool, ImageDimension> BoolImageType;
-    typename BoolImageType::Pointer alreadyVisitedImage = BoolImageType::New();
-    alreadyVisitedImage->SetRegions( input->GetRequestedRegion() );
-    alreadyVisitedImage->SetOrigin( input->GetOrigin() );
-    alreadyVisitedImage->SetSpacing( input->GetSpacing() );
-    alreadyVisitedImage->Allocate();
-    alreadyVisitedImage->FillBuffer( false );
-
-    neighborIt.GoToBegin();
-    OffsetType offset = offsets.Value();
+    this->m_ThreadRunCounts[n].assign( numberOfBins * numberOfBins, 0 );
+    }
+
+  ThreadStruct str;
+  str.Filter = this;
+
+  this->GetMultiThreader()->SetSingleMethod( this->ThreaderCallback, &str );
+
+  this->m_BinningStep = true;
+  this->GetMultiThreader()->SingleMethodExecute();
 
-    for(neighborIt.GoToBegin(), maskNeighborIt.GoToBegin();
-      !neighborIt.IsAtEnd(); ++neighborIt, ++maskNeighborIt )
+  this->m_BinningStep = false;
+  this->GetMultiThreader()->SingleMethodExecute();
+
+  // Add the run counts of all threads to the histogram.
+  typename HistogramType::IndexType index( output->GetMeasurementVectorSize() );
+  for( unsigned int i = 0; i < numberOfBins; i++ )
+    {
+    for( unsigned int j = 0; j < numberOfBins; j++ )
       {
-      if ( maskNeighborIt.GetCenterPixel() != this->m_InsidePixelValue )
+      unsigned long count = 0;
+      for( unsigned int n = 0; n < numberOfThreads; n++ )
         {
-        continue; // Go to the next loop if we're not in the mask
+        count += this->m_ThreadRunCounts[n][i * numberOfBins + j];
         }
-      const PixelType centerPixelIntensity = neighborIt.GetCenterPixel();
-      IndexType centerIndex = neighborIt.GetIndex();
-      if ( centerPixelIntensity < this->m_Min ||
-           centerPixelIntensity > this->m_Max ||
-           alreadyVisitedImage->GetPixel( centerIndex ) )
+      if( count > 0 )
         {
-        continue; // don't put a pixel in the histogram if the value
-                  // is out-of-bounds.
+        index[0] = i;
+        index[1] = j;
+        output->IncreaseFrequencyOfIndex( index, count );
         }
+      }
+    }
 
-      MeasurementType centerBinMin = output->
-        GetBinMinFromValue( 0, centerPixelIntensity );
-      MeasurementType centerBinMax = output->
-        GetBinMaxFromValue( 0, centerPixelIntensity );
+  this->m_BinImage = NULL;
+  this->m_ThreadRunCounts.clear();
+  this->m_CurrentMaskImage = NULL;
+}
 
-      IndexType index = centerIndex;
-      PixelType pixelIntensity = input->GetPixel( index );
-      while ( pixelIntensity >= centerBinMin &&
-              pixelIntensity <= centerBinMax &&
-              !alreadyVisitedImage->GetPixel( index ) )
-        {
-        alreadyVisitedImage->SetPixel( index, true );
-        index += offset;
-        if ( input->GetRequestedRegion().IsInside( index ) )
-          {
-          pixelIntensity = input->GetPixel( index );
-          }
-        else
-          {
-          break;
-          }
-        }
+template<class TImageType, class THistogramFrequencyContainer>
+ITK_THREAD_RETURN_TYPE
+ScalarImageToRunLengthMatrixFilter<TImageType,
+THistogramFrequencyContainer>::
+ThreaderCallback( void *arg )
+{
+  unsigned int threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  unsigned int threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
 
-      PointType centerPoint;
-      input->TransformIndexToPhysicalPoint( centerIndex, centerPoint );
-      PointType point;
-      input->TransformIndexToPhysicalPoint( index, point );
+  ThreadStruct *str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+  Self *filter = str->Filter;
 
-      MeasurementVectorType run( output->GetMeasurementVectorSize() );
-      run[0] = centerPixelIntensity;
-      run[1] = centerPoint.EuclideanDistanceTo( point );
+  const RegionType region = filter->m_BinImage->GetBufferedRegion();
 
-      if ( run[1] >= this->m_MinDistance &&
-           run[1] <= this->m_MaxDistance )
-        {
-        output->IncreaseFrequencyOfMeasurement( run, 1 );
-        }
+  typename ImageRegionSplitter<ImageDimension>::Pointer splitter =
+    ImageRegionSplitter<ImageDimension>::New();
+  const unsigned int total = splitter->GetNumberOfSplits( region, threadCount );
+  if( threadId < total )
+    {
+    const RegionType slab = splitter->GetSplit( threadId, total, region );
+    if( filter->m_BinningStep )
+      {
+      filter->ThreadedBinPixels( slab );
+      }
+    else
+      {
+      filter->ThreadedCountRuns( slab, threadId );
       }
     }
+
+  return ITK_THREAD_RETURN_VALUE;
 }
 
 template<class TImageType, class THistogramFrequencyContainer>
 void
 ScalarImageToRunLengthMatrixFilter<TImageType,
 THistogramFrequencyContainer>::
-FillHistogram( RadiusType radius, RegionType region )
+ThreadedBinPixels( const RegionType & region )
 {
-   // Iterate over all of those pixels and offsets, adding each
-  // co-occurrence pair to the histogram
-
   const ImageType *input = this->GetInput();
+  const ImageType *maskImage = this->m_CurrentMaskImage;
 
-  HistogramType * output =
-   static_cast< HistogramType * >( this->ProcessObject::GetOutput( 0 ) );
+  ImageRegionConstIterator<ImageType> ItI( input, region );
+  ImageRegionIterator<BinImageType> ItB( this->m_BinImage, region );
+  for( ItI.GoToBegin(), ItB.GoToBegin(); !ItI.IsAtEnd(); ++ItI, ++ItB )
+    {
+    const PixelType pixelIntensity = ItI.Get();
+    const int bin = this->GetBin( 0, pixelIntensity );
+    if( bin < 0 )
+      {
+      ItB.Set( -1 );
+      continue;
+      }
+    bool isStart = ( pixelIntensity >= this->m_Min &&
+                     pixelIntensity <= this->m_Max );
+    if( isStart && maskImage &&
+      maskImage->GetPixel( ItI.GetIndex() ) != this->m_InsidePixelValue )
+      {
+      isStart = false;
+      }
+    ItB.Set( 2 * bin + ( isStart ? 1 : 0 ) );
+    }
+}
+
+template<class TImageType, class THistogramFrequencyContainer>
+void
+ScalarImageToRunLengthMatrixFilter<TImageType,
+THistogramFrequencyContainer>::
+ThreadedCountRuns( const RegionType & region, unsigned int threadId )
+{
+  const RegionType binRegion = this->m_BinImage->GetBufferedRegion();
+  const IndexType binStart = binRegion.GetIndex();
+  const typename RegionType::SizeType binSize = binRegion.GetSize();
+  const int *buffer = this->m_BinImage->GetBufferPointer();
+  const typename BinImageType::OffsetValueType *offsetTable =
+    this->m_BinImage->GetOffsetTable();
+
+  const unsigned int numberOfOffsets = this->m_RunOffsets.size();
+  std::vector<OffsetValueType> bufferOffsets( numberOfOffsets, 0 );
+  for( unsigned int n = 0; n < numberOfOffsets; n++ )
+    {
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      bufferOffsets[n] += this->m_RunOffsets[n][d] * offsetTable[d];
+      }
+    }
 
-  typedef ConstNeighborhoodIterator<ImageType> NeighborhoodIteratorType;
-  NeighborhoodIteratorType neighborIt( radius,
-    input, input->GetRequestedRegion() );
+  const unsigned int numberOfBins = this->m_NumberOfBinsPerAxis;
+  std::vector<unsigned long> &counts = this->m_ThreadRunCounts[threadId];
 
-  typename OffsetVector::ConstIterator offsets;
-  for( offsets = this->GetOffsets()->Begin();
-    offsets != this->GetOffsets()->End(); offsets++ )
+  ImageRegionConstIteratorWithIndex<BinImageType> It( this->m_BinImage, region );
+  for( It.GoToBegin(); !It.IsAtEnd(); ++It )
     {
-    typedef Image<bool, ImageDimension> BoolImageType;
-    typename BoolImageType::Pointer alreadyVisitedImage = BoolImageType::New();
-    alreadyVisitedImage->SetRegions( input->GetRequestedRegion() );
-    alreadyVisitedImage->SetOrigin( input->GetOrigin() );
-    alreadyVisitedImage->SetSpacing( input->GetSpacing() );
-    alreadyVisitedImage->Allocate();
-    alreadyVisitedImage->FillBuffer( false );
-
-    neighborIt.GoToBegin();
-    OffsetType offset = offsets.Value();
+    const int code = It.Get();
+    if( code < 0 )
+      {
+      continue;
+      }
+    const int bin = code >> 1;
+    const IndexType index = It.GetIndex();
+    const int *pixel = buffer + this->m_BinImage->ComputeOffset( index );
 
-    for ( neighborIt.GoToBegin(); !neighborIt.IsAtEnd(); ++neighborIt )
+    for( unsigned int n = 0; n < numberOfOffsets; n++ )
       {
-      const PixelType centerPixelIntensity = neighborIt.GetCenterPixel();
-      IndexType centerIndex = neighborIt.GetIndex();
-      if ( centerPixelIntensity < this->m_Min ||
-           centerPixelIntensity > this->m_Max ||
-           alreadyVisitedImage->GetPixel( centerIndex ) )
+      const OffsetType &offset = this->m_RunOffsets[n];
+
+      // Number of steps to the last pixel of the line in the region, and
+      // whether the line has a pixel before this one.
+      bool hasPredecessor = true;
+      OffsetValueType maximumSteps = NumericTraits<OffsetValueType>::max();
+      for( unsigned int d = 0; d < ImageDimension; d++ )
         {
-        continue; // don't put a pixel in the histogram if the value
-                  // is out-of-bounds.
+        const OffsetValueType position = index[d] - binStart[d];
+        const OffsetValueType extent = static_cast<OffsetValueType>( binSize[d] );
+        if( offset[d] > 0 )
+          {
+          maximumSteps = vnl_math_min( maximumSteps,
+            ( extent - 1 - position ) / offset[d] );
+          hasPredecessor = hasPredecessor && ( position >= offset[d] );
+          }
+        else if( offset[d] < 0 )
+          {
+          maximumSteps = vnl_math_min( maximumSteps, position / -offset[d] );
+          hasPredecessor = hasPredecessor && ( position - offset[d] < extent );
+          }
         }
 
-      MeasurementType centerBinMin = output->
-        GetBinMinFromValue( 0, centerPixelIntensity );
-      MeasurementType centerBinMax = output->
-        GetBinMaxFromValue( 0, centerPixelIntensity );
-
-      IndexType index = centerIndex;
-      PixelType pixelIntensity = input->GetPixel( index );
-      while ( pixelIntensity >= centerBinMin &&
-              pixelIntensity <= centerBinMax &&
-              !alreadyVisitedImage->GetPixel( index ) )
+      // Only the first pixel of a line of same-bin pixels walks it.
+      if( hasPredecessor )
         {
-        alreadyVisitedImage->SetPixel( index, true );
-        index += offset;
-        if ( input->GetRequestedRegion().IsInside( index ) )
+        const int predecessor = *( pixel - bufferOffsets[n] );
+        if( predecessor >= 0 && ( predecessor >> 1 ) == bin )
           {
-          pixelIntensity = input->GetPixel( index );
+          continue;
           }
-        else
+        }
+
+      OffsetValueType first = ( code & 1 ) ? 0 : -1;
+      OffsetValueType steps = 1;
+      const int *next = pixel;
+      while( steps <= maximumSteps )
+        {
+        next += bufferOffsets[n];
+        if( *next < 0 || ( *next >> 1 ) != bin )
           {
           break;
           }
+        if( first < 0 && ( *next & 1 ) )
+          {
+          first = steps;
+          }
+        steps++;
+        }
+      if( first < 0 )
+        {
+        continue;
         }
 
-      PointType centerPoint;
-      input->TransformIndexToPhysicalPoint( centerIndex, centerPoint );
-      PointType point;
-      input->TransformIndexToPhysicalPoint( index, point );
-
-      MeasurementVectorType run( output->GetMeasurementVectorSize() );
-      run[0] = centerPixelIntensity;
-      run[1] = centerPoint.EuclideanDistanceTo( point );
-
-      if ( run[1] >= this->m_MinDistance &&
-           run[1] <= this->m_MaxDistance )
+      const RealType distance = ( steps - first ) * this->m_RunOffsetLengths[n];
+      if( distance < this->m_MinDistance || distance > this->m_MaxDistance )
+        {
+        continue;
+        }
+      const int distanceBin = this->GetBin( 1, distance );
+      if( distanceBin >= 0 )
         {
-        output->IncreaseFrequencyOfMeasurement( run, 1 );
+        counts[bin * numberOfBins + distanceBin]++;
         }
       }
     }
 }
 
+template<class TImageType, class THistogramFrequencyContainer>
+int
+ScalarImageToRunLengthMatrixFilter<TImageType,
+THistogramFrequencyContainer>::
+GetBin( unsigned int axis, MeasurementType value ) const
+{
+  // Same convention as the histogram: bin n holds [min_n, max_n) and
+  // values outside all the bins are dropped.
+  if( value < this->m_BinMinimum[axis] )
+    {
+    return -1;
+    }
+  typename std::vector<MeasurementType>::const_iterator it = std::upper_bound(
+    this->m_BinMaxima[axis].begin(), this->m_BinMaxima[axis].end(), value );
+  if( it == this->m_BinMaxima[axis].end() )
+    {
+    return -1;
+    }
+  return static_cast<int>( it - this->m_BinMaxima[axis].begin() );
+}
+
 template<class TImageType, class THistogramFrequencyContainer>
 void
 ScalarImageToRunLengthMatrixFilter<TImageType,
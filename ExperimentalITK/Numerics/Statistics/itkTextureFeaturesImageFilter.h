@@ -21,7 +21,9 @@
 #include "itkConstNeighborhoodIterator.h"
 #include "itkDenseFrequencyContainer2.h"
 #include "itkHistogram.h"
+#include "itkImageRegionBrickSplitter.h"
 #include "itkImageToImageFilter.h"
+#include "itkProgressReporter.h"
 #include "itkVectorContainer.h"
 #include "itkVectorImage.h"
 
@@ -127,6 +129,16 @@ public:
   itkSetMacro( InsidePixelValue, typename MaskImageType::PixelType );
   itkGetConstMacro( InsidePixelValue, typename MaskImageType::PixelType );
 
+  /**
+   * Traverse the output in bricks ordered along a Hilbert curve, each
+   * thread taking one segment of the curve, instead of in raster order.
+   * For large radii this keeps the windows of consecutive pixels in cache.
+   * Off by default.
+   */
+  itkSetMacro( UseCurveOrderedTraversal, bool );
+  itkGetConstMacro( UseCurveOrderedTraversal, bool );
+  itkBooleanMacro( UseCurveOrderedTraversal );
+
   unsigned int GetNumberOfOutputComponents() { return 8; }
 
 protected:
@@ -142,6 +154,9 @@ protected:
 
   virtual void ThreadedGenerateData( const RegionType &, ThreadIdType );
 
+  /** Compute the features over a region (called per brick or per slab). */
+  void ComputeFeatures( const RegionType &, ProgressReporter & );
+
   virtual void BeforeThreadedGenerateData();
 
   void PrintSelf( std::ostream & os, Indent indent ) const;
@@ -162,6 +177,9 @@ private:
   bool                                              m_Normalize;
   typename MaskImageType::PixelType                 m_InsidePixelValue;
 
+  bool                                              m_UseCurveOrderedTraversal;
+  typename ImageRegionBrickSplitter<ImageDimension>::Pointer  m_BrickSplitter;
+
 }; // end of class
 } // end namespace statistics
 } // end namespace itk
@@ -22,7 +22,6 @@
 
 #include "itkHistogramToTextureFeaturesFilter.h"
 #include "itkNeighborhoodAlgorithm.h"
-#include "itkProgressReporter.h"
 
 #include <vector>
 
@@ -58,6 +57,8 @@ TextureFeaturesImageFilter<TInputImage, TOutputImage>
   this->m_InsidePixelValue = 1;
 
   this->m_NeighborhoodRadius.Fill( 10 );
+
+  this->m_UseCurveOrderedTraversal = false;
 }
 
 template<class TInputImage, class TOutputImage>
@@ -174,6 +175,14 @@ TextureFeaturesImageFilter<TInputImage, TOutputImage>
         }
       }
     } while ( o1[ImageDimension-1] <= static_cast<OffsetValueType>( this->m_NeighborhoodRadius[ImageDimension-1] ) );
+
+  this->m_BrickSplitter = NULL;
+  if( this->m_UseCurveOrderedTraversal )
+    {
+    this->m_BrickSplitter = ImageRegionBrickSplitter<ImageDimension>::New();
+    this->m_BrickSplitter->SetRegion( this->GetOutput()->GetRequestedRegion() );
+    this->m_BrickSplitter->Initialize();
+    }
 }
 
 
@@ -181,6 +190,33 @@ template<class TInputImage, class TOutputImage>
 void
 TextureFeaturesImageFilter<TInputImage, TOutputImage>
 ::ThreadedGenerateData( const RegionType & region, ThreadIdType threadId )
+{
+  ProgressReporter progress( this, threadId, region.GetNumberOfPixels() );
+
+  if( !this->m_BrickSplitter )
+    {
+    this->ComputeFeatures( region, progress );
+    return;
+    }
+
+  // This thread takes the segment of the curve with the same rank as its
+  // slab, the number of segments being the number of slabs.
+  RegionType slab;
+  const unsigned int numberOfSegments = this->SplitRequestedRegion(
+    threadId, this->GetMultiThreader()->GetNumberOfThreads(), slab );
+
+  unsigned long first, last;
+  this->m_BrickSplitter->GetSegment( threadId, numberOfSegments, first, last );
+  for( unsigned long b = first; b < last; b++ )
+    {
+    this->ComputeFeatures( this->m_BrickSplitter->GetBrick( b ), progress );
+    }
+}
+
+template<class TInputImage, class TOutputImage>
+void
+TextureFeaturesImageFilter<TInputImage, TOutputImage>
+::ComputeFeatures( const RegionType & region, ProgressReporter & progress )
 {
   const InputImageType *inputImage = this->GetInput();
   OutputImageType      *outputImage = this->GetOutput();
@@ -210,8 +246,6 @@ TextureFeaturesImageFilter<TInputImage, TOutputImage>
   typedef Statistics::HistogramToTextureFeaturesFilter<HistogramType> FeatureFilterType;
   typename FeatureFilterType::Pointer featureFilter = FeatureFilterType::New();
 
-  ProgressReporter progress( this, threadId, region.GetNumberOfPixels() );
-
   typedef typename NeighborhoodAlgorithm::ImageBoundaryFacesCalculator<InputImageType> FaceCalculatorType;
   FaceCalculatorType faceCalculator;
 
@@ -299,6 +333,7 @@ TextureFeaturesImageFilter<TInputImage, TOutputImage>
   os << indent << "Max: " << this->GetMax() << std::endl;
   os << indent << "NumberOfBinsPerAxis: " << this->GetNumberOfBinsPerAxis() << std::endl;
   os << indent << "Normalize: " << this->GetNormalize() << std::endl;
+  os << indent << "UseCurveOrderedTraversal: " << this->m_UseCurveOrderedTraversal << std::endl;
   }
 
 } // end namespace Statistics
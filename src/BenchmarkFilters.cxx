@@ -0,0 +1,647 @@
+#include "itkBinaryThresholdImageFilter.h"
+#include "itkConstNeighborhoodIterator.h"
+#include "itkDiReCTImageFilter.h"
+#include "itkImage.h"
+#include "itkImageRegionBrickSplitter.h"
+#include "itkImageRegionIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkImageRegionSplitter.h"
+#include "itkJensenHavrdaCharvatTsallisPointSetMetric.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkMultiLabelSTAPLEImageFilter.h"
+#include "itkMultiThreader.h"
+#include "itkN4MRIBiasFieldCorrectionImageFilter.h"
+#include "itkPointSet.h"
+#include "itkTextureFeaturesImageFilter.h"
+#include "itkTimeProbe.h"
+
+#include "vnl/vnl_math.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Benchmark of the heavy filters of the project on synthetic phantoms.
+ *
+ * The phantom is a sphere of "white matter" (label 3) inside a shell of
+ * "gray matter" (label 2) with a linear bias field and Gaussian noise.
+ * Each filter is run once for every number of threads in 1, 2, 4, ..., N
+ * and one CSV line is printed per run:
+ *
+ *   filter,dimension,size,threads,seconds,speedup,peakRSSKB
+ *
+ * where the speedup is relative to the single-threaded run and peakRSSKB
+ * is the peak resident set size of the run (0 if unavailable).  On Unix
+ * each run is done in a forked process so that its peak is not hidden by
+ * the peak of an earlier run; it includes the phantom, which is shared
+ * with the parent.
+ *
+ * NeighborhoodRaster and NeighborhoodHilbert compare the two traversals of
+ * neighborhood filters on the same box sum (see ImageRegionBrickSplitter);
+ * run them separately under "perf stat -e cache-misses" to compare the
+ * cache misses, e.g. on a 512^3 phantom.
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+unsigned long GetPeakResidentSetSize( const struct rusage & usage )
+{
+#if defined(__APPLE__)
+  // bytes on Mac OS X
+  return static_cast<unsigned long>( usage.ru_maxrss / 1024 );
+#else
+  // kilobytes on Linux
+  return static_cast<unsigned long>( usage.ru_maxrss );
+#endif
+}
+#endif
+
+template <unsigned int ImageDimension>
+class Phantom
+{
+public:
+  typedef float                                         RealType;
+  typedef itk::Image<RealType, ImageDimension>          ImageType;
+  typedef itk::Image<unsigned int, ImageDimension>      LabelImageType;
+  typedef itk::Image<unsigned char, ImageDimension>     MaskImageType;
+
+  Phantom( unsigned int size ) : m_Size( size )
+    {
+    this->m_Image = CreateImage<ImageType>();
+    this->m_Mask = CreateImage<MaskImageType>();
+    this->m_Labels = this->CreateLabelImage( 1.0 );
+
+    typedef itk::Statistics::MersenneTwisterRandomVariateGenerator GeneratorType;
+    typename GeneratorType::Pointer generator = GeneratorType::New();
+    generator->Initialize( 1234 );
+
+    itk::ImageRegionIteratorWithIndex<ImageType> It( this->m_Image,
+      this->m_Image->GetLargestPossibleRegion() );
+    for( It.GoToBegin(); !It.IsAtEnd(); ++It )
+      {
+      typename ImageType::IndexType index = It.GetIndex();
+
+      RealType intensity = 10.0;
+      switch( this->m_Labels->GetPixel( index ) )
+        {
+        case 2:
+          intensity = 100.0;
+          break;
+        case 3:
+          intensity = 150.0;
+          break;
+        default:
+          break;
+        }
+      RealType bias = 1.0 + 0.3 * static_cast<RealType>( index[0] ) /
+        static_cast<RealType>( this->m_Size );
+
+      It.Set( intensity * bias + 5.0 * generator->GetNormalVariate() );
+      this->m_Mask->SetPixel( index, 1 );
+      }
+    }
+
+  /** Label image of the phantom with the radii scaled by scale */
+  typename LabelImageType::Pointer CreateLabelImage( RealType scale ) const
+    {
+    typename LabelImageType::Pointer labels =
+      CreateImage<LabelImageType>();
+
+    RealType outerRadius = scale * 0.40 * static_cast<RealType>( this->m_Size );
+    RealType innerRadius = scale * 0.25 * static_cast<RealType>( this->m_Size );
+
+    itk::ImageRegionIteratorWithIndex<LabelImageType> It( labels,
+      labels->GetLargestPossibleRegion() );
+    for( It.GoToBegin(); !It.IsAtEnd(); ++It )
+      {
+      RealType distance2 = 0.0;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        RealType delta = static_cast<RealType>( It.GetIndex()[d] ) -
+          0.5 * static_cast<RealType>( this->m_Size - 1 );
+        distance2 += delta * delta;
+        }
+      if( distance2 <= innerRadius * innerRadius )
+        {
+        It.Set( 3 );
+        }
+      else if( distance2 <= outerRadius * outerRadius )
+        {
+        It.Set( 2 );
+        }
+      else
+        {
+        It.Set( 0 );
+        }
+      }
+    return labels;
+    }
+
+  template <class TImage>
+  typename TImage::Pointer CreateImage() const
+    {
+    typename TImage::SizeType size;
+    size.Fill( this->m_Size );
+
+    typename TImage::Pointer image = TImage::New();
+    image->SetRegions( size );
+    image->Allocate();
+    image->FillBuffer( 0 );
+    return image;
+    }
+
+  unsigned int                       m_Size;
+  typename ImageType::Pointer        m_Image;
+  typename MaskImageType::Pointer    m_Mask;
+  typename LabelImageType::Pointer   m_Labels;
+};
+
+template <unsigned int ImageDimension>
+void BenchmarkN4( const Phantom<ImageDimension> & phantom )
+{
+  typedef Phantom<ImageDimension> PhantomType;
+
+  typedef itk::N4MRIBiasFieldCorrectionImageFilter<typename PhantomType::ImageType,
+    typename PhantomType::MaskImageType, typename PhantomType::ImageType> CorrecterType;
+  typename CorrecterType::Pointer correcter = CorrecterType::New();
+  correcter->SetInput( phantom.m_Image );
+  correcter->SetMaskImage( phantom.m_Mask );
+
+  typename CorrecterType::VariableSizeArrayType maximumNumberOfIterations( 3 );
+  maximumNumberOfIterations.Fill( 20 );
+  correcter->SetMaximumNumberOfIterations( maximumNumberOfIterations );
+  correcter->SetNumberOfFittingLevels( 3 );
+  correcter->Update();
+}
+
+template <unsigned int ImageDimension>
+void BenchmarkDiReCT( const Phantom<ImageDimension> & phantom )
+{
+  typedef Phantom<ImageDimension> PhantomType;
+
+  typedef itk::DiReCTImageFilter<typename PhantomType::LabelImageType,
+    typename PhantomType::ImageType> DiReCTFilterType;
+  typedef typename DiReCTFilterType::RealImageType RealImageType;
+
+  typedef itk::BinaryThresholdImageFilter<typename PhantomType::LabelImageType,
+    RealImageType> ThresholderType;
+
+  typename ThresholderType::Pointer gm = ThresholderType::New();
+  gm->SetInput( phantom.m_Labels );
+  gm->SetLowerThreshold( 2 );
+  gm->SetUpperThreshold( 2 );
+  gm->SetInsideValue( 1 );
+  gm->SetOutsideValue( 0 );
+  gm->Update();
+
+  typename ThresholderType::Pointer wm = ThresholderType::New();
+  wm->SetInput( phantom.m_Labels );
+  wm->SetLowerThreshold( 3 );
+  wm->SetUpperThreshold( 3 );
+  wm->SetInsideValue( 1 );
+  wm->SetOutsideValue( 0 );
+  wm->Update();
+
+  typename DiReCTFilterType::Pointer direct = DiReCTFilterType::New();
+  direct->SetSegmentationImage( phantom.m_Labels );
+  direct->SetGrayMatterProbabilityImage( gm->GetOutput() );
+  direct->SetWhiteMatterProbabilityImage( wm->GetOutput() );
+  direct->SetMaximumNumberOfIterations( 10 );
+  direct->Update();
+}
+
+template <unsigned int ImageDimension>
+void BenchmarkSTAPLE( const Phantom<ImageDimension> & phantom )
+{
+  typedef Phantom<ImageDimension> PhantomType;
+
+  typedef itk::MultiLabelSTAPLEImageFilter<typename PhantomType::LabelImageType,
+    typename PhantomType::LabelImageType> FilterType;
+  typename FilterType::Pointer filter = FilterType::New();
+
+  filter->SetInput( 0, phantom.CreateLabelImage( 0.95 ) );
+  filter->SetInput( 1, phantom.m_Labels );
+  filter->SetInput( 2, phantom.CreateLabelImage( 1.05 ) );
+  filter->Update();
+}
+
+template <unsigned int ImageDimension>
+void BenchmarkTextureFeatures( const Phantom<ImageDimension> & phantom )
+{
+  typedef Phantom<ImageDimension> PhantomType;
+
+  typedef itk::Statistics::TextureFeaturesImageFilter
+    <typename PhantomType::ImageType> TextureFilterType;
+  typename TextureFilterType::Pointer textureFilter = TextureFilterType::New();
+  textureFilter->SetInput( phantom.m_Image );
+
+  typename TextureFilterType::RadiusType radius;
+  radius.Fill( 2 );
+  textureFilter->SetNeighborhoodRadius( radius );
+  textureFilter->SetNumberOfBinsPerAxis( 64 );
+  textureFilter->SetPixelValueMinMax( 0, 250 );
+  textureFilter->Update();
+}
+
+template <unsigned int ImageDimension>
+void BenchmarkPointSetMetric( const Phantom<ImageDimension> & phantom )
+{
+  typedef Phantom<ImageDimension> PhantomType;
+
+  typedef itk::PointSet<long, ImageDimension> PointSetType;
+
+  // The fixed points are the gray matter voxels of the phantom and the
+  // moving points the ones of a slightly larger phantom
+  typename PointSetType::Pointer fixedPoints = PointSetType::New();
+  fixedPoints->Initialize();
+  typename PointSetType::Pointer movingPoints = PointSetType::New();
+  movingPoints->Initialize();
+
+  typename PhantomType::LabelImageType::Pointer movingLabels =
+    phantom.CreateLabelImage( 1.05 );
+
+  // Subsample to keep the number of points reasonable in 3-D
+  const unsigned int stride = ( ImageDimension == 2 ) ? 1 : 4;
+
+  unsigned long fixedCount = 0;
+  unsigned long movingCount = 0;
+  unsigned long n = 0;
+
+  itk::ImageRegionIteratorWithIndex<typename PhantomType::LabelImageType> It(
+    phantom.m_Labels, phantom.m_Labels->GetLargestPossibleRegion() );
+  for( It.GoToBegin(); !It.IsAtEnd(); ++It, ++n )
+    {
+    if( n % stride != 0 )
+      {
+      continue;
+      }
+    typename PointSetType::PointType point;
+    phantom.m_Labels->TransformIndexToPhysicalPoint( It.GetIndex(), point );
+    if( It.Get() == 2 )
+      {
+      fixedPoints->SetPoint( fixedCount++, point );
+      }
+    if( movingLabels->GetPixel( It.GetIndex() ) == 2 )
+      {
+      movingPoints->SetPoint( movingCount++, point );
+      }
+    }
+
+  typedef itk::JensenHavrdaCharvatTsallisPointSetMetric<PointSetType> MetricType;
+  typename MetricType::Pointer metric = MetricType::New();
+  metric->SetFixedPointSet( fixedPoints );
+  metric->SetMovingPointSet( movingPoints );
+  metric->SetFixedPointSetSigma( 1.0 );
+  metric->SetMovingPointSetSigma( 1.0 );
+  metric->SetFixedEvaluationKNeighborhood( 50 );
+  metric->SetMovingEvaluationKNeighborhood( 50 );
+  metric->SetUseRegularizationTerm( true );
+  metric->SetUseInputAsSamples( true );
+  metric->SetAlpha( 1.0 );
+  metric->SetUseAnisotropicCovariances( false );
+  metric->Initialize();
+
+  typename MetricType::DefaultTransformType::ParametersType parameters;
+  parameters.Fill( 0 );
+
+  typename MetricType::MeasureType value;
+  typename MetricType::DerivativeType derivative;
+  metric->GetValueAndDerivative( parameters, value, derivative );
+}
+
+/** Sum of a box of radius 4 at each pixel, the threads taking either
+ * slabs in raster order or segments of the Hilbert curve of bricks. */
+template <class TImage>
+class NeighborhoodSum
+{
+public:
+  typedef typename TImage::RegionType                       RegionType;
+  typedef itk::ImageRegionBrickSplitter<TImage::ImageDimension> SplitterType;
+
+  NeighborhoodSum( const TImage *input, bool useCurve )
+    : m_Input( input )
+    {
+    this->m_Output = TImage::New();
+    this->m_Output->CopyInformation( input );
+    this->m_Output->SetRegions( input->GetLargestPossibleRegion() );
+    this->m_Output->Allocate();
+
+    if( useCurve )
+      {
+      this->m_Splitter = SplitterType::New();
+      this->m_Splitter->SetRegion( input->GetLargestPossibleRegion() );
+      this->m_Splitter->Initialize();
+      }
+    }
+
+  void Run()
+    {
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    threader->SetSingleMethod( ThreaderCallback, this );
+    threader->SingleMethodExecute();
+    }
+
+private:
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback( void *arg )
+    {
+    unsigned int threadId = ( (itk::MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+    unsigned int numberOfThreads = ( (itk::MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+    NeighborhoodSum *self = (NeighborhoodSum *)( ( (itk::MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+    const RegionType region = self->m_Input->GetLargestPossibleRegion();
+    if( self->m_Splitter )
+      {
+      unsigned long first, last;
+      self->m_Splitter->GetSegment( threadId, numberOfThreads, first, last );
+      for( unsigned long b = first; b < last; b++ )
+        {
+        self->Sum( self->m_Splitter->GetBrick( b ) );
+        }
+      }
+    else
+      {
+      typedef itk::ImageRegionSplitter<TImage::ImageDimension> RegionSplitterType;
+      typename RegionSplitterType::Pointer splitter = RegionSplitterType::New();
+      if( threadId < splitter->GetNumberOfSplits( region, numberOfThreads ) )
+        {
+        self->Sum( splitter->GetSplit( threadId, numberOfThreads, region ) );
+        }
+      }
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+  void Sum( const RegionType &region )
+    {
+    typename itk::ConstNeighborhoodIterator<TImage>::RadiusType radius;
+    radius.Fill( 4 );
+
+    itk::ConstNeighborhoodIterator<TImage> It( radius, this->m_Input, region );
+    itk::ImageRegionIterator<TImage> ItO( this->m_Output, region );
+    for( It.GoToBegin(), ItO.GoToBegin(); !It.IsAtEnd(); ++It, ++ItO )
+      {
+      typename TImage::PixelType sum = 0;
+      for( unsigned int n = 0; n < It.Size(); n++ )
+        {
+        sum += It.GetPixel( n );
+        }
+      ItO.Set( sum );
+      }
+    }
+
+  const TImage                         *m_Input;
+  typename TImage::Pointer             m_Output;
+  typename SplitterType::Pointer       m_Splitter;
+};
+
+template <unsigned int ImageDimension>
+void BenchmarkNeighborhoodRaster( const Phantom<ImageDimension> & phantom )
+{
+  NeighborhoodSum<typename Phantom<ImageDimension>::ImageType> sum(
+    phantom.m_Image, false );
+  sum.Run();
+}
+
+template <unsigned int ImageDimension>
+void BenchmarkNeighborhoodHilbert( const Phantom<ImageDimension> & phantom )
+{
+  NeighborhoodSum<typename Phantom<ImageDimension>::ImageType> sum(
+    phantom.m_Image, true );
+  sum.Run();
+}
+
+/** Time one run of a benchmark and measure its peak resident set size.
+ * Returns false if the filter threw. */
+template <unsigned int ImageDimension>
+bool RunBenchmark( void (*function)( const Phantom<ImageDimension> & ),
+  const Phantom<ImageDimension> & phantom, const std::string & name,
+  double & seconds, unsigned long & peakResidentSetSize )
+{
+  seconds = 0.0;
+  peakResidentSetSize = 0;
+
+#if defined(__unix__) || defined(__APPLE__)
+  // The child reports the time through a pipe and the parent gets the peak
+  // of the child alone from wait4().
+  int fd[2];
+  pid_t pid = -1;
+  if( pipe( fd ) == 0 )
+    {
+    std::cout.flush();
+    std::cerr.flush();
+    pid = fork();
+    if( pid < 0 )
+      {
+      close( fd[0] );
+      close( fd[1] );
+      }
+    }
+  if( pid == 0 )
+    {
+    close( fd[0] );
+    double childSeconds = -1.0;
+    itk::TimeProbe timer;
+    timer.Start();
+    try
+      {
+      ( *function )( phantom );
+      timer.Stop();
+      childSeconds = timer.GetMean();
+      }
+    catch( itk::ExceptionObject & err )
+      {
+      std::cerr << name << ": " << err << std::endl;
+      }
+    catch( std::exception & err )
+      {
+      std::cerr << name << ": " << err.what() << std::endl;
+      }
+    ssize_t written = write( fd[1], &childSeconds, sizeof( childSeconds ) );
+    close( fd[1] );
+    _exit( ( written == sizeof( childSeconds ) && childSeconds >= 0.0 )
+      ? EXIT_SUCCESS : EXIT_FAILURE );
+    }
+  if( pid > 0 )
+    {
+    close( fd[1] );
+    double childSeconds = -1.0;
+    if( read( fd[0], &childSeconds, sizeof( childSeconds ) )
+      != sizeof( childSeconds ) )
+      {
+      childSeconds = -1.0;
+      }
+    close( fd[0] );
+
+    int status = 0;
+    struct rusage usage;
+    if( wait4( pid, &status, 0, &usage ) == pid )
+      {
+      peakResidentSetSize = GetPeakResidentSetSize( usage );
+      }
+    if( !WIFEXITED( status ) )
+      {
+      std::cerr << name << ": the benchmark process was terminated."
+        << std::endl;
+      return false;
+      }
+    if( childSeconds < 0.0 )
+      {
+      return false;
+      }
+    seconds = childSeconds;
+    return true;
+    }
+#endif
+
+  // No fork available: run in this process, without the peak.
+  itk::TimeProbe timer;
+  timer.Start();
+  try
+    {
+    ( *function )( phantom );
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << name << ": " << err << std::endl;
+    return false;
+    }
+  catch( std::exception & err )
+    {
+    std::cerr << name << ": " << err.what() << std::endl;
+    return false;
+    }
+  timer.Stop();
+  seconds = timer.GetMean();
+  return true;
+}
+
+template <unsigned int ImageDimension>
+int BenchmarkFilters( int argc, char *argv[] )
+{
+  unsigned int size = ( ImageDimension == 2 ) ? 256 : 64;
+  if( argc > 2 )
+    {
+    size = static_cast<unsigned int>( atoi( argv[2] ) );
+    }
+
+  unsigned int maximumNumberOfThreads =
+    itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  if( argc > 3 )
+    {
+    maximumNumberOfThreads = static_cast<unsigned int>( atoi( argv[3] ) );
+    }
+
+  std::string which( "all" );
+  if( argc > 4 )
+    {
+    which = std::string( argv[4] );
+    }
+
+  std::ofstream file;
+  if( argc > 5 )
+    {
+    file.open( argv[5] );
+    }
+  std::ostream & os = ( file.is_open() ) ? file : std::cout;
+
+  typedef void (*BenchmarkFunctionType)( const Phantom<ImageDimension> & );
+
+  std::vector<std::string> names;
+  std::vector<BenchmarkFunctionType> functions;
+
+  names.push_back( "N4" );
+  functions.push_back( &BenchmarkN4<ImageDimension> );
+  names.push_back( "DiReCT" );
+  functions.push_back( &BenchmarkDiReCT<ImageDimension> );
+  names.push_back( "STAPLE" );
+  functions.push_back( &BenchmarkSTAPLE<ImageDimension> );
+  names.push_back( "TextureFeatures" );
+  functions.push_back( &BenchmarkTextureFeatures<ImageDimension> );
+  names.push_back( "JHCTPointSetMetric" );
+  functions.push_back( &BenchmarkPointSetMetric<ImageDimension> );
+  names.push_back( "NeighborhoodRaster" );
+  functions.push_back( &BenchmarkNeighborhoodRaster<ImageDimension> );
+  names.push_back( "NeighborhoodHilbert" );
+  functions.push_back( &BenchmarkNeighborhoodHilbert<ImageDimension> );
+
+  // Thread counts 1, 2, 4, ... always ending with the maximum
+  std::vector<unsigned int> numberOfThreads;
+  for( unsigned int threads = 1; threads < maximumNumberOfThreads; threads *= 2 )
+    {
+    numberOfThreads.push_back( threads );
+    }
+  numberOfThreads.push_back( vnl_math_max( maximumNumberOfThreads, 1u ) );
+
+  Phantom<ImageDimension> phantom( size );
+
+  os << "filter,dimension,size,threads,seconds,speedup,peakRSSKB" << std::endl;
+
+  for( unsigned int f = 0; f < functions.size(); f++ )
+    {
+    if( which != "all" && which.find( names[f] ) == std::string::npos )
+      {
+      continue;
+      }
+
+    double singleThreadTime = 0.0;
+    for( unsigned int t = 0; t < numberOfThreads.size(); t++ )
+      {
+      const unsigned int threads = numberOfThreads[t];
+      itk::MultiThreader::SetGlobalDefaultNumberOfThreads( threads );
+
+      os.flush();
+
+      double seconds;
+      unsigned long peakResidentSetSize;
+      if( !RunBenchmark<ImageDimension>( functions[f], phantom, names[f],
+        seconds, peakResidentSetSize ) )
+        {
+        break;
+        }
+
+      if( threads == 1 )
+        {
+        singleThreadTime = seconds;
+        }
+
+      os << names[f] << "," << ImageDimension << "," << size << ","
+         << threads << "," << seconds << ","
+         << ( ( seconds > 0.0 ) ? singleThreadTime / seconds : 0.0 ) << ","
+         << peakResidentSetSize << std::endl;
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char *argv[] )
+{
+  if ( argc < 2 )
+    {
+    std::cout << "Usage: " << argv[0] << " imageDimension [size] "
+      << "[maximumNumberOfThreads] [filters=all|N4,DiReCT,STAPLE,TextureFeatures,JHCTPointSetMetric,"
+      << "NeighborhoodRaster,NeighborhoodHilbert] "
+      << "[outputCSVFile]" << std::endl;
+    exit( 1 );
+    }
+
+  switch( atoi( argv[1] ) )
+   {
+   case 2:
+     BenchmarkFilters<2>( argc, argv );
+     break;
+   case 3:
+     BenchmarkFilters<3>( argc, argv );
+     break;
+   default:
+      std::cerr << "Unsupported dimension" << std::endl;
+      exit( EXIT_FAILURE );
+   }
+}
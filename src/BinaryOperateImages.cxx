@@ -1,7 +1,5 @@
 #include "itkImage.h"
 #include "itkImageFileReader.h"
-#include "itkImageRegionIterator.h"
-#include "itkNeighborhoodIterator.h"
 #include "itkImageFileWriter.h"
 
 #include <string>
@@ -9,6 +7,7 @@
 #include <sstream>
 
 #include "Common.h"
+#include "ImageOperations.h"
 
 typedef float RealType;
 
@@ -35,163 +34,18 @@ int BinaryOperateImages( int argc, char * argv[] )
     reader3->Update();
     }
 
-  typename ImageType::Pointer output = ImageType::New();
-  output->SetOrigin( reader1->GetOutput()->GetOrigin() );
-  output->SetSpacing( reader1->GetOutput()->GetSpacing() );
-  output->SetRegions( reader1->GetOutput()->GetLargestPossibleRegion() );
-  output->SetDirection( reader1->GetOutput()->GetDirection() );
-  output->Allocate();
-  output->FillBuffer( 0 );
-
   std::string op = std::string( argv[3] );
 
-  typename ImageType::SizeType radius;
-  radius.Fill( 1 );
-
-  PixelType delta = -1.0;
-
-  itk::NeighborhoodIterator<ImageType> It( radius, output,
-    output->GetLargestPossibleRegion() );
-  itk::NeighborhoodIterator<ImageType> It1( radius, reader1->GetOutput(),
-    reader1->GetOutput()->GetLargestPossibleRegion() );
-  itk::NeighborhoodIterator<ImageType> It2( radius, reader2->GetOutput(),
-    reader2->GetOutput()->GetLargestPossibleRegion() );
-  itk::NeighborhoodIterator<ImageType> It3( radius, reader3->GetOutput(),
-    reader3->GetOutput()->GetLargestPossibleRegion() );
-
-  for( It.GoToBegin(), It1.GoToBegin(), It2.GoToBegin();
-    !It.IsAtEnd(); ++It, ++It1, ++It2 )
+  typename ImageType::Pointer output = NULL;
+  try
     {
-    if( op.compare( "+" ) == 0 )
-      {
-      It.SetCenterPixel( It1.GetCenterPixel() + It2.GetCenterPixel() );
-      }
-    else if( op.compare( "-" ) == 0 )
-      {
-      It.SetCenterPixel( It1.GetCenterPixel() - It2.GetCenterPixel() );
-      }
-    else if( op.compare( "x" ) == 0 )
-      {
-      It.SetCenterPixel( It1.GetCenterPixel() * It2.GetCenterPixel() );
-      }
-    else if( op.compare( "/" ) == 0 )
-      {
-      It.SetCenterPixel( It1.GetCenterPixel() / It2.GetCenterPixel() );
-      }
-    else if( op.compare( "or" ) == 0 )
-      {
-      if( static_cast<bool>( It1.GetCenterPixel() ) ||
-        static_cast<bool>( It2.GetCenterPixel() ) )
-        {
-        It.SetCenterPixel( itk::NumericTraits<PixelType>::One );
-        }
-      else
-        {
-        It.SetCenterPixel( itk::NumericTraits<PixelType>::Zero );
-        }
-      }
-    else if( op.compare( "xor" ) == 0 )
-      {
-      if( ( static_cast<bool>( It1.GetCenterPixel() ) ||
-        static_cast<bool>( It2.GetCenterPixel() ) ) &&
-        ( static_cast<bool>( It1.GetCenterPixel() ) !=
-        static_cast<bool>( It2.GetCenterPixel() ) ) )
-        {
-        It.SetCenterPixel( itk::NumericTraits<PixelType>::One );
-        }
-      else
-        {
-        It.SetCenterPixel( itk::NumericTraits<PixelType>::Zero );
-        }
-      }
-    else if( op.compare( "and" ) == 0 )
-      {
-      if( static_cast<bool>( It1.GetCenterPixel() ) &&
-        static_cast<bool>( It2.GetCenterPixel() ) )
-        {
-        It.SetCenterPixel( itk::NumericTraits<PixelType>::One );
-        }
-      else
-        {
-        It.SetCenterPixel( itk::NumericTraits<PixelType>::Zero );
-        }
-      }
-    else if( op.compare( "max" ) == 0 )
-      {
-      It.SetCenterPixel( vnl_math_max( It1.GetCenterPixel(), It2.GetCenterPixel() ) );
-      }
-    else if( op.compare( "replace" ) == 0 )
-      {
-      if( It2.GetCenterPixel() == 0 )
-        {
-        It.SetCenterPixel( It1.GetCenterPixel() );
-        }
-      else
-        {
-        It.SetCenterPixel( It2.GetCenterPixel() );
-        }
-      }
-    else if( op.compare( "isgreaterthan" ) == 0 )
-      {
-      It.SetCenterPixel( ( It1.GetCenterPixel() > It2.GetCenterPixel() ) ? 1 : 0 );
-      }
-    else if( op.compare( "islessthan" ) == 0 )
-      {
-      It.SetCenterPixel( ( It1.GetCenterPixel() < It2.GetCenterPixel() ) ? 1 : 0 );
-      }
-    else if( op.compare( "min" ) == 0 )
-      {
-      It.SetCenterPixel( vnl_math_min( It1.GetCenterPixel(), It2.GetCenterPixel() ) );
-      }
-    else if( op.compare( "zscore" ) == 0 )
-      {
-      if( reader3->GetOutput() == NULL )
-        {
-        std::cerr << "Need to specify third image." << std::endl;
-        return EXIT_FAILURE;
-        }
-
-      RealType mean = It1.GetCenterPixel();
-      RealType std = vcl_sqrt( It2.GetCenterPixel() );
-      RealType pixel = reader3->GetOutput()->GetPixel( It1.GetIndex() );
-      if( std > 0 )
-        {
-        It.SetCenterPixel( ( pixel - mean ) / std );
-        }
-      }
-    else if( op.compare( "misc" ) == 0 )
-      {
-      if( It1.GetCenterPixel() == 0 )
-        {
-        continue;
-        }
-
-      bool isSurroundedIn2 = true;
-      bool isIsolated = true;
-
-      for( unsigned int n = 0; n < It1.GetNeighborhood().Size(); n++ )
-        {
-        isSurroundedIn2 = isSurroundedIn2 && static_cast<bool>( It2.GetPixel( n ) );
-        if( n == static_cast<unsigned int>( 0.5 * It1.Size() ) )
-          {
-          continue;
-          }
-        if( It1.GetPixel( n ) != 0 )
-          {
-          isIsolated = false;
-          break;
-          }
-        }
-      if( isIsolated /*&& isSurroundedIn2*/ )
-        {
-        It.SetCenterPixel( It1.GetCenterPixel() );
-        }
-      }
-    else
-      {
-      std::cerr << "Error: Unknown operation." << std::endl;
-      return EXIT_FAILURE;
-      }
+    output = BinaryOperateImagesOperation<ImageType>( reader1->GetOutput(),
+      op, reader2->GetOutput(), ( argc > 6 ) ? reader3->GetOutput() : NULL );
+    }
+  catch( itk::ExceptionObject &e )
+    {
+    std::cerr << "Error: " << e.GetDescription() << std::endl;
+    return EXIT_FAILURE;
     }
 
   typedef itk::ImageFileWriter<ImageType> WriterType;
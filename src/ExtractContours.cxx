@@ -2,7 +2,10 @@
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 #include "itkLabelContourImageFilter.h"
+#include "itkLabeledPointSetFileWriter.h"
+#include "itkMesh.h"
 #include "itkSliceBySliceImageFilter.h"
+#include "itkSliceStackContourExtractor.h"
 
 template <unsigned int ImageDimension>
 int ExtractContours( int argc, char *argv[] )
@@ -89,12 +92,87 @@ int ExtractContoursSliceBySlice( int argc, char *argv[] )
   return 0;
 }
 
+int ExtractContoursSliceStack( int argc, char *argv[] )
+{
+  const unsigned int ImageDimension = 3;
+  typedef float PixelType;
+  typedef itk::Image<PixelType, ImageDimension> ImageType;
+
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( argv[2] );
+  reader->Update();
+
+  typedef itk::SliceStackContourExtractor<ImageType> ExtractorType;
+  ExtractorType::Pointer extractor = ExtractorType::New();
+  extractor->SetInput( reader->GetOutput() );
+  extractor->SetContourValue( 0.5 );
+  if( argc > 4 )
+    {
+    extractor->SetContourValue( atof( argv[4] ) );
+    }
+  if( argc > 5 )
+    {
+    extractor->SetSliceDimension( atoi( argv[5] ) );
+    }
+  extractor->Update();
+
+  /**
+   * One polyline per contour, the points being labeled by their slice.
+   */
+  typedef itk::Mesh<PixelType, ImageDimension> MeshType;
+  MeshType::Pointer mesh = MeshType::New();
+  mesh->Initialize();
+
+  const ExtractorType::VertexContainerType &vertices
+    = extractor->GetVertices();
+  const ExtractorType::OffsetContainerType &offsets
+    = extractor->GetContourOffsets();
+
+  typedef itk::LabeledPointSetFileWriter<MeshType> WriterType;
+  WriterType::LineSetType::Pointer lines = WriterType::LineSetType::New();
+  lines->Initialize();
+  lines->Reserve( extractor->GetNumberOfContours() );
+
+  for( unsigned long n = 0; n < extractor->GetNumberOfContours(); n++ )
+    {
+    WriterType::LineType line( offsets[n+1] - offsets[n] );
+    for( unsigned long i = offsets[n]; i < offsets[n+1]; i++ )
+      {
+      MeshType::PointType point;
+      point.CastFrom( vertices[i] );
+      mesh->SetPoint( i, point );
+      mesh->SetPointData( i, static_cast<PixelType>(
+        extractor->GetContourSlices()[n] ) );
+      line[i - offsets[n]] = i;
+      }
+    lines->InsertElement( n, line );
+    }
+
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName( argv[3] );
+  writer->SetInput( mesh );
+  writer->SetLines( lines );
+  if( argc > 6 )
+    {
+    writer->SetUseBinaryFormat( static_cast<bool>( atoi( argv[6] ) ) );
+    }
+  writer->Update();
+
+  return 0;
+}
+
 int main( int argc, char *argv[] )
 {
   if ( argc < 4 )
     {
     std::cout << argv[0] << " imageDimension inputImage outputImage"
       << " [fullyConnected] " << std::endl;
+    std::cout << "  or: " << argv[0] << " X inputImage outputImage"
+      << " [fullyConnected] " << std::endl;
+    std::cout << "  or: " << argv[0] << " P inputImage outputContours.vtk"
+      << " [contourValue=0.5] [sliceDimension=2] [useBinaryFormat=0] "
+      << std::endl;
     exit( 1 );
     }
 
@@ -102,6 +180,10 @@ int main( int argc, char *argv[] )
     {
     ExtractContoursSliceBySlice( argc, argv );
     }
+  else if( *argv[1] == 'P' )
+    {
+    ExtractContoursSliceStack( argc, argv );
+    }
   else
     {
     switch( atoi( argv[1] ) )
@@ -0,0 +1,194 @@
+#include <stdio.h>
+
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+#include "itkRunLengthFeaturesImageFilter.h"
+#include "itkVectorIndexSelectionCastImageFilter.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+template<class TValue>
+TValue Convert( std::string optionString )
+{
+  TValue value;
+  std::istringstream iss( optionString );
+  iss >> value;
+  return value;
+}
+
+template<class TValue>
+std::vector<TValue> ConvertVector( std::string optionString )
+{
+  std::vector<TValue> values;
+  std::string::size_type crosspos = optionString.find( 'x', 0 );
+
+  if ( crosspos == std::string::npos )
+    {
+    values.push_back( Convert<TValue>( optionString ) );
+    }
+  else
+    {
+    std::string element = optionString.substr( 0, crosspos ) ;
+    TValue value;
+    std::istringstream iss( element );
+    iss >> value;
+    values.push_back( value );
+    while ( crosspos != std::string::npos )
+      {
+      std::string::size_type crossposfrom = crosspos;
+      crosspos = optionString.find( 'x', crossposfrom + 1 );
+      if ( crosspos == std::string::npos )
+        {
+        element = optionString.substr( crossposfrom + 1, optionString.length() );
+        }
+      else
+        {
+        element = optionString.substr( crossposfrom + 1, crosspos ) ;
+        }
+      std::istringstream iss2( element );
+      iss2 >> value;
+      values.push_back( value );
+      }
+    }
+  return values;
+}
+
+template <unsigned int ImageDimension>
+int GenerateRunLengthImage( int argc, char *argv[] )
+{
+  typedef float PixelType;
+
+  typedef itk::Image<PixelType, ImageDimension> ImageType;
+
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  typename ReaderType::Pointer imageReader = ReaderType::New();
+  imageReader->SetFileName( argv[2] );
+  imageReader->Update();
+
+  typedef itk::Statistics::RunLengthFeaturesImageFilter<ImageType> RunLengthFilterType;
+  typename RunLengthFilterType::Pointer runLengthFilter = RunLengthFilterType::New();
+  runLengthFilter->SetInput( imageReader->GetOutput() );
+
+  typedef typename RunLengthFilterType::MaskImageType MaskImageType;
+  typename MaskImageType::Pointer mask = NULL;
+  if( argc > 5 )
+    {
+    typedef itk::ImageFileReader<MaskImageType> MaskReaderType;
+    typename MaskReaderType::Pointer labelImageReader = MaskReaderType::New();
+    labelImageReader->SetFileName( argv[5] );
+    labelImageReader->Update();
+
+    mask = labelImageReader->GetOutput();
+    runLengthFilter->SetMaskImage( mask );
+    }
+
+  typename RunLengthFilterType::RadiusType radius;
+  radius.Fill( 10 );
+  if( argc > 6 )
+    {
+    std::vector<unsigned int> rad = ConvertVector<unsigned int>( std::string( argv[6] ) );
+    if( rad.size() != ImageDimension )
+      {
+      radius.Fill( rad[0] );
+      }
+    else
+      {
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        radius[d] = rad[d];
+        }
+      }
+    }
+  runLengthFilter->SetNeighborhoodRadius( radius );
+
+  unsigned int numberOfBins = 64;
+  if ( argc > 7 )
+    {
+    numberOfBins = static_cast<unsigned int>( atoi( argv[7] ) );
+    }
+  runLengthFilter->SetNumberOfBinsPerAxis( numberOfBins );
+
+  itk::ImageRegionIteratorWithIndex<ImageType> ItI( imageReader->GetOutput(),
+    imageReader->GetOutput()->GetLargestPossibleRegion() );
+
+  PixelType maxValue = itk::NumericTraits<PixelType>::NonpositiveMin();
+  PixelType minValue = itk::NumericTraits<PixelType>::max();
+
+  for( ItI.GoToBegin(); !ItI.IsAtEnd(); ++ItI )
+    {
+    if ( !mask || ( mask->GetPixel( ItI.GetIndex() ) == runLengthFilter->GetInsidePixelValue() ) )
+      {
+      if ( ItI.Get() < minValue )
+        {
+        minValue = ItI.Get();
+        }
+      if ( ItI.Get() > maxValue )
+        {
+        maxValue = ItI.Get();
+        }
+      }
+    }
+  runLengthFilter->SetPixelValueMinMax( minValue, maxValue );
+
+  int operation = atoi( argv[3] );
+  if( operation < 0 ||
+    operation >= static_cast<int>( runLengthFilter->GetNumberOfOutputComponents() ) )
+    {
+    std::cerr << "Unrecognized option: " << operation << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  typedef typename RunLengthFilterType::OutputImageType VectorImageType;
+
+  typedef itk::VectorIndexSelectionCastImageFilter<VectorImageType, ImageType> IndexSelectionType;
+  typename IndexSelectionType::Pointer indexSelectionFilter = IndexSelectionType::New();
+  indexSelectionFilter->SetInput( runLengthFilter->GetOutput() );
+  indexSelectionFilter->SetIndex( operation );
+  indexSelectionFilter->Update();
+
+  typedef itk::ImageFileWriter<ImageType> WriterType;
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName( argv[4] );
+  writer->SetInput( indexSelectionFilter->GetOutput() );
+  writer->Update();
+
+  return 0;
+}
+
+
+int main( int argc, char *argv[] )
+{
+  if ( argc < 5 )
+    {
+    std::cerr << "Usage: " << argv[0] << " imageDimension inputImage operation "
+     << "outputImage [maskImage] [neighborhoodRadius=10] [numberOfBinsPerAxis=64]" << std::endl;
+    std::cerr << "operation:  " << std::endl;
+    std::cerr << "   0. short run emphasis " << std::endl;
+    std::cerr << "   1. long run emphasis " << std::endl;
+    std::cerr << "   2. grey level nonuniformity " << std::endl;
+    std::cerr << "   3. run length nonuniformity " << std::endl;
+    std::cerr << "   4. low grey level run emphasis " << std::endl;
+    std::cerr << "   5. high grey level run emphasis " << std::endl;
+    std::cerr << "   6. short run low grey level emphasis " << std::endl;
+    std::cerr << "   7. short run high grey level emphasis " << std::endl;
+    std::cerr << "   8. long run low grey level emphasis " << std::endl;
+    std::cerr << "   9. long run high grey level emphasis " << std::endl;
+    exit( 1 );
+    }
+
+  switch( atoi( argv[1] ) )
+   {
+   case 2:
+     return GenerateRunLengthImage<2>( argc, argv );
+   case 3:
+     return GenerateRunLengthImage<3>( argc, argv );
+   default:
+      std::cerr << "Unsupported dimension" << std::endl;
+      exit( EXIT_FAILURE );
+   }
+}
@@ -1,8 +1,8 @@
 #include "itkDecomposeTensorFunction.h"
 #include "itkImageFileReader.h"
-#include "itkImageRegionIteratorWithIndex.h"
 #include "itkPoint.h"
 #include "itkMatrix.h"
+#include "itkThinPlateSplineDeformationFieldSource.h"
 #include "itkVariableSizeMatrix.h"
 #include "itkVector.h"
 #include "itkVectorContainer.h"
@@ -67,26 +67,6 @@ int GenerateTPSDeformationField( unsigned int argc, char *argv[] )
     }
   tpsDeform.close();
 
-  // Join tps and affine parameters into single matrix
-  typedef itk::VariableSizeMatrix<RealType> MatrixType;
-  MatrixType params;
-  params.SetSize( ImageDimension + 1 + C->Size(), ImageDimension );
-  for( unsigned int n = 0; n < ImageDimension + 1; n++ )
-    {
-    for( unsigned int d = 0; d < ImageDimension; d++ )
-      {
-      params( n, d ) = A( n, d );
-      }
-    }
-  for( unsigned int n = ImageDimension + 1; n < params.Rows(); n++ )
-    {
-    for( unsigned int d = 0; d < ImageDimension; d++ )
-      {
-      VectorType V = C->GetElement( n - ImageDimension - 1 );
-      params( n, d ) = V[d];
-      }
-    }
-
   // Read in control points
 
   std::ifstream cpFile( argv[3] );
@@ -115,6 +95,7 @@ int GenerateTPSDeformationField( unsigned int argc, char *argv[] )
     }
   cpFile.close();
 
+  typedef itk::VariableSizeMatrix<RealType> MatrixType;
   MatrixType Pn;
   Pn.SetSize( L->Size(), ImageDimension + 1 );
   Pn.Fill( 1 );
@@ -137,74 +118,78 @@ int GenerateTPSDeformationField( unsigned int argc, char *argv[] )
   vnl_matrix<RealType> PP = ( Q.GetVnlMatrix() ).extract(
     L->Size(), L->Size() - ImageDimension - 1, 0, ImageDimension + 1 );
 
-  // Read in image
-  typedef itk::Image<RealType, ImageDimension> ImageType;
-  typedef itk::ImageFileReader<ImageType> ReaderType;
-  typename ReaderType::Pointer reader = ReaderType::New();
-  reader->SetFileName( argv[2] );
-  reader->Update();
+  if( C->Size() != PP.cols() )
+    {
+    std::cerr << "Expected " << PP.cols() << " tps coefficients but read "
+      << C->Size() << "." << std::endl;
+    return EXIT_FAILURE;
+    }
 
+  // The kernel weight of each control point is the projection of the tps
+  // coefficients (given in the null space of the affine constraints).
   typedef itk::Image<VectorType, ImageDimension> VectorImageType;
-  typename VectorImageType::Pointer output = VectorImageType::New();
-  output->SetOrigin( reader->GetOutput()->GetOrigin() );
-  output->SetSpacing( reader->GetOutput()->GetSpacing() );
-  output->SetRegions( reader->GetOutput()->GetLargestPossibleRegion().GetSize() );
-  output->SetDirection( reader->GetOutput()->GetDirection() );
-  output->Allocate();
-
-  itk::ImageRegionIteratorWithIndex<ImageType> ItR( reader->GetOutput(),
-    reader->GetOutput()->GetLargestPossibleRegion() );
-  itk::ImageRegionIteratorWithIndex<VectorImageType> ItV( output,
-    output->GetLargestPossibleRegion() );
-  for( ItR.GoToBegin(), ItV.GoToBegin(); !ItR.IsAtEnd(); ++ItR, ++ItV )
+  typedef itk::ThinPlateSplineDeformationFieldSource<VectorImageType>
+    TPSSourceType;
+  typename TPSSourceType::Pointer tpsSource = TPSSourceType::New();
+
+  typename TPSSourceType::LandmarkContainerType::Pointer landmarks
+    = TPSSourceType::LandmarkContainerType::New();
+  typename TPSSourceType::WeightContainerType::Pointer weights
+    = TPSSourceType::WeightContainerType::New();
+  landmarks->Initialize();
+  weights->Initialize();
+  for( unsigned int n = 0; n < L->Size(); n++ )
     {
-    PointType point;
-    output->TransformIndexToPhysicalPoint( ItV.GetIndex(), point );
-
-    vnl_matrix<RealType> U;
-    U.set_size( 1, L->Size() );
-    U.fill( 0 );
-    for( unsigned int n = 0; n < U.cols(); n++ )
+    typename TPSSourceType::PointType landmark;
+    typename TPSSourceType::VectorType weight;
+    weight.Fill( 0.0 );
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      landmark[d] = Pn( n, d + 1 );
+      }
+    for( unsigned int m = 0; m < PP.cols(); m++ )
       {
-      RealType r = 0;
+      VectorType coeff = C->GetElement( m );
       for( unsigned int d = 0; d < ImageDimension; d++ )
         {
-        r += vnl_math_sqr( Pn(n, d+1) - point[d] );
-        }
-      r = vcl_sqrt( r );
-      if( r > 0 )
-        {
-        if( ImageDimension == 2 )
-          {
-          U(0, n) = r * r * vcl_log( r );
-
-          }
-        else
-          {
-          U(0, n) = -r;
-          }
+        weight[d] += PP( n, m ) * coeff[d];
         }
       }
-    vnl_matrix<RealType> basis;
-    basis.set_size( 1, L->Size() );
-    basis(0, 0) = 1;
-    for( unsigned int d = 0; d < ImageDimension; d++ )
-      {
-      basis(0, 1 + d) = point[d];
-      }
-
-    basis.update( U * PP, static_cast<unsigned int>( 0 ), ImageDimension+1 );
-
-    vnl_matrix<RealType> warpedPoint = basis * params.GetVnlMatrix();
+    landmarks->InsertElement( n, landmark );
+    weights->InsertElement( n, weight );
+    }
 
-    VectorType V;
+  typename TPSSourceType::AffineMatrixType affineMatrix;
+  for( unsigned int n = 0; n < ImageDimension + 1; n++ )
+    {
     for( unsigned int d = 0; d < ImageDimension; d++ )
       {
-      V[d] = warpedPoint(0, d) - point[d];
+      affineMatrix( n, d ) = A( n, d );
       }
-    ItV.Set( V );
     }
 
+  // Only the geometry of the domain image is needed.
+  typedef itk::Image<RealType, ImageDimension> ImageType;
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( argv[2] );
+  reader->UpdateOutputInformation();
+
+  tpsSource->SetOrigin( reader->GetOutput()->GetOrigin() );
+  tpsSource->SetSpacing( reader->GetOutput()->GetSpacing() );
+  tpsSource->SetSize( reader->GetOutput()->GetLargestPossibleRegion().GetSize() );
+  tpsSource->SetDirection( reader->GetOutput()->GetDirection() );
+  tpsSource->SetLandmarks( landmarks );
+  tpsSource->SetKernelWeights( weights );
+  tpsSource->SetAffineMatrix( affineMatrix );
+  if( argc > 7 )
+    {
+    tpsSource->SetApproximationFactor( atoi( argv[7] ) );
+    }
+  tpsSource->Update();
+
+  typename VectorImageType::Pointer output = tpsSource->GetOutput();
+
   typedef itk::Image<RealType, ImageDimension> RealImageType;
 
   typedef itk::VectorImageFileWriter<VectorImageType, RealImageType>
@@ -221,12 +206,13 @@ int GenerateTPSDeformationField( unsigned int argc, char *argv[] )
 
 int main( int argc, char *argv[] )
 {
-  if ( argc < 6 )
+  if ( argc < 7 )
 
     {
 
     std::cout << "Usage: " << argv[0] << " imageDimension domainImage "
-      << "controlPointFile tpsAffineFile tpsDeformFile outputField" << std::endl;
+      << "controlPointFile tpsAffineFile tpsDeformFile outputField "
+      << "[approximationFactor=1]" << std::endl;
     exit( 1 );
 
     }
@@ -235,11 +221,9 @@ int main( int argc, char *argv[] )
   switch( atoi( argv[1] ) )
    {
    case 2:
-     GenerateTPSDeformationField<2>( argc, argv );
-     break;
+     return GenerateTPSDeformationField<2>( argc, argv );
    case 3:
-     GenerateTPSDeformationField<3>( argc, argv );
-     break;
+     return GenerateTPSDeformationField<3>( argc, argv );
    default:
       std::cerr << "Unsupported dimension" << std::endl;
       exit( EXIT_FAILURE );
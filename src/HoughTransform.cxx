@@ -73,7 +73,7 @@ int HoughTransform( unsigned int argc, char *argv[] )
     }
   if( argc > 11 )
     {
-  houghFilter->SetVotingRadiusRatio( atof(argv[1+10]) );
+    houghFilter->SetVotingRadiusRatio( atof(argv[1+10]) );
     }
   if( argc > 12 )
     {
@@ -89,11 +89,11 @@ int HoughTransform( unsigned int argc, char *argv[] )
     }
   if( argc > 15 )
     {
-  houghFilter->SetNbOfThreads( atoi(argv[1+14]) );
+    houghFilter->SetNumberOfThreads( atoi(argv[1+14]) );
     }
   if( argc > 16 )
     {
-  houghFilter->SetSamplingRatio( atof(argv[1+15]) );
+    houghFilter->SetSamplingRatio( atof(argv[1+15]) );
     }
 
   std::cout << "Try updating." << std::endl;
@@ -135,8 +135,24 @@ int HoughTransform( unsigned int argc, char *argv[] )
               << std::endl;
     std::cout << "Radius: " << (*itSpheres)->GetRadius()[0] << std::endl;
 
-    itk::ImageRegionIteratorWithIndex<OutputImageType> It( localImage,
-      localImage->GetLargestPossibleRegion() );
+    // Only visit the bounding box of the sphere
+    typename OutputImageType::RegionType sphereRegion;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      const float c = (*itSpheres)->GetObjectToParentTransform()->GetOffset()[d];
+      const float r = (*itSpheres)->GetRadius()[0];
+      sphereRegion.SetIndex( d, static_cast<long>( vcl_floor( c - r ) ) );
+      sphereRegion.SetSize( d, static_cast<unsigned long>( vcl_floor( c + r ) - vcl_floor( c - r ) ) + 1 );
+      }
+    if( !sphereRegion.Crop( localOutputImage->GetLargestPossibleRegion() ) )
+      {
+      itSpheres++;
+      count++;
+      continue;
+      }
+
+    itk::ImageRegionIteratorWithIndex<OutputImageType> It( localOutputImage,
+      sphereRegion );
     for( It.GoToBegin(); !It.IsAtEnd(); ++It )
       {
       typename OutputImageType::IndexType index = It.GetIndex();
@@ -147,7 +163,7 @@ int HoughTransform( unsigned int argc, char *argv[] )
         }
       if( sum <= vnl_math_sqr( (*itSpheres)->GetRadius()[0] ) )
         {
-        localOutputImage->SetPixel( index, count );
+        It.Set( count );
         }
       }
     itSpheres++;
@@ -172,7 +188,6 @@ int HoughTransform( unsigned int argc, char *argv[] )
   typename CirclesWriterType::Pointer cwriter = CirclesWriterType::New();
   cwriter->SetInput( localOutputImage );
   cwriter->SetFileName( argv[1+2] );
-  cwriter->Update();
 
   try
     {
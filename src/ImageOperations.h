@@ -0,0 +1,377 @@
+#ifndef __ImageOperations_h
+#define __ImageOperations_h
+
+/*
+ * Core routines of the ThresholdImage, ShapeMorphology, OtsuThresholdImage
+ * and BinaryOperateImages tools on images held in memory.  The tools read
+ * their inputs, call these and write the result; RunImagePipeline chains
+ * them without going through files.  Errors are thrown as
+ * itk::ExceptionObject.
+ */
+
+#include "itkBinaryBallStructuringElement.h"
+#include "itkBinaryReinhardtMorphologicalImageFilter.h"
+#include "itkBinaryThresholdImageFilter.h"
+#include "itkImage.h"
+#include "itkImageRegionIterator.h"
+#include "itkLabelStatisticsImageFilter.h"
+#include "itkMacro.h"
+#include "itkNeighborhoodIterator.h"
+#include "itkNumericTraits.h"
+#include "itkOtsuMultipleThresholdsCalculator.h"
+
+#include <string>
+#include <vector>
+
+template <class TImage>
+typename TImage::Pointer ThresholdImageOperation( const TImage *input,
+  typename TImage::PixelType lowerThreshold,
+  typename TImage::PixelType upperThreshold,
+  typename TImage::PixelType insideValue,
+  typename TImage::PixelType outsideValue )
+{
+  typedef itk::BinaryThresholdImageFilter<TImage, TImage> FilterType;
+  typename FilterType::Pointer filter = FilterType::New();
+  filter->SetInput( input );
+  filter->SetLowerThreshold( lowerThreshold );
+  filter->SetUpperThreshold( upperThreshold );
+  filter->SetInsideValue( insideValue );
+  filter->SetOutsideValue( outsideValue );
+  filter->Update();
+
+  typename TImage::Pointer output = filter->GetOutput();
+  output->DisconnectPipeline();
+  return output;
+}
+
+/*
+ * options[k] is the (k+4)-th argument of ShapeMorphology: foregroundValue,
+ * then the on/off flags and structuring element radii of the successive
+ * operations.  Missing options are off.
+ */
+template <class TLabelImage>
+typename TLabelImage::Pointer ShapeMorphologyOperation(
+  const TLabelImage *input, const std::vector<int> &options )
+{
+  typedef itk::BinaryBallStructuringElement<typename TLabelImage::PixelType,
+    TLabelImage::ImageDimension>                      StructuringElementType;
+
+  typedef itk::BinaryReinhardtMorphologicalImageFilter<
+    TLabelImage, TLabelImage, StructuringElementType>  FilterType;
+  typename FilterType::Pointer filter = FilterType::New();
+  filter->SetInput( input );
+
+  const unsigned int n = options.size();
+
+  if ( n > 0 )
+    {
+    filter->SetForegroundValue( options[0] );
+    }
+
+  filter->SetEmploySaltAndPepperRepair( n > 1 && options[1] );
+  if ( n > 2 )
+    {
+    filter->SetSaltAndPepperMinimumSizeInPixels( options[2] );
+    }
+
+  filter->SetEmployMinimumDiameterFilter( n > 3 && options[3] );
+  if ( n > 4 )
+    {
+    filter->SetMinimumDiameterStructuringElementRadius( options[4] );
+    }
+
+  filter->SetEmployUnwantedCavityDeletion( n > 5 && options[5] );
+
+  filter->SetEmployMinimumSizeFilter( n > 6 && options[6] );
+  if ( n > 7 )
+    {
+    filter->SetMinimumSizeStructuringElementRadius( options[7] );
+    }
+
+  filter->SetEmployMaximumDiameterFilter( n > 8 && options[8] );
+  if ( n > 9 )
+    {
+    filter->SetMaximumDiameterStructuringElementRadius( options[9] );
+    }
+
+  filter->SetEmployConnectivityFilter( n > 10 && options[10] );
+  if ( n > 11 )
+    {
+    filter->SetNumberOfConnectedComponents( options[11] );
+    }
+
+  filter->SetEmployBoundarySmoother( n > 12 && options[12] );
+  if ( n > 13 )
+    {
+    filter->SetBoundarySmootherStructuringElementRadius( options[13] );
+    }
+
+  filter->SetEmployUnclassifiedPixelProcessing( n > 14 && options[14] );
+
+  filter->Update();
+
+  typename TLabelImage::Pointer output = filter->GetOutput();
+  output->DisconnectPipeline();
+  return output;
+}
+
+/*
+ * Labels 1 ... numberOfThresholds+1 inside the mask (the whole image if
+ * mask is null), 0 outside.
+ */
+template <class TImage, class TMaskImage>
+typename TMaskImage::Pointer OtsuThresholdImageOperation(
+  const TImage *input, unsigned int numberOfThresholds,
+  unsigned int numberOfBins, const TMaskImage *mask,
+  typename TMaskImage::PixelType maskLabel )
+{
+  typedef typename TImage::PixelType PixelType;
+  typedef typename TMaskImage::PixelType MaskPixelType;
+
+  typename TMaskImage::Pointer maskImage = const_cast<TMaskImage *>( mask );
+  if ( !maskImage )
+    {
+    maskImage = TMaskImage::New();
+    maskImage->SetRegions( input->GetLargestPossibleRegion() );
+    maskImage->SetOrigin( input->GetOrigin() );
+    maskImage->SetSpacing( input->GetSpacing() );
+    maskImage->SetDirection( input->GetDirection() );
+    maskImage->Allocate();
+    maskImage->FillBuffer( maskLabel );
+    }
+
+  itk::ImageRegionConstIterator<TImage> ItI( input,
+    input->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<TMaskImage> ItM( maskImage,
+    maskImage->GetLargestPossibleRegion() );
+  PixelType maxValue = itk::NumericTraits<PixelType>::min();
+  PixelType minValue = itk::NumericTraits<PixelType>::max();
+  for ( ItM.GoToBegin(), ItI.GoToBegin(); !ItI.IsAtEnd(); ++ItM, ++ItI )
+    {
+    if ( ItM.Get() == maskLabel )
+      {
+      if ( ItI.Get() < minValue )
+        {
+        minValue = ItI.Get();
+        }
+      else if ( ItI.Get() > maxValue )
+        {
+        maxValue = ItI.Get();
+        }
+      }
+    }
+
+  typedef itk::LabelStatisticsImageFilter<TImage, TMaskImage> StatsType;
+  typename StatsType::Pointer stats = StatsType::New();
+  stats->SetInput( input );
+  stats->SetLabelInput( maskImage );
+  stats->UseHistogramsOn();
+  stats->SetHistogramParameters( numberOfBins, minValue, maxValue );
+  stats->Update();
+
+  typedef itk::OtsuMultipleThresholdsCalculator
+    <typename StatsType::HistogramType> OtsuType;
+  typename OtsuType::Pointer otsu = OtsuType::New();
+  otsu->SetInputHistogram( stats->GetHistogram( maskLabel ) );
+  otsu->SetNumberOfThresholds( numberOfThresholds );
+  otsu->Update();
+
+  typename OtsuType::OutputType thresholds = otsu->GetOutput();
+
+  typename TMaskImage::Pointer output = TMaskImage::New();
+  output->SetRegions( maskImage->GetLargestPossibleRegion() );
+  output->SetOrigin( maskImage->GetOrigin() );
+  output->SetSpacing( maskImage->GetSpacing() );
+  output->SetDirection( maskImage->GetDirection() );
+  output->Allocate();
+  output->FillBuffer( 0 );
+
+  /*
+   * The label of a voxel is one more than the number of thresholds below
+   * or at its value, which is what the successive passes over the
+   * (increasing) thresholds assigned.
+   */
+  itk::ImageRegionIterator<TMaskImage> ItO( output,
+    output->GetLargestPossibleRegion() );
+  for ( ItI.GoToBegin(), ItM.GoToBegin(), ItO.GoToBegin(); !ItM.IsAtEnd();
+    ++ItI, ++ItM, ++ItO )
+    {
+    if ( ItM.Get() == maskLabel )
+      {
+      unsigned int label = 1;
+      while ( label <= thresholds.size() && !( ItI.Get() < thresholds[label-1] ) )
+        {
+        label++;
+        }
+      ItO.Set( static_cast<MaskPixelType>( label ) );
+      }
+    }
+
+  return output;
+}
+
+/*
+ * image3 is only used (and required) by "zscore".
+ */
+template <class TImage>
+typename TImage::Pointer BinaryOperateImagesOperation( const TImage *image1,
+  const std::string &op, const TImage *image2, const TImage *image3 = NULL )
+{
+  typedef typename TImage::PixelType PixelType;
+  typedef float RealType;
+
+  if ( op.compare( "zscore" ) == 0 && !image3 )
+    {
+    itkGenericExceptionMacro( "Need to specify third image." );
+    }
+
+  typename TImage::Pointer output = TImage::New();
+  output->SetOrigin( image1->GetOrigin() );
+  output->SetSpacing( image1->GetSpacing() );
+  output->SetRegions( image1->GetLargestPossibleRegion() );
+  output->SetDirection( image1->GetDirection() );
+  output->Allocate();
+  output->FillBuffer( 0 );
+
+  typename TImage::SizeType radius;
+  radius.Fill( 1 );
+
+  itk::NeighborhoodIterator<TImage> It( radius, output,
+    output->GetLargestPossibleRegion() );
+  itk::ConstNeighborhoodIterator<TImage> It1( radius, image1,
+    image1->GetLargestPossibleRegion() );
+  itk::ConstNeighborhoodIterator<TImage> It2( radius, image2,
+    image2->GetLargestPossibleRegion() );
+
+  for( It.GoToBegin(), It1.GoToBegin(), It2.GoToBegin();
+    !It.IsAtEnd(); ++It, ++It1, ++It2 )
+    {
+    if( op.compare( "+" ) == 0 )
+      {
+      It.SetCenterPixel( It1.GetCenterPixel() + It2.GetCenterPixel() );
+      }
+    else if( op.compare( "-" ) == 0 )
+      {
+      It.SetCenterPixel( It1.GetCenterPixel() - It2.GetCenterPixel() );
+      }
+    else if( op.compare( "x" ) == 0 )
+      {
+      It.SetCenterPixel( It1.GetCenterPixel() * It2.GetCenterPixel() );
+      }
+    else if( op.compare( "/" ) == 0 )
+      {
+      It.SetCenterPixel( It1.GetCenterPixel() / It2.GetCenterPixel() );
+      }
+    else if( op.compare( "or" ) == 0 )
+      {
+      if( static_cast<bool>( It1.GetCenterPixel() ) ||
+        static_cast<bool>( It2.GetCenterPixel() ) )
+        {
+        It.SetCenterPixel( itk::NumericTraits<PixelType>::One );
+        }
+      else
+        {
+        It.SetCenterPixel( itk::NumericTraits<PixelType>::Zero );
+        }
+      }
+    else if( op.compare( "xor" ) == 0 )
+      {
+      if( ( static_cast<bool>( It1.GetCenterPixel() ) ||
+        static_cast<bool>( It2.GetCenterPixel() ) ) &&
+        ( static_cast<bool>( It1.GetCenterPixel() ) !=
+        static_cast<bool>( It2.GetCenterPixel() ) ) )
+        {
+        It.SetCenterPixel( itk::NumericTraits<PixelType>::One );
+        }
+      else
+        {
+        It.SetCenterPixel( itk::NumericTraits<PixelType>::Zero );
+        }
+      }
+    else if( op.compare( "and" ) == 0 )
+      {
+      if( static_cast<bool>( It1.GetCenterPixel() ) &&
+        static_cast<bool>( It2.GetCenterPixel() ) )
+        {
+        It.SetCenterPixel( itk::NumericTraits<PixelType>::One );
+        }
+      else
+        {
+        It.SetCenterPixel( itk::NumericTraits<PixelType>::Zero );
+        }
+      }
+    else if( op.compare( "max" ) == 0 )
+      {
+      It.SetCenterPixel( vnl_math_max( It1.GetCenterPixel(), It2.GetCenterPixel() ) );
+      }
+    else if( op.compare( "replace" ) == 0 )
+      {
+      if( It2.GetCenterPixel() == 0 )
+        {
+        It.SetCenterPixel( It1.GetCenterPixel() );
+        }
+      else
+        {
+        It.SetCenterPixel( It2.GetCenterPixel() );
+        }
+      }
+    else if( op.compare( "isgreaterthan" ) == 0 )
+      {
+      It.SetCenterPixel( ( It1.GetCenterPixel() > It2.GetCenterPixel() ) ? 1 : 0 );
+      }
+    else if( op.compare( "islessthan" ) == 0 )
+      {
+      It.SetCenterPixel( ( It1.GetCenterPixel() < It2.GetCenterPixel() ) ? 1 : 0 );
+      }
+    else if( op.compare( "min" ) == 0 )
+      {
+      It.SetCenterPixel( vnl_math_min( It1.GetCenterPixel(), It2.GetCenterPixel() ) );
+      }
+    else if( op.compare( "zscore" ) == 0 )
+      {
+      RealType mean = It1.GetCenterPixel();
+      RealType std = vcl_sqrt( It2.GetCenterPixel() );
+      RealType pixel = image3->GetPixel( It1.GetIndex() );
+      if( std > 0 )
+        {
+        It.SetCenterPixel( ( pixel - mean ) / std );
+        }
+      }
+    else if( op.compare( "misc" ) == 0 )
+      {
+      if( It1.GetCenterPixel() == 0 )
+        {
+        continue;
+        }
+
+      bool isSurroundedIn2 = true;
+      bool isIsolated = true;
+
+      for( unsigned int n = 0; n < It1.GetNeighborhood().Size(); n++ )
+        {
+        isSurroundedIn2 = isSurroundedIn2 && static_cast<bool>( It2.GetPixel( n ) );
+        if( n == static_cast<unsigned int>( 0.5 * It1.Size() ) )
+          {
+          continue;
+          }
+        if( It1.GetPixel( n ) != 0 )
+          {
+          isIsolated = false;
+          break;
+          }
+        }
+      if( isIsolated /*&& isSurroundedIn2*/ )
+        {
+        It.SetCenterPixel( It1.GetCenterPixel() );
+        }
+      }
+    else
+      {
+      itkGenericExceptionMacro( "Unknown operation " << op << "." );
+      }
+    }
+
+  return output;
+}
+
+#endif
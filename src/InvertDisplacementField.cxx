@@ -1,4 +1,4 @@
-#include "itkImageFileReader.h"
+#include "itkDeformationFieldReader.h"
 #include "itkImageFileWriter.h"
 
 #include "itkInvertDisplacementFieldImageFilter.h"
@@ -15,7 +15,8 @@ int Invert( int argc, char *argv[] )
   typedef itk::Vector<double, ImageDimension> VectorType;
   typedef itk::Image<VectorType, ImageDimension> DisplacementFieldType;
 
-  typedef itk::ImageFileReader<DisplacementFieldType> ReaderType;
+  typedef itk::Image<typename VectorType::ValueType, ImageDimension> ComponentImageType;
+  typedef itk::DeformationFieldReader<ComponentImageType, DisplacementFieldType> ReaderType;
   typename ReaderType::Pointer reader = ReaderType::New();
   reader->SetFileName( argv[2] );
   reader->Update();
@@ -69,7 +70,8 @@ int BSplineInvertField( int argc, char *argv[] )
   typedef itk::Vector<double, ImageDimension> VectorType;
   typedef itk::Image<VectorType, ImageDimension> DisplacementFieldType;
 
-  typedef itk::ImageFileReader<DisplacementFieldType> ReaderType;
+  typedef itk::Image<typename VectorType::ValueType, ImageDimension> ComponentImageType;
+  typedef itk::DeformationFieldReader<ComponentImageType, DisplacementFieldType> ReaderType;
   typename ReaderType::Pointer reader = ReaderType::New();
   reader->SetFileName( argv[2] );
   reader->Update();
@@ -232,7 +234,8 @@ int Invert2( int argc, char *argv[] )
   typedef itk::Image<VectorType, ImageDimension> DisplacementFieldType;
   typedef itk::Image<TReal, ImageDimension> ImageType;
 
-  typedef itk::ImageFileReader<DisplacementFieldType> ReaderType;
+  typedef itk::Image<typename VectorType::ValueType, ImageDimension> ComponentImageType;
+  typedef itk::DeformationFieldReader<ComponentImageType, DisplacementFieldType> ReaderType;
   typename ReaderType::Pointer reader = ReaderType::New();
   reader->SetFileName( argv[2] );
   reader->Update();
@@ -391,7 +394,8 @@ int InvertTPS( int argc, char *argv[] )
   typedef itk::Vector<double, ImageDimension> VectorType;
   typedef itk::Image<VectorType, ImageDimension> DisplacementFieldType;
 
-  typedef itk::ImageFileReader<DisplacementFieldType> ReaderType;
+  typedef itk::Image<typename VectorType::ValueType, ImageDimension> ComponentImageType;
+  typedef itk::DeformationFieldReader<ComponentImageType, DisplacementFieldType> ReaderType;
   typename ReaderType::Pointer reader = ReaderType::New();
   reader->SetFileName( argv[2] );
   reader->Update();
@@ -1,22 +1,34 @@
-#include "itkHilbertPath.hxx"
+#include "itkImageRegionBrickSplitter.h"
 
 #include <fstream>
 
 template<unsigned int Dimension>
 int Hilbert( int argc, char *argv[] )
 {
-  typedef itk::HilbertPath<unsigned int, Dimension> PathType;
-  typename PathType::Pointer path = PathType::New();
-  path->SetHilbertOrder( atoi( argv[2] ) );
+  // The Hilbert curve of order n visits the 2^n x ... x 2^n grid; with
+  // bricks of one pixel the brick splitter gives that order.
+  typedef itk::ImageRegionBrickSplitter<Dimension> SplitterType;
+  typename SplitterType::Pointer path = SplitterType::New();
+
+  typename SplitterType::SizeType size;
+  size.Fill( 1UL << atoi( argv[2] ) );
+  typename SplitterType::RegionType region;
+  region.SetSize( size );
+  path->SetRegion( region );
+
+  typename SplitterType::SizeType brickSize;
+  brickSize.Fill( 1 );
+  path->SetBrickSize( brickSize );
+  path->SetCurve( SplitterType::HilbertCurve );
   path->Initialize();
 
   std::ofstream str( argv[3] );
-  typedef typename PathType::IndexType IndexType;
+  typedef typename SplitterType::IndexType IndexType;
 
   str << "0 0 0 0" << std::endl;
-  for( unsigned int s = 0; s < path->NumberOfSteps(); s++ )
+  for( unsigned long s = 0; s < path->GetNumberOfBricks(); s++ )
     {
-    IndexType index = path->Evaluate( s );
+    IndexType index = path->GetBrick( s ).GetIndex();
     for( unsigned int d = 0; d < Dimension; d++ )
       {
       str << index[d] << " ";
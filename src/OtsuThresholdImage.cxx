@@ -1,8 +1,7 @@
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 
-#include "itkLabelStatisticsImageFilter.h"
-#include "itkOtsuMultipleThresholdsCalculator.h"
+#include "ImageOperations.h"
 
 template <unsigned int ImageDimension>
 int OtsuThresholdImage( int argc, char *argv[] )
@@ -34,7 +33,7 @@ int OtsuThresholdImage( int argc, char *argv[] )
     }
 
   typedef itk::Image<int, ImageDimension> MaskImageType;
-  typename MaskImageType::Pointer maskImage = MaskImageType::New();
+  typename MaskImageType::Pointer maskImage = NULL;
   if ( argc > 6 )
     {
     typedef itk::ImageFileReader<MaskImageType> MaskReaderType;
@@ -43,98 +42,10 @@ int OtsuThresholdImage( int argc, char *argv[] )
     maskReader->Update();
     maskImage = maskReader->GetOutput();
     }
-  else
-    {
-    maskImage->SetRegions( reader->GetOutput()->GetLargestPossibleRegion() );
-    maskImage->SetOrigin( reader->GetOutput()->GetOrigin() );
-    maskImage->SetSpacing( reader->GetOutput()->GetSpacing() );
-    maskImage->SetDirection( reader->GetOutput()->GetDirection() );
-    maskImage->Allocate();
-    maskImage->FillBuffer( maskLabel );
-    }
-
-  itk::ImageRegionIterator<ImageType> ItI( reader->GetOutput(),
-    reader->GetOutput()->GetLargestPossibleRegion() );
-  itk::ImageRegionIterator<MaskImageType> ItM( maskImage,
-    maskImage->GetLargestPossibleRegion() );
-  PixelType maxValue = itk::NumericTraits<PixelType>::min();
-  PixelType minValue = itk::NumericTraits<PixelType>::max();
-  for ( ItM.GoToBegin(), ItI.GoToBegin(); !ItI.IsAtEnd(); ++ItM, ++ItI )
-    {
-    if ( ItM.Get() == maskLabel )
-      {
-      if ( ItI.Get() < minValue )
-        {
-        minValue = ItI.Get();
-        }
-      else if ( ItI.Get() > maxValue )
-        {
-        maxValue = ItI.Get();
-        }
-      }
-    }
-
-  typedef itk::LabelStatisticsImageFilter<ImageType, MaskImageType> StatsType;
-  typename StatsType::Pointer stats = StatsType::New();
-  stats->SetInput( reader->GetOutput() );
-  stats->SetLabelInput( maskImage );
-  stats->UseHistogramsOn();
-  stats->SetHistogramParameters( numberOfBins, minValue, maxValue );
-  stats->Update();
-
-  typedef itk::OtsuMultipleThresholdsCalculator<typename StatsType::HistogramType>
-    OtsuType;
-  typename OtsuType::Pointer otsu = OtsuType::New();
-  otsu->SetInputHistogram( stats->GetHistogram( maskLabel ) );
-  otsu->SetNumberOfThresholds( numberOfThresholds );
-  otsu->Update();
-
-  typename OtsuType::OutputType thresholds = otsu->GetOutput();
 
-  typename MaskImageType::Pointer output = MaskImageType::New();
-  output->SetRegions( maskImage->GetLargestPossibleRegion() );
-  output->SetOrigin( maskImage->GetOrigin() );
-  output->SetSpacing( maskImage->GetSpacing() );
-  output->SetDirection( maskImage->GetDirection() );
-  output->Allocate();
-  output->FillBuffer( 0 );
-
-  itk::ImageRegionIterator<MaskImageType> ItO( output,
-    output->GetLargestPossibleRegion() );
-  for ( unsigned int i = 0; i < thresholds.size(); i++ )
-    {
-
-    ItI.GoToBegin();
-    ItM.GoToBegin();
-    ItO.GoToBegin();
-    while ( !ItM.IsAtEnd() )
-      {
-      if ( ItM.Get() == maskLabel )
-        {
-        if ( ItO.Get() == 0 && ItI.Get() < thresholds[i] )
-          {
-          ItO.Set( i+1 );
-          }
-        }
-      ++ItI;
-      ++ItM;
-      ++ItO;
-      }
-    }
-
-  ItI.GoToBegin();
-  ItM.GoToBegin();
-  ItO.GoToBegin();
-  while ( !ItM.IsAtEnd() )
-    {
-    if ( ItM.Get() == maskLabel && ItO.Get() == 0 )
-      {
-      ItO.Set( thresholds.size()+1 );
-      }
-    ++ItI;
-    ++ItM;
-    ++ItO;
-    }
+  typename MaskImageType::Pointer output =
+    OtsuThresholdImageOperation<ImageType, MaskImageType>( reader->GetOutput(),
+    numberOfThresholds, numberOfBins, maskImage, maskLabel );
 
   typedef itk::ImageFileWriter<MaskImageType> WriterType;
   typename WriterType::Pointer writer = WriterType::New();
@@ -4,15 +4,7 @@
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 
-#include "itkResampleImageFilter.h"
-
-#include "itkConstantBoundaryCondition.h"
-#include "itkIdentityTransform.h"
-#include "itkBSplineInterpolateImageFunction.h"
-#include "itkLinearInterpolateImageFunction.h"
-#include "itkGaussianInterpolateImageFunction.h"
-#include "itkNearestNeighborInterpolateImageFunction.h"
-#include "itkWindowedSincInterpolateImageFunction.h"
+#include "itkSeparableResampleImageFilter.h"
 
 #include "Common.h"
 
@@ -28,59 +20,10 @@ int ResampleImage( int argc, char *argv[] )
   reader->SetFileName( argv[2] );
   reader->Update();
 
-  typedef itk::IdentityTransform<RealType, ImageDimension> TransformType;
-  typename TransformType::Pointer transform = TransformType::New();
-  transform->SetIdentity();
-
-  typedef itk::LinearInterpolateImageFunction<ImageType, RealType>
-    LinearInterpolatorType;
-  typename LinearInterpolatorType::Pointer interpolator
-    = LinearInterpolatorType::New();
-  interpolator->SetInputImage( reader->GetOutput() );
-
-  typedef itk::NearestNeighborInterpolateImageFunction<ImageType, RealType>
-    NearestNeighborInterpolatorType;
-  typename NearestNeighborInterpolatorType::Pointer nn_interpolator
-    = NearestNeighborInterpolatorType::New();
-  nn_interpolator->SetInputImage( reader->GetOutput() );
-
-  typedef itk::BSplineInterpolateImageFunction<ImageType, RealType>
-    BSplineInterpolatorType;
-  typename BSplineInterpolatorType::Pointer bs_interpolator
-    = BSplineInterpolatorType::New();
-  bs_interpolator->SetInputImage( reader->GetOutput() );
-
-  typedef itk::GaussianInterpolateImageFunction<ImageType, RealType>
-    GaussianInterpolatorType;
-  typename GaussianInterpolatorType::Pointer g_interpolator
-    = GaussianInterpolatorType::New();
-  g_interpolator->SetInputImage( reader->GetOutput() );
-
-  typedef itk::WindowedSincInterpolateImageFunction<ImageType, 3> HammingInterpolatorType;
-  typename HammingInterpolatorType::Pointer sh_interpolator = HammingInterpolatorType::New();
-  sh_interpolator->SetInputImage( reader->GetOutput() );
-
-  typedef itk::WindowedSincInterpolateImageFunction<ImageType, 3,
-    itk::Function::CosineWindowFunction<3> > Sinc1InterpolatorType;
-  typename Sinc1InterpolatorType::Pointer sc_interpolator = Sinc1InterpolatorType::New();
-  sc_interpolator->SetInputImage( reader->GetOutput() );
-
-  typedef itk::WindowedSincInterpolateImageFunction<ImageType, 3,
-    itk::Function::WelchWindowFunction<3> > Sinc2InterpolatorType;
-  typename Sinc2InterpolatorType::Pointer sw_interpolator = Sinc2InterpolatorType::New();
-  sw_interpolator->SetInputImage( reader->GetOutput() );
-
-  typedef itk::WindowedSincInterpolateImageFunction<ImageType, 3,
-    itk::Function::LanczosWindowFunction<3> > Sinc3InterpolatorType;
-  typename Sinc3InterpolatorType::Pointer sl_interpolator = Sinc3InterpolatorType::New();
-  sl_interpolator->SetInputImage( reader->GetOutput() );
-
-  typedef itk::WindowedSincInterpolateImageFunction<ImageType, 3,
-    itk::Function::BlackmanWindowFunction<3> > Sinc4InterpolatorType;
-  typename Sinc3InterpolatorType::Pointer sb_interpolator = Sinc3InterpolatorType::New();
-  sb_interpolator->SetInputImage( reader->GetOutput() );
-
-  typedef itk::ResampleImageFilter<ImageType, ImageType, RealType> ResamplerType;
+  // The transform is the identity and only the spacing and size change so
+  // the separable resampler gives the same result as ResampleImageFilter
+  // with the corresponding interpolator.
+  typedef itk::SeparableResampleImageFilter<ImageType, ImageType> ResamplerType;
   typename ResamplerType::Pointer resampler = ResamplerType::New();
   typename ResamplerType::SpacingType spacing;
   typename ResamplerType::SizeType size;
@@ -147,21 +90,20 @@ int ResampleImage( int argc, char *argv[] )
     arg7 = *argv[7];
     }
 
-  resampler->SetTransform( transform );
-  resampler->SetInterpolator( interpolator );
+  resampler->SetKernel( ResamplerType::Linear );
   if( argc > 6 && atoi( argv[6] ) )
     {
     switch( atoi( argv[6] ) )
       {
       case 0: default:
-        resampler->SetInterpolator( interpolator );
+        resampler->SetKernel( ResamplerType::Linear );
         break;
       case 1:
-        resampler->SetInterpolator( nn_interpolator );
+        resampler->SetKernel( ResamplerType::NearestNeighbor );
         break;
       case 2:
         {
-        double sigma[ImageDimension];
+        typename ResamplerType::ArrayType sigma;
         for( unsigned int d = 0; d < ImageDimension; d++ )
           {
           sigma[d] = reader->GetOutput()->GetSpacing()[d];
@@ -180,43 +122,47 @@ int ResampleImage( int argc, char *argv[] )
           {
           alpha = static_cast<double>( atof( argv[8] ) );
           }
-        g_interpolator->SetParameters( sigma, alpha );
+        resampler->SetSigma( sigma );
+        resampler->SetAlpha( alpha );
 
-        resampler->SetInterpolator( g_interpolator );
+        resampler->SetKernel( ResamplerType::Gaussian );
         }
         break;
       case 3:
         {
+        resampler->SetKernel( ResamplerType::WindowedSinc );
+        resampler->SetWindowRadius( 3 );
         switch( arg7 )
           {
           case 'h': default:
-            resampler->SetInterpolator( sh_interpolator );
+            resampler->SetWindow( ResamplerType::Hamming );
             break;
           case 'c':
-            resampler->SetInterpolator( sc_interpolator );
+            resampler->SetWindow( ResamplerType::Cosine );
             break;
           case 'l':
-            resampler->SetInterpolator( sl_interpolator );
+            resampler->SetWindow( ResamplerType::Lanczos );
             break;
           case 'w':
-            resampler->SetInterpolator( sw_interpolator );
+            resampler->SetWindow( ResamplerType::Welch );
             break;
           case 'b':
-            resampler->SetInterpolator( sb_interpolator );
+            resampler->SetWindow( ResamplerType::Blackman );
             break;
           }
         }
+        break;
       case 4:
         {
         if( argc > 7 && atoi( argv[7] ) >= 0 && atoi( argv[7] ) <= 5 )
           {
-          bs_interpolator->SetSplineOrder( atoi( argv[7] ) );
+          resampler->SetSplineOrder( atoi( argv[7] ) );
           }
         else
           {
-          bs_interpolator->SetSplineOrder( 3 );
+          resampler->SetSplineOrder( 3 );
           }
-        resampler->SetInterpolator( bs_interpolator );
+        resampler->SetKernel( ResamplerType::BSpline );
         break;
         }
       }
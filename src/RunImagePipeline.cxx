@@ -0,0 +1,547 @@
+#include "itkCastImageFilter.h"
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkTimeProbe.h"
+
+#include "vnl/vnl_math.h"
+
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ImageOperations.h"
+
+/*
+ * Runs a list of ThresholdImage, ShapeMorphology, OtsuThresholdImage and
+ * BinaryOperateImages steps on images held in memory.
+ *
+ * Each line of the step file is the command line of one of these tools
+ * without the program path and the image dimension.  An image argument
+ * that names the output of an earlier step refers to that image in memory;
+ * any other image argument is a file, read once.  Outputs are only names:
+ * nothing is written unless asked for with
+ *
+ *   WriteImage name fileName
+ *
+ * (later steps reading fileName then get the image in memory) or, for all
+ * the outputs, with an intermediate directory on the command line.  An
+ * output name may be reused; later steps see the new image.
+ *
+ * The steps are grouped in waves: a step runs in the wave after the last of
+ * the steps producing its inputs.  The steps of a wave run concurrently and
+ * an image is released as soon as its last reader has run.  The ImageIO
+ * factory lookup is not thread safe, so reading and writing files is
+ * serialized; only the processing steps overlap.
+ */
+
+template <unsigned int ImageDimension>
+class ImagePipeline
+{
+public:
+  typedef float                                    PixelType;
+  typedef itk::Image<PixelType, ImageDimension>    ImageType;
+  typedef itk::Image<unsigned int, ImageDimension> LabelImageType;
+  typedef itk::Image<int, ImageDimension>          MaskImageType;
+
+  struct Step
+    {
+    std::string                Tool;
+    std::vector<std::string>   Arguments;
+    std::vector<int>           InputSlots;
+    int                        OutputSlot;
+    unsigned int               Wave;
+    double                     ElapsedTime;
+    std::string                Error;
+    };
+
+  ImagePipeline() : m_NextStep( 0 ) {}
+
+  /* Returns false (with a message) for an unknown tool or missing
+   * arguments. */
+  bool AddStep( const std::vector<std::string> &tokens, std::string &error )
+    {
+    Step step;
+    step.Tool = tokens[0];
+    step.Arguments.assign( tokens.begin() + 1, tokens.end() );
+    step.OutputSlot = -1;
+    step.Wave = 0;
+    step.ElapsedTime = 0.0;
+
+    std::vector<unsigned int> inputPositions;
+    int outputPosition = -1;
+    unsigned int minimumNumberOfArguments = 0;
+    if( step.Tool == "ThresholdImage" )
+      {
+      // inputImage outputImage lower upper [inside] [outside]
+      inputPositions.push_back( 0 );
+      outputPosition = 1;
+      minimumNumberOfArguments = 4;
+      }
+    else if( step.Tool == "ShapeMorphology" )
+      {
+      // labelImage outputImage [foregroundValue] [options ...]
+      inputPositions.push_back( 0 );
+      outputPosition = 1;
+      minimumNumberOfArguments = 2;
+      }
+    else if( step.Tool == "OtsuThresholdImage" )
+      {
+      // inputImage outputImage [thresholds] [bins] [maskImage] [maskLabel]
+      inputPositions.push_back( 0 );
+      inputPositions.push_back( 4 );
+      outputPosition = 1;
+      minimumNumberOfArguments = 2;
+      }
+    else if( step.Tool == "BinaryOperateImages" )
+      {
+      // inputImage1 operation inputImage2 outputImage [inputImage3]
+      inputPositions.push_back( 0 );
+      inputPositions.push_back( 2 );
+      inputPositions.push_back( 4 );
+      outputPosition = 3;
+      minimumNumberOfArguments = 4;
+      }
+    else if( step.Tool == "WriteImage" )
+      {
+      // image fileName
+      inputPositions.push_back( 0 );
+      minimumNumberOfArguments = 2;
+      }
+    else
+      {
+      error = "unknown tool " + step.Tool;
+      return false;
+      }
+    if( step.Arguments.size() < minimumNumberOfArguments )
+      {
+      error = "too few arguments for " + step.Tool;
+      return false;
+      }
+
+    step.InputSlots.assign( step.Arguments.size(), -1 );
+    for( unsigned int i = 0; i < inputPositions.size(); i++ )
+      {
+      unsigned int position = inputPositions[i];
+      if( position < step.Arguments.size() )
+        {
+        int slot = this->GetSlot( step.Arguments[position] );
+        step.InputSlots[position] = slot;
+        step.Wave = vnl_math_max( step.Wave, this->m_SlotWaves[slot] + 1 );
+        this->m_NumberOfReaders[slot]++;
+        }
+      }
+
+    if( outputPosition >= 0 )
+      {
+      step.OutputSlot = this->AddSlot( step.Arguments[outputPosition], step.Wave );
+      }
+    else if( step.Tool == "WriteImage" )
+      {
+      this->m_Slots[step.Arguments[1]] = step.InputSlots[0];
+      }
+
+    this->m_Steps.push_back( step );
+    return true;
+    }
+
+  /* Returns false if a step failed. */
+  bool Run( unsigned int numberOfConcurrentSteps,
+    const std::string &intermediateDirectory )
+    {
+    this->m_IntermediateDirectory = intermediateDirectory;
+    this->m_Images.assign( this->m_SlotNames.size(),
+      typename ImageType::Pointer() );
+    std::vector<unsigned int> remainingReaders = this->m_NumberOfReaders;
+
+    unsigned int numberOfWaves = 0;
+    for( unsigned int n = 0; n < this->m_Steps.size(); n++ )
+      {
+      numberOfWaves = vnl_math_max( numberOfWaves, this->m_Steps[n].Wave + 1 );
+      }
+
+    for( unsigned int wave = 0; wave < numberOfWaves; wave++ )
+      {
+      this->m_CurrentSteps.clear();
+      for( unsigned int n = 0; n < this->m_Steps.size(); n++ )
+        {
+        if( this->m_Steps[n].Wave == wave )
+          {
+          this->m_CurrentSteps.push_back( n );
+          }
+        }
+      if( this->m_CurrentSteps.empty() )
+        {
+        continue;
+        }
+      this->m_NextStep = 0;
+
+      itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+      threader->SetNumberOfThreads( vnl_math_min( numberOfConcurrentSteps,
+        static_cast<unsigned int>( this->m_CurrentSteps.size() ) ) );
+      threader->SetSingleMethod( StepThreaderCallback, this );
+      threader->SingleMethodExecute();
+
+      bool failed = false;
+      for( unsigned int i = 0; i < this->m_CurrentSteps.size(); i++ )
+        {
+        const Step &step = this->m_Steps[this->m_CurrentSteps[i]];
+        if( !step.Error.empty() )
+          {
+          std::cerr << "Step " << this->m_CurrentSteps[i] + 1 << " ("
+                    << step.Tool << ") failed: " << step.Error << std::endl;
+          failed = true;
+          }
+        }
+      if( failed )
+        {
+        return false;
+        }
+
+      // Release the images whose last reader has run, and the outputs
+      // nobody reads.
+      for( unsigned int i = 0; i < this->m_CurrentSteps.size(); i++ )
+        {
+        const Step &step = this->m_Steps[this->m_CurrentSteps[i]];
+        for( unsigned int j = 0; j < step.InputSlots.size(); j++ )
+          {
+          int slot = step.InputSlots[j];
+          if( slot >= 0 && --remainingReaders[slot] == 0 )
+            {
+            this->m_Images[slot] = NULL;
+            }
+          }
+        if( step.OutputSlot >= 0 && remainingReaders[step.OutputSlot] == 0 )
+          {
+          this->m_Images[step.OutputSlot] = NULL;
+          }
+        }
+      }
+    return true;
+    }
+
+  void PrintReport( std::ostream &os, double totalTime ) const
+    {
+    os << std::setw( 5 ) << "Step" << std::setw( 6 ) << "Wave"
+       << std::setw( 12 ) << "Time (s)" << "  Command" << std::endl;
+    for( unsigned int n = 0; n < this->m_Steps.size(); n++ )
+      {
+      const Step &step = this->m_Steps[n];
+      os << std::setw( 5 ) << n + 1 << std::setw( 6 ) << step.Wave
+         << std::setw( 12 ) << std::fixed << std::setprecision( 3 )
+         << step.ElapsedTime << "  " << step.Tool;
+      for( unsigned int i = 0; i < step.Arguments.size(); i++ )
+        {
+        os << " " << step.Arguments[i];
+        }
+      os << std::endl;
+      }
+    os << "Total: " << std::fixed << std::setprecision( 3 ) << totalTime
+       << " s" << std::endl;
+    }
+
+private:
+  /* The image an argument refers to, reading the file on first use. */
+  int GetSlot( const std::string &name )
+    {
+    std::map<std::string, int>::const_iterator it =
+      this->m_Slots.find( name );
+    if( it != this->m_Slots.end() )
+      {
+      return it->second;
+      }
+
+    Step step;
+    step.Tool = "ReadImage";
+    step.Arguments.push_back( name );
+    step.OutputSlot = this->AddSlot( name, 0 );
+    step.Wave = 0;
+    step.ElapsedTime = 0.0;
+    this->m_Steps.push_back( step );
+    return step.OutputSlot;
+    }
+
+  int AddSlot( const std::string &name, unsigned int wave )
+    {
+    int slot = this->m_SlotNames.size();
+    this->m_SlotNames.push_back( name );
+    this->m_SlotWaves.push_back( wave );
+    this->m_NumberOfReaders.push_back( 0 );
+    this->m_Slots[name] = slot;
+    return slot;
+    }
+
+  static ITK_THREAD_RETURN_TYPE StepThreaderCallback( void *arg )
+    {
+    ImagePipeline *pipeline = (ImagePipeline *)
+      ( ( (itk::MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+    while( true )
+      {
+      unsigned int next;
+      pipeline->m_Mutex.Lock();
+      next = pipeline->m_NextStep++;
+      pipeline->m_Mutex.Unlock();
+      if( next >= pipeline->m_CurrentSteps.size() )
+        {
+        break;
+        }
+      pipeline->RunStep( pipeline->m_Steps[pipeline->m_CurrentSteps[next]] );
+      }
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+  const ImageType * GetInput( const Step &step, unsigned int position ) const
+    {
+    if( position >= step.InputSlots.size() || step.InputSlots[position] < 0 )
+      {
+      return NULL;
+      }
+    return this->m_Images[step.InputSlots[position]];
+    }
+
+  template <class TOutputImage, class TInputImage>
+  static typename TOutputImage::Pointer CastImage( const TInputImage *input )
+    {
+    typedef itk::CastImageFilter<TInputImage, TOutputImage> CasterType;
+    typename CasterType::Pointer caster = CasterType::New();
+    caster->SetInput( input );
+    caster->Update();
+    typename TOutputImage::Pointer output = caster->GetOutput();
+    output->DisconnectPipeline();
+    return output;
+    }
+
+  void RunStep( Step &step )
+    {
+    const std::vector<std::string> &args = step.Arguments;
+
+    itk::TimeProbe timer;
+    timer.Start();
+    try
+      {
+      typename ImageType::Pointer output = NULL;
+      if( step.Tool == "ReadImage" )
+        {
+        this->m_IOMutex.Lock();
+        try
+          {
+          typedef itk::ImageFileReader<ImageType> ReaderType;
+          typename ReaderType::Pointer reader = ReaderType::New();
+          reader->SetFileName( args[0].c_str() );
+          reader->Update();
+          output = reader->GetOutput();
+          output->DisconnectPipeline();
+          }
+        catch( ... )
+          {
+          this->m_IOMutex.Unlock();
+          throw;
+          }
+        this->m_IOMutex.Unlock();
+        }
+      else if( step.Tool == "ThresholdImage" )
+        {
+        output = ThresholdImageOperation<ImageType>( this->GetInput( step, 0 ),
+          atof( args[2].c_str() ), atof( args[3].c_str() ),
+          ( args.size() > 4 ) ? atof( args[4].c_str() ) : 1.0,
+          ( args.size() > 5 ) ? atof( args[5].c_str() ) : 0.0 );
+        }
+      else if( step.Tool == "ShapeMorphology" )
+        {
+        std::vector<int> options;
+        for( unsigned int i = 2; i < args.size(); i++ )
+          {
+          options.push_back( atoi( args[i].c_str() ) );
+          }
+        typename LabelImageType::Pointer labels =
+          CastImage<LabelImageType>( this->GetInput( step, 0 ) );
+        output = CastImage<ImageType>( ShapeMorphologyOperation<LabelImageType>(
+          labels, options ).GetPointer() );
+        }
+      else if( step.Tool == "OtsuThresholdImage" )
+        {
+        typename MaskImageType::Pointer mask = NULL;
+        if( this->GetInput( step, 4 ) )
+          {
+          mask = CastImage<MaskImageType>( this->GetInput( step, 4 ) );
+          }
+        typename MaskImageType::Pointer labels =
+          OtsuThresholdImageOperation<ImageType, MaskImageType>(
+          this->GetInput( step, 0 ),
+          ( args.size() > 2 ) ? atoi( args[2].c_str() ) : 2,
+          ( args.size() > 3 ) ? atoi( args[3].c_str() ) : 100, mask,
+          ( args.size() > 5 ) ? atoi( args[5].c_str() ) : 1 );
+        output = CastImage<ImageType>( labels.GetPointer() );
+        }
+      else if( step.Tool == "BinaryOperateImages" )
+        {
+        output = BinaryOperateImagesOperation<ImageType>(
+          this->GetInput( step, 0 ), args[1], this->GetInput( step, 2 ),
+          this->GetInput( step, 4 ) );
+        }
+      else if( step.Tool == "WriteImage" )
+        {
+        this->WriteImage( this->GetInput( step, 0 ), args[1] );
+        }
+
+      if( step.OutputSlot >= 0 )
+        {
+        this->m_Images[step.OutputSlot] = output;
+        if( !this->m_IntermediateDirectory.empty() && step.Tool != "ReadImage" )
+          {
+          this->WriteImage( output, this->m_IntermediateDirectory + "/" +
+            this->m_SlotNames[step.OutputSlot] + ".nii.gz" );
+          }
+        }
+      }
+    catch( itk::ExceptionObject &e )
+      {
+      step.Error = e.GetDescription();
+      }
+    catch( std::exception &e )
+      {
+      // e.g. std::bad_alloc; letting it leave the thread would terminate
+      step.Error = e.what();
+      }
+    catch( ... )
+      {
+      step.Error = "unknown exception";
+      }
+    timer.Stop();
+    step.ElapsedTime = timer.GetMeanTime();
+    }
+
+  void WriteImage( const ImageType *image, const std::string &fileName )
+    {
+    this->m_IOMutex.Lock();
+    try
+      {
+      typedef itk::ImageFileWriter<ImageType> WriterType;
+      typename WriterType::Pointer writer = WriterType::New();
+      writer->SetFileName( fileName.c_str() );
+      writer->SetInput( image );
+      writer->Update();
+      }
+    catch( ... )
+      {
+      this->m_IOMutex.Unlock();
+      throw;
+      }
+    this->m_IOMutex.Unlock();
+    }
+
+  std::vector<Step>                           m_Steps;
+  std::map<std::string, int>                  m_Slots;
+  std::vector<std::string>                    m_SlotNames;
+  std::vector<unsigned int>                   m_SlotWaves;
+  std::vector<unsigned int>                   m_NumberOfReaders;
+  std::vector<typename ImageType::Pointer>    m_Images;
+  std::string                                 m_IntermediateDirectory;
+
+  std::vector<unsigned int>                   m_CurrentSteps;
+  unsigned int                                m_NextStep;
+  itk::SimpleFastMutexLock                    m_Mutex;
+  itk::SimpleFastMutexLock                    m_IOMutex;
+};
+
+template <unsigned int ImageDimension>
+int RunImagePipeline( int argc, char *argv[] )
+{
+  ImagePipeline<ImageDimension> pipeline;
+
+  std::ifstream file( argv[2] );
+  if( !file )
+    {
+    std::cerr << "Unable to open " << argv[2] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::string line;
+  unsigned int lineNumber = 0;
+  while( std::getline( file, line ) )
+    {
+    lineNumber++;
+    std::string::size_type comment = line.find( '#' );
+    if( comment != std::string::npos )
+      {
+      line.erase( comment );
+      }
+
+    std::istringstream iss( line );
+    std::vector<std::string> tokens;
+    std::string token;
+    while( iss >> token )
+      {
+      tokens.push_back( token );
+      }
+    if( tokens.empty() )
+      {
+      continue;
+      }
+
+    std::string error;
+    if( !pipeline.AddStep( tokens, error ) )
+      {
+      std::cerr << argv[2] << ":" << lineNumber << ": " << error << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  unsigned int numberOfConcurrentSteps =
+    itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  if( argc > 3 )
+    {
+    numberOfConcurrentSteps = vnl_math_max( 1, atoi( argv[3] ) );
+    }
+  std::string intermediateDirectory;
+  if( argc > 4 )
+    {
+    intermediateDirectory = std::string( argv[4] );
+    }
+
+  itk::TimeProbe timer;
+  timer.Start();
+  bool succeeded = pipeline.Run( numberOfConcurrentSteps, intermediateDirectory );
+  timer.Stop();
+
+  pipeline.PrintReport( std::cout, timer.GetMeanTime() );
+
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main( int argc, char *argv[] )
+{
+  if( argc < 3 )
+    {
+    std::cout << "Usage: " << argv[0] << " imageDimension stepFile "
+      << "[numberOfConcurrentSteps] [intermediateDirectory]" << std::endl;
+    std::cout << "  Each line of stepFile is a ThresholdImage, ShapeMorphology, "
+      << "OtsuThresholdImage or" << std::endl;
+    std::cout << "  BinaryOperateImages command line without the image "
+      << "dimension, or 'WriteImage name file'." << std::endl;
+    std::cout << "  Images named as outputs stay in memory, e.g." << std::endl;
+    std::cout << "    ThresholdImage input.nii.gz mask 0 25 0 1" << std::endl;
+    std::cout << "    OtsuThresholdImage input.nii.gz otsu 255 2" << std::endl;
+    std::cout << "    BinaryOperateImages mask + otsu labels" << std::endl;
+    std::cout << "    WriteImage labels labels.nii.gz" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  switch( atoi( argv[1] ) )
+   {
+   case 2:
+     return RunImagePipeline<2>( argc, argv );
+   case 3:
+     return RunImagePipeline<3>( argc, argv );
+   default:
+      std::cerr << "Unsupported dimension" << std::endl;
+      exit( EXIT_FAILURE );
+   }
+}
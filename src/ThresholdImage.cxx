@@ -1,7 +1,8 @@
 #include "itkImage.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
-#include "itkBinaryThresholdImageFilter.h"
+
+#include "ImageOperations.h"
 
 template <unsigned int ImageDimension>
 int ThresholdImage(int argc, char *argv[])
@@ -15,35 +16,25 @@ int ThresholdImage(int argc, char *argv[])
   reader->SetFileName( argv[2] );
   reader->Update();
 
-  typedef itk::BinaryThresholdImageFilter<ImageType, ImageType> FilterType;
-  typename FilterType::Pointer filter = FilterType::New();
-  filter->SetInput( reader->GetOutput() );
-  filter->SetLowerThreshold( static_cast<PixelType>( atof( argv[4] ) ) );
-  filter->SetUpperThreshold( static_cast<PixelType>( atof( argv[5] ) ) );
-
+  PixelType insideValue = static_cast<PixelType>( 1 );
   if ( argc >= 7 )
     {
-    filter->SetInsideValue( static_cast<PixelType>( atof( argv[6] ) ) );
-    }
-  else
-    {
-    filter->SetInsideValue( static_cast<PixelType>( 1 ) );
+    insideValue = static_cast<PixelType>( atof( argv[6] ) );
     }
+  PixelType outsideValue = static_cast<PixelType>( 0 );
   if ( argc >= 8 )
     {
-    filter->SetOutsideValue( static_cast<PixelType>( atof( argv[7] ) ) );
-    }
-  else
-    {
-    filter->SetOutsideValue( static_cast<PixelType>( 0 ) );
+    outsideValue = static_cast<PixelType>( atof( argv[7] ) );
     }
-//   filter->Print( std::cout, 5 );
 
+  typename ImageType::Pointer output = ThresholdImageOperation<ImageType>(
+    reader->GetOutput(), static_cast<PixelType>( atof( argv[4] ) ),
+    static_cast<PixelType>( atof( argv[5] ) ), insideValue, outsideValue );
 
   typedef itk::ImageFileWriter<ImageType> WriterType;
   typename WriterType::Pointer writer = WriterType::New();
   writer->SetFileName( argv[3] );
-  writer->SetInput( filter->GetOutput() );
+  writer->SetInput( output );
   writer->Update();
 
  return 0;
@@ -2,7 +2,7 @@
 #include "itkLabeledPointSetFileReader.h"
 #include "itkLabeledPointSetFileWriter.h"
 #include "itkPointSet.h"
-#include "itkImageFileReader.h"
+#include "itkDeformationFieldReader.h"
 #include "itkVectorLinearInterpolateImageFunction.h"
 
 template <unsigned int ImageDimension>
@@ -22,7 +22,7 @@ int WarpPoints( int argc, char *argv[] )
 
 //  try
 //    {
-    typedef itk::ImageFileReader<DeformationFieldType> FieldReaderType;
+    typedef itk::DeformationFieldReader<RealImageType, DeformationFieldType> FieldReaderType;
     typename FieldReaderType::Pointer fieldreader = FieldReaderType::New();
     fieldreader->SetFileName( argv[3] );
     fieldreader->Update();
@@ -1,7 +1,7 @@
 #include "itkVTKPolyDataReader.h"
 #include "itkVTKPolyDataWriter.h"
 #include "itkMesh.h"
-#include "itkImageFileReader.h"
+#include "itkDeformationFieldReader.h"
 #include "itkVectorLinearInterpolateImageFunction.h"
 
 template <unsigned int ImageDimension>
@@ -18,7 +18,7 @@ int WarpVTKPolyData( int argc, char *argv[] )
   reader->SetFileName( argv[2] );
   reader->Update();
 
-  typedef itk::ImageFileReader<DeformationFieldType> FieldReaderType;
+  typedef itk::DeformationFieldReader<RealImageType, DeformationFieldType> FieldReaderType;
   typename FieldReaderType::Pointer fieldreader = FieldReaderType::New();
   fieldreader->SetFileName( argv[3] );
   fieldreader->Update();